@@ -2,6 +2,25 @@ if(NOT CMAKE_BUILD_TYPE)
 	set(CMAKE_BUILD_TYPE "RelWithDebInfo")
 endif()
 
+# Сборка с санитайзером: address, thread или undefined
+set(ES_SANITIZER "" CACHE STRING "Sanitizer to build with: address, thread or undefined")
+if(ES_SANITIZER)
+    if(MSVC)
+        if(NOT ES_SANITIZER STREQUAL "address")
+            message(FATAL_ERROR "MSVC supports only ES_SANITIZER=address")
+        endif()
+        set(CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} /fsanitize=address")
+    else()
+        set(CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} -fsanitize=${ES_SANITIZER} -fno-omit-frame-pointer")
+        set(CMAKE_EXE_LINKER_FLAGS "${CMAKE_EXE_LINKER_FLAGS} -fsanitize=${ES_SANITIZER}")
+    endif()
+    # Сборки с санитайзером складываются в отдельные каталоги,
+    # чтобы не перезаписывать обычную сборку
+    set(ES_OUTPUT_SUFFIX "/${ES_SANITIZER}")
+else()
+    set(ES_OUTPUT_SUFFIX "")
+endif()
+
 set(ARCHIVE_OUTPUT_DIRECTORIES
     CMAKE_ARCHIVE_OUTPUT_DIRECTORY_DEBUG
     CMAKE_ARCHIVE_OUTPUT_DIRECTORY_RELEASE
@@ -10,7 +29,7 @@ set(ARCHIVE_OUTPUT_DIRECTORIES
 )
 
 foreach(DIR ${ARCHIVE_OUTPUT_DIRECTORIES})
-    set(${DIR} ${CMAKE_SOURCE_DIR}/lib)
+    set(${DIR} ${CMAKE_SOURCE_DIR}/lib${ES_OUTPUT_SUFFIX})
 endforeach()
 
 set(LIBRARY_OUTPUT_DIRECTORIES
@@ -21,7 +40,7 @@ set(LIBRARY_OUTPUT_DIRECTORIES
 )
 
 foreach(DIR ${LIBRARY_OUTPUT_DIRECTORIES})
-    set(${DIR} ${CMAKE_SOURCE_DIR}/bin)
+    set(${DIR} ${CMAKE_SOURCE_DIR}/bin${ES_OUTPUT_SUFFIX})
 endforeach()
 
 set(RUNTIME_OUTPUT_DIRECTORIES
@@ -32,7 +51,7 @@ set(RUNTIME_OUTPUT_DIRECTORIES
 )
 
 foreach(DIR ${RUNTIME_OUTPUT_DIRECTORIES})
-    set(${DIR} ${CMAKE_SOURCE_DIR}/bin)
+    set(${DIR} ${CMAKE_SOURCE_DIR}/bin${ES_OUTPUT_SUFFIX})
 endforeach()
 
 if(NOT CMAKE_DEBUG_POSTFIX)
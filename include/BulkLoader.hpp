@@ -0,0 +1,123 @@
+﻿#pragma once
+
+#include "IExpertSystem.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace ES
+{
+
+/**
+ * База знаний для пакетной загрузки.
+ */
+struct KnowledgeBaseEntry
+{
+    // Путь к файлу конфигурации
+    std::string path;
+    // Готовность сервиса ждёт загрузки обязательных баз
+    bool required = true;
+};
+
+/**
+ * Результат загрузки одной базы знаний.
+ */
+struct BulkLoadResult
+{
+    // Путь к файлу конфигурации
+    std::string path;
+    // Обязательная база знаний
+    bool required = true;
+    // Загруженная экспертная система, либо nullptr при ошибке
+    std::unique_ptr<IExpertSystem> system;
+    // Текст ошибки загрузки
+    std::string error;
+    // Размер файла конфигурации в байтах
+    std::uintmax_t bytes = 0;
+    // Время от начала пакета до начала загрузки, мс
+    double startMs = 0;
+    // Время загрузки, мс
+    double loadMs = 0;
+};
+
+/**
+ * Параметры пакетной загрузки.
+ */
+struct BulkLoadOptions
+{
+    // Количество одновременно загружаемых баз. 0 - по числу ядер
+    std::size_t threads = 0;
+    // Заранее просить систему читать файлы следующих баз
+    bool readahead = true;
+    // Хранение текстов узлов в сжатом виде
+    TextCompressionOptions textCompression;
+    // Бюджет памяти каждой базы знаний
+    MemoryBudgetOptions memoryBudget;
+    // Проверка графа каждой базы знаний. В строгом режиме
+    // база с ошибками считается не загрузившейся
+    ValidationOptions validation;
+    // Вызывается из загружающего потока после загрузки каждой базы.
+    // Вызовы не пересекаются
+    std::function<void(const BulkLoadResult&)> onLoaded;
+    // Вызывается один раз, когда загружены все обязательные базы
+    std::function<void()> onReady;
+};
+
+/**
+ * Результат пакетной загрузки.
+ */
+struct BulkLoadReport
+{
+    // Результаты в порядке перечисления баз
+    std::vector<BulkLoadResult> bases;
+    // Количество загруженных баз
+    std::size_t loaded = 0;
+    // Количество баз, загрузить которые не удалось
+    std::size_t failed = 0;
+    // Загружены все обязательные базы
+    bool ready = false;
+    // Время до готовности, мс
+    double readyMs = 0;
+    // Время загрузки пакета, мс
+    double totalMs = 0;
+    // Сумма времени загрузки баз, мс. Если потокам хватает ядер,
+    // это время последовательной загрузки тех же баз
+    double sequentialMs = 0;
+};
+
+/**
+ * Получение списка баз знаний из каталога или файла-манифеста.
+ * Из каталога берутся все файлы *.xml, кроме файлов текстов
+ * на других языках (с элементом <texts> вместо <tree>).
+ * Манифест - текстовый файл, в каждой строке которого путь к базе
+ * относительно каталога манифеста. Пустые строки и строки,
+ * начинающиеся с #, пропускаются, а путь, начинающийся с ?,
+ * задаёт необязательную базу.
+ *
+ * \param path Путь к каталогу или манифесту
+ * \return Базы знаний
+ */
+std::vector<KnowledgeBaseEntry> ListKnowledgeBases(
+    const std::string& path) noexcept(false);
+
+/**
+ * Параллельная загрузка баз знаний.
+ * Базы загружаются пулом потоков от больших файлов к меньшим,
+ * поэтому время загрузки пакета определяется самым большим файлом,
+ * а не суммой размеров. Пока одни базы разбираются, система
+ * заранее читает с диска файлы следующих. Ошибка загрузки базы
+ * не прерывает пакет и записывается в её результат.
+ *
+ * \param entries Базы знаний
+ * \param options Параметры загрузки
+ * \return Результат загрузки
+ */
+BulkLoadReport LoadKnowledgeBases(
+    const std::vector<KnowledgeBaseEntry>& entries,
+    const BulkLoadOptions& options);
+
+}
@@ -0,0 +1,51 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace ES
+{
+
+/**
+ * Способ разбора xml-конфигурации.
+ */
+enum class XmlParser
+{
+    Auto,       // Сканер схемы, а если конфигурация выходит за схему - pugixml
+    Scanner,    // Только сканер схемы
+    Pugixml     // Только pugixml
+};
+
+/**
+ * Итог разбора конфигурации.
+ */
+struct ConfigParseStats
+{
+    // Количество узлов
+    std::size_t nodes = 0;
+    // Количество соединений
+    std::size_t connections = 0;
+    // Размер текстов узлов в байтах
+    std::size_t textBytes = 0;
+    // Контрольная сумма узлов и соединений в порядке файла.
+    // У разных способов разбора одной конфигурации совпадает
+    std::uint64_t checksum = 0;
+};
+
+/**
+ * Разбор конфигурации без построения дерева.
+ * Узлы и соединения передаются построителю, который только считает их,
+ * поэтому время разбора не включает построение дерева и индексов.
+ * Экспертная система при загрузке использует способ Auto.
+ *
+ * \param configPath Путь к файлу конфигурации
+ * \param parser Способ разбора. Scanner выбрасывает исключение,
+ * если конфигурация выходит за схему
+ * \return Итог разбора
+ */
+ConfigParseStats ParseConfig(
+    const std::string& configPath,
+    const XmlParser parser) noexcept(false);
+
+}
@@ -1,11 +1,223 @@
 ﻿#pragma once
 
+#include "ISessionJournal.hpp"
+#include "ITraceRecorder.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <memory>
+#include <vector>
 
 namespace ES
 {
 
+/**
+ * Режим репликации загруженного дерева.
+ */
+enum class ReplicationMode
+{
+    None,           // Одно дерево на все сеансы
+    PerNumaNode,    // Копия дерева на каждый NUMA-узел
+    PerThreadGroup  // Копия дерева на каждую группу процессоров
+};
+
+/**
+ * Размещение копий дерева в памяти.
+ */
+enum class ReplicaPlacement
+{
+    FirstTouch, // Копию строит поток, привязанный к процессорам узла
+    Bind        // Дополнительно память потока явно привязывается к узлу
+};
+
+/**
+ * Параметры репликации дерева.
+ */
+struct ReplicationOptions
+{
+    // Режим репликации
+    ReplicationMode mode = ReplicationMode::None;
+    // Количество групп процессоров для режима PerThreadGroup.
+    // 0 - по количеству NUMA-узлов
+    std::size_t groups = 0;
+    // Размещение копий
+    ReplicaPlacement placement = ReplicaPlacement::FirstTouch;
+};
+
+/**
+ * Параметры хранения текстов узлов.
+ */
+struct TextCompressionOptions
+{
+    // Хранить тексты узлов сжатыми блоками с общим словарём
+    bool enabled = false;
+    // Размер блока несжатых текстов в байтах.
+    // При показе узла разжимается только его блок
+    std::size_t blockSize = 16 * 1024;
+    // Размер общего словаря в байтах
+    std::size_t dictionarySize = 32 * 1024;
+    // Количество разжатых текстов в кэше каждого сеанса
+    std::size_t cacheSize = 64;
+};
+
+/**
+ * Узел, найденный по тексту.
+ */
+struct SearchHit
+{
+    // Идентификатор узла
+    int nodeID = -1;
+    // Релевантность. Больше - лучше
+    float score = 0;
+};
+
+/**
+ * Действие при превышении бюджета памяти базы знаний.
+ */
+enum class MemoryBudgetPolicy
+{
+    Reject,     // Загрузка отклоняется, остаётся прежняя база знаний
+    Degrade     // Загрузка повторяется со сжатыми текстами узлов
+};
+
+/**
+ * Бюджет памяти базы знаний.
+ */
+struct MemoryBudgetOptions
+{
+    // Лимит памяти одной копии базы знаний в байтах.
+    // 0 - без ограничения
+    std::size_t limit = 0;
+    // Действие при превышении лимита
+    MemoryBudgetPolicy policy = MemoryBudgetPolicy::Reject;
+};
+
+/**
+ * Память, занятая загруженной базой знаний, по категориям.
+ */
+struct MemoryReport
+{
+    // Узлы и блоки хранилища узлов
+    std::size_t structure = 0;
+    // Соединения вопросов
+    std::size_t edges = 0;
+    // Тексты узлов, сжатые или несжатые
+    std::size_t texts = 0;
+    // Индекс идентификаторов, множества достижимых ответов,
+    // обратные соединения и полнотекстовый индекс
+    std::size_t indices = 0;
+    // Неиспользованные остатки блоков памяти
+    std::size_t unused = 0;
+    // Память, освобождённая контейнерами внутри блоков,
+    // но не переиспользуемая до удаления базы знаний
+    std::size_t wasted = 0;
+    // Сумма всех категорий. С ней сравнивается бюджет
+    std::size_t total = 0;
+    // Память копий дерева при репликации. В total не входит
+    std::size_t replicas = 0;
+};
+
+/**
+ * Вид ошибки в графе базы знаний.
+ */
+enum class ValidationIssue
+{
+    MissingNode,            // Соединение ссылается на несуществующий узел
+    AnswerSource,           // Соединение выходит из ответа
+    DuplicateNode,          // Повторяющийся идентификатор узла
+    DeadEnd,                // Вопрос без соединений
+    OverlappingPredicates,  // Соединение вопроса с уже встречавшимся значением ответа
+    Unreachable,            // Узел недостижим из корня
+    Cycle,                  // Соединение замыкает цикл
+    InvalidProbability      // Вероятности ответов вне [0, 1] или не дают в сумме 1
+};
+
+// Количество видов ошибок в графе
+constexpr std::size_t kValidationIssues = 8;
+
+/**
+ * Параметры проверки графа базы знаний при загрузке.
+ */
+struct ValidationOptions
+{
+    // Отклонять базу знаний с ошибками: Load выбрасывает исключение,
+    // и прежняя база знаний остаётся загруженной
+    bool strict = false;
+    // Проверять граф целиком и после перезагрузки, построившей
+    // новую версию дерева из прежней. Иначе такая версия проверяется
+    // только на ошибки, найденные при загрузке изменений: повторяющиеся
+    // узлы, соединения с несуществующими узлами и из ответов. В строгом режиме
+    // граф всегда проверяется целиком
+    bool reload = false;
+    // Количество потоков проверки, 0 - по числу процессоров
+    std::size_t threads = 0;
+};
+
+/**
+ * Отчёт о проверке графа базы знаний.
+ */
+struct ValidationReport
+{
+    // Количество примеров каждого вида ошибок
+    static constexpr std::size_t kMaxSamples = 8;
+
+    // Ошибки одного вида
+    struct Issues
+    {
+        // Количество ошибок
+        std::size_t count = 0;
+        // Идентификаторы узлов первых ошибок: отсутствующий
+        // или повторяющийся узел, ответ с соединениями,
+        // вопрос с ошибкой в соединениях либо недостижимый узел
+        std::vector<int> samples;
+    };
+
+    // Ошибки по видам, индекс - ValidationIssue
+    std::array<Issues, kValidationIssues> issues;
+    // Сумма ошибок всех видов
+    std::size_t total = 0;
+    // Количество проверенных узлов без удалённых
+    std::size_t nodes = 0;
+    // Количество проверенных соединений
+    std::size_t connections = 0;
+    // Время проверки графа в миллисекундах
+    double milliseconds = 0;
+};
+
+/**
+ * Получение названия вида ошибки в графе.
+ *
+ * \param issue Вид ошибки
+ * \return Название
+ */
+const char* GetValidationIssueName(
+    const ValidationIssue issue) noexcept;
+
+/**
+ * Оставшийся ответ и его вероятность.
+ */
+struct ScoredCandidate
+{
+    // Идентификатор узла ответа
+    int nodeID = -1;
+    // Вероятность ответа с учётом поданных ответов
+    double probability = 0;
+};
+
+/**
+ * Шаг пути по дереву.
+ */
+struct PathStep
+{
+    // Идентификатор вопроса
+    int questionID = -1;
+    // Ответ на вопрос, ведущий к следующему узлу пути
+    int answer = 0;
+};
+
 /**
  * Интерфейс экспертной системы.
  */
@@ -32,10 +244,25 @@ public:
 
     /**
      * Получение текущего результата.
+     * После загрузки экспертной системы данный метод,
+     * как и методы SetAnswer, Back, IsFinished и Reset,
+     * не выделяет память. Исключение - первый переход глубже
+     * ES_INLINE_PATH_DEPTH узлов, если в пуле путей нет свободного буфера.
+     *
+     * \return Ответ экспертной системы (вопрос либо ответ).
+     * Текст действителен до следующей загрузки экспертной системы.
+     * Если тексты узлов хранятся сжатыми, то текст находится в кэше
+     * сеанса и действителен до следующего вызова любого метода сеанса
+     */
+    virtual std::string_view GetCurrentData() const = 0;
+
+    /**
+     * Получение идентификатора текущего узла.
      *
-     * \return Ответ экспертной системы (вопрос либо ответ)
+     * \return Идентификатор текущего узла (вопроса либо ответа),
+     * либо -1, если экспертная система не загружена
      */
-    virtual std::string GetCurrentData() const = 0;
+    virtual int GetCurrentID() const = 0;
 
     /**
      * Подача ответа в экспертную систему.
@@ -58,6 +285,347 @@ public:
      * \return 
      */
     virtual void Reset() = 0;
+
+    /**
+     * Возврат к предыдущему вопросу.
+     * Отменяет последний принятый ответ за O(1), не повторяя
+     * предыдущие ответы. Возврат возможен и из ответа.
+     *
+     * \return true - если возврат выполнен,
+     * false - если сеанс находится в начале дерева
+     */
+    virtual bool Back() = 0;
+
+    /**
+     * Возврат к вопросу на заданной глубине пути.
+     * Отменяет все ответы, поданные после этого вопроса.
+     *
+     * \param depth Глубина вопроса: 0 - начало дерева,
+     * GetDepth() - текущий узел
+     * \return true - если возврат выполнен,
+     * false - если глубина больше текущей
+     */
+    virtual bool BackTo(
+        const std::size_t depth) = 0;
+
+    /**
+     * Получение глубины текущего узла.
+     *
+     * \return Количество принятых ответов с последнего сброса
+     */
+    virtual std::size_t GetDepth() const = 0;
+
+    /**
+     * Получение идентификатора узла на пути сеанса.
+     *
+     * \param depth Глубина узла: 0 - начало дерева,
+     * GetDepth() - текущий узел
+     * \return Идентификатор узла, либо -1, если глубина больше текущей
+     */
+    virtual int GetPathID(
+        const std::size_t depth) const = 0;
+
+    /**
+     * Получение количества ответов, которые ещё можно получить
+     * из текущего узла. Множества достижимых ответов вычисляются
+     * при загрузке (после перезагрузки с изменениями - при первом
+     * обращении), поэтому метод выполняется за O(1).
+     *
+     * \return Количество оставшихся ответов
+     * (1, если сеанс уже дошёл до ответа)
+     */
+    virtual std::size_t GetCandidatesCount() const = 0;
+
+    /**
+     * Проверка, можно ли ещё получить заданный ответ.
+     *
+     * \param answerID Идентификатор узла ответа
+     * \return true - если ответ достижим из текущего узла
+     */
+    virtual bool IsCandidate(
+        const int answerID) const = 0;
+
+    /**
+     * Получение ответов, которые ещё можно получить.
+     *
+     * \return Идентификаторы узлов ответов
+     */
+    virtual std::vector<int> GetCandidates() const = 0;
+
+    /**
+     * Пересечение оставшихся ответов с заданным набором.
+     *
+     * \param answerIDs Идентификаторы узлов ответов
+     * \return Идентификаторы из набора, которые ещё можно получить,
+     * в порядке набора
+     */
+    virtual std::vector<int> FilterCandidates(
+        const std::vector<int>& answerIDs) const = 0;
+
+    /**
+     * Получение наиболее вероятных оставшихся ответов.
+     * В дереве все достижимые ответы равновероятны.
+     *
+     * \param count Наибольшее количество ответов
+     * \return Ответы по убыванию вероятности
+     */
+    virtual std::vector<ScoredCandidate> GetTopCandidates(
+        const std::size_t count) const = 0;
+
+    /**
+     * Получение количества оставшихся ответов,
+     * которые достижимы также из заданного узла.
+     *
+     * \param nodeID Идентификатор узла
+     * \return Размер пересечения, либо 0, если узла нет
+     */
+    virtual std::size_t GetCommonCandidatesCount(
+        const int nodeID) const = 0;
+
+    /**
+     * Получение путей от начала дерева до заданного узла,
+     * например всех последовательностей ответов, приводящих к диагнозу.
+     * Обратные соединения строятся при загрузке (после перезагрузки
+     * с изменениями - при первом обращении), поэтому время
+     * пропорционально размеру результата.
+     *
+     * \param nodeID Идентификатор узла
+     * \param limit Наибольшее количество путей, 0 - все пути
+     * \return Пути. Каждый путь - вопросы и ответы на них от начала
+     * дерева, сам узел в путь не входит. Пусто, если узел недостижим
+     */
+    virtual std::vector<std::vector<PathStep>> GetPathsTo(
+        const int nodeID,
+        const std::size_t limit) const = 0;
+
+    /**
+     * Получение кратчайшего пути от начала дерева до заданного узла.
+     *
+     * \param nodeID Идентификатор узла
+     * \return Вопросы и ответы на них. Пусто, если узел - начало
+     * дерева либо недостижим
+     */
+    virtual std::vector<PathStep> GetShortestPathTo(
+        const int nodeID) const = 0;
+
+    /**
+     * Переход к заданному узлу по кратчайшему пути.
+     * Сеанс сбрасывается и подаёт ответы пути, поэтому после
+     * перехода работает возврат к предыдущим вопросам.
+     *
+     * \param nodeID Идентификатор узла
+     * \return true - если узел достижим и переход выполнен
+     */
+    virtual bool JumpTo(
+        const int nodeID) = 0;
+
+    /**
+     * Восстановление пути сеанса по идентификаторам узлов.
+     * Сеанс сбрасывается и проходит путь по соединениям дерева за один
+     * проход, не подавая ответы, поэтому восстановление не пишется
+     * в трассу, а в журнал сеансов записывается только итоговый путь.
+     *
+     * \param path Идентификаторы узлов пути после начала дерева,
+     * то есть GetPathID(1), ..., GetPathID(GetDepth())
+     * \return true - если пройден весь путь, false - если узел пути
+     * не соединён с предыдущим: сеанс остаётся на предыдущем узле
+     */
+    virtual bool RestorePath(
+        const std::vector<int>& path) = 0;
+
+    /**
+     * Поиск вопросов и ответов по тексту.
+     * Находятся узлы, тексты которых содержат все слова запроса,
+     * причём каждое слово запроса может быть началом слова текста.
+     * Регистр и различие е/ё не учитываются. Индекс строится
+     * при загрузке (после перезагрузки с изменениями - при первом
+     * поиске), поэтому поиск не перебирает узлы дерева.
+     * Чтобы начать проход с найденного узла, достаточно
+     * перейти к нему методом JumpTo.
+     *
+     * \param query Запрос
+     * \param limit Наибольшее количество результатов
+     * \return Найденные узлы по убыванию релевантности
+     */
+    virtual std::vector<SearchHit> Search(
+        const std::string& query,
+        const std::size_t limit) const = 0;
+
+    /**
+     * Создание нового сеанса работы с уже загруженной экспертной системой.
+     * Сеанс разделяет с исходной экспертной системой загруженное дерево
+     * и имеет собственное состояние, поэтому разные сеансы
+     * можно использовать из разных потоков одновременно.
+     * Последующая загрузка исходной экспертной системы не влияет
+     * на ранее созданные сеансы.
+     *
+     * \return Новый сеанс в начальном состоянии
+     */
+    virtual std::unique_ptr<IExpertSystem> CreateSession() const = 0;
+
+    /**
+     * Создание нового сеанса с текстами на заданном языке.
+     * Структура дерева разделяется всеми языками, тексты языка
+     * загружаются из файла языка при создании первого сеанса на нём
+     * и затем разделяются всеми сеансами на этом языке.
+     * Если для узла нет перевода, то выводится основной текст.
+     * Сеансы, созданные из нового сеанса методом CreateSession,
+     * используют тот же язык.
+     *
+     * \param language Код языка из GetLanguages,
+     * либо пустая строка для основного языка конфигурации
+     * \return Новый сеанс в начальном состоянии
+     */
+    virtual std::unique_ptr<IExpertSystem> CreateSession(
+        const std::string& language) const noexcept(false) = 0;
+
+    /**
+     * Получение дополнительных языков загруженной экспертной системы.
+     *
+     * \return Коды языков, перечисленных в конфигурации
+     */
+    virtual std::vector<std::string> GetLanguages() const = 0;
+
+    /**
+     * Подключение записи трассы.
+     * Каждый последующий вызов SetAnswer и Reset записывается в трассу.
+     * Сеансы, созданные методом CreateSession, наследуют запись трассы.
+     * Поддерживается только запись, созданная CreateTraceRecorder,
+     * для других реализаций бросается std::invalid_argument.
+     *
+     * \param recorder Запись трассы, либо nullptr для отключения записи
+     * \return
+     */
+    virtual void SetTraceRecorder(
+        std::shared_ptr<ITraceRecorder> recorder) = 0;
+
+    /**
+     * Настройка репликации дерева.
+     * Загруженное дерево (и все последующие загрузки) копируется
+     * на каждый NUMA-узел либо на каждую группу процессоров.
+     * Сеансы, созданные методом CreateSession, при создании и при каждом
+     * вызове Reset переключаются на копию, локальную для процессора
+     * вызывающего потока. На машине с одним NUMA-узлом
+     * в режиме PerNumaNode создаётся одна копия.
+     *
+     * \param options Параметры репликации
+     * \return
+     */
+    virtual void SetReplication(
+        const ReplicationOptions& options) noexcept(false) = 0;
+
+    /**
+     * Получение количества копий загруженного дерева.
+     *
+     * \return Количество копий (1, если репликация отключена)
+     */
+    virtual std::size_t GetReplicasCount() const = 0;
+
+    /**
+     * Настройка хранения текстов узлов.
+     * Параметры применяются при следующей загрузке.
+     * Сжатые тексты не используются при переходах между узлами,
+     * текст узла разжимается только в GetCurrentData. Сеансы,
+     * созданные методом CreateSession, получают собственный кэш
+     * разжатых текстов. Пока кэш не заполнен, GetCurrentData
+     * может выделять память.
+     *
+     * \param options Параметры хранения текстов
+     * \return
+     */
+    virtual void SetTextCompression(
+        const TextCompressionOptions& options) = 0;
+
+    /**
+     * Получение идентификатора сеанса.
+     * По идентификатору сеанс продолжается после перезапуска
+     * методом ResumeSession.
+     *
+     * \return Идентификатор сеанса
+     */
+    virtual std::uint64_t GetSessionID() const = 0;
+
+    /**
+     * Подключение журнала сеансов.
+     * Текущий путь сеанса сразу записывается в журнал, далее каждый
+     * принятый ответ, сброс и возврат. Сеансы, созданные методом
+     * CreateSession, наследуют журнал. Поддерживается только журнал,
+     * открытый OpenSessionJournal, для других реализаций бросается
+     * std::invalid_argument.
+     *
+     * \param journal Журнал сеансов, либо nullptr для отключения журнала
+     * \return
+     */
+    virtual void SetSessionJournal(
+        std::shared_ptr<ISessionJournal> journal) = 0;
+
+    /**
+     * Продолжение сеанса, сохранённого в журнале.
+     * Сеанс проходит сохранённый путь по загруженному дереву. Если узел
+     * пути был удалён из конфигурации, то путь обрезается перед ним.
+     *
+     * \param sessionID Идентификатор сеанса
+     * \return Сеанс, либо nullptr, если журнал не подключён
+     * или сеанса нет в журнале
+     */
+    virtual std::unique_ptr<IExpertSystem> ResumeSession(
+        const std::uint64_t sessionID) const = 0;
+
+    /**
+     * Продолжение сеанса, сохранённого в заданном журнале.
+     * Журнал подключается только к продолженному сеансу, поэтому
+     * сама экспертная система ничего в него не пишет. Так выбирается
+     * один сеанс, а остальные сеансы журнала остаются незавершёнными.
+     *
+     * \param journal Журнал сеансов, открытый OpenSessionJournal
+     * \param sessionID Идентификатор сеанса
+     * \return Сеанс, либо nullptr, если сеанса нет в журнале
+     */
+    virtual std::unique_ptr<IExpertSystem> ResumeSession(
+        std::shared_ptr<ISessionJournal> journal,
+        const std::uint64_t sessionID) const = 0;
+
+    /**
+     * Настройка бюджета памяти базы знаний.
+     * Параметры применяются при следующей загрузке. Загрузка, при которой
+     * база знаний заняла бы больше лимита, прерывается, как только лимит
+     * превышен. В режиме Reject Load выбрасывает исключение, а в режиме
+     * Degrade повторяет загрузку со сжатыми текстами узлов и выбрасывает
+     * исключение, только если не хватило и этого. Прежняя база знаний
+     * при этом остаётся загруженной.
+     *
+     * \param options Параметры бюджета
+     * \return
+     */
+    virtual void SetMemoryBudget(
+        const MemoryBudgetOptions& options) = 0;
+
+    /**
+     * Получение памяти, занятой загруженной базой знаний.
+     * Тексты на дополнительных языках не учитываются.
+     *
+     * \return Память по категориям
+     */
+    virtual MemoryReport GetMemoryReport() const = 0;
+
+    /**
+     * Установка параметров проверки графа.
+     * Граф проверяется при каждой загрузке до того, как база
+     * знаний заменит прежнюю. После перезагрузки с изменениями
+     * граф проверяется целиком, только если это запрошено.
+     *
+     * \param options Параметры проверки
+     * \return
+     */
+    virtual void SetValidation(
+        const ValidationOptions& options) = 0;
+
+    /**
+     * Получение отчёта о проверке графа загруженной базы знаний.
+     *
+     * \return Отчёт, пустой, если база знаний не загружена
+     */
+    virtual ValidationReport GetValidationReport() const = 0;
 };
 
 /**
@@ -65,4 +633,18 @@ public:
  */
 std::unique_ptr<IExpertSystem> CreateExpertSystem();
 
+/**
+ * Создание вероятностной экспертной системы.
+ * Вместо дерева конфигурация задаёт в разделе <bayes> диагнозы
+ * с априорными вероятностями, вопросы и вероятности ответов
+ * на каждый вопрос при каждом диагнозе. Ответы подаются в любом
+ * порядке: JumpTo переходит к любому вопросу, на который ещё нет
+ * ответа. После каждого ответа пересчитываются вероятности всех
+ * диагнозов, и лучшие из них возвращает GetTopCandidates.
+ * Поиск и языки работают так же, как у дерева. Путей в модели нет,
+ * поэтому методы путей, как и подключение трассы и журнала сеансов,
+ * бросают std::runtime_error.
+ */
+std::unique_ptr<IExpertSystem> CreateBayesExpertSystem();
+
 }
@@ -0,0 +1,115 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace ES
+{
+
+/**
+ * Параметры журнала сеансов.
+ */
+struct JournalOptions
+{
+    // Каталог, в котором хранятся файлы журнала и контрольные точки
+    std::string directory;
+    // Период группового сохранения в миллисекундах. Переходы сеансов,
+    // сделанные за период, записываются и сбрасываются на диск вместе
+    unsigned commitIntervalMs = 5;
+    // Сбрасывать записанное на диск (fsync). Без сброса журнал
+    // переживает падение процесса, но не отключение питания
+    bool sync = true;
+    // Объём журнала после последней контрольной точки,
+    // после которого записывается новая контрольная точка
+    std::size_t checkpointBytes = 256 * 1024 * 1024;
+    // Ёмкость кольцевого буфера каждого потока в записях
+    // (округляется вверх до степени двойки)
+    std::size_t ringCapacity = 64 * 1024;
+};
+
+/**
+ * Статистика журнала сеансов.
+ */
+struct JournalStats
+{
+    // Количество сохранённых записей
+    std::uint64_t written = 0;
+    // Количество групповых сохранений
+    std::uint64_t commits = 0;
+    // Количество случаев, когда поток ждал освобождения
+    // переполненного кольцевого буфера
+    std::uint64_t stalls = 0;
+    // Количество записанных контрольных точек
+    std::uint64_t checkpoints = 0;
+    // Количество переходов, не попавших в журнал: потоку
+    // не хватило памяти под буфер
+    std::uint64_t dropped = 0;
+    // Количество сеансов, восстановленных при открытии журнала
+    std::size_t recovered = 0;
+    // Время восстановления при открытии журнала в миллисекундах
+    double recoveryMs = 0;
+};
+
+/**
+ * Интерфейс журнала сеансов.
+ * Каждый переход сеанса (принятый ответ, сброс, возврат) записывается
+ * в кольцевой буфер потока. Фоновый поток периодически дописывает
+ * буферы в файл журнала и сбрасывает его на диск одним вызовом fsync.
+ * Когда журнал вырастает, фоновый поток сворачивает его в контрольную
+ * точку с путями незавершённых сеансов, и старые файлы журнала удаляются.
+ * При открытии журнала последняя контрольная точка и последующие
+ * файлы журнала отображаются в память и по ним восстанавливаются
+ * пути незавершённых сеансов. Сеанс завершается при удалении его объекта.
+ */
+class ISessionJournal
+{
+public:
+    virtual ~ISessionJournal() = default;
+
+    /**
+     * Сохранение всех сделанных переходов.
+     * После возврата переходы переживут падение процесса.
+     *
+     * \return
+     */
+    virtual void Flush() = 0;
+
+    /**
+     * Запись контрольной точки и удаление старых файлов журнала.
+     *
+     * \return
+     */
+    virtual void Checkpoint() = 0;
+
+    /**
+     * Получение идентификаторов сеансов, восстановленных при открытии
+     * журнала. Их можно продолжить методом IExpertSystem::ResumeSession.
+     *
+     * \return Идентификаторы сеансов
+     */
+    virtual std::vector<std::uint64_t> GetSessions() const = 0;
+
+    /**
+     * Получение статистики журнала.
+     *
+     * \return Статистика
+     */
+    virtual JournalStats GetStats() const = 0;
+};
+
+/**
+ * Открытие журнала сеансов с восстановлением сохранённых сеансов.
+ * Журнал подключается к экспертной системе методом
+ * IExpertSystem::SetSessionJournal. Идентификаторы новых сеансов
+ * после открытия журнала больше идентификаторов восстановленных.
+ *
+ * \param options Параметры журнала
+ * \return Журнал
+ */
+std::shared_ptr<ISessionJournal> OpenSessionJournal(
+    const JournalOptions& options) noexcept(false);
+
+}
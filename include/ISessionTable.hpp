@@ -0,0 +1,135 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace ES
+{
+
+/**
+ * Параметры таблицы сеансов.
+ */
+struct SessionTableOptions
+{
+    // Наибольшее количество одновременно открытых сеансов
+    // (округляется вверх до степени двойки)
+    std::size_t capacity = 64 * 1024;
+    // Наибольшая глубина пути сеанса. Место под путь такой длины
+    // выделяется в каждой ячейке таблицы
+    std::size_t maxDepth = 128;
+};
+
+/**
+ * Состояние сеанса в таблице: путь сеанса по дереву.
+ * Сеанс восстанавливается в любом процессе одним проходом
+ * по пути (IExpertSystem::RestorePath).
+ */
+struct SessionState
+{
+    // Номер последнего применённого запроса. Позволяет повторить
+    // запрос после падения обработчика, не применив его дважды
+    std::uint64_t sequence = 0;
+    // Идентификаторы узлов пути после начала дерева
+    std::vector<int> path;
+};
+
+/**
+ * Статистика таблицы сеансов.
+ */
+struct SessionTableStats
+{
+    // Наибольшее количество сеансов
+    std::size_t capacity = 0;
+    // Количество открытых сеансов
+    std::size_t size = 0;
+    // Наибольшая глубина пути сеанса
+    std::size_t maxDepth = 0;
+    // Количество изменений сеансов, прерванных завершением процесса
+    std::uint64_t recovered = 0;
+    // Объём разделяемой памяти в байтах
+    std::size_t bytes = 0;
+};
+
+/**
+ * Интерфейс таблицы сеансов, разделяемой между процессами.
+ * Таблица размещается в разделяемой памяти и наследуется процессами,
+ * порождёнными через fork после её создания, поэтому любой процесс
+ * может продолжить любой сеанс. Чтение и создание сеансов не блокируются.
+ * Изменения одного сеанса выполняются по очереди: процесс держит сеанс,
+ * пока изменяет его, а остальные процессы, изменяющие тот же сеанс,
+ * ждут, поэтому изменения не свободны от блокировок. Изменения разных
+ * сеансов друг друга не ждут. Изменение, прерванное завершением
+ * процесса, не оставляет следов: прежнее состояние сеанса остаётся
+ * целым, и очередь переходит к следующему процессу.
+ */
+class ISessionTable
+{
+public:
+    virtual ~ISessionTable() = default;
+
+    /**
+     * Создание сеанса в начальном состоянии.
+     *
+     * \return Идентификатор сеанса, либо 0, если таблица заполнена
+     */
+    virtual std::uint64_t Create() = 0;
+
+    /**
+     * Чтение состояния сеанса.
+     *
+     * \param sessionID Идентификатор сеанса
+     * \param state Состояние сеанса
+     * \return true - если сеанс открыт
+     */
+    virtual bool Read(
+        const std::uint64_t sessionID,
+        SessionState& state) const = 0;
+
+    /**
+     * Изменение состояния сеанса.
+     * Функция изменения получает копию текущего состояния и возвращает
+     * true, если изменённую копию нужно сохранить. Копия становится
+     * видна другим процессам целиком после возврата из функции.
+     * Путь длиннее наибольшей глубины таблицы не сохраняется:
+     * бросается std::length_error, а состояние остаётся прежним.
+     *
+     * \param sessionID Идентификатор сеанса
+     * \param change Функция изменения
+     * \return true - если сеанс открыт
+     */
+    virtual bool Update(
+        const std::uint64_t sessionID,
+        const std::function<bool(SessionState&)>& change) = 0;
+
+    /**
+     * Закрытие сеанса.
+     *
+     * \param sessionID Идентификатор сеанса
+     * \return true - если сеанс был открыт
+     */
+    virtual bool Close(
+        const std::uint64_t sessionID) = 0;
+
+    /**
+     * Получение статистики таблицы.
+     *
+     * \return Статистика
+     */
+    virtual SessionTableStats GetStats() const = 0;
+};
+
+/**
+ * Создание таблицы сеансов в разделяемой памяти.
+ * Таблицу нужно создать до порождения процессов, которые будут
+ * с ней работать. Поддерживается только в POSIX-системах.
+ *
+ * \param options Параметры таблицы
+ * \return Таблица сеансов
+ */
+std::shared_ptr<ISessionTable> CreateSharedSessionTable(
+    const SessionTableOptions& options) noexcept(false);
+
+}
@@ -0,0 +1,139 @@
+﻿#pragma once
+
+#include "IExpertSystem.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+
+namespace ES
+{
+
+/**
+ * Параметры кластера шардов.
+ */
+struct ShardClusterOptions
+{
+    // Количество процессов-шардов
+    std::size_t shards = 4;
+    // Количество точек каждого шарда на кольце хешей. Чем их больше,
+    // тем ровнее сеансы распределяются между шардами
+    std::size_t virtualNodes = 128;
+    // Наибольшее количество сеансов, открываемых на одном шарде.
+    // Сеансы, перенесённые при перераспределении, принимаются сверх него
+    std::size_t sessions = 64 * 1024;
+};
+
+/**
+ * Результат перераспределения сеансов между шардами.
+ */
+struct RebalanceReport
+{
+    // Количество шардов до изменения
+    std::size_t before = 0;
+    // Количество шардов после изменения
+    std::size_t after = 0;
+    // Количество открытых сеансов
+    std::size_t sessions = 0;
+    // Количество сеансов, перенесённых на другой шард
+    std::size_t moved = 0;
+    // Количество сеансов, потерянных из-за падения шарда во время переноса
+    std::size_t lost = 0;
+    // Время перераспределения, мс
+    double ms = 0;
+};
+
+/**
+ * Статистика кластера шардов.
+ */
+struct ShardClusterStats
+{
+    // Количество шардов
+    std::size_t shards = 0;
+    // Количество обработанных запросов
+    std::uint64_t requests = 0;
+    // Количество перераспределений
+    std::size_t rebalances = 0;
+    // Количество сеансов, перенесённых при всех перераспределениях
+    std::uint64_t moved = 0;
+    // Количество перезапусков упавших шардов
+    std::size_t restarts = 0;
+    // Количество сеансов, потерянных из-за падения шардов
+    // во время перераспределений
+    std::uint64_t lost = 0;
+};
+
+/**
+ * Интерфейс кластера шардов.
+ * Каждый шард - отдельный процесс со своей частью сеансов, который
+ * получает загруженное дерево копированием страниц при записи.
+ * Маршрутизатор в вызывающем процессе выдаёт идентификаторы сеансов,
+ * определяет шард сеанса согласованным хешированием идентификатора
+ * и пересылает запросы через локальные сокеты. Запросы одного сеанса
+ * попадают в один шард и выполняются по порядку, а запросы разных
+ * шардов - параллельно.
+ *
+ * Формат запросов и ответов совпадает с многопроцессным режимом:
+ * new - открыть сеанс, <сеанс> - текущий узел сеанса,
+ * <сеанс> <ответ> - подать ответ, b - возврат, r - сброс,
+ * close - закрытие. На каждый запрос в том же порядке выводится строка
+ * "статус<TAB>сеанс<TAB>идентификатор узла<TAB>текст узла".
+ * Запрос "shards N" меняет количество шардов, когда выполнены все
+ * предыдущие запросы, и выводит строку
+ * "resharded<TAB>0<TAB>N<TAB>moved X of Y sessions".
+ * Упавший шард перезапускается пустым: его сеансы теряются,
+ * а запросы к ним получают статус unknown.
+ */
+class IShardCluster
+{
+public:
+    virtual ~IShardCluster() = default;
+
+    /**
+     * Обработка всех запросов из входного дескриптора.
+     *
+     * \param input Входной дескриптор
+     * \param output Выходной файл
+     * \return
+     */
+    virtual void Run(
+        const int input,
+        std::FILE* output) = 0;
+
+    /**
+     * Изменение количества шардов. Новые шарды получают номера
+     * после существующих, а удаляются шарды с наибольшими номерами.
+     * На другой шард переносятся только сеансы, владелец которых
+     * на кольце изменился: примерно 1/N сеансов при добавлении шарда
+     * и сеансы удаляемого шарда при удалении.
+     *
+     * \param shards Новое количество шардов, не меньше 1
+     * \return Результат перераспределения
+     */
+    virtual RebalanceReport Resize(
+        const std::size_t shards) = 0;
+
+    /**
+     * Получение статистики кластера.
+     *
+     * \return Статистика
+     */
+    virtual ShardClusterStats GetStats() const = 0;
+};
+
+/**
+ * Создание кластера шардов и запуск процессов-шардов.
+ * Экспертная система должна быть загружена и существовать дольше
+ * кластера: из неё порождаются добавляемые и перезапускаемые шарды.
+ * Поддерживается только в POSIX-системах.
+ *
+ * \param base Загруженная экспертная система
+ * \param options Параметры кластера
+ * \return Кластер шардов
+ */
+std::unique_ptr<IShardCluster> CreateShardCluster(
+    const IExpertSystem& base,
+    const ShardClusterOptions& options) noexcept(false);
+
+}
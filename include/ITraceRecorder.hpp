@@ -0,0 +1,117 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+
+namespace ES
+{
+
+/**
+ * Параметры записи трассы.
+ */
+struct TraceOptions
+{
+    // Каталог, в который пишутся файлы трассы
+    std::string directory;
+    // Размер файла, после которого начинается новый файл
+    std::size_t maxFileBytes = 64 * 1024 * 1024;
+    // Количество хранимых файлов. Самые старые файлы удаляются.
+    // 0 - хранить все файлы
+    std::size_t maxFiles = 0;
+    // Ёмкость кольцевого буфера каждого потока в записях
+    // (округляется вверх до степени двойки)
+    std::size_t ringCapacity = 64 * 1024;
+    // Период сброса буферов в файл в миллисекундах
+    unsigned flushIntervalMs = 100;
+};
+
+/**
+ * Статистика записи трассы.
+ */
+struct TraceStats
+{
+    // Количество записанных в файлы записей
+    std::uint64_t written = 0;
+    // Количество случаев, когда поток ждал освобождения
+    // переполненного кольцевого буфера
+    std::uint64_t stalls = 0;
+    // Количество созданных файлов
+    std::uint64_t files = 0;
+    // Количество потерянных записей: потоку не хватило памяти
+    // под буфер, либо записать их в файл не удалось
+    std::uint64_t dropped = 0;
+};
+
+/**
+ * Интерфейс записи трассы прохождения по дереву.
+ * Каждый шаг сеанса записывается в кольцевой буфер потока
+ * двоичной записью фиксированного размера (идентификатор сеанса,
+ * индекс узла, ответ, время). Фоновый поток сбрасывает буферы
+ * в сменяющиеся файлы.
+ */
+class ITraceRecorder
+{
+public:
+    virtual ~ITraceRecorder() = default;
+
+    /**
+     * Принудительный сброс всех буферов в файл.
+     *
+     * \return
+     */
+    virtual void Flush() = 0;
+
+    /**
+     * Получение статистики записи.
+     *
+     * \return Статистика
+     */
+    virtual TraceStats GetStats() const = 0;
+};
+
+/**
+ * Создание записи трассы.
+ * Запись подключается к экспертной системе методом
+ * IExpertSystem::SetTraceRecorder.
+ *
+ * \param options Параметры записи
+ * \return Запись трассы
+ */
+std::shared_ptr<ITraceRecorder> CreateTraceRecorder(
+    const TraceOptions& options) noexcept(false);
+
+/**
+ * Формат расшифровки трассы.
+ */
+enum class TraceFormat
+{
+    Text,   // Текст: одна строка на шаг
+    Replay  // Последовательности ответов для пакетного режима
+};
+
+/**
+ * Расшифровка трассы.
+ * Записи всех файлов каталога упорядочиваются по сеансам и номерам шагов.
+ * В формате Text выводится строка на каждую запись
+ * "время сеанс индекс узла идентификатор узла ответ статус".
+ * Если задан путь к конфигурации, то строки дополняются текстами
+ * узлов, найденных по идентификаторам.
+ * В формате Replay для каждого прохода сеанса от корня выводится строка
+ * принятых ответов, пригодная для пакетного режима App --batch.
+ *
+ * \param directory Каталог с файлами трассы
+ * \param format Формат расшифровки
+ * \param configPath Путь к конфигурации экспертной системы (может быть пустым)
+ * \param out Поток для вывода
+ * \return Количество расшифрованных записей
+ */
+std::size_t DecodeTrace(
+    const std::string& directory,
+    const TraceFormat format,
+    const std::string& configPath,
+    std::ostream& out) noexcept(false);
+
+}
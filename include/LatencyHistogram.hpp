@@ -0,0 +1,153 @@
+﻿#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(_MSC_VER)
+#   include <intrin.h>
+#endif
+
+namespace ES
+{
+
+/**
+ * Гистограмма задержек.
+ * Значения (обычно наносекунды) раскладываются по логарифмическим
+ * корзинам с восемью подкорзинами на каждую степень двойки,
+ * поэтому погрешность перцентилей не превышает 12.5%.
+ * Запись значения не выделяет память и занимает несколько тактов.
+ * Гистограмма не потокобезопасна: каждый поток ведёт свою,
+ * а затем гистограммы объединяются методом Merge.
+ */
+class LatencyHistogram
+{
+public:
+    /**
+     * Добавление значения.
+     *
+     * \param value Значение
+     * \return
+     */
+    void Add(
+        const std::uint64_t value) noexcept
+    {
+        ++m_buckets[BucketOf(value)];
+        ++m_count;
+        m_sum += value;
+        if (value > m_max) {
+            m_max = value;
+        }
+    }
+
+    /**
+     * Объединение с другой гистограммой.
+     *
+     * \param other Гистограмма, значения которой добавляются к текущей
+     * \return
+     */
+    void Merge(
+        const LatencyHistogram& other) noexcept
+    {
+        for (std::size_t i = 0; i < m_buckets.size(); ++i) {
+            m_buckets[i] += other.m_buckets[i];
+        }
+        m_count += other.m_count;
+        m_sum += other.m_sum;
+        if (other.m_max > m_max) {
+            m_max = other.m_max;
+        }
+    }
+
+    /**
+     * Получение перцентиля.
+     *
+     * \param percentile Перцентиль в диапазоне [0, 100]
+     * \return Верхняя граница корзины, в которую попал перцентиль
+     */
+    std::uint64_t Percentile(
+        const double percentile) const noexcept
+    {
+        if (m_count == 0) {
+            return 0;
+        }
+        // Номер значения, соответствующего перцентилю
+        const auto rank = static_cast<std::uint64_t>(percentile / 100.0 * double(m_count - 1)) + 1;
+        std::uint64_t seen = 0;
+        for (std::size_t i = 0; i < m_buckets.size(); ++i) {
+            seen += m_buckets[i];
+            if (seen >= rank) {
+                const auto upper = UpperBoundOf(i);
+                return upper < m_max ? upper : m_max;
+            }
+        }
+        return m_max;
+    }
+
+    // Количество значений
+    std::uint64_t Count() const noexcept { return m_count; }
+    // Максимальное значение
+    std::uint64_t Max() const noexcept { return m_max; }
+    // Среднее значение
+    double Mean() const noexcept { return m_count ? double(m_sum) / double(m_count) : 0.0; }
+
+private:
+    // Значения меньше 16 хранятся в отдельных корзинах
+    static constexpr std::size_t kLinearBuckets = 16;
+
+    /**
+     * Номер старшего единичного бита ненулевого значения.
+     */
+    static std::size_t HighestBit(
+        const std::uint64_t value) noexcept
+    {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanReverse64(&index, value);
+        return index;
+#else
+        return static_cast<std::size_t>(63 - __builtin_clzll(value));
+#endif
+    }
+
+    /**
+     * Номер корзины для значения.
+     */
+    static std::size_t BucketOf(
+        const std::uint64_t value) noexcept
+    {
+        if (value < kLinearBuckets) {
+            return static_cast<std::size_t>(value);
+        }
+        // Номер старшего бита (не меньше 4)
+        const auto log = HighestBit(value);
+        // Три бита после старшего задают подкорзину
+        const auto mantissa = static_cast<std::size_t>((value >> (log - 3)) & 7);
+        return kLinearBuckets + (log - 4) * 8 + mantissa;
+    }
+
+    /**
+     * Верхняя граница значений корзины.
+     */
+    static std::uint64_t UpperBoundOf(
+        const std::size_t bucket) noexcept
+    {
+        if (bucket < kLinearBuckets) {
+            return bucket;
+        }
+        const auto log = (bucket - kLinearBuckets) / 8 + 4;
+        const auto mantissa = (bucket - kLinearBuckets) % 8;
+        return ((std::uint64_t(8 | mantissa) + 1) << (log - 3)) - 1;
+    }
+
+    // Корзины
+    std::array<std::uint64_t, kLinearBuckets + 60 * 8> m_buckets{};
+    // Количество значений
+    std::uint64_t m_count = 0;
+    // Сумма значений
+    std::uint64_t m_sum = 0;
+    // Максимальное значение
+    std::uint64_t m_max = 0;
+};
+
+}
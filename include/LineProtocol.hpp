@@ -0,0 +1,135 @@
+﻿#pragma once
+
+#include "IExpertSystem.hpp"
+
+#include <charconv>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+
+namespace ES
+{
+
+/**
+ * Строчный протокол многопроцессного режима и кластера шардов.
+ * Запрос - строка "сеанс команда", ответ - строка
+ * "статус<TAB>сеанс<TAB>идентификатор узла<TAB>текст узла".
+ */
+
+/**
+ * Команда сеанса.
+ */
+struct SessionCommand
+{
+    /**
+     * Вид команды.
+     */
+    enum class Kind
+    {
+        // Пустая команда: показать текущий узел
+        Show,
+        // Ответ на вопрос
+        Answer,
+        // b - возврат к предыдущему вопросу
+        Back,
+        // r - сброс сеанса
+        Reset,
+        // close - закрытие сеанса
+        Close,
+        // Нераспознанная команда
+        Invalid
+    };
+
+    // Вид команды
+    Kind kind = Kind::Invalid;
+    // Ответ для Kind::Answer
+    int answer = 0;
+};
+
+/**
+ * Чтение числа с начала строки.
+ *
+ * \param line Строка, из которой число удаляется вместе с пробелами за ним
+ * \param value Число
+ * \return true - если число прочитано
+ */
+template<typename T>
+bool ParseNumber(
+    std::string_view& line,
+    T& value) noexcept
+{
+    const auto [end, error] = std::from_chars(line.data(), line.data() + line.size(), value);
+    if (error != std::errc()) {
+        return false;
+    }
+    line.remove_prefix(static_cast<std::size_t>(end - line.data()));
+    while (!line.empty() && (line.front() == ' ' || line.front() == '\t')) {
+        line.remove_prefix(1);
+    }
+    return true;
+}
+
+/**
+ * Разбор команды сеанса.
+ *
+ * \param command Команда без идентификатора сеанса
+ * \return Команда
+ */
+SessionCommand ParseCommand(
+    const std::string_view command) noexcept;
+
+/**
+ * Добавление числа к строке.
+ *
+ * \param output Строка
+ * \param value Число
+ * \return
+ */
+void AppendNumber(
+    std::string& output,
+    const std::int64_t value);
+
+/**
+ * Добавление ответа "статус<TAB>сеанс<TAB>идентификатор узла<TAB>текст узла".
+ * Переводы строк в тексте узла заменяются пробелами.
+ *
+ * \param output Буфер ответов
+ * \param status Статус, либо nullptr для статуса по текущему узлу
+ * \param sessionID Идентификатор сеанса
+ * \param system Сеанс, либо nullptr, если сеанса нет
+ * \return
+ */
+void AppendReply(
+    std::string& output,
+    const char* status,
+    const std::uint64_t sessionID,
+    const IExpertSystem* system);
+
+/**
+ * Запись всех данных в сокет или файл.
+ * Сокет пишется без SIGPIPE, чтобы падение другой стороны
+ * не завершало процесс.
+ *
+ * \param fd Дескриптор
+ * \param data Данные
+ * \return true - если данные записаны
+ */
+bool WriteAll(
+    const int fd,
+    std::string_view data) noexcept;
+
+/**
+ * Обработка строк запросов из сокета до его закрытия.
+ * Ответы на прочитанный блок запросов отправляются одной записью.
+ *
+ * \param fd Сокет
+ * \param handle Обработчик строки запроса без перевода строки,
+ * дописывающий ответ в буфер
+ * \return
+ */
+void ServeLines(
+    const int fd,
+    const std::function<void(std::string_view, std::string&)>& handle);
+
+}
@@ -0,0 +1,74 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace ES
+{
+
+/**
+ * Параметры построения дерева по размеченным данным.
+ */
+struct LearnerOptions
+{
+    // Название экспертной системы. Если пусто, то имя файла данных
+    std::string name;
+    // Столбец с ответом (диагнозом). Если пусто, то последний столбец
+    std::string labelColumn;
+    // Наибольшая глубина дерева в вопросах
+    std::size_t maxDepth = 16;
+    // Наименьшее количество строк в ветви, ради которой задаётся вопрос
+    std::size_t minRows = 2;
+    // Количество интервалов, на которые делятся числовые столбцы
+    std::size_t bins = 8;
+    // Наибольшее количество значений категориального столбца.
+    // Редкие значения объединяются в одно
+    std::size_t maxCategories = 32;
+    // Количество потоков поиска разбиения. 0 - по числу ядер
+    std::size_t threads = 0;
+};
+
+/**
+ * Результат построения дерева.
+ */
+struct LearnerStats
+{
+    // Количество строк данных
+    std::size_t rows = 0;
+    // Количество признаков (столбцов без ответа)
+    std::size_t features = 0;
+    // Количество вопросов в построенном дереве
+    std::size_t questions = 0;
+    // Количество ответов в построенном дереве
+    std::size_t answers = 0;
+    // Глубина построенного дерева в вопросах
+    std::size_t depth = 0;
+    // Доля строк данных, для которых дерево даёт верный ответ
+    double accuracy = 0;
+};
+
+/**
+ * Построение дерева вопросов по размеченным данным (ID3/C4.5).
+ * Данные читаются из CSV-файла с заголовком (разделитель - запятая
+ * или точка с запятой) в два прохода: на первом определяются типы
+ * столбцов и границы интервалов, на втором каждый столбец кодируется
+ * байтом на строку. Поэтому память занимает около байта на ячейку
+ * и восьми байтов на строку независимо от длины текста файла.
+ * Разбиение ищется по гистограммам значений, признаки узла
+ * оцениваются параллельно. Вопрос узла имеет по ветви на каждое
+ * встретившееся значение признака, ответ кодируется номером значения,
+ * перечисленным в тексте вопроса.
+ * Результат записывается в конфигурацию, загружаемую IExpertSystem::Load.
+ *
+ * \param dataPath Путь к CSV-файлу
+ * \param configPath Путь к создаваемому файлу конфигурации
+ * \param options Параметры построения
+ * \return Результат построения
+ */
+LearnerStats LearnTree(
+    const std::string& dataPath,
+    const std::string& configPath,
+    const LearnerOptions& options) noexcept(false);
+
+}
@@ -0,0 +1,80 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace ES
+{
+
+/**
+ * Параметры перестройки дерева.
+ */
+struct OptimizerOptions
+{
+    // Название экспертной системы. Если пусто, то исходное
+    std::string name;
+    // Файл частот ответов: строки "идентификатор_ответа частота",
+    // строки с # - комментарии
+    std::string priorsPath;
+    // Каталог трассы сеансов, по которой считаются частоты ответов
+    std::string traceDirectory;
+    // Добавка к частоте каждого ответа, чтобы ответы без наблюдений
+    // не уходили в самый низ дерева. Без частот все ответы равновероятны
+    double smoothing = 1;
+    // Наибольшее количество путей в поддереве, порядок вопросов которого
+    // подбирается точным перебором (не больше 24)
+    std::size_t exactLimit = 12;
+    // Во сколько раз может вырасти количество путей из-за повторения
+    // вопросов в разных ветвях. 1 - вопросы не повторяются
+    double maxGrowth = 2;
+    // Наибольшее количество путей от корня до ответов в исходном дереве
+    std::size_t maxPaths = std::size_t(1) << 22;
+};
+
+/**
+ * Результат перестройки дерева.
+ */
+struct OptimizerStats
+{
+    // Количество путей от корня до ответов в исходном дереве
+    std::size_t paths = 0;
+    // Количество достижимых ответов
+    std::size_t answers = 0;
+    // Количество вопросов в исходном и в перестроенном дереве
+    std::size_t questionsBefore = 0;
+    std::size_t questionsAfter = 0;
+    // Ожидаемое количество вопросов за сеанс
+    double expectedDepthBefore = 0;
+    double expectedDepthAfter = 0;
+    // Наибольшее количество вопросов за сеанс
+    std::size_t maxDepthBefore = 0;
+    std::size_t maxDepthAfter = 0;
+    // Количество поддеревьев, построенных точным перебором
+    std::size_t exactSubtrees = 0;
+};
+
+/**
+ * Перестройка дерева для уменьшения ожидаемого количества вопросов.
+ * Каждый путь от корня до ответа исходного дерева - правило: набор
+ * ответов на вопросы, приводящий к ответу. Дерево строится заново
+ * сверху вниз: в узле задаётся вопрос с наибольшим приростом
+ * информации по весам правил, а поддеревья с небольшим количеством
+ * правил строятся точным перебором с запоминанием. Вопрос, на который
+ * правило не отвечает, копирует правило во все ветви, поэтому дерево
+ * может вырасти не больше чем в maxGrowth раз. При любых ответах
+ * на вопросы перестроенное дерево приводит к тому же ответу,
+ * что и исходное. Повторно заданный вопрос получает новый
+ * идентификатор, ответы сохраняют свои.
+ * Результат записывается в конфигурацию, загружаемую IExpertSystem::Load.
+ *
+ * \param configPath Путь к исходной конфигурации
+ * \param outputPath Путь к создаваемому файлу конфигурации
+ * \param options Параметры перестройки
+ * \return Результат перестройки
+ */
+OptimizerStats OptimizeTree(
+    const std::string& configPath,
+    const std::string& outputPath,
+    const OptimizerOptions& options) noexcept(false);
+
+}
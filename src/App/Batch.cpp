@@ -0,0 +1,543 @@
+﻿#include "Batch.hpp"
+
+#include "IExpertSystem.hpp"
+#include "LatencyHistogram.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+// Размер блока входных данных, обрабатываемого за один раз
+constexpr std::size_t kChunkSize = 16 * 1024 * 1024;
+// Минимальное количество сеансов на поток
+constexpr std::size_t kMinSessionsPerThread = 1024;
+
+/**
+ * Статистика обработчика.
+ */
+struct WorkerStats
+{
+    // Задержки сеансов в наносекундах
+    ES::LatencyHistogram latency;
+    // Количество поданных ответов
+    std::size_t answers = 0;
+    // Количество ответов, действительно поданных в сеанс.
+    // Меньше answers, если общие начала последовательностей проходятся один раз
+    std::size_t evaluated = 0;
+    // Количество сеансов, дошедших до ответа
+    std::size_t finished = 0;
+    // Количество сеансов с непринятым ответом
+    std::size_t rejected = 0;
+};
+
+/**
+ * Разобранная последовательность ответов.
+ */
+struct Sequence
+{
+    // Первые ответы, упакованные в 64 бита, - ключ упорядочивания,
+    // сравниваемый раньше самих ответов
+    std::uint64_t key = 0;
+    // Начало в общем массиве ответов
+    std::size_t begin = 0;
+    // Количество ответов
+    std::size_t size = 0;
+    // Номер строки среди строк обработчика
+    std::size_t line = 0;
+};
+
+/**
+ * Обработчик части блока входных данных.
+ * Каждый обработчик владеет собственным сеансом
+ * и собственным буфером результатов.
+ */
+struct Worker
+{
+    // Загруженная экспертная система, из которой создаётся сеанс
+    const ES::IExpertSystem* base = nullptr;
+    // Сеанс экспертной системы
+    std::unique_ptr<ES::IExpertSystem> session;
+    // Результаты обработки строк
+    std::string output;
+    // Статистика
+    WorkerStats stats;
+    // Ответы разобранных последовательностей подряд
+    std::vector<int> values;
+    // Разобранные последовательности
+    std::vector<Sequence> sequences;
+    // Результаты строк в порядке обработки и их отрезки по номерам строк
+    std::string results;
+    std::vector<std::pair<std::size_t, std::size_t>> slices;
+
+    /**
+     * Обработка строк.
+     *
+     * \param begin Первая строка
+     * \param end Строка, следующая за последней
+     * \param share Проходить общие начала последовательностей один раз
+     * \return
+     */
+    void Process(
+        const std::string_view* begin,
+        const std::string_view* end,
+        const bool share)
+    {
+        output.clear();
+        // Сеанс создаётся в рабочем потоке, чтобы при репликации
+        // получить копию дерева, локальную для процессора потока
+        if (!session) {
+            session = base->CreateSession();
+        }
+        if (share) {
+            ProcessShared(begin, end);
+            return;
+        }
+        for (auto line = begin; line != end; ++line) {
+            const auto start = std::chrono::steady_clock::now();
+            const char* status = Replay(*line);
+            Complete(status, start, &output);
+        }
+    }
+
+    /**
+     * Обработка строк с общим проходом начал последовательностей.
+     * Последовательности упорядочиваются, поэтому последовательности
+     * с общим началом идут подряд: сеанс возвращается к месту, где
+     * очередная последовательность расходится с предыдущей, и подаёт
+     * только остаток. Строки с возвратами и с нечисловыми ответами
+     * проигрываются отдельно с начала.
+     *
+     * \param begin Первая строка
+     * \param end Строка, следующая за последней
+     * \return
+     */
+    void ProcessShared(
+        const std::string_view* begin,
+        const std::string_view* end)
+    {
+        const auto count = static_cast<std::size_t>(end - begin);
+        values.clear();
+        sequences.clear();
+        results.clear();
+        slices.assign(count, { 0, 0 });
+        for (std::size_t line = 0; line < count; ++line) {
+            const auto first = values.size();
+            if (Parse(begin[line])) {
+                sequences.push_back({ 0, first, values.size() - first, line });
+                continue;
+            }
+            values.resize(first);
+            const auto start = std::chrono::steady_clock::now();
+            const char* status = Replay(begin[line]);
+            const auto offset = results.size();
+            Complete(status, start, &results);
+            slices[line] = { offset, results.size() - offset };
+        }
+        // Ответы ключа кодируются от 1 наименьшими битами, достаточными
+        // для всех ответов блока, 0 - конец последовательности.
+        // Тогда порядок ключей совпадает с порядком самих ответов
+        // и короткие последовательности сравниваются без обращения к ним
+        std::size_t width = 0;
+        if (!values.empty()) {
+            const auto [low, high] = std::minmax_element(values.begin(), values.end());
+            const auto codes = static_cast<std::uint64_t>(std::int64_t(*high) - *low) + 2;
+            unsigned bits = 1;
+            while ((std::uint64_t(1) << bits) < codes) {
+                ++bits;
+            }
+            width = 64 / bits;
+            for (auto& sequence : sequences) {
+                for (std::size_t i = 0; i < width; ++i) {
+                    const auto code = i < sequence.size
+                        ? static_cast<std::uint64_t>(std::int64_t(values[sequence.begin + i]) - *low) + 1 : 0;
+                    sequence.key = (sequence.key << bits) | code;
+                }
+            }
+        }
+        std::sort(sequences.begin(), sequences.end(),
+            [&values = values, width](const Sequence& a, const Sequence& b)
+            {
+                // Последовательности, целиком уместившиеся в ключ, равны при равных ключах
+                if (a.key != b.key || (a.size <= width && b.size <= width)) {
+                    return a.key < b.key;
+                }
+                return std::lexicographical_compare(
+                    values.begin() + static_cast<std::ptrdiff_t>(a.begin),
+                    values.begin() + static_cast<std::ptrdiff_t>(a.begin + a.size),
+                    values.begin() + static_cast<std::ptrdiff_t>(b.begin),
+                    values.begin() + static_cast<std::ptrdiff_t>(b.begin + b.size));
+            });
+        session->Reset();
+        const Sequence* previous = nullptr;
+        for (const auto& sequence : sequences) {
+            const auto start = std::chrono::steady_clock::now();
+            const int* answers = values.data() + sequence.begin;
+            // Все ответы сеанса - принятое начало предыдущей последовательности
+            std::size_t depth = 0;
+            bool same = false;
+            if (previous) {
+                const int* shared = values.data() + previous->begin;
+                const auto limit = std::min(sequence.size, session->GetDepth());
+                while (depth < limit && answers[depth] == shared[depth]) {
+                    ++depth;
+                }
+                same = sequence.size == previous->size
+                    && std::equal(answers + depth, answers + sequence.size, shared + depth);
+                if (depth < session->GetDepth()) {
+                    session->BackTo(depth);
+                }
+            }
+            stats.answers += depth;
+            const char* status = Continue(answers, sequence.size, depth);
+            if (same) {
+                // Повторяющаяся последовательность - та же строка результата
+                Complete(status, start, nullptr);
+                slices[sequence.line] = slices[previous->line];
+            }
+            else {
+                const auto offset = results.size();
+                Complete(status, start, &results);
+                slices[sequence.line] = { offset, results.size() - offset };
+            }
+            previous = &sequence;
+        }
+        // Результаты выводятся в порядке входных строк
+        for (const auto& [offset, size] : slices) {
+            output.append(results, offset, size);
+        }
+    }
+
+    /**
+     * Учёт задержки сеанса и запись строки результата.
+     *
+     * \param status Статус сеанса
+     * \param start Время начала сеанса
+     * \param target Буфер результатов, либо nullptr, если строка
+     * результата уже записана
+     * \return
+     */
+    void Complete(
+        const char* status,
+        const std::chrono::steady_clock::time_point start,
+        std::string* target)
+    {
+        const auto finish = std::chrono::steady_clock::now();
+        stats.latency.Add(static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(finish - start).count()));
+        if (!target) {
+            return;
+        }
+        // Формируем строку результата
+        char id[16];
+        const auto idEnd = std::to_chars(id, id + sizeof(id), session->GetCurrentID()).ptr;
+        target->append(status).push_back('\t');
+        target->append(id, idEnd).push_back('\t');
+        target->append(session->GetCurrentData()).push_back('\n');
+    }
+
+    /**
+     * Разбор последовательности ответов в массив values.
+     *
+     * \param line Последовательность ответов
+     * \return false - если в строке есть возврат или нечисловой ответ
+     */
+    bool Parse(
+        std::string_view line)
+    {
+        const char* it = line.data();
+        const char* end = it + line.size();
+        while (true) {
+            while (it != end && (*it == ' ' || *it == '\t' || *it == ',' || *it == '\r')) {
+                ++it;
+            }
+            if (it == end) {
+                return true;
+            }
+            int value = 0;
+            const auto [next, error] = std::from_chars(it, end, value);
+            if (error != std::errc()) {
+                return false;
+            }
+            values.push_back(value);
+            it = next;
+        }
+    }
+
+    /**
+     * Продолжение сеанса с заданного ответа последовательности.
+     *
+     * \param answers Ответы последовательности
+     * \param size Количество ответов
+     * \param depth Количество уже принятых ответов
+     * \return Статус сеанса
+     */
+    const char* Continue(
+        const int* answers,
+        const std::size_t size,
+        std::size_t depth)
+    {
+        for (; !session->IsFinished(); ++depth) {
+            if (depth == size) {
+                return "unfinished";
+            }
+            ++stats.answers;
+            ++stats.evaluated;
+            if (!session->SetAnswer(answers[depth])) {
+                ++stats.rejected;
+                return "rejected";
+            }
+        }
+        ++stats.finished;
+        return "ok";
+    }
+
+    /**
+     * Проигрывание одного сеанса.
+     *
+     * \param line Последовательность ответов
+     * \return Статус сеанса
+     */
+    const char* Replay(
+        std::string_view line)
+    {
+        session->Reset();
+        const char* it = line.data();
+        const char* end = it + line.size();
+        while (!session->IsFinished()) {
+            // Пропускаем разделители
+            while (it != end && (*it == ' ' || *it == '\t' || *it == ',' || *it == '\r')) {
+                ++it;
+            }
+            if (it == end) {
+                return "unfinished";
+            }
+            // b - возврат к предыдущему вопросу
+            if (*it == 'b') {
+                session->Back();
+                ++it;
+                continue;
+            }
+            int value = 0;
+            const auto [next, error] = std::from_chars(it, end, value);
+            ++stats.answers;
+            ++stats.evaluated;
+            if (error != std::errc() || !session->SetAnswer(value)) {
+                ++stats.rejected;
+                return "rejected";
+            }
+            it = next;
+        }
+        ++stats.finished;
+        return "ok";
+    }
+};
+
+/**
+ * Обёртка над FILE*, закрывающая файл при разрушении.
+ */
+struct FileCloser
+{
+    void operator()(std::FILE* file) const noexcept
+    {
+        if (file != stdin && file != stdout) {
+            std::fclose(file);
+        }
+    }
+};
+using file_ptr_t = std::unique_ptr<std::FILE, FileCloser>;
+
+/**
+ * Открытие файла либо стандартного потока.
+ *
+ * \param path Путь к файлу. Пустой путь означает стандартный поток
+ * \param mode Режим открытия
+ * \param standard Стандартный поток
+ * \return Открытый файл
+ */
+file_ptr_t OpenFile(
+    const std::string& path,
+    const char* mode,
+    std::FILE* standard)
+{
+    std::FILE* file = path.empty() ? standard : std::fopen(path.c_str(), mode);
+    if (!file) {
+        throw std::runtime_error(u8"Не удалось открыть " + path);
+    }
+    return file_ptr_t(file);
+}
+
+/**
+ * Разбиение блока на строки.
+ *
+ * \param data Блок, заканчивающийся полной строкой
+ * \param lines Строки блока
+ * \return
+ */
+void SplitLines(
+    std::string_view data,
+    std::vector<std::string_view>& lines)
+{
+    lines.clear();
+    while (!data.empty()) {
+        const auto end = data.find('\n');
+        if (end == std::string_view::npos) {
+            lines.push_back(data);
+            break;
+        }
+        lines.push_back(data.substr(0, end));
+        data.remove_prefix(end + 1);
+    }
+}
+
+}
+
+/**
+ * Запуск экспертной системы в пакетном режиме.
+ * Входные данные читаются крупными блоками, строки блока
+ * делятся между потоками поровну, каждый поток работает со своим
+ * сеансом, разделяющим дерево с остальными. Результаты блока
+ * записываются одним вызовом в порядке входных строк.
+ *
+ * \param options Параметры пакетного режима
+ * \return Код завершения
+ */
+int RunBatch(
+    const BatchOptions& options)
+{
+    // Загружаем экспертную систему один раз
+    auto es = ES::CreateExpertSystem();
+    es->SetReplication(options.replication);
+    es->SetTextCompression(options.textCompression);
+    es->Load(options.configPath);
+    // Сеансы обработчиков наследуют язык текстов
+    if (!options.language.empty()) {
+        es = es->CreateSession(options.language);
+    }
+    // Подключаем запись трассы. Сеансы обработчиков наследуют её
+    std::shared_ptr<ES::ITraceRecorder> recorder;
+    if (!options.traceDirectory.empty()) {
+        ES::TraceOptions traceOptions;
+        traceOptions.directory = options.traceDirectory;
+        recorder = ES::CreateTraceRecorder(traceOptions);
+        es->SetTraceRecorder(recorder);
+    }
+
+    auto input = OpenFile(options.inputPath, "rb", stdin);
+    auto output = OpenFile(options.outputPath, "wb", stdout);
+
+    // Создаём обработчики
+    const std::size_t threads = options.threads ? options.threads : 1;
+    std::vector<Worker> workers(threads);
+    for (auto& worker : workers) {
+        worker.base = es.get();
+    }
+
+    std::string buffer;
+    std::vector<std::string_view> lines;
+    std::vector<std::thread> pool;
+    std::size_t sessions = 0;
+
+    const auto start = std::chrono::steady_clock::now();
+    // Незавершённая строка, оставшаяся от предыдущего блока
+    std::size_t carry = 0;
+    bool eof = false;
+    while (!eof) {
+        // Дочитываем блок после незавершённой строки
+        buffer.resize(carry + kChunkSize);
+        const auto read = std::fread(buffer.data() + carry, 1, kChunkSize, input.get());
+        buffer.resize(carry + read);
+        eof = read < kChunkSize;
+        // Обрабатываем только полные строки, остаток переносим в следующий блок
+        auto complete = eof ? buffer.size() : buffer.rfind('\n') + 1;
+        if (complete == 0 && !eof) {
+            // Строка длиннее блока - продолжаем чтение
+            carry = buffer.size();
+            continue;
+        }
+        SplitLines(std::string_view(buffer.data(), complete), lines);
+        sessions += lines.size();
+
+        // Делим строки между потоками
+        const std::size_t used = std::max<std::size_t>(1,
+            std::min(threads, lines.size() / kMinSessionsPerThread));
+        const std::size_t perWorker = (lines.size() + used - 1) / used;
+        pool.clear();
+        for (std::size_t i = 0; i < used; ++i) {
+            const auto first = std::min(lines.size(), i * perWorker);
+            const auto last = std::min(lines.size(), first + perWorker);
+            auto process = [&worker = workers[i], begin = lines.data() + first, end = lines.data() + last,
+                share = options.sharePrefixes]
+            {
+                worker.Process(begin, end, share);
+            };
+            if (i + 1 == used) {
+                process();
+            }
+            else {
+                pool.emplace_back(process);
+            }
+        }
+        for (auto& thread : pool) {
+            thread.join();
+        }
+        // Пишем результаты в порядке входных строк
+        for (std::size_t i = 0; i < used; ++i) {
+            std::fwrite(workers[i].output.data(), 1, workers[i].output.size(), output.get());
+        }
+        // Переносим незавершённую строку в начало буфера
+        carry = buffer.size() - complete;
+        buffer.erase(0, complete);
+    }
+    std::fflush(output.get());
+    const auto finish = std::chrono::steady_clock::now();
+    if (recorder) {
+        recorder->Flush();
+        const auto traceStats = recorder->GetStats();
+        std::fprintf(stderr, "trace: %llu records, %llu files, %llu stalls, %llu dropped\n",
+            static_cast<unsigned long long>(traceStats.written),
+            static_cast<unsigned long long>(traceStats.files),
+            static_cast<unsigned long long>(traceStats.stalls),
+            static_cast<unsigned long long>(traceStats.dropped));
+    }
+
+    // Сводка
+    WorkerStats total;
+    for (const auto& worker : workers) {
+        total.latency.Merge(worker.stats.latency);
+        total.answers += worker.stats.answers;
+        total.evaluated += worker.stats.evaluated;
+        total.finished += worker.stats.finished;
+        total.rejected += worker.stats.rejected;
+    }
+    const double seconds = std::chrono::duration<double>(finish - start).count();
+    std::fprintf(stderr,
+        "batch: %zu sessions, %zu answers, %zu threads, %zu replicas\n"
+        "  wall: %.3f s, %.0f sessions/s, %.0f answers/s\n"
+        "  ok: %zu, rejected: %zu, unfinished: %zu\n"
+        "  latency ns: mean %.0f, p50 %llu, p90 %llu, p99 %llu, p99.9 %llu, max %llu\n",
+        sessions, total.answers, threads, es->GetReplicasCount(),
+        seconds, double(sessions) / seconds, double(total.answers) / seconds,
+        total.finished, total.rejected, sessions - total.finished - total.rejected,
+        total.latency.Mean(),
+        static_cast<unsigned long long>(total.latency.Percentile(50)),
+        static_cast<unsigned long long>(total.latency.Percentile(90)),
+        static_cast<unsigned long long>(total.latency.Percentile(99)),
+        static_cast<unsigned long long>(total.latency.Percentile(99.9)),
+        static_cast<unsigned long long>(total.latency.Max()));
+    if (options.sharePrefixes) {
+        std::fprintf(stderr, "  shared prefixes: %zu of %zu answers evaluated, dedup %.1f%%\n",
+            total.evaluated, total.answers,
+            total.answers ? 100.0 * double(total.answers - total.evaluated) / double(total.answers) : 0.0);
+    }
+    return EXIT_SUCCESS;
+}
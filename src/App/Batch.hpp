@@ -0,0 +1,56 @@
+﻿#pragma once
+
+#include "IExpertSystem.hpp"
+
+#include <cstddef>
+#include <string>
+
+/**
+ * Параметры пакетного режима.
+ */
+struct BatchOptions
+{
+    // Путь к файлу конфигурации экспертной системы
+    std::string configPath;
+    // Путь к файлу с последовательностями ответов.
+    // Если путь пустой, то последовательности читаются из стандартного ввода
+    std::string inputPath;
+    // Путь к файлу результатов.
+    // Если путь пустой, то результаты пишутся в стандартный вывод
+    std::string outputPath;
+    // Количество потоков
+    std::size_t threads = 1;
+    // Каталог для записи трассы сеансов.
+    // Если путь пустой, то трасса не записывается
+    std::string traceDirectory;
+    // Репликация дерева по NUMA-узлам или группам процессоров
+    ES::ReplicationOptions replication;
+    // Хранение текстов узлов в сжатом виде
+    ES::TextCompressionOptions textCompression;
+    // Код языка текстов, либо пустая строка для основного языка
+    std::string language;
+    // Проходить общие начала последовательностей ответов один раз
+    bool sharePrefixes = false;
+};
+
+/**
+ * Запуск экспертной системы в пакетном режиме.
+ * Каждая строка входных данных - это отдельный сеанс:
+ * последовательность ответов, разделённых пробелами.
+ * Вместо ответа можно указать b - возврат к предыдущему вопросу.
+ * Для каждого сеанса в том же порядке выводится строка
+ * "статус<TAB>идентификатор узла<TAB>текст узла", где статус:
+ * ok - сеанс дошёл до ответа,
+ * rejected - один из ответов не был принят,
+ * unfinished - ответы закончились раньше, чем был получен ответ.
+ * При sharePrefixes последовательности каждого потока упорядочиваются,
+ * и сеанс не сбрасывается между ними, а возвращается к месту,
+ * где очередная последовательность расходится с предыдущей.
+ * По завершении в стандартный поток ошибок выводится сводка
+ * пропускной способности и задержек.
+ *
+ * \param options Параметры пакетного режима
+ * \return Код завершения
+ */
+int RunBatch(
+    const BatchOptions& options);
@@ -0,0 +1,570 @@
+﻿#include "Prefork.hpp"
+
+#include "ILogger.hpp"
+#include "ISessionTable.hpp"
+#include "LineProtocol.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace
+{
+
+// Наибольшее количество запросов, отправленных обработчику без ответа
+constexpr std::size_t kMaxInFlight = 64;
+// Размер блока чтения
+constexpr std::size_t kReadSize = 64 * 1024;
+
+/**
+ * Запрос к сеансу.
+ */
+struct Request
+{
+    // Номер запроса, он же порядок вывода ответа
+    std::uint64_t sequence = 0;
+    // Идентификатор сеанса
+    std::uint64_t session = 0;
+    // Команда: пусто, ответ, b, r или close
+    std::string command;
+};
+
+/**
+ * Процесс-обработчик с точки зрения родителя.
+ */
+struct WorkerProcess
+{
+    // Идентификатор процесса
+    pid_t pid = -1;
+    // Сокет связи с обработчиком
+    int fd = -1;
+    // Непрочитанный остаток ответов
+    std::string input;
+    // Отправленные запросы без ответа
+    std::vector<Request> inFlight;
+};
+
+/**
+ * Обработчик запросов. Работает в дочернем процессе
+ * с собственным сеансом, состояние которого перед запросом
+ * восстанавливается из таблицы сеансов, если сеанс обработчика
+ * ещё не находится в этом состоянии.
+ */
+class Worker
+{
+public:
+    Worker(
+        const ES::IExpertSystem& base,
+        ES::ISessionTable& table):
+        m_session(base.CreateSession()),
+        m_table(table),
+        m_maxDepth(table.GetStats().maxDepth)
+    {
+    }
+
+    /**
+     * Обработка запросов из сокета до его закрытия.
+     *
+     * \param fd Сокет связи с родителем
+     * \return
+     */
+    void Run(
+        const int fd)
+    {
+        ES::ServeLines(fd, [this](std::string_view line, std::string& output) { Handle(line, output); });
+    }
+
+private:
+    /**
+     * Обработка одного запроса "номер сеанс команда".
+     *
+     * \param line Запрос
+     * \param output Буфер ответов
+     * \return
+     */
+    void Handle(
+        std::string_view line,
+        std::string& output)
+    {
+        std::uint64_t sequence = 0;
+        std::uint64_t sessionID = 0;
+        ES::ParseNumber(line, sequence);
+        ES::ParseNumber(line, sessionID);
+        const auto command = ES::ParseCommand(line);
+        const char* status = nullptr;
+        if (command.kind == ES::SessionCommand::Kind::Close) {
+            status = m_table.Close(sessionID) ? "closed" : "unknown";
+        }
+        else if (!m_table.Update(sessionID, [&](ES::SessionState& state) {
+                Restore(sessionID, state);
+                // Запрос уже применён обработчиком, упавшим до ответа
+                if (state.sequence >= sequence) {
+                    return false;
+                }
+                state.sequence = sequence;
+                m_sequence = sequence;
+                status = Apply(command, state);
+                return true;
+            })) {
+            status = "unknown";
+        }
+        const bool found = !status || (std::strcmp(status, "closed") != 0 && std::strcmp(status, "unknown") != 0);
+        ES::AppendNumber(output, static_cast<std::int64_t>(sequence));
+        output.push_back('\t');
+        ES::AppendReply(output, status, sessionID, found ? m_session.get() : nullptr);
+    }
+
+    /**
+     * Восстановление сеанса одним проходом по пути.
+     * Сеанс, последнее изменение которого сделал этот же обработчик,
+     * уже находится в нужном состоянии, поэтому путь не проходится.
+     *
+     * \param sessionID Идентификатор сеанса
+     * \param state Состояние сеанса
+     * \return
+     */
+    void Restore(
+        const std::uint64_t sessionID,
+        ES::SessionState& state)
+    {
+        if (m_sessionID == sessionID && m_sequence == state.sequence) {
+            return;
+        }
+        // Путь записан по тому же дереву, поэтому проходится целиком
+        if (!m_session->RestorePath(state.path)) {
+            state.path.resize(m_session->GetDepth());
+        }
+        m_sessionID = sessionID;
+        m_sequence = state.sequence;
+    }
+
+    /**
+     * Применение команды к восстановленному сеансу.
+     *
+     * \param command Команда
+     * \param state Состояние сеанса
+     * \return Статус непринятой команды, либо nullptr
+     */
+    const char* Apply(
+        const ES::SessionCommand& command,
+        ES::SessionState& state)
+    {
+        switch (command.kind) {
+        case ES::SessionCommand::Kind::Show:
+            return nullptr;
+        case ES::SessionCommand::Kind::Back:
+            if (!state.path.empty() && m_session->Back()) {
+                state.path.pop_back();
+            }
+            return nullptr;
+        case ES::SessionCommand::Kind::Reset:
+            m_session->Reset();
+            state.path.clear();
+            return nullptr;
+        case ES::SessionCommand::Kind::Answer:
+            // Путь длиннее места в ячейке таблицы не сохранить
+            if (state.path.size() == m_maxDepth && !m_session->IsFinished()) {
+                return "deep";
+            }
+            if (!m_session->SetAnswer(command.answer)) {
+                return "rejected";
+            }
+            state.path.push_back(m_session->GetCurrentID());
+            return nullptr;
+        default:
+            return "rejected";
+        }
+    }
+
+    // Сеанс обработчика
+    std::unique_ptr<ES::IExpertSystem> m_session;
+    // Таблица сеансов
+    ES::ISessionTable& m_table;
+    // Наибольшая глубина пути сеанса в таблице
+    std::size_t m_maxDepth;
+    // Сеанс таблицы, в состоянии которого находится m_session,
+    // и номер последнего применённого к нему запроса
+    std::uint64_t m_sessionID = 0;
+    std::uint64_t m_sequence = 0;
+};
+
+/**
+ * Родительский процесс: раздаёт запросы обработчикам
+ * и выводит ответы в порядке запросов.
+ */
+class Dispatcher
+{
+public:
+    Dispatcher(
+        const ES::IExpertSystem& base,
+        ES::ISessionTable& table,
+        const std::size_t workers):
+        m_base(base),
+        m_table(table),
+        m_workers(workers)
+    {
+        for (std::size_t i = 0; i < m_workers.size(); ++i) {
+            Spawn(i);
+        }
+    }
+
+    /**
+     * Обработка всех запросов из входного дескриптора.
+     *
+     * \param input Входной дескриптор
+     * \param output Выходной файл
+     * \return
+     */
+    void Run(
+        const int input,
+        std::FILE* output)
+    {
+        std::string buffer;
+        std::vector<char> chunk(kReadSize);
+        bool eof = false;
+        std::vector<pollfd> fds;
+        while (!eof || m_nextOutput < m_nextSequence) {
+            fds.clear();
+            // Новые запросы читаем, только пока очередь невелика
+            const bool reading = !eof && m_ready.size() < kMaxInFlight * m_workers.size();
+            fds.push_back({ reading ? input : -1, POLLIN, 0 });
+            for (const auto& worker : m_workers) {
+                fds.push_back({ worker.fd, POLLIN, 0 });
+            }
+            if (::poll(fds.data(), fds.size(), -1) < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::runtime_error(u8"Ошибка ожидания сокетов: " + std::string(std::strerror(errno)));
+            }
+            if (fds[0].revents) {
+                const auto read = ::read(input, chunk.data(), chunk.size());
+                if (read > 0) {
+                    buffer.append(chunk.data(), static_cast<std::size_t>(read));
+                }
+                else if (read == 0 || errno != EINTR) {
+                    eof = true;
+                    // Последняя строка без перевода строки
+                    if (!buffer.empty()) {
+                        buffer.push_back('\n');
+                    }
+                }
+                std::size_t begin = 0;
+                for (auto end = buffer.find('\n'); end != std::string::npos; end = buffer.find('\n', begin)) {
+                    Submit(std::string_view(buffer).substr(begin, end - begin));
+                    begin = end + 1;
+                }
+                buffer.erase(0, begin);
+            }
+            for (std::size_t i = 0; i < m_workers.size(); ++i) {
+                if (fds[i + 1].revents) {
+                    Receive(i);
+                }
+            }
+            Dispatch();
+            // Выводим ответы, готовые по порядку
+            for (auto it = m_done.begin(); it != m_done.end() && it->first == m_nextOutput;
+                it = m_done.erase(it), ++m_nextOutput) {
+                std::fwrite(it->second.data(), 1, it->second.size(), output);
+            }
+            std::fflush(output);
+        }
+        // Закрытие сокетов завершает обработчики
+        for (auto& worker : m_workers) {
+            ::close(worker.fd);
+            ::waitpid(worker.pid, nullptr, 0);
+        }
+    }
+
+    // Количество обработанных запросов
+    std::uint64_t Requests() const noexcept
+    {
+        return m_nextSequence - 1;
+    }
+
+    // Количество перезапущенных обработчиков
+    std::size_t Restarts() const noexcept
+    {
+        return m_restarts;
+    }
+
+private:
+    /**
+     * Запуск обработчика. Дочерний процесс получает копию
+     * загруженного дерева и таблицу сеансов.
+     *
+     * \param index Номер обработчика
+     * \return
+     */
+    void Spawn(
+        const std::size_t index)
+    {
+        int sockets[2];
+        if (::socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) != 0) {
+            throw std::runtime_error(u8"Не удалось создать сокеты обработчика: " + std::string(std::strerror(errno)));
+        }
+        std::fflush(nullptr);
+        const auto pid = ::fork();
+        if (pid < 0) {
+            throw std::runtime_error(u8"Не удалось запустить обработчик: " + std::string(std::strerror(errno)));
+        }
+        if (pid == 0) {
+            ::close(sockets[0]);
+            for (const auto& worker : m_workers) {
+                if (worker.fd >= 0) {
+                    ::close(worker.fd);
+                }
+            }
+            // Не выполняем деструкторы и обработчики завершения родителя
+            try {
+                Worker(m_base, m_table).Run(sockets[1]);
+            }
+            catch (const std::exception& ex) {
+                ES::logger->Log(ES::LogLevel::Error, ex.what());
+                ::_exit(EXIT_FAILURE);
+            }
+            ::_exit(EXIT_SUCCESS);
+        }
+        ::close(sockets[1]);
+        ::fcntl(sockets[0], F_SETFD, FD_CLOEXEC);
+        m_workers[index].pid = pid;
+        m_workers[index].fd = sockets[0];
+    }
+
+    /**
+     * Разбор входной строки и постановка запроса в очередь.
+     *
+     * \param line Строка запроса
+     * \return
+     */
+    void Submit(
+        std::string_view line)
+    {
+        while (!line.empty() && (line.back() == '\r' || line.back() == ' ')) {
+            line.remove_suffix(1);
+        }
+        Request request;
+        request.sequence = m_nextSequence++;
+        if (line == "new") {
+            request.session = m_table.Create();
+            if (!request.session) {
+                m_done.emplace(request.sequence, "full\t0\t\t\n");
+                return;
+            }
+        }
+        else if (!ES::ParseNumber(line, request.session) || !request.session) {
+            m_done.emplace(request.sequence, "invalid\t0\t\t\n");
+            return;
+        }
+        else {
+            request.command = line;
+        }
+        // Запросы одного сеанса ждут, пока не выполнится предыдущий
+        const auto [it, idle] = m_waiting.try_emplace(request.session);
+        if (idle) {
+            m_ready.push_back(std::move(request));
+        }
+        else {
+            it->second.push_back(std::move(request));
+        }
+    }
+
+    /**
+     * Отправка готовых запросов. Запрос сеанса отправляется обработчику
+     * предыдущего запроса этого сеанса, у которого сеанс уже
+     * восстановлен, а если тот занят - наименее загруженному.
+     *
+     * \return
+     */
+    void Dispatch()
+    {
+        while (!m_ready.empty()) {
+            const auto [owner, fresh] = m_owners.try_emplace(m_ready.front().session, 0);
+            auto worker = &m_workers[owner->second];
+            if (fresh || worker->inFlight.size() >= kMaxInFlight) {
+                for (auto& candidate : m_workers) {
+                    if (candidate.inFlight.size() < worker->inFlight.size()) {
+                        worker = &candidate;
+                    }
+                }
+                owner->second = static_cast<std::size_t>(worker - m_workers.data());
+                if (worker->inFlight.size() >= kMaxInFlight) {
+                    return;
+                }
+            }
+            auto request = std::move(m_ready.front());
+            m_ready.pop_front();
+            if (ES::ParseCommand(request.command).kind == ES::SessionCommand::Kind::Close) {
+                m_owners.erase(request.session);
+            }
+            const auto message = std::to_string(request.sequence) + ' '
+                + std::to_string(request.session) + ' ' + request.command + '\n';
+            worker->inFlight.push_back(std::move(request));
+            // Ошибку записи обнаружит чтение: сокет упавшего обработчика закрыт
+            ES::WriteAll(worker->fd, message);
+        }
+    }
+
+    /**
+     * Чтение ответов обработчика. Если обработчик завершился,
+     * он перезапускается, а его запросы повторяются.
+     *
+     * \param index Номер обработчика
+     * \return
+     */
+    void Receive(
+        const std::size_t index)
+    {
+        auto& worker = m_workers[index];
+        char chunk[kReadSize];
+        const auto read = ::read(worker.fd, chunk, sizeof(chunk));
+        if (read < 0 && errno == EINTR) {
+            return;
+        }
+        if (read <= 0) {
+            ::close(worker.fd);
+            worker.fd = -1;
+            int status = 0;
+            // Процесс дожидаемся до повтора запросов: пока он не убран,
+            // таблица сеансов не может отобрать у него сеанс
+            ::waitpid(worker.pid, &status, 0);
+            ES::logger->Log(ES::LogLevel::Warning, u8"Обработчик " + std::to_string(worker.pid)
+                + u8" завершился, запросов без ответа: " + std::to_string(worker.inFlight.size()));
+            ++m_restarts;
+            for (auto it = worker.inFlight.rbegin(); it != worker.inFlight.rend(); ++it) {
+                m_ready.push_front(std::move(*it));
+            }
+            worker.inFlight.clear();
+            worker.input.clear();
+            Spawn(index);
+            return;
+        }
+        worker.input.append(chunk, static_cast<std::size_t>(read));
+        std::size_t begin = 0;
+        for (auto end = worker.input.find('\n'); end != std::string::npos; end = worker.input.find('\n', begin)) {
+            auto line = std::string_view(worker.input).substr(begin, end + 1 - begin);
+            begin = end + 1;
+            std::uint64_t sequence = 0;
+            ES::ParseNumber(line, sequence);
+            const auto request = std::find_if(worker.inFlight.begin(), worker.inFlight.end(),
+                [sequence](const Request& r) { return r.sequence == sequence; });
+            if (request == worker.inFlight.end()) {
+                continue;
+            }
+            m_done.emplace(sequence, std::string(line));
+            // Следующий запрос сеанса становится готовым
+            auto waiting = m_waiting.find(request->session);
+            if (waiting->second.empty()) {
+                m_waiting.erase(waiting);
+            }
+            else {
+                m_ready.push_back(std::move(waiting->second.front()));
+                waiting->second.pop_front();
+            }
+            worker.inFlight.erase(request);
+        }
+        worker.input.erase(0, begin);
+    }
+
+    // Загруженная экспертная система
+    const ES::IExpertSystem& m_base;
+    // Таблица сеансов
+    ES::ISessionTable& m_table;
+    // Обработчики
+    std::vector<WorkerProcess> m_workers;
+    // Запросы, которые можно отправлять
+    std::deque<Request> m_ready;
+    // Сеансы с запросом в работе и их следующие запросы
+    std::unordered_map<std::uint64_t, std::deque<Request>> m_waiting;
+    // Обработчик последнего запроса каждого открытого сеанса
+    std::unordered_map<std::uint64_t, std::size_t> m_owners;
+    // Ответы, ожидающие вывода по порядку
+    std::map<std::uint64_t, std::string> m_done;
+    // Номер следующего запроса
+    std::uint64_t m_nextSequence = 1;
+    // Номер следующего выводимого ответа
+    std::uint64_t m_nextOutput = 1;
+    // Количество перезапусков обработчиков
+    std::size_t m_restarts = 0;
+};
+
+}
+
+/**
+ * Запуск экспертной системы в многопроцессном режиме.
+ *
+ * \param options Параметры многопроцессного режима
+ * \return Код завершения
+ */
+int RunPrefork(
+    const PreforkOptions& options)
+{
+    // Загружаем экспертную систему один раз, до порождения обработчиков
+    auto es = ES::CreateExpertSystem();
+    es->SetTextCompression(options.textCompression);
+    es->Load(options.configPath);
+    ES::SessionTableOptions tableOptions;
+    tableOptions.capacity = options.sessions;
+    tableOptions.maxDepth = options.maxDepth;
+    auto table = ES::CreateSharedSessionTable(tableOptions);
+
+    const int input = options.inputPath.empty() ? STDIN_FILENO
+        : ::open(options.inputPath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (input < 0) {
+        throw std::runtime_error(u8"Не удалось открыть файл запросов " + options.inputPath);
+    }
+    std::FILE* output = options.outputPath.empty() ? stdout : std::fopen(options.outputPath.c_str(), "wb");
+    if (!output) {
+        throw std::runtime_error(u8"Не удалось открыть файл ответов " + options.outputPath);
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    Dispatcher dispatcher(*es, *table, options.workers ? options.workers : 1);
+    dispatcher.Run(input, output);
+    const auto finish = std::chrono::steady_clock::now();
+    if (input != STDIN_FILENO) {
+        ::close(input);
+    }
+    if (output != stdout) {
+        std::fclose(output);
+    }
+
+    const auto stats = table->GetStats();
+    const double seconds = std::chrono::duration<double>(finish - start).count();
+    std::fprintf(stderr,
+        "prefork: %llu requests, %zu workers, %.0f requests/s\n"
+        "  restarts: %zu, recovered updates: %llu, open sessions: %zu of %zu (%zu bytes)\n",
+        static_cast<unsigned long long>(dispatcher.Requests()), options.workers,
+        double(dispatcher.Requests()) / seconds, dispatcher.Restarts(),
+        static_cast<unsigned long long>(stats.recovered), stats.size, stats.capacity, stats.bytes);
+    return EXIT_SUCCESS;
+}
+
+#else
+
+int RunPrefork(
+    const PreforkOptions&)
+{
+    std::fprintf(stderr, "Prefork mode is not supported on this platform\n");
+    return EXIT_FAILURE;
+}
+
+#endif
@@ -0,0 +1,58 @@
+﻿#pragma once
+
+#include "IExpertSystem.hpp"
+
+#include <cstddef>
+#include <string>
+
+/**
+ * Параметры многопроцессного режима.
+ */
+struct PreforkOptions
+{
+    // Путь к файлу конфигурации экспертной системы
+    std::string configPath;
+    // Путь к файлу запросов.
+    // Если путь пустой, то запросы читаются из стандартного ввода
+    std::string inputPath;
+    // Путь к файлу ответов.
+    // Если путь пустой, то ответы пишутся в стандартный вывод
+    std::string outputPath;
+    // Количество процессов-обработчиков
+    std::size_t workers = 4;
+    // Наибольшее количество одновременно открытых сеансов
+    std::size_t sessions = 64 * 1024;
+    // Наибольшая глубина пути сеанса
+    std::size_t maxDepth = 128;
+    // Хранение текстов узлов в сжатом виде
+    ES::TextCompressionOptions textCompression;
+};
+
+/**
+ * Запуск экспертной системы в многопроцессном режиме.
+ * Родительский процесс загружает базу знаний и порождает обработчики,
+ * которые получают дерево копированием страниц при записи, то есть
+ * фактически разделяют его. Сеансы хранятся в таблице в разделяемой
+ * памяти, поэтому запрос любого сеанса может обработать любой
+ * обработчик. Запросы одного сеанса выполняются по очереди.
+ * Упавший обработчик перезапускается, а его запросы повторяются
+ * другим процессом; повтор уже применённого запроса ничего не меняет.
+ *
+ * Каждая строка входных данных - запрос:
+ * new - открыть сеанс,
+ * <сеанс> - текущий узел сеанса,
+ * <сеанс> <ответ> - подать ответ, b - возврат к предыдущему вопросу,
+ * r - сброс сеанса, close - закрытие сеанса.
+ * Для каждого запроса в том же порядке выводится строка
+ * "статус<TAB>сеанс<TAB>идентификатор узла<TAB>текст узла", где статус:
+ * ok - текущий узел - вопрос, finished - текущий узел - ответ,
+ * rejected - ответ не был принят, deep - путь сеанса достиг
+ * наибольшей глубины (--depth) и ответ не сохранён, closed - сеанс закрыт,
+ * unknown - сеанс не найден, full - таблица сеансов заполнена,
+ * invalid - запрос не разобран.
+ *
+ * \param options Параметры многопроцессного режима
+ * \return Код завершения
+ */
+int RunPrefork(
+    const PreforkOptions& options);
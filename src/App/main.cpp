@@ -5,28 +5,86 @@
 #   include <Windows.h>
 #endif
 
+#include "BulkLoader.hpp"
 #include "IExpertSystem.hpp"
 #include "ILogger.hpp"
+#include "IShardCluster.hpp"
+#include "TreeLearner.hpp"
+#include "TreeOptimizer.hpp"
+
+#include "Batch.hpp"
+#include "Prefork.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
 
 /**
  * Запуск экспертной системы
  * 
  * \param config путь к файлу конфигурации
+ * \param language код языка текстов, либо пустая строка для основного языка
+ * \param journalDirectory каталог журнала сеансов, либо пустая строка
+ * \param sessionID продолжаемый сеанс журнала, либо 0
+ * \param bayes true - вероятностная экспертная система вместо дерева
  */
-void Run(const std::string& config)
+void Run(const std::string& config, const std::string& language, const std::string& journalDirectory,
+    const std::uint64_t sessionID, const bool bayes)
 {
     // Создаём экспертную систему
-    auto es = ES::CreateExpertSystem();
+    auto es = bayes ? ES::CreateBayesExpertSystem() : ES::CreateExpertSystem();
     // Загружаем из файла конфигурации
     es->Load(config);
+    // Переходим на сеанс с текстами на нужном языке
+    if (!language.empty()) {
+        es = es->CreateSession(language);
+    }
+    // Продолжаем сеанс, прерванный падением: заданный, либо единственный.
+    // Журнал подключается только к обслуживаемому сеансу, поэтому
+    // остальные прерванные сеансы остаются в журнале незавершёнными
+    if (!journalDirectory.empty()) {
+        ES::JournalOptions options;
+        options.directory = journalDirectory;
+        auto journal = ES::OpenSessionJournal(options);
+        const auto sessions = journal->GetSessions();
+        auto id = sessionID;
+        if (!id && sessions.size() == 1) {
+            id = sessions.front();
+        }
+        else if (!id && !sessions.empty()) {
+            std::cout << u8"Прерванные сеансы (продолжить: --session id):";
+            for (const auto session : sessions) {
+                std::cout << ' ' << session;
+            }
+            std::cout << std::endl;
+        }
+        std::unique_ptr<ES::IExpertSystem> resumed;
+        if (id) {
+            resumed = es->ResumeSession(journal, id);
+            if (!resumed) {
+                throw std::runtime_error(u8"Сеанс " + std::to_string(id) + u8" не найден в журнале");
+            }
+        }
+        if (resumed) {
+            es = std::move(resumed);
+            std::cout << u8"Сеанс " << id << u8" продолжен" << std::endl;
+        }
+        else {
+            es = es->CreateSession();
+            es->SetSessionJournal(journal);
+        }
+    }
     // Выводим название экспертной системы
     std::cout << "~~~ " << es->GetName() << " ~~~" << std::endl;
     // TODO: Вынести варианты ответов в конфигурационный файл
-    std::cout << u8"Варианты ответов: 0 - нет, 1 - да." << std::endl;
+    std::cout << u8"Варианты ответов: 0 - нет, 1 - да, b - предыдущий вопрос, /текст - поиск." << std::endl;
     // Будем крутиться в бесконечном цикле
     while (true) {
         // Получаем значение текущего узла
-        auto current = es->GetCurrentData();
+        const auto& current = es->GetCurrentData();
         // Выводим значение текущего узла в стандартный вывод
         std::cout << current << std::endl;
         // Проверяем окончание работы системы
@@ -35,8 +93,7 @@ void Run(const std::string& config)
             // Спрашиваем польлзователя
             std::cout << u8"Введите y для завершения работы, либо любой символ для продолжения." << std::endl;
             char e;
-            std::cin >> e;
-            if (e == 'y') {
+            if (!(std::cin >> e) || e == 'y') {
                 // Выходим из цикла и завершаем работу
                 break;
             } else {
@@ -49,14 +106,568 @@ void Run(const std::string& config)
         }
         // Текуший узел - это вопрос.
         // Попросим пользователя ввести ответ.
-        int a;
-        std::cin >> a;
+        std::string input;
+        if (!(std::cin >> input)) {
+            // Ввод закончился
+            break;
+        }
+        // Ищем узел по тексту и переходим к лучшему найденному
+        if (input[0] == '/') {
+            std::string rest;
+            std::getline(std::cin, rest);
+            const auto hits = es->Search(input.substr(1) + rest, 1);
+            if (hits.empty() || !es->JumpTo(hits.front().nodeID)) {
+                std::cout << u8"Ничего не найдено" << std::endl;
+            }
+            continue;
+        }
+        // Возвращаемся к предыдущему вопросу
+        if (input == "b") {
+            if (!es->Back()) {
+                std::cout << u8"Это первый вопрос" << std::endl;
+            }
+            continue;
+        }
         // Подаём ответ в систему
-        if (!es->SetAnswer(a)) {
+        char* inputEnd = nullptr;
+        const auto a = static_cast<int>(std::strtol(input.c_str(), &inputEnd, 10));
+        if (*inputEnd != '\0' || !es->SetAnswer(a)) {
             // Ответ оказался неправильнымю Выводим сообщение
             std::cout << u8"Неверный ответ. Попробуйте ещё раз" << std::endl;
         }
+        else if (bayes) {
+            // Выводим наиболее вероятные диагнозы
+            for (const auto& candidate : es->GetTopCandidates(3)) {
+                std::cout << "  " << candidate.nodeID << ": "
+                    << static_cast<int>(candidate.probability * 100 + 0.5) << '%' << std::endl;
+            }
+        }
+    }
+}
+
+/**
+ * Разбор параметров пакетного режима.
+ * Формат: --batch [--threads N] [--input file] [--output file] [--share-prefixes] config_file
+ *
+ * \param argc Количество аргументов
+ * \param argv Аргументы
+ * \param options Параметры пакетного режима
+ * \return true - если параметры разобраны успешно
+ */
+bool ParseBatchOptions(int argc, char* argv[], BatchOptions& options)
+{
+    for (int i = 2; i < argc; ++i) {
+        const bool hasValue = i + 1 < argc;
+        if (std::strcmp(argv[i], "--threads") == 0 && hasValue) {
+            options.threads = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (std::strcmp(argv[i], "--input") == 0 && hasValue) {
+            options.inputPath = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--output") == 0 && hasValue) {
+            options.outputPath = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--trace") == 0 && hasValue) {
+            options.traceDirectory = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--replicate") == 0 && hasValue) {
+            // numa - копия на каждый NUMA-узел, N - копия на каждую из N групп процессоров
+            ++i;
+            if (std::strcmp(argv[i], "numa") == 0) {
+                options.replication.mode = ES::ReplicationMode::PerNumaNode;
+            }
+            else {
+                options.replication.mode = ES::ReplicationMode::PerThreadGroup;
+                options.replication.groups = std::strtoul(argv[i], nullptr, 10);
+            }
+        }
+        else if (std::strcmp(argv[i], "--language") == 0 && hasValue) {
+            options.language = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--compress-texts") == 0) {
+            options.textCompression.enabled = true;
+        }
+        else if (std::strcmp(argv[i], "--share-prefixes") == 0) {
+            options.sharePrefixes = true;
+        }
+        else if (options.configPath.empty() && argv[i][0] != '-') {
+            options.configPath = argv[i];
+        }
+        else {
+            return false;
+        }
+    }
+    return !options.configPath.empty();
+}
+
+/**
+ * Расшифровка трассы сеансов в стандартный вывод.
+ * Формат: --trace-decode [--replay] [--config config_file] trace_dir
+ *
+ * \param argc Количество аргументов
+ * \param argv Аргументы
+ * \return Код завершения, либо -1, если аргументы неверны
+ */
+int DecodeTrace(int argc, char* argv[])
+{
+    auto format = ES::TraceFormat::Text;
+    std::string config;
+    std::string directory;
+    for (int i = 2; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--replay") == 0) {
+            format = ES::TraceFormat::Replay;
+        }
+        else if (std::strcmp(argv[i], "--config") == 0 && i + 1 < argc) {
+            config = argv[++i];
+        }
+        else if (directory.empty() && argv[i][0] != '-') {
+            directory = argv[i];
+        }
+        else {
+            return -1;
+        }
+    }
+    if (directory.empty()) {
+        return -1;
+    }
+    ES::DecodeTrace(directory, format, config, std::cout);
+    std::cout.flush();
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Вывод путей от начала дерева до узла.
+ * Формат: --paths [--limit N] node_id config_file
+ * Каждый путь выводится строкой "вопрос:ответ вопрос:ответ ... узел".
+ *
+ * \param argc Количество аргументов
+ * \param argv Аргументы
+ * \return Код завершения, либо -1, если аргументы неверны
+ */
+int PrintPaths(int argc, char* argv[])
+{
+    std::size_t limit = 0;
+    std::string node;
+    std::string config;
+    for (int i = 2; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--limit") == 0 && i + 1 < argc) {
+            limit = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (node.empty() && argv[i][0] != '-') {
+            node = argv[i];
+        }
+        else if (config.empty() && argv[i][0] != '-') {
+            config = argv[i];
+        }
+        else {
+            return -1;
+        }
+    }
+    if (config.empty()) {
+        return -1;
+    }
+    auto es = ES::CreateExpertSystem();
+    es->Load(config);
+    const int id = std::atoi(node.c_str());
+    for (const auto& path : es->GetPathsTo(id, limit)) {
+        for (const auto& step : path) {
+            std::cout << step.questionID << ':' << step.answer << ' ';
+        }
+        std::cout << id << '\n';
+    }
+    std::cout.flush();
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Проверка графа базы знаний.
+ * Формат: --validate [--threads N] config_file
+ * Выводится сводка, затем для каждого вида ошибок строка
+ * "вид: количество (идентификаторы узлов)".
+ *
+ * \param argc Количество аргументов
+ * \param argv Аргументы
+ * \return Код завершения: ненулевой, если в графе есть ошибки,
+ * либо -1, если аргументы неверны
+ */
+int Validate(int argc, char* argv[])
+{
+    ES::ValidationOptions options;
+    std::string config;
+    for (int i = 2; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            options.threads = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (config.empty() && argv[i][0] != '-') {
+            config = argv[i];
+        }
+        else {
+            return -1;
+        }
+    }
+    if (config.empty()) {
+        return -1;
+    }
+    auto es = ES::CreateExpertSystem();
+    es->SetValidation(options);
+    es->Load(config);
+    const auto report = es->GetValidationReport();
+    std::cout << "Nodes: " << report.nodes << ", connections: " << report.connections
+        << ", issues: " << report.total << ", time: " << report.milliseconds << " ms\n";
+    for (std::size_t issue = 0; issue < ES::kValidationIssues; ++issue) {
+        const auto& issues = report.issues[issue];
+        if (!issues.count) {
+            continue;
+        }
+        std::cout << ES::GetValidationIssueName(static_cast<ES::ValidationIssue>(issue))
+            << ": " << issues.count << " (";
+        for (std::size_t i = 0; i < issues.samples.size(); ++i) {
+            std::cout << (i ? ", " : "") << issues.samples[i];
+        }
+        std::cout << (issues.count > issues.samples.size() ? ", ...)\n" : ")\n");
     }
+    std::cout.flush();
+    return report.total ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/**
+ * Поиск узлов по тексту.
+ * Формат: --search [--limit N] query config_file
+ * Каждый найденный узел выводится строкой "идентификатор релевантность текст".
+ *
+ * \param argc Количество аргументов
+ * \param argv Аргументы
+ * \return Код завершения, либо -1, если аргументы неверны
+ */
+int PrintSearch(int argc, char* argv[])
+{
+    std::size_t limit = 10;
+    std::string query;
+    std::string config;
+    for (int i = 2; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--limit") == 0 && i + 1 < argc) {
+            limit = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (query.empty() && argv[i][0] != '-') {
+            query = argv[i];
+        }
+        else if (config.empty() && argv[i][0] != '-') {
+            config = argv[i];
+        }
+        else {
+            return -1;
+        }
+    }
+    if (config.empty()) {
+        return -1;
+    }
+    auto es = ES::CreateExpertSystem();
+    es->Load(config);
+    // Текст узла получаем, переходя к нему в отдельном сеансе
+    auto session = es->CreateSession();
+    for (const auto& hit : es->Search(query, limit)) {
+        std::cout << hit.nodeID << ' ' << hit.score << ' ';
+        if (session->JumpTo(hit.nodeID)) {
+            std::cout << session->GetCurrentData();
+        }
+        std::cout << '\n';
+    }
+    std::cout.flush();
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Построение конфигурации по размеченным данным.
+ * Формат: --learn [--label column] [--max-depth N] [--min-rows N] [--bins N]
+ *                 [--threads N] [--name text] data.csv config_file
+ *
+ * \param argc Количество аргументов
+ * \param argv Аргументы
+ * \return Код завершения, либо -1, если аргументы неверны
+ */
+int Learn(int argc, char* argv[])
+{
+    ES::LearnerOptions options;
+    std::string data;
+    std::string config;
+    for (int i = 2; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--label") == 0 && i + 1 < argc) {
+            options.labelColumn = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--max-depth") == 0 && i + 1 < argc) {
+            options.maxDepth = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (std::strcmp(argv[i], "--min-rows") == 0 && i + 1 < argc) {
+            options.minRows = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (std::strcmp(argv[i], "--bins") == 0 && i + 1 < argc) {
+            options.bins = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            options.threads = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (std::strcmp(argv[i], "--name") == 0 && i + 1 < argc) {
+            options.name = argv[++i];
+        }
+        else if (data.empty() && argv[i][0] != '-') {
+            data = argv[i];
+        }
+        else if (config.empty() && argv[i][0] != '-') {
+            config = argv[i];
+        }
+        else {
+            return -1;
+        }
+    }
+    if (config.empty()) {
+        return -1;
+    }
+    const auto stats = ES::LearnTree(data, config, options);
+    std::cout << "Rows: " << stats.rows << ", features: " << stats.features
+        << ", questions: " << stats.questions << ", answers: " << stats.answers
+        << ", depth: " << stats.depth << ", accuracy: " << stats.accuracy * 100 << "%"
+        << std::endl;
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Перестройка дерева для уменьшения ожидаемого количества вопросов.
+ * Формат: --optimize [--priors file] [--trace dir] [--exact N] [--growth X]
+ *                    [--name text] config_file output_file
+ *
+ * \param argc Количество аргументов
+ * \param argv Аргументы
+ * \return Код завершения, либо -1, если аргументы неверны
+ */
+int Optimize(int argc, char* argv[])
+{
+    ES::OptimizerOptions options;
+    std::string config;
+    std::string output;
+    for (int i = 2; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--priors") == 0 && i + 1 < argc) {
+            options.priorsPath = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            options.traceDirectory = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--exact") == 0 && i + 1 < argc) {
+            options.exactLimit = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (std::strcmp(argv[i], "--growth") == 0 && i + 1 < argc) {
+            options.maxGrowth = std::strtod(argv[++i], nullptr);
+        }
+        else if (std::strcmp(argv[i], "--name") == 0 && i + 1 < argc) {
+            options.name = argv[++i];
+        }
+        else if (config.empty() && argv[i][0] != '-') {
+            config = argv[i];
+        }
+        else if (output.empty() && argv[i][0] != '-') {
+            output = argv[i];
+        }
+        else {
+            return -1;
+        }
+    }
+    if (output.empty()) {
+        return -1;
+    }
+    const auto stats = ES::OptimizeTree(config, output, options);
+    std::cout << "Paths: " << stats.paths << ", answers: " << stats.answers
+        << ", questions: " << stats.questionsBefore << " -> " << stats.questionsAfter
+        << ", expected depth: " << stats.expectedDepthBefore << " -> " << stats.expectedDepthAfter
+        << ", max depth: " << stats.maxDepthBefore << " -> " << stats.maxDepthAfter
+        << ", exact subtrees: " << stats.exactSubtrees << std::endl;
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Разбор параметров многопроцессного режима.
+ * Формат: --prefork [--workers N] [--sessions N] [--depth N] [--input file]
+ *                   [--output file] [--compress-texts] config_file
+ *
+ * \param argc Количество аргументов
+ * \param argv Аргументы
+ * \param options Параметры многопроцессного режима
+ * \return true - если аргументы верны
+ */
+bool ParsePreforkOptions(int argc, char* argv[], PreforkOptions& options)
+{
+    for (int i = 2; i < argc; ++i) {
+        const bool hasValue = i + 1 < argc;
+        if (std::strcmp(argv[i], "--workers") == 0 && hasValue) {
+            options.workers = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (std::strcmp(argv[i], "--sessions") == 0 && hasValue) {
+            options.sessions = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (std::strcmp(argv[i], "--depth") == 0 && hasValue) {
+            options.maxDepth = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (std::strcmp(argv[i], "--input") == 0 && hasValue) {
+            options.inputPath = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--output") == 0 && hasValue) {
+            options.outputPath = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--compress-texts") == 0) {
+            options.textCompression.enabled = true;
+        }
+        else if (options.configPath.empty() && argv[i][0] != '-') {
+            options.configPath = argv[i];
+        }
+        else {
+            return false;
+        }
+    }
+    return !options.configPath.empty();
+}
+
+/**
+ * Запуск кластера шардов с маршрутизатором.
+ * Формат: --cluster [--shards N] [--vnodes N] [--sessions N] [--input file]
+ *                   [--output file] [--compress-texts] config_file
+ * Запросы и ответы - как в многопроцессном режиме, запрос "shards N"
+ * меняет количество шардов. Сводка выводится в stderr.
+ *
+ * \param argc Количество аргументов
+ * \param argv Аргументы
+ * \return Код завершения, либо -1, если аргументы неверны
+ */
+int RunCluster(int argc, char* argv[])
+{
+    ES::ShardClusterOptions options;
+    ES::TextCompressionOptions textCompression;
+    std::string inputPath;
+    std::string outputPath;
+    std::string config;
+    for (int i = 2; i < argc; ++i) {
+        const bool hasValue = i + 1 < argc;
+        if (std::strcmp(argv[i], "--shards") == 0 && hasValue) {
+            options.shards = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (std::strcmp(argv[i], "--vnodes") == 0 && hasValue) {
+            options.virtualNodes = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (std::strcmp(argv[i], "--sessions") == 0 && hasValue) {
+            options.sessions = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (std::strcmp(argv[i], "--input") == 0 && hasValue) {
+            inputPath = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--output") == 0 && hasValue) {
+            outputPath = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--compress-texts") == 0) {
+            textCompression.enabled = true;
+        }
+        else if (config.empty() && argv[i][0] != '-') {
+            config = argv[i];
+        }
+        else {
+            return -1;
+        }
+    }
+    if (config.empty()) {
+        return -1;
+    }
+    // Шарды получают уже загруженное дерево
+    auto es = ES::CreateExpertSystem();
+    es->SetTextCompression(textCompression);
+    es->Load(config);
+
+    std::FILE* input = inputPath.empty() ? stdin : std::fopen(inputPath.c_str(), "rb");
+    if (!input) {
+        throw std::runtime_error(u8"Не удалось открыть файл запросов " + inputPath);
+    }
+    std::FILE* output = outputPath.empty() ? stdout : std::fopen(outputPath.c_str(), "wb");
+    if (!output) {
+        throw std::runtime_error(u8"Не удалось открыть файл ответов " + outputPath);
+    }
+    const auto start = std::chrono::steady_clock::now();
+    auto cluster = ES::CreateShardCluster(*es, options);
+    cluster->Run(fileno(input), output);
+    const auto finish = std::chrono::steady_clock::now();
+    if (input != stdin) {
+        std::fclose(input);
+    }
+    if (output != stdout) {
+        std::fclose(output);
+    }
+
+    const auto stats = cluster->GetStats();
+    const double seconds = std::chrono::duration<double>(finish - start).count();
+    std::fprintf(stderr,
+        "cluster: %llu requests, %zu shards, %.0f requests/s\n"
+        "  rebalances: %zu, moved sessions: %llu, lost: %llu, restarts: %zu\n",
+        static_cast<unsigned long long>(stats.requests), stats.shards,
+        double(stats.requests) / seconds, stats.rebalances,
+        static_cast<unsigned long long>(stats.moved), static_cast<unsigned long long>(stats.lost),
+        stats.restarts);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Параллельная загрузка всех баз знаний каталога или манифеста.
+ * Формат: --load-all [--threads N] [--ready-file file] [--compress-texts] [--strict] dir|manifest
+ * Для каждой базы выводится строка "ok|failed время размер путь [ошибка]",
+ * в конце - сводка. Файл готовности создаётся, как только загружены
+ * все обязательные базы.
+ *
+ * \param argc Количество аргументов
+ * \param argv Аргументы
+ * \return Код завершения, либо -1, если аргументы неверны
+ */
+int LoadAll(int argc, char* argv[])
+{
+    ES::BulkLoadOptions options;
+    std::string readyFile;
+    std::string source;
+    for (int i = 2; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            options.threads = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (std::strcmp(argv[i], "--ready-file") == 0 && i + 1 < argc) {
+            readyFile = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--compress-texts") == 0) {
+            options.textCompression.enabled = true;
+        }
+        else if (std::strcmp(argv[i], "--strict") == 0) {
+            options.validation.strict = true;
+        }
+        else if (source.empty() && argv[i][0] != '-') {
+            source = argv[i];
+        }
+        else {
+            return -1;
+        }
+    }
+    if (source.empty()) {
+        return -1;
+    }
+    options.onLoaded = [](const ES::BulkLoadResult& base) {
+        std::cout << (base.system ? "ok" : "failed") << '\t' << base.loadMs << " ms\t"
+            << base.bytes << " bytes\t" << base.path;
+        if (!base.system) {
+            std::cout << '\t' << base.error;
+        }
+        std::cout << std::endl;
+    };
+    options.onReady = [&readyFile] {
+        if (!readyFile.empty()) {
+            std::ofstream(readyFile) << "ready" << std::endl;
+        }
+    };
+    const auto report = ES::LoadKnowledgeBases(ES::ListKnowledgeBases(source), options);
+    std::cout << "Loaded: " << report.loaded << ", failed: " << report.failed
+        << ", total: " << report.totalMs << " ms, sequential: " << report.sequentialMs << " ms";
+    if (report.ready) {
+        std::cout << ", ready: " << report.readyMs << " ms";
+    }
+    std::cout << std::endl;
+    return report.ready ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
 int main (int argc, char *argv[]){
@@ -64,15 +675,157 @@ int main (int argc, char *argv[]){
 #if defined(WIN32)
     SetConsoleOutputCP(65001);
 #endif
+    // Сообщение о правильном запуске
+    const char* usage =
+        "Usage: App [--language code] [--journal dir [--session id] | --bayes] config_file\n"
+        "       App --batch [--threads N] [--input file] [--output file] [--trace dir]\n"
+        "               [--replicate numa|N] [--compress-texts] [--language code]\n"
+        "               [--share-prefixes] config_file\n"
+        "       App --prefork [--workers N] [--sessions N] [--depth N] [--input file]\n"
+        "               [--output file] [--compress-texts] config_file\n"
+        "       App --cluster [--shards N] [--vnodes N] [--sessions N] [--input file]\n"
+        "               [--output file] [--compress-texts] config_file\n"
+        "       App --trace-decode [--replay] [--config config_file] trace_dir\n"
+        "       App --paths [--limit N] node_id config_file\n"
+        "       App --search [--limit N] query config_file\n"
+        "       App --validate [--threads N] config_file\n"
+        "       App --load-all [--threads N] [--ready-file file] [--compress-texts]\n"
+        "               [--strict] dir|manifest\n"
+        "       App --learn [--label column] [--max-depth N] [--min-rows N] [--bins N]\n"
+        "               [--threads N] [--name text] data.csv config_file\n"
+        "       App --optimize [--priors file] [--trace dir] [--exact N] [--growth X]\n"
+        "               [--name text] config_file output_file";
     // Ожидаем, что нам передали путь к конфигурационному файлу
     if (argc < 2) {
         // Выводим сообщение
-        std::cout << "Usage: App [config_file]" << std::endl;
+        std::cout << usage << std::endl;
         return EXIT_FAILURE;
     }
     try {
-        // Запускаем экспертную систему, передав в неё путь к конфигурационному файлу
-        Run(argv[1]);
+        // Пакетный режим
+        if (std::strcmp(argv[1], "--batch") == 0) {
+            BatchOptions options;
+            if (!ParseBatchOptions(argc, argv, options)) {
+                std::cout << usage << std::endl;
+                return EXIT_FAILURE;
+            }
+            return RunBatch(options);
+        }
+        // Многопроцессный режим
+        if (std::strcmp(argv[1], "--prefork") == 0) {
+            PreforkOptions options;
+            if (!ParsePreforkOptions(argc, argv, options)) {
+                std::cout << usage << std::endl;
+                return EXIT_FAILURE;
+            }
+            return RunPrefork(options);
+        }
+        // Кластер шардов
+        if (std::strcmp(argv[1], "--cluster") == 0) {
+            const int result = RunCluster(argc, argv);
+            if (result < 0) {
+                std::cout << usage << std::endl;
+                return EXIT_FAILURE;
+            }
+            return result;
+        }
+        // Расшифровка трассы
+        if (std::strcmp(argv[1], "--trace-decode") == 0) {
+            const int result = DecodeTrace(argc, argv);
+            if (result < 0) {
+                std::cout << usage << std::endl;
+                return EXIT_FAILURE;
+            }
+            return result;
+        }
+        // Пути до узла
+        if (std::strcmp(argv[1], "--paths") == 0) {
+            const int result = PrintPaths(argc, argv);
+            if (result < 0) {
+                std::cout << usage << std::endl;
+                return EXIT_FAILURE;
+            }
+            return result;
+        }
+        // Поиск по тексту
+        if (std::strcmp(argv[1], "--search") == 0) {
+            const int result = PrintSearch(argc, argv);
+            if (result < 0) {
+                std::cout << usage << std::endl;
+                return EXIT_FAILURE;
+            }
+            return result;
+        }
+        // Проверка графа
+        if (std::strcmp(argv[1], "--validate") == 0) {
+            const int result = Validate(argc, argv);
+            if (result < 0) {
+                std::cout << usage << std::endl;
+                return EXIT_FAILURE;
+            }
+            return result;
+        }
+        // Загрузка всех баз знаний
+        if (std::strcmp(argv[1], "--load-all") == 0) {
+            const int result = LoadAll(argc, argv);
+            if (result < 0) {
+                std::cout << usage << std::endl;
+                return EXIT_FAILURE;
+            }
+            return result;
+        }
+        // Построение конфигурации по данным
+        if (std::strcmp(argv[1], "--learn") == 0) {
+            const int result = Learn(argc, argv);
+            if (result < 0) {
+                std::cout << usage << std::endl;
+                return EXIT_FAILURE;
+            }
+            return result;
+        }
+        // Перестройка дерева
+        if (std::strcmp(argv[1], "--optimize") == 0) {
+            const int result = Optimize(argc, argv);
+            if (result < 0) {
+                std::cout << usage << std::endl;
+                return EXIT_FAILURE;
+            }
+            return result;
+        }
+        // Запускаем экспертную систему, передав в неё путь к конфигурационному файлу,
+        // язык текстов, каталог журнала сеансов и вид экспертной системы
+        std::string config;
+        std::string language;
+        std::string journal;
+        std::uint64_t session = 0;
+        bool bayes = false;
+        for (int i = 1; i < argc; ++i) {
+            if (std::strcmp(argv[i], "--bayes") == 0) {
+                bayes = true;
+            }
+            else if (std::strcmp(argv[i], "--language") == 0 && i + 1 < argc) {
+                language = argv[++i];
+            }
+            else if (std::strcmp(argv[i], "--journal") == 0 && i + 1 < argc) {
+                journal = argv[++i];
+            }
+            else if (std::strcmp(argv[i], "--session") == 0 && i + 1 < argc) {
+                session = std::strtoull(argv[++i], nullptr, 10);
+            }
+            else if (config.empty() && argv[i][0] != '-') {
+                config = argv[i];
+            }
+            else {
+                std::cout << usage << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        // Вероятностная экспертная система не ведёт журнал сеансов
+        if (config.empty() || (session && journal.empty()) || (bayes && !journal.empty())) {
+            std::cout << usage << std::endl;
+            return EXIT_FAILURE;
+        }
+        Run(config, language, journal, session, bayes);
     }
     catch (const std::exception& ex) {
         // В процессе работы системы произошла критическая ошибка.
@@ -0,0 +1,279 @@
+﻿#include "AllocationCounter.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include <malloc.h>
+
+// Фактический размер выделенного блока
+#if defined(_WIN32)
+#define USABLE_SIZE(ptr) _msize(ptr)
+#define ALIGNED_USABLE_SIZE(ptr, alignment) _aligned_msize(ptr, alignment, 0)
+#else
+#define USABLE_SIZE(ptr) malloc_usable_size(ptr)
+#define ALIGNED_USABLE_SIZE(ptr, alignment) malloc_usable_size(ptr)
+#endif
+
+namespace
+{
+
+// Количество вызовов operator new
+std::atomic<std::size_t> g_allocations{0};
+// Суммарный объём запрошенной памяти
+std::atomic<std::size_t> g_bytes{0};
+// Объём занятой памяти
+std::atomic<std::ptrdiff_t> g_liveBytes{0};
+
+/**
+ * Выделение памяти с учётом в счётчиках.
+ *
+ * \param size Размер блока
+ * \return Указатель на выделенный блок
+ */
+void* CountedAllocate(
+    std::size_t size)
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    g_bytes.fetch_add(size, std::memory_order_relaxed);
+    // malloc(0) может вернуть nullptr, поэтому выделяем хотя бы байт
+    if (void* ptr = std::malloc(size ? size : 1)) {
+        g_liveBytes.fetch_add(static_cast<std::ptrdiff_t>(USABLE_SIZE(ptr)),
+            std::memory_order_relaxed);
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+/**
+ * Освобождение памяти с учётом в счётчиках.
+ *
+ * \param ptr Указатель на блок
+ * \return
+ */
+void CountedFree(
+    void* ptr) noexcept
+{
+    if (ptr) {
+        g_liveBytes.fetch_sub(static_cast<std::ptrdiff_t>(USABLE_SIZE(ptr)),
+            std::memory_order_relaxed);
+    }
+    std::free(ptr);
+}
+
+/**
+ * Выделение выровненной памяти с учётом в счётчиках.
+ *
+ * \param size Размер блока
+ * \param alignment Выравнивание блока
+ * \return Указатель на выделенный блок
+ */
+void* CountedAllocateAligned(
+    std::size_t size,
+    std::align_val_t alignment)
+{
+    const auto align = static_cast<std::size_t>(alignment);
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    g_bytes.fetch_add(size, std::memory_order_relaxed);
+    // Размер округляется до кратного выравниванию, как требует aligned_alloc
+    size = (std::max<std::size_t>(size, 1) + align - 1) & ~(align - 1);
+#if defined(_WIN32)
+    void* ptr = _aligned_malloc(size, align);
+#else
+    void* ptr = std::aligned_alloc(align, size);
+#endif
+    if (ptr) {
+        g_liveBytes.fetch_add(static_cast<std::ptrdiff_t>(ALIGNED_USABLE_SIZE(ptr, align)),
+            std::memory_order_relaxed);
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+/**
+ * Освобождение выровненной памяти с учётом в счётчиках.
+ *
+ * \param ptr Указатель на блок
+ * \param alignment Выравнивание блока
+ * \return
+ */
+void CountedFreeAligned(
+    void* ptr,
+    [[maybe_unused]] std::align_val_t alignment) noexcept
+{
+    if (ptr) {
+        g_liveBytes.fetch_sub(static_cast<std::ptrdiff_t>(
+            ALIGNED_USABLE_SIZE(ptr, static_cast<std::size_t>(alignment))),
+            std::memory_order_relaxed);
+    }
+#if defined(_WIN32)
+    _aligned_free(ptr);
+#else
+    std::free(ptr);
+#endif
+}
+
+}
+
+void* operator new(std::size_t size)
+{
+    return CountedAllocate(size);
+}
+
+void* operator new[](std::size_t size)
+{
+    return CountedAllocate(size);
+}
+
+void operator delete(void* ptr) noexcept
+{
+    CountedFree(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    CountedFree(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    CountedFree(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept
+{
+    CountedFree(ptr);
+}
+
+// Варианты без исключений тоже заменяем, иначе стандартная библиотека
+// (например, временный буфер std::stable_sort) выделит память мимо счётчиков,
+// а освободит через заменённый operator delete
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    try {
+        return CountedAllocate(size);
+    }
+    catch (const std::bad_alloc&) {
+        return nullptr;
+    }
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+    try {
+        return CountedAllocate(size);
+    }
+    catch (const std::bad_alloc&) {
+        return nullptr;
+    }
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept
+{
+    CountedFree(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept
+{
+    CountedFree(ptr);
+}
+
+// Выровненные варианты (типы с alignas больше __STDCPP_DEFAULT_NEW_ALIGNMENT__,
+// например строки кэша в очередях) иначе не попадают в счётчики
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+    return CountedAllocateAligned(size, alignment);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return CountedAllocateAligned(size, alignment);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    try {
+        return CountedAllocateAligned(size, alignment);
+    }
+    catch (const std::bad_alloc&) {
+        return nullptr;
+    }
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    try {
+        return CountedAllocateAligned(size, alignment);
+    }
+    catch (const std::bad_alloc&) {
+        return nullptr;
+    }
+}
+
+void operator delete(void* ptr, std::align_val_t alignment) noexcept
+{
+    CountedFreeAligned(ptr, alignment);
+}
+
+void operator delete[](void* ptr, std::align_val_t alignment) noexcept
+{
+    CountedFreeAligned(ptr, alignment);
+}
+
+void operator delete(void* ptr, std::size_t, std::align_val_t alignment) noexcept
+{
+    CountedFreeAligned(ptr, alignment);
+}
+
+void operator delete[](void* ptr, std::size_t, std::align_val_t alignment) noexcept
+{
+    CountedFreeAligned(ptr, alignment);
+}
+
+void operator delete(void* ptr, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    CountedFreeAligned(ptr, alignment);
+}
+
+void operator delete[](void* ptr, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    CountedFreeAligned(ptr, alignment);
+}
+
+namespace Bench
+{
+
+/**
+ * Получение текущих значений счётчиков.
+ *
+ * \return Снимок счётчиков
+ */
+AllocationStats CurrentAllocationStats() noexcept
+{
+    AllocationStats stats;
+    stats.allocations = g_allocations.load(std::memory_order_relaxed);
+    stats.bytes = g_bytes.load(std::memory_order_relaxed);
+    stats.liveBytes = g_liveBytes.load(std::memory_order_relaxed);
+    return stats;
+}
+
+/**
+ * Разность двух снимков счётчиков.
+ *
+ * \param after Снимок после измеряемого участка
+ * \param before Снимок до измеряемого участка
+ * \return Количество выделений и байт на измеряемом участке
+ */
+AllocationStats operator-(
+    const AllocationStats& after,
+    const AllocationStats& before) noexcept
+{
+    AllocationStats stats;
+    stats.allocations = after.allocations - before.allocations;
+    stats.bytes = after.bytes - before.bytes;
+    stats.liveBytes = after.liveBytes - before.liveBytes;
+    return stats;
+}
+
+}
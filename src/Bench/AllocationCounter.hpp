@@ -0,0 +1,42 @@
+﻿#pragma once
+
+#include <cstddef>
+
+namespace Bench
+{
+
+/**
+ * Снимок счётчиков выделения памяти.
+ */
+struct AllocationStats
+{
+    // Количество вызовов operator new
+    std::size_t allocations = 0;
+    // Суммарный объём запрошенной памяти в байтах
+    std::size_t bytes = 0;
+    // Объём занятой в данный момент памяти в байтах
+    // с учётом служебных данных распределителя
+    std::ptrdiff_t liveBytes = 0;
+};
+
+/**
+ * Получение текущих значений счётчиков.
+ * Счётчики увеличиваются глобальными операторами new,
+ * которые переопределены в AllocationCounter.cpp.
+ *
+ * \return Снимок счётчиков
+ */
+AllocationStats CurrentAllocationStats() noexcept;
+
+/**
+ * Разность двух снимков счётчиков.
+ *
+ * \param before Снимок до измеряемого участка
+ * \param after Снимок после измеряемого участка
+ * \return Количество выделений и байт на измеряемом участке
+ */
+AllocationStats operator-(
+    const AllocationStats& after,
+    const AllocationStats& before) noexcept;
+
+}
@@ -0,0 +1,123 @@
+﻿#include "Benchmarks.hpp"
+#include "AllocationCounter.hpp"
+#include "Generator.hpp"
+
+#include "IExpertSystem.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <vector>
+
+namespace Bench
+{
+
+/**
+ * Бенчмарк возврата к предыдущим вопросам.
+ * Сеанс спускается до ответа, затем возвращается на случайную
+ * глубину и спускается снова. Возврат сравнивается с тем,
+ * что клиенту пришлось бы делать без него: сбросом и повтором
+ * всех предыдущих ответов. После прогрева возвраты
+ * не должны выделять память, даже если путь глубже
+ * хранимого внутри сеанса. В конце измеряется память
+ * на один сеанс.
+ *
+ * \param args Аргументы бенчмарка
+ * \return Код завершения
+ */
+int RunBackBenchmark(
+    const arguments_t& args)
+{
+    const std::size_t steps = ArgumentOr(args, 0, 1000000);
+    GeneratorOptions options;
+    options.depth = ArgumentOr(args, 1, 18);
+    const std::size_t sessionsCount = ArgumentOr(args, 2, 100000);
+
+    const auto path = GenerateConfig(options);
+    auto es = ES::CreateExpertSystem();
+    es->Load(path);
+    std::filesystem::remove(path);
+
+    std::mt19937 random(42);
+    std::uniform_int_distribution<int> answers(0, 1);
+    std::vector<int> history;
+
+    // Прогрев: путь переносится в буфер из пула
+    while (!es->IsFinished()) {
+        es->SetAnswer(answers(random));
+    }
+    es->Reset();
+
+    // Возвраты. Время измеряется только для самих возвратов
+    std::size_t backs = 0;
+    double backNs = 0;
+    const auto before = CurrentAllocationStats();
+    for (std::size_t step = 0; step < steps; ++step) {
+        if (!es->IsFinished()) {
+            es->SetAnswer(answers(random));
+            continue;
+        }
+        const auto depth = random() % es->GetDepth();
+        const auto start = std::chrono::steady_clock::now();
+        es->BackTo(depth);
+        const auto finish = std::chrono::steady_clock::now();
+        backNs += std::chrono::duration<double, std::nano>(finish - start).count();
+        ++backs;
+    }
+    const auto stats = CurrentAllocationStats() - before;
+
+    // То же самое через сброс и повтор ответов
+    es->Reset();
+    history.reserve(options.depth + 1);
+    std::size_t replays = 0;
+    double replayNs = 0;
+    for (std::size_t step = 0; step < steps; ++step) {
+        if (!es->IsFinished()) {
+            const int answer = answers(random);
+            es->SetAnswer(answer);
+            history.push_back(answer);
+            continue;
+        }
+        history.resize(random() % history.size());
+        const auto start = std::chrono::steady_clock::now();
+        es->Reset();
+        for (const auto answer : history) {
+            es->SetAnswer(answer);
+        }
+        const auto finish = std::chrono::steady_clock::now();
+        replayNs += std::chrono::duration<double, std::nano>(finish - start).count();
+        ++replays;
+    }
+
+    std::printf("back: %zu steps, depth %zu\n", steps, options.depth);
+    std::printf("  BackTo:         %8.2f ns/back (%zu backs)\n",
+        backNs / double(backs), backs);
+    std::printf("  Reset + replay: %8.2f ns/back (%zu backs)\n",
+        replayNs / double(replays), replays);
+    std::printf("  allocations: %zu (%zu bytes)\n", stats.allocations, stats.bytes);
+
+    // Память сеансов, стоящих на середине пути
+    std::vector<std::unique_ptr<ES::IExpertSystem>> sessions;
+    sessions.reserve(sessionsCount);
+    const auto sessionsBefore = CurrentAllocationStats();
+    for (std::size_t i = 0; i < sessionsCount; ++i) {
+        auto session = es->CreateSession();
+        for (std::size_t depth = 0; depth < options.depth / 2; ++depth) {
+            session->SetAnswer(answers(random));
+        }
+        sessions.push_back(std::move(session));
+    }
+    const auto sessionsStats = CurrentAllocationStats() - sessionsBefore;
+    std::printf("  %zu sessions at depth %zu: %.1f bytes/session\n",
+        sessionsCount, options.depth / 2,
+        double(sessionsStats.liveBytes) / double(sessionsCount));
+
+    if (stats.allocations != 0) {
+        std::printf("FAILED: back navigation must not allocate\n");
+        return 1;
+    }
+    return 0;
+}
+
+}
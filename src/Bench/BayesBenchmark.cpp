@@ -0,0 +1,84 @@
+﻿#include "Benchmarks.hpp"
+#include "Generator.hpp"
+
+#include "IExpertSystem.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+
+namespace Bench
+{
+
+/**
+ * Бенчмарк вероятностной экспертной системы.
+ * Подаёт ответы на вопросы синтетической модели и измеряет время
+ * обновления оценок всех диагнозов, выбора лучших диагнозов
+ * и отмены ответа.
+ *
+ * \param args Аргументы бенчмарка
+ * \return Код завершения
+ */
+int RunBayesBenchmark(
+    const arguments_t& args)
+{
+    using clock_t = std::chrono::steady_clock;
+    const auto diagnoses = ArgumentOr(args, 0, 100000);
+    const auto questions = std::max<std::size_t>(1, ArgumentOr(args, 1, 64));
+    const auto steps = std::min(questions, ArgumentOr(args, 2, questions));
+    const auto path = GenerateBayesConfig(diagnoses, questions);
+
+    auto es = ES::CreateBayesExpertSystem();
+    auto start = clock_t::now();
+    es->Load(path);
+    const auto loadMs = std::chrono::duration<double, std::milli>(clock_t::now() - start).count();
+    std::filesystem::remove(path);
+    const auto report = es->GetValidationReport();
+    const auto memory = es->GetMemoryReport();
+    std::printf("bayes: %zu diagnoses, %zu questions, %zu likelihoods\n",
+        diagnoses, questions, report.connections);
+    std::printf("  load:   %10.2f ms, %zu bytes, %zu issues\n", loadMs, memory.total, report.total);
+    if (report.total) {
+        return 1;
+    }
+
+    double answerTotal = 0;
+    double answerMax = 0;
+    double topTotal = 0;
+    std::size_t answered = 0;
+    for (std::size_t step = 0; step < steps && !es->IsFinished(); ++step) {
+        start = clock_t::now();
+        es->SetAnswer(static_cast<int>(step % 2));
+        const auto answerNs = std::chrono::duration<double, std::nano>(clock_t::now() - start).count();
+        answerTotal += answerNs;
+        answerMax = std::max(answerMax, answerNs);
+        start = clock_t::now();
+        const auto top = es->GetTopCandidates(10);
+        topTotal += std::chrono::duration<double, std::nano>(clock_t::now() - start).count();
+        if (top.empty()) {
+            return 1;
+        }
+        ++answered;
+    }
+    if (!answered) {
+        return 1;
+    }
+    const auto top = es->GetTopCandidates(1);
+    std::printf("  answer: %10.1f us per update (max %.1f us, %.2f ns per diagnosis), %zu answers\n",
+        answerTotal / 1e3 / double(answered), answerMax / 1e3,
+        answerTotal / double(answered) / double(diagnoses), answered);
+    std::printf("  top 10: %10.1f us, best diagnosis %d with p = %.3f\n",
+        topTotal / 1e3 / double(answered), top.front().nodeID, top.front().probability);
+
+    start = clock_t::now();
+    std::size_t backs = 0;
+    while (es->Back()) {
+        ++backs;
+    }
+    const auto backNs = std::chrono::duration<double, std::nano>(clock_t::now() - start).count();
+    std::printf("  back:   %10.1f us per step\n", backNs / 1e3 / double(std::max<std::size_t>(1, backs)));
+    return backs == answered ? 0 : 1;
+}
+
+}
@@ -0,0 +1,274 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace Bench
+{
+
+// Аргументы командной строки, переданные бенчмарку
+using arguments_t = std::vector<std::string>;
+
+/**
+ * Получение числового аргумента с значением по умолчанию.
+ *
+ * \param args Аргументы бенчмарка
+ * \param index Номер аргумента
+ * \param defaultValue Значение, если аргумент не задан
+ * \return Значение аргумента
+ */
+std::size_t ArgumentOr(
+    const arguments_t& args,
+    const std::size_t index,
+    const std::size_t defaultValue);
+
+/**
+ * Бенчмарк загрузки: время загрузки и количество выделений памяти
+ * на узел синтетической конфигурации.
+ * Аргументы: [глубина дерева] [длина текста узла] [количество повторов]
+ *
+ * \param args Аргументы бенчмарка
+ * \return Код завершения
+ */
+int RunLoadBenchmark(
+    const arguments_t& args);
+
+/**
+ * Бенчмарк перезагрузки: загрузка изменённой конфигурации с нуля
+ * и поверх исходной конфигурации.
+ * Аргументы: [глубина дерева] [изменять каждый N-й узел] [количество повторов]
+ *
+ * \param args Аргументы бенчмарка
+ * \return Код завершения
+ */
+int RunReloadBenchmark(
+    const arguments_t& args);
+
+/**
+ * Бенчмарк прохода по дереву со случайными ответами.
+ * Завершается с ошибкой, если после загрузки хотя бы один
+ * шаг выделил память.
+ * Аргументы: [количество шагов] [глубина дерева] [seed]
+ *
+ * \param args Аргументы бенчмарка
+ * \return Код завершения
+ */
+int RunTraverseBenchmark(
+    const arguments_t& args);
+
+/**
+ * Бенчмарк накладных расходов записи трассы:
+ * время шага без записи трассы и с записью.
+ * Аргументы: [количество шагов] [глубина дерева]
+ *
+ * \param args Аргументы бенчмарка
+ * \return Код завершения
+ */
+int RunTraceBenchmark(
+    const arguments_t& args);
+
+/**
+ * Бенчмарк репликации: время шага при работе многих потоков
+ * с одним общим деревом и с локальными копиями дерева.
+ * Аргументы: [количество потоков] [шагов на поток] [глубина дерева]
+ *
+ * \param args Аргументы бенчмарка
+ * \return Код завершения
+ */
+int RunReplicationBenchmark(
+    const arguments_t& args);
+
+/**
+ * Бенчмарк хранения текстов: занятая память, время шага
+ * и время получения текста для несжатых и сжатых текстов узлов.
+ * Аргументы: [глубина дерева] [длина текста узла] [количество шагов]
+ *
+ * \param args Аргументы бенчмарка
+ * \return Код завершения
+ */
+int RunTextsBenchmark(
+    const arguments_t& args);
+
+/**
+ * Бенчмарк языков: время загрузки и память, добавленная
+ * каждым языком при создании первого сеанса на нём.
+ * Аргументы: [глубина дерева] [длина текста узла] [количество языков]
+ *
+ * \param args Аргументы бенчмарка
+ * \return Код завершения
+ */
+int RunLanguagesBenchmark(
+    const arguments_t& args);
+
+/**
+ * Бенчмарк возврата к предыдущим вопросам в сравнении
+ * со сбросом и повтором ответов, и память на один сеанс.
+ * Аргументы: [шаги] [глубина дерева] [количество сеансов]
+ *
+ * \param args Аргументы бенчмарка
+ * \return Код завершения
+ */
+int RunBackBenchmark(
+    const arguments_t& args);
+
+/**
+ * Бенчмарк запросов к оставшимся ответам сеанса.
+ * Аргументы: [запросы] [глубина дерева]
+ *
+ * \param args Аргументы бенчмарка
+ * \return Код завершения
+ */
+int RunCandidatesBenchmark(
+    const arguments_t& args);
+
+/**
+ * Бенчмарк получения путей до узлов и перехода к узлу.
+ * Аргументы: [запросы] [глубина дерева]
+ *
+ * \param args Аргументы бенчмарка
+ * \return Код завершения
+ */
+int RunPathsBenchmark(
+    const arguments_t& args);
+
+/**
+ * Нагрузочный бенчмарк: случайные сеансы во многих потоках
+ * одновременно с перезагрузками конфигурации и записью в лог.
+ * Аргументы: [секунды] [потоки] [глубина дерева] [период перезагрузки в мс]
+ *
+ * \param args Аргументы бенчмарка
+ * \return Код завершения
+ */
+int RunStressBenchmark(
+    const arguments_t& args);
+
+/**
+ * Бенчмарк построения дерева по размеченным данным.
+ * Аргументы: [строки] [признаки] [потоки]
+ *
+ * \param args Аргументы бенчмарка
+ * \return Код завершения
+ */
+int RunLearnBenchmark(
+    const arguments_t& args);
+
+/**
+ * Бенчмарк журнала сеансов: стоимость шага и восстановление.
+ * Аргументы: [сеансы] [шаги] [глубина дерева]
+ *
+ * \param args Аргументы бенчмарка
+ * \return Код завершения
+ */
+int RunJournalBenchmark(
+    const arguments_t& args);
+
+/**
+ * Бенчмарк учёта памяти: отчёт о памяти базы знаний,
+ * её освобождение и бюджет памяти.
+ * Аргументы: [глубина дерева] [длина текста узла]
+ *
+ * \param args Аргументы бенчмарка
+ * \return Код завершения
+ */
+int RunMemoryBenchmark(
+    const arguments_t& args);
+
+/**
+ * Бенчмарк полнотекстового поиска: загрузка с построением индекса
+ * и задержка запросов.
+ * Аргументы: [глубина дерева] [размер словаря] [запросы]
+ *
+ * \param args Аргументы бенчмарка
+ * \return Код завершения
+ */
+int RunSearchBenchmark(
+    const arguments_t& args);
+
+/**
+ * Бенчмарк пакетной загрузки: последовательная и параллельная
+ * загрузка набора баз знаний разного размера.
+ * Аргументы: [базы] [глубина дерева] [потоки]
+ *
+ * \param args Аргументы бенчмарка
+ * \return Код завершения
+ */
+int RunBulkBenchmark(
+    const arguments_t& args);
+
+/**
+ * Бенчмарк проверки графа при загрузке в одном и нескольких потоках.
+ * Аргументы: [глубина дерева] [потоки]
+ *
+ * \param args Аргументы бенчмарка
+ * \return Код завершения
+ */
+int RunValidateBenchmark(
+    const arguments_t& args);
+
+/**
+ * Бенчмарк поиска узлов по идентификаторам: загрузка, память индекса
+ * и поиск для идентификаторов подряд и разреженных идентификаторов.
+ * Аргументы: [глубина дерева] [запросы]
+ *
+ * \param args Аргументы бенчмарка
+ * \return Код завершения
+ */
+int RunIdsBenchmark(
+    const arguments_t& args);
+
+/**
+ * Бенчмарк таблицы сеансов в разделяемой памяти: чтение и изменение
+ * сеансов процессами, которые периодически убиваются.
+ * Аргументы: [процессы] [сеансы] [секунды]
+ *
+ * \param args Аргументы бенчмарка
+ * \return Код завершения
+ */
+int RunSessionsBenchmark(
+    const arguments_t& args);
+
+/**
+ * Бенчмарк вероятностной экспертной системы: обновление оценок
+ * всех диагнозов после ответа, выбор лучших диагнозов и отмена ответов.
+ * Аргументы: [диагнозы] [вопросы] [ответы]
+ *
+ * \param args Аргументы бенчмарка
+ * \return Код завершения
+ */
+int RunBayesBenchmark(
+    const arguments_t& args);
+
+/**
+ * Бенчмарк перестройки дерева по частотам ответов: ожидаемое количество
+ * вопросов до и после и совпадение ответов в случайных сеансах.
+ * Аргументы: [глубина дерева] [значимые уровни] [сеансы]
+ *
+ * \param args Аргументы бенчмарка
+ * \return Код завершения
+ */
+int RunOptimizeBenchmark(
+    const arguments_t& args);
+
+/**
+ * Бенчмарк разбора xml-конфигурации сканером схемы и pugixml.
+ * Аргументы: [глубина дерева] [длина текста] [повторы]
+ *
+ * \param args Аргументы бенчмарка
+ * \return Код завершения
+ */
+int RunXmlBenchmark(
+    const arguments_t& args);
+
+/**
+ * Бенчмарк кластера шардов: пропускная способность при 1..N шардах
+ * и перенос сеансов при добавлении и удалении шарда.
+ * Аргументы: [шарды] [сеансы] [глубина дерева]
+ *
+ * \param args Аргументы бенчмарка
+ * \return Код завершения
+ */
+int RunClusterBenchmark(
+    const arguments_t& args);
+
+}
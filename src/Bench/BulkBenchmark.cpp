@@ -0,0 +1,69 @@
+﻿#include "Benchmarks.hpp"
+#include "Generator.hpp"
+
+#include "BulkLoader.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace Bench
+{
+
+/**
+ * Бенчмарк пакетной загрузки баз знаний.
+ * Генерирует базы разного размера, одна из которых вчетверо больше
+ * остальных, и загружает их последовательно и параллельно.
+ * Параллельная загрузка должна занимать время, близкое к загрузке
+ * самой большой базы. Несуществующая необязательная база
+ * проверяет, что ошибка не прерывает пакет и не мешает готовности.
+ *
+ * \param args Аргументы бенчмарка
+ * \return Код завершения
+ */
+int RunBulkBenchmark(
+    const arguments_t& args)
+{
+    const std::size_t count = ArgumentOr(args, 0, 32);
+    const std::size_t depth = ArgumentOr(args, 1, 14);
+    const std::size_t threads = ArgumentOr(args, 2, 0);
+
+    std::vector<ES::KnowledgeBaseEntry> entries;
+    for (std::size_t i = 0; i < count; ++i) {
+        GeneratorOptions options;
+        options.depth = i == 0 ? depth + 2 : depth - std::min<std::size_t>(depth, i % 4);
+        // Разная длина текстов даёт разные файлы
+        options.textLength = 48 + i;
+        entries.push_back({ GenerateConfig(options), true });
+    }
+    entries.push_back({ (std::filesystem::temp_directory_path() / "es_bench_missing.xml").string(), false });
+
+    std::printf("bulk: %zu bases, depth %zu, largest depth %zu\n", count, depth, depth + 2);
+    int result = 0;
+    for (const auto parallel : { false, true }) {
+        ES::BulkLoadOptions options;
+        options.threads = parallel ? threads : 1;
+        options.readahead = parallel;
+        const auto report = ES::LoadKnowledgeBases(entries, options);
+        double largest = 0;
+        for (const auto& base : report.bases) {
+            largest = std::max(largest, base.loadMs);
+        }
+        std::printf("  %-10s total %9.2f ms, ready %9.2f ms, sum %9.2f ms, "
+            "largest %9.2f ms, loaded %zu, failed %zu\n",
+            parallel ? "parallel" : "sequential", report.totalMs, report.readyMs,
+            report.sequentialMs, largest, report.loaded, report.failed);
+        if (!report.ready || report.loaded != count || report.failed != 1) {
+            std::printf("FAILED: required bases are not loaded\n");
+            result = 1;
+        }
+    }
+    for (std::size_t i = 0; i < count; ++i) {
+        std::filesystem::remove(entries[i].path);
+    }
+    return result;
+}
+
+}
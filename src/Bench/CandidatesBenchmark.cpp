@@ -0,0 +1,84 @@
+﻿#include "Benchmarks.hpp"
+#include "Generator.hpp"
+
+#include "IExpertSystem.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <random>
+
+namespace Bench
+{
+
+/**
+ * Бенчмарк запросов к оставшимся ответам.
+ * Сеанс спускается на случайную глубину, после чего
+ * измеряется время запросов количества оставшихся ответов,
+ * проверки отдельного ответа, пересечения с множеством
+ * другого узла и получения всего списка.
+ *
+ * \param args Аргументы бенчмарка
+ * \return Код завершения
+ */
+int RunCandidatesBenchmark(
+    const arguments_t& args)
+{
+    const std::size_t queries = ArgumentOr(args, 0, 100000);
+    GeneratorOptions options;
+    options.depth = ArgumentOr(args, 1, 16);
+
+    const auto path = GenerateConfig(options);
+    auto es = ES::CreateExpertSystem();
+    auto start = std::chrono::steady_clock::now();
+    es->Load(path);
+    auto finish = std::chrono::steady_clock::now();
+    std::filesystem::remove(path);
+    std::printf("candidates: depth %zu, load %.2f ms\n", options.depth,
+        std::chrono::duration<double, std::milli>(finish - start).count());
+
+    // Идентификаторы узлов в сгенерированной конфигурации идут подряд с 1
+    const int nodes = (1 << (options.depth + 1)) - 1;
+    std::mt19937 random(42);
+    std::uniform_int_distribution<int> ids(1, nodes);
+    double countNs = 0;
+    double containsNs = 0;
+    double commonNs = 0;
+    double listNs = 0;
+    std::size_t total = 0;
+    for (std::size_t query = 0; query < queries; ++query) {
+        es->Reset();
+        const auto depth = random() % options.depth;
+        for (std::size_t step = 0; step < depth; ++step) {
+            es->SetAnswer(random() % 2);
+        }
+        start = std::chrono::steady_clock::now();
+        total += es->GetCandidatesCount();
+        finish = std::chrono::steady_clock::now();
+        countNs += std::chrono::duration<double, std::nano>(finish - start).count();
+
+        const auto id = ids(random);
+        start = std::chrono::steady_clock::now();
+        total += es->IsCandidate(id) ? 1 : 0;
+        finish = std::chrono::steady_clock::now();
+        containsNs += std::chrono::duration<double, std::nano>(finish - start).count();
+
+        start = std::chrono::steady_clock::now();
+        total += es->GetCommonCandidatesCount(ids(random));
+        finish = std::chrono::steady_clock::now();
+        commonNs += std::chrono::duration<double, std::nano>(finish - start).count();
+
+        start = std::chrono::steady_clock::now();
+        total += es->GetCandidates().size();
+        finish = std::chrono::steady_clock::now();
+        listNs += std::chrono::duration<double, std::nano>(finish - start).count();
+    }
+    std::printf("  count:        %10.2f ns\n", countNs / double(queries));
+    std::printf("  contains:     %10.2f ns\n", containsNs / double(queries));
+    std::printf("  intersection: %10.2f ns\n", commonNs / double(queries));
+    std::printf("  list:         %10.2f ns\n", listNs / double(queries));
+    std::printf("  checksum: %zu\n", total);
+    return 0;
+}
+
+}
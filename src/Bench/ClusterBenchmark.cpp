@@ -0,0 +1,161 @@
+﻿#include "Benchmarks.hpp"
+#include "Generator.hpp"
+
+#include "IShardCluster.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+namespace Bench
+{
+
+#if defined(__unix__)
+
+/**
+ * Прогон запросов через кластер.
+ *
+ * \param cluster Кластер шардов
+ * \param path Путь к файлу запросов
+ * \param output Ответы кластера
+ * \return Время прогона, с
+ */
+static double RunRequests(
+    ES::IShardCluster& cluster,
+    const std::filesystem::path& path,
+    std::string& output)
+{
+    std::FILE* input = std::fopen(path.string().c_str(), "rb");
+    std::FILE* result = std::tmpfile();
+    if (!input || !result) {
+        throw std::runtime_error(u8"Не удалось открыть " + path.string());
+    }
+    const auto start = std::chrono::steady_clock::now();
+    cluster.Run(fileno(input), result);
+    const auto finish = std::chrono::steady_clock::now();
+    output.resize(static_cast<std::size_t>(std::ftell(result)));
+    std::rewind(result);
+    output.resize(std::fread(output.data(), 1, output.size(), result));
+    std::fclose(input);
+    std::fclose(result);
+    return std::chrono::duration<double>(finish - start).count();
+}
+
+/**
+ * Бенчмарк кластера шардов.
+ * Одни и те же сеансы прогоняются через кластеры из 1..N шардов:
+ * ответы должны совпадать, а пропускная способность - расти
+ * с числом шардов, пока хватает ядер. Затем в кластер из N шардов
+ * добавляется шард и удаляется снова: переноситься должна примерно
+ * 1/(N+1) часть сеансов, а состояние сеансов - сохраняться.
+ *
+ * \param args Аргументы бенчмарка
+ * \return Код завершения
+ */
+int RunClusterBenchmark(
+    const arguments_t& args)
+{
+    const std::size_t maxShards = ArgumentOr(args, 0, 4);
+    const std::size_t sessions = ArgumentOr(args, 1, 20000);
+    GeneratorOptions options;
+    options.depth = ArgumentOr(args, 2, 14);
+
+    const auto config = GenerateConfig(options);
+    auto es = ES::CreateExpertSystem();
+    es->Load(config);
+    std::filesystem::remove(config);
+
+    // Сеансы открываются, проходят дерево со случайными ответами
+    // и возвращаются на шаг назад. Идентификаторы сеансов выдаются
+    // кластером по порядку, начиная с 1
+    const auto directory = std::filesystem::temp_directory_path();
+    const auto requestsPath = directory / "es-cluster-requests.txt";
+    const auto queryPath = directory / "es-cluster-query.txt";
+    std::size_t requests = 0;
+    {
+        std::mt19937 random(42);
+        std::ofstream requestsFile(requestsPath, std::ios::binary);
+        std::ofstream queryFile(queryPath, std::ios::binary);
+        for (std::size_t i = 0; i < sessions; ++i) {
+            requestsFile << "new\n";
+        }
+        for (std::size_t step = 0; step < options.depth; ++step) {
+            for (std::size_t i = 1; i <= sessions; ++i) {
+                requestsFile << i << ' ' << (random() & 1) << '\n';
+            }
+        }
+        for (std::size_t i = 1; i <= sessions; ++i) {
+            requestsFile << i << " b\n";
+            queryFile << i << '\n';
+        }
+        requests = sessions * (options.depth + 2);
+    }
+
+    // Шарды ускоряют обработку, только пока им хватает ядер
+    std::printf("cluster: %zu sessions, %zu requests, depth %zu, %u cores\n",
+        sessions, requests, options.depth, std::thread::hardware_concurrency());
+    bool failed = false;
+    std::string expected;
+    double baseline = 0;
+    for (std::size_t shards = 1; shards <= maxShards; ++shards) {
+        ES::ShardClusterOptions clusterOptions;
+        clusterOptions.shards = shards;
+        clusterOptions.sessions = sessions;
+        auto cluster = ES::CreateShardCluster(*es, clusterOptions);
+        std::string output;
+        const double seconds = RunRequests(*cluster, requestsPath, output);
+        const double rate = double(requests) / seconds;
+        if (shards == 1) {
+            expected = std::move(output);
+            baseline = rate;
+        }
+        else if (output != expected) {
+            std::printf("FAILED: %zu shards answered differently\n", shards);
+            failed = true;
+        }
+        std::printf("  %2zu shards: %10.0f requests/s, x%.2f\n", shards, rate, rate / baseline);
+    }
+
+    // Перераспределение открытых сеансов
+    ES::ShardClusterOptions clusterOptions;
+    clusterOptions.shards = maxShards;
+    clusterOptions.sessions = sessions;
+    auto cluster = ES::CreateShardCluster(*es, clusterOptions);
+    std::string output;
+    RunRequests(*cluster, requestsPath, output);
+    std::string before;
+    RunRequests(*cluster, queryPath, before);
+    for (const auto shards : { maxShards + 1, maxShards }) {
+        const auto report = cluster->Resize(shards);
+        std::string after;
+        RunRequests(*cluster, queryPath, after);
+        std::printf("  %2zu -> %2zu shards: moved %zu of %zu sessions (%.1f%%, ideal %.1f%%), %.2f ms\n",
+            report.before, report.after, report.moved, report.sessions,
+            100.0 * double(report.moved) / double(report.sessions), 100.0 / double(maxShards + 1), report.ms);
+        if (report.lost || after != before) {
+            std::printf("FAILED: sessions were lost or changed by rebalancing\n");
+            failed = true;
+        }
+    }
+    std::filesystem::remove(requestsPath);
+    std::filesystem::remove(queryPath);
+    return failed ? 1 : 0;
+}
+
+#else
+
+int RunClusterBenchmark(
+    const arguments_t&)
+{
+    std::printf("cluster: not supported on this platform\n");
+    return 0;
+}
+
+#endif
+
+}
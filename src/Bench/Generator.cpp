@@ -0,0 +1,267 @@
+﻿#include "Generator.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+namespace Bench
+{
+
+/**
+ * Формирование текста узла заданной длины.
+ *
+ * \param prefix Префикс текста
+ * \param id Идентификатор узла
+ * \param length Длина текста
+ * \return Текст узла
+ */
+static std::string MakeText(
+    const char* prefix,
+    const std::size_t id,
+    const std::size_t length)
+{
+    std::string text = prefix + std::to_string(id) + " ";
+    // Дополняем текст до нужной длины повторяющимся алфавитом
+    while (text.size() < length) {
+        text.push_back(static_cast<char>('a' + text.size() % 26));
+    }
+    return text;
+}
+
+/**
+ * Формирование кириллического слова по его номеру.
+ * Номер записывается слогами "согласная + гласная", не меньше двух слогов,
+ * поэтому разные номера дают разные слова.
+ *
+ * \param rank Номер слова
+ * \return Слово в UTF-8
+ */
+static std::string MakeWord(
+    std::size_t rank)
+{
+    // Строчные согласные и гласные в виде смещений от "а" (U+0430)
+    static const char consonants[] = { 1, 2, 3, 4, 6, 7, 10, 11, 12, 13, 15, 16, 17, 18, 20, 21, 22, 23, 24 };
+    static const char vowels[] = { 0, 5, 8, 14, 19, 31 };
+    constexpr std::size_t syllables = sizeof(consonants) * sizeof(vowels);
+    std::string word;
+    for (std::size_t count = 0; count < 2 || rank; ++count, rank /= syllables) {
+        const auto syllable = rank % syllables;
+        for (const auto letter : { consonants[syllable / sizeof(vowels)], vowels[syllable % sizeof(vowels)] }) {
+            const auto code = 0x430 + letter;
+            word.push_back(static_cast<char>(0xC0 | (code >> 6)));
+            word.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+        }
+    }
+    return word;
+}
+
+/**
+ * Формирование текста узла из слов словаря.
+ * Слова выбираются по закону Ципфа, первое слово
+ * начинается с заглавной буквы.
+ *
+ * \param id Идентификатор узла
+ * \param length Длина текста в байтах
+ * \param weights Накопленные веса слов словаря
+ * \return Текст узла
+ */
+static std::string MakeWordsText(
+    const std::size_t id,
+    const std::size_t length,
+    const std::vector<double>& weights)
+{
+    std::mt19937_64 random(id);
+    std::uniform_real_distribution<double> uniform(0, weights.back());
+    std::string text;
+    while (text.size() < length) {
+        const auto rank = std::upper_bound(weights.begin(), weights.end(), uniform(random))
+            - weights.begin();
+        auto word = MakeWord(static_cast<std::size_t>(rank));
+        if (text.empty()) {
+            // Заглавная буква: код меньше на 0x20
+            auto code = ((word[0] & 0x1F) << 6 | (word[1] & 0x3F)) - 0x20;
+            word[0] = static_cast<char>(0xC0 | (code >> 6));
+            word[1] = static_cast<char>(0x80 | (code & 0x3F));
+        }
+        else {
+            text.push_back(' ');
+        }
+        text += word;
+    }
+    return text;
+}
+
+/**
+ * Получение идентификатора узла в сгенерированной конфигурации.
+ * Умножение на нечётное число по модулю 2^31 взаимно однозначно,
+ * поэтому разреженные идентификаторы не повторяются.
+ *
+ * \param index Номер узла в двоичной куче, начиная с 1
+ * \param options Параметры конфигурации
+ * \return Идентификатор узла
+ */
+std::size_t NodeID(
+    const std::size_t index,
+    const GeneratorOptions& options) noexcept
+{
+    return options.sparseIds ? (index * 0x9E3779B1u) & 0x7FFFFFFFu : index;
+}
+
+/**
+ * Генерация синтетической конфигурации экспертной системы
+ * во временный xml-файл.
+ * Узлы нумеруются как в двоичной куче: у вопроса с идентификатором id
+ * дочерние узлы 2*id (ответ 1) и 2*id+1 (ответ 0).
+ *
+ * \param options Параметры конфигурации
+ * \return Путь к созданному файлу
+ */
+std::string GenerateConfig(
+    const GeneratorOptions& options) noexcept(false)
+{
+    const std::size_t questions = (std::size_t(1) << options.depth) - 1;
+    const std::size_t relevant = std::min(options.relevantLevels, options.depth);
+    const std::size_t nodes = relevant ? questions + (std::size_t(1) << relevant)
+        : (std::size_t(1) << (options.depth + 1)) - 1;
+    // Номер узла-ответа для места ответа в двоичной куче
+    const auto answerIndex = [&](const std::size_t index)
+    {
+        return relevant && index > questions
+            ? questions + 1 + (index & ((std::size_t(1) << relevant) - 1)) : index;
+    };
+
+    const auto path = std::filesystem::temp_directory_path()
+        / ("es_bench_" + std::to_string(options.depth)
+            + "_" + std::to_string(options.textLength)
+            + "_" + std::to_string(options.changeEvery)
+            + "_" + std::to_string(options.languages)
+            + "_" + std::to_string(options.vocabulary)
+            + (options.sparseIds ? "_sparse" : "")
+            + (relevant ? "_r" + std::to_string(relevant) : "") + ".xml");
+    std::vector<double> weights;
+    for (std::size_t rank = 1; rank <= options.vocabulary; ++rank) {
+        weights.push_back((weights.empty() ? 0.0 : weights.back()) + 1.0 / double(rank));
+    }
+
+    std::ofstream out(path, std::ios::binary);
+    if (!out) {
+        throw std::runtime_error(u8"Не удалось создать " + path.string());
+    }
+    out << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<es>\n"
+        << "    <name>Synthetic " << options.depth << "</name>\n";
+    if (options.languages) {
+        out << "    <languages>\n";
+        for (std::size_t language = 1; language <= options.languages; ++language) {
+            out << "        <language code=\"l" << language << "\" path=\""
+                << path.filename().string() << ".l" << language << "\" />\n";
+        }
+        out << "    </languages>\n";
+    }
+    out << "    <tree>\n        <nodes>\n";
+    for (std::size_t id = 1; id <= nodes; ++id) {
+        const bool question = id <= questions;
+        const bool changed = options.changeEvery && id % options.changeEvery == 0;
+        out << "            <node type=\"" << (question ? "question" : "answer")
+            << "\" id=\"" << NodeID(id, options) << "\">"
+            << (relevant && question
+                ? MakeText("Level ", static_cast<std::size_t>(std::log2(double(id))), options.textLength)
+                : options.vocabulary && !changed
+                ? MakeWordsText(id, options.textLength, weights)
+                : MakeText(changed ? "Changed " : question ? "Question " : "Answer ",
+                    id, options.textLength))
+            << "</node>\n";
+    }
+    out << "        </nodes>\n        <connections>\n";
+    for (std::size_t id = 1; id <= questions; ++id) {
+        out << "            <connection src=\"" << NodeID(id, options)
+            << "\" dst=\"" << NodeID(answerIndex(2 * id), options) << "\" predicat=\"1\" />\n"
+            << "            <connection src=\"" << NodeID(id, options)
+            << "\" dst=\"" << NodeID(answerIndex(2 * id + 1), options)
+            << "\" predicat=\"0\" />\n";
+    }
+    out << "        </connections>\n    </tree>\n</es>\n";
+    if (!out) {
+        throw std::runtime_error(u8"Не удалось записать " + path.string());
+    }
+    // Файлы языков: те же тексты с префиксом кода языка
+    for (std::size_t language = 1; language <= options.languages; ++language) {
+        const auto code = "l" + std::to_string(language);
+        const auto languagePath = path.string() + "." + code;
+        std::ofstream texts(languagePath, std::ios::binary);
+        texts << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<es>\n"
+            << "    <name>Synthetic " << options.depth << " " << code << "</name>\n"
+            << "    <texts>\n";
+        for (std::size_t id = 1; id <= nodes; ++id) {
+            texts << "        <text id=\"" << NodeID(id, options) << "\">"
+                << MakeText((code + " ").c_str(), id, options.textLength) << "</text>\n";
+        }
+        texts << "    </texts>\n</es>\n";
+        if (!texts) {
+            throw std::runtime_error(u8"Не удалось записать " + languagePath);
+        }
+    }
+    return path.string();
+}
+
+/**
+ * Генерация синтетической конфигурации вероятностной экспертной
+ * системы во временный xml-файл.
+ * Диагнозы получают идентификаторы 1..diagnoses, вопросы - следующие.
+ *
+ * \param diagnoses Количество диагнозов
+ * \param questions Количество вопросов
+ * \return Путь к созданному файлу
+ */
+std::string GenerateBayesConfig(
+    const std::size_t diagnoses,
+    const std::size_t questions) noexcept(false)
+{
+    const auto path = std::filesystem::temp_directory_path()
+        / ("es_bench_bayes_" + std::to_string(diagnoses)
+            + "_" + std::to_string(questions) + ".xml");
+    std::ofstream out(path, std::ios::binary);
+    if (!out) {
+        throw std::runtime_error(u8"Не удалось создать " + path.string());
+    }
+    out << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<es>\n"
+        << "    <name>Synthetic Bayes " << diagnoses << "</name>\n"
+        << "    <bayes>\n        <diagnoses>\n";
+    for (std::size_t id = 1; id <= diagnoses; ++id) {
+        out << "            <diagnosis id=\"" << id << "\">"
+            << MakeText("Diagnosis ", id, 32) << "</diagnosis>\n";
+    }
+    out << "        </diagnoses>\n        <questions>\n";
+    for (std::size_t question = 1; question <= questions; ++question) {
+        out << "            <question id=\"" << diagnoses + question << "\" answers=\"2\">"
+            << MakeText("Question ", question, 32) << "</question>\n";
+    }
+    out << "        </questions>\n        <likelihoods>\n";
+    std::mt19937_64 random(diagnoses * 31 + questions);
+    std::uniform_int_distribution<int> sparse(0, 9);
+    // Вероятность ответа 1 кратна 0.05, чтобы сумма двух вероятностей
+    // с двумя знаками была точно равна 1
+    std::uniform_int_distribution<int> percent(1, 19);
+    for (std::size_t question = 1; question <= questions; ++question) {
+        for (std::size_t id = 1; id <= diagnoses; ++id) {
+            if (sparse(random)) {
+                continue;
+            }
+            const auto yes = percent(random) * 5;
+            out << "            <likelihood question=\"" << diagnoses + question
+                << "\" diagnosis=\"" << id << "\">0."
+                << (100 - yes) / 10 << (100 - yes) % 10
+                << " 0." << yes / 10 << yes % 10 << "</likelihood>\n";
+        }
+    }
+    out << "        </likelihoods>\n    </bayes>\n</es>\n";
+    if (!out) {
+        throw std::runtime_error(u8"Не удалось записать " + path.string());
+    }
+    return path.string();
+}
+
+}
@@ -0,0 +1,74 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace Bench
+{
+
+/**
+ * Параметры синтетической конфигурации.
+ * Генерируется полное бинарное дерево заданной глубины:
+ * 2^depth - 1 вопросов и 2^depth ответов.
+ */
+struct GeneratorOptions
+{
+    // Глубина дерева (количество вопросов на пути от корня до ответа)
+    std::size_t depth = 16;
+    // Длина текста узла в байтах
+    std::size_t textLength = 64;
+    // Изменить текст каждого changeEvery-го узла (0 - не изменять).
+    // Используется для получения следующей версии конфигурации
+    std::size_t changeEvery = 0;
+    // Количество дополнительных языков. Файлы языков
+    // создаются рядом с конфигурацией, коды языков - l1, l2, ...
+    std::size_t languages = 0;
+    // Количество различных слов в текстах узлов. Если не 0, то тексты
+    // составляются из кириллических слов с частотами по закону Ципфа,
+    // иначе - из повторяющегося латинского алфавита
+    std::size_t vocabulary = 0;
+    // Разреженные 31-битные идентификаторы узлов вместо 1, 2, 3, ...
+    bool sparseIds = false;
+    // Если не 0, то вопросы одного уровня имеют одинаковый текст,
+    // а ответ зависит только от ответов на последние relevantLevels
+    // вопросов пути: ответов 2^relevantLevels, и к каждому ведёт много путей
+    std::size_t relevantLevels = 0;
+};
+
+/**
+ * Получение идентификатора узла в сгенерированной конфигурации.
+ *
+ * \param index Номер узла в двоичной куче, начиная с 1
+ * \param options Параметры конфигурации
+ * \return Идентификатор узла
+ */
+std::size_t NodeID(
+    const std::size_t index,
+    const GeneratorOptions& options) noexcept;
+
+/**
+ * Генерация синтетической конфигурации экспертной системы
+ * во временный xml-файл.
+ *
+ * \param options Параметры конфигурации
+ * \return Путь к созданному файлу. Файлы языков называются
+ * так же с суффиксом .l1, .l2, ...
+ */
+std::string GenerateConfig(
+    const GeneratorOptions& options) noexcept(false);
+
+/**
+ * Генерация синтетической конфигурации вероятностной экспертной
+ * системы во временный xml-файл. На каждый вопрос с двумя ответами
+ * задаются вероятности примерно для каждого десятого диагноза,
+ * для остальных ответы равновероятны.
+ *
+ * \param diagnoses Количество диагнозов
+ * \param questions Количество вопросов
+ * \return Путь к созданному файлу
+ */
+std::string GenerateBayesConfig(
+    const std::size_t diagnoses,
+    const std::size_t questions) noexcept(false);
+
+}
@@ -0,0 +1,152 @@
+﻿#include "Benchmarks.hpp"
+#include "AllocationCounter.hpp"
+#include "Generator.hpp"
+
+#include "IExpertSystem.hpp"
+#include "IExpertSystemLoader.hpp"
+#include "NodeIdIndex.hpp"
+#include "Tree.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <map>
+#include <memory_resource>
+#include <random>
+#include <vector>
+
+namespace Bench
+{
+
+/**
+ * Среднее время одного запроса.
+ *
+ * \param ids Идентификаторы запросов
+ * \param lookup Поиск по идентификатору: true, если узел найден
+ * \param found Количество найденных узлов
+ * \return Время запроса в наносекундах
+ */
+template<typename Lookup>
+static double MeasureLookup(
+    const std::vector<ES::node_id_t>& ids,
+    const Lookup& lookup,
+    std::size_t& found)
+{
+    found = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (const auto id : ids) {
+        found += lookup(id);
+    }
+    const auto finish = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(finish - start).count() / double(ids.size());
+}
+
+/**
+ * Прогон загрузки и поиска узлов по идентификаторам
+ * для одного способа нумерации узлов.
+ * Поиск измеряется через сеанс, напрямую в дереве, в индексе
+ * узлов без дерева и в std::map тех же идентификаторов.
+ *
+ * \param options Параметры конфигурации
+ * \param queries Количество запросов
+ * \return false, если узел не найден
+ */
+static bool RunIds(
+    const GeneratorOptions& options,
+    const std::size_t queries)
+{
+    const auto path = GenerateConfig(options);
+    const auto before = CurrentAllocationStats();
+    const auto start = std::chrono::steady_clock::now();
+    auto es = ES::CreateExpertSystem();
+    es->Load(path);
+    const auto finish = std::chrono::steady_clock::now();
+    const auto loaded = CurrentAllocationStats() - before;
+    ES::Tree tree;
+    ES::CreateExpertSystemLoader()->Load(path, tree);
+    tree.Finish();
+    std::filesystem::remove(path);
+    const auto nodes = (std::size_t(1) << (options.depth + 1)) - 1;
+    const auto report = es->GetMemoryReport();
+    std::printf("  %-6s load %8.2f ms, %zu allocations, indices %zu bytes (%.2f per node)\n",
+        options.sparseIds ? "sparse" : "dense",
+        std::chrono::duration<double, std::milli>(finish - start).count(),
+        loaded.allocations, report.indices, double(report.indices) / double(nodes));
+
+    // Индекс узлов и std::map по тем же идентификаторам
+    std::vector<ES::NodeIdIndex::entry_t> entries;
+    std::map<ES::node_id_t, ES::node_index_t> map;
+    const auto mapBefore = CurrentAllocationStats();
+    for (std::size_t i = 0; i < tree.NodesCount(); ++i) {
+        const auto node = tree.GetNode(static_cast<ES::node_index_t>(i));
+        if (node) {
+            map.emplace(node->ID(), static_cast<ES::node_index_t>(i));
+        }
+    }
+    const auto mapBytes = static_cast<std::size_t>((CurrentAllocationStats() - mapBefore).liveBytes);
+    entries.assign(map.begin(), map.end());
+    std::vector<ES::node_index_t> duplicates;
+    const ES::NodeIdIndex index(entries, std::pmr::new_delete_resource(), duplicates);
+
+    // Из корня достижим любой ответ, поэтому каждый запрос
+    // сводится к поиску узла по идентификатору и проверке бита
+    const auto questions = (nodes - 1) / 2;
+    std::mt19937 random(42);
+    std::uniform_int_distribution<std::size_t> answers(questions + 1, nodes);
+    std::vector<ES::node_id_t> ids(queries);
+    for (auto& id : ids) {
+        id = static_cast<ES::node_id_t>(NodeID(answers(random), options));
+    }
+    std::size_t found[4];
+    const auto session = MeasureLookup(ids, [&es](const ES::node_id_t id) {
+        return es->IsCandidate(id);
+    }, found[0]);
+    const auto direct = MeasureLookup(ids, [&tree](const ES::node_id_t id) {
+        return tree.FindNode(id) != ES::kInvalidIndex;
+    }, found[1]);
+    const auto hashed = MeasureLookup(ids, [&index, &tree](const ES::node_id_t id) {
+        const auto node = tree.GetNode(index.Find(id));
+        return node && node->ID() == id;
+    }, found[2]);
+    const auto ordered = MeasureLookup(ids, [&map](const ES::node_id_t id) {
+        return map.find(id) != map.end();
+    }, found[3]);
+    std::printf("         IsCandidate %6.2f ns, FindNode %6.2f ns\n", session, direct);
+    std::printf("         NodeIdIndex %10zu bytes (%5.2f per node), lookup %6.2f ns\n",
+        index.MemoryBytes(), double(index.MemoryBytes()) / double(nodes), hashed);
+    std::printf("         std::map    %10zu bytes (%5.2f per node), lookup %6.2f ns\n",
+        mapBytes, double(mapBytes) / double(nodes), ordered);
+    for (const auto count : found) {
+        if (count != queries) {
+            std::printf("FAILED: %zu of %zu answers found\n", count, queries);
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Бенчмарк поиска узлов по идентификаторам.
+ * Сравнивает загрузку, память индекса узлов и поиск по идентификатору
+ * для идентификаторов подряд и разреженных 31-битных идентификаторов,
+ * а также память и поиск индекса узлов и std::map.
+ *
+ * \param args Аргументы бенчмарка
+ * \return Код завершения
+ */
+int RunIdsBenchmark(
+    const arguments_t& args)
+{
+    GeneratorOptions options;
+    options.depth = ArgumentOr(args, 0, 18);
+    const std::size_t queries = ArgumentOr(args, 1, 1000000);
+    std::printf("ids: %zu nodes, %zu queries\n",
+        (std::size_t(1) << (options.depth + 1)) - 1, queries);
+    if (!RunIds(options, queries)) {
+        return 1;
+    }
+    options.sparseIds = true;
+    return RunIds(options, queries) ? 0 : 1;
+}
+
+}
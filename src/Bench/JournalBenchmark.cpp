@@ -0,0 +1,160 @@
+﻿#include "Benchmarks.hpp"
+#include "Generator.hpp"
+
+#include "IExpertSystem.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace Bench
+{
+
+/**
+ * Случайные шаги по сеансам.
+ * Завершённый сеанс возвращается на случайную глубину либо сбрасывается.
+ *
+ * \param sessions Сеансы
+ * \param steps Количество шагов
+ * \param random Генератор случайных чисел
+ * \return Время шагов в наносекундах
+ */
+static double Walk(
+    std::vector<std::unique_ptr<ES::IExpertSystem>>& sessions,
+    const std::size_t steps,
+    std::mt19937& random)
+{
+    const auto start = std::chrono::steady_clock::now();
+    for (std::size_t step = 0; step < steps; ++step) {
+        auto& session = *sessions[random() % sessions.size()];
+        if (!session.IsFinished()) {
+            session.SetAnswer(static_cast<int>(random() & 1));
+        }
+        else if (random() & 1) {
+            session.BackTo(random() % session.GetDepth());
+        }
+        else {
+            session.Reset();
+        }
+    }
+    const auto finish = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(finish - start).count();
+}
+
+/**
+ * Восстановление сеансов по копии каталога журнала, как после падения,
+ * и сравнение восстановленных путей с путями живых сеансов.
+ *
+ * \param es Экспертная система
+ * \param sessions Живые сеансы
+ * \param directory Каталог журнала
+ * \return Количество расхождений
+ */
+static std::size_t Recover(
+    const ES::IExpertSystem& es,
+    const std::vector<std::unique_ptr<ES::IExpertSystem>>& sessions,
+    const std::filesystem::path& directory)
+{
+    const auto copy = directory.string() + "_crash";
+    std::filesystem::remove_all(copy);
+    std::filesystem::copy(directory, copy);
+    auto restarted = es.CreateSession();
+    ES::JournalOptions options;
+    options.directory = copy;
+    auto journal = ES::OpenSessionJournal(options);
+    restarted->SetSessionJournal(journal);
+    const auto stats = journal->GetStats();
+    std::printf("recovery: %zu sessions in %.1f ms\n", stats.recovered, stats.recoveryMs);
+
+    std::size_t mismatches = 0;
+    for (const auto& session : sessions) {
+        const auto resumed = restarted->ResumeSession(session->GetSessionID());
+        bool same = resumed && resumed->GetDepth() == session->GetDepth();
+        for (std::size_t depth = 0; same && depth <= session->GetDepth(); ++depth) {
+            same = resumed->GetPathID(depth) == session->GetPathID(depth);
+        }
+        mismatches += !same;
+    }
+    journal.reset();
+    restarted.reset();
+    std::filesystem::remove_all(copy);
+    return mismatches;
+}
+
+/**
+ * Бенчмарк журнала сеансов.
+ * Сравнивается время случайных шагов по множеству сеансов без журнала
+ * и с журналом, затем каталог журнала копируется, как после падения,
+ * и по копии восстанавливаются все сеансы: сначала только по файлам
+ * журнала, затем по контрольной точке.
+ *
+ * \param args Аргументы бенчмарка
+ * \return Код завершения
+ */
+int RunJournalBenchmark(
+    const arguments_t& args)
+{
+    const std::size_t sessionsCount = ArgumentOr(args, 0, 100000);
+    const std::size_t steps = ArgumentOr(args, 1, 2000000);
+    GeneratorOptions generator;
+    generator.depth = ArgumentOr(args, 2, 16);
+
+    const auto config = GenerateConfig(generator);
+    auto es = ES::CreateExpertSystem();
+    es->Load(config);
+    std::filesystem::remove(config);
+
+    const auto directory = std::filesystem::temp_directory_path() / "es_bench_journal";
+    std::filesystem::remove_all(directory);
+    ES::JournalOptions options;
+    options.directory = directory.string();
+    auto journal = ES::OpenSessionJournal(options);
+
+    std::mt19937 random(42);
+    std::vector<std::unique_ptr<ES::IExpertSystem>> sessions;
+    sessions.reserve(sessionsCount);
+    for (std::size_t i = 0; i < sessionsCount; ++i) {
+        sessions.push_back(es->CreateSession());
+    }
+    const double plainNs = Walk(sessions, steps, random);
+
+    // Те же шаги с журналом. Сеансы, созданные после подключения,
+    // наследуют журнал; уже созданные подключаются явно
+    es->SetSessionJournal(journal);
+    for (auto& session : sessions) {
+        session->SetSessionJournal(journal);
+    }
+    const double journalNs = Walk(sessions, steps, random);
+    journal->Flush();
+    auto stats = journal->GetStats();
+    std::printf("steps: %zu over %zu sessions\n", steps, sessionsCount);
+    std::printf("plain: %.1f ns/step, journal: %.1f ns/step (+%.1f ns)\n",
+        plainNs / steps, journalNs / steps, (journalNs - plainNs) / steps);
+    std::printf("journal: %llu records, %llu commits (%.0f records/commit), %llu stalls\n",
+        static_cast<unsigned long long>(stats.written),
+        static_cast<unsigned long long>(stats.commits),
+        stats.commits ? static_cast<double>(stats.written) / stats.commits : 0.0,
+        static_cast<unsigned long long>(stats.stalls));
+
+    std::size_t mismatches = Recover(*es, sessions, directory);
+    journal->Checkpoint();
+    Walk(sessions, steps / 10, random);
+    journal->Flush();
+    std::printf("checkpoint written, ");
+    mismatches += Recover(*es, sessions, directory);
+
+    sessions.clear();
+    es.reset();
+    journal.reset();
+    std::filesystem::remove_all(directory);
+    if (mismatches) {
+        std::printf("FAILED: %zu sessions recovered with wrong path\n", mismatches);
+        return 1;
+    }
+    return 0;
+}
+
+}
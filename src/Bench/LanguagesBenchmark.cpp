@@ -0,0 +1,72 @@
+﻿#include "Benchmarks.hpp"
+#include "AllocationCounter.hpp"
+#include "Generator.hpp"
+
+#include "IExpertSystem.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+
+namespace Bench
+{
+
+/**
+ * Бенчмарк языков.
+ * Загружает конфигурацию с несколькими языками и по очереди
+ * создаёт сеансы на каждом языке, измеряя время загрузки
+ * и память, добавленную каждым языком.
+ *
+ * \param args Аргументы бенчмарка
+ * \return Код завершения
+ */
+int RunLanguagesBenchmark(
+    const arguments_t& args)
+{
+    GeneratorOptions options;
+    options.depth = ArgumentOr(args, 0, 16);
+    options.textLength = ArgumentOr(args, 1, 64);
+    options.languages = ArgumentOr(args, 2, 4);
+
+    const auto path = GenerateConfig(options);
+    auto before = CurrentAllocationStats();
+    auto start = std::chrono::steady_clock::now();
+    auto es = ES::CreateExpertSystem();
+    es->Load(path);
+    auto finish = std::chrono::steady_clock::now();
+    std::printf("languages: %zu nodes, %zu languages\n",
+        (std::size_t(1) << (options.depth + 1)) - 1, options.languages);
+    std::printf("  %-8s %8.2f ms, %12td bytes\n", "base",
+        std::chrono::duration<double, std::milli>(finish - start).count(),
+        (CurrentAllocationStats() - before).liveBytes);
+
+    // Сеансы держим до конца, чтобы тексты языков оставались в памяти
+    std::vector<std::unique_ptr<ES::IExpertSystem>> sessions;
+    for (const auto& language : es->GetLanguages()) {
+        before = CurrentAllocationStats();
+        start = std::chrono::steady_clock::now();
+        sessions.push_back(es->CreateSession(language));
+        finish = std::chrono::steady_clock::now();
+        std::printf("  %-8s %8.2f ms, %12td bytes\n", language.c_str(),
+            std::chrono::duration<double, std::milli>(finish - start).count(),
+            (CurrentAllocationStats() - before).liveBytes);
+    }
+    // Повторный сеанс на том же языке не загружает тексты
+    if (!sessions.empty()) {
+        before = CurrentAllocationStats();
+        start = std::chrono::steady_clock::now();
+        auto session = es->CreateSession(es->GetLanguages().front());
+        finish = std::chrono::steady_clock::now();
+        std::printf("  %-8s %8.2f ms, %12td bytes\n", "again",
+            std::chrono::duration<double, std::milli>(finish - start).count(),
+            (CurrentAllocationStats() - before).liveBytes);
+    }
+
+    std::filesystem::remove(path);
+    for (std::size_t language = 1; language <= options.languages; ++language) {
+        std::filesystem::remove(path + ".l" + std::to_string(language));
+    }
+    return 0;
+}
+
+}
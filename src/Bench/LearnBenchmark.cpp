@@ -0,0 +1,104 @@
+﻿#include "Benchmarks.hpp"
+
+#include "IExpertSystem.hpp"
+#include "TreeLearner.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+
+namespace Bench
+{
+
+/**
+ * Генерация синтетического набора данных.
+ * Чётные признаки числовые, нечётные - категориальные.
+ * Ответ определяется первыми тремя признаками, остальные - шум.
+ *
+ * \param path Путь к создаваемому файлу
+ * \param rows Количество строк
+ * \param features Количество признаков (не меньше трёх)
+ * \return
+ */
+static void GenerateDataset(
+    const std::filesystem::path& path,
+    const std::size_t rows,
+    const std::size_t features)
+{
+    std::ofstream out(path, std::ios::binary);
+    if (!out) {
+        throw std::runtime_error(u8"Не удалось создать " + path.string());
+    }
+    for (std::size_t feature = 0; feature < features; ++feature) {
+        out << 'f' << feature << ',';
+    }
+    out << "diagnosis\n";
+    std::mt19937 random(42);
+    std::uniform_int_distribution<int> numbers(0, 99);
+    std::uniform_int_distribution<int> letters(0, 4);
+    std::vector<int> values(features);
+    for (std::size_t row = 0; row < rows; ++row) {
+        for (std::size_t feature = 0; feature < features; ++feature) {
+            values[feature] = feature % 2 ? letters(random) : numbers(random);
+            if (feature % 2) {
+                out << static_cast<char>('a' + values[feature]) << ',';
+            }
+            else {
+                out << values[feature] << ',';
+            }
+        }
+        const char* diagnosis = values[0] < 25 ? "A"
+            : values[1] == 1 ? "B"
+            : values[2] >= 50 ? "C" : "D";
+        out << diagnosis << '\n';
+    }
+}
+
+/**
+ * Бенчмарк построения дерева по размеченным данным.
+ * Измеряется время построения при заданном количестве потоков,
+ * построенная конфигурация загружается экспертной системой.
+ *
+ * \param args Аргументы бенчмарка
+ * \return Код завершения
+ */
+int RunLearnBenchmark(
+    const arguments_t& args)
+{
+    const std::size_t rows = ArgumentOr(args, 0, 1000000);
+    const std::size_t features = std::max<std::size_t>(ArgumentOr(args, 1, 16), 3);
+    ES::LearnerOptions options;
+    options.threads = ArgumentOr(args, 2, 0);
+
+    const auto directory = std::filesystem::temp_directory_path();
+    const auto data = directory / ("es_bench_learn_" + std::to_string(rows)
+        + "_" + std::to_string(features) + ".csv");
+    const auto config = directory / "es_bench_learn.xml";
+    GenerateDataset(data, rows, features);
+
+    const auto start = std::chrono::steady_clock::now();
+    const auto stats = ES::LearnTree(data.string(), config.string(), options);
+    const auto finish = std::chrono::steady_clock::now();
+    const double seconds = std::chrono::duration<double>(finish - start).count();
+    std::filesystem::remove(data);
+
+    auto es = ES::CreateExpertSystem();
+    es->Load(config.string());
+    const auto answers = es->GetCandidatesCount();
+    std::filesystem::remove(config);
+
+    std::printf("learn: %zu rows, %zu features, %.3f s (%.0f rows/s)\n",
+        stats.rows, stats.features, seconds, stats.rows / seconds);
+    std::printf("tree: %zu questions, %zu answers, depth %zu, accuracy %.2f%%\n",
+        stats.questions, stats.answers, stats.depth, stats.accuracy * 100);
+    if (answers != stats.answers) {
+        std::printf("FAILED: loaded tree has %zu answers\n", answers);
+        return 1;
+    }
+    return 0;
+}
+
+}
@@ -0,0 +1,122 @@
+﻿#include "Benchmarks.hpp"
+#include "AllocationCounter.hpp"
+#include "Generator.hpp"
+
+#include "IExpertSystem.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+
+namespace Bench
+{
+
+// Наибольшее количество выделений памяти на запись
+static constexpr double kMaxAllocationsPerRecord = 2.5;
+// Наибольший объём выделенной памяти на запись сверх её текста, байт
+static constexpr double kMaxBytesPerRecord = 384;
+// Наименьшее количество записей, на котором проверяются пределы.
+// В меньших конфигурациях заметен рост контейнеров удвоением
+static constexpr std::size_t kMinCheckedRecords = 1000;
+
+/**
+ * Загрузка конфигурации с подсчётом выделений памяти.
+ *
+ * \param path Путь к конфигурации
+ * \param ms Время загрузки в миллисекундах
+ * \return Выделения памяти за загрузку
+ */
+static AllocationStats MeasureLoad(
+    const std::string& path,
+    double& ms)
+{
+    auto es = ES::CreateExpertSystem();
+    const auto before = CurrentAllocationStats();
+    const auto start = std::chrono::steady_clock::now();
+    es->Load(path);
+    const auto finish = std::chrono::steady_clock::now();
+    const auto stats = CurrentAllocationStats() - before;
+    ms = std::chrono::duration<double, std::milli>(finish - start).count();
+    return stats;
+}
+
+/**
+ * Бенчмарк загрузки.
+ * Для каждого повтора загружает синтетическую конфигурацию
+ * и считает выделения памяти, приходящиеся на одну запись
+ * (узел или соединение). Каждая запись должна выделять память
+ * константное число раз, без лишних копий строк и предикатов,
+ * иначе бенчмарк завершается с ошибкой. Постоянные затраты загрузки
+ * (логгер, индексы, буферы разбора) измеряются на конфигурации
+ * из одного вопроса и вычитаются.
+ *
+ * \param args Аргументы бенчмарка
+ * \return Код завершения
+ */
+int RunLoadBenchmark(
+    const arguments_t& args)
+{
+    GeneratorOptions options;
+    options.depth = ArgumentOr(args, 0, 16);
+    options.textLength = ArgumentOr(args, 1, 64);
+    const std::size_t iterations = ArgumentOr(args, 2, 5);
+
+    // Количество записей и байт текста конфигурации заданной глубины
+    const auto records = [&options](const std::size_t depth, std::size_t& textBytes)
+    {
+        const std::size_t nodes = (std::size_t(1) << (depth + 1)) - 1;
+        textBytes = nodes * options.textLength;
+        return 2 * nodes - 1;
+    };
+    GeneratorOptions minimal = options;
+    minimal.depth = 1;
+    const auto minimalPath = GenerateConfig(minimal);
+    double ms = 0;
+    const auto fixed = MeasureLoad(minimalPath, ms);
+    std::filesystem::remove(minimalPath);
+    std::size_t fixedText = 0;
+    const auto fixedRecords = records(minimal.depth, fixedText);
+
+    const auto path = GenerateConfig(options);
+    const std::size_t nodes = (std::size_t(1) << (options.depth + 1)) - 1;
+    const std::size_t connections = nodes - 1;
+    std::size_t textBytes = 0;
+    const auto measured = double(records(options.depth, textBytes) - fixedRecords);
+
+    std::printf("load: %zu nodes, %zu connections, %zu text bytes\n",
+        nodes, connections, textBytes);
+    std::printf("  fixed: %zu allocations, %zu bytes\n", fixed.allocations, fixed.bytes);
+    double worstAllocations = 0;
+    double worstBytes = 0;
+    for (std::size_t i = 0; i < iterations; ++i) {
+        const auto stats = MeasureLoad(path, ms);
+        const double allocations = (double(stats.allocations) - double(fixed.allocations)) / measured;
+        const double bytes = (double(stats.bytes) - double(fixed.bytes)
+            - double(textBytes - fixedText)) / measured;
+        worstAllocations = std::max(worstAllocations, allocations);
+        worstBytes = std::max(worstBytes, bytes);
+        std::printf("  #%zu: %8.2f ms, %zu allocations (%.2f per record), "
+            "%zu bytes (%.2f x text, %.1f per record besides text)\n",
+            i, ms, stats.allocations, allocations,
+            stats.bytes, double(stats.bytes) / double(textBytes), bytes);
+    }
+    std::filesystem::remove(path);
+    if (measured < kMinCheckedRecords) {
+        std::printf("  limits are checked from %zu records\n", kMinCheckedRecords);
+        return 0;
+    }
+    if (worstAllocations > kMaxAllocationsPerRecord) {
+        std::printf("FAILED: %.2f allocations per record, at most %.2f allowed\n",
+            worstAllocations, kMaxAllocationsPerRecord);
+        return 1;
+    }
+    if (worstBytes > kMaxBytesPerRecord) {
+        std::printf("FAILED: %.1f bytes per record besides text, at most %.0f allowed\n",
+            worstBytes, kMaxBytesPerRecord);
+        return 1;
+    }
+    return 0;
+}
+
+}
@@ -0,0 +1,98 @@
+﻿#include "Benchmarks.hpp"
+#include "AllocationCounter.hpp"
+#include "Generator.hpp"
+
+#include "IExpertSystem.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <stdexcept>
+
+namespace Bench
+{
+
+/**
+ * Вывод памяти базы знаний по категориям.
+ *
+ * \param name Название варианта
+ * \param report Память по категориям
+ * \return
+ */
+static void PrintReport(
+    const char* name,
+    const ES::MemoryReport& report)
+{
+    std::printf("  %-10s structure %zu, edges %zu, texts %zu, indices %zu, "
+        "unused %zu, wasted %zu, total %zu bytes\n", name, report.structure, report.edges,
+        report.texts, report.indices, report.unused, report.wasted, report.total);
+}
+
+/**
+ * Бенчмарк учёта памяти базы знаний.
+ * Сравнивает отчёт о памяти с памятью, выделенной при загрузке,
+ * измеряет освобождение базы знаний и проверяет бюджет
+ * в режимах Reject и Degrade.
+ *
+ * \param args Аргументы бенчмарка
+ * \return Код завершения
+ */
+int RunMemoryBenchmark(
+    const arguments_t& args)
+{
+    GeneratorOptions options;
+    options.depth = ArgumentOr(args, 0, 18);
+    options.textLength = ArgumentOr(args, 1, 64);
+    const auto path = GenerateConfig(options);
+    std::printf("memory: %zu nodes, %zu bytes per text\n",
+        (std::size_t(1) << (options.depth + 1)) - 1, options.textLength);
+
+    // Отчёт о памяти против памяти, выделенной при загрузке
+    auto before = CurrentAllocationStats();
+    auto es = ES::CreateExpertSystem();
+    es->Load(path);
+    const auto loaded = CurrentAllocationStats() - before;
+    const auto report = es->GetMemoryReport();
+    PrintReport("plain", report);
+    std::printf("  load: %zu allocations, %td live bytes, report covers %.1f%%\n",
+        loaded.allocations, loaded.liveBytes,
+        100.0 * double(report.total) / double(loaded.liveBytes));
+
+    // Освобождение базы знаний
+    before = CurrentAllocationStats();
+    const auto start = std::chrono::steady_clock::now();
+    es.reset();
+    const auto finish = std::chrono::steady_clock::now();
+    std::printf("  teardown: %.2f ms, %td bytes released\n",
+        std::chrono::duration<double, std::milli>(finish - start).count(),
+        -(CurrentAllocationStats() - before).liveBytes);
+
+    // Бюджет, в который база знаний помещается только со сжатыми текстами
+    ES::MemoryBudgetOptions budget;
+    budget.limit = report.total - report.texts / 2;
+    es = ES::CreateExpertSystem();
+    es->SetMemoryBudget(budget);
+    before = CurrentAllocationStats();
+    try {
+        es->Load(path);
+        std::printf("  reject: loaded\n");
+    }
+    catch (const std::runtime_error&) {
+        std::printf("  reject: rejected at budget %zu bytes, %td bytes left allocated\n",
+            budget.limit, (CurrentAllocationStats() - before).liveBytes);
+    }
+    budget.policy = ES::MemoryBudgetPolicy::Degrade;
+    es->SetMemoryBudget(budget);
+    try {
+        es->Load(path);
+        PrintReport("degraded", es->GetMemoryReport());
+    }
+    catch (const std::runtime_error&) {
+        std::printf("  degrade: rejected at budget %zu bytes\n", budget.limit);
+    }
+    es.reset();
+    std::filesystem::remove(path);
+    return 0;
+}
+
+}
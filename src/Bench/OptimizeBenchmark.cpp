@@ -0,0 +1,144 @@
+﻿#include "Benchmarks.hpp"
+#include "Generator.hpp"
+
+#include "IExpertSystem.hpp"
+#include "TreeOptimizer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <numeric>
+#include <random>
+
+namespace Bench
+{
+
+/**
+ * Проход сеанса, в котором ответ на вопрос определяется его текстом.
+ * Одинаковые вопросы получают одинаковые ответы в любом дереве,
+ * поэтому исходное и перестроенное дерево должны привести к одному ответу.
+ *
+ * \param es Экспертная система
+ * \param seed Номер прохода
+ * \param depth Количество заданных вопросов
+ * \return Идентификатор достигнутого ответа
+ */
+static int RunSession(
+    ES::IExpertSystem& es,
+    const std::size_t seed,
+    std::size_t& depth)
+{
+    es.Reset();
+    depth = 0;
+    while (!es.IsFinished()) {
+        const auto hash = std::hash<std::string_view>()(es.GetCurrentData()) ^ (seed * 0x9E3779B97F4A7C15ull);
+        if (!es.SetAnswer(static_cast<int>((hash >> 17) & 1))) {
+            return -1;
+        }
+        ++depth;
+    }
+    return es.GetCurrentID();
+}
+
+/**
+ * Перестройка одной конфигурации и проверка результата.
+ *
+ * \param title Название конфигурации
+ * \param options Параметры конфигурации
+ * \param sessions Количество проверочных проходов
+ * \param exact Требуются поддеревья точного перебора
+ * \return true - если перестроенное дерево даёт те же ответы
+ */
+static bool OptimizeConfig(
+    const char* title,
+    const GeneratorOptions& options,
+    const std::size_t sessions,
+    const bool exact = false)
+{
+    const auto config = GenerateConfig(options);
+    const auto directory = std::filesystem::temp_directory_path();
+    const auto priors = directory / "es_bench_optimize_priors.txt";
+    const auto output = directory / "es_bench_optimize.xml";
+
+    // Частоты ответов по закону Ципфа в случайном порядке ответов
+    auto original = ES::CreateExpertSystem();
+    original->Load(config);
+    auto answers = original->GetCandidates();
+    std::shuffle(answers.begin(), answers.end(), std::mt19937_64(options.depth));
+    {
+        std::ofstream out(priors);
+        for (std::size_t rank = 0; rank < answers.size(); ++rank) {
+            out << answers[rank] << ' ' << 1000.0 / double(rank + 1) << '\n';
+        }
+    }
+    ES::OptimizerOptions optimizer;
+    optimizer.priorsPath = priors.string();
+    optimizer.smoothing = 0;
+    const auto start = std::chrono::steady_clock::now();
+    const auto stats = ES::OptimizeTree(config, output.string(), optimizer);
+    const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    ES::ValidationOptions validation;
+    validation.strict = true;
+    auto optimized = ES::CreateExpertSystem();
+    optimized->SetValidation(validation);
+    optimized->Load(output.string());
+    std::size_t mismatches = 0;
+    std::size_t depthBefore = 0;
+    std::size_t depthAfter = 0;
+    for (std::size_t seed = 0; seed < sessions; ++seed) {
+        std::size_t before = 0;
+        std::size_t after = 0;
+        mismatches += RunSession(*original, seed, before) != RunSession(*optimized, seed, after);
+        depthBefore += before;
+        depthAfter += after;
+    }
+    std::filesystem::remove(config);
+    std::filesystem::remove(priors);
+    std::filesystem::remove(output);
+
+    std::printf("%s: %zu paths, %zu answers, %.3f s\n", title, stats.paths, stats.answers, seconds);
+    std::printf("  expected depth %.3f -> %.3f, max depth %zu -> %zu, questions %zu -> %zu, exact subtrees %zu\n",
+        stats.expectedDepthBefore, stats.expectedDepthAfter, stats.maxDepthBefore, stats.maxDepthAfter,
+        stats.questionsBefore, stats.questionsAfter, stats.exactSubtrees);
+    std::printf("  %zu random sessions: %.2f -> %.2f questions, %zu mismatches\n", sessions,
+        double(depthBefore) / double(sessions), double(depthAfter) / double(sessions), mismatches);
+    if (exact && !stats.exactSubtrees) {
+        std::printf("FAILED: no subtree was built by exact search\n");
+        return false;
+    }
+    return !mismatches && stats.expectedDepthAfter <= stats.expectedDepthBefore;
+}
+
+/**
+ * Бенчмарк перестройки дерева по частотам ответов.
+ * Перестраивает полное дерево с разными вопросами в каждом узле,
+ * дерево, где ответ зависит только от последних вопросов пути,
+ * и такое же небольшое дерево, ветви которого достраиваются точным
+ * перебором, и проверяет, что случайные сеансы приводят к тем же ответам.
+ *
+ * \param args Аргументы бенчмарка
+ * \return Код завершения
+ */
+int RunOptimizeBenchmark(
+    const arguments_t& args)
+{
+    GeneratorOptions options;
+    options.depth = ArgumentOr(args, 0, 12);
+    const auto relevant = ArgumentOr(args, 1, 4);
+    const auto sessions = ArgumentOr(args, 2, 1000);
+    bool ok = OptimizeConfig("distinct questions", options, sessions);
+    options.relevantLevels = relevant;
+    ok = OptimizeConfig("repeated questions", options, sessions) && ok;
+    // После первых вопросов в ветви остаётся не больше
+    // OptimizerOptions::exactLimit путей
+    options.depth = 5;
+    options.relevantLevels = 3;
+    ok = OptimizeConfig("exact subtrees", options, sessions, true) && ok;
+    return ok ? 0 : 1;
+}
+
+}
@@ -0,0 +1,71 @@
+﻿#include "Benchmarks.hpp"
+#include "Generator.hpp"
+
+#include "IExpertSystem.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <random>
+
+namespace Bench
+{
+
+/**
+ * Бенчмарк получения путей до узлов.
+ * Для случайных узлов измеряется время получения всех путей,
+ * кратчайшего пути и перехода сеанса к узлу.
+ *
+ * \param args Аргументы бенчмарка
+ * \return Код завершения
+ */
+int RunPathsBenchmark(
+    const arguments_t& args)
+{
+    const std::size_t queries = ArgumentOr(args, 0, 100000);
+    GeneratorOptions options;
+    options.depth = ArgumentOr(args, 1, 16);
+
+    const auto path = GenerateConfig(options);
+    auto es = ES::CreateExpertSystem();
+    es->Load(path);
+    std::filesystem::remove(path);
+
+    // Идентификаторы узлов в сгенерированной конфигурации идут подряд с 1
+    const int nodes = (1 << (options.depth + 1)) - 1;
+    std::mt19937 random(42);
+    std::uniform_int_distribution<int> ids(1, nodes);
+    double pathsNs = 0;
+    double shortestNs = 0;
+    double jumpNs = 0;
+    std::size_t steps = 0;
+    for (std::size_t query = 0; query < queries; ++query) {
+        const auto id = ids(random);
+        auto start = std::chrono::steady_clock::now();
+        const auto paths = es->GetPathsTo(id, 0);
+        auto finish = std::chrono::steady_clock::now();
+        pathsNs += std::chrono::duration<double, std::nano>(finish - start).count();
+
+        start = std::chrono::steady_clock::now();
+        steps += es->GetShortestPathTo(id).size();
+        finish = std::chrono::steady_clock::now();
+        shortestNs += std::chrono::duration<double, std::nano>(finish - start).count();
+
+        start = std::chrono::steady_clock::now();
+        es->JumpTo(id);
+        finish = std::chrono::steady_clock::now();
+        jumpNs += std::chrono::duration<double, std::nano>(finish - start).count();
+        if (es->GetCurrentID() != id || paths.size() != 1) {
+            std::printf("FAILED: node %d is not reachable\n", id);
+            return 1;
+        }
+    }
+    std::printf("paths: depth %zu, %zu queries, %.2f steps per path\n",
+        options.depth, queries, double(steps) / double(queries));
+    std::printf("  all paths: %10.2f ns\n", pathsNs / double(queries));
+    std::printf("  shortest:  %10.2f ns\n", shortestNs / double(queries));
+    std::printf("  jump:      %10.2f ns\n", jumpNs / double(queries));
+    return 0;
+}
+
+}
@@ -0,0 +1,82 @@
+﻿#include "Benchmarks.hpp"
+#include "AllocationCounter.hpp"
+#include "Generator.hpp"
+
+#include "IExpertSystem.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <limits>
+
+namespace Bench
+{
+
+/**
+ * Бенчмарк перезагрузки.
+ * Сравнивает загрузку изменённой конфигурации с нуля и поверх
+ * уже загруженной исходной конфигурации. Во втором случае
+ * память выделяется только под изменившиеся узлы, поэтому
+ * перезагрузка должна быть дешевле загрузки с нуля и по памяти,
+ * и по лучшему времени. Иначе бенчмарк завершается с ошибкой.
+ *
+ * \param args Аргументы бенчмарка
+ * \return Код завершения
+ */
+int RunReloadBenchmark(
+    const arguments_t& args)
+{
+    GeneratorOptions options;
+    options.depth = ArgumentOr(args, 0, 16);
+    const std::size_t changeEvery = ArgumentOr(args, 1, 100);
+    const std::size_t iterations = ArgumentOr(args, 2, 5);
+
+    const auto basePath = GenerateConfig(options);
+    options.changeEvery = changeEvery;
+    const auto changedPath = GenerateConfig(options);
+    const std::size_t nodes = (std::size_t(1) << (options.depth + 1)) - 1;
+
+    std::printf("reload: %zu nodes, %zu changed\n",
+        nodes, changeEvery ? nodes / changeEvery : 0);
+    bool cheaper = true;
+    double bestFullMs = std::numeric_limits<double>::max();
+    double bestIncrementalMs = std::numeric_limits<double>::max();
+    for (std::size_t i = 0; i < iterations; ++i) {
+        auto full = ES::CreateExpertSystem();
+        auto before = CurrentAllocationStats();
+        auto start = std::chrono::steady_clock::now();
+        full->Load(changedPath);
+        auto finish = std::chrono::steady_clock::now();
+        const auto fullStats = CurrentAllocationStats() - before;
+        const double fullMs = std::chrono::duration<double, std::milli>(finish - start).count();
+
+        auto incremental = ES::CreateExpertSystem();
+        incremental->Load(basePath);
+        before = CurrentAllocationStats();
+        start = std::chrono::steady_clock::now();
+        incremental->Load(changedPath);
+        finish = std::chrono::steady_clock::now();
+        const auto incrementalStats = CurrentAllocationStats() - before;
+        const double incrementalMs =
+            std::chrono::duration<double, std::milli>(finish - start).count();
+
+        std::printf("  #%zu: full %8.2f ms, %zu allocations, %zu bytes; "
+            "incremental %8.2f ms, %zu allocations, %zu bytes\n",
+            i, fullMs, fullStats.allocations, fullStats.bytes,
+            incrementalMs, incrementalStats.allocations, incrementalStats.bytes);
+        cheaper = cheaper && incrementalStats.allocations < fullStats.allocations
+            && incrementalStats.bytes < fullStats.bytes;
+        bestFullMs = std::min(bestFullMs, fullMs);
+        bestIncrementalMs = std::min(bestIncrementalMs, incrementalMs);
+    }
+    std::filesystem::remove(basePath);
+    std::filesystem::remove(changedPath);
+    if (!cheaper || (iterations && bestIncrementalMs >= bestFullMs)) {
+        std::printf("FAILED: incremental reload is not cheaper than full load\n");
+        return 1;
+    }
+    return 0;
+}
+
+}
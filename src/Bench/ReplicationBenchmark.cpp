@@ -0,0 +1,108 @@
+﻿#include "Benchmarks.hpp"
+#include "Generator.hpp"
+
+#include "IExpertSystem.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace Bench
+{
+
+/**
+ * Прогон потоков, каждый из которых создаёт свой сеанс
+ * и проходит по дереву заданное количество шагов.
+ *
+ * \param es Загруженная экспертная система
+ * \param threads Количество потоков
+ * \param steps Количество шагов на поток
+ * \return Среднее время шага в наносекундах
+ */
+static double RunThreads(
+    const ES::IExpertSystem& es,
+    const std::size_t threads,
+    const std::size_t steps)
+{
+    std::atomic<bool> go{false};
+    std::vector<double> results(threads);
+    std::vector<std::thread> pool;
+    for (std::size_t i = 0; i < threads; ++i) {
+        pool.emplace_back([&, i]
+        {
+            // Сеанс создаётся в рабочем потоке, чтобы получить локальную копию
+            auto session = es.CreateSession();
+            std::mt19937 random(static_cast<std::mt19937::result_type>(i + 1));
+            while (!go.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+            const auto start = std::chrono::steady_clock::now();
+            for (std::size_t step = 0; step < steps; ++step) {
+                if (session->IsFinished()) {
+                    session->Reset();
+                    continue;
+                }
+                session->SetAnswer(static_cast<int>(random() & 1));
+            }
+            const auto finish = std::chrono::steady_clock::now();
+            results[i] = std::chrono::duration<double, std::nano>(finish - start).count()
+                / double(steps);
+        });
+    }
+    go.store(true, std::memory_order_release);
+    double total = 0;
+    for (std::size_t i = 0; i < threads; ++i) {
+        pool[i].join();
+        total += results[i];
+    }
+    return total / double(threads);
+}
+
+/**
+ * Бенчмарк репликации.
+ *
+ * \param args Аргументы бенчмарка
+ * \return Код завершения
+ */
+int RunReplicationBenchmark(
+    const arguments_t& args)
+{
+    const std::size_t threads = ArgumentOr(args, 0, std::thread::hardware_concurrency());
+    const std::size_t steps = ArgumentOr(args, 1, 5000000);
+    GeneratorOptions options;
+    // Дерево побольше, чтобы не помещаться в кэш одного ядра
+    options.depth = ArgumentOr(args, 2, 18);
+
+    const auto path = GenerateConfig(options);
+    auto es = ES::CreateExpertSystem();
+    es->Load(path);
+    std::filesystem::remove(path);
+
+    struct Variant
+    {
+        const char* name;
+        ES::ReplicationOptions options;
+    };
+    Variant variants[3];
+    variants[0].name = "shared";
+    variants[1].name = "per-numa-node";
+    variants[1].options.mode = ES::ReplicationMode::PerNumaNode;
+    variants[2].name = "per-thread-group";
+    variants[2].options.mode = ES::ReplicationMode::PerThreadGroup;
+    variants[2].options.groups = threads;
+
+    std::printf("replicate: %zu threads, %zu steps per thread\n", threads, steps);
+    for (const auto& variant : variants) {
+        es->SetReplication(variant.options);
+        const double ns = RunThreads(*es, threads, steps);
+        std::printf("  %-16s %3zu replicas, %.2f ns/step\n",
+            variant.name, es->GetReplicasCount(), ns);
+    }
+    return 0;
+}
+
+}
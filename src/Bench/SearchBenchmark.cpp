@@ -0,0 +1,146 @@
+﻿#include "Benchmarks.hpp"
+#include "Generator.hpp"
+
+#include "IExpertSystem.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace Bench
+{
+
+/**
+ * Выделение слов текста узла по пробелам.
+ *
+ * \param text Текст узла
+ * \return Слова текста
+ */
+static std::vector<std::string> SplitWords(
+    std::string_view text)
+{
+    std::vector<std::string> words;
+    while (!text.empty()) {
+        const auto space = std::min(text.find(' '), text.size());
+        if (space) {
+            words.emplace_back(text.substr(0, space));
+        }
+        text.remove_prefix(std::min(space + 1, text.size()));
+    }
+    return words;
+}
+
+/**
+ * Измерение времени поиска по набору запросов.
+ *
+ * \param es Экспертная система
+ * \param name Вид запросов
+ * \param queries Запросы
+ * \param limit Наибольшее количество результатов
+ * \return 99-й процентиль задержки в микросекундах
+ */
+static double MeasureQueries(
+    const ES::IExpertSystem& es,
+    const char* name,
+    const std::vector<std::string>& queries,
+    const std::size_t limit)
+{
+    std::vector<double> times;
+    times.reserve(queries.size());
+    std::size_t hits = 0;
+    for (const auto& query : queries) {
+        const auto start = std::chrono::steady_clock::now();
+        hits += es.Search(query, limit).size();
+        const auto finish = std::chrono::steady_clock::now();
+        times.push_back(std::chrono::duration<double, std::micro>(finish - start).count());
+    }
+    std::sort(times.begin(), times.end());
+    double total = 0;
+    for (const auto time : times) {
+        total += time;
+    }
+    const auto p99 = times[times.size() * 99 / 100];
+    std::printf("  %-9s avg %9.2f us, p50 %9.2f us, p99 %9.2f us, %.2f hits\n", name,
+        total / double(times.size()), times[times.size() / 2], p99,
+        double(hits) / double(queries.size()));
+    return p99;
+}
+
+/**
+ * Бенчмарк полнотекстового поиска.
+ * Загружает конфигурацию с текстами из слов, измеряет время загрузки
+ * вместе с построением индекса и задержку запросов из целых слов,
+ * начал слов и пар слов, взятых из текстов случайных узлов.
+ * Проваливается, если 99-й процентиль задержки запросов
+ * любого вида больше миллисекунды.
+ *
+ * \param args Аргументы бенчмарка
+ * \return Код завершения
+ */
+int RunSearchBenchmark(
+    const arguments_t& args)
+{
+    GeneratorOptions options;
+    options.depth = ArgumentOr(args, 0, 20);
+    options.vocabulary = ArgumentOr(args, 1, 50000);
+    const std::size_t count = ArgumentOr(args, 2, 10000);
+    options.textLength = 48;
+    constexpr std::size_t limit = 10;
+    constexpr double maxP99 = 1000.0;
+
+    const auto path = GenerateConfig(options);
+    auto es = ES::CreateExpertSystem();
+    const auto start = std::chrono::steady_clock::now();
+    es->Load(path);
+    const auto finish = std::chrono::steady_clock::now();
+    std::filesystem::remove(path);
+    const auto report = es->GetMemoryReport();
+    std::printf("search: depth %zu, vocabulary %zu, load %.2f ms, indices %zu bytes\n",
+        options.depth, options.vocabulary,
+        std::chrono::duration<double, std::milli>(finish - start).count(), report.indices);
+
+    // Запросы строятся из текстов случайных узлов, поэтому у каждого
+    // запроса есть хотя бы один результат. Идентификаторы идут подряд с 1
+    const int nodes = (1 << (options.depth + 1)) - 1;
+    std::mt19937 random(42);
+    std::uniform_int_distribution<int> ids(1, nodes);
+    std::vector<std::string> words;
+    std::vector<std::string> prefixes;
+    std::vector<std::string> pairs;
+    for (std::size_t query = 0; query < count; ++query) {
+        const auto id = ids(random);
+        if (!es->JumpTo(id)) {
+            std::printf("FAILED: node %d is not reachable\n", id);
+            return 1;
+        }
+        const auto text = SplitWords(es->GetCurrentData());
+        const auto& word = text[random() % text.size()];
+        words.push_back(word);
+        // Начало слова из двух или трёх букв по два байта
+        prefixes.push_back(word.substr(0, 4 + 2 * (random() % 2)));
+        pairs.push_back(text[0] + " " + text[text.size() > 1 ? 1 : 0]);
+    }
+    const auto p99 = std::max({
+        MeasureQueries(*es, "words", words, limit),
+        MeasureQueries(*es, "prefixes", prefixes, limit),
+        MeasureQueries(*es, "pairs", pairs, limit) });
+    if (p99 > maxP99) {
+        std::printf("FAILED: p99 latency %.2f us is over %.0f us\n", p99, maxP99);
+        return 1;
+    }
+
+    // Каждый запрос пары слов обязан найти узел, из которого он взят
+    for (std::size_t query = 0; query < std::min<std::size_t>(count, 100); ++query) {
+        if (es->Search(pairs[query], nodes).empty()) {
+            std::printf("FAILED: nothing found for '%s'\n", pairs[query].c_str());
+            return 1;
+        }
+    }
+    return 0;
+}
+
+}
@@ -0,0 +1,203 @@
+﻿#include "Benchmarks.hpp"
+
+#include "ISessionTable.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+
+#if defined(__unix__)
+#   include <signal.h>
+#   include <sys/mman.h>
+#   include <sys/wait.h>
+#   include <unistd.h>
+#endif
+
+namespace Bench
+{
+
+#if defined(__unix__)
+
+/**
+ * Счётчики процессов бенчмарка в разделяемой памяти.
+ */
+struct SharedCounters
+{
+    // Сохранённые изменения, о которых процессы успели сообщить
+    std::atomic<std::uint64_t> updates;
+    // Прочитанные состояния
+    std::atomic<std::uint64_t> reads;
+    // Несогласованные состояния
+    std::atomic<std::uint64_t> torn;
+};
+
+// Наибольшая глубина пути сеансов бенчмарка
+constexpr std::size_t kMaxDepth = 128;
+
+/**
+ * Проверка состояния: длина пути определяется номером изменения,
+ * а все узлы пути равны ему.
+ *
+ * \param state Состояние сеанса
+ * \return true - если состояние целое
+ */
+static bool IsConsistent(
+    const ES::SessionState& state)
+{
+    if (state.path.size() != state.sequence % (kMaxDepth + 1)) {
+        return false;
+    }
+    for (const auto node : state.path) {
+        if (node != static_cast<int>(state.sequence)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Работа процесса: чтение и изменение случайных сеансов.
+ *
+ * \param table Таблица сеансов
+ * \param sessions Количество сеансов
+ * \param counters Счётчики
+ * \param seed Начальное значение генератора
+ * \return
+ */
+[[noreturn]] static void RunProcess(
+    ES::ISessionTable& table,
+    const std::size_t sessions,
+    SharedCounters& counters,
+    const unsigned seed)
+{
+    std::mt19937 random(seed);
+    std::uniform_int_distribution<std::uint64_t> ids(1, sessions);
+    ES::SessionState state;
+    while (true) {
+        if (table.Read(ids(random), state)) {
+            counters.reads.fetch_add(1, std::memory_order_relaxed);
+            if (!IsConsistent(state)) {
+                counters.torn.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        table.Update(ids(random), [&counters](ES::SessionState& next) {
+            if (!IsConsistent(next)) {
+                counters.torn.fetch_add(1, std::memory_order_relaxed);
+            }
+            ++next.sequence;
+            next.path.assign(static_cast<std::size_t>(next.sequence % (kMaxDepth + 1)),
+                static_cast<int>(next.sequence));
+            return true;
+        });
+        counters.updates.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+/**
+ * Бенчмарк таблицы сеансов в разделяемой памяти.
+ * Процессы читают и изменяют случайные сеансы, а родитель
+ * периодически убивает случайный процесс и запускает новый.
+ * Проверяется, что ни одно состояние не оказалось разорванным
+ * и что сеансы процессов, убитых посреди изменения,
+ * продолжают изменяться другими процессами.
+ *
+ * \param args Аргументы бенчмарка
+ * \return Код завершения
+ */
+int RunSessionsBenchmark(
+    const arguments_t& args)
+{
+    const std::size_t processes = ArgumentOr(args, 0, 4);
+    const std::size_t sessions = ArgumentOr(args, 1, 1024);
+    const std::size_t seconds = ArgumentOr(args, 2, 3);
+
+    ES::SessionTableOptions options;
+    options.capacity = sessions * 2;
+    options.maxDepth = kMaxDepth;
+    auto table = ES::CreateSharedSessionTable(options);
+    for (std::size_t i = 0; i < sessions; ++i) {
+        table->Create();
+    }
+    auto counters = static_cast<SharedCounters*>(::mmap(nullptr, sizeof(SharedCounters),
+        PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0));
+    if (counters == MAP_FAILED) {
+        std::printf("FAILED: mmap\n");
+        return 1;
+    }
+
+    unsigned seed = 1;
+    const auto spawn = [&]() {
+        const auto pid = ::fork();
+        if (pid == 0) {
+            RunProcess(*table, sessions, *counters, seed);
+        }
+        ++seed;
+        return pid;
+    };
+    std::vector<pid_t> pids;
+    for (std::size_t i = 0; i < processes; ++i) {
+        pids.push_back(spawn());
+    }
+    // Убиваем случайный процесс каждые 10 мс
+    std::mt19937 random(42);
+    std::size_t kills = 0;
+    const auto start = std::chrono::steady_clock::now();
+    const auto deadline = start + std::chrono::seconds(seconds);
+    while (std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        auto& pid = pids[random() % pids.size()];
+        ::kill(pid, SIGKILL);
+        ::waitpid(pid, nullptr, 0);
+        ++kills;
+        pid = spawn();
+    }
+    for (const auto pid : pids) {
+        ::kill(pid, SIGKILL);
+        ::waitpid(pid, nullptr, 0);
+    }
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Каждое сохранённое изменение увеличивает номер изменения сеанса на 1.
+    // Процесс, убитый между сохранением и подсчётом, не успевает сообщить о нём
+    std::uint64_t committed = 0;
+    ES::SessionState state;
+    for (std::uint64_t id = 1; id <= sessions; ++id) {
+        if (!table->Read(id, state) || !IsConsistent(state)) {
+            counters->torn.fetch_add(1, std::memory_order_relaxed);
+        }
+        committed += state.sequence;
+    }
+    const auto updates = counters->updates.load();
+    const auto stats = table->GetStats();
+    std::printf("sessions: %zu processes, %zu sessions, %zu kills\n", processes, sessions, kills);
+    std::printf("  updates: %.0f/s, reads: %.0f/s, committed %llu, counted %llu\n",
+        double(updates) / elapsed, double(counters->reads.load()) / elapsed,
+        static_cast<unsigned long long>(committed), static_cast<unsigned long long>(updates));
+    std::printf("  recovered updates: %llu, torn states: %llu, shared memory %zu bytes\n",
+        static_cast<unsigned long long>(stats.recovered),
+        static_cast<unsigned long long>(counters->torn.load()), stats.bytes);
+    const bool failed = counters->torn.load() != 0
+        || committed < updates || committed > updates + kills;
+    ::munmap(counters, sizeof(SharedCounters));
+    if (failed) {
+        std::printf("FAILED: session table lost or tore updates\n");
+        return 1;
+    }
+    return 0;
+}
+
+#else
+
+int RunSessionsBenchmark(
+    const arguments_t&)
+{
+    std::printf("sessions: not supported on this platform\n");
+    return 0;
+}
+
+#endif
+
+}
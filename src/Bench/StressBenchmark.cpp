@@ -0,0 +1,292 @@
+﻿#include "Benchmarks.hpp"
+#include "Generator.hpp"
+
+#include "IExpertSystem.hpp"
+#include "ILogger.hpp"
+#include "LatencyHistogram.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace Bench
+{
+
+namespace
+{
+
+// Количество проходов, после которого рабочий поток
+// передаёт накопленные задержки в общую гистограмму
+constexpr std::size_t kFlushEvery = 64;
+// Количество проходов одного сеанса
+constexpr std::size_t kWalksPerSession = 16;
+// Количество проходов между сообщениями рабочего потока в лог
+constexpr std::size_t kLogEvery = 100000;
+
+/**
+ * Опубликованная версия экспертной системы.
+ * Перезагрузка публикует новую версию, рабочие потоки
+ * создают сеансы из последней опубликованной.
+ */
+struct Published
+{
+    std::mutex mutex;
+    std::shared_ptr<const ES::IExpertSystem> system;
+    std::atomic<std::uint64_t> generation{0};
+
+    void Publish(
+        std::shared_ptr<const ES::IExpertSystem> next)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        system = std::move(next);
+        generation.fetch_add(1, std::memory_order_release);
+    }
+
+    std::shared_ptr<const ES::IExpertSystem> Get()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return system;
+    }
+};
+
+/**
+ * Рабочий поток.
+ * Задержки копятся в локальной гистограмме и периодически
+ * переносятся в общую, которую забирает поток отчёта.
+ */
+struct StressWorker
+{
+    // Задержки за текущий интервал отчёта
+    std::mutex mutex;
+    ES::LatencyHistogram interval;
+    // Количество найденных несоответствий
+    std::atomic<std::size_t> errors{0};
+};
+
+/**
+ * Случайные проходы по дереву до окончания времени.
+ *
+ * \param worker Рабочий поток
+ * \param published Опубликованная версия экспертной системы
+ * \param languages Языки сеансов, пустая строка - основной язык
+ * \param nodes Количество узлов (идентификаторы идут подряд с 1)
+ * \param depth Глубина дерева
+ * \param seed Начальное значение генератора
+ * \param stop Признак окончания
+ * \return
+ */
+void RunWorker(
+    StressWorker& worker,
+    Published& published,
+    const std::vector<std::string>& languages,
+    const int nodes,
+    const std::size_t depth,
+    const unsigned seed,
+    const std::atomic<bool>& stop)
+{
+    std::mt19937 random(seed);
+    // 0 и 1 - допустимые ответы, 2 - отсутствует в конфигурации
+    std::uniform_int_distribution<int> answers(0, 2);
+    std::uniform_int_distribution<int> ids(1, nodes);
+    std::uniform_int_distribution<int> percent(0, 99);
+    ES::LatencyHistogram local;
+    std::shared_ptr<const ES::IExpertSystem> system;
+    std::unique_ptr<ES::IExpertSystem> session;
+    std::uint64_t generation = ~std::uint64_t(0);
+    std::size_t walks = 0;
+    std::size_t textBytes = 0;
+    while (!stop.load(std::memory_order_relaxed)) {
+        const auto start = std::chrono::steady_clock::now();
+        // Переходим на последнюю версию и периодически создаём новый сеанс
+        const auto current = published.generation.load(std::memory_order_acquire);
+        if (current != generation) {
+            system = published.Get();
+            generation = current;
+            session.reset();
+        }
+        if (!session || walks % kWalksPerSession == 0) {
+            session = system->CreateSession(languages[random() % languages.size()]);
+        }
+        session->Reset();
+        for (std::size_t step = 0; step < depth * 3 && !session->IsFinished(); ++step) {
+            textBytes += session->GetCurrentData().size();
+            const auto candidates = session->GetCandidatesCount();
+            if (candidates == 0) {
+                worker.errors.fetch_add(1, std::memory_order_relaxed);
+            }
+            const auto action = percent(random);
+            if (action < 5) {
+                session->Back();
+            }
+            else if (action < 6) {
+                session->JumpTo(ids(random));
+            }
+            else if (action < 8) {
+                session->IsCandidate(ids(random));
+            }
+            else {
+                session->SetAnswer(answers(random));
+            }
+        }
+        if (session->IsFinished() && session->GetCandidatesCount() != 1) {
+            worker.errors.fetch_add(1, std::memory_order_relaxed);
+        }
+        const auto finish = std::chrono::steady_clock::now();
+        local.Add(static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(finish - start).count()));
+        if (++walks % kFlushEvery == 0) {
+            std::lock_guard<std::mutex> lock(worker.mutex);
+            worker.interval.Merge(local);
+            local = ES::LatencyHistogram();
+        }
+        if (walks % kLogEvery == 0) {
+            ES::logger->Log(ES::LogLevel::Info, "stress worker " + std::to_string(seed)
+                + ": " + std::to_string(walks) + " walks, " + std::to_string(textBytes) + " text bytes");
+        }
+    }
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    worker.interval.Merge(local);
+}
+
+}
+
+/**
+ * Нагрузочный бенчмарк общей экспертной системы.
+ * Сотни потоков проходят дерево случайными сеансами
+ * (ответы, в том числе неверные, возвраты, переходы к узлам,
+ * запросы оставшихся ответов, тексты на разных языках),
+ * пока отдельный поток периодически перезагружает конфигурацию,
+ * чередуя две её версии, и заранее загружает тексты языков. Раз в секунду выводятся пропускная
+ * способность и задержки прохода за прошедший интервал.
+ * Бенчмарк предназначен в том числе для сборок
+ * с ThreadSanitizer и AddressSanitizer.
+ *
+ * \param args Аргументы бенчмарка
+ * \return Код завершения
+ */
+int RunStressBenchmark(
+    const arguments_t& args)
+{
+    const std::size_t seconds = ArgumentOr(args, 0, 10);
+    const std::size_t threadsCount = ArgumentOr(args, 1, 256);
+    GeneratorOptions options;
+    options.depth = ArgumentOr(args, 2, 12);
+    const std::size_t reloadMs = ArgumentOr(args, 3, 200);
+    options.textLength = 32;
+    options.languages = 2;
+
+    // Две версии конфигурации, отличающиеся текстами части узлов
+    std::vector<std::string> paths;
+    paths.push_back(GenerateConfig(options));
+    options.changeEvery = 7;
+    paths.push_back(GenerateConfig(options));
+
+    auto loader = ES::CreateExpertSystem();
+    loader->Load(paths.front());
+    auto languages = loader->GetLanguages();
+    languages.push_back(std::string());
+    for (const auto& language : languages) {
+        loader->CreateSession(language);
+    }
+    Published published;
+    published.Publish(loader->CreateSession());
+    const int nodes = (1 << (options.depth + 1)) - 1;
+
+    std::printf("stress: %zu threads, %zu s, depth %zu, reload every %zu ms\n",
+        threadsCount, seconds, options.depth, reloadMs);
+    std::atomic<bool> stop{false};
+    std::vector<std::unique_ptr<StressWorker>> workers;
+    std::vector<std::thread> threads;
+    for (std::size_t i = 0; i < threadsCount; ++i) {
+        workers.push_back(std::make_unique<StressWorker>());
+        threads.emplace_back(RunWorker, std::ref(*workers.back()), std::ref(published),
+            std::cref(languages), nodes, options.depth, static_cast<unsigned>(i), std::cref(stop));
+    }
+    // Перезагрузка чередует версии конфигурации
+    std::atomic<std::size_t> reloads{0};
+    std::thread reloader([&]
+    {
+        for (std::size_t version = 1; ; ++version) {
+            const auto next = std::chrono::steady_clock::now() + std::chrono::milliseconds(reloadMs);
+            while (!stop.load() && std::chrono::steady_clock::now() < next) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+            if (stop.load()) {
+                break;
+            }
+            loader->Load(paths[version % paths.size()]);
+            // Тексты языков загружаются до публикации, чтобы рабочие
+            // потоки не ждали их загрузки при создании сеансов
+            for (const auto& language : languages) {
+                loader->CreateSession(language);
+            }
+            published.Publish(loader->CreateSession());
+            reloads.fetch_add(1);
+        }
+    });
+
+    // Отчёт по интервалам
+    ES::LatencyHistogram total;
+    const auto begin = std::chrono::steady_clock::now();
+    auto previous = begin;
+    for (std::size_t second = 1; second <= seconds; ++second) {
+        std::this_thread::sleep_until(begin + std::chrono::seconds(second));
+        ES::LatencyHistogram interval;
+        for (auto& worker : workers) {
+            std::lock_guard<std::mutex> lock(worker->mutex);
+            interval.Merge(worker->interval);
+            worker->interval = ES::LatencyHistogram();
+        }
+        const auto now = std::chrono::steady_clock::now();
+        const double elapsed = std::chrono::duration<double>(now - previous).count();
+        previous = now;
+        total.Merge(interval);
+        std::printf("  %3zus: %10.0f walks/s, p50 %8llu ns, p99 %8llu ns, p99.9 %9llu ns, max %10llu ns, reloads %zu\n",
+            second, double(interval.Count()) / elapsed,
+            static_cast<unsigned long long>(interval.Percentile(50)),
+            static_cast<unsigned long long>(interval.Percentile(99)),
+            static_cast<unsigned long long>(interval.Percentile(99.9)),
+            static_cast<unsigned long long>(interval.Max()),
+            reloads.load());
+        std::fflush(stdout);
+    }
+    stop = true;
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    reloader.join();
+    std::size_t errors = 0;
+    for (auto& worker : workers) {
+        total.Merge(worker->interval);
+        errors += worker->errors.load();
+    }
+    const double elapsed = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - begin).count();
+    std::printf("  total: %llu walks, %.0f walks/s, p50 %llu ns, p99 %llu ns, p99.9 %llu ns, "
+        "%zu reloads, %zu errors\n",
+        static_cast<unsigned long long>(total.Count()), double(total.Count()) / elapsed,
+        static_cast<unsigned long long>(total.Percentile(50)),
+        static_cast<unsigned long long>(total.Percentile(99)),
+        static_cast<unsigned long long>(total.Percentile(99.9)),
+        reloads.load(), errors);
+
+    for (const auto& path : paths) {
+        std::filesystem::remove(path);
+        for (std::size_t language = 1; language <= options.languages; ++language) {
+            std::filesystem::remove(path + ".l" + std::to_string(language));
+        }
+    }
+    if (errors != 0) {
+        std::printf("FAILED: inconsistent session state\n");
+        return 1;
+    }
+    return 0;
+}
+
+}
@@ -0,0 +1,131 @@
+﻿#include "Benchmarks.hpp"
+#include "AllocationCounter.hpp"
+#include "Generator.hpp"
+
+#include "IExpertSystem.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <random>
+
+namespace Bench
+{
+
+/**
+ * Результаты одного варианта хранения текстов.
+ */
+struct TextsResult
+{
+    // Занятая после загрузки память в байтах
+    std::ptrdiff_t liveBytes = 0;
+    // Время шага без получения текста
+    double stepNs = 0;
+    // Время получения текста случайного узла
+    double randomTextNs = 0;
+    // Время получения текста того же узла
+    double hotTextNs = 0;
+};
+
+/**
+ * Прогон одного варианта хранения текстов.
+ *
+ * \param path Путь к конфигурации
+ * \param compression Параметры хранения текстов
+ * \param steps Количество шагов
+ * \return Результаты
+ */
+static TextsResult RunVariant(
+    const std::string& path,
+    const ES::TextCompressionOptions& compression,
+    const std::size_t steps)
+{
+    TextsResult result;
+    auto before = CurrentAllocationStats();
+    auto es = ES::CreateExpertSystem();
+    es->SetTextCompression(compression);
+    es->Load(path);
+    result.liveBytes = (CurrentAllocationStats() - before).liveBytes;
+
+    std::mt19937 random(42);
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t step = 0; step < steps; ++step) {
+        if (es->IsFinished()) {
+            es->Reset();
+            continue;
+        }
+        es->SetAnswer(static_cast<int>(random() & 1));
+    }
+    auto finish = std::chrono::steady_clock::now();
+    result.stepNs = std::chrono::duration<double, std::nano>(finish - start).count()
+        / double(steps);
+
+    // Случайные узлы: почти каждый текст разжимается заново
+    std::size_t textBytes = 0;
+    std::size_t texts = 0;
+    double textNs = 0;
+    for (std::size_t step = 0; step < steps; ++step) {
+        if (es->IsFinished()) {
+            const auto textStart = std::chrono::steady_clock::now();
+            textBytes += es->GetCurrentData().size();
+            textNs += std::chrono::duration<double, std::nano>(
+                std::chrono::steady_clock::now() - textStart).count();
+            ++texts;
+            es->Reset();
+            continue;
+        }
+        es->SetAnswer(static_cast<int>(random() & 1));
+    }
+    result.randomTextNs = textNs / double(texts ? texts : 1);
+
+    // Один и тот же узел: текст берётся из кэша
+    es->Reset();
+    start = std::chrono::steady_clock::now();
+    for (std::size_t step = 0; step < steps; ++step) {
+        textBytes += es->GetCurrentData().size();
+    }
+    finish = std::chrono::steady_clock::now();
+    result.hotTextNs = std::chrono::duration<double, std::nano>(finish - start).count()
+        / double(steps);
+    if (!textBytes) {
+        std::printf("  (no text)\n");
+    }
+    return result;
+}
+
+/**
+ * Бенчмарк хранения текстов.
+ * Сравнивает занятую память, время шага и время получения
+ * текста для несжатых и сжатых текстов узлов.
+ *
+ * \param args Аргументы бенчмарка
+ * \return Код завершения
+ */
+int RunTextsBenchmark(
+    const arguments_t& args)
+{
+    GeneratorOptions options;
+    options.depth = ArgumentOr(args, 0, 16);
+    options.textLength = ArgumentOr(args, 1, 256);
+    const std::size_t steps = ArgumentOr(args, 2, 1000000);
+
+    const auto path = GenerateConfig(options);
+    ES::TextCompressionOptions compression;
+    compression.enabled = true;
+
+    std::printf("texts: %zu nodes, %zu bytes per text\n",
+        (std::size_t(1) << (options.depth + 1)) - 1, options.textLength);
+    const auto plain = RunVariant(path, ES::TextCompressionOptions(), steps);
+    const auto compressed = RunVariant(path, compression, steps);
+    std::filesystem::remove(path);
+
+    const char* format = "  %-10s %12td bytes, %6.2f ns/step, "
+        "%8.2f ns/random text, %6.2f ns/hot text\n";
+    std::printf(format, "plain", plain.liveBytes, plain.stepNs,
+        plain.randomTextNs, plain.hotTextNs);
+    std::printf(format, "compressed", compressed.liveBytes, compressed.stepNs,
+        compressed.randomTextNs, compressed.hotTextNs);
+    return 0;
+}
+
+}
@@ -0,0 +1,81 @@
+﻿#include "Benchmarks.hpp"
+#include "Generator.hpp"
+
+#include "IExpertSystem.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+
+namespace Bench
+{
+
+/**
+ * Проход по дереву заданным количеством шагов.
+ * Ответы чередуются детерминированно, чтобы оба прохода
+ * бенчмарка выполняли одинаковую работу.
+ *
+ * \param es Экспертная система
+ * \param steps Количество шагов
+ * \return Среднее время шага в наносекундах
+ */
+static double Traverse(
+    ES::IExpertSystem& es,
+    const std::size_t steps)
+{
+    es.Reset();
+    const auto start = std::chrono::steady_clock::now();
+    for (std::size_t step = 0; step < steps; ++step) {
+        if (es.IsFinished()) {
+            es.Reset();
+            continue;
+        }
+        es.SetAnswer(static_cast<int>((step * 2654435761u) >> 7) & 1);
+    }
+    const auto finish = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(finish - start).count() / double(steps);
+}
+
+/**
+ * Бенчмарк накладных расходов записи трассы.
+ *
+ * \param args Аргументы бенчмарка
+ * \return Код завершения
+ */
+int RunTraceBenchmark(
+    const arguments_t& args)
+{
+    const std::size_t steps = ArgumentOr(args, 0, 10000000);
+    GeneratorOptions options;
+    options.depth = ArgumentOr(args, 1, 12);
+
+    const auto path = GenerateConfig(options);
+    auto es = ES::CreateExpertSystem();
+    es->Load(path);
+    std::filesystem::remove(path);
+
+    const double plain = Traverse(*es, steps);
+
+    const auto directory = std::filesystem::temp_directory_path() / "es_bench_trace";
+    std::filesystem::remove_all(directory);
+    ES::TraceOptions traceOptions;
+    traceOptions.directory = directory.string();
+    auto recorder = ES::CreateTraceRecorder(traceOptions);
+    es->SetTraceRecorder(recorder);
+    const double traced = Traverse(*es, steps);
+    es->SetTraceRecorder(nullptr);
+    recorder->Flush();
+    const auto stats = recorder->GetStats();
+    recorder.reset();
+    std::filesystem::remove_all(directory);
+
+    std::printf("trace: %zu steps, %.2f ns/step plain, %.2f ns/step traced, "
+        "overhead %.2f ns/step\n", steps, plain, traced, traced - plain);
+    std::printf("  %llu records, %llu files, %llu stalls\n",
+        static_cast<unsigned long long>(stats.written),
+        static_cast<unsigned long long>(stats.files),
+        static_cast<unsigned long long>(stats.stalls));
+    return 0;
+}
+
+}
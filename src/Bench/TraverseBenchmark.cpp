@@ -0,0 +1,71 @@
+﻿#include "Benchmarks.hpp"
+#include "AllocationCounter.hpp"
+#include "Generator.hpp"
+
+#include "IExpertSystem.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <random>
+
+namespace Bench
+{
+
+/**
+ * Бенчмарк прохода по дереву со случайными ответами.
+ * Каждый шаг запрашивает текущий узел, подаёт случайный ответ
+ * (в том числе неверный) и сбрасывает систему по достижении ответа.
+ * Все вызовы после загрузки не должны выделять память,
+ * иначе бенчмарк завершается с ошибкой.
+ *
+ * \param args Аргументы бенчмарка
+ * \return Код завершения
+ */
+int RunTraverseBenchmark(
+    const arguments_t& args)
+{
+    const std::size_t steps = ArgumentOr(args, 0, 1000000);
+    GeneratorOptions options;
+    options.depth = ArgumentOr(args, 1, 12);
+    const auto seed = static_cast<std::mt19937::result_type>(ArgumentOr(args, 2, 42));
+
+    const auto path = GenerateConfig(options);
+    auto es = ES::CreateExpertSystem();
+    es->Load(path);
+    std::filesystem::remove(path);
+
+    std::mt19937 random(seed);
+    // Ответы 0 и 1 допустимы, ответ 2 отсутствует в конфигурации
+    std::uniform_int_distribution<int> answers(0, 2);
+    std::size_t accepted = 0;
+    std::size_t finished = 0;
+    std::size_t textBytes = 0;
+
+    const auto before = CurrentAllocationStats();
+    const auto start = std::chrono::steady_clock::now();
+    for (std::size_t step = 0; step < steps; ++step) {
+        textBytes += es->GetCurrentData().size();
+        if (es->IsFinished()) {
+            ++finished;
+            es->Reset();
+            continue;
+        }
+        accepted += es->SetAnswer(answers(random)) ? 1 : 0;
+    }
+    const auto finish = std::chrono::steady_clock::now();
+    const auto stats = CurrentAllocationStats() - before;
+
+    const double ns = std::chrono::duration<double, std::nano>(finish - start).count();
+    std::printf("traverse: %zu steps, %zu accepted, %zu sessions finished, "
+        "%.2f ns/step, %zu text bytes\n",
+        steps, accepted, finished, ns / double(steps), textBytes);
+    std::printf("  allocations: %zu (%zu bytes)\n", stats.allocations, stats.bytes);
+    if (stats.allocations != 0) {
+        std::printf("FAILED: traversal must not allocate\n");
+        return 1;
+    }
+    return 0;
+}
+
+}
@@ -0,0 +1,56 @@
+﻿#include "Benchmarks.hpp"
+#include "Generator.hpp"
+
+#include "IExpertSystem.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <thread>
+
+namespace Bench
+{
+
+/**
+ * Бенчмарк проверки графа при загрузке.
+ * Загружает одну и ту же конфигурацию с проверкой в одном
+ * и в нескольких потоках и сравнивает время проверки
+ * со временем всей загрузки.
+ *
+ * \param args Аргументы бенчмарка
+ * \return Код завершения
+ */
+int RunValidateBenchmark(
+    const arguments_t& args)
+{
+    GeneratorOptions options;
+    options.depth = ArgumentOr(args, 0, 20);
+    const std::size_t threads = ArgumentOr(args, 1,
+        std::max(1u, std::thread::hardware_concurrency()));
+    const auto path = GenerateConfig(options);
+    std::printf("validate: %zu nodes\n", (std::size_t(1) << (options.depth + 1)) - 1);
+    for (const auto count : { std::size_t(1), threads }) {
+        ES::ValidationOptions validation;
+        validation.threads = count;
+        validation.strict = true;
+        auto es = ES::CreateExpertSystem();
+        es->SetValidation(validation);
+        const auto start = std::chrono::steady_clock::now();
+        es->Load(path);
+        const auto finish = std::chrono::steady_clock::now();
+        const auto report = es->GetValidationReport();
+        const auto loadMs = std::chrono::duration<double, std::milli>(finish - start).count();
+        std::printf("  %2zu threads: %8.2f ms (%.1f ns per node, %.1f%% of load), %zu issues\n",
+            count, report.milliseconds, 1e6 * report.milliseconds / double(report.nodes),
+            100.0 * report.milliseconds / loadMs, report.total);
+        if (report.total) {
+            std::filesystem::remove(path);
+            return 1;
+        }
+    }
+    std::filesystem::remove(path);
+    return 0;
+}
+
+}
@@ -0,0 +1,152 @@
+﻿#include "Benchmarks.hpp"
+#include "Generator.hpp"
+
+#include "ConfigParser.hpp"
+#include "IExpertSystem.hpp"
+#include "XmlScanner.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+namespace Bench
+{
+
+/**
+ * Лучшее время разбора конфигурации заданным способом.
+ *
+ * \param path Путь к конфигурации
+ * \param parser Способ разбора
+ * \param iterations Количество повторов
+ * \param stats Итог последнего разбора
+ * \return Время в миллисекундах
+ */
+static double MeasureParse(
+    const std::string& path,
+    const ES::XmlParser parser,
+    const std::size_t iterations,
+    ES::ConfigParseStats& stats)
+{
+    double best = 0;
+    for (std::size_t i = 0; i < iterations; ++i) {
+        const auto start = std::chrono::steady_clock::now();
+        stats = ES::ParseConfig(path, parser);
+        const auto finish = std::chrono::steady_clock::now();
+        const double ms = std::chrono::duration<double, std::milli>(finish - start).count();
+        best = i == 0 ? ms : std::min(best, ms);
+    }
+    return best;
+}
+
+/**
+ * Лучшее время разбора сканером схемы текста, уже находящегося в памяти,
+ * без чтения файла и передачи записей построителю.
+ *
+ * \param text Текст конфигурации
+ * \param iterations Количество повторов
+ * \return Время в миллисекундах, либо отрицательное число,
+ * если текст вышел за схему
+ */
+static double MeasureScan(
+    const std::string& text,
+    const std::size_t iterations)
+{
+    double best = 0;
+    for (std::size_t i = 0; i < iterations; ++i) {
+        ES::XmlScanner scanner;
+        const auto start = std::chrono::steady_clock::now();
+        const bool scanned = scanner.Scan(text.data(), text.size());
+        const auto finish = std::chrono::steady_clock::now();
+        if (!scanned) {
+            return -1;
+        }
+        const double ms = std::chrono::duration<double, std::milli>(finish - start).count();
+        best = i == 0 ? ms : std::min(best, ms);
+    }
+    return best;
+}
+
+/**
+ * Бенчмарк разбора xml-конфигурации: сканер схемы против pugixml
+ * на одной синтетической конфигурации. Оба способа передают записи
+ * построителю, который только считает их, поэтому время - это время
+ * разбора. Отдельно измеряется сам сканер на тексте в памяти. Контрольные суммы записей должны совпасть, а конфигурация
+ * с комментарием, выходящая за схему сканера, должна разобраться
+ * через pugixml с той же суммой.
+ *
+ * \param args Аргументы бенчмарка
+ * \return Код завершения
+ */
+int RunXmlBenchmark(
+    const arguments_t& args)
+{
+    GeneratorOptions options;
+    options.depth = ArgumentOr(args, 0, 18);
+    options.textLength = ArgumentOr(args, 1, 64);
+    const std::size_t iterations = std::max<std::size_t>(1, ArgumentOr(args, 2, 5));
+
+    const auto path = GenerateConfig(options);
+    const auto bytes = static_cast<double>(std::filesystem::file_size(path));
+    std::printf("xml: %.1f MB, depth %zu, text %zu\n", bytes / 1e6, options.depth, options.textLength);
+
+    ES::ConfigParseStats pugixml;
+    ES::ConfigParseStats scanner;
+    const double pugixmlMs = MeasureParse(path, ES::XmlParser::Pugixml, iterations, pugixml);
+    const double scannerMs = MeasureParse(path, ES::XmlParser::Scanner, iterations, scanner);
+    std::printf("  pugixml %9.2f ms, %6.2f GB/s\n", pugixmlMs, bytes / pugixmlMs / 1e6);
+    std::printf("  scanner %9.2f ms, %6.2f GB/s, x%.1f\n", scannerMs, bytes / scannerMs / 1e6,
+        pugixmlMs / scannerMs);
+    std::string text;
+    {
+        std::ifstream input(path, std::ios::binary);
+        std::stringstream buffer;
+        buffer << input.rdbuf();
+        text = buffer.str();
+    }
+    const double scanMs = MeasureScan(text, iterations);
+    if (scanMs < 0) {
+        std::printf("FAILED: scanner rejected the generated config\n");
+        std::filesystem::remove(path);
+        return 1;
+    }
+    std::printf("  scan only %7.2f ms, %6.2f GB/s, %s\n", scanMs, bytes / scanMs / 1e6,
+        std::string(ES::XmlScanner::Instructions()).c_str());
+    std::printf("  %zu nodes, %zu connections, %zu text bytes\n",
+        scanner.nodes, scanner.connections, scanner.textBytes);
+    if (scanner.checksum != pugixml.checksum || scanner.nodes != pugixml.nodes
+        || scanner.connections != pugixml.connections) {
+        std::printf("FAILED: scanner checksum %016llx, pugixml %016llx\n",
+            static_cast<unsigned long long>(scanner.checksum),
+            static_cast<unsigned long long>(pugixml.checksum));
+        std::filesystem::remove(path);
+        return 1;
+    }
+
+    // Полная загрузка экспертной системы сканером
+    {
+        auto es = ES::CreateExpertSystem();
+        const auto start = std::chrono::steady_clock::now();
+        es->Load(path);
+        const auto finish = std::chrono::steady_clock::now();
+        std::printf("  full load %9.2f ms\n",
+            std::chrono::duration<double, std::milli>(finish - start).count());
+    }
+
+    // Комментарий выходит за схему сканера: разбор переходит на pugixml
+    std::filesystem::remove(path);
+    const auto nodes = text.find("<nodes>");
+    text.insert(nodes + 7, "<!-- comment -->");
+    const auto commented = path + ".comment.xml";
+    std::ofstream(commented, std::ios::binary) << text;
+    ES::ConfigParseStats fallback;
+    const double fallbackMs = MeasureParse(commented, ES::XmlParser::Auto, 1, fallback);
+    std::filesystem::remove(commented);
+    std::printf("  fallback %8.2f ms, checksum %s\n", fallbackMs,
+        fallback.checksum == pugixml.checksum ? "matches" : "differs");
+    return fallback.checksum == pugixml.checksum ? 0 : 1;
+}
+
+}
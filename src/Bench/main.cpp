@@ -0,0 +1,75 @@
+﻿#include "Benchmarks.hpp"
+
+#include "ILogger.hpp"
+
+#include <cstdlib>
+#include <iostream>
+#include <map>
+
+namespace Bench
+{
+
+/**
+ * Получение числового аргумента с значением по умолчанию.
+ *
+ * \param args Аргументы бенчмарка
+ * \param index Номер аргумента
+ * \param defaultValue Значение, если аргумент не задан
+ * \return Значение аргумента
+ */
+std::size_t ArgumentOr(
+    const arguments_t& args,
+    const std::size_t index,
+    const std::size_t defaultValue)
+{
+    return index < args.size() ? std::stoull(args[index]) : defaultValue;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    // Доступные бенчмарки
+    const std::map<std::string, int(*)(const Bench::arguments_t&)> benchmarks = {
+        { "back", Bench::RunBackBenchmark },
+        { "bayes", Bench::RunBayesBenchmark },
+        { "bulk", Bench::RunBulkBenchmark },
+        { "candidates", Bench::RunCandidatesBenchmark },
+        { "ids", Bench::RunIdsBenchmark },
+        { "journal", Bench::RunJournalBenchmark },
+        { "languages", Bench::RunLanguagesBenchmark },
+        { "learn", Bench::RunLearnBenchmark },
+        { "load", Bench::RunLoadBenchmark },
+        { "memory", Bench::RunMemoryBenchmark },
+        { "optimize", Bench::RunOptimizeBenchmark },
+        { "paths", Bench::RunPathsBenchmark },
+        { "reload", Bench::RunReloadBenchmark },
+        { "search", Bench::RunSearchBenchmark },
+        { "sessions", Bench::RunSessionsBenchmark },
+        { "stress", Bench::RunStressBenchmark },
+        { "traverse", Bench::RunTraverseBenchmark },
+        { "trace", Bench::RunTraceBenchmark },
+        { "replicate", Bench::RunReplicationBenchmark },
+        { "validate", Bench::RunValidateBenchmark },
+        { "texts", Bench::RunTextsBenchmark },
+        { "xml", Bench::RunXmlBenchmark },
+        { "cluster", Bench::RunClusterBenchmark },
+    };
+    // Ожидаем, что нам передали имя бенчмарка
+    auto benchmark = argc < 2 ? benchmarks.end() : benchmarks.find(argv[1]);
+    if (benchmark == benchmarks.end()) {
+        std::cout << "Usage: Bench <benchmark> [args...]\nBenchmarks:";
+        for (const auto& [name, _] : benchmarks) {
+            std::cout << ' ' << name;
+        }
+        std::cout << std::endl;
+        return EXIT_FAILURE;
+    }
+    try {
+        return benchmark->second(Bench::arguments_t(argv + 2, argv + argc));
+    }
+    catch (const std::exception& ex) {
+        ES::logger->Log(ES::LogLevel::Error, ex.what());
+        return EXIT_FAILURE;
+    }
+}
@@ -0,0 +1,776 @@
+﻿#include "BayesExpertSystem.hpp"
+
+#include "GraphValidator.hpp"
+#include "ILogger.hpp"
+#include "SessionJournal.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+
+namespace ES
+{
+
+/**
+ * Создание вероятностной экспертной системы.
+ *
+ * \return Указатель на созданную экспертную систему
+ */
+std::unique_ptr<IExpertSystem> CreateBayesExpertSystem()
+{
+    return std::make_unique<BayesExpertSystem>();
+}
+
+/**
+ * Конструктор. Назначает сеансу уникальный идентификатор.
+ */
+BayesExpertSystem::BayesExpertSystem() noexcept:
+    m_sessionID(NextSessionID())
+{
+}
+
+/**
+ * Загрузка модели из раздела <bayes> конфигурации.
+ * Модель с ошибками в строгом режиме проверки, как и модель,
+ * не помещающаяся в бюджет памяти, не заменяет прежнюю.
+ *
+ * \param configPath Путь к конфигурации
+ * \return
+ */
+void BayesExpertSystem::Load(
+    const std::string& configPath) noexcept(false)
+{
+    const auto start = std::chrono::steady_clock::now();
+    auto model = std::make_shared<const BayesModel>(configPath);
+    auto validation = std::make_shared<ValidationReport>(model->Issues());
+    validation->milliseconds = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+    const auto memory = model->Memory();
+    logger->Log(LogLevel::Info, u8"Модель загружена: диагнозов "
+        + std::to_string(model->DiagnosesCount()) + u8", вопросов "
+        + std::to_string(model->Questions().size()) + u8", вероятностей "
+        + std::to_string(validation->connections) + u8", память "
+        + std::to_string(memory.total) + u8" байт, команды "
+        + std::string(BayesModel::Instructions()));
+    for (std::size_t issue = 0; issue < kValidationIssues; ++issue) {
+        if (const auto count = validation->issues[issue].count) {
+            logger->Log(LogLevel::Warning, std::string(
+                GetValidationIssueName(static_cast<ValidationIssue>(issue))) + u8": "
+                + std::to_string(count));
+        }
+    }
+    // Сжать модель нельзя, поэтому в режиме Degrade она тоже отклоняется
+    if (m_memoryBudget.limit && memory.total > m_memoryBudget.limit) {
+        throw std::runtime_error(u8"База знаний превышает бюджет памяти "
+            + std::to_string(m_memoryBudget.limit) + u8" байт");
+    }
+    if (m_validation.strict && validation->total) {
+        throw std::runtime_error(u8"База знаний содержит ошибки: "
+            + std::to_string(validation->total));
+    }
+    m_model = std::move(model);
+    m_validationReport = std::move(validation);
+    m_language = nullptr;
+    Reset();
+}
+
+/**
+ * Получение названия экспертной системы.
+ *
+ * \return Название экспертной системы
+ */
+std::string BayesExpertSystem::GetName() const
+{
+    if (m_language && !m_language->name.empty()) {
+        return m_language->name;
+    }
+    return m_model ? m_model->Name() : std::string();
+}
+
+/**
+ * Получение текста текущего вопроса либо лучшего диагноза.
+ *
+ * \return Текст, действительный до следующей загрузки
+ */
+std::string_view BayesExpertSystem::GetCurrentData() const
+{
+    if (!m_model) {
+        return {};
+    }
+    if (m_current != kInvalidIndex) {
+        return Text(m_model->DiagnosesCount() + m_current);
+    }
+    return m_best != kInvalidIndex ? Text(m_best) : std::string_view();
+}
+
+/**
+ * Получение идентификатора текущего вопроса либо лучшего диагноза.
+ *
+ * \return Идентификатор, либо -1, если модель не загружена
+ * или все диагнозы невозможны
+ */
+int BayesExpertSystem::GetCurrentID() const
+{
+    if (!m_model) {
+        return -1;
+    }
+    if (m_current != kInvalidIndex) {
+        return m_model->Questions()[m_current].id;
+    }
+    return m_best != kInvalidIndex ? m_model->DiagnosisID(m_best) : -1;
+}
+
+/**
+ * Подача ответа на текущий вопрос.
+ * Оценки всех диагнозов обновляются сложением со строкой матрицы
+ * за O(количество диагнозов). Для отмены ответа запоминаются только
+ * оценки диагнозов, которые ответ делает невозможными, поэтому память
+ * выделяется, лишь пока журнал отмены растёт сверх прежнего размера.
+ *
+ * \param value Ответ: от 0 до количества вариантов ответа - 1
+ * \return true - если ответ принят
+ */
+bool BayesExpertSystem::SetAnswer(
+    const int value)
+{
+    if (m_current == kInvalidIndex) {
+        return false;
+    }
+    const auto& question = m_model->Questions()[m_current];
+    if (value < 0 || value >= question.answers) {
+        return false;
+    }
+    const auto row = question.row + static_cast<std::size_t>(value);
+    const auto [first, last] = m_model->Impossible(row);
+    for (auto diagnosis = first; diagnosis != last; ++diagnosis) {
+        m_undo.push_back(m_scores[*diagnosis]);
+    }
+    BayesModel::AddRow(m_scores.data(), m_model->Row(row), m_scores.size());
+    m_answered.push_back(m_current);
+    m_values.push_back(value);
+    m_isAnswered[m_current] = true;
+    Advance();
+    return true;
+}
+
+/**
+ * Проверка завершения работы экспертной системы.
+ *
+ * \return true - если вопросы закончились либо лучший диагноз
+ * достиг порога вероятности
+ */
+bool BayesExpertSystem::IsFinished() const
+{
+    return m_finished;
+}
+
+/**
+ * Сброс сеанса: оценки возвращаются к априорным.
+ *
+ * \return
+ */
+void BayesExpertSystem::Reset()
+{
+    if (!m_model) {
+        return;
+    }
+    const auto questions = m_model->Questions().size();
+    m_answered.clear();
+    m_answered.reserve(questions);
+    m_values.clear();
+    m_values.reserve(questions);
+    m_isAnswered.assign(questions, false);
+    m_undo.clear();
+    Recompute();
+    Advance();
+}
+
+/**
+ * Отмена последнего ответа за O(количество диагнозов).
+ *
+ * \return true - если возврат выполнен
+ */
+bool BayesExpertSystem::Back()
+{
+    return !m_answered.empty() && BackTo(m_answered.size() - 1);
+}
+
+/**
+ * Отмена ответов, поданных после вопроса на заданной глубине.
+ * Вопрос на этой глубине снова становится текущим. Строки отменяемых
+ * ответов вычитаются из оценок, а оценки диагнозов, которые ответ
+ * сделал невозможными, берутся из журнала отмены. Если отменяется
+ * больше ответов, чем остаётся, то оценки дешевле пересчитать
+ * по оставшимся ответам, заодно сбросив ошибку округления.
+ *
+ * \param depth Количество оставляемых ответов
+ * \return true - если возврат выполнен
+ */
+bool BayesExpertSystem::BackTo(
+    const std::size_t depth)
+{
+    if (depth > m_answered.size()) {
+        return false;
+    }
+    if (depth == m_answered.size()) {
+        return true;
+    }
+    const auto question = m_answered[depth];
+    const auto& questions = m_model->Questions();
+    const auto recompute = m_answered.size() - depth > depth;
+    for (auto i = m_answered.size(); i-- > depth;) {
+        m_isAnswered[m_answered[i]] = false;
+        const auto row = questions[m_answered[i]].row + static_cast<std::size_t>(m_values[i]);
+        const auto [first, last] = m_model->Impossible(row);
+        const auto saved = m_undo.size() - static_cast<std::size_t>(last - first);
+        if (!recompute) {
+            BayesModel::SubtractRow(m_scores.data(), m_model->Row(row), m_scores.size());
+            std::size_t k = saved;
+            for (auto diagnosis = first; diagnosis != last; ++diagnosis) {
+                m_scores[*diagnosis] = m_undo[k++];
+            }
+        }
+        m_undo.resize(saved);
+    }
+    m_answered.resize(depth);
+    m_values.resize(depth);
+    if (recompute) {
+        Recompute();
+    }
+    Advance();
+    m_current = question;
+    m_finished = false;
+    return true;
+}
+
+/**
+ * Получение количества поданных ответов.
+ *
+ * \return Количество ответов
+ */
+std::size_t BayesExpertSystem::GetDepth() const
+{
+    return m_answered.size();
+}
+
+/**
+ * Получение идентификатора вопроса на пути сеанса.
+ *
+ * \param depth Номер ответа, GetDepth() - текущий узел
+ * \return Идентификатор, либо -1, если глубина больше текущей
+ */
+int BayesExpertSystem::GetPathID(
+    const std::size_t depth) const
+{
+    if (depth < m_answered.size()) {
+        return m_model->Questions()[m_answered[depth]].id;
+    }
+    return depth == m_answered.size() ? GetCurrentID() : -1;
+}
+
+/**
+ * Получение количества возможных диагнозов:
+ * диагнозов с ненулевой вероятностью.
+ *
+ * \return Количество диагнозов
+ */
+std::size_t BayesExpertSystem::GetCandidatesCount() const
+{
+    if (!m_model) {
+        return 0;
+    }
+    return static_cast<std::size_t>(std::count_if(m_scores.begin(),
+        m_scores.begin() + m_model->DiagnosesCount(),
+        [](const float score) { return score > -HUGE_VALF; }));
+}
+
+/**
+ * Проверка, что вероятность диагноза не нулевая.
+ *
+ * \param answerID Идентификатор диагноза
+ * \return true - если диагноз возможен
+ */
+bool BayesExpertSystem::IsCandidate(
+    const int answerID) const
+{
+    if (!m_model) {
+        return false;
+    }
+    const auto diagnosis = m_model->FindDiagnosis(answerID);
+    return diagnosis != kInvalidIndex && m_scores[diagnosis] > -HUGE_VALF;
+}
+
+/**
+ * Получение возможных диагнозов.
+ *
+ * \return Идентификаторы диагнозов в порядке конфигурации
+ */
+std::vector<int> BayesExpertSystem::GetCandidates() const
+{
+    std::vector<int> result;
+    if (!m_model) {
+        return result;
+    }
+    for (std::size_t diagnosis = 0; diagnosis < m_model->DiagnosesCount(); ++diagnosis) {
+        if (m_scores[diagnosis] > -HUGE_VALF) {
+            result.push_back(m_model->DiagnosisID(diagnosis));
+        }
+    }
+    return result;
+}
+
+/**
+ * Пересечение возможных диагнозов с заданным набором.
+ *
+ * \param answerIDs Идентификаторы диагнозов
+ * \return Возможные диагнозы из набора в порядке набора
+ */
+std::vector<int> BayesExpertSystem::FilterCandidates(
+    const std::vector<int>& answerIDs) const
+{
+    std::vector<int> result;
+    for (const auto id : answerIDs) {
+        if (IsCandidate(id)) {
+            result.push_back(id);
+        }
+    }
+    return result;
+}
+
+/**
+ * Получение наиболее вероятных диагнозов.
+ * Лучшие оценки отбираются кучей заданного размера за один
+ * проход, вероятности нормируются по всем диагнозам.
+ *
+ * \param count Наибольшее количество диагнозов
+ * \return Диагнозы по убыванию вероятности
+ */
+std::vector<ScoredCandidate> BayesExpertSystem::GetTopCandidates(
+    const std::size_t count) const
+{
+    std::vector<ScoredCandidate> top;
+    if (!m_model || !count || m_best == kInvalidIndex) {
+        return top;
+    }
+    using entry_t = std::pair<float, node_index_t>;
+    const auto greater = [](const entry_t& a, const entry_t& b)
+    {
+        return a.first != b.first ? a.first > b.first : a.second < b.second;
+    };
+    std::vector<entry_t> heap;
+    heap.reserve(count);
+    const auto diagnoses = m_model->DiagnosesCount();
+    for (std::size_t diagnosis = 0; diagnosis < diagnoses; ++diagnosis) {
+        const auto score = m_scores[diagnosis];
+        if (!(score > -HUGE_VALF)) {
+            continue;
+        }
+        const entry_t entry(score, static_cast<node_index_t>(diagnosis));
+        if (heap.size() < count) {
+            heap.push_back(entry);
+            std::push_heap(heap.begin(), heap.end(), greater);
+        }
+        else if (greater(entry, heap.front())) {
+            std::pop_heap(heap.begin(), heap.end(), greater);
+            heap.back() = entry;
+            std::push_heap(heap.begin(), heap.end(), greater);
+        }
+    }
+    std::sort_heap(heap.begin(), heap.end(), greater);
+    const auto best = m_scores[m_best];
+    const auto normalizer = Normalizer(best);
+    top.reserve(heap.size());
+    for (const auto& [score, diagnosis] : heap) {
+        top.push_back({ m_model->DiagnosisID(diagnosis), std::exp(double(score - best)) / normalizer });
+    }
+    return top;
+}
+
+/**
+ * Получение количества возможных диагнозов, общих с заданным узлом.
+ * Любой вопрос оставляет возможными все диагнозы.
+ *
+ * \param nodeID Идентификатор вопроса либо диагноза
+ * \return Количество возможных диагнозов для вопроса,
+ * 1 либо 0 для диагноза, 0, если узла нет
+ */
+std::size_t BayesExpertSystem::GetCommonCandidatesCount(
+    const int nodeID) const
+{
+    if (!m_model) {
+        return 0;
+    }
+    if (m_model->FindQuestion(nodeID) != kInvalidIndex) {
+        return GetCandidatesCount();
+    }
+    return IsCandidate(nodeID) ? 1 : 0;
+}
+
+/**
+ * Получение путей до узла не поддерживается: ответы подаются
+ * в любом порядке, поэтому путей в модели нет.
+ *
+ * \param nodeID Идентификатор узла
+ * \param limit Наибольшее количество путей
+ * \return Не возвращается, бросается std::runtime_error
+ */
+std::vector<std::vector<PathStep>> BayesExpertSystem::GetPathsTo(
+    const int nodeID,
+    const std::size_t limit) const
+{
+    (void)nodeID;
+    (void)limit;
+    throw std::runtime_error(u8"Пути до узла не поддерживаются вероятностной экспертной системой");
+}
+
+/**
+ * Получение кратчайшего пути до узла не поддерживается.
+ *
+ * \param nodeID Идентификатор узла
+ * \return Не возвращается, бросается std::runtime_error
+ */
+std::vector<PathStep> BayesExpertSystem::GetShortestPathTo(
+    const int nodeID) const
+{
+    (void)nodeID;
+    throw std::runtime_error(u8"Пути до узла не поддерживаются вероятностной экспертной системой");
+}
+
+/**
+ * Переход к вопросу, на который ещё нет ответа.
+ * Поданные ответы сохраняются, поэтому так вопросы
+ * задаются в любом порядке.
+ *
+ * \param nodeID Идентификатор вопроса
+ * \return true - если переход выполнен
+ */
+bool BayesExpertSystem::JumpTo(
+    const int nodeID)
+{
+    if (!m_model) {
+        return false;
+    }
+    const auto question = m_model->FindQuestion(nodeID);
+    if (question == kInvalidIndex || m_isAnswered[question]) {
+        return false;
+    }
+    m_current = question;
+    m_finished = false;
+    return true;
+}
+
+/**
+ * Восстановление пути не поддерживается: сеанс модели
+ * определяется ответами, а не путём по дереву.
+ *
+ * \param path Идентификаторы узлов пути
+ * \return Не возвращается, бросается std::runtime_error
+ */
+bool BayesExpertSystem::RestorePath(
+    const std::vector<int>& path)
+{
+    (void)path;
+    throw std::runtime_error(u8"Восстановление пути не поддерживается вероятностной экспертной системой");
+}
+
+/**
+ * Поиск диагнозов и вопросов по тексту на основном языке.
+ * Индекс строится при загрузке модели.
+ *
+ * \param query Запрос
+ * \param limit Наибольшее количество результатов
+ * \return Найденные узлы по убыванию релевантности
+ */
+std::vector<SearchHit> BayesExpertSystem::Search(
+    const std::string& query,
+    const std::size_t limit) const
+{
+    return m_model ? m_model->Search(query, limit) : std::vector<SearchHit>();
+}
+
+/**
+ * Создание сеанса, разделяющего модель.
+ *
+ * \return Новый сеанс в начальном состоянии
+ */
+std::unique_ptr<IExpertSystem> BayesExpertSystem::CreateSession() const
+{
+    auto session = std::make_unique<BayesExpertSystem>();
+    session->m_model = m_model;
+    session->m_validationReport = m_validationReport;
+    session->m_validation = m_validation;
+    session->m_memoryBudget = m_memoryBudget;
+    session->m_language = m_language;
+    session->Reset();
+    return session;
+}
+
+/**
+ * Создание сеанса с текстами на заданном языке.
+ * Тексты языка загружаются при создании первого сеанса на нём.
+ *
+ * \param language Код языка, либо пустая строка для основного языка
+ * \return Новый сеанс в начальном состоянии
+ */
+std::unique_ptr<IExpertSystem> BayesExpertSystem::CreateSession(
+    const std::string& language) const noexcept(false)
+{
+    if (language.empty()) {
+        auto session = CreateSession();
+        static_cast<BayesExpertSystem&>(*session).m_language = nullptr;
+        return session;
+    }
+    if (!m_model) {
+        throw std::runtime_error(u8"Экспертная система не загружена");
+    }
+    const auto& texts = m_model->GetLanguage(language);
+    auto session = CreateSession();
+    static_cast<BayesExpertSystem&>(*session).m_language = &texts;
+    return session;
+}
+
+/**
+ * Получение дополнительных языков модели.
+ *
+ * \return Коды языков, перечисленных в конфигурации
+ */
+std::vector<std::string> BayesExpertSystem::GetLanguages() const
+{
+    return m_model ? m_model->Languages() : std::vector<std::string>();
+}
+
+/**
+ * Подключение записи трассы не поддерживается: трасса хранит
+ * индексы узлов дерева. Отключение записи ничего не делает.
+ *
+ * \param recorder Запись трассы, либо nullptr
+ * \return
+ */
+void BayesExpertSystem::SetTraceRecorder(
+    std::shared_ptr<ITraceRecorder> recorder)
+{
+    if (recorder) {
+        throw std::runtime_error(u8"Запись трассы не поддерживается вероятностной экспертной системой");
+    }
+}
+
+/**
+ * Репликация не нужна: сеансы только читают матрицу модели.
+ *
+ * \param options Параметры репликации
+ * \return
+ */
+void BayesExpertSystem::SetReplication(
+    const ReplicationOptions& options) noexcept(false)
+{
+    (void)options;
+}
+
+/**
+ * Получение количества копий модели.
+ *
+ * \return 1
+ */
+std::size_t BayesExpertSystem::GetReplicasCount() const
+{
+    return 1;
+}
+
+/**
+ * Сжатие текстов не поддерживается.
+ *
+ * \param options Параметры хранения текстов
+ * \return
+ */
+void BayesExpertSystem::SetTextCompression(
+    const TextCompressionOptions& options)
+{
+    (void)options;
+}
+
+/**
+ * Получение идентификатора сеанса.
+ *
+ * \return Идентификатор сеанса
+ */
+std::uint64_t BayesExpertSystem::GetSessionID() const
+{
+    return m_sessionID;
+}
+
+/**
+ * Подключение журнала сеансов не поддерживается: журнал хранит
+ * путь по дереву. Отключение журнала ничего не делает.
+ *
+ * \param journal Журнал сеансов, либо nullptr
+ * \return
+ */
+void BayesExpertSystem::SetSessionJournal(
+    std::shared_ptr<ISessionJournal> journal)
+{
+    if (journal) {
+        throw std::runtime_error(u8"Журнал сеансов не поддерживается вероятностной экспертной системой");
+    }
+}
+
+/**
+ * Продолжение сеанса из журнала. Журнал к модели не подключается,
+ * поэтому продолжать нечего.
+ *
+ * \param sessionID Идентификатор сеанса
+ * \return nullptr
+ */
+std::unique_ptr<IExpertSystem> BayesExpertSystem::ResumeSession(
+    const std::uint64_t sessionID) const
+{
+    (void)sessionID;
+    return nullptr;
+}
+
+/**
+ * Продолжение сеанса из заданного журнала не поддерживается:
+ * журнал хранит путь по дереву.
+ *
+ * \param journal Журнал сеансов
+ * \param sessionID Идентификатор сеанса
+ * \return Не возвращается, бросается std::runtime_error
+ */
+std::unique_ptr<IExpertSystem> BayesExpertSystem::ResumeSession(
+    std::shared_ptr<ISessionJournal> journal,
+    const std::uint64_t sessionID) const
+{
+    (void)journal;
+    (void)sessionID;
+    throw std::runtime_error(u8"Журнал сеансов не поддерживается вероятностной экспертной системой");
+}
+
+/**
+ * Установка бюджета памяти модели.
+ *
+ * \param options Параметры бюджета
+ * \return
+ */
+void BayesExpertSystem::SetMemoryBudget(
+    const MemoryBudgetOptions& options)
+{
+    m_memoryBudget = options;
+}
+
+/**
+ * Получение памяти, занятой моделью.
+ *
+ * \return Память по категориям
+ */
+MemoryReport BayesExpertSystem::GetMemoryReport() const
+{
+    return m_model ? m_model->Memory() : MemoryReport();
+}
+
+/**
+ * Установка параметров проверки модели.
+ *
+ * \param options Параметры проверки
+ * \return
+ */
+void BayesExpertSystem::SetValidation(
+    const ValidationOptions& options)
+{
+    m_validation = options;
+}
+
+/**
+ * Получение отчёта о проверке модели.
+ *
+ * \return Отчёт, пустой, если модель не загружена
+ */
+ValidationReport BayesExpertSystem::GetValidationReport() const
+{
+    return m_validationReport ? *m_validationReport : ValidationReport();
+}
+
+/**
+ * Пересчёт оценок по всем поданным ответам.
+ *
+ * \return
+ */
+void BayesExpertSystem::Recompute() noexcept
+{
+    const auto priors = m_model->Priors();
+    m_scores.assign(priors, priors + m_model->Stride());
+    const auto& questions = m_model->Questions();
+    for (std::size_t i = 0; i < m_answered.size(); ++i) {
+        const auto& question = questions[m_answered[i]];
+        BayesModel::AddRow(m_scores.data(),
+            m_model->Row(question.row + static_cast<std::size_t>(m_values[i])), m_scores.size());
+    }
+}
+
+/**
+ * Получение текста диагноза либо вопроса на языке сеанса.
+ *
+ * \param index Номер диагноза, либо количество диагнозов плюс номер вопроса
+ * \return Текст перевода, либо основной текст, если перевода нет
+ */
+std::string_view BayesExpertSystem::Text(
+    const std::size_t index) const noexcept
+{
+    if (m_language && !m_language->texts[index].empty()) {
+        return m_language->texts[index];
+    }
+    const auto diagnoses = m_model->DiagnosesCount();
+    return index < diagnoses ? m_model->DiagnosisText(index)
+        : m_model->Questions()[index - diagnoses].text;
+}
+
+/**
+ * Выбор лучшего диагноза и следующего вопроса.
+ * Следующий вопрос - первый в порядке конфигурации без ответа.
+ *
+ * \return
+ */
+void BayesExpertSystem::Advance() noexcept
+{
+    const auto best = BayesModel::MaxScore(m_scores.data(), m_scores.size());
+    m_best = kInvalidIndex;
+    if (best > -HUGE_VALF) {
+        m_best = static_cast<node_index_t>(
+            std::find(m_scores.begin(), m_scores.end(), best) - m_scores.begin());
+    }
+    m_current = kInvalidIndex;
+    for (std::size_t question = 0; question < m_isAnswered.size(); ++question) {
+        if (!m_isAnswered[question]) {
+            m_current = static_cast<node_index_t>(question);
+            break;
+        }
+    }
+    const auto threshold = m_model->Threshold();
+    m_finished = m_current == kInvalidIndex || m_best == kInvalidIndex
+        || (threshold > 0 && 1.0 / Normalizer(best) >= threshold);
+    if (m_finished) {
+        m_current = kInvalidIndex;
+    }
+}
+
+/**
+ * Получение суммы exp(оценка - best) по всем диагнозам.
+ * Пренебрежимо малые слагаемые пропускаются без вычисления экспоненты.
+ *
+ * \param best Наибольшая оценка
+ * \return Нормирующая сумма
+ */
+double BayesExpertSystem::Normalizer(
+    const float best) const noexcept
+{
+    double sum = 0;
+    const auto diagnoses = m_model->DiagnosesCount();
+    for (std::size_t diagnosis = 0; diagnosis < diagnoses; ++diagnosis) {
+        const auto delta = m_scores[diagnosis] - best;
+        if (delta > kNegligibleScore) {
+            sum += std::exp(delta);
+        }
+    }
+    return sum;
+}
+
+}
@@ -0,0 +1,200 @@
+﻿#pragma once
+
+#include "IExpertSystem.hpp"
+
+#include "BayesModel.hpp"
+
+namespace ES
+{
+
+/**
+ * Вероятностная экспертная система.
+ * Вместо прохода по дереву сеанс накапливает оценки всех диагнозов:
+ * каждый ответ прибавляет к ним строку матрицы модели. Текущий
+ * узел - вопрос, на который ещё нет ответа, а после завершения -
+ * самый вероятный диагноз. Вопросы задаются по порядку конфигурации,
+ * но JumpTo позволяет ответить на любой из оставшихся.
+ * Путей в модели нет, а трасса и журнал сеансов хранят пути
+ * по дереву, поэтому эти методы бросают std::runtime_error.
+ */
+class BayesExpertSystem final:
+    public IExpertSystem
+{
+public:
+    /**
+     * Конструктор. Назначает сеансу уникальный идентификатор.
+     */
+    BayesExpertSystem() noexcept;
+
+    // Реализация интерфейса IExpertSystem
+
+    void Load(
+        const std::string& configPath) noexcept(false) override;
+
+    std::string GetName() const override;
+
+    std::string_view GetCurrentData() const override;
+
+    int GetCurrentID() const override;
+
+    bool SetAnswer(
+        const int value) override;
+
+    bool IsFinished() const override;
+
+    void Reset() override;
+
+    bool Back() override;
+
+    bool BackTo(
+        const std::size_t depth) override;
+
+    std::size_t GetDepth() const override;
+
+    int GetPathID(
+        const std::size_t depth) const override;
+
+    std::size_t GetCandidatesCount() const override;
+
+    bool IsCandidate(
+        const int answerID) const override;
+
+    std::vector<int> GetCandidates() const override;
+
+    std::vector<int> FilterCandidates(
+        const std::vector<int>& answerIDs) const override;
+
+    std::vector<ScoredCandidate> GetTopCandidates(
+        const std::size_t count) const override;
+
+    std::size_t GetCommonCandidatesCount(
+        const int nodeID) const override;
+
+    std::vector<std::vector<PathStep>> GetPathsTo(
+        const int nodeID,
+        const std::size_t limit) const override;
+
+    std::vector<PathStep> GetShortestPathTo(
+        const int nodeID) const override;
+
+    bool JumpTo(
+        const int nodeID) override;
+
+    bool RestorePath(
+        const std::vector<int>& path) override;
+
+    std::vector<SearchHit> Search(
+        const std::string& query,
+        const std::size_t limit) const override;
+
+    std::unique_ptr<IExpertSystem> CreateSession() const override;
+
+    std::unique_ptr<IExpertSystem> CreateSession(
+        const std::string& language) const noexcept(false) override;
+
+    std::vector<std::string> GetLanguages() const override;
+
+    void SetTraceRecorder(
+        std::shared_ptr<ITraceRecorder> recorder) override;
+
+    void SetReplication(
+        const ReplicationOptions& options) noexcept(false) override;
+
+    std::size_t GetReplicasCount() const override;
+
+    void SetTextCompression(
+        const TextCompressionOptions& options) override;
+
+    std::uint64_t GetSessionID() const override;
+
+    void SetSessionJournal(
+        std::shared_ptr<ISessionJournal> journal) override;
+
+    std::unique_ptr<IExpertSystem> ResumeSession(
+        const std::uint64_t sessionID) const override;
+
+    std::unique_ptr<IExpertSystem> ResumeSession(
+        std::shared_ptr<ISessionJournal> journal,
+        const std::uint64_t sessionID) const override;
+
+    void SetMemoryBudget(
+        const MemoryBudgetOptions& options) override;
+
+    MemoryReport GetMemoryReport() const override;
+
+    void SetValidation(
+        const ValidationOptions& options) override;
+
+    ValidationReport GetValidationReport() const override;
+private:
+    // Оценки ниже лучшей больше чем на эту величину
+    // не влияют на нормировку вероятностей
+    static constexpr float kNegligibleScore = -30.0f;
+
+    /**
+     * Пересчёт оценок по всем поданным ответам.
+     *
+     * \return
+     */
+    void Recompute() noexcept;
+
+    /**
+     * Получение текста диагноза либо вопроса на языке сеанса.
+     *
+     * \param index Номер диагноза, либо количество диагнозов плюс номер вопроса
+     * \return Текст
+     */
+    std::string_view Text(
+        const std::size_t index) const noexcept;
+
+    /**
+     * Выбор лучшего диагноза и следующего вопроса после изменения оценок.
+     * Работа завершается, когда вопросы закончились либо вероятность
+     * лучшего диагноза достигла порога модели.
+     *
+     * \return
+     */
+    void Advance() noexcept;
+
+    /**
+     * Получение суммы exp(оценка - best) по всем диагнозам.
+     *
+     * \param best Наибольшая оценка
+     * \return Нормирующая сумма
+     */
+    double Normalizer(
+        const float best) const noexcept;
+
+    // Модель. Разделяется всеми сеансами
+    std::shared_ptr<const BayesModel> m_model;
+    // Тексты на языке сеанса, либо nullptr для основного языка.
+    // Принадлежат модели
+    const BayesModel::Language* m_language = nullptr;
+    // Отчёт о проверке модели
+    std::shared_ptr<const ValidationReport> m_validationReport;
+    // Параметры проверки модели
+    ValidationOptions m_validation;
+    // Бюджет памяти модели
+    MemoryBudgetOptions m_memoryBudget;
+    // Оценки диагнозов сеанса
+    std::vector<float> m_scores;
+    // Вопросы, на которые получены ответы, в порядке ответов
+    std::vector<node_index_t> m_answered;
+    // Поданные ответы
+    std::vector<int> m_values;
+    // Журнал отмены: оценки диагнозов, которые каждый ответ сделал
+    // невозможными, до ответа. Количество оценок ответа задаёт модель
+    std::vector<float> m_undo;
+    // Признаки вопросов, на которые получен ответ
+    std::vector<std::uint8_t> m_isAnswered;
+    // Текущий вопрос, либо kInvalidIndex после завершения
+    node_index_t m_current = kInvalidIndex;
+    // Лучший диагноз, либо kInvalidIndex, если все диагнозы невозможны
+    node_index_t m_best = kInvalidIndex;
+    // Признак завершения работы
+    bool m_finished = false;
+    // Идентификатор сеанса
+    std::uint64_t m_sessionID;
+};
+
+}
@@ -0,0 +1,660 @@
+﻿#include "BayesModel.hpp"
+
+#include "GraphValidator.hpp"
+#include "IExpertSystemLoader.hpp"
+#include "ILogger.hpp"
+
+#include "pugixml.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <limits>
+#include <memory_resource>
+#include <stdexcept>
+#include <unordered_set>
+
+// Команды AVX включаются только для функций сложения строк,
+// а выбираются при запуске, если их поддерживает процессор
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define ES_BAYES_AVX __attribute__((target("avx")))
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <immintrin.h>
+#include <intrin.h>
+#define ES_BAYES_AVX
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+namespace ES
+{
+
+namespace
+{
+
+// Логарифм нулевой вероятности
+constexpr float kImpossible = -std::numeric_limits<float>::infinity();
+// Допустимое отклонение суммы вероятностей ответов от 1
+constexpr double kProbabilityTolerance = 1e-3;
+
+/**
+ * Чтение числового атрибута.
+ *
+ * \param attribute Атрибут
+ * \param defaultValue Значение отсутствующего атрибута
+ * \return Значение атрибута
+ */
+inline double AttributeValue(
+    const pugi::xml_attribute& attribute,
+    const double defaultValue) noexcept
+{
+    return attribute ? std::strtod(attribute.as_string(), nullptr) : defaultValue;
+}
+
+/**
+ * Логарифм вероятности.
+ *
+ * \param probability Вероятность
+ * \return Логарифм, либо -inf для нулевой вероятности
+ */
+inline float LogProbability(
+    const double probability) noexcept
+{
+    return probability > 0 ? static_cast<float>(std::log(probability)) : kImpossible;
+}
+
+#if defined(ES_BAYES_AVX)
+/**
+ * Проверка поддержки команд AVX процессором и системой.
+ *
+ * \return true - если команды AVX можно использовать
+ */
+bool HasAvx() noexcept
+{
+#if defined(__AVX__)
+    return true;
+#elif defined(__GNUC__)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx");
+#else
+    // Процессор поддерживает AVX и XSAVE, а система сохраняет регистры YMM
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6;
+#endif
+}
+
+// Признак поддержки команд AVX
+const bool avxSupported = HasAvx();
+
+/**
+ * Сложение оценок со строкой матрицы командами AVX.
+ *
+ * \param scores Оценки диагнозов
+ * \param row Строка матрицы
+ * \param count Количество элементов
+ * \return
+ */
+ES_BAYES_AVX void AddRowAvx(
+    float* scores,
+    const float* row,
+    const std::size_t count) noexcept
+{
+    std::size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        _mm256_storeu_ps(scores + i,
+            _mm256_add_ps(_mm256_loadu_ps(scores + i), _mm256_loadu_ps(row + i)));
+    }
+    for (; i < count; ++i) {
+        scores[i] += row[i];
+    }
+}
+
+/**
+ * Вычитание строки матрицы из оценок командами AVX.
+ *
+ * \param scores Оценки диагнозов
+ * \param row Строка матрицы
+ * \param count Количество элементов
+ * \return
+ */
+ES_BAYES_AVX void SubtractRowAvx(
+    float* scores,
+    const float* row,
+    const std::size_t count) noexcept
+{
+    std::size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        _mm256_storeu_ps(scores + i,
+            _mm256_sub_ps(_mm256_loadu_ps(scores + i), _mm256_loadu_ps(row + i)));
+    }
+    for (; i < count; ++i) {
+        scores[i] -= row[i];
+    }
+}
+
+/**
+ * Получение наибольшей оценки командами AVX.
+ *
+ * \param scores Оценки диагнозов
+ * \param count Количество элементов
+ * \return Наибольшая оценка
+ */
+ES_BAYES_AVX float MaxScoreAvx(
+    const float* scores,
+    const std::size_t count) noexcept
+{
+    std::size_t i = 0;
+    auto lanes = _mm256_set1_ps(kImpossible);
+    for (; i + 8 <= count; i += 8) {
+        lanes = _mm256_max_ps(lanes, _mm256_loadu_ps(scores + i));
+    }
+    alignas(32) float values[8];
+    _mm256_store_ps(values, lanes);
+    auto best = *std::max_element(values, values + 8);
+    for (; i < count; ++i) {
+        best = std::max(best, scores[i]);
+    }
+    return best;
+}
+#endif
+
+/**
+ * Построитель текстов модели на дополнительном языке.
+ * Текст узла, которого нет в модели, пропускается.
+ */
+class LanguageBuilder final:
+    public ITextsBuilder
+{
+public:
+    /**
+     * Конструктор.
+     *
+     * \param model Модель, к диагнозам и вопросам которой относятся тексты
+     * \param language Заполняемые тексты
+     */
+    LanguageBuilder(
+        const BayesModel& model,
+        BayesModel::Language& language):
+        m_model(model),
+        m_language(language)
+    {
+        m_language.texts.resize(model.DiagnosesCount() + model.Questions().size());
+    }
+
+    void Reserve(
+        const std::size_t texts) noexcept override
+    {
+        (void)texts;
+    }
+
+    void AddText(
+        NodeConfig&& text) noexcept override
+    {
+        auto index = m_model.FindDiagnosis(text.id);
+        if (index == kInvalidIndex) {
+            index = m_model.FindQuestion(text.id);
+            if (index == kInvalidIndex) {
+                logger->Log(LogLevel::Warning, u8"Узел с идентификатором "
+                    + std::to_string(text.id)
+                    + u8" не найден");
+                return;
+            }
+            index += static_cast<node_index_t>(m_model.DiagnosesCount());
+        }
+        m_language.texts[index].assign(text.data);
+    }
+private:
+    // Модель
+    const BayesModel& m_model;
+    // Заполняемые тексты
+    BayesModel::Language& m_language;
+};
+
+}
+
+/**
+ * Конструктор. Загружает модель из раздела <bayes> конфигурации.
+ * Повторяющиеся идентификаторы и вероятности, заданные
+ * с ошибками, пропускаются. Для пары вопроса и диагноза,
+ * вероятности которой не заданы, все ответы равновероятны.
+ *
+ * \param configPath Путь к конфигурации
+ */
+BayesModel::BayesModel(
+    const std::string& configPath) noexcept(false)
+{
+    pugi::xml_document doc;
+    const auto result = doc.load_file(configPath.c_str());
+    if (!result) {
+        throw std::runtime_error(result.description());
+    }
+    const auto elEs = doc.child("es");
+    if (!elEs) {
+        throw std::runtime_error(
+            u8"В конфигурационном файле не найден элемент <es>");
+    }
+    const auto elName = elEs.child("name");
+    if (!elName) {
+        throw std::runtime_error(
+            u8"В конфигурационном файле не найден элемент <name>");
+    }
+    m_name = elName.text().as_string();
+
+    // Дополнительные языки, как у дерева. Тексты загружаются,
+    // только когда язык понадобится сеансу
+    const auto configDirectory = std::filesystem::path(configPath).parent_path();
+    for (auto language = elEs.child("languages").child("language"); language;
+        language = language.next_sibling("language")) {
+        const auto code = language.attribute("code");
+        const auto path = language.attribute("path");
+        if (!code || !path) {
+            logger->Log(LogLevel::Warning,
+                u8"У элемента <language> не найден атрибут code или path");
+            continue;
+        }
+        m_languages[code.as_string()] = std::make_unique<LazyIndex<Language>>(
+            [this, path = (configDirectory / path.as_string()).string()] {
+                return LoadLanguage(path);
+            });
+    }
+    const auto elBayes = elEs.child("bayes");
+    if (!elBayes) {
+        throw std::runtime_error(
+            u8"В конфигурационном файле не найден элемент <bayes>");
+    }
+    m_threshold = AttributeValue(elBayes.attribute("threshold"), 0);
+
+    // Диагнозы и вопросы. Идентификаторы общие, как у узлов дерева
+    std::unordered_set<node_id_t> seen;
+    std::vector<double> priors;
+    for (auto node = elBayes.child("diagnoses").child("diagnosis"); node;
+        node = node.next_sibling("diagnosis")) {
+        const auto id = node.attribute("id");
+        if (!id) {
+            logger->Log(LogLevel::Warning,
+                u8"У элемента <diagnosis> не найден атрибут id");
+            continue;
+        }
+        if (!seen.insert(id.as_int()).second) {
+            AddIssue(m_issues, ValidationIssue::DuplicateNode, id.as_int());
+            continue;
+        }
+        // Без атрибута prior диагнозы равновероятны
+        auto prior = AttributeValue(node.attribute("prior"), 1);
+        if (prior < 0 || prior > 1) {
+            AddIssue(m_issues, ValidationIssue::InvalidProbability, id.as_int());
+            prior = 1;
+        }
+        else if (prior == 0) {
+            AddIssue(m_issues, ValidationIssue::Unreachable, id.as_int());
+        }
+        m_diagnoses.push_back(id.as_int());
+        m_diagnosisTexts.emplace_back(node.text().as_string());
+        priors.push_back(prior);
+    }
+    std::size_t rows = 0;
+    for (auto node = elBayes.child("questions").child("question"); node;
+        node = node.next_sibling("question")) {
+        const auto id = node.attribute("id");
+        if (!id) {
+            logger->Log(LogLevel::Warning,
+                u8"У элемента <question> не найден атрибут id");
+            continue;
+        }
+        if (!seen.insert(id.as_int()).second) {
+            AddIssue(m_issues, ValidationIssue::DuplicateNode, id.as_int());
+            continue;
+        }
+        Question question;
+        question.id = id.as_int();
+        question.text = node.text().as_string();
+        question.row = rows;
+        question.answers = std::max(1, static_cast<int>(AttributeValue(node.attribute("answers"), 2)));
+        rows += static_cast<std::size_t>(question.answers);
+        m_questions.push_back(std::move(question));
+    }
+    seen = {};
+
+    // Индекс идентификаторов: сначала диагнозы, затем вопросы
+    m_ids = m_diagnoses;
+    std::vector<NodeIdIndex::entry_t> entries;
+    entries.reserve(m_diagnoses.size() + m_questions.size());
+    for (const auto& question : m_questions) {
+        m_ids.push_back(question.id);
+    }
+    for (std::size_t index = 0; index < m_ids.size(); ++index) {
+        entries.emplace_back(m_ids[index], static_cast<node_index_t>(index));
+    }
+    std::vector<node_index_t> duplicates;
+    m_index = std::make_unique<NodeIdIndex>(entries,
+        std::pmr::get_default_resource(), duplicates);
+
+    // Матрица: пока вероятности не заданы, ответы равновероятны.
+    // Лишние элементы строк не влияют на оценки
+    m_stride = (m_diagnoses.size() + kLanes - 1) / kLanes * kLanes;
+    m_priors.assign(m_stride, kImpossible);
+    for (std::size_t index = 0; index < priors.size(); ++index) {
+        m_priors[index] = LogProbability(priors[index]);
+    }
+    m_likelihoods.assign(rows * m_stride, 0.0f);
+    for (const auto& question : m_questions) {
+        const auto uniform = LogProbability(1.0 / question.answers);
+        for (int answer = 0; answer < question.answers; ++answer) {
+            std::fill_n(m_likelihoods.begin() + (question.row + answer) * m_stride,
+                m_diagnoses.size(), uniform);
+        }
+    }
+
+    // Вероятности ответов: <likelihood question="id" diagnosis="id">p0 p1 ...</likelihood>
+    std::vector<std::size_t> specified(m_questions.size(), 0);
+    std::vector<double> probabilities;
+    for (auto node = elBayes.child("likelihoods").child("likelihood"); node;
+        node = node.next_sibling("likelihood")) {
+        const auto questionID = node.attribute("question").as_int();
+        const auto diagnosisID = node.attribute("diagnosis").as_int();
+        const auto question = FindQuestion(questionID);
+        if (question == kInvalidIndex) {
+            AddIssue(m_issues, ValidationIssue::MissingNode, questionID);
+            continue;
+        }
+        const auto diagnosis = FindDiagnosis(diagnosisID);
+        if (diagnosis == kInvalidIndex) {
+            AddIssue(m_issues, ValidationIssue::MissingNode, diagnosisID);
+            continue;
+        }
+        ++m_issues.connections;
+        probabilities.clear();
+        const char* text = node.text().as_string();
+        for (char* end = nullptr; ; text = end) {
+            const auto probability = std::strtod(text, &end);
+            if (end == text) {
+                break;
+            }
+            probabilities.push_back(probability);
+        }
+        const auto& config = m_questions[question];
+        double sum = 0;
+        bool valid = probabilities.size() == static_cast<std::size_t>(config.answers);
+        for (const auto probability : probabilities) {
+            valid = valid && probability >= 0 && probability <= 1;
+            sum += probability;
+        }
+        if (!valid || std::abs(sum - 1) > kProbabilityTolerance) {
+            AddIssue(m_issues, ValidationIssue::InvalidProbability, questionID);
+            continue;
+        }
+        ++specified[question];
+        for (int answer = 0; answer < config.answers; ++answer) {
+            m_likelihoods[(config.row + answer) * m_stride + diagnosis] =
+                LogProbability(probabilities[answer]);
+        }
+    }
+    // Вопрос без заданных вероятностей ничего не меняет в оценках
+    for (std::size_t question = 0; question < m_questions.size(); ++question) {
+        if (!specified[question]) {
+            AddIssue(m_issues, ValidationIssue::DeadEnd, m_questions[question].id);
+        }
+    }
+    m_issues.nodes = m_ids.size();
+
+    // Невозможные при каждом ответе диагнозы - для отмены ответа
+    m_impossibleOffsets.reserve(rows + 1);
+    m_impossibleOffsets.push_back(0);
+    for (std::size_t row = 0; row < rows; ++row) {
+        const auto likelihoods = Row(row);
+        for (std::size_t diagnosis = 0; diagnosis < m_diagnoses.size(); ++diagnosis) {
+            if (likelihoods[diagnosis] == kImpossible) {
+                m_impossible.push_back(static_cast<node_index_t>(diagnosis));
+            }
+        }
+        m_impossibleOffsets.push_back(m_impossible.size());
+    }
+    m_impossible.shrink_to_fit();
+
+    m_search = std::make_unique<SearchIndex>(m_ids.size(),
+        [this](const node_index_t index, std::string_view& text) {
+            text = index < m_diagnoses.size() ? m_diagnosisTexts[index]
+                : m_questions[index - m_diagnoses.size()].text;
+            return true;
+        });
+}
+
+/**
+ * Сложение оценок со строкой матрицы.
+ * Строки дополнены до kLanes элементов, поэтому при длине,
+ * равной Stride(), хвост не обрабатывается.
+ *
+ * \param scores Оценки диагнозов
+ * \param row Строка матрицы
+ * \param count Количество элементов
+ * \return
+ */
+void BayesModel::AddRow(
+    float* scores,
+    const float* row,
+    const std::size_t count) noexcept
+{
+#if defined(ES_BAYES_AVX)
+    if (avxSupported) {
+        AddRowAvx(scores, row, count);
+        return;
+    }
+#endif
+    std::size_t i = 0;
+#if defined(__SSE2__) || defined(_M_X64)
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_ps(scores + i, _mm_add_ps(_mm_loadu_ps(scores + i), _mm_loadu_ps(row + i)));
+    }
+#endif
+    for (; i < count; ++i) {
+        scores[i] += row[i];
+    }
+}
+
+/**
+ * Вычитание строки матрицы из оценок.
+ *
+ * \param scores Оценки диагнозов
+ * \param row Строка матрицы
+ * \param count Количество элементов
+ * \return
+ */
+void BayesModel::SubtractRow(
+    float* scores,
+    const float* row,
+    const std::size_t count) noexcept
+{
+#if defined(ES_BAYES_AVX)
+    if (avxSupported) {
+        SubtractRowAvx(scores, row, count);
+        return;
+    }
+#endif
+    std::size_t i = 0;
+#if defined(__SSE2__) || defined(_M_X64)
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_ps(scores + i, _mm_sub_ps(_mm_loadu_ps(scores + i), _mm_loadu_ps(row + i)));
+    }
+#endif
+    for (; i < count; ++i) {
+        scores[i] -= row[i];
+    }
+}
+
+/**
+ * Получение наибольшей оценки.
+ *
+ * \param scores Оценки диагнозов
+ * \param count Количество элементов
+ * \return Наибольшая оценка
+ */
+float BayesModel::MaxScore(
+    const float* scores,
+    const std::size_t count) noexcept
+{
+#if defined(ES_BAYES_AVX)
+    if (avxSupported) {
+        return MaxScoreAvx(scores, count);
+    }
+#endif
+    std::size_t i = 0;
+    float best = kImpossible;
+#if defined(__SSE2__) || defined(_M_X64)
+    auto lanes = _mm_set1_ps(kImpossible);
+    for (; i + 4 <= count; i += 4) {
+        lanes = _mm_max_ps(lanes, _mm_loadu_ps(scores + i));
+    }
+    alignas(16) float values[4];
+    _mm_store_ps(values, lanes);
+    best = *std::max_element(values, values + 4);
+#endif
+    for (; i < count; ++i) {
+        best = std::max(best, scores[i]);
+    }
+    return best;
+}
+
+/**
+ * Получение набора команд, которым складываются строки.
+ *
+ * \return AVX, SSE2, либо пустая строка
+ */
+std::string_view BayesModel::Instructions() noexcept
+{
+#if defined(ES_BAYES_AVX)
+    if (avxSupported) {
+        return "AVX";
+    }
+#endif
+#if defined(__SSE2__) || defined(_M_X64)
+    return "SSE2";
+#else
+    return {};
+#endif
+}
+
+/**
+ * Поиск диагноза по идентификатору.
+ *
+ * \param id Идентификатор
+ * \return Номер диагноза, либо kInvalidIndex
+ */
+node_index_t BayesModel::FindDiagnosis(
+    const node_id_t id) const noexcept
+{
+    const auto index = m_index->Find(id);
+    return index < m_diagnoses.size() && m_ids[index] == id ? index : kInvalidIndex;
+}
+
+/**
+ * Поиск вопроса по идентификатору.
+ *
+ * \param id Идентификатор
+ * \return Номер вопроса, либо kInvalidIndex
+ */
+node_index_t BayesModel::FindQuestion(
+    const node_id_t id) const noexcept
+{
+    const auto index = m_index->Find(id);
+    return index != kInvalidIndex && index >= m_diagnoses.size()
+        && index < m_ids.size() && m_ids[index] == id
+        ? static_cast<node_index_t>(index - m_diagnoses.size())
+        : kInvalidIndex;
+}
+
+/**
+ * Поиск диагнозов и вопросов по тексту на основном языке.
+ *
+ * \param query Запрос
+ * \param limit Наибольшее количество результатов
+ * \return Найденные узлы по убыванию релевантности
+ */
+std::vector<SearchHit> BayesModel::Search(
+    const std::string_view query,
+    const std::size_t limit) const
+{
+    std::vector<SearchHit> hits;
+    for (const auto& hit : m_search->Search(query, limit)) {
+        hits.push_back({ m_ids[hit.node], hit.score });
+    }
+    return hits;
+}
+
+/**
+ * Получение кодов дополнительных языков.
+ *
+ * \return Коды языков в алфавитном порядке
+ */
+std::vector<std::string> BayesModel::Languages() const
+{
+    std::vector<std::string> codes;
+    codes.reserve(m_languages.size());
+    for (const auto& [code, _] : m_languages) {
+        codes.push_back(code);
+    }
+    return codes;
+}
+
+/**
+ * Получение текстов на дополнительном языке.
+ *
+ * \param code Код языка
+ * \return Тексты на заданном языке
+ */
+const BayesModel::Language& BayesModel::GetLanguage(
+    const std::string& code) const noexcept(false)
+{
+    const auto it = m_languages.find(code);
+    if (it == m_languages.end()) {
+        throw std::runtime_error(u8"Язык " + code + u8" не найден в конфигурации");
+    }
+    return it->second->Get();
+}
+
+/**
+ * Загрузка текстов на дополнительном языке.
+ * Файл языка имеет тот же вид, что и для дерева.
+ *
+ * \param path Путь к файлу языка
+ * \return Тексты на этом языке
+ */
+std::shared_ptr<const BayesModel::Language> BayesModel::LoadLanguage(
+    const std::string& path) const noexcept(false)
+{
+    auto language = std::make_shared<Language>();
+    auto loader = CreateExpertSystemLoader();
+    LanguageBuilder builder(*this, *language);
+    loader->LoadTexts(path, builder);
+    language->name = loader->GetName();
+    return language;
+}
+
+/**
+ * Получение памяти, занятой моделью, по категориям.
+ *
+ * \return Память по категориям
+ */
+MemoryReport BayesModel::Memory() const noexcept
+{
+    MemoryReport report;
+    report.structure = (m_diagnoses.capacity() + m_ids.capacity()) * sizeof(node_id_t)
+        + m_questions.capacity() * sizeof(Question)
+        + m_diagnosisTexts.capacity() * sizeof(std::string);
+    report.edges = (m_priors.capacity() + m_likelihoods.capacity()) * sizeof(float);
+    for (const auto& text : m_diagnosisTexts) {
+        report.texts += text.size();
+    }
+    for (const auto& question : m_questions) {
+        report.texts += question.text.size();
+    }
+    report.indices = m_index->MemoryBytes() + m_search->MemoryBytes()
+        + m_impossible.capacity() * sizeof(node_index_t)
+        + m_impossibleOffsets.capacity() * sizeof(std::size_t);
+    report.total = report.structure + report.edges + report.texts + report.indices;
+    return report;
+}
+
+}
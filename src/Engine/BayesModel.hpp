@@ -0,0 +1,338 @@
+﻿#pragma once
+
+#include "IExpertSystem.hpp"
+
+#include "LazyIndex.hpp"
+#include "NodeIdIndex.hpp"
+#include "SearchIndex.hpp"
+#include "Types.hpp"
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace ES
+{
+
+/**
+ * Модель вероятностной экспертной системы (наивный Байес).
+ * Оценка диагноза - логарифм его апостериорной вероятности
+ * без нормировки: логарифм априорной вероятности плюс логарифмы
+ * вероятностей поданных ответов при этом диагнозе. Логарифмы
+ * вероятностей каждого ответа на каждый вопрос хранятся строкой
+ * непрерывной матрицы по всем диагнозам, поэтому ответ обновляет
+ * оценки всех диагнозов одним сложением строк, а отмена ответа -
+ * вычитанием той же строки. Строки складываются командами AVX,
+ * если их поддерживает процессор, иначе SSE2.
+ * Модель неизменяема и разделяется всеми сеансами, тексты
+ * дополнительных языков загружаются при первом обращении.
+ */
+class BayesModel final
+{
+public:
+    // Вопрос модели
+    struct Question
+    {
+        // Идентификатор вопроса
+        node_id_t id = -1;
+        // Текст вопроса
+        std::string text;
+        // Строка матрицы для ответа 0. Ответу k соответствует строка row + k
+        std::size_t row = 0;
+        // Количество вариантов ответа: от 0 до answers - 1
+        int answers = 0;
+    };
+
+    // Тексты модели на дополнительном языке
+    struct Language
+    {
+        // Название модели на этом языке
+        std::string name;
+        // Тексты диагнозов и затем вопросов по порядку.
+        // Пустой текст - перевода нет
+        std::vector<std::string> texts;
+    };
+
+    /**
+     * Конструктор. Загружает модель из раздела <bayes> конфигурации.
+     * Ошибки в конфигурации, не мешающие работе, собираются
+     * в отчёт о проверке.
+     *
+     * \param configPath Путь к конфигурации
+     */
+    explicit BayesModel(
+        const std::string& configPath) noexcept(false);
+
+    /**
+     * Сложение оценок со строкой матрицы.
+     *
+     * \param scores Оценки диагнозов
+     * \param row Строка матрицы
+     * \param count Количество элементов
+     * \return
+     */
+    static void AddRow(
+        float* scores,
+        const float* row,
+        const std::size_t count) noexcept;
+
+    /**
+     * Вычитание строки матрицы из оценок.
+     * Невозможные при ответе диагнозы получают NaN, их оценки
+     * восстанавливаются отдельно.
+     *
+     * \param scores Оценки диагнозов
+     * \param row Строка матрицы
+     * \param count Количество элементов
+     * \return
+     */
+    static void SubtractRow(
+        float* scores,
+        const float* row,
+        const std::size_t count) noexcept;
+
+    /**
+     * Получение набора команд, которым складываются строки.
+     *
+     * \return AVX, SSE2, либо пустая строка
+     */
+    static std::string_view Instructions() noexcept;
+
+    /**
+     * Получение наибольшей оценки.
+     *
+     * \param scores Оценки диагнозов
+     * \param count Количество элементов
+     * \return Наибольшая оценка, либо -inf, если все диагнозы невозможны
+     */
+    static float MaxScore(
+        const float* scores,
+        const std::size_t count) noexcept;
+
+    /**
+     * Получение названия модели.
+     *
+     * \return Название
+     */
+    const std::string& Name() const noexcept
+    {
+        return m_name;
+    }
+
+    /**
+     * Получение количества диагнозов.
+     *
+     * \return Количество диагнозов
+     */
+    std::size_t DiagnosesCount() const noexcept
+    {
+        return m_diagnoses.size();
+    }
+
+    /**
+     * Получение длины строки матрицы: количество диагнозов,
+     * дополненное до границы SIMD-регистров.
+     *
+     * \return Количество элементов строки
+     */
+    std::size_t Stride() const noexcept
+    {
+        return m_stride;
+    }
+
+    /**
+     * Получение идентификатора диагноза.
+     *
+     * \param index Номер диагноза
+     * \return Идентификатор
+     */
+    node_id_t DiagnosisID(
+        const std::size_t index) const noexcept
+    {
+        return m_diagnoses[index];
+    }
+
+    /**
+     * Получение текста диагноза.
+     *
+     * \param index Номер диагноза
+     * \return Текст
+     */
+    const std::string& DiagnosisText(
+        const std::size_t index) const noexcept
+    {
+        return m_diagnosisTexts[index];
+    }
+
+    /**
+     * Получение вопросов в порядке конфигурации.
+     *
+     * \return Вопросы
+     */
+    const std::vector<Question>& Questions() const noexcept
+    {
+        return m_questions;
+    }
+
+    /**
+     * Поиск диагноза по идентификатору.
+     *
+     * \param id Идентификатор
+     * \return Номер диагноза, либо kInvalidIndex
+     */
+    node_index_t FindDiagnosis(
+        const node_id_t id) const noexcept;
+
+    /**
+     * Поиск вопроса по идентификатору.
+     *
+     * \param id Идентификатор
+     * \return Номер вопроса, либо kInvalidIndex
+     */
+    node_index_t FindQuestion(
+        const node_id_t id) const noexcept;
+
+    /**
+     * Получение логарифмов априорных вероятностей.
+     *
+     * \return Stride() оценок, лишние равны -inf
+     */
+    const float* Priors() const noexcept
+    {
+        return m_priors.data();
+    }
+
+    /**
+     * Получение строки матрицы.
+     *
+     * \param row Номер строки
+     * \return Stride() логарифмов вероятностей
+     */
+    const float* Row(
+        const std::size_t row) const noexcept
+    {
+        return m_likelihoods.data() + row * m_stride;
+    }
+
+    /**
+     * Получение диагнозов, невозможных при ответе строки матрицы:
+     * их логарифм вероятности равен -inf.
+     *
+     * \param row Номер строки
+     * \return Номер первого диагноза и номер за последним
+     */
+    std::pair<const node_index_t*, const node_index_t*> Impossible(
+        const std::size_t row) const noexcept
+    {
+        return { m_impossible.data() + m_impossibleOffsets[row],
+            m_impossible.data() + m_impossibleOffsets[row + 1] };
+    }
+
+    /**
+     * Поиск диагнозов и вопросов по тексту на основном языке.
+     *
+     * \param query Запрос
+     * \param limit Наибольшее количество результатов
+     * \return Найденные узлы по убыванию релевантности
+     */
+    std::vector<SearchHit> Search(
+        const std::string_view query,
+        const std::size_t limit) const;
+
+    /**
+     * Получение кодов дополнительных языков.
+     *
+     * \return Коды языков в алфавитном порядке
+     */
+    std::vector<std::string> Languages() const;
+
+    /**
+     * Получение текстов на дополнительном языке.
+     * Если тексты ещё не загружены, то они загружаются
+     * вызывающим потоком, остальные потоки ждут окончания загрузки.
+     *
+     * \param code Код языка
+     * \return Тексты на заданном языке
+     */
+    const Language& GetLanguage(
+        const std::string& code) const noexcept(false);
+
+    /**
+     * Получение вероятности лучшего диагноза, после которой
+     * работа завершается, не дожидаясь ответов на все вопросы.
+     *
+     * \return Порог, либо 0, если он не задан
+     */
+    double Threshold() const noexcept
+    {
+        return m_threshold;
+    }
+
+    /**
+     * Получение ошибок конфигурации, найденных при загрузке.
+     *
+     * \return Отчёт о проверке
+     */
+    const ValidationReport& Issues() const noexcept
+    {
+        return m_issues;
+    }
+
+    /**
+     * Получение памяти, занятой моделью, по категориям.
+     * Матрица и априорные вероятности учитываются как соединения.
+     *
+     * \return Память по категориям
+     */
+    MemoryReport Memory() const noexcept;
+private:
+    /**
+     * Загрузка текстов на дополнительном языке.
+     *
+     * \param path Путь к файлу языка
+     * \return Тексты на этом языке
+     */
+    std::shared_ptr<const Language> LoadLanguage(
+        const std::string& path) const noexcept(false);
+
+    // Количество оценок в SIMD-регистре наибольшей ширины,
+    // до которого дополняются строки матрицы
+    static constexpr std::size_t kLanes = 16;
+
+    // Название модели
+    std::string m_name;
+    // Идентификаторы диагнозов
+    std::vector<node_id_t> m_diagnoses;
+    // Тексты диагнозов
+    std::vector<std::string> m_diagnosisTexts;
+    // Вопросы
+    std::vector<Question> m_questions;
+    // Идентификаторы диагнозов и затем вопросов по порядку
+    std::vector<node_id_t> m_ids;
+    // Индекс идентификаторов: номер в m_ids
+    std::unique_ptr<NodeIdIndex> m_index;
+    // Длина строки матрицы
+    std::size_t m_stride = 0;
+    // Логарифмы априорных вероятностей диагнозов
+    std::vector<float> m_priors;
+    // Логарифмы вероятностей ответов: строка на каждый ответ каждого вопроса
+    std::vector<float> m_likelihoods;
+    // Невозможные диагнозы каждой строки матрицы подряд
+    std::vector<node_index_t> m_impossible;
+    // Начало невозможных диагнозов каждой строки и конец последней
+    std::vector<std::size_t> m_impossibleOffsets;
+    // Полнотекстовый индекс: узел - номер в m_ids
+    std::unique_ptr<SearchIndex> m_search;
+    // Дополнительные языки по кодам
+    std::map<std::string, std::unique_ptr<LazyIndex<Language>>> m_languages;
+    // Порог вероятности лучшего диагноза
+    double m_threshold = 0;
+    // Ошибки конфигурации
+    ValidationReport m_issues;
+};
+
+}
@@ -0,0 +1,207 @@
+﻿#include "BulkLoader.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <numeric>
+#include <stdexcept>
+#include <thread>
+
+#if defined(__linux__)
+#   include <fcntl.h>
+#   include <unistd.h>
+#endif
+
+namespace ES
+{
+
+/**
+ * Проверка, что файл - это тексты на другом языке, а не база знаний.
+ * Смотрится только начало файла.
+ *
+ * \param path Путь к файлу
+ * \return true - если файл содержит тексты без дерева
+ */
+static bool IsLanguageFile(
+    const std::filesystem::path& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    std::string head(4096, '\0');
+    file.read(head.data(), static_cast<std::streamsize>(head.size()));
+    head.resize(static_cast<std::size_t>(file.gcount()));
+    return head.find("<texts>") != std::string::npos
+        && head.find("<tree>") == std::string::npos;
+}
+
+/**
+ * Получение списка баз знаний из каталога или файла-манифеста.
+ *
+ * \param path Путь к каталогу или манифесту
+ * \return Базы знаний
+ */
+std::vector<KnowledgeBaseEntry> ListKnowledgeBases(
+    const std::string& path) noexcept(false)
+{
+    std::vector<KnowledgeBaseEntry> entries;
+    if (std::filesystem::is_directory(path)) {
+        for (const auto& file : std::filesystem::directory_iterator(path)) {
+            if (file.is_regular_file() && file.path().extension() == ".xml"
+                && !IsLanguageFile(file.path())) {
+                entries.push_back({ file.path().string(), true });
+            }
+        }
+        std::sort(entries.begin(), entries.end(),
+            [](const KnowledgeBaseEntry& a, const KnowledgeBaseEntry& b) { return a.path < b.path; });
+        return entries;
+    }
+    std::ifstream manifest(path);
+    if (!manifest) {
+        throw std::runtime_error(u8"Не удалось открыть манифест " + path);
+    }
+    const auto directory = std::filesystem::path(path).parent_path();
+    std::string line;
+    while (std::getline(manifest, line)) {
+        // Обрезаем пробелы по краям строки
+        const auto first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#') {
+            continue;
+        }
+        line = line.substr(first, line.find_last_not_of(" \t\r") - first + 1);
+        KnowledgeBaseEntry entry;
+        if (line[0] == '?') {
+            entry.required = false;
+            line.erase(0, line.find_first_not_of(" \t", 1));
+        }
+        entry.path = (directory / line).string();
+        entries.push_back(std::move(entry));
+    }
+    return entries;
+}
+
+/**
+ * Просьба к системе заранее прочитать файл в кэш страниц.
+ * Чтение идёт в фоне, вызов не ждёт диска.
+ *
+ * \param path Путь к файлу
+ * \return
+ */
+static void Readahead(
+    const std::string& path)
+{
+#if defined(__linux__)
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        ::posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+        ::close(fd);
+    }
+#else
+    (void)path;
+#endif
+}
+
+/**
+ * Параллельная загрузка баз знаний.
+ *
+ * \param entries Базы знаний
+ * \param options Параметры загрузки
+ * \return Результат загрузки
+ */
+BulkLoadReport LoadKnowledgeBases(
+    const std::vector<KnowledgeBaseEntry>& entries,
+    const BulkLoadOptions& options)
+{
+    using clock = std::chrono::steady_clock;
+    const auto start = clock::now();
+    const auto elapsed = [start] {
+        return std::chrono::duration<double, std::milli>(clock::now() - start).count();
+    };
+
+    BulkLoadReport report;
+    report.bases.resize(entries.size());
+    std::size_t required = 0;
+    for (std::size_t i = 0; i < entries.size(); ++i) {
+        auto& base = report.bases[i];
+        base.path = entries[i].path;
+        base.required = entries[i].required;
+        std::error_code error;
+        const auto size = std::filesystem::file_size(base.path, error);
+        base.bytes = error ? 0 : size;
+        required += base.required ? 1 : 0;
+    }
+    // Большие файлы загружаем первыми: иначе самый большой файл,
+    // доставшийся последним, добавит своё время к концу пакета
+    std::vector<std::size_t> order(entries.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&report](const std::size_t a, const std::size_t b) {
+        return report.bases[a].bytes > report.bases[b].bytes;
+    });
+
+    const auto threads = std::max<std::size_t>(1, std::min(entries.size(),
+        options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency())));
+    // Файлы читаются заранее на столько баз вперёд, сколько загружается одновременно
+    const auto window = options.readahead ? threads : 0;
+    for (std::size_t k = 0; k < std::min(order.size(), 2 * window); ++k) {
+        Readahead(report.bases[order[k]].path);
+    }
+
+    std::mutex lock;
+    std::size_t requiredLeft = required;
+    const auto markReady = [&] {
+        report.ready = true;
+        report.readyMs = elapsed();
+        if (options.onReady) {
+            options.onReady();
+        }
+    };
+    if (!requiredLeft) {
+        markReady();
+    }
+
+    std::atomic<std::size_t> next{ 0 };
+    const auto work = [&] {
+        for (auto k = next++; k < order.size(); k = next++) {
+            if (window && k + 2 * window < order.size()) {
+                Readahead(report.bases[order[k + 2 * window]].path);
+            }
+            auto& base = report.bases[order[k]];
+            base.startMs = elapsed();
+            try {
+                auto system = CreateExpertSystem();
+                system->SetTextCompression(options.textCompression);
+                system->SetMemoryBudget(options.memoryBudget);
+                system->SetValidation(options.validation);
+                system->Load(base.path);
+                base.system = std::move(system);
+            }
+            catch (const std::exception& e) {
+                base.error = e.what();
+            }
+            base.loadMs = elapsed() - base.startMs;
+
+            std::lock_guard<std::mutex> guard(lock);
+            ++(base.system ? report.loaded : report.failed);
+            report.sequentialMs += base.loadMs;
+            if (options.onLoaded) {
+                options.onLoaded(base);
+            }
+            if (base.system && base.required && --requiredLeft == 0) {
+                markReady();
+            }
+        }
+    };
+    std::vector<std::thread> workers;
+    for (std::size_t worker = 1; worker < threads; ++worker) {
+        workers.emplace_back(work);
+    }
+    work();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    report.totalMs = elapsed();
+    return report;
+}
+
+}
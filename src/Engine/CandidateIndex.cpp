@@ -0,0 +1,716 @@
+﻿#include "CandidateIndex.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+#include <utility>
+
+#if defined(_MSC_VER)
+#   include <intrin.h>
+#endif
+
+namespace ES
+{
+
+namespace
+{
+
+/**
+ * Количество единичных битов в слове.
+ *
+ * \param word Слово
+ * \return Количество единичных битов
+ */
+inline std::uint32_t CountBits(
+    const std::uint64_t word) noexcept
+{
+#if defined(_MSC_VER)
+    return static_cast<std::uint32_t>(__popcnt64(word));
+#else
+    return static_cast<std::uint32_t>(__builtin_popcountll(word));
+#endif
+}
+
+/**
+ * Номер младшего единичного бита.
+ *
+ * \param word Слово, не равное нулю
+ * \return Номер бита
+ */
+inline std::uint32_t LowestBit(
+    const std::uint64_t word) noexcept
+{
+#if defined(_MSC_VER)
+    unsigned long result;
+    _BitScanForward64(&result, word);
+    return result;
+#else
+    return static_cast<std::uint32_t>(__builtin_ctzll(word));
+#endif
+}
+
+/**
+ * Установка интервала битов.
+ *
+ * \param words Битовая карта
+ * \param start Первый бит
+ * \param end Бит, следующий за последним
+ * \return
+ */
+void SetRange(
+    std::uint64_t* words,
+    const std::uint32_t start,
+    const std::uint32_t end) noexcept
+{
+    if (start >= end) {
+        return;
+    }
+    const auto first = start / 64;
+    const auto last = (end - 1) / 64;
+    const auto firstMask = ~std::uint64_t(0) << (start % 64);
+    const auto lastMask = ~std::uint64_t(0) >> (63 - (end - 1) % 64);
+    if (first == last) {
+        words[first] |= firstMask & lastMask;
+        return;
+    }
+    words[first] |= firstMask;
+    for (auto i = first + 1; i < last; ++i) {
+        words[i] = ~std::uint64_t(0);
+    }
+    words[last] |= lastMask;
+}
+
+// Интервал номеров [start, end)
+using interval_t = std::pair<std::uint32_t, std::uint32_t>;
+
+}
+
+/**
+ * Конструктор. Вычисляет множества для всех узлов дерева.
+ * Узлы обходятся в глубину, и множество вопроса вычисляется
+ * после множеств всех его дочерних узлов. Если в дереве есть
+ * циклы, то проходы повторяются, пока множества растут.
+ *
+ * \param tree Дерево
+ */
+CandidateIndex::CandidateIndex(
+    const Tree& tree)
+{
+    const auto count = static_cast<node_index_t>(tree.NodesCount());
+    m_sets.resize(count);
+    // Нумеруем ответы, множество ответа - он сам
+    for (node_index_t index = 0; index < count; ++index) {
+        const auto node = tree.GetNode(index);
+        if (!node || node->Type() != NodeType::Answer) {
+            continue;
+        }
+        const auto ordinal = static_cast<std::uint32_t>(m_answers.size());
+        m_answers.push_back(index);
+        Container container;
+        container.key = static_cast<std::uint16_t>(ordinal >> 16);
+        container.cardinality = 1;
+        container.offset = static_cast<std::uint32_t>(m_values.size());
+        container.size = 1;
+        m_sets[index] = { static_cast<std::uint32_t>(m_containers.size()), 1, 1 };
+        m_containers.push_back(container);
+        m_values.push_back(static_cast<std::uint16_t>(ordinal));
+    }
+
+    // Порядок обхода в глубину: дочерние узлы раньше родителей
+    enum : std::uint8_t { Unvisited, Visiting, Visited };
+    std::vector<std::uint8_t> state(count, Unvisited);
+    std::vector<node_index_t> order;
+    order.reserve(count);
+    // Узел и номер следующего дочернего узла
+    std::vector<std::pair<node_index_t, std::size_t>> stack;
+    bool cyclic = false;
+    for (node_index_t start = 0; start < count; ++start) {
+        if (state[start] != Unvisited || !tree.GetNode(start)) {
+            continue;
+        }
+        state[start] = Visiting;
+        stack.emplace_back(start, 0);
+        while (!stack.empty()) {
+            const auto index = stack.back().first;
+            const auto node = tree.GetNode(index);
+            if (node->Type() == NodeType::Question) {
+                const auto& childrens = static_cast<const Question*>(node)->GetChildrens();
+                const auto child = stack.back().second++;
+                if (child < childrens.size()) {
+                    const auto next = childrens[child].first;
+                    if (next < count && tree.GetNode(next)) {
+                        if (state[next] == Unvisited) {
+                            state[next] = Visiting;
+                            stack.emplace_back(next, 0);
+                        }
+                        else if (state[next] == Visiting) {
+                            cyclic = true;
+                        }
+                    }
+                    continue;
+                }
+            }
+            state[index] = Visited;
+            order.push_back(index);
+            stack.pop_back();
+        }
+    }
+
+    for (const auto index : order) {
+        const auto node = tree.GetNode(index);
+        if (node->Type() == NodeType::Question) {
+            m_sets[index] = Union(*static_cast<const Question*>(node));
+        }
+    }
+    if (!cyclic) {
+        return;
+    }
+    // Узлы цикла при первом проходе видели неполные множества друг друга.
+    // Множества только растут, поэтому проходы повторяются,
+    // пока не изменится ни одно из них
+    for (bool changed = true; changed; ) {
+        changed = false;
+        for (const auto index : order) {
+            const auto node = tree.GetNode(index);
+            if (node->Type() == NodeType::Question) {
+                const auto set = Union(*static_cast<const Question*>(node));
+                changed |= set.cardinality != m_sets[index].cardinality;
+                m_sets[index] = set;
+            }
+        }
+    }
+    Compact();
+}
+
+/**
+ * Вычисление множества вопроса объединением множеств дочерних узлов.
+ * Контейнеры, номера которых есть только у одного дочернего узла,
+ * разделяются с ним. Массивы и интервалы объединяются слиянием
+ * интервалов, битовые карты - побитовым ИЛИ.
+ *
+ * \param question Вопрос
+ * \return Множество вопроса
+ */
+CandidateIndex::Set CandidateIndex::Union(
+    const Question& question)
+{
+    std::vector<Set> sets;
+    for (const auto& [child, predicat] : question.GetChildrens()) {
+        if (child >= m_sets.size() || !m_sets[child].count) {
+            continue;
+        }
+        const auto& set = m_sets[child];
+        // Одинаковые множества объединять не нужно
+        const bool duplicate = std::any_of(sets.begin(), sets.end(), [&](const Set& other)
+        {
+            return other.first == set.first && other.count == set.count;
+        });
+        if (!duplicate) {
+            sets.push_back(set);
+        }
+    }
+    if (sets.empty()) {
+        return Set();
+    }
+    if (sets.size() == 1) {
+        return sets.front();
+    }
+
+    Set result;
+    result.first = static_cast<std::uint32_t>(m_containers.size());
+    std::vector<std::uint32_t> positions(sets.size(), 0);
+    std::vector<Container> group;
+    std::vector<interval_t> intervals;
+    std::vector<std::uint64_t> words;
+    while (true) {
+        // Следующая группа номеров - наименьший ключ среди дочерних узлов
+        std::uint32_t key = 0x10000;
+        for (std::size_t i = 0; i < sets.size(); ++i) {
+            if (positions[i] < sets[i].count) {
+                key = std::min<std::uint32_t>(key, m_containers[sets[i].first + positions[i]].key);
+            }
+        }
+        if (key > 0xFFFF) {
+            break;
+        }
+        group.clear();
+        bool bitmap = false;
+        for (std::size_t i = 0; i < sets.size(); ++i) {
+            if (positions[i] < sets[i].count
+                && m_containers[sets[i].first + positions[i]].key == key) {
+                group.push_back(m_containers[sets[i].first + positions[i]]);
+                bitmap |= group.back().type == ContainerType::Bitmap;
+                ++positions[i];
+            }
+        }
+        if (group.size() == 1) {
+            // Данные контейнера разделяются с дочерним узлом
+            m_containers.push_back(group.front());
+        }
+        else if (bitmap) {
+            words.assign(kBitmapWords, 0);
+            for (const auto& container : group) {
+                const auto values = m_values.data() + container.offset;
+                switch (container.type) {
+                case ContainerType::Array:
+                    for (std::uint32_t i = 0; i < container.size; ++i) {
+                        words[values[i] / 64] |= std::uint64_t(1) << (values[i] % 64);
+                    }
+                    break;
+                case ContainerType::Runs:
+                    for (std::uint32_t i = 0; i < container.size; ++i) {
+                        SetRange(words.data(), values[2 * i], values[2 * i] + values[2 * i + 1] + 1u);
+                    }
+                    break;
+                case ContainerType::Bitmap:
+                    for (std::size_t i = 0; i < kBitmapWords; ++i) {
+                        words[i] |= m_bitmaps[container.offset + i];
+                    }
+                    break;
+                }
+            }
+            AppendContainer(static_cast<std::uint16_t>(key), words.data());
+        }
+        else {
+            // Массивы и интервалы сливаются как интервалы
+            intervals.clear();
+            for (const auto& container : group) {
+                const auto values = m_values.data() + container.offset;
+                for (std::uint32_t i = 0; i < container.size; ++i) {
+                    if (container.type == ContainerType::Array) {
+                        intervals.emplace_back(values[i], values[i] + 1u);
+                    }
+                    else {
+                        intervals.emplace_back(values[2 * i], values[2 * i] + values[2 * i + 1] + 1u);
+                    }
+                }
+            }
+            std::sort(intervals.begin(), intervals.end());
+            std::size_t merged = 0;
+            std::uint32_t cardinality = 0;
+            for (const auto& interval : intervals) {
+                if (merged && interval.first <= intervals[merged - 1].second) {
+                    intervals[merged - 1].second = std::max(intervals[merged - 1].second, interval.second);
+                }
+                else {
+                    intervals[merged++] = interval;
+                }
+            }
+            intervals.resize(merged);
+            for (const auto& interval : intervals) {
+                cardinality += interval.second - interval.first;
+            }
+            Container container;
+            container.key = static_cast<std::uint16_t>(key);
+            container.cardinality = cardinality;
+            if (merged * 4 <= 8192 && (cardinality > 4096 || merged * 4 <= cardinality * 2)) {
+                container.type = ContainerType::Runs;
+                container.offset = static_cast<std::uint32_t>(m_values.size());
+                container.size = static_cast<std::uint32_t>(merged);
+                for (const auto& interval : intervals) {
+                    m_values.push_back(static_cast<std::uint16_t>(interval.first));
+                    m_values.push_back(static_cast<std::uint16_t>(interval.second - interval.first - 1));
+                }
+                m_containers.push_back(container);
+            }
+            else if (cardinality <= 4096) {
+                container.type = ContainerType::Array;
+                container.offset = static_cast<std::uint32_t>(m_values.size());
+                container.size = cardinality;
+                for (const auto& interval : intervals) {
+                    for (auto value = interval.first; value < interval.second; ++value) {
+                        m_values.push_back(static_cast<std::uint16_t>(value));
+                    }
+                }
+                m_containers.push_back(container);
+            }
+            else {
+                words.assign(kBitmapWords, 0);
+                for (const auto& interval : intervals) {
+                    SetRange(words.data(), interval.first, interval.second);
+                }
+                AppendContainer(static_cast<std::uint16_t>(key), words.data());
+            }
+        }
+        result.cardinality += m_containers.back().cardinality;
+    }
+    result.count = static_cast<std::uint32_t>(m_containers.size()) - result.first;
+    return result;
+}
+
+/**
+ * Добавление контейнера, построенного по битовой карте.
+ *
+ * \param key Старшие 16 бит номеров
+ * \param words Битовая карта
+ * \return
+ */
+void CandidateIndex::AppendContainer(
+    const std::uint16_t key,
+    const std::uint64_t* words)
+{
+    std::uint32_t cardinality = 0;
+    std::uint32_t runs = 0;
+    std::uint64_t previous = 0;
+    for (std::size_t i = 0; i < kBitmapWords; ++i) {
+        cardinality += CountBits(words[i]);
+        // Начало интервала - единичный бит после нулевого
+        runs += CountBits(words[i] & ~((words[i] << 1) | (previous >> 63)));
+        previous = words[i];
+    }
+    Container container;
+    container.key = key;
+    container.cardinality = cardinality;
+    const std::size_t arrayBytes = cardinality <= 4096 ? cardinality * 2 : 8192;
+    const std::size_t runsBytes = std::size_t(runs) * 4;
+    if (runsBytes < arrayBytes && runsBytes < 8192) {
+        container.type = ContainerType::Runs;
+        container.offset = static_cast<std::uint32_t>(m_values.size());
+        container.size = runs;
+        std::uint32_t start = 0;
+        bool inside = false;
+        for (std::uint32_t bit = 0; bit <= 65536; ++bit) {
+            const bool set = bit < 65536 && (words[bit / 64] >> (bit % 64)) & 1;
+            if (set && !inside) {
+                start = bit;
+            }
+            else if (!set && inside) {
+                m_values.push_back(static_cast<std::uint16_t>(start));
+                m_values.push_back(static_cast<std::uint16_t>(bit - start - 1));
+            }
+            inside = set;
+        }
+    }
+    else if (arrayBytes < 8192) {
+        container.type = ContainerType::Array;
+        container.offset = static_cast<std::uint32_t>(m_values.size());
+        container.size = cardinality;
+        for (std::size_t i = 0; i < kBitmapWords; ++i) {
+            for (auto word = words[i]; word; word &= word - 1) {
+                m_values.push_back(static_cast<std::uint16_t>(i * 64 + LowestBit(word)));
+            }
+        }
+    }
+    else {
+        container.type = ContainerType::Bitmap;
+        container.offset = static_cast<std::uint32_t>(m_bitmaps.size());
+        m_bitmaps.insert(m_bitmaps.end(), words, words + kBitmapWords);
+    }
+    m_containers.push_back(container);
+}
+
+/**
+ * Получение битовой карты контейнера.
+ *
+ * \param container Контейнер
+ * \param scratch Буфер на kBitmapWords слов
+ * \return Битовая карта
+ */
+const std::uint64_t* CandidateIndex::AsBitmap(
+    const Container& container,
+    std::uint64_t* scratch) const noexcept
+{
+    if (container.type == ContainerType::Bitmap) {
+        return m_bitmaps.data() + container.offset;
+    }
+    std::memset(scratch, 0, kBitmapWords * sizeof(std::uint64_t));
+    const auto values = m_values.data() + container.offset;
+    for (std::uint32_t i = 0; i < container.size; ++i) {
+        if (container.type == ContainerType::Array) {
+            scratch[values[i] / 64] |= std::uint64_t(1) << (values[i] % 64);
+        }
+        else {
+            SetRange(scratch, values[2 * i], values[2 * i] + values[2 * i + 1] + 1u);
+        }
+    }
+    return scratch;
+}
+
+/**
+ * Поиск номера ответа по индексу узла.
+ * Ответы пронумерованы в порядке индексов, поэтому номер
+ * ищется двоичным поиском.
+ *
+ * \param answer Индекс узла ответа
+ * \param ordinal Номер ответа
+ * \return false, если узел не является ответом
+ */
+bool CandidateIndex::OrdinalOf(
+    const node_index_t answer,
+    std::uint32_t& ordinal) const noexcept
+{
+    const auto it = std::lower_bound(m_answers.begin(), m_answers.end(), answer);
+    if (it == m_answers.end() || *it != answer) {
+        return false;
+    }
+    ordinal = static_cast<std::uint32_t>(it - m_answers.begin());
+    return true;
+}
+
+/**
+ * Проверка достижимости ответа из узла.
+ *
+ * \param node Индекс узла
+ * \param answer Индекс узла ответа
+ * \return true - если ответ достижим
+ */
+bool CandidateIndex::Contains(
+    const node_index_t node,
+    const node_index_t answer) const noexcept
+{
+    std::uint32_t ordinal = 0;
+    if (node >= m_sets.size() || !OrdinalOf(answer, ordinal)) {
+        return false;
+    }
+    const auto& set = m_sets[node];
+    const auto begin = m_containers.begin() + set.first;
+    const auto end = begin + set.count;
+    const auto key = static_cast<std::uint16_t>(ordinal >> 16);
+    const auto low = static_cast<std::uint16_t>(ordinal);
+    const auto it = std::lower_bound(begin, end, key, [](const Container& container, const std::uint16_t value)
+    {
+        return container.key < value;
+    });
+    if (it == end || it->key != key) {
+        return false;
+    }
+    const auto values = m_values.data() + it->offset;
+    switch (it->type) {
+    case ContainerType::Array:
+        return std::binary_search(values, values + it->size, low);
+    case ContainerType::Runs:
+    {
+        // Последний интервал, начинающийся не позже номера
+        std::uint32_t lo = 0;
+        std::uint32_t hi = it->size;
+        while (lo < hi) {
+            const auto mid = (lo + hi) / 2;
+            if (values[2 * mid] <= low) {
+                lo = mid + 1;
+            }
+            else {
+                hi = mid;
+            }
+        }
+        return lo && low <= values[2 * (lo - 1)] + values[2 * (lo - 1) + 1];
+    }
+    case ContainerType::Bitmap:
+        return (m_bitmaps[it->offset + low / 64] >> (low % 64)) & 1;
+    }
+    return false;
+}
+
+/**
+ * Получение количества ответов, достижимых из обоих узлов.
+ * Контейнеры с одинаковыми ключами пересекаются попарно:
+ * интервалы - слиянием, массивы - проверкой каждого номера,
+ * остальные - побитовым И битовых карт по 64 бита за операцию.
+ *
+ * \param first Индекс первого узла
+ * \param second Индекс второго узла
+ * \return Размер пересечения
+ */
+std::size_t CandidateIndex::IntersectionCount(
+    const node_index_t first,
+    const node_index_t second) const noexcept
+{
+    if (first >= m_sets.size() || second >= m_sets.size()) {
+        return 0;
+    }
+    const auto& a = m_sets[first];
+    const auto& b = m_sets[second];
+    if (a.first == b.first && a.count == b.count) {
+        return a.cardinality;
+    }
+    // Буферы для контейнеров, не являющихся битовыми картами
+    std::uint64_t scratchA[kBitmapWords];
+    std::uint64_t scratchB[kBitmapWords];
+    std::size_t result = 0;
+    std::uint32_t i = 0;
+    std::uint32_t j = 0;
+    while (i < a.count && j < b.count) {
+        const auto& x = m_containers[a.first + i];
+        const auto& y = m_containers[b.first + j];
+        if (x.key != y.key) {
+            x.key < y.key ? ++i : ++j;
+            continue;
+        }
+        ++i;
+        ++j;
+        if (x.type == y.type && x.offset == y.offset) {
+            // Общий контейнер
+            result += x.cardinality;
+            continue;
+        }
+        const auto xv = m_values.data() + x.offset;
+        const auto yv = m_values.data() + y.offset;
+        if (x.type == ContainerType::Runs && y.type == ContainerType::Runs) {
+            std::uint32_t p = 0;
+            std::uint32_t q = 0;
+            while (p < x.size && q < y.size) {
+                const std::uint32_t xEnd = xv[2 * p] + xv[2 * p + 1] + 1u;
+                const std::uint32_t yEnd = yv[2 * q] + yv[2 * q + 1] + 1u;
+                const std::uint32_t start = std::max(xv[2 * p], yv[2 * q]);
+                const std::uint32_t end = std::min(xEnd, yEnd);
+                if (start < end) {
+                    result += end - start;
+                }
+                xEnd < yEnd ? ++p : ++q;
+            }
+        }
+        else if (x.type == ContainerType::Array && y.type == ContainerType::Array) {
+            std::uint32_t p = 0;
+            std::uint32_t q = 0;
+            while (p < x.size && q < y.size) {
+                if (xv[p] == yv[q]) {
+                    ++result;
+                    ++p;
+                    ++q;
+                }
+                else {
+                    xv[p] < yv[q] ? ++p : ++q;
+                }
+            }
+        }
+        else if (x.type == ContainerType::Array || y.type == ContainerType::Array) {
+            const auto& array = x.type == ContainerType::Array ? x : y;
+            const auto& other = x.type == ContainerType::Array ? y : x;
+            const auto words = AsBitmap(other, scratchB);
+            const auto values = m_values.data() + array.offset;
+            for (std::uint32_t k = 0; k < array.size; ++k) {
+                result += (words[values[k] / 64] >> (values[k] % 64)) & 1;
+            }
+        }
+        else {
+            const auto xw = AsBitmap(x, scratchA);
+            const auto yw = AsBitmap(y, scratchB);
+            std::uint32_t count = 0;
+            for (std::size_t k = 0; k < kBitmapWords; ++k) {
+                count += CountBits(xw[k] & yw[k]);
+            }
+            result += count;
+        }
+    }
+    return result;
+}
+
+/**
+ * Получение ответов, достижимых из узла.
+ *
+ * \param node Индекс узла
+ * \param answers Индексы узлов ответов
+ * \return
+ */
+void CandidateIndex::Collect(
+    const node_index_t node,
+    std::vector<node_index_t>& answers) const
+{
+    if (node >= m_sets.size()) {
+        return;
+    }
+    const auto& set = m_sets[node];
+    answers.reserve(answers.size() + set.cardinality);
+    for (std::uint32_t i = 0; i < set.count; ++i) {
+        const auto& container = m_containers[set.first + i];
+        const std::uint32_t base = std::uint32_t(container.key) << 16;
+        const auto values = m_values.data() + container.offset;
+        switch (container.type) {
+        case ContainerType::Array:
+            for (std::uint32_t k = 0; k < container.size; ++k) {
+                answers.push_back(m_answers[base + values[k]]);
+            }
+            break;
+        case ContainerType::Runs:
+            for (std::uint32_t k = 0; k < container.size; ++k) {
+                const std::uint32_t start = base + values[2 * k];
+                const std::uint32_t end = start + values[2 * k + 1] + 1u;
+                for (auto ordinal = start; ordinal < end; ++ordinal) {
+                    answers.push_back(m_answers[ordinal]);
+                }
+            }
+            break;
+        case ContainerType::Bitmap:
+            for (std::size_t k = 0; k < kBitmapWords; ++k) {
+                for (auto word = m_bitmaps[container.offset + k]; word; word &= word - 1) {
+                    answers.push_back(m_answers[base + k * 64 + LowestBit(word)]);
+                }
+            }
+            break;
+        }
+    }
+}
+
+/**
+ * Получение объёма памяти, занятой множествами.
+ *
+ * \return Объём в байтах
+ */
+std::size_t CandidateIndex::MemoryBytes() const noexcept
+{
+    return m_answers.capacity() * sizeof(node_index_t)
+        + m_sets.capacity() * sizeof(Set)
+        + m_containers.capacity() * sizeof(Container)
+        + m_values.capacity() * sizeof(std::uint16_t)
+        + m_bitmaps.capacity() * sizeof(std::uint64_t);
+}
+
+/**
+ * Удаление контейнеров, не принадлежащих ни одному множеству.
+ * Разделение диапазонов контейнеров и данных сохраняется.
+ *
+ * \return
+ */
+void CandidateIndex::Compact()
+{
+    std::vector<Container> containers;
+    std::vector<std::uint16_t> values;
+    std::vector<std::uint64_t> bitmaps;
+    // Старое начало диапазона и количество -> новое начало
+    std::unordered_map<std::uint64_t, std::uint32_t> ranges;
+    // Старое смещение данных -> новое
+    std::unordered_map<std::uint32_t, std::uint32_t> valueOffsets;
+    std::unordered_map<std::uint32_t, std::uint32_t> bitmapOffsets;
+    for (auto& set : m_sets) {
+        if (!set.count) {
+            continue;
+        }
+        const auto rangeKey = (std::uint64_t(set.first) << 32) | set.count;
+        const auto range = ranges.find(rangeKey);
+        if (range != ranges.end()) {
+            set.first = range->second;
+            continue;
+        }
+        const auto first = static_cast<std::uint32_t>(containers.size());
+        for (std::uint32_t i = 0; i < set.count; ++i) {
+            auto container = m_containers[set.first + i];
+            if (container.type == ContainerType::Bitmap) {
+                const auto [it, added] = bitmapOffsets.emplace(
+                    container.offset, static_cast<std::uint32_t>(bitmaps.size()));
+                if (added) {
+                    bitmaps.insert(bitmaps.end(), m_bitmaps.begin() + container.offset,
+                        m_bitmaps.begin() + container.offset + kBitmapWords);
+                }
+                container.offset = it->second;
+            }
+            else {
+                const auto [it, added] = valueOffsets.emplace(
+                    container.offset, static_cast<std::uint32_t>(values.size()));
+                if (added) {
+                    const auto length = container.type == ContainerType::Runs
+                        ? container.size * 2 : container.size;
+                    values.insert(values.end(), m_values.begin() + container.offset,
+                        m_values.begin() + container.offset + length);
+                }
+                container.offset = it->second;
+            }
+            containers.push_back(container);
+        }
+        ranges.emplace(rangeKey, first);
+        set.first = first;
+    }
+    m_containers = std::move(containers);
+    m_values = std::move(values);
+    m_bitmaps = std::move(bitmaps);
+}
+
+}
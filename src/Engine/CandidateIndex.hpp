@@ -0,0 +1,193 @@
+﻿#pragma once
+
+#include "Tree.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ES
+{
+
+/**
+ * Множества ответов, достижимых из каждого узла дерева.
+ * Строится один раз после загрузки и затем только читается,
+ * поэтому разделяется всеми сеансами и копиями дерева
+ * (индексы узлов в копиях совпадают).
+ *
+ * Ответы нумеруются подряд в порядке индексов узлов, и множество
+ * номеров хранится по схеме roaring: номера делятся на группы
+ * по старшим 16 битам, каждая группа хранится контейнером одного
+ * из трёх видов - отсортированным массивом, списком интервалов
+ * или битовой картой на 65536 бит, смотря что компактнее.
+ * Ответы поддерева обычно идут подряд, поэтому большинство
+ * множеств занимают один-два интервала. Контейнеры не изменяются
+ * после построения, и вопрос с единственным продолжением
+ * разделяет контейнеры со своим дочерним узлом.
+ */
+class CandidateIndex final
+{
+public:
+    /**
+     * Конструктор. Вычисляет множества для всех узлов дерева.
+     * Множество вопроса - объединение множеств дочерних узлов,
+     * множество ответа - сам ответ. Циклы в дереве допускаются.
+     *
+     * \param tree Дерево
+     */
+    explicit CandidateIndex(
+        const Tree& tree);
+
+    /**
+     * Получение количества ответов, достижимых из узла.
+     *
+     * \param node Индекс узла
+     * \return Количество ответов
+     */
+    std::size_t Count(
+        const node_index_t node) const noexcept
+    {
+        return node < m_sets.size() ? m_sets[node].cardinality : 0;
+    }
+
+    /**
+     * Проверка достижимости ответа из узла.
+     *
+     * \param node Индекс узла
+     * \param answer Индекс узла ответа
+     * \return true - если ответ достижим
+     */
+    bool Contains(
+        const node_index_t node,
+        const node_index_t answer) const noexcept;
+
+    /**
+     * Получение количества ответов, достижимых из обоих узлов.
+     *
+     * \param first Индекс первого узла
+     * \param second Индекс второго узла
+     * \return Размер пересечения множеств
+     */
+    std::size_t IntersectionCount(
+        const node_index_t first,
+        const node_index_t second) const noexcept;
+
+    /**
+     * Получение ответов, достижимых из узла.
+     *
+     * \param node Индекс узла
+     * \param answers Индексы узлов ответов в порядке возрастания.
+     * Ответы добавляются в конец
+     * \return
+     */
+    void Collect(
+        const node_index_t node,
+        std::vector<node_index_t>& answers) const;
+
+    /**
+     * Получение объёма памяти, занятой множествами.
+     *
+     * \return Объём в байтах
+     */
+    std::size_t MemoryBytes() const noexcept;
+
+private:
+    // Вид контейнера
+    enum class ContainerType : std::uint8_t
+    {
+        Array,  // Отсортированные младшие 16 бит номеров
+        Runs,   // Пары (начало, длина - 1)
+        Bitmap  // 1024 слова по 64 бита
+    };
+
+    // Контейнер одной группы номеров
+    struct Container
+    {
+        // Старшие 16 бит номеров группы
+        std::uint16_t key = 0;
+        // Вид контейнера
+        ContainerType type = ContainerType::Array;
+        // Количество номеров в контейнере (до 65536)
+        std::uint32_t cardinality = 0;
+        // Смещение данных в m_values (массив, интервалы)
+        // либо в m_bitmaps (битовая карта)
+        std::uint32_t offset = 0;
+        // Количество элементов массива либо интервалов
+        std::uint32_t size = 0;
+    };
+
+    // Множество узла: диапазон контейнеров в m_containers
+    struct Set
+    {
+        std::uint32_t first = 0;
+        std::uint32_t count = 0;
+        std::uint32_t cardinality = 0;
+    };
+
+    // Количество слов битовой карты контейнера
+    static constexpr std::size_t kBitmapWords = 65536 / 64;
+
+    /**
+     * Вычисление множества вопроса объединением множеств дочерних узлов.
+     *
+     * \param question Вопрос
+     * \return Множество вопроса
+     */
+    Set Union(
+        const Question& question);
+
+    /**
+     * Добавление контейнера, построенного по битовой карте.
+     * Выбирается самое компактное представление.
+     *
+     * \param key Старшие 16 бит номеров
+     * \param words Битовая карта
+     * \return
+     */
+    void AppendContainer(
+        const std::uint16_t key,
+        const std::uint64_t* words);
+
+    /**
+     * Получение битовой карты контейнера.
+     *
+     * \param container Контейнер
+     * \param scratch Буфер для контейнеров другого вида
+     * \return Битовая карта контейнера либо scratch
+     */
+    const std::uint64_t* AsBitmap(
+        const Container& container,
+        std::uint64_t* scratch) const noexcept;
+
+    /**
+     * Поиск номера ответа по индексу узла.
+     *
+     * \param answer Индекс узла ответа
+     * \param ordinal Номер ответа
+     * \return false, если узел не является ответом
+     */
+    bool OrdinalOf(
+        const node_index_t answer,
+        std::uint32_t& ordinal) const noexcept;
+
+    /**
+     * Удаление контейнеров, не принадлежащих ни одному множеству.
+     * Остаются после повторных проходов по циклам.
+     *
+     * \return
+     */
+    void Compact();
+
+    // Индексы узлов ответов по номерам ответов
+    std::vector<node_index_t> m_answers;
+    // Множества по индексам узлов
+    std::vector<Set> m_sets;
+    // Контейнеры всех множеств
+    std::vector<Container> m_containers;
+    // Данные массивов и интервалов
+    std::vector<std::uint16_t> m_values;
+    // Данные битовых карт
+    std::vector<std::uint64_t> m_bitmaps;
+};
+
+}
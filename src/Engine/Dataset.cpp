@@ -0,0 +1,412 @@
+﻿#include "Dataset.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace ES
+{
+
+// Размер выборки значений числового столбца для вычисления квантилей
+static constexpr std::size_t kSampleSize = 64 * 1024;
+// Наибольшее количество различных значений, подсчитываемых
+// в столбце на первом проходе. Остальные значения считаются редкими
+static constexpr std::size_t kTrackedCategories = 4096;
+
+/**
+ * Сведения о столбце, собираемые на первом проходе.
+ */
+struct ColumnProfile
+{
+    // Все непустые значения - числа
+    bool numeric = true;
+    // Количество числовых значений
+    std::size_t numbers = 0;
+    // Равномерная выборка числовых значений
+    std::vector<double> sample;
+    // Количество строк по значениям
+    std::unordered_map<std::string, std::size_t> categories;
+    // Встретились значения сверх kTrackedCategories
+    bool overflow = false;
+};
+
+/**
+ * Разбор строки CSV на поля.
+ * Поля в кавычках могут содержать разделитель и удвоенные кавычки.
+ * Пробелы вокруг полей без кавычек отбрасываются.
+ *
+ * \param line Строка
+ * \param separator Разделитель полей
+ * \param fields Поля строки (буфер переиспользуется между строками)
+ * \return Количество полей
+ */
+static std::size_t SplitLine(
+    const std::string& line,
+    const char separator,
+    std::vector<std::string>& fields)
+{
+    std::size_t count = 0;
+    std::size_t i = 0;
+    std::size_t size = line.size();
+    if (size && line[size - 1] == '\r') {
+        --size;
+    }
+    do {
+        if (fields.size() <= count) {
+            fields.emplace_back();
+        }
+        auto& field = fields[count++];
+        field.clear();
+        while (i < size && (line[i] == ' ' || line[i] == '\t')) {
+            ++i;
+        }
+        if (i < size && line[i] == '"') {
+            // Поле в кавычках
+            for (++i; i < size; ++i) {
+                if (line[i] == '"') {
+                    if (i + 1 < size && line[i + 1] == '"') {
+                        field.push_back('"');
+                        ++i;
+                        continue;
+                    }
+                    ++i;
+                    break;
+                }
+                field.push_back(line[i]);
+            }
+            while (i < size && line[i] != separator) {
+                ++i;
+            }
+        }
+        else {
+            const auto begin = i;
+            while (i < size && line[i] != separator) {
+                ++i;
+            }
+            auto end = i;
+            while (end > begin && (line[end - 1] == ' ' || line[end - 1] == '\t')) {
+                --end;
+            }
+            field.assign(line, begin, end - begin);
+        }
+    } while (i++ < size);
+    return count;
+}
+
+/**
+ * Чтение записи CSV.
+ * Запись продолжается на следующих строках файла, пока открыто поле
+ * в кавычках, поэтому такие поля могут содержать переводы строк.
+ * Переводы строк внутри поля сохраняются как '\n'.
+ *
+ * \param file Поток
+ * \param separator Разделитель полей
+ * \param record Запись (буфер переиспользуется между записями)
+ * \param next Буфер строки продолжения
+ * \return true - если запись прочитана
+ */
+static bool ReadRecord(
+    std::istream& file,
+    const char separator,
+    std::string& record,
+    std::string& next)
+{
+    if (!std::getline(file, record)) {
+        return false;
+    }
+    bool start = true;
+    bool quoted = false;
+    std::size_t i = 0;
+    for (;;) {
+        for (; i < record.size(); ++i) {
+            const char c = record[i];
+            if (quoted) {
+                if (c == '"') {
+                    if (i + 1 < record.size() && record[i + 1] == '"') {
+                        ++i;
+                    }
+                    else {
+                        quoted = false;
+                    }
+                }
+            }
+            else if (c == separator) {
+                start = true;
+            }
+            else if (start && c == '"') {
+                quoted = true;
+                start = false;
+            }
+            else if (c != ' ' && c != '\t') {
+                start = false;
+            }
+        }
+        if (!quoted) {
+            return true;
+        }
+        if (!std::getline(file, next)) {
+            throw std::runtime_error(u8"Поле в кавычках не закрыто до конца файла");
+        }
+        if (!record.empty() && record.back() == '\r') {
+            record.pop_back();
+        }
+        record.push_back('\n');
+        i = record.size();
+        record += next;
+    }
+}
+
+/**
+ * Разбор числа.
+ *
+ * \param text Текст
+ * \param value Число
+ * \return true - если весь текст является конечным числом
+ */
+static bool ParseNumber(
+    const std::string& text,
+    double& value)
+{
+    char* end = nullptr;
+    value = std::strtod(text.c_str(), &end);
+    return end == text.c_str() + text.size() && std::isfinite(value);
+}
+
+/**
+ * Получение текстового описания значения.
+ *
+ * \param code Код значения
+ * \return Описание
+ */
+std::string DatasetFeature::DescribeValue(
+    const std::uint8_t code) const
+{
+    if (numeric) {
+        if (code > edges.size()) {
+            return u8"нет данных";
+        }
+        std::ostringstream text;
+        if (edges.empty()) {
+            text << u8"любое";
+        }
+        else if (code == 0) {
+            text << u8"меньше " << edges.front();
+        }
+        else if (code == edges.size()) {
+            text << u8"не меньше " << edges.back();
+        }
+        else {
+            text << u8"от " << edges[code - 1] << u8" до " << edges[code];
+        }
+        return text.str();
+    }
+    if (code == 0) {
+        return u8"нет данных";
+    }
+    return code < categories.size() ? categories[code] : u8"другое";
+}
+
+/**
+ * Чтение набора данных из CSV-файла с заголовком.
+ *
+ * \param path Путь к файлу
+ * \param labelColumn Столбец с ответом. Если пусто, то последний столбец
+ * \param bins Количество интервалов числовых признаков
+ * \param maxCategories Наибольшее количество значений категориального признака
+ * \return Набор данных
+ */
+Dataset ReadDataset(
+    const std::string& path,
+    const std::string& labelColumn,
+    const std::size_t bins,
+    const std::size_t maxCategories) noexcept(false)
+{
+    std::ifstream file(path, std::ios::binary);
+    std::string line;
+    if (!file || !std::getline(file, line)) {
+        throw std::runtime_error(u8"Не удалось прочитать " + path);
+    }
+    if (line.compare(0, 3, "\xEF\xBB\xBF") == 0) {
+        line.erase(0, 3);
+    }
+    // Разделитель определяется по заголовку
+    const char separator = std::count(line.begin(), line.end(), ';')
+        > std::count(line.begin(), line.end(), ',') ? ';' : ',';
+    std::vector<std::string> header;
+    const auto columns = SplitLine(line, separator, header);
+    header.resize(columns);
+    if (columns < 2) {
+        throw std::runtime_error(u8"В наборе данных должно быть не меньше двух столбцов: " + path);
+    }
+    std::size_t labelIndex = columns - 1;
+    if (!labelColumn.empty()) {
+        const auto it = std::find(header.begin(), header.end(), labelColumn);
+        if (it == header.end()) {
+            throw std::runtime_error(u8"Не найден столбец с ответом: " + labelColumn);
+        }
+        labelIndex = static_cast<std::size_t>(it - header.begin());
+    }
+
+    // Первый проход: типы столбцов, выборки чисел, частоты значений
+    Dataset dataset;
+    std::unordered_map<std::string, std::uint16_t> labelCodes;
+    std::vector<ColumnProfile> profiles(columns);
+    std::vector<std::string> fields;
+    std::string next;
+    std::mt19937_64 random(columns);
+    std::size_t rows = 0;
+    while (ReadRecord(file, separator, line, next)) {
+        if (line.empty() || line == "\r") {
+            continue;
+        }
+        if (SplitLine(line, separator, fields) != columns) {
+            throw std::runtime_error(u8"Неверное количество полей в записи "
+                + std::to_string(rows + 1) + u8" файла " + path);
+        }
+        ++rows;
+        for (std::size_t column = 0; column < columns; ++column) {
+            const auto& field = fields[column];
+            if (column == labelIndex) {
+                if (labelCodes.emplace(field, static_cast<std::uint16_t>(labelCodes.size())).second) {
+                    if (labelCodes.size() > UINT16_MAX) {
+                        throw std::runtime_error(u8"Слишком много различных ответов в " + path);
+                    }
+                    dataset.labelNames.push_back(field);
+                }
+                continue;
+            }
+            auto& profile = profiles[column];
+            if (field.empty()) {
+                continue;
+            }
+            double value = 0;
+            if (profile.numeric && ParseNumber(field, value)) {
+                // Равномерная выборка (reservoir sampling)
+                ++profile.numbers;
+                if (profile.sample.size() < kSampleSize) {
+                    profile.sample.push_back(value);
+                }
+                else {
+                    const auto j = random() % profile.numbers;
+                    if (j < kSampleSize) {
+                        profile.sample[j] = value;
+                    }
+                }
+            }
+            else if (profile.numeric) {
+                profile.numeric = false;
+                profile.sample = {};
+            }
+            auto it = profile.categories.find(field);
+            if (it != profile.categories.end()) {
+                ++it->second;
+            }
+            else if (profile.categories.size() < kTrackedCategories) {
+                profile.categories.emplace(field, 1);
+            }
+            else {
+                profile.overflow = true;
+            }
+        }
+    }
+    if (rows > UINT32_MAX) {
+        throw std::runtime_error(u8"Слишком много строк в " + path);
+    }
+
+    // Кодирование значений каждого признака
+    const auto binsCount = std::clamp<std::size_t>(bins, 1, 254);
+    const auto categoriesCount = std::clamp<std::size_t>(maxCategories, 2, 255);
+    std::vector<std::size_t> featureColumns;
+    std::vector<std::unordered_map<std::string, std::uint8_t>> categoryCodes(columns);
+    for (std::size_t column = 0; column < columns; ++column) {
+        if (column == labelIndex) {
+            continue;
+        }
+        featureColumns.push_back(column);
+        auto& profile = profiles[column];
+        DatasetFeature feature;
+        feature.name = header[column];
+        feature.numeric = profile.numeric;
+        if (feature.numeric) {
+            // Границы интервалов - квантили выборки
+            auto& sample = profile.sample;
+            std::sort(sample.begin(), sample.end());
+            for (std::size_t bin = 1; bin < binsCount && !sample.empty(); ++bin) {
+                const double edge = sample[bin * sample.size() / binsCount];
+                if (edge > sample.front()
+                    && (feature.edges.empty() || edge > feature.edges.back())) {
+                    feature.edges.push_back(edge);
+                }
+            }
+            // Интервалы и отдельный код для пустых ячеек
+            feature.valuesCount = feature.edges.size() + 2;
+        }
+        else {
+            // Код 0 - пустая ячейка, далее самые частые значения
+            std::vector<std::pair<std::size_t, std::string>> frequent;
+            frequent.reserve(profile.categories.size());
+            for (auto& [value, count] : profile.categories) {
+                frequent.emplace_back(count, value);
+            }
+            std::sort(frequent.begin(), frequent.end(), [](const auto& a, const auto& b) {
+                return a.first != b.first ? a.first > b.first : a.second < b.second;
+            });
+            const bool other = profile.overflow || frequent.size() + 1 > categoriesCount;
+            const auto kept = std::min(frequent.size(), categoriesCount - 1 - (other ? 1 : 0));
+            feature.categories.emplace_back();
+            for (std::size_t i = 0; i < kept; ++i) {
+                categoryCodes[column].emplace(frequent[i].second,
+                    static_cast<std::uint8_t>(feature.categories.size()));
+                feature.categories.push_back(std::move(frequent[i].second));
+            }
+            // Редкие значения получают код, следующий за последней категорией
+            feature.valuesCount = feature.categories.size() + (other ? 1 : 0);
+        }
+        profiles[column] = {};
+        feature.codes.reserve(rows);
+        dataset.features.push_back(std::move(feature));
+    }
+
+    // Второй проход: кодирование строк
+    file.clear();
+    file.seekg(0);
+    std::getline(file, line);
+    dataset.labels.reserve(rows);
+    while (ReadRecord(file, separator, line, next)) {
+        if (line.empty() || line == "\r") {
+            continue;
+        }
+        SplitLine(line, separator, fields);
+        dataset.labels.push_back(labelCodes[fields[labelIndex]]);
+        for (std::size_t i = 0; i < featureColumns.size(); ++i) {
+            const auto& field = fields[featureColumns[i]];
+            auto& feature = dataset.features[i];
+            std::uint8_t code = 0;
+            if (feature.numeric) {
+                double value = 0;
+                code = static_cast<std::uint8_t>(field.empty() || !ParseNumber(field, value)
+                    ? feature.edges.size() + 1
+                    : std::upper_bound(feature.edges.begin(), feature.edges.end(), value)
+                        - feature.edges.begin());
+            }
+            else if (!field.empty()) {
+                const auto& codes = categoryCodes[featureColumns[i]];
+                const auto it = codes.find(field);
+                code = it != codes.end() ? it->second
+                    : static_cast<std::uint8_t>(feature.categories.size());
+            }
+            feature.codes.push_back(code);
+        }
+    }
+    if (dataset.labels.size() != rows) {
+        throw std::runtime_error(u8"Набор данных изменился во время чтения: " + path);
+    }
+    return dataset;
+}
+
+}
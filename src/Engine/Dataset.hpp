@@ -0,0 +1,85 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ES
+{
+
+/**
+ * Признак набора данных, закодированный байтом на строку.
+ * Числовой признак делится на интервалы по квантилям,
+ * у категориального признака сохраняются самые частые значения.
+ * Пустая ячейка кодируется отдельным значением.
+ */
+struct DatasetFeature
+{
+    // Название столбца
+    std::string name;
+    // Числовой признак
+    bool numeric = false;
+    // Границы интервалов числового признака (по возрастанию)
+    std::vector<double> edges;
+    // Значения категориального признака по кодам
+    std::vector<std::string> categories;
+    // Коды значений по строкам
+    std::vector<std::uint8_t> codes;
+    // Количество кодов
+    std::size_t valuesCount = 0;
+
+    /**
+     * Получение текстового описания значения.
+     *
+     * \param code Код значения
+     * \return Описание
+     */
+    std::string DescribeValue(
+        const std::uint8_t code) const;
+};
+
+/**
+ * Набор размеченных данных, хранимый по столбцам.
+ */
+struct Dataset
+{
+    // Признаки
+    std::vector<DatasetFeature> features;
+    // Названия ответов по кодам
+    std::vector<std::string> labelNames;
+    // Коды ответов по строкам
+    std::vector<std::uint16_t> labels;
+
+    /**
+     * Получение количества строк.
+     *
+     * \return Количество строк
+     */
+    std::size_t RowsCount() const noexcept
+    {
+        return labels.size();
+    }
+};
+
+/**
+ * Чтение набора данных из CSV-файла с заголовком.
+ * Файл читается дважды: на первом проходе по выборке значений
+ * определяются типы столбцов, границы интервалов и частые категории,
+ * на втором проходе значения кодируются.
+ * Поля в кавычках могут содержать разделитель, удвоенные кавычки
+ * и переводы строк. Заголовок должен занимать одну строку.
+ *
+ * \param path Путь к файлу
+ * \param labelColumn Столбец с ответом. Если пусто, то последний столбец
+ * \param bins Количество интервалов числовых признаков
+ * \param maxCategories Наибольшее количество значений категориального признака
+ * \return Набор данных
+ */
+Dataset ReadDataset(
+    const std::string& path,
+    const std::string& labelColumn,
+    const std::size_t bins,
+    const std::size_t maxCategories) noexcept(false);
+
+}
@@ -1,6 +1,12 @@
 ﻿#include "ExpertSystem.hpp"
 
+#include "GraphValidator.hpp"
 #include "IExpertSystemLoader.hpp"
+#include "ILogger.hpp"
+#include "TreeDiff.hpp"
+
+#include <algorithm>
+#include <stdexcept>
 
 namespace ES
 {
@@ -15,8 +21,194 @@ std::unique_ptr<IExpertSystem> CreateExpertSystem()
     return std::make_unique<ExpertSystem>();
 }
 
+/**
+ * Конструктор. Назначает сеансу уникальный идентификатор.
+ */
+ExpertSystem::ExpertSystem() noexcept:
+    m_sessionID(NextSessionID())
+{
+}
+
+/**
+ * Деструктор. Завершает сеанс в журнале сеансов.
+ */
+ExpertSystem::~ExpertSystem()
+{
+    if (m_journal) {
+        m_journal->Record(m_sessionID, ++m_sequence, JournalRecordType::Close, 0, 0);
+    }
+}
+
+/**
+ * Подсчёт памяти, занятой базой знаний.
+ *
+ * \param tree Дерево
+ * \param candidates Множества достижимых ответов, либо nullptr
+ * \param parents Обратные соединения, либо nullptr
+ * \param search Полнотекстовый индекс, либо nullptr
+ * \return Память по категориям
+ */
+static MemoryReport CountMemory(
+    const Tree& tree,
+    const CandidateIndex* candidates,
+    const ParentIndex* parents,
+    const SearchIndex* search) noexcept
+{
+    auto report = tree.Memory();
+    std::size_t texts = 0;
+    std::size_t indices = 0;
+    if (const auto store = tree.Texts()) {
+        texts = store->CompressedBytes();
+    }
+    if (candidates) {
+        indices += candidates->MemoryBytes();
+    }
+    if (parents) {
+        indices += parents->MemoryBytes();
+    }
+    if (search) {
+        indices += search->MemoryBytes();
+    }
+    report.texts += texts;
+    report.indices += indices;
+    report.total += texts + indices;
+    return report;
+}
+
+/**
+ * Получение индекса для подсчёта памяти.
+ *
+ * \param index Индекс новой версии дерева, либо nullptr
+ * \param previous Индекс прежней версии, либо nullptr
+ * \return Индекс новой версии, если он построен, иначе индекс
+ * прежней версии как оценка, либо nullptr
+ */
+template <typename Index>
+static const Index* Estimate(
+    const std::shared_ptr<const LazyIndex<Index>>& index,
+    const std::shared_ptr<const LazyIndex<Index>>& previous) noexcept
+{
+    if (!index) {
+        return nullptr;
+    }
+    if (const auto built = index->Built()) {
+        return built;
+    }
+    return previous ? previous->Built() : nullptr;
+}
+
+/**
+ * Создание индекса дерева.
+ *
+ * \param tree Дерево
+ * \param lazy true - индекс строится при первом обращении, false - сразу
+ * \param build Функция построения индекса
+ * \return Индекс
+ */
+template <typename Index>
+static std::shared_ptr<const LazyIndex<Index>> MakeIndex(
+    std::shared_ptr<const Tree> tree,
+    const bool lazy,
+    std::shared_ptr<const Index> (*build)(const Tree&))
+{
+    if (!lazy) {
+        return std::make_shared<const LazyIndex<Index>>(build(*tree));
+    }
+    return std::make_shared<const LazyIndex<Index>>(
+        typename LazyIndex<Index>::build_t([tree, build] { return build(*tree); }));
+}
+
+/**
+ * Построение множеств достижимых ответов.
+ *
+ * \param tree Дерево
+ * \return Множества ответов
+ */
+static std::shared_ptr<const CandidateIndex> BuildCandidates(
+    const Tree& tree)
+{
+    auto candidates = std::make_shared<const CandidateIndex>(tree);
+    logger->Log(LogLevel::Info, u8"Множества ответов построены: "
+        + std::to_string(candidates->MemoryBytes()) + u8" байт");
+    return candidates;
+}
+
+/**
+ * Построение обратных соединений.
+ *
+ * \param tree Дерево
+ * \return Обратные соединения
+ */
+static std::shared_ptr<const ParentIndex> BuildParents(
+    const Tree& tree)
+{
+    auto parents = std::make_shared<const ParentIndex>(tree);
+    logger->Log(LogLevel::Info, u8"Обратные соединения построены: "
+        + std::to_string(parents->MemoryBytes()) + u8" байт");
+    return parents;
+}
+
+/**
+ * Построение полнотекстового индекса.
+ *
+ * \param tree Дерево с текстами в узлах
+ * \return Полнотекстовый индекс
+ */
+static std::shared_ptr<const SearchIndex> BuildSearch(
+    const Tree& tree)
+{
+    auto search = std::make_shared<const SearchIndex>(tree);
+    logger->Log(LogLevel::Info, u8"Полнотекстовый индекс построен: "
+        + std::to_string(search->TermsCount()) + u8" слов, "
+        + std::to_string(search->MemoryBytes()) + u8" байт");
+    return search;
+}
+
+/**
+ * Вывод отчёта о проверке графа: одна строка на вид ошибок
+ * с их количеством и примерами идентификаторов узлов.
+ *
+ * \param report Отчёт о проверке
+ * \param full true - граф проверен целиком, false - отчёт
+ * содержит только ошибки, найденные при загрузке
+ * \return
+ */
+static void LogValidationReport(
+    const ValidationReport& report,
+    const bool full)
+{
+    if (full) {
+        logger->Log(report.total ? LogLevel::Warning : LogLevel::Info, u8"Граф проверен за "
+            + std::to_string(static_cast<long long>(report.milliseconds)) + u8" мс: узлов "
+            + std::to_string(report.nodes) + u8", соединений "
+            + std::to_string(report.connections) + u8", ошибок "
+            + std::to_string(report.total));
+    }
+    else {
+        logger->Log(report.total ? LogLevel::Warning : LogLevel::Info,
+            u8"Граф после перезагрузки проверен только при загрузке изменений, ошибок "
+            + std::to_string(report.total));
+    }
+    for (std::size_t issue = 0; issue < kValidationIssues; ++issue) {
+        const auto& issues = report.issues[issue];
+        if (!issues.count) {
+            continue;
+        }
+        std::string samples;
+        for (const auto id : issues.samples) {
+            samples += (samples.empty() ? "" : ", ") + std::to_string(id);
+        }
+        logger->Log(LogLevel::Warning, std::string(
+            GetValidationIssueName(static_cast<ValidationIssue>(issue))) + u8": "
+            + std::to_string(issues.count) + u8" (узлы " + samples
+            + (issues.count > issues.samples.size() ? u8", ...)" : u8")"));
+    }
+}
+
 /**
  * Загрузка экспертной системы.
+ * Если база знаний не помещается в бюджет памяти, то в режиме
+ * Degrade загрузка повторяется со сжатыми текстами узлов.
  * 
  * \param configPath Путь к конфигурации
  * \return 
@@ -24,34 +216,172 @@ std::unique_ptr<IExpertSystem> CreateExpertSystem()
 void ExpertSystem::Load(
     const std::string& configPath) noexcept(false)
 {
-    // Создаём загрузчик
-    auto loader = CreateExpertSystemLoader();
-    // Загружаем
-    loader->Load(configPath);
+    const auto limit = m_memoryBudget.limit ? m_memoryBudget.limit : MemoryArena::kUnlimited;
+    auto compression = m_textCompression;
+    std::unique_ptr<IExpertSystemLoader> loader;
+    std::shared_ptr<Tree> tree;
+    bool derived = false;
+    std::shared_ptr<const LazyIndex<CandidateIndex>> candidates;
+    std::shared_ptr<const LazyIndex<ParentIndex>> parents;
+    std::shared_ptr<const LazyIndex<SearchIndex>> search;
+    MemoryReport memory;
+    while (true) {
+        // Создаём загрузчик
+        loader = CreateExpertSystemLoader();
+        tree = BuildTree(*loader, configPath, compression, limit, derived);
+        // Недостроенное дерево не сжимаем и не индексируем
+        if (!tree->Exceeded()) {
+            logger->Log(LogLevel::Info, u8"Индекс узлов построен: "
+                + std::to_string(tree->Memory().indices) + u8" байт");
+            // Полнотекстовый индекс строим, пока тексты хранятся в узлах.
+            // Версия, построенная из прежнего дерева, тексты не сжимает,
+            // поэтому её индекс строится при первом поиске
+            search = MakeIndex(tree, derived, BuildSearch);
+            if (compression.enabled) {
+                tree->CompressTexts(compression.blockSize, compression.dictionarySize);
+                logger->Log(LogLevel::Info, u8"Тексты узлов сжаты: "
+                    + std::to_string(tree->Texts()->OriginalBytes()) + u8" байт -> "
+                    + std::to_string(tree->Texts()->CompressedBytes()) + u8" байт");
+            }
+            // Вычисляем ответы, достижимые из каждого узла. Новая версия
+            // дерева обычно отличается от прежней немногими узлами,
+            // поэтому после перезагрузки множества строятся только
+            // при первом обращении
+            candidates = MakeIndex(tree, derived, BuildCandidates);
+            // Строим обратные соединения (после перезагрузки - тоже
+            // при первом обращении)
+            parents = MakeIndex(tree, derived, BuildParents);
+        }
+        // Ещё не построенные индексы новой версии оцениваем
+        // по индексам прежней, они почти не отличаются
+        memory = CountMemory(*tree, Estimate(candidates, m_candidates),
+            Estimate(parents, m_parents), Estimate(search, m_search));
+        if (!tree->Exceeded() && memory.total <= limit) {
+            break;
+        }
+        // Освобождаем недостроенную базу знаний до следующей попытки
+        candidates.reset();
+        parents.reset();
+        search.reset();
+        tree.reset();
+        if (m_memoryBudget.policy == MemoryBudgetPolicy::Degrade && !compression.enabled) {
+            logger->Log(LogLevel::Warning, u8"База знаний превышает бюджет памяти "
+                + std::to_string(m_memoryBudget.limit) + u8" байт, тексты узлов будут сжаты");
+            compression.enabled = true;
+            continue;
+        }
+        throw std::runtime_error(u8"База знаний превышает бюджет памяти "
+            + std::to_string(m_memoryBudget.limit) + u8" байт");
+    }
+    logger->Log(LogLevel::Info, u8"Память базы знаний: структура "
+        + std::to_string(memory.structure) + u8", соединения "
+        + std::to_string(memory.edges) + u8", тексты "
+        + std::to_string(memory.texts) + u8", индексы "
+        + std::to_string(memory.indices) + u8", не использовано "
+        + std::to_string(memory.unused) + u8", потеряно "
+        + std::to_string(memory.wasted) + u8", всего "
+        + std::to_string(memory.total) + u8" байт");
+    // Проверяем граф до того, как новая база знаний заменит прежнюю.
+    // Версию, построенную из прежнего дерева, целиком проверяем
+    // только по запросу: иначе в отчёт попадают ошибки, найденные
+    // при загрузке изменений
+    const auto full = !derived || m_validation.reload || m_validation.strict;
+    auto validation = std::make_shared<const ValidationReport>(
+        full ? ValidateTree(*tree, m_validation) : tree->Issues());
+    LogValidationReport(*validation, full);
+    if (m_validation.strict && validation->total) {
+        throw std::runtime_error(u8"База знаний содержит ошибки: "
+            + std::to_string(validation->total));
+    }
     // Получаем имя
     m_name = loader->GetName();
-    // Создаём дерево
-    m_tree = std::make_unique<Tree>();
-    // Получаем список вопросов
-    auto questions = loader->GetQuestions();
-    // Добавляем вопросы в дерево
-    for (const auto& question : questions) {
-        m_tree->AddQuestion(question);
+    // Строим копии нового дерева, если включена репликация
+    std::shared_ptr<const ReplicaSet> replicas;
+    if (m_replication.mode != ReplicationMode::None) {
+        replicas = std::make_shared<ReplicaSet>(tree, m_replication);
     }
-    // Получаем список ответов
-    auto answers = loader->GetAnswers();
-    // Добавляем ответы в дерево
-    for (const auto& answer : answers) {
-        m_tree->AddAnswer(answer);
+    // Тексты на дополнительных языках будут загружаться по требованию
+    auto languages = std::make_shared<LanguageSet>(
+        tree, loader->GetLanguages(), compression);
+    // Дерево загружено, заменяем им текущее
+    m_tree = std::move(tree);
+    m_candidates = std::move(candidates);
+    m_parents = std::move(parents);
+    m_search = std::move(search);
+    m_replicas = std::move(replicas);
+    m_validationReport = std::move(validation);
+    m_languages = std::move(languages);
+    m_languageTexts.reset();
+    // Новое дерево начинаем проходить с начала
+    Reset();
+}
+
+/**
+ * Построение дерева по конфигурации.
+ * Если дерево уже загружено, то строится его новая версия
+ * из изменившихся узлов, а новые узлы размещаются в новой
+ * области памяти. Когда версия накопила слишком много удалённых
+ * узлов или областей прежних версий либо не поместилась в бюджет,
+ * дерево строится заново в одной области.
+ *
+ * \param loader Загрузчик
+ * \param configPath Путь к конфигурации
+ * \param compression Параметры хранения текстов
+ * \param limit Лимит памяти дерева в байтах
+ * \return Дерево. Если лимит превышен, то дерево построено не полностью
+ */
+std::shared_ptr<Tree> ExpertSystem::BuildTree(
+    IExpertSystemLoader& loader,
+    const std::string& configPath,
+    const TextCompressionOptions& compression,
+    const std::size_t limit,
+    bool& derived) const noexcept(false)
+{
+    std::shared_ptr<Tree> tree;
+    derived = false;
+    // Сжатые тексты не сравниваются с новой конфигурацией,
+    // поэтому в этом случае дерево всегда строится заново
+    if (m_tree && !m_tree->Texts() && !compression.enabled) {
+        // Новая версия удерживает память предыдущей,
+        // поэтому новым узлам достаётся остаток бюджета
+        const auto used = m_tree->Memory().total;
+        const auto rest = limit == MemoryArena::kUnlimited ? limit
+            : limit > used ? limit - used : 0;
+        // Дерево уже загружено. Сравниваем с ним новую конфигурацию
+        // и строим новую версию только из изменившихся узлов
+        TreeDiff diff(m_tree, std::make_shared<MemoryArena>(rest));
+        loader.Load(configPath, diff);
+        tree = diff.Build();
+        derived = true;
+        logger->Log(LogLevel::Info, u8"Изменения: добавлено "
+            + std::to_string(diff.ChangesCount(TreeChangeType::Add))
+            + u8", удалено " + std::to_string(diff.ChangesCount(TreeChangeType::Remove))
+            + u8", изменено " + std::to_string(diff.ChangesCount(TreeChangeType::Update))
+            + u8", изменены соединения " + std::to_string(diff.ChangesCount(TreeChangeType::Relink)));
+        // Если больше половины индексов заняты удалёнными узлами,
+        // то дешевле построить дерево заново. Так же поступаем,
+        // если версия удерживает слишком много областей прежних
+        // версий либо не поместилась в бюджет
+        if (tree->RemovedCount() * 2 > tree->NodesCount()
+            || tree->ArenasCount() > kMaxTreeArenas
+            || tree->Exceeded()) {
+            tree.reset();
+        }
     }
-    // Получаем список соединений
-    auto connections = loader->GetConnections();
-    // Добавляем соединения в дерево
-    for (const auto& connection : connections) {
-        m_tree->AddConnection(connection);
+    if (!tree) {
+        // Создаём дерево в новой области памяти. Несжатые тексты
+        // размещаются в отдельной области, которая освобождается
+        // после сжатия и в бюджет не входит
+        derived = false;
+        tree = std::make_shared<Tree>(std::make_shared<MemoryArena>(limit),
+            compression.enabled ? std::make_shared<MemoryArena>() : nullptr);
+        // Загружаем, передавая узлы и соединения напрямую в дерево
+        loader.Load(configPath, *tree);
+        // Строим индекс узлов (в конфигурации может не быть соединений)
+        // и переносим соединения в вопросы
+        tree->Finish();
     }
-    // Запоминаем указатель на корень дерева
-    currentNode = m_tree->GetRoot();
+    return tree;
 }
 
 /**
@@ -68,32 +398,40 @@ std::string ExpertSystem::GetName() const
 /**
  * Получаем значение текущего узла дерева.
  * Это может быть вопрос или ответ.
- * Перед вызовом данного метода нужно проверить
- * завершение работы экспертной системы, вызвав
- * метод IsFinished(), поскольку если система уже достигла
- * конечного состояния, то получение значения текущего узла
- * является бессмысленным. В таком случае будет возвращена
- * пустая сторока.
+ * Если система достигла конечного состояния, то будет
+ * возвращён текст ответа. Если экспертная система не загружена,
+ * то будет возвращена пустая строка.
+ * Метод возвращает текст, принадлежащий дереву, и не выделяет память.
  * 
  * \return Текущее значение узла
  */
-std::string ExpertSystem::GetCurrentData() const
+std::string_view ExpertSystem::GetCurrentData() const
 {
-    // Проверка завершения работы экспертной системы
-    if (m_finished) {
-        // Система достигла конечного состояния,
-        // возвращаем пустую строку.
-        return "";
+    // Проверяем, что текущий узел существует
+    if (!currentNode) {
+        return {};
     }
-    // Получение значения текущего узла
-    std::string result = currentNode->Data();
-    // Если текущий узел это ответ,
-    if (currentNode->Type() == NodeType::Answer) {
-        // то выставляем флаг завершения работы системы
-        m_finished = true;
+    // Текст на языке сеанса, если для узла есть перевод
+    if (m_languageTexts && m_languageTexts->Has(currentNode->Index())) {
+        return m_textCache.Get(*m_languageTexts, currentNode->Index());
     }
-    // Возвращаем результат
-    return result;
+    // Сжатый текст разжимаем в кэш сеанса
+    if (const auto texts = m_activeTree->Texts()) {
+        return m_textCache.Get(*texts, currentNode->Index());
+    }
+    // Возвращаем значение текущего узла
+    return currentNode->Data();
+}
+
+/**
+ * Получение идентификатора текущего узла.
+ *
+ * \return Идентификатор текущего узла, либо -1,
+ * если экспертная система не загружена
+ */
+int ExpertSystem::GetCurrentID() const
+{
+    return currentNode ? currentNode->ID() : -1;
 }
 
 /**
@@ -104,29 +442,39 @@ std::string ExpertSystem::GetCurrentData() const
  */
 bool ExpertSystem::SetAnswer(const int value)
 {
-    // Результат. На данном этапе отрицательный
-    bool result = false;
-    // Если текущий узел - это вопрос,
-    if (currentNode->Type() == NodeType::Question) {
-        // кастуем к узлу, имеющим тип вопрос
-        auto question = dynamic_cast<Question*>(currentNode);
-        // Подаём ответ в узел в надежде получить указатель
-        // на следующий узел. Тут, собственно, и происходит
-        // переход экспертной системы в новое состояние.
-        auto nextNode = question->GetNext(value);
-        // Проверяем, что узел, соответствующий ответу найден.
-        // Если же узел не найден, значит был подан ответ,
-        // на который в экспертной системе не оказалось ответа.
-        if (nextNode) {
-            // Система перешла в новое состояние.
-            // Полученный узел становится текущим
-            currentNode = nextNode;
-            // Результат - положительный.
-            result = true;
-        }
+    // Если текущего узла нет, либо он не является вопросом,
+    // то ответ принять невозможно
+    if (!currentNode || currentNode->Type() != NodeType::Question) {
+        return false;
     }
-    // Возвращаем результат
-    return result;
+    // Тип узла уже проверен, поэтому кастуем к вопросу без dynamic_cast
+    auto question = static_cast<const Question*>(currentNode);
+    // Подаём ответ в узел в надежде получить индекс
+    // следующего узла. Тут, собственно, и происходит
+    // переход экспертной системы в новое состояние.
+    auto nextNode = m_activeTree->GetNode(question->GetNext(value));
+    // Записываем шаг в трассу
+    if (m_tracer) {
+        m_tracer->Record(m_sessionID, ++m_sequence,
+            nextNode ? question->Index() : question->Index() | kTraceRejected, question->ID(), value);
+    }
+    // Проверяем, что узел, соответствующий ответу найден.
+    // Если же узел не найден, значит был подан ответ,
+    // на который в экспертной системе не оказалось ответа.
+    if (!nextNode) {
+        return false;
+    }
+    // Система перешла в новое состояние.
+    // Полученный узел становится текущим
+    currentNode = nextNode;
+    m_path.Push(nextNode->Index());
+    // Записываем новую вершину пути в журнал сеансов
+    JournalStep();
+    // Если текущий узел это ответ,
+    // то выставляем флаг завершения работы системы
+    m_finished = currentNode->Type() == NodeType::Answer;
+    // Результат - положительный.
+    return true;
 }
 
 /**
@@ -146,10 +494,614 @@ bool ExpertSystem::IsFinished() const
  */
 void ExpertSystem::Reset()
 {
+    Rewind();
+    // Записываем сброс в трассу
+    if (m_tracer) {
+        m_tracer->Record(m_sessionID, ++m_sequence, kTraceReset, -1, 0);
+    }
+    // и в журнал сеансов
+    JournalStep();
+}
+
+/**
+ * Переход в начало дерева без записи в трассу и журнал.
+ *
+ * \return
+ */
+void ExpertSystem::Rewind() noexcept
+{
+    // Выбираем копию дерева, локальную для текущего процессора
+    const auto activeTree = m_replicas ? m_replicas->Local() : m_tree.get();
+    // Разжатые тексты другого дерева не подходят
+    if (activeTree != m_activeTree) {
+        m_textCache.Clear();
+        m_activeTree = activeTree;
+    }
     // Делаем текущим узлом корень дерева
-    currentNode = m_tree->GetRoot();
+    currentNode = m_activeTree ? m_activeTree->GetRoot() : nullptr;
+    m_path.Clear();
+    if (currentNode) {
+        m_path.Push(currentNode->Index());
+    }
     // Сбрасываем флаг завершения работы системы
     m_finished = false;
 }
 
+/**
+ * Проход по пути из текущего узла. Каждый узел пути должен быть
+ * потомком предыдущего в загруженном дереве.
+ *
+ * \param ids Идентификаторы узлов пути
+ * \param count Количество узлов
+ * \return true - если пройден весь путь
+ */
+bool ExpertSystem::Follow(
+    const int* ids,
+    const std::size_t count) noexcept
+{
+    std::size_t depth = 0;
+    for (; depth < count && currentNode && currentNode->Type() == NodeType::Question; ++depth) {
+        const auto& childrens = static_cast<const Question*>(currentNode)->GetChildrens();
+        const auto next = m_activeTree->FindNode(ids[depth]);
+        if (std::none_of(childrens.begin(), childrens.end(),
+            [next](const auto& child) { return child.first == next; })) {
+            break;
+        }
+        currentNode = m_activeTree->GetNode(next);
+        m_path.Push(next);
+    }
+    m_finished = currentNode && currentNode->Type() == NodeType::Answer;
+    return depth == count;
+}
+
+/**
+ * Возврат к предыдущему вопросу.
+ *
+ * \return true - если возврат выполнен
+ */
+bool ExpertSystem::Back()
+{
+    return m_path.Size() > 1 && BackTo(m_path.Size() - 2);
+}
+
+/**
+ * Возврат к вопросу на заданной глубине пути.
+ * Узлы пути хранятся индексами, поэтому возврат
+ * сводится к укорачиванию пути.
+ *
+ * \param depth Глубина вопроса
+ * \return true - если возврат выполнен
+ */
+bool ExpertSystem::BackTo(
+    const std::size_t depth)
+{
+    if (depth >= m_path.Size()) {
+        return false;
+    }
+    m_path.Truncate(depth + 1);
+    currentNode = m_activeTree->GetNode(m_path.Top());
+    // Все узлы пути, кроме последнего, - вопросы
+    m_finished = currentNode->Type() == NodeType::Answer;
+    // Записываем возврат в трассу
+    if (m_tracer) {
+        m_tracer->Record(m_sessionID, ++m_sequence, kTraceBack, -1, static_cast<std::int32_t>(depth));
+    }
+    // и в журнал сеансов
+    JournalStep();
+    return true;
+}
+
+/**
+ * Получение глубины текущего узла.
+ *
+ * \return Количество принятых ответов
+ */
+std::size_t ExpertSystem::GetDepth() const
+{
+    return m_path.Size() ? m_path.Size() - 1 : 0;
+}
+
+/**
+ * Получение идентификатора узла на пути сеанса.
+ *
+ * \param depth Глубина узла
+ * \return Идентификатор узла, либо -1
+ */
+int ExpertSystem::GetPathID(
+    const std::size_t depth) const
+{
+    return depth < m_path.Size() ? m_activeTree->GetNode(m_path[depth])->ID() : -1;
+}
+
+/**
+ * Получение количества оставшихся ответов.
+ *
+ * \return Количество ответов, достижимых из текущего узла
+ */
+std::size_t ExpertSystem::GetCandidatesCount() const
+{
+    return currentNode ? m_candidates->Get().Count(currentNode->Index()) : 0;
+}
+
+/**
+ * Проверка, можно ли ещё получить заданный ответ.
+ *
+ * \param answerID Идентификатор узла ответа
+ * \return true - если ответ достижим из текущего узла
+ */
+bool ExpertSystem::IsCandidate(
+    const int answerID) const
+{
+    return currentNode
+        && m_candidates->Get().Contains(currentNode->Index(), m_activeTree->FindNode(answerID));
+}
+
+/**
+ * Получение ответов, которые ещё можно получить.
+ *
+ * \return Идентификаторы узлов ответов в порядке индексов узлов
+ */
+std::vector<int> ExpertSystem::GetCandidates() const
+{
+    std::vector<int> result;
+    if (!currentNode) {
+        return result;
+    }
+    std::vector<node_index_t> answers;
+    m_candidates->Get().Collect(currentNode->Index(), answers);
+    result.reserve(answers.size());
+    for (const auto index : answers) {
+        result.push_back(m_activeTree->GetNode(index)->ID());
+    }
+    return result;
+}
+
+/**
+ * Получение наиболее вероятных оставшихся ответов.
+ * Достижимые ответы равновероятны, поэтому возвращаются
+ * первые из них в порядке индексов узлов.
+ *
+ * \param count Наибольшее количество ответов
+ * \return Ответы с равными вероятностями
+ */
+std::vector<ScoredCandidate> ExpertSystem::GetTopCandidates(
+    const std::size_t count) const
+{
+    const auto candidates = GetCandidates();
+    const auto limit = std::min(count, candidates.size());
+    std::vector<ScoredCandidate> top;
+    top.reserve(limit);
+    for (std::size_t i = 0; i < limit; ++i) {
+        top.push_back({ candidates[i], 1.0 / double(candidates.size()) });
+    }
+    return top;
+}
+
+/**
+ * Пересечение оставшихся ответов с заданным набором.
+ *
+ * \param answerIDs Идентификаторы узлов ответов
+ * \return Идентификаторы из набора, которые ещё можно получить
+ */
+std::vector<int> ExpertSystem::FilterCandidates(
+    const std::vector<int>& answerIDs) const
+{
+    std::vector<int> result;
+    for (const auto id : answerIDs) {
+        if (IsCandidate(id)) {
+            result.push_back(id);
+        }
+    }
+    return result;
+}
+
+/**
+ * Получение количества оставшихся ответов,
+ * которые достижимы также из заданного узла.
+ *
+ * \param nodeID Идентификатор узла
+ * \return Размер пересечения
+ */
+std::size_t ExpertSystem::GetCommonCandidatesCount(
+    const int nodeID) const
+{
+    if (!currentNode) {
+        return 0;
+    }
+    return m_candidates->Get().IntersectionCount(currentNode->Index(), m_activeTree->FindNode(nodeID));
+}
+
+/**
+ * Получение путей от начала дерева до заданного узла.
+ *
+ * \param nodeID Идентификатор узла
+ * \param limit Наибольшее количество путей, 0 - все пути
+ * \return Пути
+ */
+std::vector<std::vector<PathStep>> ExpertSystem::GetPathsTo(
+    const int nodeID,
+    const std::size_t limit) const
+{
+    std::vector<std::vector<PathStep>> result;
+    if (!m_activeTree) {
+        return result;
+    }
+    const auto paths = m_parents->Get().Paths(m_activeTree->FindNode(nodeID), limit);
+    result.reserve(paths.size());
+    for (const auto& path : paths) {
+        auto& steps = result.emplace_back();
+        steps.reserve(path.size());
+        for (const auto& step : path) {
+            steps.push_back({ m_activeTree->GetNode(step.question)->ID(), step.answer });
+        }
+    }
+    return result;
+}
+
+/**
+ * Получение кратчайшего пути от начала дерева до заданного узла.
+ *
+ * \param nodeID Идентификатор узла
+ * \return Вопросы и ответы на них
+ */
+std::vector<PathStep> ExpertSystem::GetShortestPathTo(
+    const int nodeID) const
+{
+    std::vector<PathStep> result;
+    ParentIndex::path_t path;
+    if (!m_activeTree || !m_parents->Get().ShortestPath(m_activeTree->FindNode(nodeID), path)) {
+        return result;
+    }
+    result.reserve(path.size());
+    for (const auto& step : path) {
+        result.push_back({ m_activeTree->GetNode(step.question)->ID(), step.answer });
+    }
+    return result;
+}
+
+/**
+ * Переход к заданному узлу по кратчайшему пути.
+ *
+ * \param nodeID Идентификатор узла
+ * \return true - если переход выполнен
+ */
+bool ExpertSystem::JumpTo(
+    const int nodeID)
+{
+    ParentIndex::path_t path;
+    if (!m_activeTree || !m_parents->Get().ShortestPath(m_activeTree->FindNode(nodeID), path)) {
+        return false;
+    }
+    Reset();
+    // Индекс содержит только соединения, по которым проходит ответ,
+    // поэтому ответы пути всегда принимаются
+    for (const auto& step : path) {
+        SetAnswer(step.answer);
+    }
+    return true;
+}
+
+/**
+ * Восстановление пути сеанса по идентификаторам узлов.
+ *
+ * \param path Идентификаторы узлов пути после начала дерева
+ * \return true - если пройден весь путь
+ */
+bool ExpertSystem::RestorePath(
+    const std::vector<int>& path)
+{
+    Rewind();
+    const auto followed = Follow(path.data(), path.size());
+    JournalPath();
+    return followed;
+}
+
+/**
+ * Поиск вопросов и ответов по тексту.
+ *
+ * \param query Запрос
+ * \param limit Наибольшее количество результатов
+ * \return Найденные узлы по убыванию релевантности
+ */
+std::vector<SearchHit> ExpertSystem::Search(
+    const std::string& query,
+    const std::size_t limit) const
+{
+    std::vector<SearchHit> hits;
+    if (!m_search) {
+        return hits;
+    }
+    for (const auto& hit : m_search->Get().Search(query, limit)) {
+        hits.push_back({ m_tree->GetNode(hit.node)->ID(), hit.score });
+    }
+    return hits;
+}
+
+/**
+ * Создание сеанса, разделяющего дерево и тексты
+ * с текущей экспертной системой.
+ *
+ * \return Новый сеанс в начальном состоянии
+ */
+std::unique_ptr<ExpertSystem> ExpertSystem::NewSession() const
+{
+    auto session = std::make_unique<ExpertSystem>();
+    session->m_tree = m_tree;
+    session->m_candidates = m_candidates;
+    session->m_parents = m_parents;
+    session->m_search = m_search;
+    session->m_replicas = m_replicas;
+    session->m_replication = m_replication;
+    session->m_memoryBudget = m_memoryBudget;
+    session->m_validation = m_validation;
+    session->m_validationReport = m_validationReport;
+    session->m_name = m_name;
+    session->SetTextCompression(m_textCompression);
+    session->m_languages = m_languages;
+    session->m_languageTexts = m_languageTexts;
+    session->Reset();
+    session->m_tracer = m_tracer;
+    session->m_journal = m_journal;
+    return session;
+}
+
+/**
+ * Создание нового сеанса работы с загруженной экспертной системой.
+ * Новый сеанс разделяет дерево с текущей экспертной системой
+ * и использует тот же язык текстов.
+ *
+ * \return Новый сеанс в начальном состоянии
+ */
+std::unique_ptr<IExpertSystem> ExpertSystem::CreateSession() const
+{
+    auto session = NewSession();
+    session->JournalPath();
+    return session;
+}
+
+/**
+ * Создание нового сеанса с текстами на заданном языке.
+ * Тексты языка загружаются при первом обращении к нему.
+ *
+ * \param language Код языка, либо пустая строка для основного языка
+ * \return Новый сеанс в начальном состоянии
+ */
+std::unique_ptr<IExpertSystem> ExpertSystem::CreateSession(
+    const std::string& language) const noexcept(false)
+{
+    auto session = NewSession();
+    session->JournalPath();
+    if (language.empty()) {
+        session->m_languageTexts.reset();
+        return session;
+    }
+    if (!m_languages) {
+        throw std::runtime_error(u8"Экспертная система не загружена");
+    }
+    auto texts = m_languages->Get(language);
+    session->m_languageTexts = std::move(texts.texts);
+    if (!texts.name.empty()) {
+        session->m_name = std::move(texts.name);
+    }
+    return session;
+}
+
+/**
+ * Получение дополнительных языков.
+ *
+ * \return Коды языков
+ */
+std::vector<std::string> ExpertSystem::GetLanguages() const
+{
+    return m_languages ? m_languages->Codes() : std::vector<std::string>();
+}
+
+/**
+ * Подключение записи трассы.
+ *
+ * \param recorder Запись трассы, либо nullptr для отключения записи
+ * \return
+ */
+void ExpertSystem::SetTraceRecorder(
+    std::shared_ptr<ITraceRecorder> recorder)
+{
+    // Записи пишутся прямо в буферы TraceRecorder, другие реализации
+    // интерфейса не поддерживаются
+    auto tracer = std::dynamic_pointer_cast<TraceRecorder>(recorder);
+    if (recorder && !tracer) {
+        throw std::invalid_argument(u8"Запись трассы должна быть создана CreateTraceRecorder");
+    }
+    m_tracer = std::move(tracer);
+}
+
+/**
+ * Настройка репликации дерева.
+ *
+ * \param options Параметры репликации
+ * \return
+ */
+void ExpertSystem::SetReplication(
+    const ReplicationOptions& options) noexcept(false)
+{
+    m_replication = options;
+    // Копируем уже загруженное дерево
+    if (m_tree) {
+        m_replicas = m_replication.mode != ReplicationMode::None
+            ? std::make_shared<ReplicaSet>(m_tree, m_replication)
+            : nullptr;
+        Reset();
+    }
+}
+
+/**
+ * Получение количества копий загруженного дерева.
+ *
+ * \return Количество копий
+ */
+std::size_t ExpertSystem::GetReplicasCount() const
+{
+    return m_replicas ? m_replicas->Count() : 1;
+}
+
+/**
+ * Настройка хранения текстов узлов.
+ *
+ * \param options Параметры хранения текстов
+ * \return
+ */
+void ExpertSystem::SetTextCompression(
+    const TextCompressionOptions& options)
+{
+    m_textCompression = options;
+    m_textCache.Resize(options.cacheSize);
+}
+
+/**
+ * Получение идентификатора сеанса.
+ *
+ * \return Идентификатор сеанса
+ */
+std::uint64_t ExpertSystem::GetSessionID() const
+{
+    return m_sessionID;
+}
+
+/**
+ * Подключение журнала сеансов.
+ *
+ * \param journal Журнал сеансов, либо nullptr для отключения журнала
+ * \return
+ */
+void ExpertSystem::SetSessionJournal(
+    std::shared_ptr<ISessionJournal> journal)
+{
+    // Переходы пишутся прямо в буферы SessionJournal, другие реализации
+    // интерфейса не поддерживаются
+    auto sessionJournal = std::dynamic_pointer_cast<SessionJournal>(journal);
+    if (journal && !sessionJournal) {
+        throw std::invalid_argument(u8"Журнал сеансов должен быть создан OpenSessionJournal");
+    }
+    // Сеанс завершается в прежнем журнале
+    if (m_journal && m_journal != sessionJournal) {
+        m_journal->Record(m_sessionID, ++m_sequence, JournalRecordType::Close, 0, 0);
+    }
+    m_journal = std::move(sessionJournal);
+    JournalPath();
+}
+
+/**
+ * Продолжение сеанса, сохранённого в журнале.
+ *
+ * \param sessionID Идентификатор сеанса
+ * \return Сеанс, либо nullptr
+ */
+std::unique_ptr<IExpertSystem> ExpertSystem::ResumeSession(
+    const std::uint64_t sessionID) const
+{
+    return m_journal ? ResumeSession(m_journal, sessionID) : nullptr;
+}
+
+/**
+ * Продолжение сеанса, сохранённого в заданном журнале.
+ *
+ * \param journal Журнал сеансов
+ * \param sessionID Идентификатор сеанса
+ * \return Сеанс, либо nullptr
+ */
+std::unique_ptr<IExpertSystem> ExpertSystem::ResumeSession(
+    std::shared_ptr<ISessionJournal> journal,
+    const std::uint64_t sessionID) const
+{
+    auto sessionJournal = std::dynamic_pointer_cast<SessionJournal>(journal);
+    if (!sessionJournal) {
+        throw std::invalid_argument(u8"Журнал сеансов должен быть создан OpenSessionJournal");
+    }
+    std::vector<int> path;
+    std::uint32_t sequence = 0;
+    if (!m_activeTree || !sessionJournal->Find(sessionID, path, sequence)) {
+        return nullptr;
+    }
+    auto session = NewSession();
+    session->m_journal = std::move(sessionJournal);
+    session->m_sessionID = sessionID;
+    session->m_sequence = sequence;
+    // Проходим сохранённый путь. Путь начинается с корня
+    // и продолжается по соединениям, существующим в загруженном дереве
+    if (path.size() > 1) {
+        session->Follow(path.data() + 1, path.size() - 1);
+    }
+    // Переписываем путь: он мог стать короче сохранённого
+    session->JournalPath();
+    return session;
+}
+
+/**
+ * Запись всего пути в журнал сеансов.
+ * Запись каждой глубины получает новый номер перехода,
+ * поэтому заменяет все прежние записи сеанса.
+ *
+ * \return
+ */
+void ExpertSystem::JournalPath() noexcept
+{
+    if (!m_journal || !m_activeTree) {
+        return;
+    }
+    for (std::size_t depth = 0; depth < m_path.Size(); ++depth) {
+        m_journal->Record(m_sessionID, ++m_sequence, JournalRecordType::Step,
+            static_cast<std::uint16_t>(depth), m_activeTree->GetNode(m_path[depth])->ID());
+    }
+}
+
+/**
+ * Настройка бюджета памяти базы знаний.
+ *
+ * \param options Параметры бюджета
+ * \return
+ */
+void ExpertSystem::SetMemoryBudget(
+    const MemoryBudgetOptions& options)
+{
+    m_memoryBudget = options;
+}
+
+/**
+ * Получение памяти, занятой загруженной базой знаний.
+ *
+ * \return Память по категориям
+ */
+MemoryReport ExpertSystem::GetMemoryReport() const
+{
+    if (!m_tree) {
+        return {};
+    }
+    auto report = CountMemory(*m_tree, m_candidates->Built(), m_parents->Built(), m_search->Built());
+    if (m_replicas) {
+        report.replicas = m_replicas->MemoryBytes();
+    }
+    return report;
+}
+
+/**
+ * Установка параметров проверки графа.
+ *
+ * \param options Параметры проверки
+ * \return
+ */
+void ExpertSystem::SetValidation(
+    const ValidationOptions& options)
+{
+    m_validation = options;
+}
+
+/**
+ * Получение отчёта о проверке графа загруженной базы знаний.
+ *
+ * \return Отчёт, пустой, если база знаний не загружена
+ */
+ValidationReport ExpertSystem::GetValidationReport() const
+{
+    return m_validationReport ? *m_validationReport : ValidationReport();
+}
+
 }
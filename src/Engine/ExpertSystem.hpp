@@ -3,10 +3,22 @@
 #include "IExpertSystem.hpp"
 
 #include "Tree.hpp"
+#include "TraceRecorder.hpp"
+#include "ReplicaSet.hpp"
+#include "TextCache.hpp"
+#include "LanguageSet.hpp"
+#include "PathStack.hpp"
+#include "CandidateIndex.hpp"
+#include "ParentIndex.hpp"
+#include "SearchIndex.hpp"
+#include "LazyIndex.hpp"
+#include "SessionJournal.hpp"
 
 namespace ES
 {
 
+class IExpertSystemLoader;
+
 /**
  * Реализация экспертной системы.
  * Работа экспертной системы сводится к
@@ -24,7 +36,9 @@ public:
 
     std::string GetName() const override;
 
-    std::string GetCurrentData() const override;
+    std::string_view GetCurrentData() const override;
+
+    int GetCurrentID() const override;
 
     bool SetAnswer(
         const int value) override;
@@ -32,18 +46,218 @@ public:
     bool IsFinished() const override;
 
     void Reset() override;
+
+    bool Back() override;
+
+    bool BackTo(
+        const std::size_t depth) override;
+
+    std::size_t GetDepth() const override;
+
+    int GetPathID(
+        const std::size_t depth) const override;
+
+    std::size_t GetCandidatesCount() const override;
+
+    bool IsCandidate(
+        const int answerID) const override;
+
+    std::vector<int> GetCandidates() const override;
+
+    std::vector<int> FilterCandidates(
+        const std::vector<int>& answerIDs) const override;
+
+    std::vector<ScoredCandidate> GetTopCandidates(
+        const std::size_t count) const override;
+
+    std::size_t GetCommonCandidatesCount(
+        const int nodeID) const override;
+
+    std::vector<std::vector<PathStep>> GetPathsTo(
+        const int nodeID,
+        const std::size_t limit) const override;
+
+    std::vector<PathStep> GetShortestPathTo(
+        const int nodeID) const override;
+
+    bool JumpTo(
+        const int nodeID) override;
+
+    bool RestorePath(
+        const std::vector<int>& path) override;
+
+    std::vector<SearchHit> Search(
+        const std::string& query,
+        const std::size_t limit) const override;
+
+    std::unique_ptr<IExpertSystem> CreateSession() const override;
+
+    std::unique_ptr<IExpertSystem> CreateSession(
+        const std::string& language) const noexcept(false) override;
+
+    std::vector<std::string> GetLanguages() const override;
+
+    void SetTraceRecorder(
+        std::shared_ptr<ITraceRecorder> recorder) override;
+
+    void SetReplication(
+        const ReplicationOptions& options) noexcept(false) override;
+
+    std::size_t GetReplicasCount() const override;
+
+    void SetTextCompression(
+        const TextCompressionOptions& options) override;
+
+    std::uint64_t GetSessionID() const override;
+
+    void SetSessionJournal(
+        std::shared_ptr<ISessionJournal> journal) override;
+
+    std::unique_ptr<IExpertSystem> ResumeSession(
+        const std::uint64_t sessionID) const override;
+
+    std::unique_ptr<IExpertSystem> ResumeSession(
+        std::shared_ptr<ISessionJournal> journal,
+        const std::uint64_t sessionID) const override;
+
+    void SetMemoryBudget(
+        const MemoryBudgetOptions& options) override;
+
+    MemoryReport GetMemoryReport() const override;
+
+    void SetValidation(
+        const ValidationOptions& options) override;
+
+    ValidationReport GetValidationReport() const override;
+
+    /**
+     * Конструктор. Назначает сеансу уникальный идентификатор.
+     */
+    ExpertSystem() noexcept;
+
+    /**
+     * Деструктор. Завершает сеанс в журнале сеансов.
+     */
+    ~ExpertSystem();
 private:
-    // Дерево
-    std::unique_ptr<Tree> m_tree;
+    // Количество областей памяти, после которого новая
+    // версия дерева строится заново в одной области
+    static constexpr std::size_t kMaxTreeArenas = 8;
+
+    /**
+     * Построение дерева по конфигурации.
+     *
+     * \param loader Загрузчик
+     * \param configPath Путь к конфигурации
+     * \param compression Параметры хранения текстов
+     * \param limit Лимит памяти дерева в байтах
+     * \param derived Признак версии, построенной из прежнего дерева
+     * \return Дерево. Если лимит превышен, то дерево построено не полностью
+     */
+    std::shared_ptr<Tree> BuildTree(
+        IExpertSystemLoader& loader,
+        const std::string& configPath,
+        const TextCompressionOptions& compression,
+        const std::size_t limit,
+        bool& derived) const noexcept(false);
+
+    /**
+     * Создание сеанса, разделяющего дерево и тексты
+     * с текущей экспертной системой.
+     *
+     * \return Новый сеанс в начальном состоянии
+     */
+    std::unique_ptr<ExpertSystem> NewSession() const;
+
+    /**
+     * Переход в начало дерева без записи в трассу и журнал.
+     *
+     * \return
+     */
+    void Rewind() noexcept;
+
+    /**
+     * Проход по пути из текущего узла по соединениям дерева.
+     *
+     * \param ids Идентификаторы узлов пути
+     * \param count Количество узлов
+     * \return true - если пройден весь путь
+     */
+    bool Follow(
+        const int* ids,
+        const std::size_t count) noexcept;
+
+    /**
+     * Запись вершины пути в журнал сеансов.
+     *
+     * \return
+     */
+    void JournalStep() noexcept
+    {
+        if (m_journal && currentNode) {
+            m_journal->Record(m_sessionID, ++m_sequence, JournalRecordType::Step,
+                static_cast<std::uint16_t>(m_path.Size() - 1), currentNode->ID());
+        }
+    }
+
+    /**
+     * Запись всего пути в журнал сеансов.
+     *
+     * \return
+     */
+    void JournalPath() noexcept;
+
+    // Дерево. Разделяется между всеми сеансами,
+    // созданными из данной экспертной системы
+    std::shared_ptr<const Tree> m_tree;
+    // Ответы, достижимые из каждого узла дерева.
+    // Индексы узлов в копиях совпадают, поэтому множества общие
+    std::shared_ptr<const LazyIndex<CandidateIndex>> m_candidates;
+    // Обратные соединения дерева
+    std::shared_ptr<const LazyIndex<ParentIndex>> m_parents;
+    // Полнотекстовый индекс по текстам узлов
+    std::shared_ptr<const LazyIndex<SearchIndex>> m_search;
+    // Копии дерева (если включена репликация)
+    std::shared_ptr<const ReplicaSet> m_replicas;
+    // Параметры репликации
+    ReplicationOptions m_replication;
+    // Бюджет памяти базы знаний
+    MemoryBudgetOptions m_memoryBudget;
+    // Параметры проверки графа
+    ValidationOptions m_validation;
+    // Отчёт о проверке графа загруженной базы знаний
+    std::shared_ptr<const ValidationReport> m_validationReport;
+    // Дерево, по которому идёт текущий сеанс:
+    // исходное дерево либо его локальная копия
+    const Tree* m_activeTree = nullptr;
     // Имя экспертной системы
     std::string m_name;
     // Текущий узел дерева
-    mutable BasicNode* currentNode = nullptr;
+    BasicNode* currentNode = nullptr;
+    // Путь от корня до текущего узла
+    PathStack m_path;
     // Флаг, показывающий окончание работы экспертной системы.
     // Флаг будет выставлен, когда в процессе движения по дереву
-    // текущий узел будет соответствовать узлу с типом "Ответ",
-    // либо в ответ не будет найден в экспертной системе.
-    mutable bool m_finished = false;
+    // текущий узел будет соответствовать узлу с типом "Ответ".
+    bool m_finished = false;
+    // Уникальный идентификатор сеанса для трассы и журнала
+    std::uint64_t m_sessionID;
+    // Запись трассы
+    std::shared_ptr<TraceRecorder> m_tracer;
+    // Журнал сеансов
+    std::shared_ptr<SessionJournal> m_journal;
+    // Номер последнего шага сеанса, записанного в журнал либо трассу.
+    // Продолженный сеанс продолжает нумерацию журнала, поэтому его
+    // шаги в трассе идут после шагов до перезапуска
+    std::uint32_t m_sequence = 0;
+    // Параметры хранения текстов узлов
+    TextCompressionOptions m_textCompression;
+    // Разжатые тексты узлов, показанные в текущем сеансе
+    mutable TextCache m_textCache;
+    // Дополнительные языки загруженной экспертной системы
+    std::shared_ptr<LanguageSet> m_languages;
+    // Тексты на языке сеанса, либо nullptr для основного языка
+    std::shared_ptr<const TextStore> m_languageTexts;
 };
 
 }
@@ -0,0 +1,260 @@
+﻿#include "GraphValidator.hpp"
+
+#include "Tree.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <thread>
+#include <vector>
+
+namespace ES
+{
+
+namespace
+{
+
+// Количество узлов, начиная с которого проверка идёт в нескольких потоках
+constexpr std::size_t kMinNodesPerThread = std::size_t(1) << 16;
+
+/**
+ * Добавление ошибок одного отчёта в другой.
+ *
+ * \param report Отчёт, в который добавляются ошибки
+ * \param part Добавляемый отчёт
+ * \return
+ */
+void MergeReport(
+    ValidationReport& report,
+    const ValidationReport& part)
+{
+    for (std::size_t issue = 0; issue < kValidationIssues; ++issue) {
+        auto& to = report.issues[issue];
+        const auto& from = part.issues[issue];
+        to.count += from.count;
+        for (std::size_t i = 0; i < from.samples.size()
+            && to.samples.size() < ValidationReport::kMaxSamples; ++i) {
+            to.samples.push_back(from.samples[i]);
+        }
+    }
+    report.total += part.total;
+    report.nodes += part.nodes;
+    report.connections += part.connections;
+}
+
+/**
+ * Проверка соединений части узлов дерева.
+ *
+ * \param tree Дерево
+ * \param begin Индекс первого узла
+ * \param end Индекс за последним узлом
+ * \param overlaps Признаки вопросов с повторяющимися значениями ответа
+ * \return Отчёт о части узлов
+ */
+ValidationReport ValidateNodes(
+    const Tree& tree,
+    const std::size_t begin,
+    const std::size_t end,
+    std::vector<std::uint8_t>& overlaps)
+{
+    ValidationReport report;
+    std::vector<int> values;
+    for (std::size_t index = begin; index < end; ++index) {
+        const auto node = tree.GetNode(static_cast<node_index_t>(index));
+        if (!node) {
+            continue;
+        }
+        ++report.nodes;
+        if (node->Type() != NodeType::Question) {
+            continue;
+        }
+        const auto& childrens = static_cast<const Question*>(node)->GetChildrens();
+        report.connections += childrens.size();
+        if (childrens.empty()) {
+            AddIssue(report, ValidationIssue::DeadEnd, node->ID());
+            continue;
+        }
+        values.clear();
+        for (const auto& [child, predicat] : childrens) {
+            if (!tree.GetNode(child)) {
+                AddIssue(report, ValidationIssue::MissingNode, node->ID());
+            }
+            values.push_back(predicat.value);
+        }
+        std::sort(values.begin(), values.end());
+        for (std::size_t i = 1; i < values.size(); ++i) {
+            if (values[i] == values[i - 1]) {
+                AddIssue(report, ValidationIssue::OverlappingPredicates, node->ID());
+                overlaps[index] = true;
+            }
+        }
+    }
+    return report;
+}
+
+}
+
+/**
+ * Получение названия вида ошибки в графе.
+ *
+ * \param issue Вид ошибки
+ * \return Название
+ */
+const char* GetValidationIssueName(
+    const ValidationIssue issue) noexcept
+{
+    switch (issue) {
+    case ValidationIssue::MissingNode:
+        return u8"несуществующие узлы";
+    case ValidationIssue::AnswerSource:
+        return u8"соединения из ответов";
+    case ValidationIssue::DuplicateNode:
+        return u8"повторяющиеся узлы";
+    case ValidationIssue::DeadEnd:
+        return u8"вопросы без соединений";
+    case ValidationIssue::OverlappingPredicates:
+        return u8"повторяющиеся ответы";
+    case ValidationIssue::Unreachable:
+        return u8"недостижимые узлы";
+    case ValidationIssue::Cycle:
+        return u8"циклы";
+    case ValidationIssue::InvalidProbability:
+        return u8"неверные вероятности";
+    }
+    return u8"неизвестные ошибки";
+}
+
+/**
+ * Добавление ошибки в отчёт о проверке графа.
+ *
+ * \param report Отчёт
+ * \param issue Вид ошибки
+ * \param id Идентификатор узла
+ * \return
+ */
+void AddIssue(
+    ValidationReport& report,
+    const ValidationIssue issue,
+    const node_id_t id) noexcept
+{
+    auto& issues = report.issues[static_cast<std::size_t>(issue)];
+    ++issues.count;
+    ++report.total;
+    if (issues.samples.size() < ValidationReport::kMaxSamples) {
+        // Место под примеры выделяется сразу целиком
+        issues.samples.reserve(ValidationReport::kMaxSamples);
+        issues.samples.push_back(id);
+    }
+}
+
+/**
+ * Проверка графа дерева за O(V+E).
+ * Каждый поток проверяет свою часть хранилища узлов,
+ * отчёты частей объединяются по порядку, поэтому примеры
+ * ошибок не зависят от количества потоков.
+ *
+ * \param tree Дерево
+ * \param options Параметры проверки
+ * \return Отчёт о проверке
+ */
+ValidationReport ValidateTree(
+    const Tree& tree,
+    const ValidationOptions& options)
+{
+    const auto start = std::chrono::steady_clock::now();
+    const auto count = tree.NodesCount();
+    auto report = tree.Issues();
+
+    // Проверка соединений каждого вопроса по частям хранилища
+    const auto threads = std::max<std::size_t>(1, std::min(
+        options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency()),
+        count / kMinNodesPerThread));
+    std::vector<std::uint8_t> overlaps(count, false);
+    std::vector<ValidationReport> parts(threads);
+    std::vector<std::exception_ptr> errors(threads);
+    std::vector<std::thread> workers;
+    for (std::size_t part = 1; part < threads; ++part) {
+        workers.emplace_back([&, part]
+        {
+            try {
+                parts[part] = ValidateNodes(tree,
+                    count * part / threads, count * (part + 1) / threads, overlaps);
+            }
+            catch (...) {
+                errors[part] = std::current_exception();
+            }
+        });
+    }
+    parts[0] = ValidateNodes(tree, 0, count / threads, overlaps);
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    for (const auto& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+    for (const auto& part : parts) {
+        MergeReport(report, part);
+    }
+
+    // Обход в глубину по проходимым соединениям.
+    // 0 - узел не посещён, 1 - узел на пути обхода, 2 - узел пройден
+    std::vector<std::uint8_t> colors(count, 0);
+    struct Frame
+    {
+        node_index_t index;
+        std::size_t next;
+    };
+    std::vector<Frame> stack;
+    const auto visit = [&](const node_index_t from)
+    {
+        colors[from] = 1;
+        stack.push_back({ from, 0 });
+        while (!stack.empty()) {
+            auto& top = stack.back();
+            const auto node = tree.GetNode(top.index);
+            if (node->Type() == NodeType::Question) {
+                const auto& question = *static_cast<const Question*>(node);
+                const auto& childrens = question.GetChildrens();
+                if (top.next < childrens.size()) {
+                    const auto [child, predicat] = childrens[top.next++];
+                    if (!tree.GetNode(child)
+                        || (overlaps[top.index] && question.GetNext(predicat.value) != child)) {
+                        continue;
+                    }
+                    if (colors[child] == 1) {
+                        AddIssue(report, ValidationIssue::Cycle, node->ID());
+                    }
+                    else if (colors[child] == 0) {
+                        colors[child] = 1;
+                        stack.push_back({ child, 0 });
+                    }
+                    continue;
+                }
+            }
+            colors[top.index] = 2;
+            stack.pop_back();
+        }
+    };
+    if (const auto root = tree.GetRoot()) {
+        visit(root->Index());
+    }
+    for (std::size_t index = 0; index < count; ++index) {
+        const auto node = tree.GetNode(static_cast<node_index_t>(index));
+        if (node && !colors[index]) {
+            AddIssue(report, ValidationIssue::Unreachable, node->ID());
+        }
+    }
+    // Циклы среди недостижимых узлов тоже ошибка конфигурации
+    for (std::size_t index = 0; index < count; ++index) {
+        if (!colors[index] && tree.GetNode(static_cast<node_index_t>(index))) {
+            visit(static_cast<node_index_t>(index));
+        }
+    }
+    report.milliseconds = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+    return report;
+}
+
+}
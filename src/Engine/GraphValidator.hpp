@@ -0,0 +1,43 @@
+﻿#pragma once
+
+#include "IExpertSystem.hpp"
+
+#include "Types.hpp"
+
+namespace ES
+{
+
+class Tree;
+
+/**
+ * Добавление ошибки в отчёт о проверке графа.
+ * Сохраняются только первые ValidationReport::kMaxSamples примеров.
+ *
+ * \param report Отчёт
+ * \param issue Вид ошибки
+ * \param id Идентификатор узла
+ * \return
+ */
+void AddIssue(
+    ValidationReport& report,
+    const ValidationIssue issue,
+    const node_id_t id) noexcept;
+
+/**
+ * Проверка графа дерева за O(V+E).
+ * Вопросы без соединений и соединения с повторяющимися значениями
+ * ответа ищутся параллельно по частям хранилища узлов, затем
+ * обход в глубину от корня находит циклы и недостижимые узлы.
+ * Проходимыми считаются только соединения, по которым можно пройти
+ * ответом: первое соединение вопроса с данным значением ответа.
+ * В отчёт добавляются и ошибки, найденные деревом при загрузке.
+ *
+ * \param tree Дерево
+ * \param options Параметры проверки
+ * \return Отчёт о проверке
+ */
+ValidationReport ValidateTree(
+    const Tree& tree,
+    const ValidationOptions& options);
+
+}
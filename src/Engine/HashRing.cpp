@@ -0,0 +1,85 @@
+﻿#include "HashRing.hpp"
+
+#include <algorithm>
+
+namespace ES
+{
+
+/**
+ * Перемешивание битов ключа (splitmix64).
+ *
+ * \param key Ключ
+ * \return Хеш
+ */
+static std::uint64_t Mix(
+    std::uint64_t key) noexcept
+{
+    key += 0x9E3779B97F4A7C15ull;
+    key = (key ^ (key >> 30)) * 0xBF58476D1CE4E5B9ull;
+    key = (key ^ (key >> 27)) * 0x94D049BB133111EBull;
+    return key ^ (key >> 31);
+}
+
+/**
+ * Конструктор пустого кольца.
+ *
+ * \param virtualNodes Количество точек каждого шарда
+ */
+HashRing::HashRing(
+    const std::size_t virtualNodes) noexcept:
+    m_virtualNodes(virtualNodes ? virtualNodes : 1)
+{
+}
+
+/**
+ * Добавление шарда.
+ *
+ * \param shard Номер шарда, которого нет на кольце
+ * \return
+ */
+void HashRing::Add(
+    const std::uint32_t shard)
+{
+    // Точки шарда не зависят от порядка добавления шардов. Номер шарда
+    // перемешивается заранее, иначе точки шарда 0 совпали бы с хешами
+    // ключей 0, 1, 2, ...
+    const auto seed = Mix(shard);
+    m_points.reserve(m_points.size() + m_virtualNodes);
+    for (std::size_t i = 0; i < m_virtualNodes; ++i) {
+        m_points.push_back({ Mix(seed + i), shard });
+    }
+    std::sort(m_points.begin(), m_points.end(), [](const Point& a, const Point& b) {
+        return a.hash < b.hash || (a.hash == b.hash && a.shard < b.shard);
+    });
+}
+
+/**
+ * Удаление шарда.
+ *
+ * \param shard Номер шарда
+ * \return
+ */
+void HashRing::Remove(
+    const std::uint32_t shard) noexcept
+{
+    m_points.erase(std::remove_if(m_points.begin(), m_points.end(),
+        [shard](const Point& point) { return point.shard == shard; }), m_points.end());
+}
+
+/**
+ * Поиск шарда, которому принадлежит ключ.
+ *
+ * \param key Ключ
+ * \return Номер шарда. Кольцо не должно быть пустым
+ */
+std::uint32_t HashRing::Find(
+    const std::uint64_t key) const noexcept
+{
+    const auto hash = Mix(key);
+    const auto it = std::lower_bound(m_points.begin(), m_points.end(), hash,
+        [](const Point& point, const std::uint64_t value) { return point.hash < value; });
+    // За последней точкой кольцо замыкается на первую
+    return it == m_points.end() ? m_points.front().shard : it->shard;
+}
+
+}
@@ -0,0 +1,94 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ES
+{
+
+/**
+ * Кольцо согласованного хеширования.
+ * Каждый шард занимает на кольце несколько точек, и ключ принадлежит
+ * шарду первой точки, следующей за хешем ключа. Добавление шарда
+ * отбирает у остальных примерно 1/N ключей, удаление отдаёт
+ * остальным только ключи удалённого шарда. Точки зависят только
+ * от номера шарда, поэтому одинаковые наборы шардов дают одинаковое
+ * кольцо в любом процессе.
+ */
+class HashRing final
+{
+public:
+    /**
+     * Конструктор пустого кольца.
+     *
+     * \param virtualNodes Количество точек каждого шарда
+     */
+    explicit HashRing(
+        const std::size_t virtualNodes) noexcept;
+
+    /**
+     * Добавление шарда.
+     *
+     * \param shard Номер шарда, которого нет на кольце
+     * \return
+     */
+    void Add(
+        const std::uint32_t shard);
+
+    /**
+     * Удаление шарда.
+     *
+     * \param shard Номер шарда
+     * \return
+     */
+    void Remove(
+        const std::uint32_t shard) noexcept;
+
+    /**
+     * Поиск шарда, которому принадлежит ключ.
+     *
+     * \param key Ключ
+     * \return Номер шарда. Кольцо не должно быть пустым
+     */
+    std::uint32_t Find(
+        const std::uint64_t key) const noexcept;
+
+    /**
+     * Получение количества шардов.
+     *
+     * \return Количество шардов
+     */
+    std::size_t Size() const noexcept
+    {
+        return m_points.size() / m_virtualNodes;
+    }
+
+    /**
+     * Получение количества точек каждого шарда.
+     *
+     * \return Количество точек
+     */
+    std::size_t VirtualNodes() const noexcept
+    {
+        return m_virtualNodes;
+    }
+private:
+    /**
+     * Точка шарда на кольце.
+     */
+    struct Point
+    {
+        // Положение на кольце
+        std::uint64_t hash;
+        // Номер шарда
+        std::uint32_t shard;
+    };
+
+    // Количество точек каждого шарда
+    std::size_t m_virtualNodes;
+    // Точки в порядке положения на кольце
+    std::vector<Point> m_points;
+};
+
+}
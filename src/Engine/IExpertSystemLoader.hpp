@@ -1,8 +1,9 @@
 ﻿#pragma once
 
-#include "Types.hpp"
+#include "ITreeBuilder.hpp"
+#include "ITextsBuilder.hpp"
 
-#include <vector>
+#include <map>
 #include <memory>
 #include <string>
 
@@ -19,44 +20,45 @@ public:
 
     /**
      * Загрузка экспертной системы из файла конфигурации.
+     * Считанные узлы и соединения передаются в построитель дерева
+     * по мере разбора конфигурации: сначала все вопросы и ответы,
+     * затем все соединения.
      * 
      * \param configPath путь к файлу конфигурации
+     * \param builder Построитель дерева, принимающий загруженные данные
      * \return 
      */
     virtual void Load(
-        const std::string& configPath) noexcept(false) = 0;
+        const std::string& configPath,
+        ITreeBuilder& builder) noexcept(false) = 0;
 
     /**
-     * Получение имени экспертной системы.
-     * Перед вызовом данного метода экспертная система должна быть загружена.
-     * 
-     * \return Имя экспертной системы
-     */
-    virtual std::string GetName() const noexcept = 0;
-
-    /**
-     * Получение загруженных вопросов.
-     * Перед вызовом данного метода экспертная система должна быть загружена.
-     * 
-     * \return Загруженные вопросы
+     * Загрузка текстов узлов на дополнительном языке.
+     * После загрузки GetName возвращает имя экспертной системы на этом языке.
+     *
+     * \param textsPath Путь к файлу языка
+     * \param builder Построитель столбца текстов
+     * \return
      */
-    virtual std::vector<NodeConfig> GetQuestions() const noexcept = 0;
+    virtual void LoadTexts(
+        const std::string& textsPath,
+        ITextsBuilder& builder) noexcept(false) = 0;
 
     /**
-     * Получение загруженных ответов.
+     * Получение имени экспертной системы.
      * Перед вызовом данного метода экспертная система должна быть загружена.
      * 
-     * \return Загруженные ответы
+     * \return Имя экспертной системы
      */
-    virtual std::vector<NodeConfig> GetAnswers() const noexcept = 0;
+    virtual std::string GetName() const noexcept = 0;
 
     /**
-     * Получение загруженных соединений узлов.
+     * Получение дополнительных языков, перечисленных в конфигурации.
      * Перед вызовом данного метода экспертная система должна быть загружена.
-     * 
-     * \return Загруженные соединения узлов
+     *
+     * \return Ключ - код языка, значение - путь к файлу языка
      */
-    virtual std::vector<ConnectionConfig> GetConnections() const noexcept = 0;
+    virtual std::map<std::string, std::string> GetLanguages() const noexcept = 0;
 };
 
 /**
@@ -0,0 +1,40 @@
+﻿#pragma once
+
+#include "Types.hpp"
+
+#include <cstddef>
+
+namespace ES
+{
+
+/**
+ * Интерфейс построителя столбца текстов на одном языке.
+ * Загрузчик передаёт в построитель переводы текстов узлов
+ * по мере разбора файла языка. Структура дерева при этом
+ * не загружается: узлы сопоставляются по идентификаторам.
+ */
+class ITextsBuilder
+{
+public:
+    virtual ~ITextsBuilder() = default;
+
+    /**
+     * Резервирование места под тексты.
+     *
+     * \param texts Количество текстов
+     * \return
+     */
+    virtual void Reserve(
+        const std::size_t texts) noexcept = 0;
+
+    /**
+     * Добавление текста узла.
+     *
+     * \param text Идентификатор узла и текст на языке столбца
+     * \return
+     */
+    virtual void AddText(
+        NodeConfig&& text) noexcept = 0;
+};
+
+}
@@ -1,14 +1,17 @@
 ﻿#pragma once
 
 #include "Node.hpp"
+#include "ITreeBuilder.hpp"
 
 namespace ES
 {
 
 /**
  * Интерфейс дерева.
+ * Дерево наполняется через интерфейс построителя ITreeBuilder.
  */
-class ITree
+class ITree:
+    public ITreeBuilder
 {
 public:
     virtual ~ITree() = default;
@@ -21,31 +24,21 @@ public:
     virtual BasicNode* GetRoot() const noexcept = 0;
 
     /**
-     * Добавление узла, имеющего тип "Вопрос".
-     * 
-     * \param question Конфигурация узла
-     * \return 
-     */
-    virtual void AddQuestion(
-        const NodeConfig& question) noexcept = 0;
-
-    /**
-     * Добавление узла, имеющего тип "Ответ".
-     * 
-     * \param answer Конфигурация узла
-     * \return 
+     * Получение количества узлов дерева.
+     *
+     * \return Количество узлов
      */
-    virtual void AddAnswer(
-        const NodeConfig& answer) noexcept = 0;
+    virtual std::size_t NodesCount() const noexcept = 0;
 
     /**
-     * Добавление соединения между узлами.
-     * 
-     * \param connection Конфигурация соединения
-     * \return 
+     * Получение узла по плотному индексу.
+     * Индексы узлов идут подряд с нуля в порядке добавления.
+     *
+     * \param index Индекс узла
+     * \return Узел, либо nullptr, если индекс вне диапазона
      */
-    virtual void AddConnection(
-        const ConnectionConfig& connection) noexcept = 0;
+    virtual BasicNode* GetNode(
+        const node_index_t index) const noexcept = 0;
 };
 
 }
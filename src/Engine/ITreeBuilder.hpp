@@ -0,0 +1,67 @@
+﻿#pragma once
+
+#include "Types.hpp"
+
+#include <cstddef>
+
+namespace ES
+{
+
+/**
+ * Интерфейс построителя дерева.
+ * Загрузчик экспертной системы передаёт в построитель
+ * считанные из конфигурации записи по мере их разбора.
+ * Тексты узлов передаются ссылками на разобранную конфигурацию,
+ * поэтому строка текста создаётся ровно один раз - в области памяти
+ * построителя, а неизменившийся при перезагрузке узел сравнивается
+ * с прежним без создания строки.
+ */
+class ITreeBuilder
+{
+public:
+    virtual ~ITreeBuilder() = default;
+
+    /**
+     * Резервирование места под узлы и соединения.
+     * Вызывается загрузчиком до добавления записей,
+     * если количество записей известно заранее.
+     *
+     * \param questions Количество вопросов
+     * \param answers Количество ответов
+     * \param connections Количество соединений
+     * \return
+     */
+    virtual void Reserve(
+        const std::size_t questions,
+        const std::size_t answers,
+        const std::size_t connections) noexcept = 0;
+
+    /**
+     * Добавление узла, имеющего тип "Вопрос".
+     *
+     * \param question Конфигурация узла
+     * \return
+     */
+    virtual void AddQuestion(
+        NodeConfig&& question) noexcept = 0;
+
+    /**
+     * Добавление узла, имеющего тип "Ответ".
+     *
+     * \param answer Конфигурация узла
+     * \return
+     */
+    virtual void AddAnswer(
+        NodeConfig&& answer) noexcept = 0;
+
+    /**
+     * Добавление соединения между узлами.
+     *
+     * \param connection Конфигурация соединения
+     * \return
+     */
+    virtual void AddConnection(
+        ConnectionConfig&& connection) noexcept = 0;
+};
+
+}
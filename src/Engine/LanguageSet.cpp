@@ -0,0 +1,183 @@
+﻿#include "LanguageSet.hpp"
+
+#include "IExpertSystemLoader.hpp"
+#include "ILogger.hpp"
+
+#include <stdexcept>
+
+namespace ES
+{
+
+namespace
+{
+
+/**
+ * Построитель столбца текстов.
+ * Тексты приходят в порядке файла языка, поэтому сначала
+ * раскладываются по индексам узлов, а затем переносятся
+ * в хранилище по порядку индексов.
+ */
+class TextColumnBuilder final:
+    public ITextsBuilder
+{
+public:
+    /**
+     * Конструктор.
+     *
+     * \param tree Дерево, к узлам которого относятся тексты
+     */
+    explicit TextColumnBuilder(
+        const Tree& tree):
+        m_tree(tree),
+        m_texts(tree.NodesCount()),
+        m_present(tree.NodesCount(), false) {}
+
+    void Reserve(
+        const std::size_t texts) noexcept override
+    {
+        (void)texts;
+    }
+
+    void AddText(
+        NodeConfig&& text) noexcept override
+    {
+        const auto index = m_tree.FindNode(text.id);
+        if (index == kInvalidIndex) {
+            // Перевод узла, которого нет в дереве
+            logger->Log(LogLevel::Warning, u8"Узел с идентификатором "
+                + std::to_string(text.id)
+                + u8" не найден");
+            return;
+        }
+        m_texts[index].assign(text.data);
+        m_present[index] = true;
+    }
+
+    /**
+     * Перенос текстов в хранилище.
+     *
+     * \param compression Параметры хранения текстов
+     * \return Хранилище текстов
+     */
+    std::shared_ptr<const TextStore> Build(
+        const TextCompressionOptions& compression)
+    {
+        std::string dictionary;
+        if (compression.enabled) {
+            std::vector<std::string_view> sample;
+            sample.reserve(m_texts.size());
+            for (std::size_t i = 0; i < m_texts.size(); ++i) {
+                if (m_present[i]) {
+                    sample.push_back(m_texts[i]);
+                }
+            }
+            dictionary = TextStore::BuildDictionary(sample, compression.dictionarySize);
+        }
+        auto store = std::make_shared<TextStore>(
+            std::move(dictionary), compression.blockSize, compression.enabled);
+        for (std::size_t i = 0; i < m_texts.size(); ++i) {
+            if (m_present[i]) {
+                store->Add(m_texts[i]);
+                std::string().swap(m_texts[i]);
+            }
+            else {
+                store->AddMissing();
+            }
+        }
+        store->Finish();
+        return store;
+    }
+
+private:
+    // Дерево, к узлам которого относятся тексты
+    const Tree& m_tree;
+    // Тексты по индексам узлов
+    std::vector<std::string> m_texts;
+    // Признаки загруженных текстов
+    std::vector<bool> m_present;
+};
+
+}
+
+/**
+ * Конструктор.
+ *
+ * \param tree Дерево, к узлам которого относятся тексты
+ * \param languages Ключ - код языка, значение - путь к файлу языка
+ * \param compression Параметры хранения текстов
+ */
+LanguageSet::LanguageSet(
+    std::shared_ptr<const Tree> tree,
+    const std::map<std::string, std::string>& languages,
+    const TextCompressionOptions& compression):
+    m_tree(std::move(tree)),
+    m_compression(compression)
+{
+    for (const auto& [code, path] : languages) {
+        auto language = std::make_unique<Language>();
+        language->path = path;
+        m_languages.emplace(code, std::move(language));
+    }
+}
+
+/**
+ * Получение кодов языков.
+ *
+ * \return Коды языков в алфавитном порядке
+ */
+std::vector<std::string> LanguageSet::Codes() const
+{
+    std::vector<std::string> codes;
+    codes.reserve(m_languages.size());
+    for (const auto& [code, _] : m_languages) {
+        codes.push_back(code);
+    }
+    return codes;
+}
+
+/**
+ * Получение текстов на заданном языке.
+ *
+ * \param code Код языка
+ * \return Тексты на заданном языке
+ */
+LanguageTexts LanguageSet::Get(
+    const std::string& code) noexcept(false)
+{
+    auto it = m_languages.find(code);
+    if (it == m_languages.end()) {
+        throw std::runtime_error(u8"Язык " + code + u8" не найден в конфигурации");
+    }
+    auto& language = *it->second;
+    // Загруженные тексты больше не изменяются, поэтому
+    // после загрузки сеансы создаются без блокировки
+    if (language.loaded.load(std::memory_order_acquire)) {
+        return language.texts;
+    }
+    std::lock_guard<std::mutex> lock(language.mutex);
+    if (!language.loaded.load(std::memory_order_relaxed)) {
+        language.texts = Load(language.path);
+        language.loaded.store(true, std::memory_order_release);
+    }
+    return language.texts;
+}
+
+/**
+ * Загрузка текстов языка.
+ *
+ * \param path Путь к файлу языка
+ * \return Загруженные тексты
+ */
+LanguageTexts LanguageSet::Load(
+    const std::string& path) const noexcept(false)
+{
+    auto loader = CreateExpertSystemLoader();
+    TextColumnBuilder builder(*m_tree);
+    loader->LoadTexts(path, builder);
+    LanguageTexts result;
+    result.name = loader->GetName();
+    result.texts = builder.Build(m_compression);
+    return result;
+}
+
+}
@@ -0,0 +1,102 @@
+﻿#pragma once
+
+#include "IExpertSystem.hpp"
+#include "Tree.hpp"
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace ES
+{
+
+/**
+ * Тексты загруженной экспертной системы на одном языке.
+ */
+struct LanguageTexts
+{
+    // Имя экспертной системы на этом языке
+    std::string name;
+    // Тексты узлов. Отсутствующие переводы берутся из основных текстов
+    std::shared_ptr<const TextStore> texts;
+};
+
+/**
+ * Дополнительные языки загруженной экспертной системы.
+ * Структура дерева общая для всех языков, а тексты каждого
+ * языка хранятся отдельным столбцом, индексированным
+ * индексами узлов. Столбец загружается при первом создании
+ * сеанса на его языке, неиспользуемые языки не загружаются.
+ * Набор разделяется всеми сеансами и может использоваться
+ * из разных потоков.
+ */
+class LanguageSet final
+{
+public:
+    /**
+     * Конструктор.
+     *
+     * \param tree Дерево, к узлам которого относятся тексты
+     * \param languages Ключ - код языка, значение - путь к файлу языка
+     * \param compression Параметры хранения текстов
+     */
+    LanguageSet(
+        std::shared_ptr<const Tree> tree,
+        const std::map<std::string, std::string>& languages,
+        const TextCompressionOptions& compression);
+
+    /**
+     * Получение кодов языков.
+     *
+     * \return Коды языков в алфавитном порядке
+     */
+    std::vector<std::string> Codes() const;
+
+    /**
+     * Получение текстов на заданном языке.
+     * Если тексты ещё не загружены, то они загружаются
+     * вызывающим потоком, остальные потоки ждут окончания загрузки.
+     *
+     * \param code Код языка
+     * \return Тексты на заданном языке
+     */
+    LanguageTexts Get(
+        const std::string& code) noexcept(false);
+
+private:
+    // Язык
+    struct Language
+    {
+        // Путь к файлу языка
+        std::string path;
+        // Загруженные тексты
+        LanguageTexts texts;
+        // Защита от одновременной загрузки
+        std::mutex mutex;
+        // Признак загруженных текстов
+        std::atomic<bool> loaded{false};
+    };
+
+    /**
+     * Загрузка текстов языка.
+     *
+     * \param path Путь к файлу языка
+     * \return Загруженные тексты
+     */
+    LanguageTexts Load(
+        const std::string& path) const noexcept(false);
+
+    // Дерево, к узлам которого относятся тексты
+    std::shared_ptr<const Tree> m_tree;
+    // Параметры хранения текстов
+    TextCompressionOptions m_compression;
+    // Языки
+    // Ключ - код языка
+    // Значение - язык
+    std::map<std::string, std::unique_ptr<Language>> m_languages;
+};
+
+}
@@ -0,0 +1,89 @@
+﻿#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+namespace ES
+{
+
+/**
+ * Индекс дерева, построенный при загрузке либо при первом обращении.
+ * При полной загрузке индексы строятся сразу, чтобы учесть их
+ * в бюджете памяти, а после перезагрузки с изменениями - только
+ * когда сеанс впервые к ним обратится. Разделяется всеми сеансами
+ * и может использоваться из разных потоков: индекс строит первый
+ * обратившийся поток, остальные ждут окончания построения.
+ */
+template <typename Index>
+class LazyIndex final
+{
+public:
+    // Функция построения индекса
+    using build_t = std::function<std::shared_ptr<const Index>()>;
+
+    /**
+     * Конструктор для уже построенного индекса.
+     *
+     * \param index Индекс
+     */
+    explicit LazyIndex(
+        std::shared_ptr<const Index> index) noexcept:
+        m_index(std::move(index)),
+        m_built(true)
+    {
+    }
+
+    /**
+     * Конструктор для индекса, строящегося при первом обращении.
+     *
+     * \param build Функция построения индекса
+     */
+    explicit LazyIndex(
+        build_t build) noexcept:
+        m_build(std::move(build))
+    {
+    }
+
+    /**
+     * Получение индекса. Если индекс ещё не построен,
+     * то он строится вызывающим потоком.
+     *
+     * \return Индекс
+     */
+    const Index& Get() const noexcept(false)
+    {
+        if (!m_built.load(std::memory_order_acquire)) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_built.load(std::memory_order_relaxed)) {
+                m_index = m_build();
+                m_build = nullptr;
+                m_built.store(true, std::memory_order_release);
+            }
+        }
+        return *m_index;
+    }
+
+    /**
+     * Получение индекса без построения.
+     *
+     * \return Индекс, либо nullptr, если он ещё не построен
+     */
+    const Index* Built() const noexcept
+    {
+        return m_built.load(std::memory_order_acquire) ? m_index.get() : nullptr;
+    }
+
+private:
+    // Функция построения индекса (до построения)
+    mutable build_t m_build;
+    // Индекс (после построения)
+    mutable std::shared_ptr<const Index> m_index;
+    // Защита от одновременного построения
+    mutable std::mutex m_mutex;
+    // Признак построенного индекса
+    mutable std::atomic<bool> m_built{false};
+};
+
+}
@@ -0,0 +1,183 @@
+﻿#include "LineProtocol.hpp"
+
+#include <stdexcept>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#   include <cerrno>
+#   include <sys/socket.h>
+#   include <unistd.h>
+#endif
+
+namespace ES
+{
+
+// Размер блока чтения
+static constexpr std::size_t kReadSize = 64 * 1024;
+
+/**
+ * Разбор команды сеанса.
+ *
+ * \param command Команда без идентификатора сеанса
+ * \return Команда
+ */
+SessionCommand ParseCommand(
+    const std::string_view command) noexcept
+{
+    SessionCommand result;
+    if (command.empty()) {
+        result.kind = SessionCommand::Kind::Show;
+    }
+    else if (command == "b") {
+        result.kind = SessionCommand::Kind::Back;
+    }
+    else if (command == "r") {
+        result.kind = SessionCommand::Kind::Reset;
+    }
+    else if (command == "close") {
+        result.kind = SessionCommand::Kind::Close;
+    }
+    else {
+        const auto [end, error] = std::from_chars(command.data(), command.data() + command.size(),
+            result.answer);
+        if (error == std::errc() && end == command.data() + command.size()) {
+            result.kind = SessionCommand::Kind::Answer;
+        }
+    }
+    return result;
+}
+
+/**
+ * Добавление числа к строке.
+ *
+ * \param output Строка
+ * \param value Число
+ * \return
+ */
+void AppendNumber(
+    std::string& output,
+    const std::int64_t value)
+{
+    char number[24];
+    output.append(number, std::to_chars(number, number + sizeof(number), value).ptr);
+}
+
+/**
+ * Добавление ответа на запрос.
+ *
+ * \param output Буфер ответов
+ * \param status Статус, либо nullptr для статуса по текущему узлу
+ * \param sessionID Идентификатор сеанса
+ * \param system Сеанс, либо nullptr, если сеанса нет
+ * \return
+ */
+void AppendReply(
+    std::string& output,
+    const char* status,
+    const std::uint64_t sessionID,
+    const IExpertSystem* system)
+{
+    if (!status) {
+        status = system->IsFinished() ? "finished" : "ok";
+    }
+    output.append(status).push_back('\t');
+    AppendNumber(output, static_cast<std::int64_t>(sessionID));
+    output.push_back('\t');
+    if (system) {
+        AppendNumber(output, system->GetCurrentID());
+        output.push_back('\t');
+        // Перевод строки в тексте узла разорвал бы ответ
+        for (const auto c : system->GetCurrentData()) {
+            output.push_back(c == '\n' || c == '\r' ? ' ' : c);
+        }
+    }
+    else {
+        output.push_back('\t');
+    }
+    output.push_back('\n');
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+
+/**
+ * Запись всех данных в сокет или файл.
+ *
+ * \param fd Дескриптор
+ * \param data Данные
+ * \return true - если данные записаны
+ */
+bool WriteAll(
+    const int fd,
+    std::string_view data) noexcept
+{
+    while (!data.empty()) {
+        auto written = ::send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+        if (written < 0 && errno == ENOTSOCK) {
+            written = ::write(fd, data.data(), data.size());
+        }
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data.remove_prefix(static_cast<std::size_t>(written));
+    }
+    return true;
+}
+
+/**
+ * Обработка строк запросов из сокета до его закрытия.
+ *
+ * \param fd Сокет
+ * \param handle Обработчик строки запроса
+ * \return
+ */
+void ServeLines(
+    const int fd,
+    const std::function<void(std::string_view, std::string&)>& handle)
+{
+    std::string buffer;
+    std::string output;
+    std::vector<char> chunk(kReadSize);
+    while (true) {
+        const auto read = ::read(fd, chunk.data(), chunk.size());
+        if (read < 0 && errno == EINTR) {
+            continue;
+        }
+        if (read <= 0) {
+            return;
+        }
+        buffer.append(chunk.data(), static_cast<std::size_t>(read));
+        std::size_t begin = 0;
+        for (auto end = buffer.find('\n'); end != std::string::npos; end = buffer.find('\n', begin)) {
+            handle(std::string_view(buffer).substr(begin, end - begin), output);
+            begin = end + 1;
+        }
+        buffer.erase(0, begin);
+        if (!WriteAll(fd, output)) {
+            return;
+        }
+        output.clear();
+    }
+}
+
+#else
+
+bool WriteAll(
+    const int,
+    std::string_view) noexcept
+{
+    return false;
+}
+
+void ServeLines(
+    const int,
+    const std::function<void(std::string_view, std::string&)>&)
+{
+    throw std::runtime_error(u8"Строчный протокол не поддерживается на этой платформе");
+}
+
+#endif
+
+}
@@ -0,0 +1,66 @@
+﻿#include "MappedFile.hpp"
+
+#include <stdexcept>
+
+#if defined(_WIN32)
+#   include <fstream>
+#else
+#   include <fcntl.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <unistd.h>
+#endif
+
+namespace ES
+{
+
+/**
+ * Отображение файла в память.
+ *
+ * \param path Путь к файлу
+ */
+MappedFile::MappedFile(
+    const std::filesystem::path& path) noexcept(false)
+{
+#if defined(_WIN32)
+    std::ifstream file(path, std::ios::binary);
+    m_buffer.resize(static_cast<std::size_t>(std::filesystem::file_size(path)));
+    file.read(m_buffer.data(), static_cast<std::streamsize>(m_buffer.size()));
+    m_size = static_cast<std::size_t>(file.gcount());
+    m_data = m_buffer.data();
+#else
+    const int file = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat status = {};
+    if (file < 0 || ::fstat(file, &status) != 0) {
+        if (file >= 0) {
+            ::close(file);
+        }
+        throw std::runtime_error(u8"Не удалось прочитать " + path.string());
+    }
+    m_size = static_cast<std::size_t>(status.st_size);
+    if (m_size) {
+        void* data = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, file, 0);
+        if (data == MAP_FAILED) {
+            ::close(file);
+            throw std::runtime_error(u8"Не удалось отобразить в память " + path.string());
+        }
+        ::madvise(data, m_size, MADV_SEQUENTIAL);
+        m_data = static_cast<const char*>(data);
+    }
+    ::close(file);
+#endif
+}
+
+/**
+ * Деструктор. Снимает отображение.
+ */
+MappedFile::~MappedFile()
+{
+#if !defined(_WIN32)
+    if (m_data) {
+        ::munmap(const_cast<char*>(m_data), m_size);
+    }
+#endif
+}
+
+}
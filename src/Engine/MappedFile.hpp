@@ -0,0 +1,48 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <vector>
+
+namespace ES
+{
+
+/**
+ * Файл, отображённый в память только для чтения.
+ * Там, где отображение недоступно, файл читается целиком.
+ */
+class MappedFile final
+{
+public:
+    /**
+     * Конструктор.
+     *
+     * \param path Путь к файлу
+     */
+    explicit MappedFile(
+        const std::filesystem::path& path) noexcept(false);
+
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* Data() const noexcept
+    {
+        return m_data;
+    }
+
+    std::size_t Size() const noexcept
+    {
+        return m_size;
+    }
+
+private:
+    const char* m_data = nullptr;
+    std::size_t m_size = 0;
+#if defined(_WIN32)
+    std::vector<char> m_buffer;
+#endif
+};
+
+}
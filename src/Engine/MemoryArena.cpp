@@ -0,0 +1,105 @@
+﻿#include "MemoryArena.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace ES
+{
+
+/**
+ * Конструктор.
+ *
+ * \param limit Лимит памяти области в байтах
+ */
+MemoryArena::MemoryArena(
+    const std::size_t limit) noexcept:
+    m_limit(limit)
+{
+    for (std::size_t i = 0; i < kMemoryCategories; ++i) {
+        m_resources[i] = CategoryResource(this, static_cast<MemoryCategory>(i));
+    }
+}
+
+/**
+ * Деструктор. Освобождает все блоки области.
+ */
+MemoryArena::~MemoryArena()
+{
+    for (const auto block : m_blocks) {
+        ::operator delete(block);
+    }
+}
+
+/**
+ * Выделение памяти из текущего блока.
+ * Если в блоке не хватает места, то начинается новый блок.
+ *
+ * \param category Категория памяти
+ * \param bytes Размер в байтах
+ * \param alignment Выравнивание
+ * \return Выделенная память
+ */
+void* MemoryArena::Allocate(
+    const MemoryCategory category,
+    const std::size_t bytes,
+    const std::size_t alignment)
+{
+    auto address = reinterpret_cast<std::uintptr_t>(m_current);
+    auto aligned = (address + alignment - 1) & ~(std::uintptr_t(alignment) - 1);
+    if (!m_current || aligned + bytes > reinterpret_cast<std::uintptr_t>(m_end)) {
+        NewBlock(bytes + alignment);
+        address = reinterpret_cast<std::uintptr_t>(m_current);
+        aligned = (address + alignment - 1) & ~(std::uintptr_t(alignment) - 1);
+    }
+    m_current = reinterpret_cast<char*>(aligned + bytes);
+    m_used[static_cast<std::size_t>(category)] += bytes;
+    return reinterpret_cast<void*>(aligned);
+}
+
+/**
+ * Копирование текста в область.
+ * Пустые тексты не занимают памяти.
+ *
+ * \param text Текст
+ * \return Копия текста, принадлежащая области
+ */
+std::string_view MemoryArena::CopyText(
+    const std::string_view text)
+{
+    if (text.empty()) {
+        return {};
+    }
+    const auto copy = static_cast<char*>(Allocate(MemoryCategory::Texts, text.size(), 1));
+    std::memcpy(copy, text.data(), text.size());
+    return { copy, text.size() };
+}
+
+/**
+ * Выделение нового блока.
+ * Размер блока - четверть уже занятой областью памяти, поэтому
+ * небольшие базы не занимают лишнего, а крупные обходятся
+ * малым числом блоков.
+ * При заданном лимите блок не превышает шестнадцатой части лимита,
+ * чтобы превышение обнаруживалось вовремя.
+ *
+ * \param bytes Минимальный размер блока в байтах
+ * \return
+ */
+void MemoryArena::NewBlock(
+    const std::size_t bytes)
+{
+    auto size = std::clamp(m_reserved / 4, kMinBlockSize, kMaxBlockSize);
+    if (m_limit != kUnlimited) {
+        size = std::min(size, std::max(kMinBlockSize, m_limit / 16));
+    }
+    size = std::max(size, bytes);
+    m_blocks.reserve(m_blocks.size() + 1);
+    const auto block = ::operator new(size);
+    m_blocks.push_back(block);
+    m_current = static_cast<char*>(block);
+    m_end = m_current + size;
+    m_reserved += size;
+}
+
+}
@@ -0,0 +1,239 @@
+﻿#pragma once
+
+#include <array>
+#include <cstddef>
+#include <limits>
+#include <memory_resource>
+#include <new>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace ES
+{
+
+// Категория памяти базы знаний
+enum class MemoryCategory
+{
+    Structure,  // Узлы и блоки хранилища узлов
+    Edges,      // Соединения вопросов
+    Texts,      // Тексты узлов
+    Indices     // Индекс идентификаторов узлов
+};
+
+// Количество категорий памяти
+constexpr std::size_t kMemoryCategories = 4;
+
+/**
+ * Область памяти базы знаний.
+ * Память выделяется подряд из крупных блоков и по отдельности
+ * не освобождается: все блоки освобождаются разом при удалении
+ * области. Деструкторы размещённых в области объектов не вызываются,
+ * поэтому в ней размещаются только объекты, вся память которых
+ * также выделена из области.
+ * Выделенные байты учитываются по категориям. Память, которую
+ * контейнеры std::pmr освободили (например, при росте вектора),
+ * не переиспользуется и учитывается отдельно как потерянная.
+ * При превышении
+ * лимита память продолжает выделяться, а область лишь запоминает
+ * превышение, чтобы построитель дерева прекратил добавление узлов.
+ * Область не потокобезопасна: её заполняет один поток.
+ */
+class MemoryArena final
+{
+public:
+    // Лимит, соответствующий отсутствию ограничения
+    static constexpr std::size_t kUnlimited = std::numeric_limits<std::size_t>::max();
+
+    /**
+     * Конструктор.
+     *
+     * \param limit Лимит памяти области в байтах
+     */
+    explicit MemoryArena(
+        const std::size_t limit = kUnlimited) noexcept;
+
+    /**
+     * Деструктор. Освобождает все блоки области.
+     */
+    ~MemoryArena();
+
+    MemoryArena(const MemoryArena&) = delete;
+    MemoryArena& operator=(const MemoryArena&) = delete;
+
+    /**
+     * Выделение памяти.
+     *
+     * \param category Категория памяти
+     * \param bytes Размер в байтах
+     * \param alignment Выравнивание
+     * \return Выделенная память
+     */
+    void* Allocate(
+        const MemoryCategory category,
+        const std::size_t bytes,
+        const std::size_t alignment = alignof(std::max_align_t));
+
+    /**
+     * Создание объекта в области.
+     *
+     * \param category Категория памяти
+     * \param args Аргументы конструктора
+     * \return Созданный объект
+     */
+    template <typename T, typename... Args>
+    T* Create(
+        const MemoryCategory category,
+        Args&&... args)
+    {
+        return new (Allocate(category, sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    /**
+     * Копирование текста в область.
+     *
+     * \param text Текст
+     * \return Копия текста, принадлежащая области
+     */
+    std::string_view CopyText(
+        const std::string_view text);
+
+    /**
+     * Получение ресурса памяти для контейнеров std::pmr.
+     * Освобождённая через ресурс память не переиспользуется,
+     * а только учитывается как потерянная.
+     *
+     * \param category Категория памяти
+     * \return Ресурс, выделяющий память заданной категории
+     */
+    std::pmr::memory_resource* Resource(
+        const MemoryCategory category) noexcept
+    {
+        return &m_resources[static_cast<std::size_t>(category)];
+    }
+
+    /**
+     * Получение объёма используемой памяти заданной категории.
+     * Потерянная память сюда не входит.
+     *
+     * \param category Категория памяти
+     * \return Размер в байтах
+     */
+    std::size_t Used(
+        const MemoryCategory category) const noexcept
+    {
+        const auto i = static_cast<std::size_t>(category);
+        return m_used[i] - m_wasted[i];
+    }
+
+    /**
+     * Получение объёма памяти, освобождённой контейнерами,
+     * но не возвращённой в область до её удаления.
+     *
+     * \return Размер в байтах
+     */
+    std::size_t Wasted() const noexcept
+    {
+        std::size_t wasted = 0;
+        for (const auto bytes : m_wasted) {
+            wasted += bytes;
+        }
+        return wasted;
+    }
+
+    /**
+     * Получение объёма памяти, занятой блоками области,
+     * включая ещё не использованные остатки блоков.
+     *
+     * \return Размер в байтах
+     */
+    std::size_t Reserved() const noexcept
+    {
+        return m_reserved;
+    }
+
+    /**
+     * Проверка превышения лимита.
+     *
+     * \return true, если блоки области заняли больше лимита
+     */
+    bool Exceeded() const noexcept
+    {
+        return m_reserved > m_limit;
+    }
+
+private:
+    /**
+     * Ресурс памяти одной категории.
+     */
+    class CategoryResource final:
+        public std::pmr::memory_resource
+    {
+    public:
+        CategoryResource() noexcept = default;
+
+        CategoryResource(
+            MemoryArena* arena,
+            const MemoryCategory category) noexcept:
+            m_arena(arena),
+            m_category(category) {}
+
+    private:
+        void* do_allocate(
+            std::size_t bytes,
+            std::size_t alignment) override
+        {
+            return m_arena->Allocate(m_category, bytes, alignment);
+        }
+
+        void do_deallocate(
+            void*,
+            std::size_t bytes,
+            std::size_t) override
+        {
+            m_arena->m_wasted[static_cast<std::size_t>(m_category)] += bytes;
+        }
+
+        bool do_is_equal(
+            const std::pmr::memory_resource& other) const noexcept override
+        {
+            return this == &other;
+        }
+
+        // Область, из которой выделяется память
+        MemoryArena* m_arena = nullptr;
+        // Категория выделяемой памяти
+        MemoryCategory m_category = MemoryCategory::Structure;
+    };
+
+    // Границы размера блока в байтах
+    static constexpr std::size_t kMinBlockSize = 64 * 1024;
+    static constexpr std::size_t kMaxBlockSize = 4 * 1024 * 1024;
+
+    /**
+     * Выделение нового блока.
+     *
+     * \param bytes Минимальный размер блока в байтах
+     * \return
+     */
+    void NewBlock(
+        const std::size_t bytes);
+
+    // Лимит памяти области
+    std::size_t m_limit;
+    // Блоки области
+    std::vector<void*> m_blocks;
+    // Свободная часть текущего блока
+    char* m_current = nullptr;
+    char* m_end = nullptr;
+    // Объём памяти, занятой блоками
+    std::size_t m_reserved = 0;
+    // Объём выделенной памяти по категориям
+    std::array<std::size_t, kMemoryCategories> m_used{};
+    // Объём потерянной памяти по категориям
+    std::array<std::size_t, kMemoryCategories> m_wasted{};
+    // Ресурсы памяти по категориям
+    std::array<CategoryResource, kMemoryCategories> m_resources;
+};
+
+}
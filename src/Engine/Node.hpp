@@ -2,13 +2,19 @@
 
 #include "Types.hpp"
 
-#include <map>
+#include <memory_resource>
+#include <string_view>
+#include <utility>
+#include <vector>
 
 namespace ES
 {
 
 /**
  * Базовый класс для узла дерева.
+ * Узлы размещаются в области памяти базы знаний (MemoryArena)
+ * вместе со своими текстами и соединениями и освобождаются
+ * вместе с областью без вызова деструкторов.
  */
 class BasicNode
 {
@@ -16,11 +22,17 @@ public:
     /**
      * Конструктор.
      * 
-     * \param config Конфигурация узла
+     * \param id Идентификатор узла
+     * \param data Данные узла. Память под данные принадлежит области дерева
+     * \param index Плотный индекс узла в дереве
      */
     BasicNode(
-        const NodeConfig& config):
-        m_config(config) {}
+        const node_id_t id,
+        const std::string_view data,
+        const node_index_t index) noexcept:
+        m_id(id),
+        m_data(data),
+        m_index(index) {}
 
     /**
      * Деструктор.
@@ -33,9 +45,20 @@ public:
      * 
      * \return Данные, хранящиеся в узле
      */
-    const node_data_t& Data() const noexcept
+    std::string_view Data() const noexcept
     {
-        return m_config.data;
+        return m_data;
+    }
+
+    /**
+     * Освобождение памяти, занятой данными узла.
+     * Используется, когда данные перенесены в хранилище сжатых текстов.
+     *
+     * \return
+     */
+    void ReleaseData() noexcept
+    {
+        m_data = {};
     }
 
     /**
@@ -45,7 +68,17 @@ public:
      */
     node_id_t ID() const noexcept
     {
-        return m_config.id;
+        return m_id;
+    }
+
+    /**
+     * Получение плотного индекса узла.
+     *
+     * \return Индекс узла в дереве
+     */
+    node_index_t Index() const noexcept
+    {
+        return m_index;
     }
 
     /**
@@ -56,8 +89,12 @@ public:
     virtual NodeType Type() const noexcept = 0;
 
 protected:
-    // Конфигурация узла
-    NodeConfig m_config;
+    // Идентификатор узла
+    node_id_t m_id;
+    // Данные, хранящиеся в узле
+    std::string_view m_data;
+    // Плотный индекс узла в дереве
+    node_index_t m_index;
 };
 
 /**
@@ -71,11 +108,32 @@ public:
     /**
      * Конструктор.
      * 
-     * \param config Конфигурация узла
+     * \param id Идентификатор узла
+     * \param data Данные узла
+     * \param index Плотный индекс узла в дереве
+     * \param edges Ресурс памяти для соединений
+     */
+    Question(
+        const node_id_t id,
+        const std::string_view data,
+        const node_index_t index,
+        std::pmr::memory_resource* edges) noexcept:
+        BasicNode(id, data, index),
+        m_childrens(edges) {}
+
+    /**
+     * Копирование вопроса в другую область памяти.
+     *
+     * \param other Исходный вопрос
+     * \param data Данные узла
+     * \param edges Ресурс памяти для соединений
      */
     Question(
-        const NodeConfig& config):
-        BasicNode(config){}
+        const Question& other,
+        const std::string_view data,
+        std::pmr::memory_resource* edges):
+        BasicNode(other.m_id, data, other.m_index),
+        m_childrens(other.m_childrens, edges) {}
 
     /**
      * Деструктор.
@@ -88,16 +146,16 @@ public:
      * согласно значению (ответу на текущий вопрос).
      * 
      * \param answerValue Ответ
-     * \return Дочерний узел, соответствующий ответу.
+     * \return Индекс дочернего узла, соответствующего ответу, либо kInvalidIndex.
      * Это может быть другой вопрос, либо ответ, либо узла может не существовать.
      * Если узла не существует, то это говорит о неполноте информации в эеспертной системе.
      * В таком случае следует добавить отсутствующий узел в конфигурационный файл.
      */
-    BasicNode* GetNext(
+    node_index_t GetNext(
         const int answerValue) const noexcept
     {
         // Перебираем все дочерние узлы
-        // node - текущий дочерний узел
+        // node - индекс текущего дочернего узла
         // predicat - предикат, соответствующий дочернему узлу
         for (const auto& [node, predicat] : m_childrens) {
             // Применяем значение ответа к предикату текущего дочернего узла
@@ -109,21 +167,53 @@ public:
         }
         // Среди дочерних узлов не удалось найти узел,
         // соответствующий предикату
-        return nullptr;
+        return kInvalidIndex;
+    }
+
+    /**
+     * Получение дочерних узлов.
+     *
+     * \return Индексы дочерних узлов и соответствующие им предикаты
+     * в порядке добавления соединений
+     */
+    const std::pmr::vector<std::pair<node_index_t, node_predicat_t>>& GetChildrens() const noexcept
+    {
+        return m_childrens;
+    }
+
+    /**
+     * Резервирование места под соединения.
+     * Соединения размещаются в области памяти, которая не переиспользует
+     * освобождённое, поэтому место резервируется сразу под все соединения.
+     *
+     * \param count Количество соединений
+     * \return
+     */
+    void ReserveConnections(
+        const std::size_t count)
+    {
+        m_childrens.reserve(count);
     }
 
     /**
      * Добавление нового соединения к текущему узлу.
      * 
-     * \param dst Узел, который станет дочерним текущему узлу
+     * \param dst Индекс узла, который станет дочерним текущему узлу
      * \param predicat Предикат, соответствующий добавляемому узлу
      * \return 
      */
     void AddConnection(
-        BasicNode* dst,
-        const node_predicat_t& predicat) noexcept
+        const node_index_t dst,
+        const node_predicat_t predicat) noexcept
     {
-        m_childrens[dst] = predicat;
+        // Если соединение с таким узлом уже есть, то заменяем его предикат
+        for (auto& child : m_childrens) {
+            if (child.first == dst) {
+                child.second = predicat;
+                return;
+            }
+        }
+        m_childrens.emplace_back(dst, predicat);
     }
 
     // BasicNode
@@ -138,10 +228,14 @@ public:
         return NodeType::Question;
     }
 private:
-    // Дочерние узлы
-    // Ключ - указатель на дочерний узел
-    // Значение - предикат, соответствующий дочернему узлу
-    std::map<BasicNode*, node_predicat_t> m_childrens;
+    // Дочерние узлы в порядке добавления соединений.
+    // Хранятся непрерывно, чтобы перебор при переходе
+    // не требовал обхода узлов дерева std::map.
+    // Узлы задаются индексами, а не указателями, поэтому
+    // неизменившиеся вопросы можно разделять между версиями дерева
+    // first - индекс дочернего узла
+    // second - предикат, соответствующий дочернему узлу
+    std::pmr::vector<std::pair<node_index_t, node_predicat_t>> m_childrens;
 };
 
 /**
@@ -160,11 +254,15 @@ public:
     /**
      * Конструктор.
      * 
-     * \param config Конфигурация узла
+     * \param id Идентификатор узла
+     * \param data Данные узла
+     * \param index Плотный индекс узла в дереве
      */
     Answer(
-        const NodeConfig& config):
-        BasicNode(config){}
+        const node_id_t id,
+        const std::string_view data,
+        const node_index_t index) noexcept:
+        BasicNode(id, data, index){}
 
     /**
      * Деструктор.
@@ -0,0 +1,230 @@
+﻿#include "NodeIdIndex.hpp"
+
+#include <algorithm>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace ES
+{
+
+namespace
+{
+
+/**
+ * Количество единичных битов в слове.
+ *
+ * \param word Слово
+ * \return Количество единичных битов
+ */
+inline std::size_t CountBits(
+    const std::uint64_t word) noexcept
+{
+#if defined(_MSC_VER)
+    return static_cast<std::size_t>(__popcnt64(word));
+#else
+    return static_cast<std::size_t>(__builtin_popcountll(word));
+#endif
+}
+
+/**
+ * Проверка бита.
+ *
+ * \param bits Биты
+ * \param position Номер бита
+ * \return true, если бит единичный
+ */
+inline bool TestBit(
+    const std::uint64_t* bits,
+    const std::uint64_t position) noexcept
+{
+    return (bits[position >> 6] >> (position & 63)) & 1;
+}
+
+}
+
+/**
+ * Конструктор. Строит индекс по идентификаторам узлов.
+ * На каждом уровне идентификаторы, попавшие на позицию в одиночку,
+ * размещаются, а столкнувшиеся переходят на следующий уровень,
+ * вдвое больший их количества. Каждый уровень размещает большую
+ * часть оставшихся идентификаторов, поэтому построение занимает O(n).
+ * Повторяющиеся идентификаторы сталкиваются на всех уровнях
+ * и вместе с редкими неразмещёнными попадают в упорядоченный массив.
+ *
+ * \param entries Идентификаторы и индексы узлов
+ * \param resource Ресурс памяти для индекса
+ * \param duplicates Индексы узлов с повторяющимися идентификаторами
+ */
+NodeIdIndex::NodeIdIndex(
+    std::vector<entry_t>& entries,
+    std::pmr::memory_resource* resource,
+    std::vector<node_index_t>& duplicates):
+    m_bits(resource),
+    m_ranks(resource),
+    m_values(resource),
+    m_fallback(resource)
+{
+    constexpr std::uint64_t blockMask = (std::uint64_t(1) << kBlockBits) - 1;
+    std::vector<std::uint64_t> bits;
+    std::vector<std::uint64_t> hits;
+    std::vector<std::uint64_t> collisions;
+    // Неразмещённые идентификаторы собираются в начале entries
+    std::size_t count = entries.size();
+    while (count && m_levelsCount < kMaxLevels) {
+        const auto level = m_levelsCount;
+        const auto size = (std::uint64_t(count) * kGamma + blockMask) & ~blockMask;
+        hits.assign(size >> 6, 0);
+        collisions.assign(size >> 6, 0);
+        for (std::size_t i = 0; i < count; ++i) {
+            const auto position = Position(entries[i].first, level, size);
+            const auto bit = std::uint64_t(1) << (position & 63);
+            if (hits[position >> 6] & bit) {
+                collisions[position >> 6] |= bit;
+            }
+            hits[position >> 6] |= bit;
+        }
+        for (std::size_t word = 0; word < hits.size(); ++word) {
+            hits[word] &= ~collisions[word];
+        }
+        std::size_t rest = 0;
+        for (std::size_t i = 0; i < count; ++i) {
+            if (!TestBit(hits.data(), Position(entries[i].first, level, size))) {
+                std::swap(entries[rest++], entries[i]);
+            }
+        }
+        // Уровень, на котором ничего не разместилось, не сохраняем:
+        // остались только повторяющиеся идентификаторы
+        if (rest == count) {
+            break;
+        }
+        m_levels[level] = { std::uint64_t(bits.size()) << 6, size };
+        bits.insert(bits.end(), hits.begin(), hits.end());
+        ++m_levelsCount;
+        count = rest;
+    }
+    hits = {};
+    collisions = {};
+
+    m_bits.assign(bits.begin(), bits.end());
+    bits = {};
+    m_ranks.resize((m_bits.size() << 6) >> kBlockBits);
+    std::size_t rank = 0;
+    for (std::size_t word = 0; word < m_bits.size(); ++word) {
+        if (!(word & (blockMask >> 6))) {
+            m_ranks[word >> (kBlockBits - 6)] = static_cast<std::uint32_t>(rank);
+        }
+        rank += CountBits(m_bits[word]);
+    }
+    // Размещённый идентификатор находится на первом уровне,
+    // где его бит единичный: на предыдущих уровнях он столкнулся
+    m_values.resize(entries.size() - count);
+    for (std::size_t i = count; i < entries.size(); ++i) {
+        for (std::size_t level = 0; level < m_levelsCount; ++level) {
+            const auto position = m_levels[level].offset
+                + Position(entries[i].first, level, m_levels[level].size);
+            if (TestBit(m_bits.data(), position)) {
+                m_values[Rank(position)] = entries[i].second;
+                break;
+            }
+        }
+    }
+
+    std::sort(entries.begin(), entries.begin() + count);
+    m_fallback.reserve(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        if (i && entries[i].first == entries[i - 1].first) {
+            duplicates.push_back(entries[i].second);
+        }
+        else {
+            m_fallback.push_back(entries[i]);
+        }
+    }
+}
+
+/**
+ * Поиск узла по идентификатору.
+ * Уровни проверяются по порядку до первого единичного бита,
+ * затем идентификатор ищется в упорядоченном массиве.
+ *
+ * \param id Идентификатор узла
+ * \return Индекс узла, либо kInvalidIndex
+ */
+node_index_t NodeIdIndex::Find(
+    const node_id_t id) const noexcept
+{
+    for (std::size_t level = 0; level < m_levelsCount; ++level) {
+        const auto position = m_levels[level].offset
+            + Position(id, level, m_levels[level].size);
+        if (TestBit(m_bits.data(), position)) {
+            return m_values[Rank(position)];
+        }
+    }
+    auto it = std::lower_bound(m_fallback.begin(), m_fallback.end(), id,
+        [](const entry_t& entry, const node_id_t key)
+    {
+        return entry.first < key;
+    });
+    return it != m_fallback.end() && it->first == id ? it->second : kInvalidIndex;
+}
+
+/**
+ * Получение памяти, занятой индексом.
+ *
+ * \return Размер в байтах
+ */
+std::size_t NodeIdIndex::MemoryBytes() const noexcept
+{
+    return sizeof(*this)
+        + m_bits.capacity() * sizeof(std::uint64_t)
+        + m_ranks.capacity() * sizeof(std::uint32_t)
+        + m_values.capacity() * sizeof(node_index_t)
+        + m_fallback.capacity() * sizeof(entry_t);
+}
+
+/**
+ * Получение позиции идентификатора на уровне.
+ * Идентификатор перемешивается splitmix64 с солью уровня,
+ * а старшие 32 бита хеша отображаются на размер уровня
+ * умножением вместо деления. Размер уровня меньше 2^32,
+ * так как узлов не больше 2^31.
+ *
+ * \param id Идентификатор узла
+ * \param level Номер уровня
+ * \param size Количество бит уровня
+ * \return Номер бита внутри уровня
+ */
+std::uint64_t NodeIdIndex::Position(
+    const node_id_t id,
+    const std::size_t level,
+    const std::uint64_t size) noexcept
+{
+    auto hash = std::uint64_t(static_cast<std::uint32_t>(id))
+        + (level + 1) * 0x9E3779B97F4A7C15ull;
+    hash = (hash ^ (hash >> 30)) * 0xBF58476D1CE4E5B9ull;
+    hash = (hash ^ (hash >> 27)) * 0x94D049BB133111EBull;
+    hash ^= hash >> 31;
+    return ((hash >> 32) * size) >> 32;
+}
+
+/**
+ * Получение количества единичных бит перед заданным.
+ * Ранг блока хранится, биты внутри блока подсчитываются.
+ *
+ * \param position Номер бита
+ * \return Ранг бита
+ */
+std::size_t NodeIdIndex::Rank(
+    const std::uint64_t position) const noexcept
+{
+    const auto block = position >> kBlockBits;
+    std::size_t rank = m_ranks[block];
+    const auto word = position >> 6;
+    for (auto i = block << (kBlockBits - 6); i < word; ++i) {
+        rank += CountBits(m_bits[i]);
+    }
+    return rank + CountBits(m_bits[word] & ((std::uint64_t(1) << (position & 63)) - 1));
+}
+
+}
@@ -0,0 +1,126 @@
+﻿#pragma once
+
+#include "Types.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <utility>
+#include <vector>
+
+namespace ES
+{
+
+/**
+ * Индекс узлов по идентификаторам на основе минимальной
+ * совершенной хеш-функции. Строится один раз за O(n) по всем
+ * идентификаторам дерева и занимает около 3,5 бит на идентификатор
+ * плюс плотный индекс узла. Ключи не хранятся, поэтому для
+ * отсутствующего идентификатора Find может вернуть индекс другого
+ * узла, и вызывающий сверяет идентификатор найденного узла.
+ * Вся память индекса выделяется из заданного ресурса.
+ */
+class NodeIdIndex final
+{
+public:
+    // Идентификатор узла и его индекс
+    using entry_t = std::pair<node_id_t, node_index_t>;
+
+    /**
+     * Конструктор. Строит индекс по идентификаторам узлов.
+     * Для повторяющихся идентификаторов в индекс попадает
+     * узел с наименьшим индексом.
+     *
+     * \param entries Идентификаторы и индексы узлов, порядок которых
+     * при построении меняется
+     * \param resource Ресурс памяти для индекса
+     * \param duplicates Индексы узлов с повторяющимися идентификаторами,
+     * не попавших в индекс
+     */
+    NodeIdIndex(
+        std::vector<entry_t>& entries,
+        std::pmr::memory_resource* resource,
+        std::vector<node_index_t>& duplicates);
+
+    /**
+     * Поиск узла по идентификатору.
+     *
+     * \param id Идентификатор узла
+     * \return Индекс узла с таким идентификатором, если он есть в индексе,
+     * иначе индекс произвольного узла либо kInvalidIndex
+     */
+    node_index_t Find(
+        const node_id_t id) const noexcept;
+
+    /**
+     * Получение количества идентификаторов в индексе.
+     *
+     * \return Количество идентификаторов
+     */
+    std::size_t Size() const noexcept
+    {
+        return m_values.size() + m_fallback.size();
+    }
+
+    /**
+     * Получение памяти, занятой индексом.
+     *
+     * \return Размер в байтах
+     */
+    std::size_t MemoryBytes() const noexcept;
+private:
+    // Наибольшее количество уровней хеш-функции
+    static constexpr std::size_t kMaxLevels = 24;
+    // Количество бит уровня на один идентификатор
+    static constexpr std::size_t kGamma = 2;
+    // Размер блока битов, для которого хранится ранг (степень двойки).
+    // Размеры уровней кратны блоку, поэтому блок не пересекает уровни
+    static constexpr std::size_t kBlockBits = 9;
+
+    // Уровень хеш-функции: смещение первого бита и количество бит
+    struct Level
+    {
+        std::uint64_t offset = 0;
+        std::uint64_t size = 0;
+    };
+
+    /**
+     * Получение позиции идентификатора на уровне.
+     *
+     * \param id Идентификатор узла
+     * \param level Номер уровня
+     * \param size Количество бит уровня
+     * \return Номер бита внутри уровня
+     */
+    static std::uint64_t Position(
+        const node_id_t id,
+        const std::size_t level,
+        const std::uint64_t size) noexcept;
+
+    /**
+     * Получение количества единичных бит перед заданным.
+     *
+     * \param position Номер бита
+     * \return Ранг бита
+     */
+    std::size_t Rank(
+        const std::uint64_t position) const noexcept;
+
+    // Уровни хеш-функции
+    std::array<Level, kMaxLevels> m_levels;
+    // Количество уровней
+    std::size_t m_levelsCount = 0;
+    // Биты всех уровней подряд. Единичный бит означает, что на эту
+    // позицию уровня попал ровно один идентификатор
+    std::pmr::vector<std::uint64_t> m_bits;
+    // Количество единичных бит перед каждым блоком
+    std::pmr::vector<std::uint32_t> m_ranks;
+    // Индексы узлов по рангам единичных бит
+    std::pmr::vector<node_index_t> m_values;
+    // Идентификаторы, не размещённые ни на одном уровне,
+    // упорядоченные по идентификатору
+    std::pmr::vector<entry_t> m_fallback;
+};
+
+}
@@ -0,0 +1,199 @@
+﻿#include "Numa.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+
+#if defined(__linux__)
+#   include <sched.h>
+#   include <sys/syscall.h>
+#   include <unistd.h>
+#endif
+
+namespace ES
+{
+
+/**
+ * Разбор списка процессоров или узлов sysfs вида "0-3,8,10-11".
+ *
+ * \param list Список
+ * \return Номера из списка
+ */
+static std::vector<std::size_t> ParseList(
+    const std::string& list)
+{
+    std::vector<std::size_t> cpus;
+    std::size_t position = 0;
+    while (position < list.size()) {
+        std::size_t end = list.find(',', position);
+        if (end == std::string::npos) {
+            end = list.size();
+        }
+        const auto range = list.substr(position, end - position);
+        const auto dash = range.find('-');
+        try {
+            const auto first = std::stoul(range.substr(0, dash));
+            const auto last = dash == std::string::npos ? first : std::stoul(range.substr(dash + 1));
+            for (auto cpu = first; cpu <= last; ++cpu) {
+                cpus.push_back(cpu);
+            }
+        }
+        catch (const std::exception&) {
+            // Пропускаем нечитаемые элементы списка
+        }
+        position = end + 1;
+    }
+    return cpus;
+}
+
+/**
+ * Получение топологии текущей машины.
+ *
+ * \return Топология
+ */
+const NumaTopology& NumaTopology::Instance()
+{
+    static const NumaTopology topology;
+    return topology;
+}
+
+/**
+ * Конструктор. Считывает топологию из sysfs.
+ */
+NumaTopology::NumaTopology()
+{
+    std::size_t cpusCount = std::thread::hardware_concurrency();
+#if defined(__linux__)
+    // Номера узлов могут идти с пропусками (узлы отключены
+    // или не заняты), поэтому перебираем список включённых узлов
+    const std::filesystem::path root("/sys/devices/system/node");
+    std::vector<std::size_t> nodes;
+    for (const char* name : {"online", "possible"}) {
+        std::ifstream file(root / name);
+        std::string list;
+        if (file && std::getline(file, list)) {
+            nodes = ParseList(list);
+            break;
+        }
+    }
+    for (auto node : nodes) {
+        std::ifstream file(root / ("node" + std::to_string(node)) / "cpulist");
+        std::string list;
+        if (!file || !std::getline(file, list)) {
+            continue;
+        }
+        // Узлы только с памятью не получают потоков и пропускаются
+        auto cpus = ParseList(list);
+        if (cpus.empty()) {
+            continue;
+        }
+        m_nodeIds.push_back(node);
+        m_nodeCpus.push_back(std::move(cpus));
+        for (auto cpu : m_nodeCpus.back()) {
+            if (cpu + 1 > cpusCount) {
+                cpusCount = cpu + 1;
+            }
+        }
+    }
+#endif
+    if (cpusCount == 0) {
+        cpusCount = 1;
+    }
+    // Если топология не прочитана, то вся машина - один узел
+    if (m_nodeCpus.empty()) {
+        m_nodeIds.assign(1, 0);
+        m_nodeCpus.emplace_back();
+        for (std::size_t cpu = 0; cpu < cpusCount; ++cpu) {
+            m_nodeCpus.back().push_back(cpu);
+        }
+    }
+    m_cpuNodes.assign(cpusCount, 0);
+    for (std::size_t node = 0; node < m_nodeCpus.size(); ++node) {
+        for (auto cpu : m_nodeCpus[node]) {
+            m_cpuNodes[cpu] = node;
+        }
+    }
+}
+
+/**
+ * Получение процессора, на котором выполняется текущий поток.
+ *
+ * \return Номер процессора
+ */
+std::size_t NumaTopology::CurrentCpu() const noexcept
+{
+#if defined(__linux__)
+    const int cpu = sched_getcpu();
+    if (cpu >= 0 && static_cast<std::size_t>(cpu) < m_cpuNodes.size()) {
+        return static_cast<std::size_t>(cpu);
+    }
+#endif
+    return 0;
+}
+
+/**
+ * Получение NUMA-узла, на котором выполняется текущий поток.
+ *
+ * \return Номер узла
+ */
+std::size_t NumaTopology::CurrentNode() const noexcept
+{
+    return m_cpuNodes[CurrentCpu()];
+}
+
+/**
+ * Привязка текущего потока к заданным процессорам.
+ *
+ * \param cpus Номера процессоров
+ * \return true - если привязка выполнена
+ */
+bool NumaTopology::BindThreadToCpus(
+    const std::vector<std::size_t>& cpus) const noexcept
+{
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (auto cpu : cpus) {
+        if (cpu < CPU_SETSIZE) {
+            CPU_SET(cpu, &set);
+        }
+    }
+    return !cpus.empty() && sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+    (void)cpus;
+    return false;
+#endif
+}
+
+/**
+ * Привязка выделения памяти текущего потока к NUMA-узлу.
+ * Используется системный вызов set_mempolicy напрямую,
+ * чтобы не зависеть от libnuma.
+ *
+ * \param node Номер узла, либо NodesCount() для сброса привязки
+ * \return true - если привязка выполнена
+ */
+bool NumaTopology::BindMemoryToNode(
+    const std::size_t node) const noexcept
+{
+#if defined(__linux__) && defined(SYS_set_mempolicy)
+    // Значения из linux/mempolicy.h
+    constexpr int kMemPolicyDefault = 0;
+    constexpr int kMemPolicyBind = 2;
+    if (node >= m_nodeCpus.size()) {
+        return syscall(SYS_set_mempolicy, kMemPolicyDefault, nullptr, 0) == 0;
+    }
+    // Маска узлов по системным номерам, по биту на узел
+    const auto id = m_nodeIds[node];
+    std::vector<unsigned long> mask(id / (8 * sizeof(unsigned long)) + 1, 0);
+    mask[id / (8 * sizeof(unsigned long))] |= 1ul << (id % (8 * sizeof(unsigned long)));
+    return syscall(SYS_set_mempolicy, kMemPolicyBind, mask.data(),
+        mask.size() * 8 * sizeof(unsigned long) + 1) == 0;
+#else
+    (void)node;
+    return false;
+#endif
+}
+
+}
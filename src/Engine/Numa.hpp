@@ -0,0 +1,102 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace ES
+{
+
+/**
+ * Топология NUMA-узлов машины.
+ * На системах без NUMA (и не на Linux) вся машина
+ * считается одним узлом.
+ * Узлы нумеруются подряд с нуля в порядке списка включённых узлов
+ * sysfs, системные номера которого могут идти с пропусками.
+ */
+class NumaTopology
+{
+public:
+    /**
+     * Получение топологии текущей машины.
+     * Топология считывается один раз при первом вызове.
+     *
+     * \return Топология
+     */
+    static const NumaTopology& Instance();
+
+    /**
+     * Получение количества NUMA-узлов.
+     *
+     * \return Количество узлов (не меньше 1)
+     */
+    std::size_t NodesCount() const noexcept
+    {
+        return m_nodeCpus.size();
+    }
+
+    /**
+     * Получение количества процессоров.
+     *
+     * \return Количество процессоров (не меньше 1)
+     */
+    std::size_t CpusCount() const noexcept
+    {
+        return m_cpuNodes.size();
+    }
+
+    /**
+     * Получение процессора, на котором выполняется текущий поток.
+     *
+     * \return Номер процессора
+     */
+    std::size_t CurrentCpu() const noexcept;
+
+    /**
+     * Получение NUMA-узла, на котором выполняется текущий поток.
+     *
+     * \return Номер узла
+     */
+    std::size_t CurrentNode() const noexcept;
+
+    /**
+     * Получение NUMA-узла процессора.
+     *
+     * \param cpu Номер процессора
+     * \return Номер узла
+     */
+    std::size_t NodeOf(
+        const std::size_t cpu) const noexcept
+    {
+        return cpu < m_cpuNodes.size() ? m_cpuNodes[cpu] : 0;
+    }
+
+    /**
+     * Привязка текущего потока к заданным процессорам.
+     *
+     * \param cpus Номера процессоров
+     * \return true - если привязка выполнена
+     */
+    bool BindThreadToCpus(
+        const std::vector<std::size_t>& cpus) const noexcept;
+
+    /**
+     * Привязка выделения памяти текущего потока к NUMA-узлу.
+     *
+     * \param node Номер узла, либо NodesCount() для сброса привязки
+     * \return true - если привязка выполнена
+     */
+    bool BindMemoryToNode(
+        const std::size_t node) const noexcept;
+
+private:
+    NumaTopology();
+
+    // Системный номер каждого узла
+    std::vector<std::size_t> m_nodeIds;
+    // Процессоры каждого узла
+    std::vector<std::vector<std::size_t>> m_nodeCpus;
+    // Узел каждого процессора
+    std::vector<std::size_t> m_cpuNodes;
+};
+
+}
@@ -0,0 +1,170 @@
+﻿#include "ParentIndex.hpp"
+
+#include <algorithm>
+
+namespace ES
+{
+
+/**
+ * Конструктор.
+ * Обход в ширину от корня находит достижимые узлы и их глубины,
+ * затем соединения достижимых вопросов раскладываются по приёмникам.
+ *
+ * \param tree Дерево
+ */
+ParentIndex::ParentIndex(
+    const Tree& tree)
+{
+    const auto count = static_cast<node_index_t>(tree.NodesCount());
+    m_offsets.assign(std::size_t(count) + 1, 0);
+    m_depths.assign(count, kUnreachable);
+    const auto root = tree.GetRoot();
+    if (!root) {
+        return;
+    }
+    m_root = root->Index();
+
+    // Соединение, по которому можно пройти ответом
+    const auto reachable = [&](const Question& question, const node_index_t child, const int answer)
+    {
+        return child < count && tree.GetNode(child) && question.GetNext(answer) == child;
+    };
+
+    // Обход в ширину: глубины и количество родителей
+    std::vector<node_index_t> queue;
+    queue.reserve(count);
+    queue.push_back(m_root);
+    m_depths[m_root] = 0;
+    for (std::size_t head = 0; head < queue.size(); ++head) {
+        const auto node = tree.GetNode(queue[head]);
+        if (node->Type() != NodeType::Question) {
+            continue;
+        }
+        const auto& question = *static_cast<const Question*>(node);
+        for (const auto& [child, predicat] : question.GetChildrens()) {
+            if (!reachable(question, child, predicat.value)) {
+                continue;
+            }
+            ++m_offsets[child + 1];
+            if (m_depths[child] == kUnreachable) {
+                m_depths[child] = m_depths[queue[head]] + 1;
+                queue.push_back(child);
+            }
+        }
+    }
+    for (node_index_t index = 0; index < count; ++index) {
+        m_offsets[index + 1] += m_offsets[index];
+    }
+
+    // Раскладываем соединения по приёмникам
+    m_parents.resize(m_offsets[count]);
+    auto positions = m_offsets;
+    for (const auto index : queue) {
+        const auto node = tree.GetNode(index);
+        if (node->Type() != NodeType::Question) {
+            continue;
+        }
+        const auto& question = *static_cast<const Question*>(node);
+        for (const auto& [child, predicat] : question.GetChildrens()) {
+            if (reachable(question, child, predicat.value)) {
+                m_parents[positions[child]++] = { index, predicat.value };
+            }
+        }
+    }
+}
+
+/**
+ * Получение всех путей от корня до узла.
+ * Обход в глубину по родителям: каждый родитель достижим
+ * из корня, поэтому при отсутствии циклов каждая ветвь
+ * обхода заканчивается путём.
+ *
+ * \param node Индекс узла
+ * \param limit Наибольшее количество путей
+ * \return Пути
+ */
+std::vector<ParentIndex::path_t> ParentIndex::Paths(
+    const node_index_t node,
+    const std::size_t limit) const
+{
+    std::vector<path_t> result;
+    if (node >= m_depths.size() || m_depths[node] == kUnreachable) {
+        return result;
+    }
+    // Текущий путь от узла к корню и номер следующего родителя
+    // последнего узла пути
+    path_t reversed;
+    std::vector<std::uint32_t> next{ m_offsets[node] };
+    std::vector<node_index_t> nodes{ node };
+    while (!nodes.empty()) {
+        const auto current = nodes.back();
+        if (current == m_root) {
+            result.emplace_back(reversed.rbegin(), reversed.rend());
+            if (result.size() == limit) {
+                break;
+            }
+        }
+        else if (next.back() < m_offsets[current + 1]) {
+            const auto& parent = m_parents[next.back()++];
+            // При циклах пропускаем узлы, уже находящиеся на пути
+            if (std::find(nodes.begin(), nodes.end(), parent.question) == nodes.end()) {
+                reversed.push_back(parent);
+                nodes.push_back(parent.question);
+                next.push_back(m_offsets[parent.question]);
+            }
+            continue;
+        }
+        nodes.pop_back();
+        next.pop_back();
+        if (!reversed.empty()) {
+            reversed.pop_back();
+        }
+    }
+    return result;
+}
+
+/**
+ * Получение кратчайшего пути от корня до узла.
+ * На каждом шаге выбирается родитель, глубина которого
+ * на единицу меньше глубины текущего узла.
+ *
+ * \param node Индекс узла
+ * \param path Путь
+ * \return false, если узел недостижим из корня
+ */
+bool ParentIndex::ShortestPath(
+    const node_index_t node,
+    path_t& path) const
+{
+    path.clear();
+    if (node >= m_depths.size() || m_depths[node] == kUnreachable) {
+        return false;
+    }
+    path.resize(m_depths[node]);
+    auto current = node;
+    while (current != m_root) {
+        const auto begin = m_parents.begin() + m_offsets[current];
+        const auto end = m_parents.begin() + m_offsets[current + 1];
+        const auto parent = std::find_if(begin, end, [&](const Step& step)
+        {
+            return m_depths[step.question] + 1 == m_depths[current];
+        });
+        path[m_depths[parent->question]] = *parent;
+        current = parent->question;
+    }
+    return true;
+}
+
+/**
+ * Получение объёма памяти, занятой индексом.
+ *
+ * \return Объём в байтах
+ */
+std::size_t ParentIndex::MemoryBytes() const noexcept
+{
+    return m_offsets.capacity() * sizeof(std::uint32_t)
+        + m_parents.capacity() * sizeof(Step)
+        + m_depths.capacity() * sizeof(std::uint32_t);
+}
+
+}
@@ -0,0 +1,90 @@
+﻿#pragma once
+
+#include "Tree.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ES
+{
+
+/**
+ * Обратный индекс дерева: для каждого узла - вопросы,
+ * из которых в него ведут соединения, и ответы на них.
+ * Хранится в сжатом виде: смещения по индексам узлов
+ * и один общий массив родителей. Учитываются только
+ * соединения, по которым можно пройти ответом (первое
+ * соединение вопроса с данным значением ответа), и только
+ * узлы, достижимые из корня, поэтому любой обратный путь
+ * из узла заканчивается в корне. Строится один раз после
+ * загрузки и разделяется всеми сеансами и копиями дерева.
+ */
+class ParentIndex final
+{
+public:
+    // Шаг пути: вопрос и ответ, ведущий к следующему узлу пути
+    struct Step
+    {
+        node_index_t question;
+        int answer;
+    };
+
+    // Путь от корня: шаги без самого конечного узла
+    using path_t = std::vector<Step>;
+
+    /**
+     * Конструктор. Строит обратные соединения и глубины узлов.
+     *
+     * \param tree Дерево
+     */
+    explicit ParentIndex(
+        const Tree& tree);
+
+    /**
+     * Получение всех путей от корня до узла.
+     * Время пропорционально размеру результата, если в дереве
+     * нет циклов. При циклах возвращаются только простые пути.
+     *
+     * \param node Индекс узла
+     * \param limit Наибольшее количество путей, 0 - без ограничения
+     * \return Пути в порядке обхода родителей
+     */
+    std::vector<path_t> Paths(
+        const node_index_t node,
+        const std::size_t limit) const;
+
+    /**
+     * Получение кратчайшего пути от корня до узла.
+     *
+     * \param node Индекс узла
+     * \param path Путь. Пустой, если узел - корень
+     * \return false, если узел недостижим из корня
+     */
+    bool ShortestPath(
+        const node_index_t node,
+        path_t& path) const;
+
+    /**
+     * Получение объёма памяти, занятой индексом.
+     *
+     * \return Объём в байтах
+     */
+    std::size_t MemoryBytes() const noexcept;
+
+private:
+    // Глубина недостижимого из корня узла
+    static constexpr std::uint32_t kUnreachable = ~std::uint32_t(0);
+
+    // Индекс корня
+    node_index_t m_root = kInvalidIndex;
+    // Начало родителей узла в m_parents, по индексам узлов.
+    // Родители узла i - [m_offsets[i], m_offsets[i + 1])
+    std::vector<std::uint32_t> m_offsets;
+    // Родители всех узлов
+    std::vector<Step> m_parents;
+    // Длина кратчайшего пути от корня, по индексам узлов
+    std::vector<std::uint32_t> m_depths;
+};
+
+}
@@ -0,0 +1,183 @@
+﻿#include "PathStack.hpp"
+
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace ES
+{
+
+namespace
+{
+
+// Количество классов ёмкости: от 2^0 до 2^31 узлов
+constexpr std::size_t kClassesCount = 32;
+// Количество буферов каждого класса, хранимых потоком
+constexpr std::size_t kLocalLimit = 16;
+
+/**
+ * Номер класса для ёмкости, округлённой до степени двойки.
+ *
+ * \param capacity Ёмкость (степень двойки)
+ * \return Номер класса
+ */
+std::size_t ClassOf(
+    std::uint32_t capacity) noexcept
+{
+    std::size_t result = 0;
+    while (capacity > 1) {
+        capacity >>= 1;
+        ++result;
+    }
+    return result;
+}
+
+/**
+ * Общий пул свободных буферов.
+ */
+struct SharedPool
+{
+    std::mutex mutex;
+    std::vector<node_index_t*> free[kClassesCount];
+};
+
+SharedPool& Shared()
+{
+    // Пул не разрушается, чтобы потоки могли вернуть
+    // в него буферы при завершении в любом порядке
+    static auto pool = new SharedPool();
+    return *pool;
+}
+
+/**
+ * Свободные буферы потока.
+ * При завершении потока буферы передаются в общий пул.
+ */
+struct LocalPool
+{
+    std::vector<node_index_t*> free[kClassesCount];
+
+    ~LocalPool()
+    {
+        auto& shared = Shared();
+        std::lock_guard<std::mutex> lock(shared.mutex);
+        for (std::size_t i = 0; i < kClassesCount; ++i) {
+            shared.free[i].insert(shared.free[i].end(), free[i].begin(), free[i].end());
+        }
+    }
+};
+
+thread_local LocalPool localPool;
+
+}
+
+/**
+ * Получение буфера.
+ * Сначала буфер ищется у потока, затем в общем пуле,
+ * и только потом выделяется.
+ *
+ * \param capacity Требуемая ёмкость в узлах
+ * \return Буфер
+ */
+node_index_t* PathPool::Acquire(
+    std::uint32_t& capacity)
+{
+    std::uint32_t rounded = 1;
+    while (rounded < capacity) {
+        rounded <<= 1;
+    }
+    capacity = rounded;
+    const auto sizeClass = ClassOf(rounded);
+    auto& local = localPool.free[sizeClass];
+    if (local.empty()) {
+        local.reserve(kLocalLimit);
+        auto& shared = Shared();
+        std::lock_guard<std::mutex> lock(shared.mutex);
+        auto& free = shared.free[sizeClass];
+        // Забираем сразу половину запаса потока, чтобы реже брать блокировку
+        while (!free.empty() && local.size() < kLocalLimit / 2) {
+            local.push_back(free.back());
+            free.pop_back();
+        }
+    }
+    if (!local.empty()) {
+        const auto buffer = local.back();
+        local.pop_back();
+        return buffer;
+    }
+    return static_cast<node_index_t*>(::operator new(rounded * sizeof(node_index_t)));
+}
+
+/**
+ * Возврат буфера в пул.
+ * Излишек буферов потока передаётся в общий пул.
+ *
+ * \param buffer Буфер
+ * \param capacity Ёмкость буфера
+ * \return
+ */
+void PathPool::Release(
+    node_index_t* buffer,
+    const std::uint32_t capacity) noexcept
+{
+    const auto sizeClass = ClassOf(capacity);
+    auto& local = localPool.free[sizeClass];
+    try {
+        if (local.size() >= kLocalLimit) {
+            // Излишек передаём в общий пул
+            auto& shared = Shared();
+            std::lock_guard<std::mutex> lock(shared.mutex);
+            auto& free = shared.free[sizeClass];
+            free.insert(free.end(), local.begin() + kLocalLimit / 2, local.end());
+            local.resize(kLocalLimit / 2);
+        }
+        local.reserve(kLocalLimit);
+        local.push_back(buffer);
+    }
+    catch (const std::bad_alloc&) {
+        // Пул не смог вырасти, буфер просто освобождаем
+        ::operator delete(buffer);
+    }
+}
+
+/**
+ * Деструктор. Возвращает буфер в пул.
+ */
+PathStack::~PathStack()
+{
+    Clear();
+}
+
+/**
+ * Очистка пути. Буфер возвращается в пул.
+ *
+ * \return
+ */
+void PathStack::Clear() noexcept
+{
+    if (m_capacity > kInlineDepth) {
+        PathPool::Release(m_buffer, m_capacity);
+        m_capacity = kInlineDepth;
+    }
+    m_size = 0;
+}
+
+/**
+ * Перенос пути в буфер вдвое большей ёмкости.
+ *
+ * \return
+ */
+void PathStack::Grow()
+{
+    auto capacity = m_capacity * 2;
+    const auto buffer = PathPool::Acquire(capacity);
+    std::memcpy(buffer, Data(), m_size * sizeof(node_index_t));
+    if (m_capacity > kInlineDepth) {
+        PathPool::Release(m_buffer, m_capacity);
+    }
+    m_buffer = buffer;
+    m_capacity = capacity;
+}
+
+}
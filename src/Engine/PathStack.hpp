@@ -0,0 +1,172 @@
+﻿#pragma once
+
+#include "Types.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+// Количество узлов пути, хранимых внутри сеанса без выделения памяти.
+// Задаётся при сборке параметром ES_INLINE_PATH_DEPTH
+#ifndef ES_INLINE_PATH_DEPTH
+#   define ES_INLINE_PATH_DEPTH 14
+#endif
+
+namespace ES
+{
+
+/**
+ * Пул буферов для путей, не поместившихся в сеанс.
+ * Буферы разбиты на классы по ёмкости (степени двойки).
+ * Освобождённые буферы не возвращаются системе, а переиспользуются
+ * другими сеансами, поэтому при установившейся нагрузке
+ * глубокие пути не выделяют память.
+ * Каждый поток держит несколько буферов каждого класса у себя,
+ * к общему пулу обращается только при их нехватке или избытке.
+ */
+class PathPool final
+{
+public:
+    /**
+     * Получение буфера.
+     *
+     * \param capacity Требуемая ёмкость в узлах. Округляется
+     * вверх до степени двойки
+     * \return Буфер ёмкостью не меньше capacity
+     */
+    static node_index_t* Acquire(
+        std::uint32_t& capacity);
+
+    /**
+     * Возврат буфера в пул.
+     *
+     * \param buffer Буфер, полученный методом Acquire
+     * \param capacity Ёмкость буфера, возвращённая методом Acquire
+     * \return
+     */
+    static void Release(
+        node_index_t* buffer,
+        const std::uint32_t capacity) noexcept;
+};
+
+/**
+ * Путь сеанса по дереву: индексы узлов от корня до текущего.
+ * Первые ES_INLINE_PATH_DEPTH узлов хранятся внутри объекта,
+ * более длинный путь переносится в буфер из PathPool.
+ * При значении по умолчанию объект занимает одну кэш-линию.
+ * Все операции, кроме переноса в буфер, выполняются за O(1).
+ */
+class PathStack final
+{
+public:
+    // Количество узлов, хранимых внутри объекта
+    static constexpr std::uint32_t kInlineDepth = ES_INLINE_PATH_DEPTH;
+
+    PathStack() noexcept = default;
+
+    ~PathStack();
+
+    PathStack(const PathStack&) = delete;
+
+    PathStack& operator=(const PathStack&) = delete;
+
+    /**
+     * Добавление узла в конец пути.
+     * Выделяет память, только если путь не помещается
+     * в объект и в пуле нет подходящего буфера.
+     *
+     * \param index Индекс узла
+     * \return
+     */
+    void Push(
+        const node_index_t index)
+    {
+        if (m_size == m_capacity) {
+            Grow();
+        }
+        Data()[m_size++] = index;
+    }
+
+    /**
+     * Укорачивание пути.
+     * Буфер сохраняется до вызова Clear.
+     *
+     * \param size Новая длина пути, не больше текущей
+     * \return
+     */
+    void Truncate(
+        const std::size_t size) noexcept
+    {
+        m_size = static_cast<std::uint32_t>(size);
+    }
+
+    /**
+     * Очистка пути. Буфер возвращается в пул.
+     *
+     * \return
+     */
+    void Clear() noexcept;
+
+    /**
+     * Получение длины пути.
+     *
+     * \return Количество узлов в пути
+     */
+    std::size_t Size() const noexcept
+    {
+        return m_size;
+    }
+
+    /**
+     * Получение узла пути.
+     *
+     * \param position Позиция узла от корня, меньше Size()
+     * \return Индекс узла
+     */
+    node_index_t operator[](
+        const std::size_t position) const noexcept
+    {
+        return Data()[position];
+    }
+
+    /**
+     * Получение последнего узла пути.
+     *
+     * \return Индекс последнего узла. Путь не должен быть пустым
+     */
+    node_index_t Top() const noexcept
+    {
+        return Data()[m_size - 1];
+    }
+
+private:
+    /**
+     * Перенос пути в буфер вдвое большей ёмкости.
+     *
+     * \return
+     */
+    void Grow();
+
+    node_index_t* Data() noexcept
+    {
+        return m_capacity > kInlineDepth ? m_buffer : m_inline;
+    }
+
+    const node_index_t* Data() const noexcept
+    {
+        return m_capacity > kInlineDepth ? m_buffer : m_inline;
+    }
+
+    // Длина пути
+    std::uint32_t m_size = 0;
+    // Ёмкость: kInlineDepth, либо ёмкость буфера из пула
+    std::uint32_t m_capacity = kInlineDepth;
+    union
+    {
+        // Узлы пути, пока он помещается в объект
+        node_index_t m_inline[kInlineDepth];
+        // Буфер из пула для длинного пути
+        node_index_t* m_buffer;
+    };
+};
+
+}
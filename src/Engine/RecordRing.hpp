@@ -0,0 +1,228 @@
+﻿#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace ES
+{
+
+/**
+ * Кольцевой буфер записей одного потока.
+ * Один писатель (поток сеансов) и один читатель (фоновый поток).
+ */
+template <typename Record>
+struct RecordRing
+{
+    explicit RecordRing(
+        const std::size_t capacity):
+        records(capacity),
+        mask(capacity - 1) {}
+
+    // Записи
+    std::vector<Record> records;
+    // Маска индекса (ёмкость - степень двойки)
+    const std::size_t mask;
+    // Позиция записи. Изменяется только писателем
+    alignas(64) std::atomic<std::uint64_t> head{0};
+    // Последняя известная писателю позиция чтения
+    std::uint64_t cachedTail = 0;
+    // Позиция чтения. Изменяется только читателем
+    alignas(64) std::atomic<std::uint64_t> tail{0};
+    // Буфер закреплён за потоком. Сбрасывается, когда поток
+    // завершается или начинает писать в другой набор буферов
+    std::atomic<bool> inUse{true};
+};
+
+/**
+ * Набор кольцевых буферов потоков одного читателя.
+ * Поток получает буфер при первой записи. Когда поток завершается,
+ * буфер освобождается, а после того как читатель заберёт из него
+ * записи, попадает в список свободных и достаётся следующему потоку.
+ * Поэтому буферов не больше, чем одновременно пишущих потоков,
+ * даже если потоки постоянно создаются заново.
+ */
+template <typename Record>
+class RecordRingPool final
+{
+public:
+    using ring_t = RecordRing<Record>;
+
+    /**
+     * Конструктор.
+     *
+     * \param owner Уникальный номер набора
+     * \param capacity Ёмкость буфера в записях
+     * (округляется вверх до степени двойки)
+     */
+    RecordRingPool(
+        const std::uint64_t owner,
+        const std::size_t capacity) noexcept:
+        m_owner(owner),
+        m_capacity(RoundCapacity(capacity))
+    {
+    }
+
+    /**
+     * Получение ёмкости буфера.
+     *
+     * \return Ёмкость в записях
+     */
+    std::size_t Capacity() const noexcept
+    {
+        return m_capacity;
+    }
+
+    /**
+     * Получение буфера текущего потока.
+     * Выделяет память только при первой записи потока в набор.
+     *
+     * \return Буфер, либо nullptr, если не удалось выделить память
+     */
+    ring_t* Local() noexcept
+    {
+        // Кэш буфера потока. Набор определяется уникальным номером,
+        // а не адресом, чтобы кэш не указывал на буфер удалённого набора.
+        // Буфер разделяется с набором, поэтому освобождение буфера
+        // при завершении потока безопасно, даже если набора уже нет
+        struct Cache
+        {
+            std::uint64_t owner = 0;
+            std::shared_ptr<ring_t> ring;
+
+            ~Cache()
+            {
+                Release();
+            }
+
+            void Release() noexcept
+            {
+                if (ring) {
+                    ring->inUse.store(false, std::memory_order_release);
+                    ring.reset();
+                }
+                owner = 0;
+            }
+        };
+        thread_local Cache cache;
+        if (cache.owner != m_owner) {
+            cache.Release();
+            cache.ring = Acquire();
+            if (!cache.ring) {
+                return nullptr;
+            }
+            cache.owner = m_owner;
+        }
+        return cache.ring.get();
+    }
+
+    /**
+     * Снимок списка буферов для читателя. Буферы остаются
+     * действительными до следующего вызова Recycle.
+     *
+     * \param rings Буферы
+     * \return
+     */
+    void Snapshot(
+        std::vector<ring_t*>& rings)
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        rings.clear();
+        for (const auto& ring : m_rings) {
+            rings.push_back(ring.get());
+        }
+    }
+
+    /**
+     * Перенос освобождённых потоками и прочитанных буферов
+     * в список свободных. Вызывается читателем.
+     *
+     * \return
+     */
+    void Recycle()
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        for (auto it = m_rings.begin(); it != m_rings.end();) {
+            auto& ring = **it;
+            if (ring.inUse.load(std::memory_order_acquire)
+                || ring.tail.load(std::memory_order_relaxed) != ring.head.load(std::memory_order_relaxed)) {
+                ++it;
+                continue;
+            }
+            m_free.push_back(std::move(*it));
+            it = m_rings.erase(it);
+        }
+    }
+
+    /**
+     * Получение количества буферов, включая свободные.
+     *
+     * \return Количество буферов
+     */
+    std::size_t Size() const
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        return m_rings.size() + m_free.size();
+    }
+
+private:
+    /**
+     * Округление ёмкости вверх до степени двойки.
+     *
+     * \param capacity Ёмкость
+     * \return Округлённая ёмкость
+     */
+    static std::size_t RoundCapacity(
+        const std::size_t capacity) noexcept
+    {
+        std::size_t rounded = 1;
+        while (rounded < capacity) {
+            rounded <<= 1;
+        }
+        return rounded;
+    }
+
+    /**
+     * Выдача свободного или нового буфера.
+     *
+     * \return Буфер, либо nullptr, если не удалось выделить память
+     */
+    std::shared_ptr<ring_t> Acquire() noexcept
+    {
+        try {
+            std::lock_guard<std::mutex> lock(m_lock);
+            m_rings.reserve(m_rings.size() + 1);
+            std::shared_ptr<ring_t> ring;
+            if (m_free.empty()) {
+                ring = std::make_shared<ring_t>(m_capacity);
+            }
+            else {
+                ring = std::move(m_free.back());
+                m_free.pop_back();
+                ring->inUse.store(true, std::memory_order_relaxed);
+            }
+            m_rings.push_back(ring);
+            return ring;
+        }
+        catch (const std::bad_alloc&) {
+            return nullptr;
+        }
+    }
+
+    // Уникальный номер набора
+    const std::uint64_t m_owner;
+    // Ёмкость буфера
+    const std::size_t m_capacity;
+    // Мьютекс списков буферов
+    mutable std::mutex m_lock;
+    // Буферы, из которых читает читатель
+    std::vector<std::shared_ptr<ring_t>> m_rings;
+    // Свободные буферы
+    std::vector<std::shared_ptr<ring_t>> m_free;
+};
+
+}
@@ -0,0 +1,103 @@
+﻿#include "ReplicaSet.hpp"
+#include "Numa.hpp"
+
+#include <exception>
+#include <thread>
+
+namespace ES
+{
+
+/**
+ * Построение копий дерева.
+ *
+ * \param tree Исходное дерево
+ * \param options Параметры репликации
+ */
+ReplicaSet::ReplicaSet(
+    const std::shared_ptr<const Tree>& tree,
+    const ReplicationOptions& options) noexcept(false)
+{
+    const auto& topology = NumaTopology::Instance();
+    const std::size_t cpus = topology.CpusCount();
+    // Определяем количество копий и распределение процессоров по копиям:
+    // по NUMA-узлам, либо равными группами соседних процессоров
+    std::size_t count = 1;
+    if (options.mode == ReplicationMode::PerNumaNode) {
+        count = topology.NodesCount();
+    }
+    else if (options.mode == ReplicationMode::PerThreadGroup) {
+        count = options.groups ? options.groups : topology.NodesCount();
+        if (count > cpus) {
+            count = cpus;
+        }
+    }
+    m_cpuReplica.resize(cpus);
+    std::vector<std::vector<std::size_t>> replicaCpus(count);
+    for (std::size_t cpu = 0; cpu < cpus; ++cpu) {
+        m_cpuReplica[cpu] = options.mode == ReplicationMode::PerNumaNode
+            ? topology.NodeOf(cpu)
+            : cpu * count / cpus;
+        replicaCpus[m_cpuReplica[cpu]].push_back(cpu);
+    }
+    m_replicas.resize(count);
+    // Единственная копия - это исходное дерево
+    if (count == 1) {
+        m_replicas[0] = tree;
+        return;
+    }
+    // Строим каждую копию в потоке, привязанном к процессорам копии
+    std::vector<std::thread> builders;
+    std::vector<std::exception_ptr> errors(count);
+    for (std::size_t replica = 0; replica < count; ++replica) {
+        builders.emplace_back([&, replica]
+        {
+            try {
+                // Память копии выделяется на узле процессоров копии
+                // при первом обращении к ней из привязанного потока
+                const auto& cpus = replicaCpus[replica];
+                topology.BindThreadToCpus(cpus);
+                if (options.placement == ReplicaPlacement::Bind && !cpus.empty()) {
+                    topology.BindMemoryToNode(topology.NodeOf(cpus.front()));
+                }
+                m_replicas[replica] = tree->Clone();
+            }
+            catch (...) {
+                errors[replica] = std::current_exception();
+            }
+        });
+    }
+    for (auto& builder : builders) {
+        builder.join();
+    }
+    for (const auto& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+/**
+ * Получение копии, локальной для процессора текущего потока.
+ *
+ * \return Локальная копия дерева
+ */
+const Tree* ReplicaSet::Local() const noexcept
+{
+    return m_replicas[m_cpuReplica[NumaTopology::Instance().CurrentCpu()]].get();
+}
+
+/**
+ * Получение памяти, занятой всеми копиями.
+ *
+ * \return Размер в байтах
+ */
+std::size_t ReplicaSet::MemoryBytes() const noexcept
+{
+    std::size_t bytes = 0;
+    for (const auto& replica : m_replicas) {
+        bytes += replica->Memory().total;
+    }
+    return bytes;
+}
+
+}
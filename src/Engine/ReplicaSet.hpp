@@ -0,0 +1,67 @@
+﻿#pragma once
+
+#include "IExpertSystem.hpp"
+#include "Tree.hpp"
+
+#include <memory>
+#include <vector>
+
+namespace ES
+{
+
+/**
+ * Набор копий дерева, размещённых на разных NUMA-узлах
+ * или группах процессоров.
+ * Копии неизменяемы, поэтому набор разделяется
+ * всеми сеансами без синхронизации.
+ */
+class ReplicaSet final
+{
+public:
+    /**
+     * Построение копий дерева.
+     * Каждая копия строится отдельным потоком, привязанным
+     * к процессорам своего узла, чтобы память копии
+     * была выделена на этом узле.
+     *
+     * \param tree Исходное дерево
+     * \param options Параметры репликации
+     */
+    ReplicaSet(
+        const std::shared_ptr<const Tree>& tree,
+        const ReplicationOptions& options) noexcept(false);
+
+    /**
+     * Получение копии, локальной для процессора текущего потока.
+     * Не выделяет память и не изменяет счётчики ссылок.
+     *
+     * \return Локальная копия дерева
+     */
+    const Tree* Local() const noexcept;
+
+    /**
+     * Получение количества копий.
+     *
+     * \return Количество копий
+     */
+    std::size_t Count() const noexcept
+    {
+        return m_replicas.size();
+    }
+
+    /**
+     * Получение памяти, занятой всеми копиями.
+     * Сжатые тексты копии разделяют с исходным деревом и не учитываются.
+     *
+     * \return Размер в байтах
+     */
+    std::size_t MemoryBytes() const noexcept;
+
+private:
+    // Копии дерева
+    std::vector<std::shared_ptr<const Tree>> m_replicas;
+    // Номер копии для каждого процессора
+    std::vector<std::size_t> m_cpuReplica;
+};
+
+}
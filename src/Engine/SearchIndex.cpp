@@ -0,0 +1,799 @@
+﻿#include "SearchIndex.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <optional>
+#include <unordered_set>
+
+namespace ES
+{
+
+// Параметры ранжирования BM25 для слов, встречающихся в тексте один раз
+static constexpr float kTermSaturation = 1.2f;
+static constexpr float kLengthInfluence = 0.75f;
+// Наибольшая длина слова в байтах. Более длинные слова не индексируются
+static constexpr std::size_t kMaxWordLength = 64;
+// Количество узлов в первой группе слов самого редкого слова запроса
+static constexpr std::size_t kMinBatch = 64;
+
+/**
+ * Приведение символа к виду, в котором он хранится в словаре.
+ *
+ * \param code Код символа
+ * \return Код символа в нижнем регистре, либо 0, если символ не входит в слова
+ */
+static std::uint32_t FoldCharacter(
+    const std::uint32_t code) noexcept
+{
+    if ((code >= '0' && code <= '9') || (code >= 'a' && code <= 'z')) {
+        return code;
+    }
+    if (code >= 'A' && code <= 'Z') {
+        return code + ('a' - 'A');
+    }
+    // Буквы Latin-1
+    if (code >= 0xC0 && code <= 0xFF && code != 0xD7 && code != 0xF7) {
+        return code <= 0xDE ? code + 0x20 : code;
+    }
+    // Кириллица: Ѐ-Џ, А-Я, а-я, ѐ-џ. Ё и ё приводятся к е
+    if (code >= 0x400 && code <= 0x45F) {
+        auto lower = code < 0x410 ? code + 0x50 : code < 0x430 ? code + 0x20 : code;
+        return lower == 0x451 ? 0x435 : lower;
+    }
+    // Остальная кириллица: пары заглавных и строчных букв
+    if ((code >= 0x460 && code <= 0x481) || (code >= 0x48A && code <= 0x4BF)) {
+        return code | 1;
+    }
+    if (code >= 0x4C0 && code <= 0x4FF) {
+        return code;
+    }
+    return 0;
+}
+
+/**
+ * Декодирование числа переменной длины.
+ *
+ * \param data Указатель на число. Сдвигается за его конец
+ * \return Число
+ */
+static std::uint32_t ReadVarint(
+    const std::uint8_t*& data) noexcept
+{
+    std::uint32_t value = *data & 0x7F;
+    for (std::uint32_t shift = 7; *data++ & 0x80; shift += 7) {
+        value |= std::uint32_t(*data & 0x7F) << shift;
+    }
+    return value;
+}
+
+/**
+ * Кодирование числа переменной длины.
+ *
+ * \param value Число
+ * \param out Буфер
+ * \return
+ */
+static void WriteVarint(
+    std::uint32_t value,
+    std::vector<std::uint8_t>& out)
+{
+    while (value >= 0x80) {
+        out.push_back(static_cast<std::uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<std::uint8_t>(value));
+}
+
+/**
+ * Курсор по списку узлов слова.
+ * Узлы декодируются по одному, а SkipTo перепрыгивает
+ * блоки, целиком лежащие до искомого узла.
+ */
+class SearchIndex::Cursor
+{
+public:
+    /**
+     * Конструктор. Курсор встаёт на первый узел списка.
+     *
+     * \param index Индекс
+     * \param term Номер слова
+     */
+    Cursor(
+        const SearchIndex& index,
+        const std::uint32_t term) noexcept:
+        m_data(index.m_postings.data() + index.m_postingOffsets[term]),
+        m_postings(index.m_postings.data()),
+        m_skips(index.m_skips.data() + index.m_skipOffsets[term]),
+        m_skipsCount(index.m_skipOffsets[term + 1] - index.m_skipOffsets[term]),
+        m_count(index.m_counts[term])
+    {
+        m_node = ReadVarint(m_data);
+    }
+
+    /**
+     * Получение текущего узла.
+     *
+     * \return Номер узла
+     */
+    node_index_t Node() const noexcept
+    {
+        return m_node;
+    }
+
+    /**
+     * Переход к следующему узлу.
+     *
+     * \return false, если список закончился
+     */
+    bool Next() noexcept
+    {
+        if (++m_position >= m_count) {
+            return false;
+        }
+        m_node += ReadVarint(m_data);
+        return true;
+    }
+
+    /**
+     * Переход к первому узлу, не меньшему заданного.
+     *
+     * \param target Номер узла
+     * \return false, если такого узла в списке нет
+     */
+    bool SkipTo(
+        const node_index_t target) noexcept
+    {
+        if (m_position >= m_count) {
+            return false;
+        }
+        if (m_node >= target) {
+            return true;
+        }
+        // Последний блок, начинающийся до искомого узла
+        const auto block = m_position / kBlockSize;
+        if (block + 1 < m_skipsCount && m_skips[block + 1].base < target) {
+            const auto next = std::partition_point(m_skips + block + 1, m_skips + m_skipsCount,
+                [target](const Skip& skip) { return skip.base < target; }) - 1;
+            m_position = static_cast<std::uint32_t>(next - m_skips) * kBlockSize;
+            m_data = m_postings + next->offset;
+            m_node = next->base + ReadVarint(m_data);
+        }
+        while (m_node < target) {
+            if (!Next()) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    // Следующее число списка
+    const std::uint8_t* m_data;
+    // Начало всех списков
+    const std::uint8_t* m_postings;
+    // Таблица пропуска блоков
+    const Skip* m_skips;
+    std::uint32_t m_skipsCount;
+    // Длина списка
+    std::uint32_t m_count;
+    // Номер текущего узла в списке
+    std::uint32_t m_position = 0;
+    // Текущий узел
+    node_index_t m_node = 0;
+};
+
+/**
+ * Разбиение текста на слова.
+ * Некорректные последовательности UTF-8 разделяют слова.
+ *
+ * \param text Текст в UTF-8
+ * \param words Слова
+ * \param ends Смещения концов слов в words
+ * \return
+ */
+void SearchIndex::Tokenize(
+    const std::string_view text,
+    std::string& words,
+    std::vector<std::uint32_t>& ends)
+{
+    words.clear();
+    ends.clear();
+    const auto finishWord = [&words, &ends]() {
+        const std::size_t start = ends.empty() ? 0 : ends.back();
+        if (words.size() - start > kMaxWordLength) {
+            words.resize(start);
+        }
+        else if (words.size() > start) {
+            ends.push_back(static_cast<std::uint32_t>(words.size()));
+        }
+    };
+    const auto bytes = reinterpret_cast<const unsigned char*>(text.data());
+    const auto continuation = [bytes](const std::size_t i) {
+        return (bytes[i] & 0xC0) == 0x80;
+    };
+    for (std::size_t i = 0; i < text.size();) {
+        const auto lead = bytes[i];
+        std::uint32_t code = 0;
+        if (lead < 0x80) {
+            code = lead;
+            i += 1;
+        }
+        else if ((lead & 0xE0) == 0xC0 && i + 1 < text.size() && continuation(i + 1)) {
+            code = (std::uint32_t(lead & 0x1F) << 6) | (bytes[i + 1] & 0x3F);
+            i += 2;
+        }
+        else if ((lead & 0xF0) == 0xE0 && i + 2 < text.size()
+            && continuation(i + 1) && continuation(i + 2)) {
+            code = (std::uint32_t(lead & 0x0F) << 12)
+                | (std::uint32_t(bytes[i + 1] & 0x3F) << 6) | (bytes[i + 2] & 0x3F);
+            i += 3;
+        }
+        else {
+            i += 1;
+        }
+        code = FoldCharacter(code);
+        if (!code) {
+            finishWord();
+        }
+        else if (code < 0x80) {
+            words.push_back(static_cast<char>(code));
+        }
+        else {
+            words.push_back(static_cast<char>(0xC0 | (code >> 6)));
+            words.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+        }
+    }
+    finishWord();
+}
+
+/**
+ * Конструктор. Строит индекс по текстам узлов дерева.
+ *
+ * \param tree Дерево
+ */
+SearchIndex::SearchIndex(
+    const Tree& tree):
+    SearchIndex(tree.NodesCount(), [&tree](const node_index_t index, std::string_view& text) {
+        const auto node = tree.GetNode(index);
+        if (node) {
+            text = node->Data();
+        }
+        return node != nullptr;
+    })
+{
+}
+
+/**
+ * Конструктор. Строит индекс по текстам узлов.
+ * Тексты разбиваются на слова за один проход, слова собираются
+ * в хеш-таблицу, а номера слов каждого узла запоминаются подряд.
+ * Затем узлы нумеруются по длине текста, списки узлов раскладываются
+ * подсчётом по словам, словарь сортируется, и списки кодируются
+ * в порядке словаря.
+ *
+ * \param nodes Количество узлов
+ * \param texts Получение текста узла
+ */
+SearchIndex::SearchIndex(
+    const std::size_t nodes,
+    const texts_t& texts):
+    m_nodes(nodes)
+{
+    // Словарь на время построения: слова подряд и хеш-таблица номеров
+    std::string pool;
+    std::vector<std::uint32_t> poolOffsets{0};
+    std::vector<std::uint32_t> hashes;
+    std::vector<std::uint32_t> table(1024, ~std::uint32_t(0));
+    // Номера слов узлов подряд и начало слов каждого узла
+    std::vector<std::uint32_t> occurrences;
+    std::vector<std::uint32_t> nodeStarts(m_nodes + 1, 0);
+    // Последний узел, в котором встретилось слово, и количество узлов слова
+    std::vector<std::uint32_t> lastNode;
+    std::vector<std::uint32_t> counts;
+    std::vector<std::uint16_t> lengths(m_nodes, 0);
+    std::size_t totalLength = 0;
+    std::size_t liveNodes = 0;
+
+    std::string words;
+    std::vector<std::uint32_t> ends;
+    for (std::size_t i = 0; i < m_nodes; ++i) {
+        nodeStarts[i] = static_cast<std::uint32_t>(occurrences.size());
+        std::string_view text;
+        if (!texts(static_cast<node_index_t>(i), text)) {
+            continue;
+        }
+        ++liveNodes;
+        Tokenize(text, words, ends);
+        lengths[i] = static_cast<std::uint16_t>(std::min<std::size_t>(ends.size(), 0xFFFF));
+        totalLength += lengths[i];
+        std::uint32_t begin = 0;
+        for (const auto end : ends) {
+            const std::string_view word(words.data() + begin, end - begin);
+            begin = end;
+            // FNV-1a
+            std::uint32_t hash = 2166136261u;
+            for (const auto c : word) {
+                hash = (hash ^ static_cast<unsigned char>(c)) * 16777619u;
+            }
+            const auto mask = table.size() - 1;
+            auto slot = hash & mask;
+            std::uint32_t term = table[slot];
+            while (term != ~std::uint32_t(0)
+                && (hashes[term] != hash || std::string_view(pool).substr(
+                    poolOffsets[term], poolOffsets[term + 1] - poolOffsets[term]) != word)) {
+                slot = (slot + 1) & mask;
+                term = table[slot];
+            }
+            if (term == ~std::uint32_t(0)) {
+                term = static_cast<std::uint32_t>(counts.size());
+                table[slot] = term;
+                pool.append(word);
+                poolOffsets.push_back(static_cast<std::uint32_t>(pool.size()));
+                hashes.push_back(hash);
+                counts.push_back(0);
+                lastNode.push_back(~std::uint32_t(0));
+                // Держим заполнение таблицы не больше половины
+                if (counts.size() * 2 > table.size()) {
+                    std::vector<std::uint32_t> grown(table.size() * 2, ~std::uint32_t(0));
+                    const auto grownMask = grown.size() - 1;
+                    for (std::uint32_t t = 0; t < counts.size(); ++t) {
+                        auto s = hashes[t] & grownMask;
+                        while (grown[s] != ~std::uint32_t(0)) {
+                            s = (s + 1) & grownMask;
+                        }
+                        grown[s] = t;
+                    }
+                    table.swap(grown);
+                }
+            }
+            // Слово, повторившееся в тексте узла, учитываем один раз
+            if (lastNode[term] != i) {
+                lastNode[term] = static_cast<std::uint32_t>(i);
+                ++counts[term];
+                occurrences.push_back(term);
+            }
+        }
+    }
+    nodeStarts[m_nodes] = static_cast<std::uint32_t>(occurrences.size());
+    table = {};
+    hashes = {};
+    lastNode = {};
+
+    // Нумеруем узлы по возрастанию длины текста, то есть по убыванию
+    // поправки на длину, а узлы одной длины - по возрастанию индексов.
+    // Подсчёт сохраняет порядок индексов внутри длины
+    std::vector<std::uint32_t> lengthStarts(0x10001, 0);
+    for (std::size_t i = 0; i < m_nodes; ++i) {
+        ++lengthStarts[lengths[i] + 1];
+    }
+    std::partial_sum(lengthStarts.begin(), lengthStarts.end(), lengthStarts.begin());
+    m_order.resize(m_nodes);
+    for (std::size_t i = 0; i < m_nodes; ++i) {
+        m_order[lengthStarts[lengths[i]]++] = static_cast<node_index_t>(i);
+    }
+    lengthStarts = {};
+
+    // Раскладываем узлы по словам. Узлы перебираются по возрастанию
+    // номеров, поэтому списки получаются отсортированными
+    const auto termsCount = counts.size();
+    std::vector<std::uint32_t> starts(termsCount + 1, 0);
+    for (std::size_t t = 0; t < termsCount; ++t) {
+        starts[t + 1] = starts[t] + counts[t];
+    }
+    std::vector<node_index_t> postings(occurrences.size());
+    {
+        auto positions = starts;
+        for (std::size_t rank = 0; rank < m_nodes; ++rank) {
+            const auto i = m_order[rank];
+            for (auto k = nodeStarts[i]; k < nodeStarts[i + 1]; ++k) {
+                postings[positions[occurrences[k]]++] = static_cast<node_index_t>(rank);
+            }
+        }
+    }
+    occurrences = {};
+    nodeStarts = {};
+
+    // Сортируем словарь и кодируем списки в его порядке
+    std::vector<std::uint32_t> order(termsCount);
+    std::iota(order.begin(), order.end(), 0);
+    const auto poolTerm = [&pool, &poolOffsets](const std::uint32_t t) {
+        return std::string_view(pool).substr(poolOffsets[t], poolOffsets[t + 1] - poolOffsets[t]);
+    };
+    std::sort(order.begin(), order.end(), [&poolTerm](const std::uint32_t a, const std::uint32_t b) {
+        return poolTerm(a) < poolTerm(b);
+    });
+    m_terms.reserve(pool.size());
+    m_termOffsets.reserve(termsCount + 1);
+    m_counts.reserve(termsCount);
+    m_countSums.reserve(termsCount + 1);
+    m_postingOffsets.reserve(termsCount + 1);
+    m_skipOffsets.reserve(termsCount + 1);
+    m_postings.reserve(postings.size() + postings.size() / 2);
+    for (const auto t : order) {
+        m_terms.append(poolTerm(t));
+        m_termOffsets.push_back(static_cast<std::uint32_t>(m_terms.size()));
+        m_counts.push_back(counts[t]);
+        m_countSums.push_back(m_countSums.back() + counts[t]);
+        node_index_t previous = 0;
+        for (auto k = starts[t]; k < starts[t + 1]; ++k) {
+            const auto position = k - starts[t];
+            if (position % kBlockSize == 0 && counts[t] > kBlockSize) {
+                m_skips.push_back({ previous, static_cast<std::uint32_t>(m_postings.size()) });
+            }
+            WriteVarint(postings[k] - previous, m_postings);
+            previous = postings[k];
+        }
+        m_postingOffsets.push_back(static_cast<std::uint32_t>(m_postings.size()));
+        m_skipOffsets.push_back(static_cast<std::uint32_t>(m_skips.size()));
+    }
+    m_postings.shrink_to_fit();
+    m_skips.shrink_to_fit();
+
+    // Поправки на длину текста
+    const float averageLength = liveNodes && totalLength
+        ? float(totalLength) / float(liveNodes) : 1.0f;
+    m_norms.resize(m_nodes);
+    for (std::size_t rank = 0; rank < m_nodes; ++rank) {
+        m_norms[rank] = (kTermSaturation + 1) / (1 + kTermSaturation
+            * (1 - kLengthInfluence + kLengthInfluence * float(lengths[m_order[rank]]) / averageLength));
+        m_maxNorm = std::max(m_maxNorm, m_norms[rank]);
+    }
+}
+
+/**
+ * Поиск диапазона слов словаря с заданным префиксом.
+ *
+ * \param prefix Префикс
+ * \return Первое слово и слово за последним
+ */
+std::pair<std::uint32_t, std::uint32_t> SearchIndex::PrefixRange(
+    const std::string_view prefix) const noexcept
+{
+    const auto count = static_cast<std::uint32_t>(m_counts.size());
+    std::uint32_t first = 0;
+    for (auto length = count; length > 0;) {
+        const auto half = length / 2;
+        if (Term(first + half) < prefix) {
+            first += half + 1;
+            length -= half + 1;
+        }
+        else {
+            length = half;
+        }
+    }
+    std::uint32_t last = first;
+    for (auto length = count - first; length > 0;) {
+        const auto half = length / 2;
+        if (Term(last + half).substr(0, prefix.size()) == prefix) {
+            last += half + 1;
+            length -= half + 1;
+        }
+        else {
+            length = half;
+        }
+    }
+    return { first, last };
+}
+
+/**
+ * Вес совпадения слова запроса со словом словаря.
+ * Редкие слова весят больше. Совпадение по префиксу
+ * весит тем меньше, чем меньшую часть слова покрывает префикс.
+ *
+ * \param term Номер слова словаря
+ * \param length Длина слова запроса в байтах
+ * \return Вес
+ */
+float SearchIndex::Weight(
+    const std::uint32_t term,
+    const std::size_t length) const noexcept
+{
+    const auto count = float(m_counts[term]);
+    const auto idf = std::log(1.0f + (float(m_nodes) - count + 0.5f) / (count + 0.5f));
+    const auto termLength = m_termOffsets[term + 1] - m_termOffsets[term];
+    return termLength == length ? idf : idf * (0.5f + 0.5f * float(length) / float(termLength));
+}
+
+/**
+ * Поиск узлов, тексты которых содержат все слова запроса.
+ * Лучшие узлы держатся в куче из limit узлов с худшим узлом наверху.
+ * Слова словаря каждого слова запроса упорядочены по убыванию веса.
+ * Узлы перебираются группами слов словаря, и узлы группы сверяются
+ * со списками остальных слов запроса, тоже по убыванию веса.
+ * Перед сверкой оценивается наибольшая релевантность, которую узел
+ * ещё может получить: если она не лучше худшего узла кучи, то узел
+ * отбрасывается, не дочитывая остальные списки. Узлы в списках идут
+ * по убыванию поправки на длину текста, поэтому чтение списка
+ * заканчивается на первом узле, который не лучше худшего узла кучи
+ * даже с наибольшими весами, а длинные списки читаются по частям.
+ * Перебор заканчивается, когда так оцениваются все ещё не перебранные
+ * слова словаря, поэтому длинные списки частых слов обычно
+ * не читаются целиком.
+ *
+ * \param query Запрос
+ * \param limit Наибольшее количество результатов
+ * \return Найденные узлы по убыванию релевантности
+ */
+std::vector<SearchIndex::Hit> SearchIndex::Search(
+    const std::string_view query,
+    const std::size_t limit) const
+{
+    std::vector<Hit> hits;
+    std::string words;
+    std::vector<std::uint32_t> ends;
+    Tokenize(query, words, ends);
+    if (!limit || ends.empty()) {
+        return hits;
+    }
+    // Слово запроса и соответствующий ему диапазон словаря
+    struct Token
+    {
+        std::string_view text;
+        std::uint32_t first;
+        std::uint32_t last;
+        std::uint64_t cost;
+    };
+    std::vector<Token> tokens;
+    std::uint32_t begin = 0;
+    for (const auto end : ends) {
+        const std::string_view text(words.data() + begin, end - begin);
+        begin = end;
+        if (std::any_of(tokens.begin(), tokens.end(),
+            [text](const Token& token) { return token.text == text; })) {
+            continue;
+        }
+        const auto [first, last] = PrefixRange(text);
+        if (first == last) {
+            return hits;
+        }
+        tokens.push_back({ text, first, last, m_countSums[last] - m_countSums[first] });
+    }
+    std::sort(tokens.begin(), tokens.end(),
+        [](const Token& a, const Token& b) { return a.cost < b.cost; });
+    const auto byScore = [](const Hit& a, const Hit& b) {
+        return a.score > b.score || (a.score == b.score && a.node < b.node);
+    };
+
+    // Слова словаря каждого слова запроса по убыванию веса, подряд.
+    // Слова k-го слова запроса начинаются с terms[starts[k]]
+    const auto count = tokens.size();
+    std::vector<std::pair<float, std::uint32_t>> terms;
+    std::vector<std::size_t> starts{0};
+    for (const auto& token : tokens) {
+        for (auto term = token.first; term < token.last; ++term) {
+            terms.emplace_back(Weight(term, token.text.size()), term);
+        }
+        std::sort(terms.begin() + starts.back(), terms.end(), std::greater<>());
+        starts.push_back(terms.size());
+    }
+    // Релевантность без поправки на длину текста - сумма весов слов
+    // запроса по порядку. Если вместо неизвестных весов подставить
+    // наибольшие, то сумма в том же порядке не меньше настоящей
+    const auto sum = [count](const float* weights) {
+        float score = 0;
+        for (std::size_t k = 0; k < count; ++k) {
+            score += weights[k];
+        }
+        return score;
+    };
+    // Узел не может попасть в полную кучу, если даже с наибольшей
+    // релевантностью он не лучше худшего узла кучи. Списки хранят
+    // номера узлов, а куча упорядочена по индексам
+    const auto rejected = [this, &hits, limit, &byScore](const node_index_t rank, const float score) {
+        return hits.size() == limit && !byScore({ m_order[rank], score }, hits.front());
+    };
+
+    // Узлы перебираются группами из слов словаря одного из слов запроса,
+    // каждый раз того, чьё следующее слово словаря короче всего. Узел,
+    // содержащий уже перебранное слово словаря, уже получил свою
+    // релевантность, поэтому релевантность нового узла не больше суммы
+    // весов следующих слов словаря всех слов запроса. Когда эта сумма
+    // не лучше худшего узла кучи либо слова одного из слов запроса
+    // кончились, поиск закончен. Длинный список читается по частям:
+    // курсор недочитанного слова словаря ждёт следующей группы
+    std::vector<std::size_t> next(starts.begin(), starts.end() - 1);
+    std::vector<std::optional<Cursor>> open(count);
+    std::vector<float> remaining(count);
+    // Узел, найденный повторно, уже получал не меньшую релевантность,
+    // поэтому повтор узла кучи пропускается
+    std::unordered_set<node_index_t> found;
+    // Кандидаты группы по возрастанию номеров и веса слов запроса
+    // каждого кандидата: известные, либо наибольшие возможные
+    std::vector<Hit> candidates;
+    std::vector<float> weights;
+    std::vector<float> upper(count);
+    std::vector<float> best;
+    const auto insert = [this, &hits, limit, &byScore, &rejected, &found](
+        const node_index_t rank,
+        const float score) {
+        if (rejected(rank, score) || !found.insert(m_order[rank]).second) {
+            return;
+        }
+        if (hits.size() == limit) {
+            std::pop_heap(hits.begin(), hits.end(), byScore);
+            found.erase(hits.back().node);
+            hits.pop_back();
+        }
+        hits.push_back({ m_order[rank], score });
+        std::push_heap(hits.begin(), hits.end(), byScore);
+    };
+    const auto byNode = [](const Hit& hit, const node_index_t node) { return hit.node < node; };
+    std::size_t batch = kMinBatch;
+    while (true) {
+        std::size_t source = count;
+        for (std::size_t k = 0; k < count; ++k) {
+            if (next[k] == starts[k + 1]) {
+                source = count;
+                break;
+            }
+            remaining[k] = terms[next[k]].first;
+            if (source == count
+                || m_counts[terms[next[k]].second] < m_counts[terms[next[source]].second]) {
+                source = k;
+            }
+        }
+        if (source == count
+            || (hits.size() == limit && hits.front().score > sum(remaining.data()) * m_maxNorm)) {
+            break;
+        }
+        // Читаем узлы, пока их не больше batch. Группы растут вдвое,
+        // чтобы частые слова читались только при необходимости и за
+        // немного проходов. Узлы, которые не попадут в кучу даже
+        // с наибольшими весами остальных слов, не запоминаются.
+        // Одно слово запроса сверять не с чем, поэтому его узлы
+        // сразу попадают в кучу
+        std::copy(remaining.begin(), remaining.end(), upper.begin());
+        const auto first = remaining[source];
+        std::size_t read = 0;
+        bool sorted = true;
+        candidates.clear();
+        do {
+            const auto weight = terms[next[source]].first;
+            upper[source] = weight;
+            const auto most = sum(upper.data());
+            if (!open[source]) {
+                open[source].emplace(*this, terms[next[source]].second);
+            }
+            auto& cursor = *open[source];
+            sorted = sorted && candidates.empty();
+            // Поправка на длину не возрастает с номером узла, поэтому
+            // после первого узла, не проходящего даже с наибольшими
+            // весами остальных слов, не пройдёт ни один
+            bool more = true;
+            while (true) {
+                const auto rank = cursor.Node();
+                const auto score = most * m_norms[rank];
+                if (hits.size() == limit && score < hits.front().score) {
+                    more = false;
+                    break;
+                }
+                if (count == 1) {
+                    insert(rank, weight * m_norms[rank]);
+                }
+                else if (!rejected(rank, score)) {
+                    candidates.push_back({ rank, weight });
+                }
+                ++read;
+                if (!cursor.Next()) {
+                    more = false;
+                    break;
+                }
+                if (count > 1 && read >= batch) {
+                    break;
+                }
+            }
+            if (more) {
+                break;
+            }
+            open[source].reset();
+            ++next[source];
+        } while (next[source] < starts[source + 1] && (count == 1 || read < batch));
+        batch *= 2;
+        upper[source] = first;
+        // Сверка с остальными словами требует порядка узлов,
+        // а узлы одного слова словаря уже упорядочены
+        if (!sorted) {
+            std::sort(candidates.begin(), candidates.end(), [](const Hit& a, const Hit& b) {
+                return a.node < b.node || (a.node == b.node && a.score > b.score);
+            });
+            candidates.erase(std::unique(candidates.begin(), candidates.end(),
+                [](const Hit& a, const Hit& b) { return a.node == b.node; }), candidates.end());
+        }
+        weights.resize(candidates.size() * count);
+        for (std::size_t c = 0; c < candidates.size(); ++c) {
+            std::copy(upper.begin(), upper.end(), weights.begin() + c * count);
+            weights[c * count + source] = candidates[c].score;
+        }
+        // Оставляем кандидатов, содержащих остальные слова запроса.
+        // Узлы уже перебранных слов словаря уже получили релевантность,
+        // поэтому сверяются только следующие слова. Они перебираются
+        // по убыванию веса, поэтому первое совпадение кандидата - лучшее,
+        // а каждый список сверяется с кандидатами со стороны меньшего
+        for (std::size_t k = 0; k < count && !candidates.empty(); ++k) {
+            if (k == source) {
+                continue;
+            }
+            best.assign(candidates.size(), 0.0f);
+            float norm = 0;
+            for (const auto& candidate : candidates) {
+                norm = std::max(norm, m_norms[candidate.node]);
+            }
+            std::size_t matched = 0;
+            for (auto i = next[k]; i < starts[k + 1] && matched < candidates.size(); ++i) {
+                const auto weight = terms[i].first;
+                upper[k] = weight;
+                if (hits.size() == limit && hits.front().score > sum(upper.data()) * norm) {
+                    break;
+                }
+                const auto match = [&](const std::size_t candidate) {
+                    if (!best[candidate]) {
+                        best[candidate] = weight;
+                        ++matched;
+                    }
+                };
+                Cursor cursor(*this, terms[i].second);
+                if (m_counts[terms[i].second] < candidates.size()) {
+                    auto position = candidates.begin();
+                    do {
+                        position = std::lower_bound(position, candidates.end(), cursor.Node(), byNode);
+                        if (position == candidates.end()) {
+                            break;
+                        }
+                        if (position->node == cursor.Node()) {
+                            match(static_cast<std::size_t>(position - candidates.begin()));
+                        }
+                    } while (cursor.Next());
+                }
+                else {
+                    for (std::size_t c = 0; c < candidates.size(); ++c) {
+                        if (!cursor.SkipTo(candidates[c].node)) {
+                            break;
+                        }
+                        if (cursor.Node() == candidates[c].node) {
+                            match(c);
+                        }
+                    }
+                }
+            }
+            std::size_t kept = 0;
+            upper[k] = 0;
+            for (std::size_t c = 0; c < candidates.size(); ++c) {
+                weights[c * count + k] = best[c];
+                if (best[c] > 0
+                    && !rejected(candidates[c].node, sum(&weights[c * count]) * m_norms[candidates[c].node])) {
+                    upper[k] = std::max(upper[k], best[c]);
+                    std::copy_n(weights.begin() + c * count, count, weights.begin() + kept * count);
+                    candidates[kept++] = candidates[c];
+                }
+            }
+            candidates.resize(kept);
+        }
+        for (std::size_t c = 0; c < candidates.size(); ++c) {
+            insert(candidates[c].node, sum(&weights[c * count]) * m_norms[candidates[c].node]);
+        }
+    }
+    std::sort_heap(hits.begin(), hits.end(), byScore);
+    return hits;
+}
+
+/**
+ * Получение объёма памяти, занятой индексом.
+ *
+ * \return Объём в байтах
+ */
+std::size_t SearchIndex::MemoryBytes() const noexcept
+{
+    return m_terms.capacity()
+        + m_termOffsets.capacity() * sizeof(std::uint32_t)
+        + m_counts.capacity() * sizeof(std::uint32_t)
+        + m_countSums.capacity() * sizeof(std::uint64_t)
+        + m_postingOffsets.capacity() * sizeof(std::uint32_t)
+        + m_skipOffsets.capacity() * sizeof(std::uint32_t)
+        + m_postings.capacity()
+        + m_skips.capacity() * sizeof(Skip)
+        + m_norms.capacity() * sizeof(float)
+        + m_order.capacity() * sizeof(node_index_t);
+}
+
+}
@@ -0,0 +1,201 @@
+﻿#pragma once
+
+#include "Tree.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ES
+{
+
+/**
+ * Полнотекстовый индекс по текстам вопросов и ответов.
+ * Тексты делятся на слова в UTF-8: словом считается непрерывная
+ * последовательность латинских и кириллических букв и цифр,
+ * регистр приводится к нижнему, а ё заменяется на е.
+ * Узлы нумеруются по возрастанию длины текста, то есть по убыванию
+ * поправки на длину. Для каждого слова хранится отсортированный
+ * список номеров узлов, в текстах которых оно встречается, поэтому
+ * лучшие узлы слова идут первыми. Списки закодированы
+ * разностями переменной длины блоками по kBlockSize узлов,
+ * а для длинных списков хранится таблица пропуска блоков.
+ * Слова словаря отсортированы, поэтому слова с заданным
+ * префиксом занимают непрерывный диапазон.
+ * Строится один раз после загрузки и разделяется всеми
+ * сеансами и копиями дерева.
+ */
+class SearchIndex final
+{
+public:
+    // Найденный узел
+    struct Hit
+    {
+        // Индекс узла
+        node_index_t node;
+        // Релевантность
+        float score;
+    };
+
+    /**
+     * Конструктор. Строит индекс по текстам узлов дерева.
+     * Тексты должны храниться в узлах, то есть индекс строится
+     * до их сжатия.
+     *
+     * \param tree Дерево
+     */
+    explicit SearchIndex(
+        const Tree& tree);
+
+    // Получение текста узла по индексу: false, если узла нет
+    using texts_t = std::function<bool(const node_index_t index, std::string_view& text)>;
+
+    /**
+     * Конструктор. Строит индекс по текстам узлов без дерева,
+     * например по текстам диагнозов и вопросов вероятностной модели.
+     *
+     * \param nodes Количество узлов
+     * \param texts Получение текста узла
+     */
+    SearchIndex(
+        const std::size_t nodes,
+        const texts_t& texts);
+
+    /**
+     * Поиск узлов, тексты которых содержат все слова запроса.
+     * Каждое слово запроса считается префиксом. Релевантность -
+     * сумма по словам запроса веса самого редкого совпавшего
+     * слова текста с поправкой на длину текста; точное совпадение
+     * весит больше совпадения по префиксу.
+     * Списки узлов читаются по убыванию веса слов словаря, начиная
+     * с коротких, а каждый список - по убыванию поправки на длину.
+     * Чтение заканчивается, как только оставшиеся узлы не могут
+     * оказаться лучше найденных limit узлов, поэтому списки частых
+     * слов обычно не читаются целиком. Кандидаты
+     * сверяются с остальными списками со стороны меньшего из них.
+     *
+     * \param query Запрос
+     * \param limit Наибольшее количество результатов
+     * \return Найденные узлы по убыванию релевантности
+     */
+    std::vector<Hit> Search(
+        const std::string_view query,
+        const std::size_t limit) const;
+
+    /**
+     * Получение количества слов в словаре.
+     *
+     * \return Количество слов
+     */
+    std::size_t TermsCount() const noexcept
+    {
+        return m_counts.size();
+    }
+
+    /**
+     * Получение объёма памяти, занятой индексом.
+     *
+     * \return Объём в байтах
+     */
+    std::size_t MemoryBytes() const noexcept;
+
+    /**
+     * Разбиение текста на слова.
+     * Слова приводятся к нижнему регистру и записываются
+     * подряд в words, границы слов - в ends.
+     *
+     * \param text Текст в UTF-8
+     * \param words Слова
+     * \param ends Смещения концов слов в words
+     * \return
+     */
+    static void Tokenize(
+        const std::string_view text,
+        std::string& words,
+        std::vector<std::uint32_t>& ends);
+
+private:
+    // Количество узлов в блоке списка
+    static constexpr std::uint32_t kBlockSize = 128;
+
+    // Начало блока в списке узлов
+    struct Skip
+    {
+        // Номер узла, от которого отсчитывается первая разность блока.
+        // Для первого блока - 0
+        node_index_t base;
+        // Смещение блока в m_postings
+        std::uint32_t offset;
+    };
+
+    /**
+     * Курсор по списку узлов слова.
+     */
+    class Cursor;
+
+    /**
+     * Получение слова словаря.
+     *
+     * \param term Номер слова
+     * \return Слово
+     */
+    std::string_view Term(
+        const std::uint32_t term) const noexcept
+    {
+        return std::string_view(m_terms).substr(
+            m_termOffsets[term], m_termOffsets[term + 1] - m_termOffsets[term]);
+    }
+
+    /**
+     * Поиск диапазона слов словаря с заданным префиксом.
+     *
+     * \param prefix Префикс
+     * \return Первое слово и слово за последним
+     */
+    std::pair<std::uint32_t, std::uint32_t> PrefixRange(
+        const std::string_view prefix) const noexcept;
+
+    /**
+     * Вес совпадения слова запроса со словом словаря.
+     *
+     * \param term Номер слова словаря
+     * \param length Длина слова запроса в байтах
+     * \return Вес
+     */
+    float Weight(
+        const std::uint32_t term,
+        const std::size_t length) const noexcept;
+
+    // Количество узлов дерева, включая удалённые
+    std::size_t m_nodes = 0;
+    // Слова словаря в порядке сортировки, записанные подряд
+    std::string m_terms;
+    // Смещения слов в m_terms. Последний элемент - размер m_terms
+    std::vector<std::uint32_t> m_termOffsets{0};
+    // Количество узлов каждого слова
+    std::vector<std::uint32_t> m_counts;
+    // Накопленные суммы m_counts для оценки стоимости диапазона слов
+    std::vector<std::uint64_t> m_countSums{0};
+    // Смещения списков узлов в m_postings.
+    // Последний элемент - размер m_postings
+    std::vector<std::uint32_t> m_postingOffsets{0};
+    // Смещения таблиц пропуска слов в m_skips.
+    // Таблица есть только у списков длиннее одного блока
+    std::vector<std::uint32_t> m_skipOffsets{0};
+    // Списки узлов, закодированные разностями
+    std::vector<std::uint8_t> m_postings;
+    // Таблицы пропуска блоков
+    std::vector<Skip> m_skips;
+    // Поправка на длину текста узла по номеру узла в списках.
+    // Не возрастает с номером
+    std::vector<float> m_norms;
+    // Индекс узла по номеру узла в списках
+    std::vector<node_index_t> m_order;
+    // Наибольшая поправка на длину текста
+    float m_maxNorm = 0;
+};
+
+}
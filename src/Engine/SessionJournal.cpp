@@ -0,0 +1,829 @@
+﻿#include "SessionJournal.hpp"
+#include "ILogger.hpp"
+#include "MappedFile.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+
+#if defined(_WIN32)
+#   include <fcntl.h>
+#   include <io.h>
+#   include <sys/stat.h>
+#else
+#   include <fcntl.h>
+#   include <sys/stat.h>
+#   include <unistd.h>
+#endif
+
+namespace ES
+{
+
+/**
+ * Заголовок файла журнала и контрольной точки.
+ */
+struct JournalFileHeader
+{
+    // Сигнатура
+    char magic[8];
+    // Размер записи
+    std::uint32_t recordSize;
+    // 0 - файл журнала, 1 - контрольная точка
+    std::uint32_t kind;
+    std::uint64_t reserved;
+};
+static_assert(sizeof(JournalFileHeader) == sizeof(JournalRecord),
+    "Records must stay aligned after the header");
+
+// Сигнатура файлов журнала
+constexpr char kJournalMagic[8] = { 'E', 'S', 'J', 'O', 'U', 'R', 'N', '1' };
+
+/**
+ * Счётчик идентификаторов сеансов.
+ *
+ * \return Счётчик
+ */
+static std::atomic<std::uint64_t>& SessionCounter() noexcept
+{
+    static std::atomic<std::uint64_t> counter{0};
+    return counter;
+}
+
+/**
+ * Получение идентификатора для нового сеанса.
+ *
+ * \return Идентификатор сеанса
+ */
+std::uint64_t NextSessionID() noexcept
+{
+    return ++SessionCounter();
+}
+
+/**
+ * Пропуск идентификаторов сеансов, уже занятых сохранёнными сеансами.
+ *
+ * \param last Наибольший занятый идентификатор
+ * \return
+ */
+void ReserveSessionIDs(
+    const std::uint64_t last) noexcept
+{
+    auto& counter = SessionCounter();
+    auto current = counter.load();
+    while (current < last && !counter.compare_exchange_weak(current, last)) {
+    }
+}
+
+/**
+ * Получение уникального номера для нового журнала.
+ *
+ * \return Номер журнала
+ */
+static std::uint64_t NextJournalID() noexcept
+{
+    static std::atomic<std::uint64_t> counter{0};
+    return ++counter;
+}
+
+/**
+ * Вычисление контрольной суммы записи (FNV-1a по полям до суммы).
+ *
+ * \param record Запись
+ * \return Контрольная сумма
+ */
+static std::uint32_t Checksum(
+    const JournalRecord& record) noexcept
+{
+    unsigned char bytes[offsetof(JournalRecord, checksum)];
+    std::memcpy(bytes, &record, sizeof(bytes));
+    std::uint32_t hash = 2166136261u;
+    for (const auto byte : bytes) {
+        hash = (hash ^ byte) * 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * Формирование пути к файлу журнала или контрольной точки.
+ *
+ * \param directory Каталог журнала
+ * \param prefix Префикс имени файла
+ * \param number Номер файла
+ * \return Путь к файлу
+ */
+static std::filesystem::path JournalFilePath(
+    const std::string& directory,
+    const char* prefix,
+    const std::uint64_t number)
+{
+    char name[48];
+    std::snprintf(name, sizeof(name), "%s-%08llu.bin", prefix,
+        static_cast<unsigned long long>(number));
+    return std::filesystem::path(directory) / name;
+}
+
+/**
+ * Создание файла для записи.
+ *
+ * \param path Путь к файлу
+ * \return Дескриптор файла
+ */
+static int CreateJournalFile(
+    const std::filesystem::path& path)
+{
+#if defined(_WIN32)
+    const int file = _wopen(path.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY,
+        _S_IREAD | _S_IWRITE);
+#else
+    const int file = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+#endif
+    if (file < 0) {
+        throw std::runtime_error(u8"Не удалось создать файл журнала " + path.string());
+    }
+    return file;
+}
+
+/**
+ * Запись в файл целиком.
+ *
+ * \param file Дескриптор файла
+ * \param data Данные
+ * \param size Размер данных
+ * \return
+ */
+static void WriteFile(
+    const int file,
+    const void* data,
+    std::size_t size)
+{
+    auto bytes = static_cast<const char*>(data);
+    while (size) {
+#if defined(_WIN32)
+        const auto written = _write(file, bytes, static_cast<unsigned>(std::min<std::size_t>(size, 1u << 30)));
+#else
+        const auto written = ::write(file, bytes, size);
+#endif
+        if (written <= 0) {
+            throw std::runtime_error(u8"Не удалось записать журнал сеансов");
+        }
+        bytes += written;
+        size -= static_cast<std::size_t>(written);
+    }
+}
+
+/**
+ * Сброс записанного в файл на диск.
+ *
+ * \param file Дескриптор файла
+ * \return
+ */
+static void SyncFile(
+    const int file)
+{
+#if defined(_WIN32)
+    const bool synced = _commit(file) == 0;
+#elif defined(__APPLE__)
+    const bool synced = ::fsync(file) == 0;
+#else
+    const bool synced = ::fdatasync(file) == 0;
+#endif
+    if (!synced) {
+        throw std::runtime_error(u8"Не удалось сбросить журнал сеансов на диск");
+    }
+}
+
+/**
+ * Закрытие файла.
+ *
+ * \param file Дескриптор файла
+ * \return
+ */
+static void CloseFile(
+    const int file) noexcept
+{
+#if defined(_WIN32)
+    _close(file);
+#else
+    ::close(file);
+#endif
+}
+
+/**
+ * Сброс на диск записи каталога, чтобы переименование
+ * и создание файлов пережили отключение питания.
+ *
+ * \param directory Каталог
+ * \return
+ */
+static void SyncDirectory(
+    const std::string& directory) noexcept
+{
+#if !defined(_WIN32)
+    const int file = ::open(directory.c_str(), O_RDONLY | O_CLOEXEC);
+    if (file >= 0) {
+        ::fsync(file);
+        ::close(file);
+    }
+#else
+    (void)directory;
+#endif
+}
+
+/**
+ * Применение записи.
+ * Каждая глубина пути хранит узел из записи с наибольшим номером
+ * перехода, а длину пути задаёт запись с наибольшим номером вообще.
+ * Поэтому результат не зависит от порядка применения записей.
+ *
+ * \param record Запись
+ * \param generation Номер файла, из которого прочитана запись
+ * \return
+ */
+void JournalState::Apply(
+    const JournalRecord& record,
+    const std::uint64_t generation)
+{
+    // Записи одного сеанса часто идут подряд (в контрольной точке - всегда)
+    if (!m_last || m_lastID != record.session) {
+        m_maxSession = std::max(m_maxSession, record.session);
+        m_last = &m_sessions[record.session];
+        m_lastID = record.session;
+    }
+    auto& session = *m_last;
+    if (session.closeSequence) {
+        // Завершённый сеанс хранится, пока не придут
+        // все его записи, сделанные до завершения
+        session.closeSequence = std::max(session.closeSequence, record.sequence);
+        return;
+    }
+    if (record.type == JournalRecordType::Close) {
+        session.closeSequence = record.sequence;
+        session.closedAt = generation;
+        session.path = {};
+        ++m_closed;
+        return;
+    }
+    if (record.depth >= session.path.size()) {
+        session.path.resize(record.depth + std::size_t(1), { 0, 0 });
+    }
+    auto& step = session.path[record.depth];
+    if (record.sequence > step.second) {
+        step = { record.node, record.sequence };
+    }
+    if (record.sequence > session.lengthSequence) {
+        session.length = record.depth + 1u;
+        session.lengthSequence = record.sequence;
+    }
+}
+
+/**
+ * Резервирование места под сеансы.
+ *
+ * \param sessions Ожидаемое количество сеансов
+ * \return
+ */
+void JournalState::Reserve(
+    const std::size_t sessions)
+{
+    if (sessions > m_sessions.size()) {
+        m_sessions.reserve(sessions);
+    }
+}
+
+/**
+ * Получение пути сеанса.
+ *
+ * \param session Идентификатор сеанса
+ * \param path Идентификаторы узлов пути от корня
+ * \param sequence Номер последнего перехода сеанса
+ * \return true - если сеанс не завершён
+ */
+bool JournalState::Get(
+    const std::uint64_t session,
+    std::vector<int>& path,
+    std::uint32_t& sequence) const
+{
+    const auto it = m_sessions.find(session);
+    if (it == m_sessions.end() || it->second.closeSequence || !it->second.length) {
+        return false;
+    }
+    path.clear();
+    for (std::size_t depth = 0; depth < it->second.length; ++depth) {
+        // Пропавшая запись обрывает путь
+        if (!it->second.path[depth].second) {
+            break;
+        }
+        path.push_back(it->second.path[depth].first);
+    }
+    sequence = it->second.lengthSequence;
+    return true;
+}
+
+/**
+ * Получение идентификаторов незавершённых сеансов.
+ *
+ * \return Идентификаторы сеансов
+ */
+std::vector<std::uint64_t> JournalState::Sessions() const
+{
+    std::vector<std::uint64_t> sessions;
+    sessions.reserve(Size());
+    for (const auto& [id, session] : m_sessions) {
+        if (!session.closeSequence && session.length) {
+            sessions.push_back(id);
+        }
+    }
+    std::sort(sessions.begin(), sessions.end());
+    return sessions;
+}
+
+/**
+ * Запись состояния сеансов в виде записей журнала.
+ * Сеансы, завершённые в последнем файле перед контрольной точкой,
+ * записываются, чтобы запоздавшие записи из других потоков,
+ * попавшие в следующий файл, не восстановили их.
+ *
+ * \param checkpoint Номер новой контрольной точки
+ * \param records Записи
+ * \return
+ */
+void JournalState::Snapshot(
+    const std::uint64_t checkpoint,
+    std::vector<JournalRecord>& records)
+{
+    m_last = nullptr;
+    for (auto it = m_sessions.begin(); it != m_sessions.end();) {
+        auto& session = it->second;
+        JournalRecord record = {};
+        record.session = it->first;
+        if (session.closeSequence) {
+            if (session.closedAt + 1 < checkpoint) {
+                it = m_sessions.erase(it);
+                --m_closed;
+                continue;
+            }
+            record.type = JournalRecordType::Close;
+            record.sequence = session.closeSequence;
+            records.push_back(record);
+            ++it;
+            continue;
+        }
+        // Узлы глубже текущей длины пути больше не понадобятся
+        session.path.resize(session.length);
+        record.type = JournalRecordType::Step;
+        for (std::size_t depth = 0; depth < session.length; ++depth) {
+            if (session.path[depth].second) {
+                record.depth = static_cast<std::uint16_t>(depth);
+                record.node = session.path[depth].first;
+                record.sequence = session.path[depth].second;
+                records.push_back(record);
+            }
+        }
+        ++it;
+    }
+}
+
+/**
+ * Открытие журнала сеансов с восстановлением сохранённых сеансов.
+ *
+ * \param options Параметры журнала
+ * \return Журнал
+ */
+std::shared_ptr<ISessionJournal> OpenSessionJournal(
+    const JournalOptions& options) noexcept(false)
+{
+    return std::make_shared<SessionJournal>(options);
+}
+
+/**
+ * Конструктор. Восстанавливает сеансы из каталога журнала,
+ * открывает новый файл журнала и запускает фоновый поток.
+ *
+ * \param options Параметры журнала
+ */
+SessionJournal::SessionJournal(
+    const JournalOptions& options) noexcept(false):
+    m_options(options),
+    m_id(NextJournalID()),
+    m_pool(m_id, options.ringCapacity)
+{
+    m_options.ringCapacity = m_pool.Capacity();
+    std::filesystem::create_directories(m_options.directory);
+    Recover();
+    Rotate();
+    m_worker = std::thread(&SessionJournal::Worker, this);
+}
+
+/**
+ * Деструктор. Сохраняет оставшиеся записи и останавливает фоновый поток.
+ */
+SessionJournal::~SessionJournal()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_wakeLock);
+        m_stop = true;
+    }
+    m_wake.notify_one();
+    m_worker.join();
+    if (m_checkpointWriter.joinable()) {
+        m_checkpointWriter.join();
+    }
+    if (m_file >= 0) {
+        CloseFile(m_file);
+    }
+}
+
+/**
+ * Сохранение всех сделанных переходов.
+ *
+ * \return
+ */
+void SessionJournal::Flush()
+{
+    std::lock_guard<std::mutex> lock(m_drainLock);
+    Commit();
+}
+
+/**
+ * Запись контрольной точки и удаление старых файлов журнала.
+ * Возвращает управление, когда контрольная точка записана.
+ *
+ * \return
+ */
+void SessionJournal::Checkpoint()
+{
+    std::lock_guard<std::mutex> lock(m_drainLock);
+    WriteCheckpoint();
+    m_checkpointWriter.join();
+}
+
+/**
+ * Получение идентификаторов незавершённых сеансов.
+ *
+ * \return Идентификаторы сеансов
+ */
+std::vector<std::uint64_t> SessionJournal::GetSessions() const
+{
+    return m_state.Sessions();
+}
+
+/**
+ * Получение статистики журнала.
+ *
+ * \return Статистика
+ */
+JournalStats SessionJournal::GetStats() const
+{
+    JournalStats stats;
+    stats.written = m_written.load(std::memory_order_relaxed);
+    stats.commits = m_commits.load(std::memory_order_relaxed);
+    stats.stalls = m_stalls.load(std::memory_order_relaxed);
+    stats.checkpoints = m_checkpoints.load(std::memory_order_relaxed);
+    stats.dropped = m_dropped.load(std::memory_order_relaxed);
+    stats.recovered = m_recovered;
+    stats.recoveryMs = m_recoveryMs;
+    return stats;
+}
+
+/**
+ * Получение сохранённого пути сеанса.
+ *
+ * \param session Идентификатор сеанса
+ * \param path Идентификаторы узлов пути от корня
+ * \param sequence Номер последнего перехода сеанса
+ * \return true - если сеанс найден и не завершён
+ */
+bool SessionJournal::Find(
+    const std::uint64_t session,
+    std::vector<int>& path,
+    std::uint32_t& sequence) const
+{
+    return m_state.Get(session, path, sequence);
+}
+
+/**
+ * Запрос сохранения наполовину заполненного буфера
+ * и ожидание освобождения места в переполненном буфере.
+ * Переходы не теряются: если буфер переполнен,
+ * поток ждёт, пока фоновый поток не заберёт записи.
+ *
+ * \param ring Буфер потока
+ * \param head Позиция записи
+ * \return
+ */
+void SessionJournal::ReserveSpace(
+    JournalRing& ring,
+    const std::uint64_t head) noexcept
+{
+    ring.cachedTail = ring.tail.load(std::memory_order_acquire);
+    if (head - ring.cachedTail <= ring.mask / 2) {
+        return;
+    }
+    if (!m_drainRequested.exchange(true, std::memory_order_acq_rel)) {
+        m_wake.notify_one();
+    }
+    if (head - ring.cachedTail <= ring.mask) {
+        return;
+    }
+    m_stalls.fetch_add(1, std::memory_order_relaxed);
+    do {
+        std::this_thread::yield();
+        ring.cachedTail = ring.tail.load(std::memory_order_acquire);
+    } while (head - ring.cachedTail > ring.mask);
+}
+
+/**
+ * Применение к таблице сеансов контрольной точки и файлов журнала.
+ * Файлы отображаются в память и читаются подряд. Чтение файла
+ * прекращается на первой повреждённой записи: это может быть
+ * только запись, обрезанная падением.
+ *
+ * \param directory Каталог журнала
+ * \param checkpoint Номер контрольной точки, либо 0, если её нет
+ * \param journals Номера файлов журнала по возрастанию
+ * \param state Таблица сеансов
+ * \return
+ */
+static void ReadJournal(
+    const std::string& directory,
+    const std::uint64_t checkpoint,
+    const std::vector<std::uint64_t>& journals,
+    JournalState& state)
+{
+    const auto apply = [&state](const std::filesystem::path& path,
+        const std::uint32_t kind, const std::uint64_t generation) {
+        MappedFile file(path);
+        JournalFileHeader header;
+        if (file.Size() < sizeof(header)) {
+            return;
+        }
+        std::memcpy(&header, file.Data(), sizeof(header));
+        if (std::memcmp(header.magic, kJournalMagic, sizeof(kJournalMagic)) != 0
+            || header.recordSize != sizeof(JournalRecord) || header.kind != kind) {
+            throw std::runtime_error(u8"Неверный файл журнала сеансов " + path.string());
+        }
+        const auto count = (file.Size() - sizeof(header)) / sizeof(JournalRecord);
+        const auto records = file.Data() + sizeof(header);
+        state.Reserve(count / 8);
+        JournalRecord record;
+        for (std::size_t i = 0; i < count; ++i) {
+            std::memcpy(&record, records + i * sizeof(JournalRecord), sizeof(record));
+            if (record.checksum != Checksum(record) || !record.session) {
+                logger->Log(LogLevel::Warning, u8"Журнал сеансов обрезан: " + path.string());
+                break;
+            }
+            state.Apply(record, generation);
+        }
+    };
+    // Сеансы, завершённые до контрольной точки, относятся к предыдущему файлу
+    if (checkpoint) {
+        apply(JournalFilePath(directory, "checkpoint", checkpoint), 1, checkpoint - 1);
+    }
+    for (const auto number : journals) {
+        apply(JournalFilePath(directory, "journal", number), 0, number);
+    }
+}
+
+/**
+ * Восстановление состояния по файлам каталога.
+ * Применяется последняя контрольная точка и файлы журнала,
+ * начатые после неё. Файлы, уже учтённые в контрольной точке,
+ * удаляются.
+ *
+ * \return
+ */
+void SessionJournal::Recover()
+{
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<std::uint64_t> journals;
+    std::vector<std::uint64_t> checkpoints;
+    for (const auto& entry : std::filesystem::directory_iterator(m_options.directory)) {
+        const auto name = entry.path().filename().string();
+        unsigned long long number = 0;
+        char tail = 0;
+        if (entry.path().extension() == ".tmp") {
+            // Недописанная контрольная точка
+            std::filesystem::remove(entry.path());
+        }
+        else if (std::sscanf(name.c_str(), "journal-%llu.bi%c", &number, &tail) == 2 && tail == 'n') {
+            journals.push_back(number);
+        }
+        else if (std::sscanf(name.c_str(), "checkpoint-%llu.bi%c", &number, &tail) == 2 && tail == 'n') {
+            checkpoints.push_back(number);
+        }
+    }
+    std::sort(journals.begin(), journals.end());
+    std::sort(checkpoints.begin(), checkpoints.end());
+    m_checkpoint = checkpoints.empty() ? 0 : checkpoints.back();
+    for (const auto number : checkpoints) {
+        if (number < m_checkpoint) {
+            std::filesystem::remove(JournalFilePath(m_options.directory, "checkpoint", number));
+        }
+    }
+    const auto first = std::lower_bound(journals.begin(), journals.end(), m_checkpoint);
+    for (auto it = journals.begin(); it != first; ++it) {
+        std::filesystem::remove(JournalFilePath(m_options.directory, "journal", *it));
+    }
+    journals.erase(journals.begin(), first);
+
+    ReadJournal(m_options.directory, m_checkpoint, journals, m_state);
+    m_fileNumber = std::max<std::uint64_t>({ m_checkpoint, 1, journals.empty() ? 0 : journals.back() + 1 });
+    ReserveSessionIDs(m_state.MaxSession());
+    m_recovered = m_state.Size();
+    m_recoveryMs = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+    if (m_recovered) {
+        logger->Log(LogLevel::Info, u8"Восстановлено сеансов: "
+            + std::to_string(m_recovered) + u8" за "
+            + std::to_string(static_cast<long long>(m_recoveryMs)) + u8" мс");
+    }
+}
+
+/**
+ * Групповое сохранение записей всех буферов.
+ * Записи копируются из буферов в общий пакет, поэтому потоки
+ * сеансов не ждут записи на диск. Пакет дописывается в файл одним
+ * вызовом и сбрасывается на диск одним fsync. Место в буферах
+ * освобождается только после этого: если сохранить пакет не удалось,
+ * записи остаются в буферах, и следующее сохранение повторяет их
+ * в новом файле. Повтор уже сохранённой записи безопасен, так как
+ * состояние восстанавливается по номерам переходов.
+ *
+ * \return
+ */
+void SessionJournal::Commit()
+{
+    m_drainRequested.store(false, std::memory_order_release);
+    // Восстановление остановится на недописанной записи,
+    // поэтому после ошибки журнал продолжается в новом файле
+    if (m_failed) {
+        Rotate();
+        m_failed = false;
+    }
+    m_pool.Snapshot(m_drainRings);
+    m_drainHeads.clear();
+    m_batch.clear();
+    for (auto ring : m_drainRings) {
+        const auto tail = ring->tail.load(std::memory_order_relaxed);
+        const auto head = ring->head.load(std::memory_order_acquire);
+        for (auto position = tail; position != head; ++position) {
+            m_batch.push_back(ring->records[position & ring->mask]);
+        }
+        m_drainHeads.push_back(head);
+    }
+    if (m_batch.empty()) {
+        m_pool.Recycle();
+        return;
+    }
+    for (auto& record : m_batch) {
+        record.reserved = 0;
+        record.checksum = Checksum(record);
+    }
+    const auto bytes = m_batch.size() * sizeof(JournalRecord);
+    try {
+        WriteFile(m_file, m_batch.data(), bytes);
+        if (m_options.sync) {
+            SyncFile(m_file);
+        }
+    }
+    catch (...) {
+        m_failed = true;
+        throw;
+    }
+    for (std::size_t i = 0; i < m_drainRings.size(); ++i) {
+        m_drainRings[i]->tail.store(m_drainHeads[i], std::memory_order_release);
+    }
+    m_pool.Recycle();
+    m_bytesSinceCheckpoint += bytes;
+    m_written.fetch_add(m_batch.size(), std::memory_order_relaxed);
+    m_commits.fetch_add(1, std::memory_order_relaxed);
+}
+
+/**
+ * Открытие нового файла журнала.
+ *
+ * \return
+ */
+void SessionJournal::Rotate()
+{
+    const auto path = JournalFilePath(m_options.directory, "journal", m_fileNumber++);
+    const int file = CreateJournalFile(path);
+    JournalFileHeader header = {};
+    std::memcpy(header.magic, kJournalMagic, sizeof(kJournalMagic));
+    header.recordSize = sizeof(JournalRecord);
+    WriteFile(file, &header, sizeof(header));
+    if (m_options.sync) {
+        SyncFile(file);
+        SyncDirectory(m_options.directory);
+    }
+    if (m_file >= 0) {
+        CloseFile(m_file);
+    }
+    m_file = file;
+}
+
+/**
+ * Запись контрольной точки.
+ * Все записи сохраняются и начинается новый файл журнала. Номер
+ * контрольной точки равен номеру нового файла: она заменяет предыдущую
+ * контрольную точку и все файлы журнала с меньшими номерами.
+ * Таблица сеансов строится из этих файлов отдельным потоком,
+ * поэтому групповые сохранения не останавливаются и не тратят
+ * время на поддержание таблицы. Старые файлы удаляются,
+ * когда контрольная точка сохранена.
+ *
+ * \return
+ */
+void SessionJournal::WriteCheckpoint()
+{
+    Commit();
+    if (m_checkpointWriter.joinable()) {
+        m_checkpointWriter.join();
+    }
+    const auto previous = m_checkpoint;
+    Rotate();
+    const auto number = m_fileNumber - 1;
+    m_checkpoint = number;
+    m_bytesSinceCheckpoint = 0;
+    m_checkpointWriter = std::thread([this, previous, number] {
+        try {
+            std::vector<std::uint64_t> journals;
+            for (auto journal = std::max<std::uint64_t>(previous, 1); journal < number; ++journal) {
+                if (std::filesystem::exists(JournalFilePath(m_options.directory, "journal", journal))) {
+                    journals.push_back(journal);
+                }
+            }
+            JournalState state;
+            ReadJournal(m_options.directory, previous, journals, state);
+            std::vector<JournalRecord> records;
+            records.reserve(state.Size() * 8);
+            state.Snapshot(number, records);
+
+            const auto path = JournalFilePath(m_options.directory, "checkpoint", number);
+            auto temporary = path;
+            temporary += ".tmp";
+            const int file = CreateJournalFile(temporary);
+            JournalFileHeader header = {};
+            std::memcpy(header.magic, kJournalMagic, sizeof(kJournalMagic));
+            header.recordSize = sizeof(JournalRecord);
+            header.kind = 1;
+            WriteFile(file, &header, sizeof(header));
+            for (auto& record : records) {
+                record.checksum = Checksum(record);
+            }
+            WriteFile(file, records.data(), records.size() * sizeof(JournalRecord));
+            SyncFile(file);
+            CloseFile(file);
+            std::filesystem::rename(temporary, path);
+            SyncDirectory(m_options.directory);
+            // Контрольная точка сохранена, старые файлы больше не нужны
+            if (previous) {
+                std::filesystem::remove(JournalFilePath(m_options.directory, "checkpoint", previous));
+            }
+            for (const auto journal : journals) {
+                std::filesystem::remove(JournalFilePath(m_options.directory, "journal", journal));
+            }
+            m_checkpoints.fetch_add(1, std::memory_order_relaxed);
+        }
+        catch (const std::exception& ex) {
+            logger->Log(LogLevel::Error, ex.what());
+        }
+    });
+}
+
+/**
+ * Цикл фонового потока.
+ * Записи сохраняются периодически, а также по сигналу от потока
+ * с переполненным буфером. Когда журнал вырастает,
+ * записывается контрольная точка.
+ *
+ * \return
+ */
+void SessionJournal::Worker()
+{
+    std::unique_lock<std::mutex> lock(m_wakeLock);
+    for (bool stop = false; !stop;) {
+        m_wake.wait_for(lock, std::chrono::milliseconds(m_options.commitIntervalMs), [this]
+        {
+            return m_stop || m_drainRequested.load(std::memory_order_acquire);
+        });
+        stop = m_stop;
+        lock.unlock();
+        try {
+            std::lock_guard<std::mutex> drainLock(m_drainLock);
+            Commit();
+            if (!stop && m_bytesSinceCheckpoint >= m_options.checkpointBytes) {
+                WriteCheckpoint();
+            }
+        }
+        catch (const std::exception& ex) {
+            logger->Log(LogLevel::Error, ex.what());
+        }
+        lock.lock();
+    }
+}
+
+}
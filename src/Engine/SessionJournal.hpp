@@ -0,0 +1,340 @@
+﻿#pragma once
+
+#include "ISessionJournal.hpp"
+#include "RecordRing.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace ES
+{
+
+/**
+ * Тип записи журнала сеансов.
+ */
+enum class JournalRecordType: std::uint8_t
+{
+    Step = 1,   // Узел на вершине пути сеанса после перехода
+    Close = 2   // Завершение сеанса
+};
+
+/**
+ * Двоичная запись журнала сеансов.
+ * Любой переход сеанса (ответ, сброс, возврат) записывается как новая
+ * вершина пути: глубина и идентификатор узла на ней. Записи одного сеанса
+ * из разных потоков могут попасть в файл не по порядку, поэтому каждая
+ * запись несёт номер перехода в сеансе, и состояние восстанавливается
+ * по номерам независимо от порядка записей.
+ */
+struct JournalRecord
+{
+    // Идентификатор сеанса
+    std::uint64_t session;
+    // Номер перехода в сеансе
+    std::uint32_t sequence;
+    // Идентификатор узла на вершине пути
+    std::int32_t node;
+    // Глубина вершины пути
+    std::uint16_t depth;
+    // Тип записи
+    JournalRecordType type;
+    std::uint8_t reserved;
+    // Контрольная сумма предыдущих полей. Обрезанная
+    // при падении запись в конце файла не проходит проверку
+    std::uint32_t checksum;
+};
+static_assert(sizeof(JournalRecord) == 24, "JournalRecord must stay 24 bytes");
+
+// Кольцевой буфер записей журнала одного потока
+using JournalRing = RecordRing<JournalRecord>;
+
+/**
+ * Сохранённое состояние одного сеанса.
+ */
+struct JournalSession
+{
+    // Узлы пути по глубинам с номерами переходов, записавших их
+    std::vector<std::pair<std::int32_t, std::uint32_t>> path;
+    // Длина пути
+    std::uint32_t length = 0;
+    // Номер перехода, задавшего длину пути
+    std::uint32_t lengthSequence = 0;
+    // Номер перехода, завершившего сеанс, либо 0
+    std::uint32_t closeSequence = 0;
+    // Номер файла, в котором сеанс был завершён
+    std::uint64_t closedAt = 0;
+};
+
+/**
+ * Таблица состояний сеансов, восстанавливаемая по записям журнала.
+ */
+class JournalState final
+{
+public:
+    /**
+     * Применение записи.
+     * Результат не зависит от порядка применения записей.
+     *
+     * \param record Запись
+     * \param generation Номер файла, из которого прочитана запись
+     * \return
+     */
+    void Apply(
+        const JournalRecord& record,
+        const std::uint64_t generation);
+
+    /**
+     * Резервирование места под сеансы.
+     *
+     * \param sessions Ожидаемое количество сеансов
+     * \return
+     */
+    void Reserve(
+        const std::size_t sessions);
+
+    /**
+     * Получение пути сеанса.
+     *
+     * \param session Идентификатор сеанса
+     * \param path Идентификаторы узлов пути от корня
+     * \param sequence Номер последнего перехода сеанса
+     * \return true - если сеанс не завершён
+     */
+    bool Get(
+        const std::uint64_t session,
+        std::vector<int>& path,
+        std::uint32_t& sequence) const;
+
+    /**
+     * Получение идентификаторов незавершённых сеансов.
+     *
+     * \return Идентификаторы сеансов
+     */
+    std::vector<std::uint64_t> Sessions() const;
+
+    /**
+     * Получение количества незавершённых сеансов.
+     *
+     * \return Количество сеансов
+     */
+    std::size_t Size() const noexcept
+    {
+        return m_sessions.size() - m_closed;
+    }
+
+    /**
+     * Получение наибольшего идентификатора сеанса.
+     *
+     * \return Идентификатор
+     */
+    std::uint64_t MaxSession() const noexcept
+    {
+        return m_maxSession;
+    }
+
+    /**
+     * Запись состояния незавершённых сеансов в виде записей журнала
+     * и удаление давно завершённых сеансов.
+     *
+     * \param checkpoint Номер контрольной точки
+     * \param records Записи
+     * \return
+     */
+    void Snapshot(
+        const std::uint64_t checkpoint,
+        std::vector<JournalRecord>& records);
+
+private:
+    // Состояния сеансов по идентификаторам
+    std::unordered_map<std::uint64_t, JournalSession> m_sessions;
+    // Количество завершённых сеансов в таблице
+    std::size_t m_closed = 0;
+    // Наибольший идентификатор сеанса
+    std::uint64_t m_maxSession = 0;
+    // Сеанс последней применённой записи
+    std::uint64_t m_lastID = 0;
+    JournalSession* m_last = nullptr;
+};
+
+/**
+ * Реализация журнала сеансов.
+ */
+class SessionJournal final:
+    public ISessionJournal
+{
+public:
+    /**
+     * Конструктор. Восстанавливает сеансы из каталога журнала,
+     * открывает новый файл журнала и запускает фоновый поток.
+     *
+     * \param options Параметры журнала
+     */
+    explicit SessionJournal(
+        const JournalOptions& options) noexcept(false);
+
+    /**
+     * Деструктор. Сохраняет оставшиеся записи и останавливает фоновый поток.
+     */
+    ~SessionJournal();
+
+    // Реализация интерфейса ISessionJournal
+
+    void Flush() override;
+
+    void Checkpoint() override;
+
+    std::vector<std::uint64_t> GetSessions() const override;
+
+    JournalStats GetStats() const override;
+
+    /**
+     * Запись перехода сеанса в буфер текущего потока.
+     * Не выделяет память после первого вызова в потоке.
+     * Если буфер для потока выделить не удалось, переход не записывается.
+     *
+     * \param session Идентификатор сеанса
+     * \param sequence Номер перехода в сеансе
+     * \param type Тип записи
+     * \param depth Глубина вершины пути
+     * \param node Идентификатор узла на вершине пути
+     * \return
+     */
+    void Record(
+        const std::uint64_t session,
+        const std::uint32_t sequence,
+        const JournalRecordType type,
+        const std::uint16_t depth,
+        const std::int32_t node) noexcept
+    {
+        JournalRing* local = m_pool.Local();
+        if (!local) {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        JournalRing& ring = *local;
+        const auto head = ring.head.load(std::memory_order_relaxed);
+        if (head - ring.cachedTail > ring.mask / 2) {
+            ReserveSpace(ring, head);
+        }
+        auto& record = ring.records[head & ring.mask];
+        record.session = session;
+        record.sequence = sequence;
+        record.node = node;
+        record.depth = depth;
+        record.type = type;
+        ring.head.store(head + 1, std::memory_order_release);
+    }
+
+    /**
+     * Получение пути сеанса, восстановленного при открытии журнала.
+     *
+     * \param session Идентификатор сеанса
+     * \param path Идентификаторы узлов пути от корня
+     * \param sequence Номер последнего перехода сеанса
+     * \return true - если сеанс найден и не завершён
+     */
+    bool Find(
+        const std::uint64_t session,
+        std::vector<int>& path,
+        std::uint32_t& sequence) const;
+
+private:
+    /**
+     * Запрос сохранения наполовину заполненного буфера
+     * и ожидание освобождения места в переполненном буфере.
+     */
+    void ReserveSpace(
+        JournalRing& ring,
+        const std::uint64_t head) noexcept;
+
+    /**
+     * Восстановление состояния по файлам каталога.
+     */
+    void Recover();
+
+    /**
+     * Групповое сохранение записей всех буферов.
+     * Вызывается под m_drainLock.
+     */
+    void Commit();
+
+    /**
+     * Открытие нового файла журнала.
+     */
+    void Rotate();
+
+    /**
+     * Запись контрольной точки. Вызывается под m_drainLock.
+     */
+    void WriteCheckpoint();
+
+    /**
+     * Цикл фонового потока.
+     */
+    void Worker();
+
+    // Параметры
+    JournalOptions m_options;
+    // Уникальный номер журнала
+    const std::uint64_t m_id;
+    // Буферы потоков
+    RecordRingPool<JournalRecord> m_pool;
+    // Мьютекс группового сохранения
+    std::mutex m_drainLock;
+    // Снимок списка буферов, позиции записи в них и записи текущего сохранения
+    std::vector<JournalRing*> m_drainRings;
+    std::vector<std::uint64_t> m_drainHeads;
+    std::vector<JournalRecord> m_batch;
+    // Последнее сохранение не удалось, и текущий файл может
+    // заканчиваться недописанным пакетом
+    bool m_failed = false;
+    // Дескриптор текущего файла журнала
+    int m_file = -1;
+    // Номер текущего файла журнала
+    std::uint64_t m_fileNumber = 0;
+    // Номер последней контрольной точки
+    std::uint64_t m_checkpoint = 0;
+    // Объём журнала после последней контрольной точки
+    std::size_t m_bytesSinceCheckpoint = 0;
+    // Сеансы, восстановленные при открытии журнала
+    JournalState m_state;
+    // Поток записи контрольной точки
+    std::thread m_checkpointWriter;
+    // Статистика
+    std::atomic<std::uint64_t> m_written{0};
+    std::atomic<std::uint64_t> m_commits{0};
+    std::atomic<std::uint64_t> m_stalls{0};
+    std::atomic<std::uint64_t> m_checkpoints{0};
+    std::atomic<std::uint64_t> m_dropped{0};
+    std::size_t m_recovered = 0;
+    double m_recoveryMs = 0;
+    // Синхронизация фонового потока
+    std::atomic<bool> m_drainRequested{false};
+    std::mutex m_wakeLock;
+    std::condition_variable m_wake;
+    bool m_stop = false;
+    std::thread m_worker;
+};
+
+/**
+ * Получение идентификатора для нового сеанса.
+ *
+ * \return Идентификатор сеанса
+ */
+std::uint64_t NextSessionID() noexcept;
+
+/**
+ * Пропуск идентификаторов сеансов, уже занятых сохранёнными сеансами.
+ *
+ * \param last Наибольший занятый идентификатор
+ * \return
+ */
+void ReserveSessionIDs(
+    const std::uint64_t last) noexcept;
+
+}
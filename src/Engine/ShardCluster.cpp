@@ -0,0 +1,803 @@
+﻿#include "IShardCluster.hpp"
+
+#include "HashRing.hpp"
+#include "ILogger.hpp"
+#include "LineProtocol.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace ES
+{
+
+namespace
+{
+
+// Наибольшее количество запросов, отправленных шарду без ответа
+constexpr std::size_t kMaxInFlight = 256;
+// Наибольшее количество шардов
+constexpr std::size_t kMaxShards = 256;
+// Размер блока чтения
+constexpr std::size_t kReadSize = 64 * 1024;
+
+/**
+ * Процесс-шард: хранит свои сеансы и выполняет запросы к ним.
+ * Запросы приходят строками "сеанс команда", ответ на каждый
+ * запрос - одна строка в порядке запросов. Кроме команд сеансов,
+ * шард понимает служебные запросы маршрутизатора:
+ * "<сеанс> import <ответы>" - принять перенесённый сеанс,
+ * "0 rebalance <точки> <шарды>" - отдать сеансы, которые на новом
+ * кольце принадлежат другим шардам.
+ */
+class ShardServer
+{
+public:
+    ShardServer(
+        const IExpertSystem& base,
+        const std::uint32_t shard,
+        const std::size_t capacity):
+        m_base(base),
+        m_shard(shard),
+        m_capacity(capacity)
+    {
+    }
+
+    /**
+     * Обработка запросов из сокета до его закрытия.
+     *
+     * \param fd Сокет связи с маршрутизатором
+     * \return
+     */
+    void Run(
+        const int fd)
+    {
+        ServeLines(fd, [this](std::string_view line, std::string& output) { Handle(line, output); });
+    }
+
+private:
+    /**
+     * Сеанс шарда.
+     */
+    struct Session
+    {
+        // Сеанс экспертной системы
+        std::unique_ptr<IExpertSystem> system;
+        // Ответы, поданные с начала сеанса. По ним сеанс
+        // восстанавливается на другом шарде
+        std::vector<int> answers;
+    };
+
+    /**
+     * Обработка одного запроса "сеанс команда".
+     *
+     * \param line Запрос
+     * \param output Буфер ответов
+     * \return
+     */
+    void Handle(
+        std::string_view line,
+        std::string& output)
+    {
+        std::uint64_t sessionID = 0;
+        if (!ParseNumber(line, sessionID) || !sessionID) {
+            Rebalance(line, output);
+            return;
+        }
+        const bool import = line.substr(0, 6) == "import";
+        if (line == "new" || import) {
+            // Перенесённый сеанс принимается и сверх ёмкости:
+            // перераспределение не должно терять сеансы
+            if (!import && m_sessions.size() >= m_capacity) {
+                output.append("full\t0\t\t\n");
+                return;
+            }
+            auto& session = m_sessions[sessionID];
+            session.system = m_base.CreateSession();
+            session.answers.clear();
+            if (import) {
+                line.remove_prefix(6);
+                while (!line.empty() && line.front() == ' ') {
+                    line.remove_prefix(1);
+                }
+                int value = 0;
+                while (ParseNumber(line, value)) {
+                    session.system->SetAnswer(value);
+                    session.answers.push_back(value);
+                }
+                output.append("imported\t");
+                AppendNumber(output, static_cast<std::int64_t>(sessionID));
+                output.append("\t\t\n");
+                return;
+            }
+            AppendReply(output, nullptr, sessionID, session.system.get());
+            return;
+        }
+        const auto command = ParseCommand(line);
+        if (command.kind == SessionCommand::Kind::Close) {
+            AppendReply(output, m_sessions.erase(sessionID) ? "closed" : "unknown", sessionID, nullptr);
+            return;
+        }
+        const auto it = m_sessions.find(sessionID);
+        if (it == m_sessions.end()) {
+            AppendReply(output, "unknown", sessionID, nullptr);
+            return;
+        }
+        AppendReply(output, Apply(command, it->second), sessionID, it->second.system.get());
+    }
+
+    /**
+     * Применение команды к сеансу.
+     *
+     * \param command Команда
+     * \param session Сеанс
+     * \return Статус непринятой команды, либо nullptr
+     */
+    static const char* Apply(
+        const SessionCommand& command,
+        Session& session)
+    {
+        switch (command.kind) {
+        case SessionCommand::Kind::Show:
+            return nullptr;
+        case SessionCommand::Kind::Back:
+            if (!session.answers.empty() && session.system->Back()) {
+                session.answers.pop_back();
+            }
+            return nullptr;
+        case SessionCommand::Kind::Reset:
+            session.system->Reset();
+            session.answers.clear();
+            return nullptr;
+        case SessionCommand::Kind::Answer:
+            if (!session.system->SetAnswer(command.answer)) {
+                return "rejected";
+            }
+            session.answers.push_back(command.answer);
+            return nullptr;
+        default:
+            return "rejected";
+        }
+    }
+
+    /**
+     * Выдача сеансов, которые на новом кольце принадлежат другим шардам.
+     * Ответ: "exported<TAB>сеансов шарда<TAB>сеанс ответы,сеанс ответы,...".
+     *
+     * \param line Запрос "rebalance <точки> <шарды>"
+     * \param output Буфер ответов
+     * \return
+     */
+    void Rebalance(
+        std::string_view line,
+        std::string& output)
+    {
+        std::size_t virtualNodes = 0;
+        if (line.substr(0, 9) != "rebalance") {
+            output.append("invalid\t0\t\t\n");
+            return;
+        }
+        line.remove_prefix(9);
+        while (!line.empty() && line.front() == ' ') {
+            line.remove_prefix(1);
+        }
+        ParseNumber(line, virtualNodes);
+        HashRing ring(virtualNodes);
+        std::uint32_t shard = 0;
+        while (ParseNumber(line, shard)) {
+            ring.Add(shard);
+        }
+        output.append("exported\t");
+        AppendNumber(output, static_cast<std::int64_t>(m_sessions.size()));
+        output.push_back('\t');
+        for (auto it = m_sessions.begin(); it != m_sessions.end();) {
+            if (ring.Size() && ring.Find(it->first) == m_shard) {
+                ++it;
+                continue;
+            }
+            AppendNumber(output, static_cast<std::int64_t>(it->first));
+            for (const auto answer : it->second.answers) {
+                output.push_back(' ');
+                AppendNumber(output, answer);
+            }
+            output.push_back(',');
+            it = m_sessions.erase(it);
+        }
+        output.push_back('\n');
+    }
+
+    // Загруженная экспертная система
+    const IExpertSystem& m_base;
+    // Номер шарда
+    std::uint32_t m_shard;
+    // Наибольшее количество открываемых сеансов
+    std::size_t m_capacity;
+    // Сеансы шарда
+    std::unordered_map<std::uint64_t, Session> m_sessions;
+};
+
+/**
+ * Процесс-шард с точки зрения маршрутизатора.
+ */
+struct ShardProcess
+{
+    // Идентификатор процесса
+    pid_t pid = -1;
+    // Сокет связи с шардом
+    int fd = -1;
+    // Непрочитанный остаток ответов
+    std::string input;
+    // Неотправленные запросы
+    std::string output;
+    // Номера отправленных запросов без ответа в порядке отправки,
+    // 0 - служебный запрос маршрутизатора
+    std::deque<std::uint64_t> inFlight;
+};
+
+/**
+ * Кластер шардов: маршрутизатор в вызывающем процессе
+ * и процессы-шарды.
+ */
+class ShardCluster final:
+    public IShardCluster
+{
+public:
+    ShardCluster(
+        const IExpertSystem& base,
+        const ShardClusterOptions& options):
+        m_base(base),
+        m_options(options),
+        m_ring(options.virtualNodes)
+    {
+        const auto shards = std::clamp<std::size_t>(options.shards, 1, kMaxShards);
+        m_shards.resize(shards);
+        for (std::size_t i = 0; i < shards; ++i) {
+            Spawn(i);
+            m_ring.Add(static_cast<std::uint32_t>(i));
+        }
+    }
+
+    ~ShardCluster() override
+    {
+        // Закрытие сокетов завершает шарды
+        while (!m_shards.empty()) {
+            Stop();
+        }
+    }
+
+    /**
+     * Обработка всех запросов из входного дескриптора.
+     *
+     * \param input Входной дескриптор
+     * \param output Выходной файл
+     * \return
+     */
+    void Run(
+        const int input,
+        std::FILE* output) override
+    {
+        std::string buffer;
+        std::vector<char> chunk(kReadSize);
+        bool eof = false;
+        while (true) {
+            // Запросы разбираются, пока шардам есть куда их отправить
+            // и пока не встретилось изменение количества шардов
+            bool pending = false;
+            std::size_t begin = 0;
+            for (auto end = buffer.find('\n'); end != std::string::npos; end = buffer.find('\n', begin)) {
+                if (m_resize || !CanSubmit()) {
+                    pending = true;
+                    break;
+                }
+                Submit(std::string_view(buffer).substr(begin, end - begin));
+                begin = end + 1;
+            }
+            buffer.erase(0, begin);
+            if (m_resize && Idle()) {
+                const auto report = Resize(m_resize);
+                std::string line = "resharded\t0\t";
+                AppendNumber(line, static_cast<std::int64_t>(report.after));
+                line.append("\tmoved ").append(std::to_string(report.moved))
+                    .append(" of ").append(std::to_string(report.sessions)).append(" sessions\n");
+                Complete(m_resizeSequence, line);
+                m_resize = 0;
+                continue;
+            }
+            for (std::size_t i = 0; i < m_shards.size(); ++i) {
+                Flush(i);
+            }
+            // Выводим ответы, готовые по порядку
+            for (; !m_done.empty() && !m_done.front().empty(); m_done.pop_front(), ++m_nextOutput) {
+                std::fwrite(m_done.front().data(), 1, m_done.front().size(), output);
+            }
+            std::fflush(output);
+            if (eof && !pending && m_done.empty()) {
+                return;
+            }
+            const bool reading = !eof && !pending && !m_resize;
+            if (Poll(reading ? input : -1)) {
+                const auto read = ::read(input, chunk.data(), chunk.size());
+                if (read > 0) {
+                    buffer.append(chunk.data(), static_cast<std::size_t>(read));
+                }
+                else if (read == 0 || errno != EINTR) {
+                    eof = true;
+                    // Последняя строка без перевода строки
+                    if (!buffer.empty()) {
+                        buffer.push_back('\n');
+                    }
+                }
+            }
+        }
+    }
+
+    /**
+     * Изменение количества шардов.
+     *
+     * \param shards Новое количество шардов, не меньше 1
+     * \return Результат перераспределения
+     */
+    RebalanceReport Resize(
+        const std::size_t shards) override
+    {
+        const auto start = std::chrono::steady_clock::now();
+        RebalanceReport report;
+        report.before = m_shards.size();
+        report.after = std::clamp<std::size_t>(shards, 1, kMaxShards);
+        Wait();
+
+        HashRing ring(m_options.virtualNodes);
+        std::string message = "0 rebalance " + std::to_string(ring.VirtualNodes());
+        for (std::size_t i = 0; i < report.after; ++i) {
+            ring.Add(static_cast<std::uint32_t>(i));
+            message.push_back(' ');
+            AppendNumber(message, static_cast<std::int64_t>(i));
+        }
+        message.push_back('\n');
+        for (std::size_t i = m_shards.size(); i < report.after; ++i) {
+            m_shards.emplace_back();
+            Spawn(i);
+        }
+
+        // Прежние шарды отдают сеансы, владелец которых изменился
+        for (std::size_t i = 0; i < report.before; ++i) {
+            Send(i, 0, message);
+        }
+        Wait();
+        const auto exported = std::move(m_internal);
+        m_internal.clear();
+        for (const auto& line : exported) {
+            std::string_view rest = line;
+            if (rest.substr(0, 9) != "exported\t") {
+                continue;
+            }
+            rest.remove_prefix(9);
+            std::size_t count = 0;
+            ParseNumber(rest, count);
+            report.sessions += count;
+            while (!rest.empty() && rest.front() != '\n') {
+                const auto end = std::min(rest.find(','), rest.size());
+                const auto entry = rest.substr(0, end);
+                rest.remove_prefix(std::min(end + 1, rest.size()));
+                // Запись "сеанс ответы" становится запросом "сеанс import ответы"
+                const auto space = std::min(entry.find(' '), entry.size());
+                std::uint64_t sessionID = 0;
+                if (std::from_chars(entry.data(), entry.data() + space, sessionID).ec != std::errc()) {
+                    continue;
+                }
+                std::string import(entry.substr(0, space));
+                import.append(" import").append(entry.substr(space)).push_back('\n');
+                Send(ring.Find(sessionID), 0, import);
+                ++report.moved;
+            }
+        }
+        Wait();
+        for (const auto& line : m_internal) {
+            if (line.substr(0, 9) != "imported\t") {
+                ++report.lost;
+            }
+        }
+        m_internal.clear();
+
+        while (m_shards.size() > report.after) {
+            Stop();
+        }
+        m_ring = std::move(ring);
+        report.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        ++m_rebalances;
+        m_moved += report.moved;
+        m_lost += report.lost;
+        logger->Log(LogLevel::Info, u8"Шарды: " + std::to_string(report.before) + " -> "
+            + std::to_string(report.after) + u8", перенесено сеансов " + std::to_string(report.moved)
+            + u8" из " + std::to_string(report.sessions) + u8" за "
+            + std::to_string(static_cast<long long>(report.ms)) + u8" мс");
+        return report;
+    }
+
+    /**
+     * Получение статистики кластера.
+     *
+     * \return Статистика
+     */
+    ShardClusterStats GetStats() const override
+    {
+        ShardClusterStats stats;
+        stats.shards = m_shards.size();
+        stats.requests = m_nextSequence - 1;
+        stats.rebalances = m_rebalances;
+        stats.moved = m_moved;
+        stats.restarts = m_restarts;
+        stats.lost = m_lost;
+        return stats;
+    }
+
+private:
+    /**
+     * Запуск процесса-шарда. Шард получает копию загруженного
+     * дерева и начинает без сеансов.
+     *
+     * \param index Номер шарда
+     * \return
+     */
+    void Spawn(
+        const std::size_t index)
+    {
+        int sockets[2];
+        if (::socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) != 0) {
+            throw std::runtime_error(u8"Не удалось создать сокеты шарда: " + std::string(std::strerror(errno)));
+        }
+        std::fflush(nullptr);
+        const auto pid = ::fork();
+        if (pid < 0) {
+            throw std::runtime_error(u8"Не удалось запустить шард: " + std::string(std::strerror(errno)));
+        }
+        if (pid == 0) {
+            ::close(sockets[0]);
+            // Иначе закрытие сокета маршрутизатором не завершит другой шард
+            for (const auto& shard : m_shards) {
+                if (shard.fd >= 0) {
+                    ::close(shard.fd);
+                }
+            }
+            // Не выполняем деструкторы и обработчики завершения маршрутизатора
+            try {
+                ShardServer(m_base, static_cast<std::uint32_t>(index), m_options.sessions).Run(sockets[1]);
+            }
+            catch (const std::exception& ex) {
+                logger->Log(LogLevel::Error, ex.what());
+                ::_exit(EXIT_FAILURE);
+            }
+            ::_exit(EXIT_SUCCESS);
+        }
+        ::close(sockets[1]);
+        ::fcntl(sockets[0], F_SETFD, FD_CLOEXEC);
+        ::fcntl(sockets[0], F_SETFL, ::fcntl(sockets[0], F_GETFL) | O_NONBLOCK);
+        m_shards[index].pid = pid;
+        m_shards[index].fd = sockets[0];
+    }
+
+    /**
+     * Остановка шарда с наибольшим номером.
+     *
+     * \return
+     */
+    void Stop()
+    {
+        auto& shard = m_shards.back();
+        ::close(shard.fd);
+        ::waitpid(shard.pid, nullptr, 0);
+        m_shards.pop_back();
+    }
+
+    /**
+     * Разбор входной строки и постановка запроса в очередь шарда.
+     *
+     * \param line Строка запроса
+     * \return
+     */
+    void Submit(
+        std::string_view line)
+    {
+        while (!line.empty() && (line.back() == '\r' || line.back() == ' ')) {
+            line.remove_suffix(1);
+        }
+        const auto sequence = m_nextSequence++;
+        m_done.emplace_back();
+        std::uint64_t sessionID = 0;
+        if (line == "new") {
+            sessionID = m_nextSession++;
+        }
+        else if (line.substr(0, 7) == "shards ") {
+            line.remove_prefix(7);
+            std::size_t shards = 0;
+            if (ParseNumber(line, shards) && line.empty() && shards >= 1 && shards <= kMaxShards) {
+                m_resize = shards;
+                m_resizeSequence = sequence;
+            }
+            else {
+                Complete(sequence, "invalid\t0\t\t\n");
+            }
+            return;
+        }
+        else if (!ParseNumber(line, sessionID) || !sessionID) {
+            Complete(sequence, "invalid\t0\t\t\n");
+            return;
+        }
+        auto& shard = m_shards[m_ring.Find(sessionID)];
+        AppendNumber(shard.output, static_cast<std::int64_t>(sessionID));
+        shard.output.push_back(' ');
+        shard.output.append(line).push_back('\n');
+        shard.inFlight.push_back(sequence);
+    }
+
+    /**
+     * Постановка запроса в очередь шарда.
+     *
+     * \param index Номер шарда
+     * \param sequence Номер запроса, либо 0 для служебного запроса
+     * \param message Запрос с переводом строки
+     * \return
+     */
+    void Send(
+        const std::size_t index,
+        const std::uint64_t sequence,
+        const std::string_view message)
+    {
+        m_shards[index].output.append(message);
+        m_shards[index].inFlight.push_back(sequence);
+    }
+
+    /**
+     * Сохранение ответа на запрос.
+     *
+     * \param sequence Номер запроса, либо 0 для служебного запроса
+     * \param line Ответ
+     * \return
+     */
+    void Complete(
+        const std::uint64_t sequence,
+        const std::string_view line)
+    {
+        if (sequence) {
+            m_done[sequence - m_nextOutput].assign(line);
+        }
+        else {
+            m_internal.emplace_back(line);
+        }
+    }
+
+    /**
+     * Проверка, что каждому шарду можно отправить запрос.
+     *
+     * \return true - если ни один шард не ждёт слишком много ответов
+     */
+    bool CanSubmit() const noexcept
+    {
+        return std::all_of(m_shards.begin(), m_shards.end(),
+            [](const ShardProcess& shard) { return shard.inFlight.size() < kMaxInFlight; });
+    }
+
+    /**
+     * Проверка, что все запросы выполнены.
+     *
+     * \return true - если ни один шард не ждёт ответов
+     */
+    bool Idle() const noexcept
+    {
+        return std::all_of(m_shards.begin(), m_shards.end(),
+            [](const ShardProcess& shard) { return shard.inFlight.empty(); });
+    }
+
+    /**
+     * Ожидание ответов на все отправленные запросы.
+     *
+     * \return
+     */
+    void Wait()
+    {
+        while (!Idle()) {
+            for (std::size_t i = 0; i < m_shards.size(); ++i) {
+                Flush(i);
+            }
+            Poll(-1);
+        }
+    }
+
+    /**
+     * Ожидание событий шардов и входного дескриптора.
+     * Готовые ответы шардов читаются, накопленные запросы отправляются.
+     *
+     * \param input Входной дескриптор, либо -1
+     * \return true - если входной дескриптор готов к чтению
+     */
+    bool Poll(
+        const int input)
+    {
+        m_fds.clear();
+        m_fds.push_back({ input, POLLIN, 0 });
+        for (const auto& shard : m_shards) {
+            m_fds.push_back({ shard.fd, static_cast<short>(POLLIN | (shard.output.empty() ? 0 : POLLOUT)), 0 });
+        }
+        if (::poll(m_fds.data(), m_fds.size(), -1) < 0) {
+            if (errno == EINTR) {
+                return false;
+            }
+            throw std::runtime_error(u8"Ошибка ожидания сокетов: " + std::string(std::strerror(errno)));
+        }
+        for (std::size_t i = 0; i < m_shards.size(); ++i) {
+            if (m_fds[i + 1].revents & POLLOUT) {
+                Flush(i);
+            }
+            if (m_fds[i + 1].revents & (POLLIN | POLLHUP | POLLERR)) {
+                Receive(i);
+            }
+        }
+        return m_fds[0].revents != 0;
+    }
+
+    /**
+     * Отправка накопленных запросов шарду без блокировки.
+     *
+     * \param index Номер шарда
+     * \return
+     */
+    void Flush(
+        const std::size_t index)
+    {
+        auto& shard = m_shards[index];
+        std::size_t sent = 0;
+        while (sent < shard.output.size()) {
+            const auto written = ::send(shard.fd, shard.output.data() + sent,
+                shard.output.size() - sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+            if (written < 0) {
+                // Ошибку записи в упавший шард обнаружит чтение
+                if (errno == EINTR) {
+                    continue;
+                }
+                break;
+            }
+            sent += static_cast<std::size_t>(written);
+        }
+        shard.output.erase(0, sent);
+    }
+
+    /**
+     * Чтение ответов шарда. Упавший шард перезапускается пустым.
+     *
+     * \param index Номер шарда
+     * \return
+     */
+    void Receive(
+        const std::size_t index)
+    {
+        auto& shard = m_shards[index];
+        char chunk[kReadSize];
+        const auto read = ::read(shard.fd, chunk, sizeof(chunk));
+        if (read < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+        if (read <= 0) {
+            Restart(index);
+            return;
+        }
+        shard.input.append(chunk, static_cast<std::size_t>(read));
+        std::size_t begin = 0;
+        for (auto end = shard.input.find('\n'); end != std::string::npos; end = shard.input.find('\n', begin)) {
+            if (!shard.inFlight.empty()) {
+                Complete(shard.inFlight.front(), std::string_view(shard.input).substr(begin, end + 1 - begin));
+                shard.inFlight.pop_front();
+            }
+            begin = end + 1;
+        }
+        shard.input.erase(0, begin);
+    }
+
+    /**
+     * Перезапуск упавшего шарда. Его сеансы потеряны,
+     * поэтому запросы без ответа получают статус unknown.
+     *
+     * \param index Номер шарда
+     * \return
+     */
+    void Restart(
+        const std::size_t index)
+    {
+        auto& shard = m_shards[index];
+        ::close(shard.fd);
+        shard.fd = -1;
+        ::waitpid(shard.pid, nullptr, 0);
+        logger->Log(LogLevel::Warning, u8"Шард " + std::to_string(index)
+            + u8" завершился, запросов без ответа: " + std::to_string(shard.inFlight.size()));
+        ++m_restarts;
+        for (const auto sequence : shard.inFlight) {
+            Complete(sequence, sequence ? "unknown\t0\t\t\n" : "");
+        }
+        shard.inFlight.clear();
+        shard.input.clear();
+        shard.output.clear();
+        Spawn(index);
+    }
+
+    // Загруженная экспертная система
+    const IExpertSystem& m_base;
+    // Параметры кластера
+    ShardClusterOptions m_options;
+    // Кольцо хешей текущих шардов
+    HashRing m_ring;
+    // Шарды
+    std::vector<ShardProcess> m_shards;
+    // Дескрипторы ожидания
+    std::vector<pollfd> m_fds;
+    // Ответы, ожидающие вывода по порядку, начиная с m_nextOutput.
+    // Пустая строка - ответа ещё нет
+    std::deque<std::string> m_done;
+    // Ответы на служебные запросы
+    std::vector<std::string> m_internal;
+    // Номер следующего запроса
+    std::uint64_t m_nextSequence = 1;
+    // Номер следующего выводимого ответа
+    std::uint64_t m_nextOutput = 1;
+    // Следующий идентификатор сеанса
+    std::uint64_t m_nextSession = 1;
+    // Запрошенное количество шардов, либо 0
+    std::size_t m_resize = 0;
+    // Номер запроса изменения количества шардов
+    std::uint64_t m_resizeSequence = 0;
+    // Количество перераспределений
+    std::size_t m_rebalances = 0;
+    // Количество перенесённых сеансов
+    std::uint64_t m_moved = 0;
+    // Количество сеансов, потерянных при перераспределении
+    std::uint64_t m_lost = 0;
+    // Количество перезапусков шардов
+    std::size_t m_restarts = 0;
+};
+
+}
+
+/**
+ * Создание кластера шардов и запуск процессов-шардов.
+ *
+ * \param base Загруженная экспертная система
+ * \param options Параметры кластера
+ * \return Кластер шардов
+ */
+std::unique_ptr<IShardCluster> CreateShardCluster(
+    const IExpertSystem& base,
+    const ShardClusterOptions& options) noexcept(false)
+{
+    return std::make_unique<ShardCluster>(base, options);
+}
+
+}
+
+#else
+
+namespace ES
+{
+
+std::unique_ptr<IShardCluster> CreateShardCluster(
+    const IExpertSystem&,
+    const ShardClusterOptions&) noexcept(false)
+{
+    throw std::runtime_error(u8"Кластер шардов не поддерживается на этой платформе");
+}
+
+}
+
+#endif
@@ -0,0 +1,313 @@
+﻿#include "SharedSessionTable.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#if defined(__unix__) || defined(__APPLE__)
+#   include <signal.h>
+#   include <sys/mman.h>
+#   include <unistd.h>
+#   define ES_SHARED_MEMORY 1
+#endif
+
+namespace ES
+{
+
+// Значения идентификатора свободной, закрытой и создаваемой ячейки
+constexpr std::uint64_t kFreeSlot = 0;
+constexpr std::uint64_t kClosedSlot = ~std::uint64_t(0);
+constexpr std::uint64_t kReservedSlot = ~std::uint64_t(0) - 1;
+
+/**
+ * Создание таблицы сеансов в разделяемой памяти.
+ *
+ * \param options Параметры таблицы
+ * \return Таблица сеансов
+ */
+std::shared_ptr<ISessionTable> CreateSharedSessionTable(
+    const SessionTableOptions& options) noexcept(false)
+{
+    return std::make_shared<SharedSessionTable>(options);
+}
+
+/**
+ * Идентификатор текущего процесса.
+ *
+ * \return Идентификатор процесса
+ */
+static std::uint32_t CurrentProcess() noexcept
+{
+#if defined(ES_SHARED_MEMORY)
+    return static_cast<std::uint32_t>(::getpid());
+#else
+    return 1;
+#endif
+}
+
+/**
+ * Проверка, что процесс завершился.
+ *
+ * \param process Идентификатор процесса
+ * \return true - если процесса больше нет
+ */
+static bool IsProcessGone(
+    const std::uint32_t process) noexcept
+{
+#if defined(ES_SHARED_MEMORY)
+    return ::kill(static_cast<pid_t>(process), 0) == -1 && errno == ESRCH;
+#else
+    (void)process;
+    return false;
+#endif
+}
+
+/**
+ * Конструктор. Отображает разделяемую память.
+ * Анонимная память заполнена нулями, поэтому все ячейки свободны.
+ *
+ * \param options Параметры таблицы
+ */
+SharedSessionTable::SharedSessionTable(
+    const SessionTableOptions& options) noexcept(false)
+{
+    std::size_t capacity = 1;
+    while (capacity < options.capacity) {
+        capacity *= 2;
+    }
+    m_mask = capacity - 1;
+    m_maxDepth = options.maxDepth;
+    m_recordBytes = sizeof(SessionRecord) + (m_maxDepth + 1) / 2 * 2 * sizeof(int);
+    m_slotBytes = (sizeof(SessionSlot) + 2 * m_recordBytes + 63) / 64 * 64;
+    m_bytes = sizeof(SessionTableHeader) + capacity * m_slotBytes;
+#if defined(ES_SHARED_MEMORY)
+    m_memory = ::mmap(nullptr, m_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (m_memory == MAP_FAILED) {
+        m_memory = nullptr;
+        throw std::runtime_error(u8"Не удалось отобразить разделяемую память таблицы сеансов: "
+            + std::string(std::strerror(errno)));
+    }
+#else
+    throw std::runtime_error(u8"Разделяемая таблица сеансов не поддерживается");
+#endif
+    m_header = static_cast<SessionTableHeader*>(m_memory);
+    m_slots = reinterpret_cast<std::uint8_t*>(m_header + 1);
+    m_header->nextID.store(1, std::memory_order_relaxed);
+}
+
+/**
+ * Деструктор. Освобождает отображение текущего процесса.
+ * Другие процессы продолжают работать со своими отображениями.
+ */
+SharedSessionTable::~SharedSessionTable()
+{
+#if defined(ES_SHARED_MEMORY)
+    if (m_memory) {
+        ::munmap(m_memory, m_bytes);
+    }
+#endif
+}
+
+/**
+ * Поиск ячейки сеанса.
+ *
+ * \param sessionID Идентификатор сеанса
+ * \return Ячейка, либо nullptr, если сеанс не открыт
+ */
+SessionSlot* SharedSessionTable::Find(
+    const std::uint64_t sessionID) const noexcept
+{
+    if (sessionID == kFreeSlot || sessionID >= kReservedSlot) {
+        return nullptr;
+    }
+    auto index = static_cast<std::size_t>(sessionID * 0x9E3779B97F4A7C15ull);
+    for (std::size_t probe = 0; probe <= m_mask; ++probe, ++index) {
+        auto& slot = Slot(index & m_mask);
+        const auto id = slot.id.load(std::memory_order_acquire);
+        if (id == sessionID) {
+            return &slot;
+        }
+        if (id == kFreeSlot) {
+            return nullptr;
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * Захват ячейки для изменения.
+ * Это единственное ожидание в таблице: процесс, изменяющий занятый
+ * сеанс, уступает процессор, пока ячейка не освободится.
+ * Если ячейку держит завершившийся процесс, она отбирается у него:
+ * его незавершённое изменение лежит в нетекущей копии и просто теряется.
+ *
+ * \param slot Ячейка
+ * \return
+ */
+void SharedSessionTable::Lock(
+    SessionSlot& slot) noexcept
+{
+    const auto self = CurrentProcess();
+    for (std::size_t attempt = 0;; ++attempt) {
+        auto owner = slot.owner.load(std::memory_order_relaxed);
+        if (owner == 0) {
+            if (slot.owner.compare_exchange_weak(owner, self, std::memory_order_acquire)) {
+                return;
+            }
+            continue;
+        }
+        if (owner != self && attempt % 64 == 63 && IsProcessGone(owner)
+            && slot.owner.compare_exchange_strong(owner, self, std::memory_order_acquire)) {
+            m_header->recovered.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        std::this_thread::yield();
+    }
+}
+
+/**
+ * Создание сеанса в начальном состоянии.
+ *
+ * \return Идентификатор сеанса, либо 0, если таблица заполнена
+ */
+std::uint64_t SharedSessionTable::Create()
+{
+    const auto sessionID = m_header->nextID.fetch_add(1, std::memory_order_relaxed);
+    auto index = static_cast<std::size_t>(sessionID * 0x9E3779B97F4A7C15ull);
+    for (std::size_t probe = 0; probe <= m_mask; ++probe, ++index) {
+        auto& slot = Slot(index & m_mask);
+        auto id = slot.id.load(std::memory_order_relaxed);
+        if ((id != kFreeSlot && id != kClosedSlot)
+            || !slot.id.compare_exchange_strong(id, kReservedSlot, std::memory_order_acquire)) {
+            continue;
+        }
+        // Пока ячейка создаётся, её не видит ни один читатель
+        const auto generation = slot.generation.load(std::memory_order_relaxed);
+        Record(slot, generation) = SessionRecord();
+        slot.id.store(sessionID, std::memory_order_release);
+        m_header->size.fetch_add(1, std::memory_order_relaxed);
+        return sessionID;
+    }
+    return 0;
+}
+
+/**
+ * Чтение состояния сеанса.
+ * Состояние копируется, пока номер поколения не изменится за время копирования.
+ *
+ * \param sessionID Идентификатор сеанса
+ * \param state Состояние сеанса
+ * \return true - если сеанс открыт
+ */
+bool SharedSessionTable::Read(
+    const std::uint64_t sessionID,
+    SessionState& state) const
+{
+    const auto slot = Find(sessionID);
+    if (!slot) {
+        return false;
+    }
+    while (true) {
+        const auto generation = slot->generation.load(std::memory_order_acquire);
+        auto& record = Record(*slot, generation);
+        state.sequence = record.sequence;
+        // Длина, прочитанная во время записи, может быть любой,
+        // но такое чтение всё равно повторяется
+        state.path.resize(static_cast<std::size_t>(std::min<std::uint64_t>(record.depth, m_maxDepth)));
+        std::memcpy(state.path.data(), Path(record), state.path.size() * sizeof(int));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot->generation.load(std::memory_order_relaxed) == generation) {
+            return slot->id.load(std::memory_order_relaxed) == sessionID;
+        }
+    }
+}
+
+/**
+ * Изменение состояния сеанса.
+ *
+ * \param sessionID Идентификатор сеанса
+ * \param change Функция изменения
+ * \return true - если сеанс открыт
+ */
+bool SharedSessionTable::Update(
+    const std::uint64_t sessionID,
+    const std::function<bool(SessionState&)>& change)
+{
+    const auto slot = Find(sessionID);
+    if (!slot) {
+        return false;
+    }
+    Lock(*slot);
+    // Отпускаем ячейку и при исключении в функции изменения
+    struct Unlock
+    {
+        SessionSlot& slot;
+        ~Unlock() { slot.owner.store(0, std::memory_order_release); }
+    } unlock{ *slot };
+    // Сеанс мог быть закрыт, пока ячейка ждала
+    if (slot->id.load(std::memory_order_relaxed) != sessionID) {
+        return false;
+    }
+    const auto generation = slot->generation.load(std::memory_order_relaxed);
+    auto& current = Record(*slot, generation);
+    SessionState state;
+    state.sequence = current.sequence;
+    state.path.assign(Path(current), Path(current) + current.depth);
+    if (!change(state)) {
+        return true;
+    }
+    if (state.path.size() > m_maxDepth) {
+        throw std::length_error(u8"Путь сеанса " + std::to_string(sessionID) + u8" длиннее "
+            + std::to_string(m_maxDepth) + u8" узлов");
+    }
+    auto& next = Record(*slot, generation + 1);
+    next.sequence = state.sequence;
+    next.depth = state.path.size();
+    std::copy(state.path.begin(), state.path.end(), Path(next));
+    slot->generation.store(generation + 1, std::memory_order_release);
+    return true;
+}
+
+/**
+ * Закрытие сеанса.
+ *
+ * \param sessionID Идентификатор сеанса
+ * \return true - если сеанс был открыт
+ */
+bool SharedSessionTable::Close(
+    const std::uint64_t sessionID)
+{
+    const auto slot = Find(sessionID);
+    if (!slot) {
+        return false;
+    }
+    Lock(*slot);
+    auto id = sessionID;
+    const bool closed = slot->id.compare_exchange_strong(id, kClosedSlot, std::memory_order_release);
+    slot->owner.store(0, std::memory_order_release);
+    if (closed) {
+        m_header->size.fetch_sub(1, std::memory_order_relaxed);
+    }
+    return closed;
+}
+
+/**
+ * Получение статистики таблицы.
+ *
+ * \return Статистика
+ */
+SessionTableStats SharedSessionTable::GetStats() const
+{
+    SessionTableStats stats;
+    stats.capacity = m_mask + 1;
+    stats.maxDepth = m_maxDepth;
+    stats.size = static_cast<std::size_t>(m_header->size.load(std::memory_order_relaxed));
+    stats.recovered = m_header->recovered.load(std::memory_order_relaxed);
+    stats.bytes = m_bytes;
+    return stats;
+}
+
+}
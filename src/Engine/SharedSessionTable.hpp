@@ -0,0 +1,149 @@
+﻿#pragma once
+
+#include "ISessionTable.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace ES
+{
+
+/**
+ * Копия состояния сеанса в ячейке.
+ * За ней следует место под путь наибольшей глубины.
+ */
+struct SessionRecord
+{
+    // Номер последнего применённого запроса
+    std::uint64_t sequence;
+    // Длина пути
+    std::uint64_t depth;
+};
+
+/**
+ * Заголовок ячейки таблицы сеансов.
+ * За заголовком следуют две копии состояния: изменение пишется
+ * в копию, не являющуюся текущей, и становится текущим увеличением
+ * номера поколения. Поэтому процесс, завершившийся посреди
+ * изменения, не портит текущее состояние.
+ * Изменяющий процесс держит ячейку, записав свой идентификатор
+ * в owner: так изменения одного сеанса упорядочены без повторов
+ * функции изменения, у которой в обработчике есть побочные
+ * действия над сеансом. Ячейку умершего процесса отбирает
+ * следующий ждущий процесс.
+ */
+struct alignas(64) SessionSlot
+{
+    // Идентификатор сеанса, либо kFreeSlot, kClosedSlot, kReservedSlot
+    std::atomic<std::uint64_t> id;
+    // Процесс, изменяющий сеанс, либо 0
+    std::atomic<std::uint32_t> owner;
+    // Количество сохранённых изменений. Текущая копия - generation & 1
+    std::atomic<std::uint64_t> generation;
+};
+
+/**
+ * Заголовок разделяемой памяти таблицы.
+ */
+struct alignas(64) SessionTableHeader
+{
+    // Следующий идентификатор сеанса
+    std::atomic<std::uint64_t> nextID;
+    // Количество открытых сеансов
+    std::atomic<std::uint64_t> size;
+    // Количество изменений, прерванных завершением процесса
+    std::atomic<std::uint64_t> recovered;
+};
+
+/**
+ * Таблица сеансов в анонимной разделяемой памяти.
+ * Размер ячейки определяется наибольшей глубиной пути.
+ * Ячейки ищутся открытой адресацией по идентификатору сеанса.
+ * Идентификаторы выдаются счётчиком и не повторяются, поэтому
+ * закрытая ячейка может быть занята новым сеансом без риска
+ * двух ячеек с одним идентификатором.
+ */
+class SharedSessionTable final:
+    public ISessionTable
+{
+public:
+    /**
+     * Конструктор. Отображает разделяемую память.
+     *
+     * \param options Параметры таблицы
+     */
+    explicit SharedSessionTable(
+        const SessionTableOptions& options) noexcept(false);
+
+    /**
+     * Деструктор. Освобождает отображение текущего процесса.
+     */
+    ~SharedSessionTable();
+
+    SharedSessionTable(const SharedSessionTable&) = delete;
+    SharedSessionTable& operator=(const SharedSessionTable&) = delete;
+
+    // Реализация интерфейса ISessionTable
+
+    std::uint64_t Create() override;
+
+    bool Read(
+        const std::uint64_t sessionID,
+        SessionState& state) const override;
+
+    bool Update(
+        const std::uint64_t sessionID,
+        const std::function<bool(SessionState&)>& change) override;
+
+    bool Close(
+        const std::uint64_t sessionID) override;
+
+    SessionTableStats GetStats() const override;
+
+private:
+    SessionSlot& Slot(
+        const std::size_t index) const noexcept
+    {
+        return *reinterpret_cast<SessionSlot*>(m_slots + index * m_slotBytes);
+    }
+
+    SessionRecord& Record(
+        SessionSlot& slot,
+        const std::uint64_t generation) const noexcept
+    {
+        return *reinterpret_cast<SessionRecord*>(reinterpret_cast<std::uint8_t*>(&slot + 1)
+            + (generation & 1) * m_recordBytes);
+    }
+
+    static int* Path(
+        SessionRecord& record) noexcept
+    {
+        return reinterpret_cast<int*>(&record + 1);
+    }
+
+    SessionSlot* Find(
+        const std::uint64_t sessionID) const noexcept;
+
+    void Lock(
+        SessionSlot& slot) noexcept;
+
+    // Отображённая память: заголовок и ячейки
+    void* m_memory = nullptr;
+    // Размер отображения в байтах
+    std::size_t m_bytes = 0;
+    // Заголовок таблицы
+    SessionTableHeader* m_header = nullptr;
+    // Ячейки таблицы
+    std::uint8_t* m_slots = nullptr;
+    // Количество ячеек минус один (степень двойки минус один)
+    std::size_t m_mask = 0;
+    // Наибольшая глубина пути
+    std::size_t m_maxDepth = 0;
+    // Размер копии состояния с путём в байтах
+    std::size_t m_recordBytes = 0;
+    // Размер ячейки в байтах, кратный 64
+    std::size_t m_slotBytes = 0;
+};
+
+}
@@ -1,6 +1,5 @@
 ﻿#include "StdOutLogger.hpp"
 
-#include <memory>
 #include <iostream>
 
 namespace ES
@@ -13,15 +12,12 @@ namespace ES
  */
 ILogger* DefaultLoggerInstance()
 {
-    // Указатель на логгер по умолчанию
-    static std::unique_ptr<ILogger> defaultLogger;
-    // Если логгер ещё не создан,
-    if (!defaultLogger) {
-        // создадим его
-        defaultLogger = std::make_unique<StdOutLogger>();
-    }
+    // Логгер по умолчанию. Инициализация локальной статической
+    // переменной потокобезопасна, поэтому первый вызов
+    // из нескольких потоков создаст ровно один логгер
+    static StdOutLogger defaultLogger;
     // Вернём указатель на логгер
-    return defaultLogger.get();
+    return &defaultLogger;
 }
 
 /**
@@ -41,6 +37,7 @@ static std::string LogLevelToString(
     case LogLevel::Info:
         return "[INFO   ]";
     }
+    return "[UNKNOWN]";
 }
 
 /**
@@ -55,10 +52,11 @@ void StdOutLogger::Log(
     const std::string& log)
 {
     // Запираем мьютекс, чтобы монопольно завладеть кодом ниже
-    std::unique_lock<decltype(m_logLock)> lock;
-    // Пишем сообщение в стандартный вывод, выведя перед сообщением
-    // уровень лога
-    std::cout << LogLevelToString(level) << ": " << log << std::endl;
+    std::lock_guard<decltype(m_logLock)> lock(m_logLock);
+    // Пишем сообщение в стандартный поток ошибок, выведя перед сообщением
+    // уровень лога. Стандартный вывод занят результатами пакетного
+    // и многопроцессного режимов, и лог не должен в них попадать
+    std::cerr << LogLevelToString(level) << ": " << log << std::endl;
 }
 
 }
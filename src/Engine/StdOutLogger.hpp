@@ -8,7 +8,9 @@ namespace ES
 {
 
 /**
- * Класс логгера, выводящего сообщения в стандартный вывод.
+ * Класс логгера, выводящего сообщения в стандартный поток ошибок.
+ * Может использоваться из нескольких потоков:
+ * сообщения не перемешиваются.
  */
 class StdOutLogger final:
     public ILogger
@@ -22,7 +24,7 @@ public:
         const LogLevel level,
         const std::string& log);
 private:
-    // Мьютекс, обеспечивающий монопольную запись в стандартный вывод
+    // Мьютекс, обеспечивающий монопольную запись в поток
     std::mutex m_logLock;
 };
 
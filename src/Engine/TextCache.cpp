@@ -0,0 +1,94 @@
+﻿#include "TextCache.hpp"
+
+namespace ES
+{
+
+/**
+ * Изменение количества хранимых текстов.
+ * Память под тексты выделяется при первом обращении,
+ * поэтому сеансы без сжатых текстов её не занимают.
+ *
+ * \param size Количество текстов (не меньше одного)
+ * \return
+ */
+void TextCache::Resize(
+    const std::size_t size)
+{
+    m_size = size ? size : 1;
+    m_entries.clear();
+    m_entries.shrink_to_fit();
+    m_last = 0;
+    Clear();
+}
+
+/**
+ * Очистка кэша.
+ * Выделенная под строки память сохраняется.
+ *
+ * \return
+ */
+void TextCache::Clear() noexcept
+{
+    for (auto& entry : m_entries) {
+        entry.index = kInvalidIndex;
+        entry.used = 0;
+    }
+    m_blockStore = nullptr;
+    m_block = static_cast<std::size_t>(-1);
+}
+
+/**
+ * Получение текста узла.
+ * Кэш небольшой, поэтому текст ищется перебором,
+ * а при промахе вытесняется давно не использованный текст.
+ *
+ * \param store Хранилище текстов
+ * \param index Индекс узла
+ * \return Текст узла
+ */
+const std::string& TextCache::Get(
+    const TextStore& store,
+    const node_index_t index)
+{
+    if (m_entries.empty()) {
+        m_entries.resize(m_size);
+    }
+    // Чаще всего текст текущего узла запрашивают повторно
+    if (m_entries[m_last].index == index) {
+        return m_entries[m_last].text;
+    }
+    auto victim = &m_entries.front();
+    for (auto& entry : m_entries) {
+        if (entry.index == index) {
+            entry.used = ++m_clock;
+            m_last = static_cast<std::size_t>(&entry - m_entries.data());
+            return entry.text;
+        }
+        if (entry.used < victim->used) {
+            victim = &entry;
+        }
+    }
+    victim->index = index;
+    victim->used = ++m_clock;
+    if (!store.Compressed()) {
+        // Несжатый текст копируем напрямую
+        victim->text.assign(store.RawText(index), store.Length(index));
+    }
+    else {
+        // Разжимаем блок только до конца нужного текста
+        const auto block = store.BlockOf(index);
+        const auto offset = store.OffsetInBlock(index);
+        const auto length = store.Length(index);
+        if (&store != m_blockStore || block != m_block
+            || offset + length > m_blockData.size()) {
+            store.DecompressBlock(block, offset + length, m_blockData);
+            m_blockStore = &store;
+            m_block = block;
+        }
+        victim->text.assign(m_blockData, offset, length);
+    }
+    m_last = static_cast<std::size_t>(victim - m_entries.data());
+    return victim->text;
+}
+
+}
@@ -0,0 +1,83 @@
+﻿#pragma once
+
+#include "TextStore.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ES
+{
+
+/**
+ * Кэш разжатых текстов узлов.
+ * Принадлежит одному сеансу и не синхронизируется.
+ * Каждый текст сеанс всегда берёт из одного и того же хранилища,
+ * поэтому тексты в кэше различаются только индексами узлов.
+ * Хранит несколько последних показанных текстов и последний
+ * разжатый блок, из которого без разжатия берутся соседние тексты.
+ * Строки кэша переиспользуются, поэтому после заполнения
+ * кэш не выделяет память.
+ */
+class TextCache final
+{
+public:
+    /**
+     * Изменение количества хранимых текстов.
+     * Кэш при этом очищается.
+     *
+     * \param size Количество текстов
+     * \return
+     */
+    void Resize(
+        const std::size_t size);
+
+    /**
+     * Очистка кэша.
+     * Вызывается при переходе сеанса на другое хранилище текстов.
+     *
+     * \return
+     */
+    void Clear() noexcept;
+
+    /**
+     * Получение текста узла.
+     *
+     * \param store Хранилище текстов
+     * \param index Индекс узла
+     * \return Текст узла. Ссылка действительна до следующего
+     * вызова Get с другим индексом
+     */
+    const std::string& Get(
+        const TextStore& store,
+        const node_index_t index);
+
+private:
+    // Разжатый текст
+    struct Entry
+    {
+        // Индекс узла
+        node_index_t index = kInvalidIndex;
+        // Момент последнего обращения
+        std::uint64_t used = 0;
+        // Текст узла
+        std::string text;
+    };
+
+    // Количество хранимых текстов
+    std::size_t m_size = 1;
+    // Разжатые тексты. Создаются при первом обращении
+    std::vector<Entry> m_entries;
+    // Номер последнего запрошенного текста
+    std::size_t m_last = 0;
+    // Счётчик обращений
+    std::uint64_t m_clock = 0;
+    // Хранилище последнего разжатого блока
+    const TextStore* m_blockStore = nullptr;
+    // Номер последнего разжатого блока
+    std::size_t m_block = static_cast<std::size_t>(-1);
+    // Последний разжатый блок
+    std::string m_blockData;
+};
+
+}
@@ -0,0 +1,416 @@
+﻿#include "TextStore.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace ES
+{
+
+namespace
+{
+
+// Минимальная длина повтора
+constexpr std::size_t kMinMatch = 4;
+// Максимальное расстояние до повтора
+constexpr std::size_t kMaxDistance = 0xFFFF;
+// Размер хеш-таблицы поиска повторов (степень двойки)
+constexpr unsigned kHashBits = 14;
+
+/**
+ * Хеш четырёх байт, начиная с заданной позиции.
+ *
+ * \param data Данные
+ * \return Номер ячейки хеш-таблицы
+ */
+std::uint32_t Hash(
+    const char* data) noexcept
+{
+    std::uint32_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return (value * 2654435761u) >> (32 - kHashBits);
+}
+
+/**
+ * Запись длины сверх значения, уместившегося в токене.
+ *
+ * \param length Остаток длины
+ * \param out Сжатые данные
+ * \return
+ */
+void WriteLength(
+    std::size_t length,
+    std::string& out)
+{
+    for (; length >= 255; length -= 255) {
+        out.push_back(static_cast<char>(255));
+    }
+    out.push_back(static_cast<char>(length));
+}
+
+/**
+ * Чтение длины сверх значения, уместившегося в токене.
+ *
+ * \param in Позиция в сжатых данных
+ * \return Остаток длины
+ */
+std::size_t ReadLength(
+    const unsigned char*& in) noexcept
+{
+    std::size_t length = 0;
+    unsigned char byte;
+    do {
+        byte = *in++;
+        length += byte;
+    } while (byte == 255);
+    return length;
+}
+
+/**
+ * Запись последовательности: литералы и следующий за ними повтор.
+ * Формат совпадает с блоком LZ4: токен (4 бита длины литералов,
+ * 4 бита длины повтора), литералы, расстояние (2 байта),
+ * продолжения длин по 255. Последняя последовательность
+ * блока состоит только из литералов.
+ *
+ * \param literals Литералы
+ * \param literalsLength Количество литералов
+ * \param distance Расстояние до повтора (0 - последняя последовательность)
+ * \param matchLength Длина повтора
+ * \param out Сжатые данные
+ * \return
+ */
+void WriteSequence(
+    const char* literals,
+    const std::size_t literalsLength,
+    const std::size_t distance,
+    const std::size_t matchLength,
+    std::string& out)
+{
+    const auto match = distance ? matchLength - kMinMatch : 0;
+    out.push_back(static_cast<char>(
+        (std::min<std::size_t>(literalsLength, 15) << 4) | std::min<std::size_t>(match, 15)));
+    if (literalsLength >= 15) {
+        WriteLength(literalsLength - 15, out);
+    }
+    out.append(literals, literalsLength);
+    if (!distance) {
+        return;
+    }
+    out.push_back(static_cast<char>(distance & 0xFF));
+    out.push_back(static_cast<char>(distance >> 8));
+    if (match >= 15) {
+        WriteLength(match - 15, out);
+    }
+}
+
+}
+
+/**
+ * Конструктор.
+ * Хеш-таблица словаря строится один раз: в неё попадает
+ * только конец словаря, до которого достают повторы блоков.
+ *
+ * \param dictionary Общий словарь
+ * \param blockSize Размер блока несжатых текстов в байтах
+ * \param compress Сжимать блоки
+ */
+TextStore::TextStore(
+    std::string dictionary,
+    const std::size_t blockSize,
+    const bool compress) noexcept(false):
+    m_dictionary(compress ? std::move(dictionary) : std::string()),
+    m_blockSize(blockSize ? blockSize : 1),
+    m_compress(compress)
+{
+    if (!m_compress) {
+        return;
+    }
+    m_dictionaryTable.assign(std::size_t(1) << kHashBits, 0);
+    const auto size = m_dictionary.size();
+    for (auto position = size > kMaxDistance ? size - kMaxDistance : 0;
+        position + kMinMatch <= size; ++position) {
+        m_dictionaryTable[Hash(&m_dictionary[position])] = static_cast<std::uint32_t>(position + 1);
+    }
+}
+
+/**
+ * Построение словаря по выборке текстов.
+ * Берётся каждый k-й текст так, чтобы выборка
+ * примерно совпала с размером словаря.
+ *
+ * \param texts Тексты
+ * \param size Размер словаря в байтах
+ * \return Словарь
+ */
+std::string TextStore::BuildDictionary(
+    const std::vector<std::string_view>& texts,
+    const std::size_t size)
+{
+    std::size_t total = 0;
+    for (const auto text : texts) {
+        total += text.size();
+    }
+    std::string dictionary;
+    if (!size || !total) {
+        return dictionary;
+    }
+    dictionary.reserve(std::min(size, total));
+    const auto step = std::max<std::size_t>(1, total / size);
+    for (std::size_t i = 0; i < texts.size() && dictionary.size() < size; i += step) {
+        dictionary.append(texts[i].substr(0, size - dictionary.size()));
+    }
+    return dictionary;
+}
+
+/**
+ * Добавление текста с очередным индексом.
+ * Текст копируется в накапливаемый блок, заполненный блок сжимается.
+ *
+ * \param text Текст
+ * \return
+ */
+void TextStore::Add(
+    const std::string_view text)
+{
+    // Начинаем новый блок, если предыдущий уже сжат
+    if (m_blockStarts.size() < m_blockOffsets.size()) {
+        m_blockStarts.push_back(m_offsets.back());
+    }
+    m_pending += text;
+    m_offsets.push_back(m_offsets.back() + text.size());
+    if (!m_missing.empty()) {
+        m_missing.push_back(false);
+    }
+    if (m_pending.size() >= m_blockSize) {
+        CompressPending();
+    }
+}
+
+/**
+ * Добавление отсутствующего текста с очередным индексом.
+ * Признаки отсутствия заводятся при первом отсутствующем тексте.
+ *
+ * \return
+ */
+void TextStore::AddMissing()
+{
+    if (m_missing.empty()) {
+        m_missing.resize(Count(), false);
+    }
+    Add(std::string_view());
+    m_missing.back() = true;
+}
+
+/**
+ * Сжатие последнего неполного блока.
+ *
+ * \return
+ */
+void TextStore::Finish()
+{
+    if (m_blockStarts.size() == m_blockOffsets.size()) {
+        CompressPending();
+    }
+    m_pending.shrink_to_fit();
+    m_dictionaryTable.clear();
+    m_dictionaryTable.shrink_to_fit();
+    m_blockTable.clear();
+    m_blockTable.shrink_to_fit();
+    m_data.shrink_to_fit();
+    m_offsets.shrink_to_fit();
+    m_blockStarts.shrink_to_fit();
+    m_blockOffsets.shrink_to_fit();
+    m_missing.shrink_to_fit();
+}
+
+/**
+ * Сжатие накопленного блока.
+ * Несжатый блок просто дописывается в хранилище.
+ * Блок сжимается жадным поиском повторов: сначала среди уже
+ * пройденной части блока, затем в словаре по его готовой таблице.
+ * Таблица блока не очищается между блоками: устаревшая позиция
+ * лишь указывает на другие байты блока и отсеивается сравнением.
+ *
+ * \return
+ */
+void TextStore::CompressPending()
+{
+    if (!m_compress) {
+        m_data += m_pending;
+        m_blockOffsets.push_back(m_data.size());
+        m_pending.clear();
+        return;
+    }
+    if (m_blockTable.empty()) {
+        m_blockTable.assign(std::size_t(1) << kHashBits, 0);
+    }
+    const char* block = m_pending.data();
+    const std::size_t end = m_pending.size();
+    const char* dictionary = m_dictionary.data();
+    const std::size_t dictionarySize = m_dictionary.size();
+    std::size_t anchor = 0;
+    std::size_t position = 0;
+    while (position + kMinMatch <= end) {
+        const auto hash = Hash(block + position);
+        const std::size_t candidate = m_blockTable[hash];
+        m_blockTable[hash] = static_cast<std::uint32_t>(position + 1);
+        std::size_t distance = 0;
+        std::size_t length = 0;
+        if (candidate && candidate - 1 < position
+            && position - (candidate - 1) <= kMaxDistance
+            && std::memcmp(block + candidate - 1, block + position, kMinMatch) == 0) {
+            const auto from = candidate - 1;
+            distance = position - from;
+            length = kMinMatch;
+            while (position + length < end && block[from + length] == block[position + length]) {
+                ++length;
+            }
+        }
+        else if (const std::size_t entry = m_dictionaryTable[hash];
+            entry && dictionarySize - (entry - 1) + position <= kMaxDistance
+            && std::memcmp(dictionary + entry - 1, block + position, kMinMatch) == 0) {
+            // Повтор из словаря может продолжиться в начале блока
+            const auto from = entry - 1;
+            distance = dictionarySize - from + position;
+            length = kMinMatch;
+            while (position + length < end
+                && (from + length < dictionarySize
+                    ? dictionary[from + length]
+                    : block[from + length - dictionarySize]) == block[position + length]) {
+                ++length;
+            }
+        }
+        if (!distance) {
+            ++position;
+            continue;
+        }
+        WriteSequence(block + anchor, position - anchor, distance, length, m_data);
+        position += length;
+        anchor = position;
+    }
+    WriteSequence(block + anchor, end - anchor, 0, 0, m_data);
+    m_blockOffsets.push_back(m_data.size());
+    m_pending.clear();
+}
+
+/**
+ * Получение номера блока, содержащего текст.
+ *
+ * \param index Индекс текста
+ * \return Номер блока
+ */
+std::size_t TextStore::BlockOf(
+    const node_index_t index) const noexcept
+{
+    // Ищем последний блок, начинающийся не позже текста
+    auto it = std::upper_bound(m_blockStarts.begin(), m_blockStarts.end(), m_offsets[index]);
+    return static_cast<std::size_t>(it - m_blockStarts.begin()) - 1;
+}
+
+/**
+ * Получение смещения текста внутри разжатого блока.
+ *
+ * \param index Индекс текста
+ * \return Смещение текста в байтах
+ */
+std::size_t TextStore::OffsetInBlock(
+    const node_index_t index) const noexcept
+{
+    return static_cast<std::size_t>(m_offsets[index] - m_blockStarts[BlockOf(index)]);
+}
+
+/**
+ * Получение текста из несжатого хранилища без копирования.
+ *
+ * \param index Индекс текста
+ * \return Указатель на начало текста
+ */
+const char* TextStore::RawText(
+    const node_index_t index) const noexcept
+{
+    return m_data.data() + m_blockOffsets[BlockOf(index)] + OffsetInBlock(index);
+}
+
+/**
+ * Разжатие начала блока.
+ * Повторы с расстоянием больше уже разжатой части
+ * берутся из конца словаря.
+ *
+ * \param block Номер блока
+ * \param size Сколько байт блока разжать
+ * \param out Буфер для разжатого блока
+ * \return
+ */
+void TextStore::DecompressBlock(
+    const std::size_t block,
+    const std::size_t size,
+    std::string& out) const
+{
+    const auto blockSize = static_cast<std::size_t>(
+        (block + 1 < m_blockStarts.size() ? m_blockStarts[block + 1] : m_offsets.back())
+        - m_blockStarts[block]);
+    // Последовательности не обрываем, поэтому буфер - под весь блок
+    out.resize(blockSize);
+    auto in = reinterpret_cast<const unsigned char*>(m_data.data()) + m_blockOffsets[block];
+    const auto end = reinterpret_cast<const unsigned char*>(m_data.data()) + m_blockOffsets[block + 1];
+    const auto dictionaryEnd = m_dictionary.data() + m_dictionary.size();
+    const auto begin = &out[0];
+    auto position = begin;
+    if (!m_compress) {
+        std::memcpy(begin, m_data.data() + m_blockOffsets[block], blockSize);
+        return;
+    }
+    while (in < end && static_cast<std::size_t>(position - begin) < size) {
+        const unsigned token = *in++;
+        std::size_t literals = token >> 4;
+        if (literals == 15) {
+            literals += ReadLength(in);
+        }
+        std::memcpy(position, in, literals);
+        position += literals;
+        in += literals;
+        if (in >= end) {
+            break;
+        }
+        const std::size_t distance = in[0] | (std::size_t(in[1]) << 8);
+        in += 2;
+        std::size_t length = token & 0x0F;
+        if (length == 15) {
+            length += ReadLength(in);
+        }
+        length += kMinMatch;
+        const auto decoded = static_cast<std::size_t>(position - begin);
+        if (distance > decoded) {
+            // Начало повтора в словаре, продолжение может быть уже в блоке
+            const auto fromDictionary = std::min(length, distance - decoded);
+            std::memcpy(position, dictionaryEnd - (distance - decoded), fromDictionary);
+            position += fromDictionary;
+            length -= fromDictionary;
+        }
+        if (distance >= length) {
+            std::memcpy(position, position - distance, length);
+            position += length;
+        }
+        else {
+            // Перекрывающийся повтор копируем побайтно
+            for (; length; --length, ++position) {
+                *position = *(position - distance);
+            }
+        }
+    }
+    out.resize(static_cast<std::size_t>(position - begin));
+}
+
+/**
+ * Получение размера хранилища в памяти.
+ *
+ * \return Размер в байтах
+ */
+std::size_t TextStore::CompressedBytes() const noexcept
+{
+    return m_dictionary.capacity() + m_data.capacity() + m_missing.capacity() / 8
+        + (m_offsets.capacity() + m_blockStarts.capacity() + m_blockOffsets.capacity())
+            * sizeof(std::uint64_t);
+}
+
+}
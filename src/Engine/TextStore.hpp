@@ -0,0 +1,215 @@
+﻿#pragma once
+
+#include "Types.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ES
+{
+
+/**
+ * Столбец текстов узлов.
+ * Тексты нумеруются индексами узлов и хранятся подряд блоками.
+ * Блоки могут сжиматься простым LZ-кодеком. Каждый блок сжимается
+ * независимо, но ссылки на повторы могут указывать в общий словарь,
+ * поэтому даже небольшие блоки сжимаются хорошо.
+ * После построения хранилище неизменяемо и разделяется
+ * всеми сеансами и копиями дерева.
+ */
+class TextStore final
+{
+public:
+    /**
+     * Конструктор.
+     *
+     * \param dictionary Общий словарь
+     * \param blockSize Размер блока несжатых текстов в байтах
+     * \param compress Сжимать блоки. Если false, то словарь не используется
+     */
+    TextStore(
+        std::string dictionary,
+        const std::size_t blockSize,
+        const bool compress = true) noexcept(false);
+
+    /**
+     * Построение словаря по выборке текстов.
+     * Тексты выбираются равномерно, чтобы словарь
+     * отражал всю базу знаний, а не только её начало.
+     *
+     * \param texts Тексты
+     * \param size Размер словаря в байтах
+     * \return Словарь
+     */
+    static std::string BuildDictionary(
+        const std::vector<std::string_view>& texts,
+        const std::size_t size);
+
+    /**
+     * Добавление текста с очередным индексом.
+     *
+     * \param text Текст
+     * \return
+     */
+    void Add(
+        const std::string_view text);
+
+    /**
+     * Добавление отсутствующего текста с очередным индексом.
+     *
+     * \return
+     */
+    void AddMissing();
+
+    /**
+     * Сжатие последнего неполного блока.
+     * Вызывается один раз после добавления всех текстов.
+     *
+     * \return
+     */
+    void Finish();
+
+    /**
+     * Получение количества текстов.
+     *
+     * \return Количество текстов
+     */
+    std::size_t Count() const noexcept
+    {
+        return m_offsets.size() - 1;
+    }
+
+    /**
+     * Проверка наличия текста.
+     *
+     * \param index Индекс текста
+     * \return false, если текст отсутствует либо индекс вне диапазона
+     */
+    bool Has(
+        const node_index_t index) const noexcept
+    {
+        return index < Count() && (m_missing.empty() || !m_missing[index]);
+    }
+
+    /**
+     * Проверка того, что блоки хранятся сжатыми.
+     *
+     * \return true - если блоки сжаты
+     */
+    bool Compressed() const noexcept
+    {
+        return m_compress;
+    }
+
+    /**
+     * Получение текста из несжатого хранилища без копирования.
+     *
+     * \param index Индекс текста
+     * \return Указатель на начало текста длиной Length(index)
+     */
+    const char* RawText(
+        const node_index_t index) const noexcept;
+
+    /**
+     * Получение номера блока, содержащего текст.
+     *
+     * \param index Индекс текста
+     * \return Номер блока
+     */
+    std::size_t BlockOf(
+        const node_index_t index) const noexcept;
+
+    /**
+     * Получение смещения текста внутри разжатого блока.
+     *
+     * \param index Индекс текста
+     * \return Смещение текста в байтах
+     */
+    std::size_t OffsetInBlock(
+        const node_index_t index) const noexcept;
+
+    /**
+     * Получение длины текста.
+     *
+     * \param index Индекс текста
+     * \return Длина текста в байтах
+     */
+    std::size_t Length(
+        const node_index_t index) const noexcept
+    {
+        return static_cast<std::size_t>(m_offsets[index + 1] - m_offsets[index]);
+    }
+
+    /**
+     * Разжатие начала блока.
+     *
+     * \param block Номер блока
+     * \param size Сколько байт блока разжать. Разжато может быть
+     * больше, но не дальше конца блока
+     * \param out Буфер для разжатого блока.
+     * Ёмкость буфера переиспользуется
+     * \return
+     */
+    void DecompressBlock(
+        const std::size_t block,
+        const std::size_t size,
+        std::string& out) const;
+
+    /**
+     * Получение суммарного размера несжатых текстов.
+     *
+     * \return Размер в байтах
+     */
+    std::size_t OriginalBytes() const noexcept
+    {
+        return static_cast<std::size_t>(m_offsets.back());
+    }
+
+    /**
+     * Получение размера хранилища в памяти:
+     * сжатые блоки, словарь и таблицы смещений.
+     *
+     * \return Размер в байтах
+     */
+    std::size_t CompressedBytes() const noexcept;
+
+private:
+    /**
+     * Сжатие накопленного блока.
+     *
+     * \return
+     */
+    void CompressPending();
+
+    // Общий словарь
+    std::string m_dictionary;
+    // Последняя позиция словаря (плюс один) для каждого значения хеша.
+    // Нужна только при построении и освобождается в Finish
+    std::vector<std::uint32_t> m_dictionaryTable;
+    // Последняя позиция блока (плюс один) для каждого значения хеша
+    std::vector<std::uint32_t> m_blockTable;
+    // Размер блока несжатых текстов
+    std::size_t m_blockSize;
+    // Признак сжатия блоков
+    bool m_compress;
+    // Признаки отсутствующих текстов.
+    // Пусто, если присутствуют все тексты
+    std::vector<bool> m_missing;
+    // Сжатые блоки, записанные подряд
+    std::string m_data;
+    // Смещения начала текстов в несжатом потоке.
+    // Последний элемент - общий размер текстов
+    std::vector<std::uint64_t> m_offsets{0};
+    // Смещения начала блоков в несжатом потоке
+    std::vector<std::uint64_t> m_blockStarts;
+    // Смещения начала сжатых блоков в m_data.
+    // Последний элемент - размер m_data
+    std::vector<std::uint64_t> m_blockOffsets{0};
+    // Несжатые тексты текущего блока
+    std::string m_pending;
+};
+
+}
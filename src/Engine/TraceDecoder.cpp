@@ -0,0 +1,152 @@
+﻿#include "TraceRecorder.hpp"
+#include "IExpertSystemLoader.hpp"
+#include "Tree.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+
+namespace ES
+{
+
+/**
+ * Чтение записей из файла трассы.
+ *
+ * \param path Путь к файлу
+ * \param records Записи, к которым добавляются прочитанные
+ * \return
+ */
+static void ReadTraceFile(
+    const std::filesystem::path& path,
+    std::vector<TraceRecord>& records)
+{
+    std::ifstream file(path, std::ios::binary);
+    char magic[sizeof(kTraceMagic)];
+    std::uint32_t header[2];
+    file.read(magic, sizeof(magic));
+    file.read(reinterpret_cast<char*>(header), sizeof(header));
+    if (!file || std::memcmp(magic, kTraceMagic, sizeof(magic)) != 0
+        || header[0] != sizeof(TraceRecord)) {
+        throw std::runtime_error(u8"Неверный файл трассы " + path.string());
+    }
+    const auto size = std::filesystem::file_size(path) - sizeof(magic) - sizeof(header);
+    const auto offset = records.size();
+    records.resize(offset + size / sizeof(TraceRecord));
+    file.read(reinterpret_cast<char*>(records.data() + offset),
+        static_cast<std::streamsize>((records.size() - offset) * sizeof(TraceRecord)));
+}
+
+/**
+ * Вывод прохода сеанса в формате пакетного режима.
+ *
+ * \param answers Принятые ответы прохода
+ * \param out Поток для вывода
+ * \return
+ */
+static void WriteReplayLine(
+    std::vector<std::int32_t>& answers,
+    std::ostream& out)
+{
+    if (answers.empty()) {
+        return;
+    }
+    for (std::size_t i = 0; i < answers.size(); ++i) {
+        out << (i ? " " : "") << answers[i];
+    }
+    out << '\n';
+    answers.clear();
+}
+
+/**
+ * Расшифровка трассы.
+ *
+ * \param directory Каталог с файлами трассы
+ * \param format Формат расшифровки
+ * \param configPath Путь к конфигурации экспертной системы (может быть пустым)
+ * \param out Поток для вывода
+ * \return Количество расшифрованных записей
+ */
+std::size_t DecodeTrace(
+    const std::string& directory,
+    const TraceFormat format,
+    const std::string& configPath,
+    std::ostream& out) noexcept(false)
+{
+    // Собираем файлы трассы в порядке номеров
+    std::vector<std::filesystem::path> files;
+    for (const auto& entry : std::filesystem::directory_iterator(directory)) {
+        const auto name = entry.path().filename().string();
+        if (name.rfind("trace-", 0) == 0 && entry.path().extension() == ".bin") {
+            files.push_back(entry.path());
+        }
+    }
+    std::sort(files.begin(), files.end());
+    std::vector<TraceRecord> records;
+    for (const auto& file : files) {
+        ReadTraceFile(file, records);
+    }
+    // Записи разных потоков перемешаны, упорядочиваем их по сеансам
+    // и номерам шагов. Время для порядка не годится: системные часы
+    // могут идти назад
+    std::sort(records.begin(), records.end(),
+        [](const TraceRecord& a, const TraceRecord& b)
+    {
+        return a.session != b.session ? a.session < b.session : a.sequence < b.sequence;
+    });
+
+    // Для текстового формата загружаем дерево, если задана конфигурация.
+    // Узлы ищутся по идентификаторам: индексы дерева, загруженного
+    // с нуля, не совпадают с индексами после перезагрузки с изменениями
+    Tree tree;
+    if (format == TraceFormat::Text && !configPath.empty()) {
+        CreateExpertSystemLoader()->Load(configPath, tree);
+        tree.Finish();
+    }
+
+    std::vector<std::int32_t> answers;
+    for (std::size_t i = 0; i < records.size(); ++i) {
+        const auto& record = records[i];
+        if (i && records[i - 1].session != record.session && format == TraceFormat::Replay) {
+            // Начался новый сеанс
+            WriteReplayLine(answers, out);
+        }
+        const bool reset = record.node == kTraceReset;
+        const bool back = record.node == kTraceBack;
+        const bool rejected = !reset && !back && (record.node & kTraceRejected);
+        const auto index = record.node & ~kTraceRejected;
+        if (format == TraceFormat::Replay) {
+            if (reset) {
+                WriteReplayLine(answers, out);
+            }
+            else if (back) {
+                // Отменённые ответы в повторный прогон не попадают
+                answers.resize(std::min<std::size_t>(answers.size(), record.answer));
+            }
+            else if (!rejected) {
+                answers.push_back(record.answer);
+            }
+            continue;
+        }
+        out << record.timestamp << '\t' << record.session << '\t';
+        if (reset) {
+            out << "reset\n";
+            continue;
+        }
+        if (back) {
+            out << "back\t" << record.answer << '\n';
+            continue;
+        }
+        const auto node = tree.GetNode(tree.FindNode(record.nodeID));
+        out << index << '\t' << record.nodeID;
+        out << '\t' << record.answer << '\t' << (rejected ? "rejected" : "accepted");
+        if (node) {
+            out << '\t' << node->Data();
+        }
+        out << '\n';
+    }
+    WriteReplayLine(answers, out);
+    return records.size();
+}
+
+}
@@ -0,0 +1,279 @@
+﻿#include "TraceRecorder.hpp"
+
+#include "ILogger.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <stdexcept>
+
+namespace ES
+{
+
+/**
+ * Получение уникального номера для новой записи трассы.
+ *
+ * \return Номер записи трассы
+ */
+static std::uint64_t NextRecorderID() noexcept
+{
+    static std::atomic<std::uint64_t> counter{0};
+    return ++counter;
+}
+
+/**
+ * Формирование пути к файлу трассы.
+ *
+ * \param directory Каталог трассы
+ * \param number Номер файла
+ * \return Путь к файлу
+ */
+static std::filesystem::path TraceFilePath(
+    const std::string& directory,
+    const std::uint64_t number)
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "trace-%08llu.bin",
+        static_cast<unsigned long long>(number));
+    return std::filesystem::path(directory) / name;
+}
+
+/**
+ * Создание записи трассы.
+ *
+ * \param options Параметры записи
+ * \return Запись трассы
+ */
+std::shared_ptr<ITraceRecorder> CreateTraceRecorder(
+    const TraceOptions& options) noexcept(false)
+{
+    return std::make_shared<TraceRecorder>(options);
+}
+
+/**
+ * Конструктор. Запускает фоновый поток сброса буферов.
+ *
+ * \param options Параметры записи
+ */
+TraceRecorder::TraceRecorder(
+    const TraceOptions& options) noexcept(false):
+    m_options(options),
+    m_id(NextRecorderID()),
+    m_pool(m_id, options.ringCapacity)
+{
+    m_options.ringCapacity = m_pool.Capacity();
+    // Создаём каталог и продолжаем нумерацию уже существующих файлов
+    std::filesystem::create_directories(m_options.directory);
+    for (const auto& entry : std::filesystem::directory_iterator(m_options.directory)) {
+        unsigned long long number = 0;
+        if (std::sscanf(entry.path().filename().string().c_str(), "trace-%llu.bin", &number) == 1
+            && number >= m_fileNumber) {
+            m_fileNumber = number + 1;
+        }
+    }
+    Rotate();
+    m_worker = std::thread(&TraceRecorder::Worker, this);
+}
+
+/**
+ * Деструктор. Сбрасывает оставшиеся записи и останавливает фоновый поток.
+ */
+TraceRecorder::~TraceRecorder()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_wakeLock);
+        m_stop = true;
+    }
+    m_wake.notify_one();
+    m_worker.join();
+}
+
+/**
+ * Принудительный сброс всех буферов в файл.
+ *
+ * \return
+ */
+void TraceRecorder::Flush()
+{
+    Drain();
+}
+
+/**
+ * Получение статистики записи.
+ *
+ * \return Статистика
+ */
+TraceStats TraceRecorder::GetStats() const
+{
+    TraceStats stats;
+    stats.written = m_written.load(std::memory_order_relaxed);
+    stats.stalls = m_stalls.load(std::memory_order_relaxed);
+    stats.files = m_files.load(std::memory_order_relaxed);
+    stats.dropped = m_dropped.load(std::memory_order_relaxed);
+    return stats;
+}
+
+/**
+ * Запрос сброса наполовину заполненного буфера
+ * и ожидание освобождения места в переполненном буфере.
+ * Записи трассы не теряются: если буфер переполнен,
+ * поток ждёт, пока фоновый поток не заберёт записи.
+ *
+ * \param ring Буфер потока
+ * \param head Позиция записи
+ * \return
+ */
+void TraceRecorder::ReserveSpace(
+    TraceRing& ring,
+    const std::uint64_t head) noexcept
+{
+    ring.cachedTail = ring.tail.load(std::memory_order_acquire);
+    if (head - ring.cachedTail <= ring.mask / 2) {
+        return;
+    }
+    // Будим фоновый поток один раз на каждый сброс
+    if (!m_drainRequested.exchange(true, std::memory_order_acq_rel)) {
+        m_wake.notify_one();
+    }
+    if (head - ring.cachedTail <= ring.mask) {
+        return;
+    }
+    m_stalls.fetch_add(1, std::memory_order_relaxed);
+    do {
+        std::this_thread::yield();
+        ring.cachedTail = ring.tail.load(std::memory_order_acquire);
+    } while (head - ring.cachedTail > ring.mask);
+}
+
+/**
+ * Перенос записей из всех буферов в файл.
+ * Записи буфера, которые не удалось записать, отбрасываются:
+ * иначе потоки сеансов ждали бы места в буфере, пока запись
+ * в файл не восстановится. Буферы завершившихся потоков
+ * после переноса записей становятся свободными.
+ *
+ * \return
+ */
+void TraceRecorder::Drain()
+{
+    std::lock_guard<std::mutex> drainLock(m_drainLock);
+    m_drainRequested.store(false, std::memory_order_release);
+    // Снимок списка буферов, чтобы не держать мьютекс во время записи в файл
+    m_pool.Snapshot(m_drainRings);
+    std::uint64_t written = 0;
+    for (auto ring : m_drainRings) {
+        const auto tail = ring->tail.load(std::memory_order_relaxed);
+        const auto head = ring->head.load(std::memory_order_acquire);
+        try {
+            // Записи между tail и head пишем прямо из буфера, не более двух кусков
+            for (auto position = tail; position != head;) {
+                const auto offset = position & ring->mask;
+                const auto count = std::min<std::uint64_t>(head - position, ring->records.size() - offset);
+                Write(ring->records.data() + offset, static_cast<std::size_t>(count));
+                position += count;
+            }
+        }
+        catch (...) {
+            ring->tail.store(head, std::memory_order_release);
+            m_dropped.fetch_add(head - tail, std::memory_order_relaxed);
+            m_written.fetch_add(written, std::memory_order_relaxed);
+            throw;
+        }
+        ring->tail.store(head, std::memory_order_release);
+        written += head - tail;
+    }
+    m_file.flush();
+    m_written.fetch_add(written, std::memory_order_relaxed);
+    m_pool.Recycle();
+}
+
+/**
+ * Запись в файл с переходом к новому файлу
+ * при достижении предельного размера.
+ *
+ * \param records Записи
+ * \param count Количество записей
+ * \return
+ */
+void TraceRecorder::Write(
+    const TraceRecord* records,
+    std::size_t count)
+{
+    while (count) {
+        if (m_fileBytes >= m_options.maxFileBytes) {
+            Rotate();
+        }
+        const std::size_t room = (m_options.maxFileBytes - m_fileBytes + sizeof(TraceRecord) - 1)
+            / sizeof(TraceRecord);
+        const std::size_t chunk = std::min(room, count);
+        m_file.write(reinterpret_cast<const char*>(records),
+            static_cast<std::streamsize>(chunk * sizeof(TraceRecord)));
+        if (!m_file) {
+            // Следующий сброс начнёт новый файл
+            m_fileBytes = m_options.maxFileBytes;
+            throw std::runtime_error(u8"Не удалось записать трассу в " + m_options.directory);
+        }
+        m_fileBytes += chunk * sizeof(TraceRecord);
+        records += chunk;
+        count -= chunk;
+    }
+}
+
+/**
+ * Открытие нового файла трассы и удаление старых файлов.
+ *
+ * \return
+ */
+void TraceRecorder::Rotate()
+{
+    if (m_file.is_open()) {
+        m_file.close();
+    }
+    const auto number = m_fileNumber++;
+    m_file.open(TraceFilePath(m_options.directory, number), std::ios::binary | std::ios::trunc);
+    if (!m_file) {
+        throw std::runtime_error(u8"Не удалось создать файл трассы в " + m_options.directory);
+    }
+    // Заголовок: сигнатура и размер записи
+    const std::uint32_t header[2] = { sizeof(TraceRecord), 0 };
+    m_file.write(kTraceMagic, sizeof(kTraceMagic));
+    m_file.write(reinterpret_cast<const char*>(header), sizeof(header));
+    m_fileBytes = sizeof(kTraceMagic) + sizeof(header);
+    m_files.fetch_add(1, std::memory_order_relaxed);
+    // Удаляем файлы сверх заданного количества
+    if (m_options.maxFiles && number >= m_options.maxFiles) {
+        std::error_code error;
+        std::filesystem::remove(TraceFilePath(m_options.directory, number - m_options.maxFiles), error);
+    }
+}
+
+/**
+ * Цикл фонового потока.
+ * Буферы сбрасываются периодически, а также по сигналу
+ * от потока с переполненным буфером. Ошибка записи в файл
+ * не останавливает поток: она выводится в лог, а следующий
+ * сброс начинает новый файл.
+ *
+ * \return
+ */
+void TraceRecorder::Worker()
+{
+    std::unique_lock<std::mutex> lock(m_wakeLock);
+    for (bool stop = false; !stop;) {
+        m_wake.wait_for(lock, std::chrono::milliseconds(m_options.flushIntervalMs), [this]
+        {
+            return m_stop || m_drainRequested.load(std::memory_order_acquire);
+        });
+        stop = m_stop;
+        lock.unlock();
+        try {
+            Drain();
+        }
+        catch (const std::exception& ex) {
+            logger->Log(LogLevel::Error, ex.what());
+        }
+        lock.lock();
+    }
+}
+
+}
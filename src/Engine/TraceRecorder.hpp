@@ -0,0 +1,190 @@
+﻿#pragma once
+
+#include "ITraceRecorder.hpp"
+#include "RecordRing.hpp"
+#include "Types.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ES
+{
+
+/**
+ * Двоичная запись трассы.
+ * Записи пишутся в файл как есть, поэтому размер фиксирован.
+ * Шаги сеанса упорядочиваются по номеру шага, а не по времени:
+ * системные часы могут идти назад, а шаги разных потоков -
+ * совпадать по времени.
+ */
+struct TraceRecord
+{
+    // Время шага в наносекундах от начала эпохи
+    std::uint64_t timestamp;
+    // Идентификатор сеанса
+    std::uint64_t session;
+    // Индекс узла, которому был подан ответ.
+    // Старший бит выставлен, если ответ не был принят.
+    // Значение kTraceReset означает сброс сеанса в начальное состояние,
+    // kTraceBack - возврат к вопросу на глубине answer
+    std::uint32_t node;
+    // Поданный ответ, либо глубина возврата
+    std::int32_t answer;
+    // Идентификатор узла, которому был подан ответ. Индекс узла
+    // после перезагрузки с изменениями не совпадает с индексом
+    // при загрузке с нуля, а идентификатор совпадает
+    node_id_t nodeID;
+    // Номер шага в сеансе, общий с журналом сеансов
+    std::uint32_t sequence;
+};
+static_assert(sizeof(TraceRecord) == 32, "TraceRecord must stay 32 bytes");
+
+// Признак непринятого ответа в поле node
+constexpr std::uint32_t kTraceRejected = 0x80000000u;
+// Значение поля node для сброса сеанса
+constexpr std::uint32_t kTraceReset = 0xFFFFFFFFu;
+// Значение поля node для возврата к предыдущему вопросу
+constexpr std::uint32_t kTraceBack = 0xFFFFFFFEu;
+
+// Сигнатура файла трассы
+constexpr char kTraceMagic[8] = { 'E', 'S', 'T', 'R', 'A', 'C', 'E', '2' };
+
+// Кольцевой буфер записей трассы одного потока
+using TraceRing = RecordRing<TraceRecord>;
+
+/**
+ * Реализация записи трассы.
+ */
+class TraceRecorder final:
+    public ITraceRecorder
+{
+public:
+    /**
+     * Конструктор. Запускает фоновый поток сброса буферов.
+     *
+     * \param options Параметры записи
+     */
+    explicit TraceRecorder(
+        const TraceOptions& options) noexcept(false);
+
+    /**
+     * Деструктор. Сбрасывает оставшиеся записи и останавливает фоновый поток.
+     */
+    ~TraceRecorder();
+
+    // Реализация интерфейса ITraceRecorder
+
+    void Flush() override;
+
+    TraceStats GetStats() const override;
+
+    /**
+     * Запись шага сеанса в буфер текущего потока.
+     * Не выделяет память после первого вызова в потоке.
+     * Если буфер для потока выделить не удалось, шаг не записывается.
+     *
+     * \param session Идентификатор сеанса
+     * \param sequence Номер шага в сеансе
+     * \param node Индекс узла либо kTraceReset
+     * \param nodeID Идентификатор узла, либо -1
+     * \param answer Ответ
+     * \return
+     */
+    void Record(
+        const std::uint64_t session,
+        const std::uint32_t sequence,
+        const std::uint32_t node,
+        const node_id_t nodeID,
+        const std::int32_t answer) noexcept
+    {
+        TraceRing* local = m_pool.Local();
+        if (!local) {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        TraceRing& ring = *local;
+        const auto head = ring.head.load(std::memory_order_relaxed);
+        // Буфер заполнен больше чем наполовину - просим фоновый поток
+        // забрать записи, не дожидаясь очередного периода сброса
+        if (head - ring.cachedTail > ring.mask / 2) {
+            ReserveSpace(ring, head);
+        }
+        auto& record = ring.records[head & ring.mask];
+        record.timestamp = static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count());
+        record.session = session;
+        record.node = node;
+        record.answer = answer;
+        record.nodeID = nodeID;
+        record.sequence = sequence;
+        ring.head.store(head + 1, std::memory_order_release);
+    }
+
+private:
+    /**
+     * Запрос сброса наполовину заполненного буфера
+     * и ожидание освобождения места в переполненном буфере.
+     */
+    void ReserveSpace(
+        TraceRing& ring,
+        const std::uint64_t head) noexcept;
+
+    /**
+     * Перенос записей из всех буферов в файл.
+     */
+    void Drain();
+
+    /**
+     * Запись в файл с переходом к новому файлу.
+     */
+    void Write(
+        const TraceRecord* records,
+        std::size_t count);
+
+    /**
+     * Открытие нового файла трассы и удаление старых файлов.
+     */
+    void Rotate();
+
+    /**
+     * Цикл фонового потока.
+     */
+    void Worker();
+
+    // Параметры
+    TraceOptions m_options;
+    // Уникальный номер записи трассы
+    const std::uint64_t m_id;
+    // Буферы потоков
+    RecordRingPool<TraceRecord> m_pool;
+    // Мьютекс сброса в файл
+    std::mutex m_drainLock;
+    // Текущий файл
+    std::ofstream m_file;
+    // Размер текущего файла
+    std::size_t m_fileBytes = 0;
+    // Номер следующего файла
+    std::uint64_t m_fileNumber = 0;
+    // Снимок списка буферов для сброса в файл
+    std::vector<TraceRing*> m_drainRings;
+    // Статистика
+    std::atomic<std::uint64_t> m_written{0};
+    std::atomic<std::uint64_t> m_stalls{0};
+    std::atomic<std::uint64_t> m_files{0};
+    std::atomic<std::uint64_t> m_dropped{0};
+    // Синхронизация фонового потока
+    std::atomic<bool> m_drainRequested{false};
+    std::mutex m_wakeLock;
+    std::condition_variable m_wake;
+    bool m_stop = false;
+    std::thread m_worker;
+};
+
+}
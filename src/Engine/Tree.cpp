@@ -1,10 +1,39 @@
 ﻿#include "Tree.hpp"
 
-#include "ILogger.hpp"
+#include "GraphValidator.hpp"
+
+#include <algorithm>
 
 namespace ES
 {
 
+/**
+ * Конструктор дерева с собственной областью памяти без лимита.
+ */
+Tree::Tree():
+    Tree(std::make_shared<MemoryArena>())
+{
+}
+
+/**
+ * Конструктор.
+ *
+ * \param arena Область памяти для узлов дерева
+ * \param texts Отдельная область для текстов узлов, либо nullptr
+ */
+Tree::Tree(
+    std::shared_ptr<MemoryArena> arena,
+    std::shared_ptr<MemoryArena> texts):
+    m_arenas{ arena },
+    m_arena(std::move(arena)),
+    m_textArena(std::move(texts)),
+    m_changedIndex(m_arena->Resource(MemoryCategory::Indices))
+{
+    if (m_textArena) {
+        m_arenas.push_back(m_textArena);
+    }
+}
+
 /**
  * Получение корня дерева.
  *
@@ -16,6 +45,414 @@ BasicNode* Tree::GetRoot() const noexcept
     return m_root;
 }
 
+/**
+ * Создание копии дерева.
+ * Узлы копируются в порядке индексов вместе с удалёнными,
+ * поэтому индексы в копии совпадают с исходными.
+ * Соединения хранят индексы узлов и копируются как есть.
+ * Копия получает собственную область памяти, в которую
+ * копируются узлы вместе с текстами и соединениями.
+ *
+ * \return Копия дерева
+ */
+std::unique_ptr<Tree> Tree::Clone() const
+{
+    auto clone = std::make_unique<Tree>();
+    auto& arena = *clone->m_arena;
+    clone->Reserve(m_nodesCount, 0, 0);
+    for (std::size_t index = 0; index < m_nodesCount; ++index) {
+        const auto node = GetNode(static_cast<node_index_t>(index));
+        if (!node) {
+            clone->AppendNode(nullptr);
+            ++clone->m_removedCount;
+            continue;
+        }
+        clone->InsertNode(node->ID());
+        const auto data = arena.CopyText(node->Data());
+        if (node->Type() == NodeType::Question) {
+            clone->AppendNode(arena.Create<Question>(MemoryCategory::Structure,
+                *static_cast<const Question*>(node), data, arena.Resource(MemoryCategory::Edges)));
+        }
+        else {
+            clone->AppendNode(arena.Create<Answer>(MemoryCategory::Structure,
+                node->ID(), data, node->Index()));
+        }
+    }
+    clone->BuildIndex();
+    clone->m_root = m_root ? clone->GetNode(m_root->Index()) : nullptr;
+    clone->m_texts = m_texts;
+    return clone;
+}
+
+/**
+ * Перенос текстов узлов в хранилище сжатых текстов.
+ * Словарь строится по выборке текстов, затем тексты по порядку
+ * индексов добавляются в хранилище и освобождаются в узлах.
+ * Отдельная область текстов после этого освобождается целиком.
+ *
+ * \param blockSize Размер блока несжатых текстов в байтах
+ * \param dictionarySize Размер общего словаря в байтах
+ * \return
+ */
+void Tree::CompressTexts(
+    const std::size_t blockSize,
+    const std::size_t dictionarySize)
+{
+    std::vector<std::string_view> texts;
+    texts.reserve(m_nodesCount);
+    for (std::size_t index = 0; index < m_nodesCount; ++index) {
+        if (const auto node = GetNode(static_cast<node_index_t>(index))) {
+            texts.push_back(node->Data());
+        }
+    }
+    auto store = std::make_shared<TextStore>(
+        TextStore::BuildDictionary(texts, dictionarySize), blockSize);
+    texts.clear();
+    texts.shrink_to_fit();
+    // Удалённым узлам соответствуют пустые тексты
+    for (std::size_t index = 0; index < m_nodesCount; ++index) {
+        const auto node = GetNode(static_cast<node_index_t>(index));
+        store->Add(node ? node->Data() : std::string_view());
+        if (node) {
+            node->ReleaseData();
+        }
+    }
+    store->Finish();
+    m_texts = std::move(store);
+    if (m_textArena) {
+        m_arenas.erase(std::find(m_arenas.begin(), m_arenas.end(), m_textArena));
+        m_textArena.reset();
+    }
+}
+
+/**
+ * Получение памяти, занятой областями дерева.
+ * Категории суммируются по всем областям, а остатки блоков
+ * считаются неиспользованной памятью. Память, освобождённая
+ * контейнерами внутри блоков, считается потерянной.
+ *
+ * \return Память по категориям
+ */
+MemoryReport Tree::Memory() const noexcept
+{
+    MemoryReport report;
+    for (const auto& arena : m_arenas) {
+        report.structure += arena->Used(MemoryCategory::Structure);
+        report.edges += arena->Used(MemoryCategory::Edges);
+        report.texts += arena->Used(MemoryCategory::Texts);
+        report.indices += arena->Used(MemoryCategory::Indices);
+        report.wasted += arena->Wasted();
+        report.total += arena->Reserved();
+    }
+    report.unused = report.total
+        - report.structure - report.edges - report.texts - report.indices - report.wasted;
+    return report;
+}
+
+/**
+ * Поиск узла по идентификатору.
+ * Сначала проверяются изменения индекса, затем общий индекс.
+ * Общий индекс не хранит идентификаторы и не знает об удалённых
+ * узлах, поэтому идентификатор найденного узла сверяется.
+ *
+ * \param id Идентификатор узла
+ * \return Индекс узла, либо kInvalidIndex, если узла нет
+ */
+node_index_t Tree::FindNode(
+    const node_id_t id) const noexcept
+{
+    auto index = kInvalidIndex;
+    if (!m_changedIndex.empty()) {
+        auto changed = m_changedIndex.find(id);
+        if (changed != m_changedIndex.end()) {
+            index = changed->second;
+        }
+    }
+    if (index == kInvalidIndex && m_nodesIndex) {
+        index = m_nodesIndex->Find(id);
+    }
+    const auto node = GetNode(index);
+    return node && node->ID() == id ? index : kInvalidIndex;
+}
+
+/**
+ * Построение индекса узлов по идентификаторам, добавленным
+ * после создания дерева. Повторяющиеся идентификаторы
+ * обнаруживаются при построении: остаётся узел, добавленный
+ * первым, остальные удаляются и попадают в ошибки загрузки.
+ *
+ * \return
+ */
+void Tree::BuildIndex() noexcept
+{
+    if (m_nodesIndex && m_pendingIndex.empty()) {
+        return;
+    }
+    std::vector<node_index_t> duplicates;
+    m_nodesIndex = m_arena->Create<NodeIdIndex>(MemoryCategory::Indices,
+        m_pendingIndex, m_arena->Resource(MemoryCategory::Indices), duplicates);
+    m_pendingIndex = {};
+    std::sort(duplicates.begin(), duplicates.end());
+    for (const auto index : duplicates) {
+        AddIssue(m_issues, ValidationIssue::DuplicateNode, GetNode(index)->ID());
+        RemoveNode(index);
+    }
+    // Корнем остаётся первый вопрос из оставшихся
+    for (std::size_t index = 0; !m_root && index < m_nodesCount; ++index) {
+        const auto node = GetNode(static_cast<node_index_t>(index));
+        if (node && node->Type() == NodeType::Question) {
+            m_root = node;
+        }
+    }
+}
+
+/**
+ * Завершение построения дерева.
+ *
+ * \return
+ */
+void Tree::Finish() noexcept
+{
+    BuildIndex();
+    for (const auto& [question, count] : CountConnections(m_pendingConnections)) {
+        question->ReserveConnections(count);
+    }
+    AddConnections(m_pendingConnections);
+}
+
+/**
+ * Подсчёт накопленных соединений каждого вопроса.
+ *
+ * \param connections Соединения
+ * \return Количество соединений по вопросам
+ */
+std::unordered_map<Question*, std::size_t> Tree::CountConnections(
+    const std::vector<PendingConnection>& connections)
+{
+    // Соединения одного вопроса в конфигурации обычно идут подряд,
+    // поэтому к таблице обращаемся один раз на серию
+    std::unordered_map<Question*, std::size_t> counts;
+    for (std::size_t i = 0; i < connections.size();) {
+        auto j = i + 1;
+        while (j < connections.size() && connections[j].src == connections[i].src) {
+            ++j;
+        }
+        counts[connections[i].src] += j - i;
+        i = j;
+    }
+    return counts;
+}
+
+/**
+ * Перенос накопленных соединений в вопросы.
+ * Соединения вопроса добавляются в порядке конфигурации,
+ * поэтому повторные соединения с тем же узлом по-прежнему
+ * заменяют предикат.
+ *
+ * \param connections Соединения, список очищается
+ * \return
+ */
+void Tree::AddConnections(
+    std::vector<PendingConnection>& connections) noexcept
+{
+    for (const auto& connection : connections) {
+        connection.src->AddConnection(connection.dst, connection.predicat);
+    }
+    connections.clear();
+    connections.shrink_to_fit();
+}
+
+/**
+ * Получение количества узлов дерева.
+ *
+ * \return Количество узлов, включая удалённые
+ */
+std::size_t Tree::NodesCount() const noexcept
+{
+    return m_nodesCount;
+}
+
+/**
+ * Получение узла по плотному индексу.
+ *
+ * \param index Индекс узла
+ * \return Узел, либо nullptr, если индекс вне диапазона или узел удалён
+ */
+BasicNode* Tree::GetNode(
+    const node_index_t index) const noexcept
+{
+    return index < m_nodesCount
+        ? (*m_chunks[index >> kChunkBits])[index & (kChunkSize - 1)]
+        : nullptr;
+}
+
+/**
+ * Резервирование места под узлы и соединения.
+ *
+ * \param questions Количество вопросов
+ * \param answers Количество ответов
+ * \param connections Количество соединений
+ * \return
+ */
+void Tree::Reserve(
+    const std::size_t questions,
+    const std::size_t answers,
+    const std::size_t connections) noexcept
+{
+    m_pendingConnections.reserve(m_pendingConnections.size() + connections);
+    const auto chunks = (m_nodesCount + questions + answers + kChunkSize - 1) / kChunkSize;
+    m_chunks.reserve(chunks);
+    m_ownedChunks.reserve(chunks);
+}
+
+/**
+ * Регистрация идентификатора следующего добавляемого узла.
+ * Сначала регистрируем идентификатор в индексе и только после этого
+ * создаём сам узел, чтобы не создавать узлы-дубликаты.
+ *
+ * \param id Идентификатор узла
+ * \return false, если узел с таким идентификатором уже существует
+ */
+bool Tree::InsertNode(
+    const node_id_t id) noexcept
+{
+    if (!m_nodesIndex) {
+        m_pendingIndex.emplace_back(id, NextIndex());
+        return true;
+    }
+    // Общий индекс не изменяем, запоминаем только изменения
+    if (FindNode(id) != kInvalidIndex) {
+        return false;
+    }
+    m_changedIndex[id] = NextIndex();
+    return true;
+}
+
+/**
+ * Добавление узла в конец хранилища.
+ *
+ * \param node Узел, либо nullptr для удалённого узла
+ * \return
+ */
+void Tree::AppendNode(
+    BasicNode* node) noexcept
+{
+    const auto chunk = m_nodesCount >> kChunkBits;
+    if (chunk == m_chunks.size()) {
+        // Последний блок заполнен, начинаем новый
+        m_chunks.push_back(NewChunk());
+        m_ownedChunks.push_back(true);
+    }
+    OwnChunk(chunk).push_back(node);
+    ++m_nodesCount;
+}
+
+/**
+ * Замена узла с заданным индексом.
+ *
+ * \param index Индекс узла
+ * \param node Новый узел, либо nullptr для удаления
+ * \return
+ */
+void Tree::SetNode(
+    const node_index_t index,
+    BasicNode* node) noexcept
+{
+    OwnChunk(index >> kChunkBits)[index & (kChunkSize - 1)] = node;
+}
+
+/**
+ * Удаление узла.
+ * Индекс узлов не изменяется: FindNode не находит удалённый узел,
+ * так как сверяет идентификатор с узлом по найденному индексу.
+ *
+ * \param index Индекс узла
+ * \return
+ */
+void Tree::RemoveNode(
+    const node_index_t index) noexcept
+{
+    const auto node = GetNode(index);
+    if (!node) {
+        return;
+    }
+    if (m_root == node) {
+        m_root = nullptr;
+    }
+    SetNode(index, nullptr);
+    ++m_removedCount;
+}
+
+/**
+ * Создание блока хранилища в области памяти дерева.
+ * Блоки разделяются между версиями дерева, поэтому
+ * принадлежат им через shared_ptr, но память и под блок,
+ * и под его счётчик ссылок выделяется из области.
+ *
+ * \return Пустой блок с местом под kChunkSize узлов
+ */
+std::shared_ptr<Tree::chunk_t> Tree::NewChunk() noexcept
+{
+    const auto resource = m_arena->Resource(MemoryCategory::Structure);
+    auto chunk = std::allocate_shared<chunk_t>(
+        std::pmr::polymorphic_allocator<chunk_t>(resource));
+    chunk->reserve(kChunkSize);
+    return chunk;
+}
+
+/**
+ * Получение блока хранилища для изменения.
+ * Копируются только указатели на узлы, сами узлы остаются общими.
+ *
+ * \param chunk Номер блока
+ * \return Блок, принадлежащий только текущему дереву
+ */
+Tree::chunk_t& Tree::OwnChunk(
+    const std::size_t chunk) noexcept
+{
+    if (!m_ownedChunks[chunk]) {
+        auto copy = NewChunk();
+        copy->assign(m_chunks[chunk]->begin(), m_chunks[chunk]->end());
+        m_chunks[chunk] = std::move(copy);
+        m_ownedChunks[chunk] = true;
+    }
+    return *m_chunks[chunk];
+}
+
+/**
+ * Превращение пустого дерева в новую версию заданного дерева.
+ * Копируются только указатели на блоки. Изменения индекса
+ * переносятся в новую версию, пока их немного, иначе
+ * общий индекс строится заново по оставшимся узлам.
+ * Новая версия удерживает области памяти исходного дерева.
+ *
+ * \param base Исходное дерево
+ * \return
+ */
+void Tree::DeriveFrom(
+    const Tree& base) noexcept
+{
+    m_arenas.insert(m_arenas.begin(), base.m_arenas.begin(), base.m_arenas.end());
+    m_chunks = base.m_chunks;
+    m_ownedChunks.assign(m_chunks.size(), false);
+    m_nodesCount = base.m_nodesCount;
+    m_removedCount = base.m_removedCount;
+    m_root = base.m_root;
+    if (!base.m_nodesIndex || base.m_changedIndex.size() * 8 > base.m_nodesIndex->Size()) {
+        m_pendingIndex.reserve(m_nodesCount - m_removedCount);
+        for (std::size_t index = 0; index < m_nodesCount; ++index) {
+            if (const auto node = GetNode(static_cast<node_index_t>(index))) {
+                m_pendingIndex.emplace_back(node->ID(), static_cast<node_index_t>(index));
+            }
+        }
+        BuildIndex();
+    }
+    else {
+        m_nodesIndex = base.m_nodesIndex;
+        m_changedIndex = base.m_changedIndex;
+    }
+}
+
 /**
  *  Добавление узла, имеющего тип "Вопрос".
  * 
@@ -23,28 +460,32 @@ BasicNode* Tree::GetRoot() const noexcept
  * \return 
  */
 void Tree::AddQuestion(
-    const NodeConfig& question) noexcept
-{
-    // Создаём новый узел типа "Вопрос"
-    // it - итератор, указывающий на созданный узел
-    // result - результат создания узла.
-    // Если узел уже существует, то создание нового не произойдёт.
-    auto [it, result] = m_nodesStorage.emplace(question.id, std::make_unique<Question>(question));
-    // Проверяем результат
-    if (!result) {
-        // Такой узел уже есть. Выведем предупреждение.
+    NodeConfig&& question) noexcept
+{
+    // После превышения лимита памяти узлы не добавляются
+    if (Exceeded()) {
+        return;
+    }
+    // Регистрируем идентификатор нового узла
+    // и проверяем результат
+    if (!InsertNode(question.id)) {
+        // Такой узел уже есть. Запомним ошибку.
         // В конфигурации системы оказались узлы, имеющие одинаковый идентификатор.
         // Система будет работать, но узлы с одинаковыми идентификаторами - это неправильно.
-        logger->Log(LogLevel::Warning, u8"Вопрос с идентификатором "
-            + std::to_string(question.id)
-            + u8" уже существует");
+        AddIssue(m_issues, ValidationIssue::DuplicateNode, question.id);
+        return;
     }
+    // Создаём новый узел типа "Вопрос" в области памяти дерева
+    auto created = m_arena->Create<Question>(MemoryCategory::Structure,
+        question.id, CopyText(question.data), NextIndex(),
+        m_arena->Resource(MemoryCategory::Edges));
+    AppendNode(created);
     // Будем считать, что первый вызов данного метода добавляет корневой узел
     // TODO: Возможно следует как-то помечать корневой узел в конфигурационном файле
     // Если корневой узел ещё не задан,
     if (!m_root) {
         // то сделаем вновь созданный узел корневым
-        m_root = it->second.get();
+        m_root = created;
     }
 }
 
@@ -55,22 +496,24 @@ void Tree::AddQuestion(
  * \return 
  */
 void Tree::AddAnswer(
-    const NodeConfig& answer) noexcept
-{
-    // Создаём новый узел типа "Ответ"
-    // it - итератор, указывающий на созданный узел
-    // result - результат создания узла.
-    // Если узел уже существует, то создание нового не произойдёт.
-    auto [_, result] = m_nodesStorage.emplace(answer.id, std::make_unique<Answer>(answer));
-    // Проверяем результат
-    if (!result) {
-        // Такой узел уже есть. Выведем предупреждение.
+    NodeConfig&& answer) noexcept
+{
+    // После превышения лимита памяти узлы не добавляются
+    if (Exceeded()) {
+        return;
+    }
+    // Регистрируем идентификатор нового узла
+    // и проверяем результат
+    if (!InsertNode(answer.id)) {
+        // Такой узел уже есть. Запомним ошибку.
         // В конфигурации системы оказались узлы, имеющие одинаковый идентификатор.
         // Система будет работать, но узлы с одинаковыми идентификаторами - это неправильно.
-        logger->Log(LogLevel::Warning, u8"Ответ с идентификатором "
-            + std::to_string(answer.id)
-            + u8" уже существует");
+        AddIssue(m_issues, ValidationIssue::DuplicateNode, answer.id);
+        return;
     }
+    // Создаём новый узел типа "Ответ" в области памяти дерева
+    AppendNode(m_arena->Create<Answer>(MemoryCategory::Structure,
+        answer.id, CopyText(answer.data), NextIndex()));
 }
 
 /**
@@ -83,48 +526,51 @@ void Tree::AddAnswer(
  * \return 
  */
 void Tree::AddConnection(
-    const ConnectionConfig& connection) noexcept
+    ConnectionConfig&& connection) noexcept
 {
+    // После превышения лимита памяти соединения не добавляются
+    if (Exceeded()) {
+        return;
+    }
+    // Все узлы добавлены, строим индекс узлов
+    if (!m_pendingIndex.empty()) {
+        BuildIndex();
+    }
     // Среди всех узлов ищем узел, соответствующий идентификатору источника.
     // Найденный узел будет родительским
-    auto src = m_nodesStorage.find(connection.src);
+    auto src = GetNode(FindNode(connection.src));
     // Проверяем результат поиска
-    if (src == m_nodesStorage.end()) {
+    if (!src) {
         // Узла с заданным идентификатором не нашлось.
         // Система сможет работать, но в конфигурации ошибка
-        logger->Log(LogLevel::Warning, u8"Узел с идентификатором "
-            + std::to_string(connection.src)
-            + u8" не найден");
+        AddIssue(m_issues, ValidationIssue::MissingNode, connection.src);
         // Игнорируем данное соединение, просто выходим из функции
         return;
     }
     // Если найденный узел является ответом,
     // то у него не может быть дочерних узлов,
     // тк ответы являются конечными элементами дерева.
-    if (src->second->Type() == NodeType::Answer) {
+    if (src->Type() == NodeType::Answer) {
         // Система сможет работать, но в конфигурации ошибка
-        logger->Log(LogLevel::Warning, u8"Неправильный тип узла");
+        AddIssue(m_issues, ValidationIssue::AnswerSource, connection.src);
         // Игнорируем данное соединение, просто выходим из функции
         return;
     }
     // Среди всех узлов ищем узел, соответствующий идентификатору приёмника.
     // Найденный узел будет дочерним по отношению к узлу
     // с идентификатором connection.src
-    auto dst = m_nodesStorage.find(connection.dst);
+    auto dst = FindNode(connection.dst);
     // Проверяем результат поиска
-    if (dst == m_nodesStorage.end()) {
+    if (dst == kInvalidIndex) {
         // Узла с заданным идентификатором не нашлось.
         // Система сможет работать, но в конфигурации ошибка
-        logger->Log(LogLevel::Warning, u8"Узел с идентификатором "
-            + std::to_string(connection.dst)
-            + u8" не найден");
+        AddIssue(m_issues, ValidationIssue::MissingNode, connection.dst);
         // Игнорируем данное соединение, просто выходим из функции
         return;
     }
-    // Кастуем BasicNode к Question
-    auto srcQuestion = dynamic_cast<Question*>(src->second.get());
-    // Добавляем соединение с дочерним узлом к соответствующему вопросу
-    srcQuestion->AddConnection(dst->second.get(), connection.predicat);
+    // Соединение переносится в вопрос в Finish, когда известно
+    // количество соединений каждого вопроса
+    m_pendingConnections.push_back({ static_cast<Question*>(src), dst, connection.predicat });
 }
 
 }
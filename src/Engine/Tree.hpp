@@ -1,11 +1,19 @@
 ﻿#pragma once
 
+#include "IExpertSystem.hpp"
+
 #include "Node.hpp"
 #include "ITree.hpp"
+#include "TextStore.hpp"
+#include "MemoryArena.hpp"
+#include "NodeIdIndex.hpp"
 
 #include <map>
 #include <string>
 #include <memory>
+#include <memory_resource>
+#include <unordered_map>
+#include <vector>
 #include <functional>
 
 namespace ES
@@ -13,32 +21,348 @@ namespace ES
 
 /**
  * Реализация дерева.
+ * Узлы, их тексты и соединения, блоки хранилища и индекс узлов
+ * размещаются в области памяти дерева. Новая версия дерева,
+ * разделяющая узлы с предыдущей, удерживает и её области.
+ * Индекс узлов по идентификаторам строится после добавления
+ * всех узлов, до первого соединения либо вызовом BuildIndex.
+ * Соединения копятся до вызова Finish, чтобы место под соединения
+ * каждого вопроса выделялось в области один раз.
  */
 class Tree final:
     public ITree
 {
+    // Построитель новой версии дерева по изменениям конфигурации
+    friend class TreeDiff;
 public:
+    /**
+     * Конструктор дерева с собственной областью памяти без лимита.
+     */
+    Tree();
+
+    /**
+     * Конструктор.
+     *
+     * \param arena Область памяти для узлов дерева
+     * \param texts Отдельная область для текстов узлов, освобождаемая
+     * после их сжатия в CompressTexts, либо nullptr, если тексты
+     * размещаются в основной области
+     */
+    explicit Tree(
+        std::shared_ptr<MemoryArena> arena,
+        std::shared_ptr<MemoryArena> texts = nullptr);
+
     virtual ~Tree() = default;
 
+    /**
+     * Создание копии дерева.
+     * Память под копию выделяется вызывающим потоком,
+     * индексы и идентификаторы узлов сохраняются.
+     *
+     * \return Копия дерева
+     */
+    std::unique_ptr<Tree> Clone() const;
+
+    /**
+     * Поиск узла по идентификатору.
+     *
+     * \param id Идентификатор узла
+     * \return Индекс узла, либо kInvalidIndex, если узла нет
+     * или индекс узлов ещё не построен
+     */
+    node_index_t FindNode(
+        const node_id_t id) const noexcept;
+
+    /**
+     * Построение индекса узлов по идентификаторам, добавленным
+     * после создания дерева. Узлы с повторяющимися идентификаторами,
+     * кроме первого, удаляются.
+     *
+     * \return
+     */
+    void BuildIndex() noexcept;
+
+    /**
+     * Завершение построения дерева после загрузки конфигурации:
+     * построение индекса узлов и перенос накопленных соединений
+     * в вопросы.
+     *
+     * \return
+     */
+    void Finish() noexcept;
+
+    /**
+     * Перенос текстов узлов в хранилище сжатых текстов.
+     * Тексты в самих узлах освобождаются, и дальше
+     * их следует получать через Texts(). Отдельная область
+     * текстов освобождается целиком.
+     *
+     * \param blockSize Размер блока несжатых текстов в байтах
+     * \param dictionarySize Размер общего словаря в байтах
+     * \return
+     */
+    void CompressTexts(
+        const std::size_t blockSize,
+        const std::size_t dictionarySize);
+
+    /**
+     * Получение хранилища сжатых текстов.
+     *
+     * \return Хранилище, либо nullptr, если тексты хранятся в узлах
+     */
+    const TextStore* Texts() const noexcept
+    {
+        return m_texts.get();
+    }
+
+    /**
+     * Получение ошибок конфигурации, найденных при добавлении
+     * узлов и соединений: повторяющихся узлов, соединений
+     * с несуществующими узлами и соединений из ответов.
+     *
+     * \return Отчёт с ошибками загрузки
+     */
+    const ValidationReport& Issues() const noexcept
+    {
+        return m_issues;
+    }
+
+    /**
+     * Получение количества удалённых узлов.
+     * Индексы удалённых узлов не переиспользуются,
+     * GetNode для них возвращает nullptr.
+     *
+     * \return Количество удалённых узлов
+     */
+    std::size_t RemovedCount() const noexcept
+    {
+        return m_removedCount;
+    }
+
+    /**
+     * Получение памяти, занятой областями дерева.
+     * Учитываются и области предыдущих версий, удерживаемые деревом.
+     * Сжатые тексты и индексы, построенные по дереву, не входят.
+     *
+     * \return Память по категориям
+     */
+    MemoryReport Memory() const noexcept;
+
+    /**
+     * Получение количества областей памяти, удерживаемых деревом.
+     *
+     * \return Количество областей
+     */
+    std::size_t ArenasCount() const noexcept
+    {
+        return m_arenas.size();
+    }
+
+    /**
+     * Проверка превышения лимита области памяти дерева.
+     * После превышения новые узлы и соединения не добавляются.
+     *
+     * \return true, если лимит превышен
+     */
+    bool Exceeded() const noexcept
+    {
+        return m_arena->Exceeded() || (m_textArena && m_textArena->Exceeded());
+    }
+
     // Реализация интерфейса ITree
 
     BasicNode* GetRoot() const noexcept override;
 
+    std::size_t NodesCount() const noexcept override;
+
+    BasicNode* GetNode(
+        const node_index_t index) const noexcept override;
+
+    // Реализация интерфейса ITreeBuilder
+
+    void Reserve(
+        const std::size_t questions,
+        const std::size_t answers,
+        const std::size_t connections) noexcept override;
+
     void AddQuestion(
-        const NodeConfig& question) noexcept override;
+        NodeConfig&& question) noexcept override;
 
     void AddAnswer(
-        const NodeConfig& answer) noexcept override;
+        NodeConfig&& answer) noexcept override;
 
     void AddConnection(
-        const ConnectionConfig& connection) noexcept override;
+        ConnectionConfig&& connection) noexcept override;
 private:
-    // Хранилище для узлов
+    // Количество узлов в одном блоке хранилища (степень двойки)
+    static constexpr std::size_t kChunkBits = 10;
+    static constexpr std::size_t kChunkSize = std::size_t(1) << kChunkBits;
+
+    // Блок хранилища узлов.
+    // Узлы принадлежат областям памяти и не освобождаются по отдельности
+    using chunk_t = std::pmr::vector<BasicNode*>;
+    // Изменения индекса узлов
     // Ключ - идентификатор узла
-    // Значение - умный указатель на узел
-    std::map<node_id_t, std::unique_ptr<BasicNode>> m_nodesStorage;
+    // Значение - индекс узла
+    using index_t = std::pmr::map<node_id_t, node_index_t>;
+
+    /**
+     * Соединение, ожидающее переноса в вопрос.
+     */
+    struct PendingConnection
+    {
+        // Вопрос-источник
+        Question* src;
+        // Индекс приёмника
+        node_index_t dst;
+        // Предикат соединения
+        node_predicat_t predicat;
+    };
+
+    /**
+     * Подсчёт накопленных соединений каждого вопроса.
+     *
+     * \param connections Соединения
+     * \return Количество соединений по вопросам
+     */
+    static std::unordered_map<Question*, std::size_t> CountConnections(
+        const std::vector<PendingConnection>& connections);
+
+    /**
+     * Перенос накопленных соединений в вопросы.
+     * Место под соединения должно быть уже зарезервировано.
+     *
+     * \param connections Соединения, список очищается
+     * \return
+     */
+    static void AddConnections(
+        std::vector<PendingConnection>& connections) noexcept;
+
+    /**
+     * Регистрация идентификатора следующего добавляемого узла.
+     * До построения индекса идентификатор только запоминается,
+     * а повторы обнаруживаются в BuildIndex.
+     *
+     * \param id Идентификатор узла
+     * \return false, если узел с таким идентификатором уже существует
+     */
+    bool InsertNode(
+        const node_id_t id) noexcept;
+
+    /**
+     * Добавление узла в конец хранилища.
+     *
+     * \param node Узел, либо nullptr для удалённого узла
+     * \return
+     */
+    void AppendNode(
+        BasicNode* node) noexcept;
+
+    /**
+     * Замена узла с заданным индексом.
+     *
+     * \param index Индекс узла
+     * \param node Новый узел, либо nullptr для удаления
+     * \return
+     */
+    void SetNode(
+        const node_index_t index,
+        BasicNode* node) noexcept;
+
+    /**
+     * Удаление узла.
+     * Индекс удалённого узла остаётся занятым.
+     *
+     * \param index Индекс узла
+     * \return
+     */
+    void RemoveNode(
+        const node_index_t index) noexcept;
+
+    /**
+     * Создание блока хранилища в области памяти дерева.
+     *
+     * \return Пустой блок с местом под kChunkSize узлов
+     */
+    std::shared_ptr<chunk_t> NewChunk() noexcept;
+
+    /**
+     * Получение блока хранилища для изменения.
+     * Блок, разделяемый с предыдущей версией дерева, копируется.
+     *
+     * \param chunk Номер блока
+     * \return Блок, принадлежащий только текущему дереву
+     */
+    chunk_t& OwnChunk(
+        const std::size_t chunk) noexcept;
+
+    /**
+     * Превращение пустого дерева в новую версию заданного дерева.
+     * Блоки хранилища и индекс узлов разделяются с исходным деревом
+     * и копируются только при изменении.
+     *
+     * \param base Исходное дерево
+     * \return
+     */
+    void DeriveFrom(
+        const Tree& base) noexcept;
+
+    /**
+     * Копирование текста узла в область памяти дерева.
+     *
+     * \param text Текст узла
+     * \return Копия текста
+     */
+    std::string_view CopyText(
+        const std::string_view text)
+    {
+        return (m_textArena ? *m_textArena : *m_arena).CopyText(text);
+    }
+
+    /**
+     * Получение индекса для следующего добавляемого узла.
+     *
+     * \return Плотный индекс узла
+     */
+    node_index_t NextIndex() const noexcept
+    {
+        return static_cast<node_index_t>(m_nodesCount);
+    }
+
+    // Области памяти, в которых размещены узлы дерева, включая
+    // области предыдущих версий. Объявлены первыми, чтобы
+    // освобождаться после всех объектов, размещённых в них
+    std::vector<std::shared_ptr<MemoryArena>> m_arenas;
+    // Область памяти для узлов, добавляемых в это дерево
+    std::shared_ptr<MemoryArena> m_arena;
+    // Отдельная область для текстов узлов до сжатия
+    std::shared_ptr<MemoryArena> m_textArena;
+    // Хранилище для узлов.
+    // Узлы хранятся в порядке добавления блоками по kChunkSize узлов.
+    // Блоки и сами узлы разделяются между версиями дерева
+    std::vector<std::shared_ptr<chunk_t>> m_chunks;
+    // Признаки блоков, которые можно изменять без копирования
+    std::vector<bool> m_ownedChunks;
+    // Количество узлов, включая удалённые
+    std::size_t m_nodesCount = 0;
+    // Количество удалённых узлов
+    std::size_t m_removedCount = 0;
+    // Индекс узлов по идентификаторам, либо nullptr, пока не построен.
+    // Разделяется между версиями дерева и принадлежит области памяти,
+    // в которой создан
+    const NodeIdIndex* m_nodesIndex = nullptr;
+    // Узлы, добавленные в новую версию после построения m_nodesIndex
+    index_t m_changedIndex;
+    // Идентификаторы и индексы узлов, добавленных до построения индекса
+    std::vector<NodeIdIndex::entry_t> m_pendingIndex;
+    // Соединения, ожидающие переноса в вопросы
+    std::vector<PendingConnection> m_pendingConnections;
     // Указатель на корень дерева
     BasicNode* m_root = nullptr;
+    // Сжатые тексты узлов. Разделяются между копиями дерева
+    std::shared_ptr<const TextStore> m_texts;
+    // Ошибки конфигурации, найденные при загрузке
+    ValidationReport m_issues;
 };
 
 }
@@ -0,0 +1,315 @@
+﻿#include "TreeDiff.hpp"
+
+#include "GraphValidator.hpp"
+
+namespace ES
+{
+
+/**
+ * Конструктор.
+ *
+ * \param base Дерево предыдущей версии
+ * \param arena Область памяти для изменившихся узлов
+ */
+TreeDiff::TreeDiff(
+    std::shared_ptr<const Tree> base,
+    std::shared_ptr<MemoryArena> arena):
+    m_base(std::move(base)),
+    m_tree(std::make_shared<Tree>(std::move(arena))),
+    m_seen(m_base->NodesCount(), false),
+    m_matched(m_base->NodesCount(), 0),
+    m_replaced(m_base->NodesCount(), nullptr)
+{
+}
+
+/**
+ * Построение новой версии дерева.
+ * Узлы, не встреченные в новой конфигурации, удаляются.
+ * Вопросы, у которых совпала только часть соединений, заменяются копиями.
+ * Затем новая версия получает блоки хранилища предыдущей версии
+ * и копирует только блоки с изменившимися узлами.
+ *
+ * \return Новая версия дерева
+ */
+std::shared_ptr<Tree> TreeDiff::Build() noexcept
+{
+    std::vector<node_index_t> removed;
+    for (std::size_t i = 0; i < m_seen.size(); ++i) {
+        const auto index = static_cast<node_index_t>(i);
+        const auto node = m_base->GetNode(index);
+        if (!node) {
+            continue;
+        }
+        if (!m_seen[i]) {
+            removed.push_back(index);
+            m_changes.push_back({ TreeChangeType::Remove, node->ID() });
+            continue;
+        }
+        // Вопрос потерял часть соединений
+        if (node->Type() == NodeType::Question
+            && m_matched[i] != static_cast<const Question*>(node)->GetChildrens().size()
+            && !m_replaced[i]) {
+            Relink(index);
+        }
+    }
+
+    // Место под соединения каждого вопроса выделяется один раз:
+    // под совпавшие соединения заменённого вопроса и под новые
+    auto counts = Tree::CountConnections(m_connections);
+    for (const auto index : m_relinked) {
+        counts[static_cast<Question*>(m_replaced[index])] += m_matched[index];
+    }
+    for (const auto& [question, count] : counts) {
+        question->ReserveConnections(count);
+    }
+    for (const auto index : m_relinked) {
+        const auto copy = static_cast<Question*>(m_replaced[index]);
+        const auto& childrens = static_cast<const Question*>(m_base->GetNode(index))->GetChildrens();
+        for (std::size_t i = 0; i < m_matched[index]; ++i) {
+            copy->AddConnection(childrens[i].first, childrens[i].second);
+        }
+    }
+    Tree::AddConnections(m_connections);
+
+    auto tree = std::move(m_tree);
+    tree->DeriveFrom(*m_base);
+    for (std::size_t i = 0; i < m_replaced.size(); ++i) {
+        if (m_replaced[i]) {
+            tree->SetNode(static_cast<node_index_t>(i), m_replaced[i]);
+        }
+    }
+    for (const auto index : removed) {
+        tree->RemoveNode(index);
+    }
+    tree->Reserve(m_added.size(), 0, 0);
+    for (const auto node : m_added) {
+        tree->InsertNode(node->ID());
+        tree->AppendNode(node);
+    }
+    tree->m_root = tree->GetNode(m_root);
+    m_replaced.clear();
+    m_replaced.shrink_to_fit();
+    m_added.clear();
+    return tree;
+}
+
+/**
+ * Получение количества изменений заданного типа.
+ *
+ * \param type Тип изменения
+ * \return Количество изменений
+ */
+std::size_t TreeDiff::ChangesCount(
+    const TreeChangeType type) const noexcept
+{
+    std::size_t count = 0;
+    for (const auto& change : m_changes) {
+        count += change.type == type;
+    }
+    return count;
+}
+
+/**
+ * Резервирование места под узлы и соединения.
+ * Количество изменений заранее неизвестно, поэтому ничего не резервируем.
+ *
+ * \param questions Количество вопросов
+ * \param answers Количество ответов
+ * \param connections Количество соединений
+ * \return
+ */
+void TreeDiff::Reserve(
+    const std::size_t questions,
+    const std::size_t answers,
+    const std::size_t connections) noexcept
+{
+    (void)questions;
+    (void)answers;
+    (void)connections;
+}
+
+/**
+ * Добавление узла, имеющего тип "Вопрос".
+ *
+ * \param question Конфигурация узла
+ * \return
+ */
+void TreeDiff::AddQuestion(
+    NodeConfig&& question) noexcept
+{
+    AddNode(NodeType::Question, std::move(question));
+}
+
+/**
+ * Добавление узла, имеющего тип "Ответ".
+ *
+ * \param answer Конфигурация узла
+ * \return
+ */
+void TreeDiff::AddAnswer(
+    NodeConfig&& answer) noexcept
+{
+    AddNode(NodeType::Answer, std::move(answer));
+}
+
+/**
+ * Добавление узла новой версии.
+ * Узел с тем же идентификатором, типом и текстом переиспользуется,
+ * изменившийся узел создаётся заново с прежним индексом,
+ * новый узел получает индекс в конце хранилища.
+ *
+ * \param type Тип узла
+ * \param config Конфигурация узла
+ * \return
+ */
+void TreeDiff::AddNode(
+    const NodeType type,
+    NodeConfig&& config) noexcept
+{
+    // После превышения лимита памяти узлы не добавляются
+    if (m_tree->Exceeded()) {
+        return;
+    }
+    const auto old = m_base->FindNode(config.id);
+    const bool duplicate = old != kInvalidIndex
+        ? static_cast<bool>(m_seen[old])
+        : m_addedIndex.find(config.id) != m_addedIndex.end();
+    if (duplicate) {
+        // Ведём себя так же, как Tree: второй узел с тем же идентификатором игнорируется
+        AddIssue(m_tree->m_issues, ValidationIssue::DuplicateNode, config.id);
+        return;
+    }
+    node_index_t index = old;
+    if (old != kInvalidIndex) {
+        m_seen[old] = true;
+        const auto node = m_base->GetNode(old);
+        if (node->Type() != type || node->Data() != config.data) {
+            m_changes.push_back({ TreeChangeType::Update, config.id });
+            m_replaced[old] = MakeNode(type, config, old);
+        }
+    }
+    else {
+        index = static_cast<node_index_t>(m_base->NodesCount() + m_added.size());
+        m_changes.push_back({ TreeChangeType::Add, config.id });
+        m_addedIndex.emplace(config.id, index);
+        m_added.push_back(MakeNode(type, config, index));
+    }
+    // Корнем, как и в Tree, становится первый вопрос
+    if (type == NodeType::Question && m_root == kInvalidIndex) {
+        m_root = index;
+    }
+}
+
+/**
+ * Поиск узла в новой версии дерева.
+ *
+ * \param id Идентификатор узла
+ * \return Узел, либо nullptr, если в новой версии его нет
+ */
+BasicNode* TreeDiff::Resolve(
+    const node_id_t id) const noexcept
+{
+    const auto old = m_base->FindNode(id);
+    if (old != kInvalidIndex) {
+        // Узел предыдущей версии, не встреченный в новой конфигурации, удалён
+        if (!m_seen[old]) {
+            return nullptr;
+        }
+        return m_replaced[old] ? m_replaced[old] : m_base->GetNode(old);
+    }
+    auto added = m_addedIndex.find(id);
+    return added != m_addedIndex.end()
+        ? m_added[added->second - m_base->NodesCount()]
+        : nullptr;
+}
+
+/**
+ * Добавление соединения между узлами.
+ * Соединения неизменившегося вопроса сверяются с его прежними
+ * соединениями по порядку. При первом расхождении вопрос
+ * заменяется копией, и дальше соединения добавляются в неё.
+ *
+ * \param connection Конфигурация соединения
+ * \return
+ */
+void TreeDiff::AddConnection(
+    ConnectionConfig&& connection) noexcept
+{
+    // После превышения лимита памяти соединения не добавляются
+    if (m_tree->Exceeded()) {
+        return;
+    }
+    auto src = Resolve(connection.src);
+    if (!src) {
+        AddIssue(m_tree->m_issues, ValidationIssue::MissingNode, connection.src);
+        return;
+    }
+    if (src->Type() == NodeType::Answer) {
+        AddIssue(m_tree->m_issues, ValidationIssue::AnswerSource, connection.src);
+        return;
+    }
+    const auto dst = Resolve(connection.dst);
+    if (!dst) {
+        AddIssue(m_tree->m_issues, ValidationIssue::MissingNode, connection.dst);
+        return;
+    }
+    const auto index = src->Index();
+    if (index < m_matched.size() && src == m_base->GetNode(index)) {
+        // Вопрос предыдущей версии: сверяем со следующим прежним соединением
+        const auto& childrens = static_cast<const Question*>(src)->GetChildrens();
+        auto& matched = m_matched[index];
+        if (matched < childrens.size()
+            && childrens[matched].first == dst->Index()
+            && childrens[matched].second.value == connection.predicat.value) {
+            ++matched;
+            return;
+        }
+        src = Relink(index);
+    }
+    m_connections.push_back({ static_cast<Question*>(src), dst->Index(), connection.predicat });
+}
+
+/**
+ * Замена неизменившегося вопроса копией с новыми соединениями.
+ * Текст узла разделяется с предыдущей версией, а совпавшие
+ * соединения копируются в Build, когда известно их общее количество.
+ *
+ * \param index Индекс вопроса
+ * \return Копия вопроса
+ */
+Question* TreeDiff::Relink(
+    const node_index_t index) noexcept
+{
+    const auto old = static_cast<const Question*>(m_base->GetNode(index));
+    auto& arena = *m_tree->m_arena;
+    auto copy = arena.Create<Question>(MemoryCategory::Structure,
+        old->ID(), old->Data(), index, arena.Resource(MemoryCategory::Edges));
+    m_relinked.push_back(index);
+    m_changes.push_back({ TreeChangeType::Relink, old->ID() });
+    m_replaced[index] = copy;
+    return copy;
+}
+
+/**
+ * Создание узла заданного типа в области памяти новой версии.
+ *
+ * \param type Тип узла
+ * \param config Конфигурация узла
+ * \param index Индекс узла
+ * \return Созданный узел
+ */
+BasicNode* TreeDiff::MakeNode(
+    const NodeType type,
+    const NodeConfig& config,
+    const node_index_t index) noexcept
+{
+    auto& arena = *m_tree->m_arena;
+    const auto data = m_tree->CopyText(config.data);
+    if (type == NodeType::Question) {
+        return arena.Create<Question>(MemoryCategory::Structure,
+            config.id, data, index, arena.Resource(MemoryCategory::Edges));
+    }
+    return arena.Create<Answer>(MemoryCategory::Structure, config.id, data, index);
+}
+
+}
@@ -0,0 +1,174 @@
+﻿#pragma once
+
+#include "Tree.hpp"
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace ES
+{
+
+// Тип изменения узла между версиями конфигурации
+enum class TreeChangeType
+{
+    Add,        // Узел добавлен
+    Remove,     // Узел удалён
+    Update,     // Изменился тип или текст узла
+    Relink      // Изменились соединения вопроса
+};
+
+// Изменение узла
+struct TreeChange
+{
+    // Тип изменения
+    TreeChangeType type;
+    // Идентификатор узла
+    node_id_t id;
+};
+
+/**
+ * Построитель новой версии дерева по новой конфигурации.
+ * Узлы и соединения новой конфигурации сравниваются с деревом
+ * предыдущей версии по мере загрузки. Неизменившиеся узлы
+ * не создаются заново: новая версия разделяет с предыдущей
+ * узлы, их тексты, соединения и блоки хранилища, а память
+ * выделяется только под изменившиеся узлы.
+ * Узлы сохраняют свои индексы, удалённые узлы оставляют
+ * пустые индексы, добавленные узлы получают индексы в конце.
+ * Изменившиеся узлы размещаются в новой области памяти,
+ * а новая версия удерживает и области предыдущей.
+ */
+class TreeDiff final:
+    public ITreeBuilder
+{
+public:
+    /**
+     * Конструктор.
+     *
+     * \param base Дерево предыдущей версии
+     * \param arena Область памяти для изменившихся узлов
+     */
+    explicit TreeDiff(
+        std::shared_ptr<const Tree> base,
+        std::shared_ptr<MemoryArena> arena = std::make_shared<MemoryArena>());
+
+    /**
+     * Построение новой версии дерева.
+     * Вызывается один раз после загрузки конфигурации.
+     *
+     * \return Новая версия дерева
+     */
+    std::shared_ptr<Tree> Build() noexcept;
+
+    /**
+     * Получение изменений относительно предыдущей версии.
+     * Полный список доступен после вызова Build.
+     *
+     * \return Изменения в порядке их обнаружения
+     */
+    const std::vector<TreeChange>& Changes() const noexcept
+    {
+        return m_changes;
+    }
+
+    /**
+     * Получение количества изменений заданного типа.
+     *
+     * \param type Тип изменения
+     * \return Количество изменений
+     */
+    std::size_t ChangesCount(
+        const TreeChangeType type) const noexcept;
+
+    // Реализация интерфейса ITreeBuilder
+
+    void Reserve(
+        const std::size_t questions,
+        const std::size_t answers,
+        const std::size_t connections) noexcept override;
+
+    void AddQuestion(
+        NodeConfig&& question) noexcept override;
+
+    void AddAnswer(
+        NodeConfig&& answer) noexcept override;
+
+    void AddConnection(
+        ConnectionConfig&& connection) noexcept override;
+private:
+    /**
+     * Добавление узла новой версии.
+     *
+     * \param type Тип узла
+     * \param config Конфигурация узла
+     * \return
+     */
+    void AddNode(
+        const NodeType type,
+        NodeConfig&& config) noexcept;
+
+    /**
+     * Поиск узла в новой версии дерева.
+     *
+     * \param id Идентификатор узла
+     * \return Узел, либо nullptr, если в новой версии его нет
+     */
+    BasicNode* Resolve(
+        const node_id_t id) const noexcept;
+
+    /**
+     * Замена неизменившегося вопроса копией с новыми соединениями.
+     * Совпавшие с новой конфигурацией соединения переносятся
+     * в копию в Build вместе с новыми.
+     *
+     * \param index Индекс вопроса
+     * \return Копия вопроса
+     */
+    Question* Relink(
+        const node_index_t index) noexcept;
+
+    /**
+     * Создание узла заданного типа в области памяти новой версии.
+     *
+     * \param type Тип узла
+     * \param config Конфигурация узла
+     * \param index Индекс узла
+     * \return Созданный узел
+     */
+    BasicNode* MakeNode(
+        const NodeType type,
+        const NodeConfig& config,
+        const node_index_t index) noexcept;
+
+    // Дерево предыдущей версии
+    std::shared_ptr<const Tree> m_base;
+    // Новая версия дерева. Получает узлы предыдущей версии в Build
+    std::shared_ptr<Tree> m_tree;
+    // Признаки узлов предыдущей версии, встреченных в новой конфигурации
+    std::vector<bool> m_seen;
+    // Количество соединений вопросов предыдущей версии,
+    // совпавших с соединениями новой конфигурации
+    std::vector<std::uint32_t> m_matched;
+    // Новые узлы с индексами изменившихся узлов предыдущей версии,
+    // по индексам узлов. nullptr - узел не изменился.
+    // Место выделяется один раз, а не на каждое изменение
+    std::vector<BasicNode*> m_replaced;
+    // Добавленные узлы в порядке добавления
+    std::vector<BasicNode*> m_added;
+    // Индекс добавленных узлов
+    // Ключ - идентификатор узла
+    // Значение - индекс узла в новой версии
+    std::map<node_id_t, node_index_t> m_addedIndex;
+    // Вопросы, заменённые копиями в Relink
+    std::vector<node_index_t> m_relinked;
+    // Соединения новых и заменённых вопросов, переносимые в них в Build
+    std::vector<Tree::PendingConnection> m_connections;
+    // Индекс корня новой версии
+    node_index_t m_root = kInvalidIndex;
+    // Изменения относительно предыдущей версии
+    std::vector<TreeChange> m_changes;
+};
+
+}
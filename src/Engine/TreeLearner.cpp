@@ -0,0 +1,558 @@
+﻿#include "TreeLearner.hpp"
+#include "Dataset.hpp"
+#include "ILogger.hpp"
+#include "XmlExpertSystemLoader.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+namespace ES
+{
+
+// Признак листа вместо номера признака узла
+static constexpr std::uint32_t kLeaf = UINT32_MAX;
+// Наименьшее произведение строк узла на количество признаков,
+// при котором признаки оцениваются параллельно
+static constexpr std::size_t kParallelCells = 64 * 1024;
+// Наименьший прирост информации, ради которого задаётся вопрос
+static constexpr double kMinGain = 1e-9;
+
+/**
+ * Узел строящегося дерева.
+ */
+struct LearnedNode
+{
+    // Признак вопроса или kLeaf
+    std::uint32_t feature = kLeaf;
+    // Самый частый ответ строк узла
+    std::uint16_t label = 0;
+    // Количество строк узла с самым частым ответом
+    std::uint32_t correct = 0;
+    // Дочерние узлы по кодам значений признака
+    std::vector<std::pair<std::uint8_t, std::uint32_t>> children;
+};
+
+/**
+ * Оценка разбиения узла по признаку.
+ */
+struct SplitScore
+{
+    // Прирост информации
+    double gain = 0;
+    // Отношение прироста к информации разбиения (C4.5)
+    double ratio = 0;
+    // Разбиение допустимо
+    bool valid = false;
+};
+
+/**
+ * Пул потоков, выполняющий пронумерованные задачи.
+ * Вызывающий поток тоже выполняет задачи, поэтому при одном
+ * потоке пул не создаёт дополнительных потоков.
+ */
+class SplitPool final
+{
+public:
+    using Task = std::function<void(std::size_t worker, std::size_t index)>;
+
+    explicit SplitPool(
+        const std::size_t threads)
+    {
+        for (std::size_t worker = 1; worker < threads; ++worker) {
+            m_threads.emplace_back([this, worker] { Work(worker); });
+        }
+    }
+
+    ~SplitPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_start.notify_all();
+        for (auto& thread : m_threads) {
+            thread.join();
+        }
+    }
+
+    /**
+     * Получение количества потоков, включая вызывающий.
+     *
+     * \return Количество потоков
+     */
+    std::size_t Size() const noexcept
+    {
+        return m_threads.size() + 1;
+    }
+
+    /**
+     * Выполнение задач с номерами [0, count) всеми потоками пула.
+     * Возвращает управление после завершения всех задач.
+     *
+     * \param count Количество задач
+     * \param task Задача
+     * \return
+     */
+    void Run(
+        const std::size_t count,
+        const Task& task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_task = &task;
+            m_count = count;
+            m_next = 0;
+            m_running = m_threads.size();
+            ++m_generation;
+        }
+        m_start.notify_all();
+        Drain(0);
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_done.wait(lock, [this] { return m_running == 0; });
+    }
+
+private:
+    void Work(
+        const std::size_t worker)
+    {
+        std::size_t generation = 0;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_start.wait(lock, [&] { return m_stop || m_generation != generation; });
+                if (m_stop) {
+                    return;
+                }
+                generation = m_generation;
+            }
+            Drain(worker);
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (--m_running == 0) {
+                m_done.notify_one();
+            }
+        }
+    }
+
+    void Drain(
+        const std::size_t worker)
+    {
+        for (auto index = m_next++; index < m_count; index = m_next++) {
+            (*m_task)(worker, index);
+        }
+    }
+
+    std::vector<std::thread> m_threads;
+    std::mutex m_mutex;
+    std::condition_variable m_start;
+    std::condition_variable m_done;
+    const Task* m_task = nullptr;
+    std::size_t m_count = 0;
+    std::atomic<std::size_t> m_next{ 0 };
+    std::size_t m_running = 0;
+    std::size_t m_generation = 0;
+    bool m_stop = false;
+};
+
+/**
+ * Вычисление x * log2(x) для количества строк.
+ *
+ * \param x Количество
+ * \return x * log2(x)
+ */
+static double XLogX(
+    const std::uint32_t x)
+{
+    return x ? x * std::log2(static_cast<double>(x)) : 0.0;
+}
+
+/**
+ * Построение дерева по набору данных.
+ * Узлы обрабатываются в глубину с явным стеком. Строки узла занимают
+ * отрезок общего массива номеров строк, который при разбиении
+ * раскладывается по значениям признака сортировкой подсчётом.
+ */
+class TreeInduction final
+{
+public:
+    TreeInduction(
+        const Dataset& dataset,
+        const LearnerOptions& options,
+        SplitPool& pool)
+        : m_dataset(dataset)
+        , m_options(options)
+        , m_pool(pool)
+        , m_labelsCount(std::max<std::size_t>(dataset.labelNames.size(), 1))
+        , m_scores(dataset.features.size())
+    {
+        std::size_t valuesCount = 1;
+        for (const auto& feature : dataset.features) {
+            valuesCount = std::max(valuesCount, feature.valuesCount);
+        }
+        // Гистограммы потоков всегда обнулены между оценками
+        m_histograms.resize(pool.Size());
+        for (auto& histogram : m_histograms) {
+            histogram.assign(valuesCount * m_labelsCount, 0);
+        }
+        m_valueCounts.resize(pool.Size());
+        for (auto& counts : m_valueCounts) {
+            counts.assign(256, 0);
+        }
+        m_labelCounts.assign(m_labelsCount, 0);
+    }
+
+    /**
+     * Построение дерева.
+     *
+     * \return Узлы дерева. Корень - первый узел
+     */
+    std::vector<LearnedNode> Build()
+    {
+        const auto rowsCount = static_cast<std::uint32_t>(m_dataset.RowsCount());
+        m_rows.resize(rowsCount);
+        m_buffer.resize(rowsCount);
+        for (std::uint32_t row = 0; row < rowsCount; ++row) {
+            m_rows[row] = row;
+        }
+
+        struct Range
+        {
+            std::uint32_t node;
+            std::uint32_t begin;
+            std::uint32_t end;
+            std::uint32_t depth;
+        };
+        std::vector<LearnedNode> nodes(1);
+        std::vector<Range> stack{ { 0, 0, rowsCount, 0 } };
+        while (!stack.empty()) {
+            const auto range = stack.back();
+            stack.pop_back();
+            const auto begin = m_rows.data() + range.begin;
+            const auto count = range.end - range.begin;
+
+            // Ответы строк узла
+            double labelsTerm = 0;
+            std::uint32_t correct = 0;
+            std::uint16_t label = 0;
+            for (auto row = begin; row != begin + count; ++row) {
+                ++m_labelCounts[m_dataset.labels[*row]];
+            }
+            for (auto row = begin; row != begin + count; ++row) {
+                const auto code = m_dataset.labels[*row];
+                auto& labelCount = m_labelCounts[code];
+                if (labelCount) {
+                    labelsTerm += XLogX(labelCount);
+                    if (labelCount > correct || (labelCount == correct && code < label)) {
+                        correct = labelCount;
+                        label = code;
+                    }
+                    labelCount = 0;
+                }
+            }
+            nodes[range.node].label = label;
+            nodes[range.node].correct = correct;
+            if (correct == count || range.depth >= m_options.maxDepth
+                || count < 2 * std::max<std::size_t>(m_options.minRows, 1)) {
+                continue;
+            }
+
+            // Оценка всех признаков: параллельно для больших узлов
+            const auto featuresCount = m_dataset.features.size();
+            const SplitPool::Task evaluate = [&](std::size_t worker, std::size_t feature) {
+                m_scores[feature] = Evaluate(worker, feature, begin, count, labelsTerm);
+            };
+            if (m_pool.Size() > 1 && std::size_t(count) * featuresCount >= kParallelCells) {
+                m_pool.Run(featuresCount, evaluate);
+            }
+            else {
+                for (std::size_t feature = 0; feature < featuresCount; ++feature) {
+                    evaluate(0, feature);
+                }
+            }
+            const auto best = ChooseSplit();
+            if (best == kLeaf) {
+                continue;
+            }
+
+            // Раскладка строк по значениям признака
+            const auto& codes = m_dataset.features[best].codes;
+            std::uint32_t offsets[257] = {};
+            for (auto row = begin; row != begin + count; ++row) {
+                ++offsets[codes[*row] + 1];
+            }
+            for (std::size_t value = 0; value < 256; ++value) {
+                offsets[value + 1] += offsets[value];
+            }
+            std::uint32_t positions[256];
+            std::copy(offsets, offsets + 256, positions);
+            const auto buffer = m_buffer.data() + range.begin;
+            for (auto row = begin; row != begin + count; ++row) {
+                buffer[positions[codes[*row]]++] = *row;
+            }
+            std::copy(buffer, buffer + count, begin);
+
+            nodes[range.node].feature = best;
+            const auto first = stack.size();
+            for (std::size_t value = 0; value < 256; ++value) {
+                if (offsets[value] == offsets[value + 1]) {
+                    continue;
+                }
+                const auto child = static_cast<std::uint32_t>(nodes.size());
+                nodes.emplace_back();
+                nodes[range.node].children.emplace_back(static_cast<std::uint8_t>(value), child);
+                stack.push_back({ child, range.begin + offsets[value],
+                    range.begin + offsets[value + 1], range.depth + 1 });
+            }
+            // Дочерние узлы обрабатываются в порядке значений
+            std::reverse(stack.begin() + first, stack.end());
+        }
+        return nodes;
+    }
+
+private:
+    /**
+     * Оценка разбиения строк узла по признаку.
+     * Прирост информации вычисляется по гистограмме (значение, ответ):
+     * n*gain = n*H(ответ) - (сумма nv*log nv - сумма c*log c).
+     * Гистограмма обнуляется по затронутым ячейкам, поэтому стоимость
+     * оценки маленьких узлов не зависит от количества ответов.
+     *
+     * \param worker Номер потока
+     * \param feature Номер признака
+     * \param rows Строки узла
+     * \param count Количество строк узла
+     * \param labelsTerm Сумма c*log c по ответам узла
+     * \return Оценка разбиения
+     */
+    SplitScore Evaluate(
+        const std::size_t worker,
+        const std::size_t feature,
+        const std::uint32_t* rows,
+        const std::uint32_t count,
+        const double labelsTerm)
+    {
+        const auto& codes = m_dataset.features[feature].codes;
+        const auto& labels = m_dataset.labels;
+        const auto valuesCount = m_dataset.features[feature].valuesCount;
+        auto& histogram = m_histograms[worker];
+        auto& valueCounts = m_valueCounts[worker];
+        for (auto row = rows; row != rows + count; ++row) {
+            const auto code = codes[*row];
+            ++histogram[code * m_labelsCount + labels[*row]];
+            ++valueCounts[code];
+        }
+
+        double cellsTerm = 0;
+        if (valuesCount * m_labelsCount <= count) {
+            for (std::size_t cell = 0; cell < valuesCount * m_labelsCount; ++cell) {
+                cellsTerm += XLogX(histogram[cell]);
+                histogram[cell] = 0;
+            }
+        }
+        else {
+            for (auto row = rows; row != rows + count; ++row) {
+                auto& cell = histogram[codes[*row] * m_labelsCount + labels[*row]];
+                cellsTerm += XLogX(cell);
+                cell = 0;
+            }
+        }
+
+        double valuesTerm = 0;
+        std::size_t branches = 0;
+        std::size_t largeBranches = 0;
+        for (std::size_t value = 0; value < valuesCount; ++value) {
+            if (valueCounts[value]) {
+                valuesTerm += XLogX(valueCounts[value]);
+                ++branches;
+                largeBranches += valueCounts[value] >= m_options.minRows;
+                valueCounts[value] = 0;
+            }
+        }
+
+        SplitScore score;
+        const double total = XLogX(count);
+        score.gain = (total - labelsTerm - valuesTerm + cellsTerm) / count;
+        const double splitInfo = (total - valuesTerm) / count;
+        score.valid = branches > 1 && largeBranches > 1 && score.gain > kMinGain;
+        score.ratio = score.valid ? score.gain / splitInfo : 0;
+        return score;
+    }
+
+    /**
+     * Выбор признака разбиения по правилу C4.5: наибольшее отношение
+     * прироста среди признаков с приростом не ниже среднего.
+     *
+     * \return Номер признака или kLeaf, если разбиение не нужно
+     */
+    std::uint32_t ChooseSplit() const
+    {
+        double sum = 0;
+        std::size_t validCount = 0;
+        for (const auto& score : m_scores) {
+            if (score.valid) {
+                sum += score.gain;
+                ++validCount;
+            }
+        }
+        if (!validCount) {
+            return kLeaf;
+        }
+        const double average = sum / validCount - kMinGain;
+        std::uint32_t best = kLeaf;
+        for (std::size_t feature = 0; feature < m_scores.size(); ++feature) {
+            const auto& score = m_scores[feature];
+            if (score.valid && score.gain >= average
+                && (best == kLeaf || score.ratio > m_scores[best].ratio)) {
+                best = static_cast<std::uint32_t>(feature);
+            }
+        }
+        return best;
+    }
+
+    const Dataset& m_dataset;
+    const LearnerOptions& m_options;
+    SplitPool& m_pool;
+    const std::size_t m_labelsCount;
+    // Номера строк, упорядоченные по узлам, и буфер раскладки
+    std::vector<std::uint32_t> m_rows;
+    std::vector<std::uint32_t> m_buffer;
+    // Оценки признаков текущего узла
+    std::vector<SplitScore> m_scores;
+    // Гистограммы и счётчики значений по потокам
+    std::vector<std::vector<std::uint32_t>> m_histograms;
+    std::vector<std::vector<std::uint32_t>> m_valueCounts;
+    std::vector<std::uint32_t> m_labelCounts;
+};
+
+/**
+ * Замена вопросов, все ветви которых приводят к одному ответу, этим ответом.
+ *
+ * \param nodes Узлы дерева
+ * \param node Индекс узла
+ * \return
+ */
+static void Collapse(
+    std::vector<LearnedNode>& nodes,
+    const std::uint32_t node)
+{
+    if (nodes[node].feature == kLeaf) {
+        return;
+    }
+    bool same = true;
+    for (const auto& [value, child] : nodes[node].children) {
+        Collapse(nodes, child);
+        same = same && nodes[child].feature == kLeaf
+            && nodes[child].label == nodes[nodes[node].children.front().second].label;
+    }
+    if (same) {
+        auto& collapsed = nodes[node];
+        collapsed.label = nodes[collapsed.children.front().second].label;
+        collapsed.feature = kLeaf;
+        collapsed.children.clear();
+    }
+}
+
+/**
+ * Построение дерева вопросов по размеченным данным (ID3/C4.5).
+ *
+ * \param dataPath Путь к CSV-файлу
+ * \param configPath Путь к создаваемому файлу конфигурации
+ * \param options Параметры построения
+ * \return Результат построения
+ */
+LearnerStats LearnTree(
+    const std::string& dataPath,
+    const std::string& configPath,
+    const LearnerOptions& options) noexcept(false)
+{
+    const auto dataset = ReadDataset(dataPath, options.labelColumn,
+        options.bins, options.maxCategories);
+    if (!dataset.RowsCount()) {
+        throw std::runtime_error(u8"Набор данных пуст: " + dataPath);
+    }
+    logger->Log(LogLevel::Info, u8"Данные прочитаны: "
+        + std::to_string(dataset.RowsCount()) + u8" строк, "
+        + std::to_string(dataset.features.size()) + u8" признаков, "
+        + std::to_string(dataset.labelNames.size()) + u8" ответов");
+
+    LearnerStats stats;
+    stats.rows = dataset.RowsCount();
+    stats.features = dataset.features.size();
+    SplitPool pool(options.threads ? options.threads
+        : std::max(1u, std::thread::hardware_concurrency()));
+    auto nodes = TreeInduction(dataset, options, pool).Build();
+    Collapse(nodes, 0);
+
+    // Нумерация достижимых узлов: вопросы в порядке обхода в глубину,
+    // затем по одному ответу на каждый встретившийся диагноз
+    std::vector<std::uint32_t> questions;
+    std::vector<std::int64_t> answerIDs(dataset.labelNames.size(), 0);
+    std::vector<std::uint16_t> answers;
+    std::vector<std::pair<std::uint32_t, std::size_t>> stack{ { 0, 0 } };
+    std::uint64_t correct = 0;
+    while (!stack.empty()) {
+        const auto [node, depth] = stack.back();
+        stack.pop_back();
+        stats.depth = std::max(stats.depth, depth);
+        if (nodes[node].feature == kLeaf) {
+            correct += nodes[node].correct;
+            if (!answerIDs[nodes[node].label]) {
+                answerIDs[nodes[node].label] = -1;
+                answers.push_back(nodes[node].label);
+            }
+            continue;
+        }
+        questions.push_back(node);
+        for (auto it = nodes[node].children.rbegin(); it != nodes[node].children.rend(); ++it) {
+            stack.emplace_back(it->second, depth + 1);
+        }
+    }
+    std::vector<std::int64_t> questionIDs(nodes.size(), 0);
+    for (std::size_t i = 0; i < questions.size(); ++i) {
+        questionIDs[questions[i]] = static_cast<std::int64_t>(i + 1);
+    }
+    for (std::size_t i = 0; i < answers.size(); ++i) {
+        answerIDs[answers[i]] = static_cast<std::int64_t>(questions.size() + i + 1);
+    }
+    const auto nodeID = [&](const std::uint32_t node) {
+        return nodes[node].feature == kLeaf ? answerIDs[nodes[node].label] : questionIDs[node];
+    };
+    stats.questions = questions.size();
+    stats.answers = answers.size();
+    stats.accuracy = static_cast<double>(correct) / stats.rows;
+
+    const auto name = options.name.empty()
+        ? std::filesystem::path(dataPath).stem().string() : options.name;
+    XmlConfigWriter writer(configPath, name);
+    for (const auto node : questions) {
+        const auto& feature = dataset.features[nodes[node].feature];
+        std::string text = feature.name + "?";
+        for (const auto& [value, child] : nodes[node].children) {
+            text += (&value == &nodes[node].children.front().first ? " " : "; ")
+                + std::to_string(value) + " - " + feature.DescribeValue(value);
+        }
+        writer.AddNode("question", questionIDs[node], text);
+    }
+    for (const auto label : answers) {
+        writer.AddNode("answer", answerIDs[label], dataset.labelNames[label]);
+    }
+    for (const auto node : questions) {
+        for (const auto& [value, child] : nodes[node].children) {
+            writer.AddConnection(questionIDs[node], nodeID(child), value);
+        }
+    }
+    writer.Finish();
+    logger->Log(LogLevel::Info, u8"Дерево построено: "
+        + std::to_string(stats.questions) + u8" вопросов, "
+        + std::to_string(stats.answers) + u8" ответов, глубина "
+        + std::to_string(stats.depth));
+    return stats;
+}
+
+}
@@ -0,0 +1,1100 @@
+﻿#include "TreeOptimizer.hpp"
+#include "GraphValidator.hpp"
+#include "ILogger.hpp"
+#include "ITraceRecorder.hpp"
+#include "Tree.hpp"
+#include "XmlExpertSystemLoader.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+
+#if defined(_MSC_VER)
+#   include <intrin.h>
+#endif
+
+namespace ES
+{
+
+// Узел перестроенного дерева без вопроса - ответ
+static constexpr std::uint32_t kLeaf = UINT32_MAX;
+// Наибольшее количество правил точного перебора: по биту маски на правило
+static constexpr std::size_t kMaxExactLimit = 24;
+// Относительная разница приростов информации, при которой вопросы равноценны
+static constexpr double kGainTolerance = 1e-12;
+// Наименьшая доля правил узла, отвечающих на вопрос, при которой
+// остальные правила копируются во все его ветви
+static constexpr double kMinCoverage = 0.5;
+
+/**
+ * Ответ правила на вопрос.
+ */
+struct Condition
+{
+    // Номер вопроса
+    std::uint32_t question = 0;
+    // Значение ответа
+    int value = 0;
+};
+
+/**
+ * Способ выбора вопроса в узле.
+ */
+enum class SplitStrategy
+{
+    Copying,    // Наибольший прирост информации, правила копируются в ветви
+    Covering,   // Наибольший прирост информации среди вопросов, на которые
+                // отвечают все правила узла, небольшие поддеревья - перебором
+    Original    // Порядок вопросов исходного дерева
+};
+
+/**
+ * Правило - путь исходного дерева от корня до ответа.
+ */
+struct PathRule
+{
+    // Ответы на вопросы пути - отрезок [begin, end) общего массива,
+    // упорядоченный по номерам вопросов. Тот же отрезок массива
+    // вопросов в порядке пути
+    std::size_t begin = 0;
+    std::size_t end = 0;
+    // Количество вопросов пути в исходном дереве
+    std::size_t depth = 0;
+    // Индекс ответа в исходном дереве
+    node_index_t answer = kInvalidIndex;
+    // Вес правила. Сумма весов всех правил равна 1
+    double weight = 0;
+};
+
+/**
+ * Правило в ветви перестраиваемого дерева.
+ */
+struct RuleItem
+{
+    // Номер правила
+    std::uint32_t rule = 0;
+    // Доля веса правила, доставшаяся ветви
+    double weight = 0;
+};
+
+/**
+ * Узел перестроенного дерева.
+ */
+struct OptimizedNode
+{
+    // Номер вопроса, либо kLeaf для ответа
+    std::uint32_t question = kLeaf;
+    // Индекс ответа в исходном дереве
+    node_index_t answer = kInvalidIndex;
+    // Вес правил, проходящих через узел
+    double weight = 0;
+    // Значения ответа и дочерние узлы
+    std::vector<std::pair<int, std::uint32_t>> children;
+};
+
+/**
+ * x * ln(x) с нулём в нуле.
+ */
+static double XLogX(
+    const double x)
+{
+    return x > 0 ? x * std::log(x) : 0.0;
+}
+
+/**
+ * Сложение весов с одинаковыми ключами.
+ * Записи упорядочиваются по ключу, повторяющиеся ключи объединяются.
+ *
+ * \param entries Ключи и веса
+ */
+template <typename Key>
+static void CombineWeights(
+    std::vector<std::pair<Key, double>>& entries)
+{
+    std::sort(entries.begin(), entries.end(),
+        [](const std::pair<Key, double>& a, const std::pair<Key, double>& b) { return a.first < b.first; });
+    std::size_t size = 0;
+    for (const auto& entry : entries) {
+        if (size > 0 && entries[size - 1].first == entry.first) {
+            entries[size - 1].second += entry.second;
+        }
+        else {
+            entries[size++] = entry;
+        }
+    }
+    entries.resize(size);
+}
+
+/**
+ * Номер младшего единичного бита.
+ *
+ * \param mask Маска, не равная нулю
+ * \return Номер бита
+ */
+static std::uint32_t LowestBit(
+    const std::uint32_t mask)
+{
+#if defined(_MSC_VER)
+    unsigned long result;
+    _BitScanForward(&result, mask);
+    return result;
+#else
+    return static_cast<std::uint32_t>(__builtin_ctz(mask));
+#endif
+}
+
+/**
+ * Построение дерева по правилам сверху вниз.
+ */
+class TreeRestructuring final
+{
+public:
+
+    /**
+     * Конструктор.
+     *
+     * \param conditions Ответы правил на вопросы
+     * \param sequence Вопросы правил в порядке пути
+     * \param rules Правила
+     * \param domains Значения ответов каждого вопроса по возрастанию
+     * \param options Параметры перестройки
+     * \param strategy Способ выбора вопроса
+     */
+    TreeRestructuring(
+        const std::vector<Condition>& conditions,
+        const std::vector<std::uint32_t>& sequence,
+        const std::vector<PathRule>& rules,
+        const std::vector<std::vector<int>>& domains,
+        const OptimizerOptions& options,
+        const SplitStrategy strategy):
+        m_conditions(conditions),
+        m_sequence(sequence),
+        m_rules(rules),
+        m_domains(domains),
+        m_strategy(strategy),
+        m_exactLimit(strategy == SplitStrategy::Original ? 0
+            : std::min(options.exactLimit, kMaxExactLimit)),
+        m_budget(strategy != SplitStrategy::Copying ? 0.0
+            : static_cast<double>(rules.size()) * std::max(0.0, options.maxGrowth - 1)),
+        m_slots(domains.size(), kLeaf)
+    {
+        // Доли значений ответов на каждый вопрос по всем правилам.
+        // Правило, не отвечающее на вопрос, делит вес между ветвями в этих долях
+        m_marginals.resize(domains.size());
+        for (std::size_t question = 0; question < domains.size(); ++question) {
+            m_marginals[question].assign(domains[question].size(), 0.0);
+        }
+        for (const auto& rule : rules) {
+            for (auto i = rule.begin; i < rule.end; ++i) {
+                const auto& condition = conditions[i];
+                m_marginals[condition.question][ValueSlot(condition.question, condition.value)] += rule.weight;
+            }
+        }
+        for (auto& marginal : m_marginals) {
+            double total = 0;
+            for (const auto weight : marginal) {
+                total += weight;
+            }
+            for (auto& weight : marginal) {
+                weight = total > 0 ? weight / total : 1.0 / double(marginal.size());
+            }
+        }
+    }
+
+    /**
+     * Построение дерева.
+     *
+     * \return Узлы дерева, корень - первый. Вес вопроса - вклад
+     * в ожидаемое количество вопросов
+     */
+    std::vector<OptimizedNode> Build()
+    {
+        std::vector<RuleItem> items(m_rules.size());
+        for (std::size_t rule = 0; rule < m_rules.size(); ++rule) {
+            items[rule] = { static_cast<std::uint32_t>(rule), m_rules[rule].weight };
+        }
+        m_nodes.emplace_back();
+        // Ветви строятся через стек, а не рекурсией: глубина дерева-цепочки
+        // равна количеству вопросов
+        std::vector<std::pair<std::uint32_t, std::vector<RuleItem>>> stack;
+        stack.emplace_back(0, std::move(items));
+        while (!stack.empty()) {
+            const auto node = stack.back().first;
+            const auto branch = std::move(stack.back().second);
+            stack.pop_back();
+            double weight = 0;
+            for (const auto& item : branch) {
+                weight += item.weight;
+            }
+            m_nodes[node].weight = weight;
+            if (SameAnswer(branch)) {
+                m_nodes[node].answer = m_rules[branch.front().rule].answer;
+                continue;
+            }
+            if (branch.size() <= m_exactLimit) {
+                BuildExact(node, branch);
+                continue;
+            }
+            const auto question = ChooseQuestion(branch);
+            m_nodes[node].question = question;
+            for (auto& [value, child] : Split(branch, question)) {
+                const auto childNode = static_cast<std::uint32_t>(m_nodes.size());
+                m_nodes.emplace_back();
+                m_nodes[node].children.emplace_back(value, childNode);
+                stack.emplace_back(childNode, std::move(child));
+            }
+        }
+        return std::move(m_nodes);
+    }
+
+    /**
+     * Получение количества поддеревьев, построенных точным перебором.
+     *
+     * \return Количество поддеревьев
+     */
+    std::size_t ExactSubtrees() const noexcept
+    {
+        return m_exactSubtrees;
+    }
+
+    /**
+     * Поиск ответа правила на вопрос.
+     *
+     * \param rule Номер правила
+     * \param question Номер вопроса
+     * \param value Значение ответа
+     * \return true - если правило отвечает на вопрос
+     */
+    bool FindValue(
+        const std::uint32_t rule,
+        const std::uint32_t question,
+        int& value) const noexcept
+    {
+        const auto begin = m_conditions.begin() + static_cast<std::ptrdiff_t>(m_rules[rule].begin);
+        const auto end = m_conditions.begin() + static_cast<std::ptrdiff_t>(m_rules[rule].end);
+        const auto it = std::lower_bound(begin, end, question,
+            [](const Condition& condition, const std::uint32_t q) { return condition.question < q; });
+        if (it == end || it->question != question) {
+            return false;
+        }
+        value = it->value;
+        return true;
+    }
+
+private:
+
+    /**
+     * Оценка вопроса в узле.
+     */
+    struct Candidate
+    {
+        // Номер вопроса
+        std::uint32_t question = 0;
+        // Количество правил, отвечающих на вопрос
+        std::size_t count = 0;
+        // Вес и количество правил по значениям ответа
+        std::vector<double> weights;
+        std::vector<std::size_t> counts;
+        // Вес правил по номеру значения (старшие 32 бита) и ответу
+        std::vector<std::pair<std::uint64_t, double>> pairs;
+    };
+
+    /**
+     * Исход точного перебора для набора правил.
+     */
+    struct ExactChoice
+    {
+        // Ожидаемое количество вопросов, умноженное на вес
+        double cost = 0;
+        // Лучший вопрос, либо kLeaf для ответа
+        std::uint32_t question = kLeaf;
+    };
+
+    /**
+     * Номер значения ответа среди значений вопроса.
+     */
+    std::size_t ValueSlot(
+        const std::uint32_t question,
+        const int value) const noexcept
+    {
+        const auto& domain = m_domains[question];
+        return static_cast<std::size_t>(
+            std::lower_bound(domain.begin(), domain.end(), value) - domain.begin());
+    }
+
+    /**
+     * Проверка, что все правила ведут к одному ответу.
+     */
+    bool SameAnswer(
+        const std::vector<RuleItem>& items) const noexcept
+    {
+        for (const auto& item : items) {
+            if (m_rules[item.rule].answer != m_rules[items.front().rule].answer) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Выбор вопроса с наибольшим приростом информации об ответе.
+     * Правила, не отвечающие на вопрос, делятся между всеми ветвями
+     * в долях значений ответа, поэтому такой вопрос выбирается,
+     * только если на него отвечает не меньше половины правил
+     * и пока не исчерпан запас роста дерева.
+     *
+     * \param items Правила узла
+     * \return Номер вопроса
+     */
+    std::uint32_t ChooseQuestion(
+        const std::vector<RuleItem>& items)
+    {
+        std::size_t used = 0;
+        double total = 0;
+        m_answerWeights.clear();
+        for (const auto& item : items) {
+            total += item.weight;
+            const auto& rule = m_rules[item.rule];
+            m_answerWeights.emplace_back(rule.answer, item.weight);
+            for (auto i = rule.begin; i < rule.end; ++i) {
+                const auto& condition = m_conditions[i];
+                auto& slot = m_slots[condition.question];
+                if (slot == kLeaf) {
+                    slot = static_cast<std::uint32_t>(used++);
+                    if (m_candidates.size() < used) {
+                        m_candidates.emplace_back();
+                    }
+                    auto& candidate = m_candidates[slot];
+                    candidate.question = condition.question;
+                    candidate.count = 0;
+                    candidate.weights.assign(m_domains[condition.question].size(), 0.0);
+                    candidate.counts.assign(m_domains[condition.question].size(), 0);
+                    candidate.pairs.clear();
+                }
+                auto& candidate = m_candidates[slot];
+                const auto value = ValueSlot(condition.question, condition.value);
+                candidate.weights[value] += item.weight;
+                if (m_strategy != SplitStrategy::Original) {
+                    candidate.pairs.emplace_back((std::uint64_t(value) << 32) | rule.answer, item.weight);
+                }
+                ++candidate.counts[value];
+                ++candidate.count;
+            }
+        }
+        const auto splits = [&](const Candidate& candidate)
+        {
+            return std::count_if(candidate.counts.begin(), candidate.counts.end(),
+                [](const std::size_t count) { return count > 0; }) > 1;
+        };
+        std::uint32_t best = kLeaf;
+        if (m_strategy == SplitStrategy::Original) {
+            // Первый вопрос пути, на который отвечают все правила и ответы
+            // на который различаются, - тот, на котором пути расходятся
+            // в исходном дереве
+            const auto& rule = m_rules[items.front().rule];
+            for (auto i = rule.begin; best == kLeaf && i < rule.end; ++i) {
+                const auto& candidate = m_candidates[m_slots[m_sequence[i]]];
+                if (candidate.count == items.size() && splits(candidate)) {
+                    best = candidate.question;
+                }
+            }
+        }
+        CombineWeights(m_answerWeights);
+        double entropy = XLogX(total);
+        for (const auto& [answer, weight] : m_answerWeights) {
+            entropy -= XLogX(weight);
+        }
+        double bestGain = 0;
+        bool bestCopies = false;
+        for (std::size_t i = 0; i < used; ++i) {
+            auto& candidate = m_candidates[i];
+            m_slots[candidate.question] = kLeaf;
+            if (m_strategy == SplitStrategy::Original || !splits(candidate)) {
+                continue;
+            }
+            const auto uncovered = items.size() - candidate.count;
+            const bool copies = uncovered > 0;
+            if (copies && (double(candidate.count) < kMinCoverage * double(items.size())
+                || double(uncovered * (candidate.counts.size() - 1)) > m_budget)) {
+                continue;
+            }
+            CombineWeights(candidate.pairs);
+            // Прирост - энтропия ответов узла без взвешенной энтропии ветвей.
+            // Вес ветви по ответу - вес отвечающих правил плюс доля
+            // веса не отвечающих
+            const auto& marginal = m_marginals[candidate.question];
+            double covered = 0;
+            for (const auto weight : candidate.weights) {
+                covered += weight;
+            }
+            const auto rest = std::max(0.0, total - covered);
+            double branches = 0;
+            for (std::size_t value = 0; value < candidate.weights.size(); ++value) {
+                branches += XLogX(candidate.weights[value] + (copies ? rest * marginal[value] : 0.0));
+            }
+            if (!copies) {
+                for (const auto& [key, weight] : candidate.pairs) {
+                    branches -= XLogX(weight);
+                }
+            }
+            else {
+                // Вес не отвечающих правил по ответам - разность упорядоченных
+                // весов всех правил узла и отвечающих
+                m_covered.clear();
+                for (const auto& [key, weight] : candidate.pairs) {
+                    m_covered.emplace_back(static_cast<node_index_t>(key), weight);
+                }
+                CombineWeights(m_covered);
+                m_uncovered.clear();
+                auto covered = m_covered.begin();
+                for (const auto& [answer, weight] : m_answerWeights) {
+                    auto remaining = weight;
+                    if (covered != m_covered.end() && covered->first == answer) {
+                        remaining -= (covered++)->second;
+                    }
+                    if (remaining > kGainTolerance * weight) {
+                        m_uncovered.emplace_back(answer, remaining);
+                    }
+                }
+                // Пары одного значения идут подряд по возрастанию ответа
+                // и сливаются с весами не отвечающих правил
+                auto pair = candidate.pairs.begin();
+                for (std::size_t value = 0; value < marginal.size(); ++value) {
+                    auto shared = m_uncovered.begin();
+                    for (; pair != candidate.pairs.end() && (pair->first >> 32) == value; ++pair) {
+                        const auto answer = static_cast<node_index_t>(pair->first);
+                        for (; shared != m_uncovered.end() && shared->first < answer; ++shared) {
+                            branches -= XLogX(shared->second * marginal[value]);
+                        }
+                        auto weight = pair->second;
+                        if (shared != m_uncovered.end() && shared->first == answer) {
+                            weight += (shared++)->second * marginal[value];
+                        }
+                        branches -= XLogX(weight);
+                    }
+                    for (; shared != m_uncovered.end(); ++shared) {
+                        branches -= XLogX(shared->second * marginal[value]);
+                    }
+                }
+            }
+            const auto gain = entropy - branches;
+            // При равном приросте предпочитаем вопрос без копирования правил,
+            // затем - заданный раньше в исходном дереве
+            const auto tolerance = kGainTolerance * std::max(1.0, std::abs(bestGain));
+            const bool better = best == kLeaf || gain > bestGain + tolerance
+                || (gain > bestGain - tolerance && (bestCopies > copies
+                    || (bestCopies == copies && candidate.question < best)));
+            if (better) {
+                best = candidate.question;
+                bestGain = gain;
+                bestCopies = copies;
+            }
+        }
+        if (best == kLeaf) {
+            throw std::logic_error(u8"Ни один вопрос не разделяет правила");
+        }
+        return best;
+    }
+
+    /**
+     * Разбиение правил по ответу на вопрос.
+     *
+     * \param items Правила узла
+     * \param question Номер вопроса
+     * \return Значения ответа и правила ветвей
+     */
+    std::vector<std::pair<int, std::vector<RuleItem>>> Split(
+        const std::vector<RuleItem>& items,
+        const std::uint32_t question)
+    {
+        const auto& domain = m_domains[question];
+        const auto& marginal = m_marginals[question];
+        std::vector<std::vector<RuleItem>> branches(domain.size());
+        std::size_t uncovered = 0;
+        for (const auto& item : items) {
+            int value = 0;
+            if (FindValue(item.rule, question, value)) {
+                branches[ValueSlot(question, value)].push_back(item);
+                continue;
+            }
+            ++uncovered;
+            for (std::size_t slot = 0; slot < domain.size(); ++slot) {
+                branches[slot].push_back({ item.rule, item.weight * marginal[slot] });
+            }
+        }
+        m_budget -= double(uncovered * (domain.size() - 1));
+        std::vector<std::pair<int, std::vector<RuleItem>>> result;
+        for (std::size_t slot = 0; slot < domain.size(); ++slot) {
+            if (!branches[slot].empty()) {
+                result.emplace_back(domain[slot], std::move(branches[slot]));
+            }
+        }
+        return result;
+    }
+
+    /**
+     * Построение поддерева точным перебором.
+     * Перебираются только вопросы, на которые отвечают все правила
+     * поддерева, поэтому набор правил задаётся битовой маской,
+     * а вес правила в ветви не меняется.
+     *
+     * \param node Корень поддерева
+     * \param items Правила поддерева
+     * \return
+     */
+    void BuildExact(
+        const std::uint32_t node,
+        const std::vector<RuleItem>& items)
+    {
+        m_exactItems = items;
+        m_exactMemo.clear();
+        const auto mask = static_cast<std::uint32_t>((std::uint64_t(1) << items.size()) - 1);
+        SolveExact(mask);
+        EmitExact(node, mask);
+        ++m_exactSubtrees;
+    }
+
+    /**
+     * Разбиение набора правил точного перебора по ответу на вопрос.
+     *
+     * \param mask Набор правил
+     * \param question Номер вопроса
+     * \param parts Значения ответа и наборы правил ветвей
+     * \return true - если на вопрос отвечают все правила
+     * и ответы разделяют правила
+     */
+    bool PartitionExact(
+        const std::uint32_t mask,
+        const std::uint32_t question,
+        std::vector<std::pair<int, std::uint32_t>>& parts) const
+    {
+        parts.clear();
+        for (std::uint32_t rest = mask; rest; rest &= rest - 1) {
+            const auto bit = LowestBit(rest);
+            int value = 0;
+            if (!FindValue(m_exactItems[bit].rule, question, value)) {
+                return false;
+            }
+            auto part = std::find_if(parts.begin(), parts.end(),
+                [value](const std::pair<int, std::uint32_t>& p) { return p.first == value; });
+            if (part == parts.end()) {
+                parts.emplace_back(value, 0);
+                part = parts.end() - 1;
+            }
+            part->second |= std::uint32_t(1) << bit;
+        }
+        std::sort(parts.begin(), parts.end());
+        return parts.size() > 1;
+    }
+
+    /**
+     * Наименьшая ожидаемая стоимость набора правил.
+     *
+     * \param mask Набор правил
+     * \return Стоимость: сумма по вопросам веса проходящих через них правил
+     */
+    double SolveExact(
+        const std::uint32_t mask)
+    {
+        if (const auto it = m_exactMemo.find(mask); it != m_exactMemo.end()) {
+            return it->second.cost;
+        }
+        ExactChoice choice;
+        const auto first = LowestBit(mask);
+        const auto answer = m_rules[m_exactItems[first].rule].answer;
+        bool same = true;
+        double weight = 0;
+        for (std::uint32_t rest = mask; rest; rest &= rest - 1) {
+            const auto& item = m_exactItems[LowestBit(rest)];
+            same = same && m_rules[item.rule].answer == answer;
+            weight += item.weight;
+        }
+        if (!same) {
+            // Вопрос, на который отвечают все правила, есть среди вопросов
+            // любого из них, например, первого
+            const auto& rule = m_rules[m_exactItems[first].rule];
+            std::vector<std::pair<int, std::uint32_t>> parts;
+            choice.cost = HUGE_VAL;
+            for (auto i = rule.begin; i < rule.end; ++i) {
+                const auto question = m_conditions[i].question;
+                if (!PartitionExact(mask, question, parts)) {
+                    continue;
+                }
+                double cost = weight;
+                for (const auto& part : parts) {
+                    cost += SolveExact(part.second);
+                }
+                if (cost < choice.cost) {
+                    choice.cost = cost;
+                    choice.question = question;
+                }
+            }
+            if (choice.question == kLeaf) {
+                throw std::logic_error(u8"Ни один вопрос не разделяет правила");
+            }
+        }
+        m_exactMemo[mask] = choice;
+        return choice.cost;
+    }
+
+    /**
+     * Запись поддерева точного перебора в узлы дерева.
+     *
+     * \param node Корень поддерева
+     * \param mask Набор правил
+     * \return
+     */
+    void EmitExact(
+        const std::uint32_t node,
+        const std::uint32_t mask)
+    {
+        double weight = 0;
+        for (std::uint32_t rest = mask; rest; rest &= rest - 1) {
+            weight += m_exactItems[LowestBit(rest)].weight;
+        }
+        m_nodes[node].weight = weight;
+        const auto question = m_exactMemo.at(mask).question;
+        if (question == kLeaf) {
+            m_nodes[node].answer = m_rules[m_exactItems[LowestBit(mask)].rule].answer;
+            return;
+        }
+        m_nodes[node].question = question;
+        std::vector<std::pair<int, std::uint32_t>> parts;
+        PartitionExact(mask, question, parts);
+        for (const auto& [value, part] : parts) {
+            const auto child = static_cast<std::uint32_t>(m_nodes.size());
+            m_nodes.emplace_back();
+            m_nodes[node].children.emplace_back(value, child);
+            EmitExact(child, part);
+        }
+    }
+
+    // Ответы правил на вопросы
+    const std::vector<Condition>& m_conditions;
+    // Вопросы правил в порядке пути
+    const std::vector<std::uint32_t>& m_sequence;
+    // Правила
+    const std::vector<PathRule>& m_rules;
+    // Значения ответов каждого вопроса по возрастанию
+    const std::vector<std::vector<int>>& m_domains;
+    // Способ выбора вопроса
+    SplitStrategy m_strategy;
+    // Доли значений ответов каждого вопроса
+    std::vector<std::vector<double>> m_marginals;
+    // Наибольшее количество правил точного перебора
+    std::size_t m_exactLimit;
+    // Оставшийся запас копий правил
+    double m_budget;
+    // Номер оценки вопроса в m_candidates, либо kLeaf
+    std::vector<std::uint32_t> m_slots;
+    // Оценки вопросов узла. Память переиспользуется между узлами
+    std::vector<Candidate> m_candidates;
+    // Вес правил узла по ответам. Массивы, а не хеш-таблицы: очистка
+    // хеш-таблицы стоит столько же, сколько самое большое её заполнение
+    std::vector<std::pair<node_index_t, double>> m_answerWeights;
+    // Вес правил узла, отвечающих и не отвечающих на оцениваемый вопрос, по ответам
+    std::vector<std::pair<node_index_t, double>> m_covered;
+    std::vector<std::pair<node_index_t, double>> m_uncovered;
+    // Правила текущего поддерева точного перебора
+    std::vector<RuleItem> m_exactItems;
+    // Лучшие вопросы для наборов правил текущего поддерева
+    std::unordered_map<std::uint32_t, ExactChoice> m_exactMemo;
+    // Количество поддеревьев, построенных точным перебором
+    std::size_t m_exactSubtrees = 0;
+    // Построенные узлы
+    std::vector<OptimizedNode> m_nodes;
+};
+
+/**
+ * Чтение частот ответов из файла.
+ *
+ * \param path Путь к файлу
+ * \param tree Исходное дерево
+ * \param frequencies Частоты по индексам узлов
+ * \return
+ */
+static void ReadPriors(
+    const std::string& path,
+    const Tree& tree,
+    std::vector<double>& frequencies)
+{
+    std::ifstream file(path);
+    if (!file) {
+        throw std::runtime_error(u8"Не удалось открыть файл частот " + path);
+    }
+    std::size_t unknown = 0;
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream fields(line);
+        node_id_t id = 0;
+        double frequency = 0;
+        if (line.empty() || line[0] == '#' || !(fields >> id >> frequency)) {
+            continue;
+        }
+        const auto index = tree.FindNode(id);
+        const auto node = index != kInvalidIndex ? tree.GetNode(index) : nullptr;
+        if (!node || node->Type() != NodeType::Answer || frequency < 0) {
+            ++unknown;
+            continue;
+        }
+        frequencies[index] += frequency;
+    }
+    if (unknown) {
+        logger->Log(LogLevel::Warning, u8"Частоты пропущены для неизвестных ответов: "
+            + std::to_string(unknown));
+    }
+}
+
+/**
+ * Подсчёт частот ответов по трассе сеансов.
+ * Каждый проход сеанса от корня повторяется на дереве,
+ * и частота достигнутого ответа увеличивается на 1.
+ *
+ * \param directory Каталог трассы
+ * \param tree Исходное дерево
+ * \param frequencies Частоты по индексам узлов
+ * \return
+ */
+static void CountTracePriors(
+    const std::string& directory,
+    const Tree& tree,
+    std::vector<double>& frequencies)
+{
+    std::stringstream replay;
+    DecodeTrace(directory, TraceFormat::Replay, std::string(), replay);
+    std::size_t passes = 0;
+    std::string line;
+    while (std::getline(replay, line)) {
+        std::istringstream values(line);
+        auto node = tree.GetRoot();
+        int value = 0;
+        while (node && node->Type() == NodeType::Question && values >> value) {
+            const auto next = static_cast<const Question*>(node)->GetNext(value);
+            node = next != kInvalidIndex ? tree.GetNode(next) : nullptr;
+        }
+        if (node && node->Type() == NodeType::Answer) {
+            frequencies[node->Index()] += 1;
+            ++passes;
+        }
+    }
+    logger->Log(LogLevel::Info, u8"Частоты ответов подсчитаны по "
+        + std::to_string(passes) + u8" сеансам");
+}
+
+/**
+ * Перестройка дерева для уменьшения ожидаемого количества вопросов.
+ *
+ * \param configPath Путь к исходной конфигурации
+ * \param outputPath Путь к создаваемому файлу конфигурации
+ * \param options Параметры перестройки
+ * \return Результат перестройки
+ */
+OptimizerStats OptimizeTree(
+    const std::string& configPath,
+    const std::string& outputPath,
+    const OptimizerOptions& options) noexcept(false)
+{
+    auto loader = CreateExpertSystemLoader();
+    Tree tree;
+    loader->Load(configPath, tree);
+    tree.Finish();
+    const auto report = ValidateTree(tree, ValidationOptions());
+    if (report.issues[static_cast<std::size_t>(ValidationIssue::Cycle)].count
+        || report.issues[static_cast<std::size_t>(ValidationIssue::DeadEnd)].count) {
+        throw std::runtime_error(u8"Перестраивается только дерево без циклов "
+            u8"и вопросов без соединений: " + configPath);
+    }
+    const auto root = tree.GetRoot();
+    if (!root) {
+        throw std::runtime_error(u8"В конфигурации нет вопросов: " + configPath);
+    }
+
+    // Правила - пути от корня до ответов. Узлы с одинаковым текстом -
+    // один и тот же вопрос, заданный в разных ветвях. Вопросы нумеруются
+    // в порядке обхода в глубину, значения ответов вопроса собираются
+    // по соединениям всех его узлов
+    std::unordered_map<std::string_view, std::uint32_t> texts;
+    std::vector<std::uint32_t> numbers(tree.NodesCount(), kLeaf);
+    std::vector<std::vector<node_index_t>> questions;
+    std::vector<std::vector<int>> domains;
+    std::vector<Condition> conditions;
+    std::vector<std::uint32_t> sequence;
+    std::vector<PathRule> rules;
+    std::vector<Condition> path;
+    std::vector<std::size_t> stamps;
+    std::size_t questionNodes = 0;
+    std::size_t infeasible = 0;
+    std::vector<std::pair<node_index_t, std::size_t>> stack{ { root->Index(), 0 } };
+    while (!stack.empty()) {
+        const auto [index, position] = stack.back();
+        const auto node = tree.GetNode(index);
+        if (node->Type() == NodeType::Answer) {
+            // Повторный вопрос на пути с другим ответом - путь, по которому
+            // не пройдёт ни один сеанс с согласованными ответами
+            PathRule rule;
+            rule.begin = conditions.size();
+            rule.depth = path.size();
+            rule.answer = index;
+            const auto stamp = rules.size() + infeasible + 1;
+            for (const auto& condition : path) {
+                if (stamps[condition.question] != stamp) {
+                    stamps[condition.question] = stamp;
+                    conditions.push_back(condition);
+                    sequence.push_back(condition.question);
+                }
+            }
+            rule.end = conditions.size();
+            const auto begin = conditions.begin() + static_cast<std::ptrdiff_t>(rule.begin);
+            std::sort(begin, conditions.end(),
+                [](const Condition& a, const Condition& b) { return a.question < b.question; });
+            const bool feasible = std::all_of(path.begin(), path.end(),
+                [&](const Condition& condition)
+            {
+                return std::lower_bound(begin, conditions.end(), condition.question,
+                    [](const Condition& c, const std::uint32_t q) { return c.question < q; })->value
+                    == condition.value;
+            });
+            if (feasible) {
+                rules.push_back(rule);
+            }
+            else {
+                conditions.resize(rule.begin);
+                sequence.resize(rule.begin);
+                ++infeasible;
+            }
+            if (rules.size() + infeasible > options.maxPaths) {
+                throw std::runtime_error(u8"Путей от корня до ответов больше "
+                    + std::to_string(options.maxPaths) + ": " + configPath);
+            }
+        }
+        else {
+            auto& number = numbers[index];
+            const auto& children = static_cast<const Question*>(node)->GetChildrens();
+            if (number == kLeaf) {
+                number = texts.emplace(node->Data(), static_cast<std::uint32_t>(questions.size())).first->second;
+                if (number == questions.size()) {
+                    questions.emplace_back();
+                    domains.emplace_back();
+                    stamps.push_back(0);
+                }
+                questions[number].push_back(index);
+                auto& domain = domains[number];
+                for (const auto& [child, predicat] : children) {
+                    domain.push_back(predicat.value);
+                }
+                std::sort(domain.begin(), domain.end());
+                domain.erase(std::unique(domain.begin(), domain.end()), domain.end());
+                ++questionNodes;
+            }
+            // Из соединений с одинаковым значением ответа
+            // сеанс всегда проходит по первому
+            auto next = position;
+            while (next < children.size() && std::any_of(children.begin(),
+                children.begin() + static_cast<std::ptrdiff_t>(next),
+                [&](const std::pair<node_index_t, node_predicat_t>& child)
+            {
+                return child.second.value == children[next].second.value;
+            })) {
+                ++next;
+            }
+            if (next < children.size()) {
+                stack.back().second = next + 1;
+                path.push_back({ number, children[next].second.value });
+                stack.emplace_back(children[next].first, 0);
+                continue;
+            }
+        }
+        stack.pop_back();
+        if (!stack.empty()) {
+            path.pop_back();
+        }
+    }
+    if (infeasible) {
+        logger->Log(LogLevel::Warning, u8"Пропущены пути с противоречивыми ответами "
+            u8"на повторный вопрос: " + std::to_string(infeasible));
+    }
+
+    // Веса правил: частота ответа делится поровну между путями к нему
+    std::vector<double> frequencies(tree.NodesCount(), 0.0);
+    if (!options.priorsPath.empty()) {
+        ReadPriors(options.priorsPath, tree, frequencies);
+    }
+    if (!options.traceDirectory.empty()) {
+        CountTracePriors(options.traceDirectory, tree, frequencies);
+    }
+    std::vector<std::size_t> paths(tree.NodesCount(), 0);
+    for (const auto& rule : rules) {
+        ++paths[rule.answer];
+    }
+    OptimizerStats stats;
+    double total = 0;
+    for (std::size_t index = 0; index < paths.size(); ++index) {
+        if (paths[index]) {
+            frequencies[index] += options.smoothing;
+            total += frequencies[index];
+            ++stats.answers;
+        }
+    }
+    for (auto& rule : rules) {
+        rule.weight = total > 0 ? frequencies[rule.answer] / total / double(paths[rule.answer])
+            : 1.0 / double(stats.answers) / double(paths[rule.answer]);
+    }
+    stats.paths = rules.size();
+    stats.questionsBefore = questionNodes;
+    for (const auto& rule : rules) {
+        stats.expectedDepthBefore += rule.weight * double(rule.depth);
+        stats.maxDepthBefore = std::max(stats.maxDepthBefore, rule.depth);
+    }
+    if (stats.answers < 2) {
+        throw std::runtime_error(u8"Все пути ведут к одному ответу: " + configPath);
+    }
+
+    // Прирост информации не гарантирует наименьшую глубину, поэтому
+    // из деревьев, построенных разными способами, выбирается лучшее.
+    // Дерево в исходном порядке вопросов не хуже исходного
+    std::vector<OptimizedNode> nodes;
+    std::unique_ptr<TreeRestructuring> restructuring;
+    double best = HUGE_VAL;
+    for (const auto strategy : { SplitStrategy::Original, SplitStrategy::Covering, SplitStrategy::Copying }) {
+        auto candidate = std::make_unique<TreeRestructuring>(conditions, sequence, rules, domains, options, strategy);
+        auto built = candidate->Build();
+        double expected = 0;
+        for (const auto& node : built) {
+            expected += node.question != kLeaf ? node.weight : 0.0;
+        }
+        if (expected < best * (1 - kGainTolerance)) {
+            best = expected;
+            nodes = std::move(built);
+            restructuring = std::move(candidate);
+        }
+    }
+    stats.exactSubtrees = restructuring->ExactSubtrees();
+
+    // Проверка: любой путь исходного дерева приводит к тому же ответу.
+    // На вопрос, на который путь не отвечает, подходит любой ответ,
+    // поэтому проверяются все ветви такого вопроса
+    std::vector<std::uint32_t> reached;
+    for (std::uint32_t rule = 0; rule < rules.size(); ++rule) {
+        reached.assign(1, 0);
+        while (!reached.empty()) {
+            const auto node = reached.back();
+            reached.pop_back();
+            if (nodes[node].question == kLeaf) {
+                if (nodes[node].answer != rules[rule].answer) {
+                    throw std::logic_error(u8"Перестроенное дерево изменило ответ");
+                }
+                continue;
+            }
+            const auto& children = nodes[node].children;
+            int value = 0;
+            if (!restructuring->FindValue(rule, nodes[node].question, value)) {
+                for (const auto& [branch, child] : children) {
+                    reached.push_back(child);
+                }
+                continue;
+            }
+            const auto child = std::find_if(children.begin(), children.end(),
+                [value](const std::pair<int, std::uint32_t>& c) { return c.first == value; });
+            if (child == children.end()) {
+                throw std::logic_error(u8"Перестроенное дерево потеряло путь");
+            }
+            reached.push_back(child->second);
+        }
+    }
+
+    std::vector<std::pair<std::uint32_t, std::size_t>> walk{ { 0, 0 } };
+    while (!walk.empty()) {
+        const auto [node, depth] = walk.back();
+        walk.pop_back();
+        if (nodes[node].question == kLeaf) {
+            stats.maxDepthAfter = std::max(stats.maxDepthAfter, depth);
+            continue;
+        }
+        stats.expectedDepthAfter += nodes[node].weight;
+        for (const auto& [value, child] : nodes[node].children) {
+            walk.emplace_back(child, depth + 1);
+        }
+    }
+
+    // Одинаковые поддеревья записываются один раз, как общие поддеревья
+    // исходной конфигурации. Дочерние узлы создаются после родителя,
+    // поэтому обход с конца видит их раньше
+    std::vector<std::uint32_t> shared(nodes.size());
+    std::map<std::vector<std::int64_t>, std::uint32_t> subtrees;
+    for (auto node = static_cast<std::uint32_t>(nodes.size()); node-- > 0;) {
+        const auto& optimized = nodes[node];
+        std::vector<std::int64_t> key{ optimized.question,
+            optimized.question == kLeaf ? std::int64_t(optimized.answer) : 0 };
+        for (const auto& [value, child] : optimized.children) {
+            key.push_back(value);
+            key.push_back(shared[child]);
+        }
+        shared[node] = subtrees.emplace(std::move(key), node).first->second;
+    }
+
+    // Нумерация: появления вопроса получают идентификаторы его узлов
+    // в исходной конфигурации, а когда они закончатся - новые после
+    // наибольшего
+    node_id_t nextID = 0;
+    for (std::size_t index = 0; index < tree.NodesCount(); ++index) {
+        if (const auto node = tree.GetNode(static_cast<node_index_t>(index))) {
+            nextID = std::max(nextID, node->ID());
+        }
+    }
+    std::vector<std::size_t> placed(questions.size(), 0);
+    std::vector<node_id_t> ids(nodes.size(), -1);
+    std::vector<std::uint32_t> order;
+    std::vector<std::uint32_t> pending{ 0 };
+    while (!pending.empty()) {
+        const auto node = pending.back();
+        pending.pop_back();
+        const auto& optimized = nodes[node];
+        if (ids[node] != -1) {
+            continue;
+        }
+        if (optimized.question == kLeaf) {
+            ids[node] = tree.GetNode(optimized.answer)->ID();
+            continue;
+        }
+        const auto& sources = questions[optimized.question];
+        auto& count = placed[optimized.question];
+        ids[node] = count < sources.size() ? tree.GetNode(sources[count])->ID() : ++nextID;
+        ++count;
+        order.push_back(node);
+        for (auto it = optimized.children.rbegin(); it != optimized.children.rend(); ++it) {
+            pending.push_back(shared[it->second]);
+        }
+    }
+    stats.questionsAfter = order.size();
+
+    XmlConfigWriter writer(outputPath, options.name.empty() ? loader->GetName() : options.name);
+    for (const auto node : order) {
+        writer.AddNode("question", ids[node],
+            std::string(tree.GetNode(questions[nodes[node].question].front())->Data()));
+    }
+    for (std::size_t index = 0; index < paths.size(); ++index) {
+        if (paths[index]) {
+            const auto answer = tree.GetNode(static_cast<node_index_t>(index));
+            writer.AddNode("answer", answer->ID(), std::string(answer->Data()));
+        }
+    }
+    for (const auto node : order) {
+        for (const auto& [value, child] : nodes[node].children) {
+            writer.AddConnection(ids[node], ids[shared[child]], value);
+        }
+    }
+    writer.Finish();
+    logger->Log(LogLevel::Info, u8"Дерево перестроено: ожидаемое количество вопросов "
+        + std::to_string(stats.expectedDepthBefore) + u8" -> "
+        + std::to_string(stats.expectedDepthAfter) + u8", наибольшее "
+        + std::to_string(stats.maxDepthBefore) + u8" -> "
+        + std::to_string(stats.maxDepthAfter));
+    return stats;
+}
+
+}
@@ -1,17 +1,40 @@
 ﻿#pragma once
 
+#include <cstdint>
 #include <string>
-#include <functional>
+#include <string_view>
+#include <utility>
 
 namespace ES
 {
 
 // Тип для идентификатора узла
 using node_id_t = int;
-// Тип данных, хранящихся в узле
-using node_data_t = std::string;
-// Предикат для ответа
-using node_predicat_t = std::function<bool(const int)>;
+// Тип для плотного индекса узла.
+// Узлы дерева нумеруются подряд с нуля в порядке добавления
+using node_index_t = std::uint32_t;
+// Индекс, не соответствующий ни одному узлу
+constexpr node_index_t kInvalidIndex = ~node_index_t(0);
+// Тип данных узла в конфигурации.
+// Данные ссылаются на разобранную конфигурацию и действительны
+// только на время вызова построителя, поэтому построитель
+// копирует их в свою область памяти один раз
+using node_data_t = std::string_view;
+// Предикат для ответа.
+// Ответ удовлетворяет предикату, если совпадает с заданным значением.
+// Предикат хранится по значению, поэтому его создание, копирование
+// и вызов не требуют выделения памяти.
+struct EqualPredicat
+{
+    // Значение ответа, соответствующее соединению
+    int value = 0;
+
+    bool operator()(const int answer) const noexcept
+    {
+        return answer == value;
+    }
+};
+using node_predicat_t = EqualPredicat;
 
 // Тип узла
 enum class NodeType
@@ -28,12 +51,14 @@ struct NodeConfig
     // Данные, хранящиеся в узле
     node_data_t data;
 
-    // Конструктор
+    // Конструктор.
+    // Данные не копируются: строка создаётся только в области
+    // памяти построителя
     NodeConfig(
         const node_id_t _id,
-        const node_data_t& _data):
+        node_data_t _data):
         id(_id),
-        data(_data) {}
+        data(std::move(_data)) {}
 };
 
 // Конфигурация соединения
@@ -50,10 +75,10 @@ struct ConnectionConfig
     ConnectionConfig(
         const node_id_t _src,
         const node_id_t _dst,
-        const node_predicat_t _predicat):
+        node_predicat_t _predicat):
         src(_src),
         dst(_dst),
-        predicat(_predicat) {}
+        predicat(std::move(_predicat)) {}
 };
 
 }
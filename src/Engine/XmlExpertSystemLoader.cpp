@@ -1,9 +1,15 @@
 ﻿#include "XmlExpertSystemLoader.hpp"
 #include "ILogger.hpp"
+#include "MappedFile.hpp"
+#include "XmlScanner.hpp"
 
 #include "pugixml.hpp"
 
 #include <stdexcept>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <string_view>
 
 namespace ES
 {
@@ -22,11 +28,38 @@ std::unique_ptr<IExpertSystemLoader> CreateExpertSystemLoader()
  * Загрузка экспертной системы из файла конфигурации.
  * 
  * \param configPath путь к файлу конфигурации
+ * \param builder Построитель дерева, принимающий загруженные данные
  * \return 
  */
 void XmlExpertSystemLoader::Load(
-    const std::string& configPath) noexcept(false)
+    const std::string& configPath,
+    ITreeBuilder& builder) noexcept(false)
 {
+    // Конфигурация обычного вида разбирается сканером схемы. Если файл
+    // не открывается, то об ошибке, как и прежде, сообщает pugixml
+    std::error_code error;
+    if (m_parser != XmlParser::Pugixml && std::filesystem::is_regular_file(configPath, error)) {
+        MappedFile file(configPath);
+        XmlScanner scanner;
+        if (scanner.Scan(file.Data(), file.Size())) {
+            scanner.Emit(builder);
+            m_name = scanner.GetName();
+            m_languages.clear();
+            const auto configDirectory = std::filesystem::path(configPath).parent_path();
+            for (const auto& [code, path] : scanner.GetLanguages()) {
+                m_languages[code] = (configDirectory / path).string();
+            }
+            logger->Log(LogLevel::Info, u8"Экспертная система загружена");
+            return;
+        }
+        if (m_parser == XmlParser::Scanner) {
+            throw std::runtime_error(u8"Конфигурация выходит за схему сканера на байте "
+                + std::to_string(scanner.GetStopOffset()));
+        }
+        logger->Log(LogLevel::Info, u8"Конфигурация выходит за схему сканера на байте "
+            + std::to_string(scanner.GetStopOffset()) + u8", разбор pugixml");
+    }
+
     // xml-файл
     pugi::xml_document doc;
 
@@ -56,6 +89,23 @@ void XmlExpertSystemLoader::Load(
     // Сохраняем название экспертной системы
     m_name = elName.text().as_string();
 
+    // Запоминаем дополнительные языки. Сами тексты загружаются,
+    // только когда язык понадобится сеансу
+    m_languages.clear();
+    const auto configDirectory = std::filesystem::path(configPath).parent_path();
+    for (auto language = elEs.child("languages").child("language"); language;
+        language = language.next_sibling("language")) {
+        auto code = language.attribute("code");
+        auto path = language.attribute("path");
+        if (!code || !path) {
+            // Язык задан не полностью. Запишем предупреждение в лог
+            logger->Log(LogLevel::Warning,
+                u8"У элемента <language> не найден атрибут code или path");
+            continue;
+        }
+        m_languages[code.as_string()] = (configDirectory / path.as_string()).string();
+    }
+
     // Ищем в дочерних элементах элемента <es> элемент <tree>
     auto elTree = elEs.child("tree");
     if (!elTree) {
@@ -71,6 +121,21 @@ void XmlExpertSystemLoader::Load(
             u8"В конфигурационном файле не найден элемент <nodes>");
     }
 
+    // Подсчитываем количество вопросов и ответов,
+    // чтобы построитель заранее зарезервировал под них место
+    std::size_t questionsCount = 0;
+    std::size_t answersCount = 0;
+    for (auto node = elNodes.child("node"); node; node = node.next_sibling("node")) {
+        const char* nodeTypeStr = node.attribute("type").as_string();
+        if (std::strcmp(nodeTypeStr, "question") == 0) {
+            ++questionsCount;
+        }
+        else if (std::strcmp(nodeTypeStr, "answer") == 0) {
+            ++answersCount;
+        }
+    }
+    builder.Reserve(questionsCount, answersCount, 0);
+
     // Проходим по дочерним элементам <node> элемента <nodes>
     for (auto node = elNodes.child("node"); node; node = node.next_sibling("node")) {
         // Считываем атрибут type
@@ -101,14 +166,15 @@ void XmlExpertSystemLoader::Load(
             continue;
         }
         // Получаем стороковое представление типа узла
-        std::string nodeTypeStr = nodeType.as_string();
-        if (nodeTypeStr == "question") {
-            // Если текущий узел - это вопрос, то добавляем данные этого узла к списку вопросов
-            m_questions.emplace_back(nodeID.as_int(), std::string(nodeData.as_string()));
+        const char* nodeTypeStr = nodeType.as_string();
+        if (std::strcmp(nodeTypeStr, "question") == 0) {
+            // Если текущий узел - это вопрос, то передаём его в построитель.
+            // Текст узла передаётся без копирования, его копирует построитель
+            builder.AddQuestion(NodeConfig(nodeID.as_int(), nodeData.as_string()));
         }
-        else if (nodeTypeStr == "answer") {
-            // Если текущий узел - это ответ, то добавляем данные этого узла к списку ответов
-            m_answers.emplace_back(nodeID.as_int(), nodeData.as_string());
+        else if (std::strcmp(nodeTypeStr, "answer") == 0) {
+            // Если текущий узел - это ответ, то передаём его в построитель
+            builder.AddAnswer(NodeConfig(nodeID.as_int(), nodeData.as_string()));
         }
         else {
             // Неизвестный тип узла. Запишем предупреждение в лог
@@ -124,6 +190,13 @@ void XmlExpertSystemLoader::Load(
             u8"В конфигурационном файле не найден элемент <connections>");
     }
 
+    // Подсчитываем количество соединений
+    std::size_t connectionsCount = 0;
+    for (auto connection = nodeConnections.child("connection"); connection; connection = connection.next_sibling("connection")) {
+        ++connectionsCount;
+    }
+    builder.Reserve(0, 0, connectionsCount);
+
     // Проходим по дочерним элементам <connection> элемента <connections>
     for (auto connection = nodeConnections.child("connection"); connection; connection = connection.next_sibling("connection")) {
         // Считываем атрибут src
@@ -153,18 +226,243 @@ void XmlExpertSystemLoader::Load(
             // Проигнорируем текущйи элемент и перейдём к следующему элементу
             continue;
         }
-        // Добавляем соединение к списку соединений.
-        // Предикат - это функция сравнения числа с заданным в атрибуте predicat.
+        // Передаём соединение в построитель.
+        // Предикат - это сравнение числа с заданным в атрибуте predicat.
         // Те если параметр предиката раен 0, то если вызвать данный предикат,
         // передав в него 0, то получим ture.
         // Предикаты понадабятся при хождении по дереву
-        m_connections.emplace_back(src.as_int(), dst.as_int(),
-            [predicat=predicat.as_int()] (const int value) -> bool
-        {
-            return value == predicat;
-        });
+        builder.AddConnection(ConnectionConfig(src.as_int(), dst.as_int(),
+            node_predicat_t{predicat.as_int()}));
     }
     logger->Log(LogLevel::Info, u8"Экспертная система загружена");
 }
 
+namespace
+{
+
+/**
+ * Построитель, только считающий узлы и соединения.
+ */
+class CountingBuilder final :
+    public ITreeBuilder
+{
+public:
+    void Reserve(
+        const std::size_t,
+        const std::size_t,
+        const std::size_t) noexcept override
+    {
+    }
+
+    void AddQuestion(
+        NodeConfig&& question) noexcept override
+    {
+        AddNode(1, question);
+    }
+
+    void AddAnswer(
+        NodeConfig&& answer) noexcept override
+    {
+        AddNode(2, answer);
+    }
+
+    void AddConnection(
+        ConnectionConfig&& connection) noexcept override
+    {
+        ++m_stats.connections;
+        Mix(3);
+        Mix(static_cast<std::uint32_t>(connection.src));
+        Mix(static_cast<std::uint32_t>(connection.dst));
+        Mix(static_cast<std::uint32_t>(connection.predicat.value));
+    }
+
+    const ConfigParseStats& Stats() const noexcept
+    {
+        return m_stats;
+    }
+
+private:
+    void AddNode(
+        const std::uint32_t type,
+        const NodeConfig& node) noexcept
+    {
+        ++m_stats.nodes;
+        m_stats.textBytes += node.data.size();
+        Mix(type);
+        Mix(static_cast<std::uint32_t>(node.id));
+        Mix(std::hash<std::string_view>()(node.data));
+    }
+
+    // FNV-1a по словам
+    void Mix(
+        const std::uint64_t value) noexcept
+    {
+        m_stats.checksum = (m_stats.checksum ^ value) * 0x100000001B3ull;
+    }
+
+    ConfigParseStats m_stats = { 0, 0, 0, 0xCBF29CE484222325ull };
+};
+
+}
+
+/**
+ * Разбор конфигурации без построения дерева.
+ *
+ * \param configPath Путь к файлу конфигурации
+ * \param parser Способ разбора
+ * \return Итог разбора
+ */
+ConfigParseStats ParseConfig(
+    const std::string& configPath,
+    const XmlParser parser) noexcept(false)
+{
+    XmlExpertSystemLoader loader(parser);
+    CountingBuilder builder;
+    loader.Load(configPath, builder);
+    return builder.Stats();
+}
+
+/**
+ * Загрузка текстов узлов на дополнительном языке.
+ *
+ * \param textsPath Путь к файлу языка
+ * \param builder Построитель столбца текстов
+ * \return
+ */
+void XmlExpertSystemLoader::LoadTexts(
+    const std::string& textsPath,
+    ITextsBuilder& builder) noexcept(false)
+{
+    pugi::xml_document doc;
+    pugi::xml_parse_result result = doc.load_file(textsPath.c_str());
+    if (!result) {
+        throw std::runtime_error(result.description());
+    }
+    auto elEs = doc.child("es");
+    if (!elEs) {
+        throw std::runtime_error(
+            u8"В файле языка не найден элемент <es>");
+    }
+    // Имя на языке файла. Если его нет, то оставляем основное
+    if (auto elName = elEs.child("name")) {
+        m_name = elName.text().as_string();
+    }
+    auto elTexts = elEs.child("texts");
+    if (!elTexts) {
+        throw std::runtime_error(
+            u8"В файле языка не найден элемент <texts>");
+    }
+    std::size_t textsCount = 0;
+    for (auto text = elTexts.child("text"); text; text = text.next_sibling("text")) {
+        ++textsCount;
+    }
+    builder.Reserve(textsCount);
+    for (auto text = elTexts.child("text"); text; text = text.next_sibling("text")) {
+        auto textID = text.attribute("id");
+        if (!textID) {
+            logger->Log(LogLevel::Warning,
+                u8"У элемента <text> не найден атрибут id");
+            continue;
+        }
+        builder.AddText(NodeConfig(textID.as_int(), text.text().as_string()));
+    }
+    logger->Log(LogLevel::Info, u8"Тексты загружены: " + textsPath);
+}
+
+/**
+ * Экранирование текста для xml.
+ *
+ * \param text Текст
+ * \return Экранированный текст
+ */
+std::string EscapeXml(
+    const std::string& text)
+{
+    std::string escaped;
+    escaped.reserve(text.size());
+    for (const char c : text) {
+        switch (c) {
+        case '&': escaped += "&amp;"; break;
+        case '<': escaped += "&lt;"; break;
+        case '>': escaped += "&gt;"; break;
+        case '"': escaped += "&quot;"; break;
+        default: escaped.push_back(c);
+        }
+    }
+    return escaped;
+}
+
+/**
+ * Создание файла конфигурации.
+ *
+ * \param path Путь к файлу конфигурации
+ * \param name Название экспертной системы
+ */
+XmlConfigWriter::XmlConfigWriter(
+    const std::string& path,
+    const std::string& name) noexcept(false):
+    m_path(path),
+    m_out(path, std::ios::binary)
+{
+    if (!m_out) {
+        throw std::runtime_error(u8"Не удалось создать " + path);
+    }
+    m_out << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<es>\n"
+        << "    <name>" << EscapeXml(name) << "</name>\n"
+        << "    <tree>\n        <nodes>\n";
+}
+
+/**
+ * Запись узла.
+ *
+ * \param type Тип узла
+ * \param id Идентификатор узла
+ * \param text Текст узла
+ * \return
+ */
+void XmlConfigWriter::AddNode(
+    const char* type,
+    const std::int64_t id,
+    const std::string& text)
+{
+    m_out << "            <node type=\"" << type << "\" id=\"" << id << "\">"
+        << EscapeXml(text) << "</node>\n";
+}
+
+/**
+ * Запись связи.
+ *
+ * \param src Идентификатор вопроса
+ * \param dst Идентификатор дочернего узла
+ * \param predicat Ответ на вопрос
+ * \return
+ */
+void XmlConfigWriter::AddConnection(
+    const std::int64_t src,
+    const std::int64_t dst,
+    const int predicat)
+{
+    if (!m_connections) {
+        m_out << "        </nodes>\n        <connections>\n";
+        m_connections = true;
+    }
+    m_out << "            <connection src=\"" << src
+        << "\" dst=\"" << dst << "\" predicat=\"" << predicat << "\" />\n";
+}
+
+/**
+ * Закрытие элементов и файла.
+ *
+ * \return
+ */
+void XmlConfigWriter::Finish() noexcept(false)
+{
+    m_out << (m_connections ? "        </connections>\n" : "        </nodes>\n")
+        << "    </tree>\n</es>\n";
+    m_out.close();
+    if (!m_out) {
+        throw std::runtime_error(u8"Не удалось записать " + m_path);
+    }
+}
+
 }
@@ -1,7 +1,11 @@
 ﻿#pragma once
 
+#include "ConfigParser.hpp"
 #include "IExpertSystemLoader.hpp"
 
+#include <cstdint>
+#include <fstream>
+
 namespace ES
 {
 
@@ -25,45 +29,137 @@ namespace ES
  *         </connections>
  *     </tree>
  * </es>
+ * Тексты на дополнительных языках хранятся в отдельных файлах,
+ * которые перечисляются в элементе <languages> основной конфигурации:
+ * <languages>
+ *     <language code="en" path="health.en.xml" />
+ * </languages>
+ * Путь к файлу языка задаётся относительно основной конфигурации.
+ * Конфигурация такого вида разбирается сканером схемы (XmlScanner)
+ * прямо из отображённого в память файла, остальные - pugixml.
+ * Файл языка содержит только имя и тексты узлов:
+ * <es>
+ *     <name>Health check</name>
+ *     <texts>
+ *         <text id="1">Do you have a headache?</text>
+ *         <text id="2">See a doctor</text>
+ *         <text id="3">You are healthy!</text>
+ *     </texts>
+ * </es>
  */
 class XmlExpertSystemLoader final :
     public IExpertSystemLoader
 {
 public:
+    /**
+     * Конструктор.
+     *
+     * \param parser Способ разбора конфигурации
+     */
+    explicit XmlExpertSystemLoader(
+        const XmlParser parser = XmlParser::Auto) noexcept:
+        m_parser(parser)
+    {
+    }
+
     virtual ~XmlExpertSystemLoader() = default;
 
     // Реализация интерфейса IExpertSystemLoader
     void Load(
-        const std::string& configPath) noexcept(false);
+        const std::string& configPath,
+        ITreeBuilder& builder) noexcept(false);
+
+    void LoadTexts(
+        const std::string& textsPath,
+        ITextsBuilder& builder) noexcept(false);
 
     std::string GetName() const noexcept
     {
         return m_name;
     }
 
-    std::vector<NodeConfig> GetQuestions() const noexcept
-    {
-        return m_questions;
-    }
-
-    std::vector<NodeConfig> GetAnswers() const noexcept
-    {
-        return m_answers;
-    }
-
-    std::vector<ConnectionConfig> GetConnections() const noexcept
+    std::map<std::string, std::string> GetLanguages() const noexcept
     {
-        return m_connections;
+        return m_languages;
     }
 private:
+    // Способ разбора конфигурации
+    XmlParser m_parser;
     // Название экспертной системы
     std::string m_name;
-    // Вопросы
-    std::vector<NodeConfig> m_questions;
-    // Ответы
-    std::vector<NodeConfig> m_answers;
-    // Соединения
-    std::vector<ConnectionConfig> m_connections;
+    // Дополнительные языки
+    // Ключ - код языка
+    // Значение - путь к файлу языка
+    std::map<std::string, std::string> m_languages;
+};
+
+/**
+ * Экранирование текста для записи в xml-конфигурацию.
+ *
+ * \param text Текст
+ * \return Экранированный текст
+ */
+std::string EscapeXml(
+    const std::string& text);
+
+/**
+ * Запись xml-конфигурации экспертной системы.
+ * Сначала добавляются все узлы, корень дерева - первый из них,
+ * затем связи. Построенные и перестроенные деревья записываются
+ * одинаково.
+ */
+class XmlConfigWriter final
+{
+public:
+    /**
+     * Конструктор. Создаёт файл и записывает название.
+     *
+     * \param path Путь к файлу конфигурации
+     * \param name Название экспертной системы
+     */
+    XmlConfigWriter(
+        const std::string& path,
+        const std::string& name) noexcept(false);
+
+    /**
+     * Добавление узла.
+     *
+     * \param type Тип узла: "question" или "answer"
+     * \param id Идентификатор узла
+     * \param text Текст узла
+     * eturn
+     */
+    void AddNode(
+        const char* type,
+        const std::int64_t id,
+        const std::string& text);
+
+    /**
+     * Добавление связи. После первой связи узлы не добавляются.
+     *
+     * \param src Идентификатор вопроса
+     * \param dst Идентификатор дочернего узла
+     * \param predicat Ответ на вопрос
+     * eturn
+     */
+    void AddConnection(
+        const std::int64_t src,
+        const std::int64_t dst,
+        const int predicat);
+
+    /**
+     * Завершение записи.
+     *
+     * eturn
+     */
+    void Finish() noexcept(false);
+private:
+    // Путь к файлу конфигурации
+    std::string m_path;
+    // Файл конфигурации
+    std::ofstream m_out;
+    // Записываются связи
+    bool m_connections = false;
 };
 
 }
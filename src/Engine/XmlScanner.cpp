@@ -0,0 +1,886 @@
+﻿#include "XmlScanner.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <string_view>
+
+// Команды AVX2 включаются только для функций поиска разметки,
+// а выбираются при запуске, если их поддерживает процессор
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define ES_SCANNER_AVX2 __attribute__((target("avx2")))
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <immintrin.h>
+#define ES_SCANNER_AVX2
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#   include <intrin.h>
+#endif
+
+namespace ES
+{
+
+namespace
+{
+
+/**
+ * Номер младшего единичного бита.
+ *
+ * \param mask Маска, не равная нулю
+ * \return Номер бита
+ */
+std::uint32_t LowestBit(
+    const std::uint32_t mask) noexcept
+{
+#if defined(_MSC_VER)
+    unsigned long result;
+    _BitScanForward(&result, mask);
+    return result;
+#else
+    return static_cast<std::uint32_t>(__builtin_ctz(mask));
+#endif
+}
+
+/**
+ * Проверка, что символ пробельный в смысле xml.
+ */
+bool IsSpace(
+    const char c) noexcept
+{
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r';
+}
+
+#if defined(ES_SCANNER_AVX2)
+/**
+ * Проверка поддержки команд AVX2 процессором и системой.
+ *
+ * \return true - если команды AVX2 можно использовать
+ */
+bool HasAvx2() noexcept
+{
+#if defined(__AVX2__)
+    return true;
+#elif defined(__GNUC__)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#else
+    // Процессор поддерживает AVX, XSAVE и AVX2, а система сохраняет регистры YMM
+    int info[4];
+    __cpuid(info, 1);
+    if (!(info[2] & (1 << 27)) || !(info[2] & (1 << 28)) || (_xgetbv(0) & 6) != 6) {
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#endif
+}
+
+// Признак поддержки команд AVX2
+const bool avx2Supported = HasAvx2();
+
+/**
+ * Поиск символа разметки блоками по 32 байта командами AVX2.
+ *
+ * \param it Начало текста
+ * \param end Конец конфигурации
+ * \return Найденный символ, либо начало недосмотренного хвоста короче блока
+ */
+ES_SCANNER_AVX2 const char* FindMarkupAvx2(
+    const char* it,
+    const char* end) noexcept
+{
+    const auto less = _mm256_set1_epi8('<');
+    const auto ampersand = _mm256_set1_epi8('&');
+    const auto carriage = _mm256_set1_epi8('\r');
+    for (; end - it >= 32; it += 32) {
+        const auto chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(it));
+        const auto hits = _mm256_or_si256(_mm256_cmpeq_epi8(chunk, less),
+            _mm256_or_si256(_mm256_cmpeq_epi8(chunk, ampersand), _mm256_cmpeq_epi8(chunk, carriage)));
+        const auto mask = static_cast<std::uint32_t>(_mm256_movemask_epi8(hits));
+        if (mask) {
+            return it + LowestBit(mask);
+        }
+    }
+    return it;
+}
+
+/**
+ * Поиск непробельного символа блоками по 32 байта командами AVX2.
+ *
+ * \param it Начало поиска
+ * \param end Конец конфигурации
+ * \return Найденный символ, либо начало недосмотренного хвоста короче блока
+ */
+ES_SCANNER_AVX2 const char* SkipSpacesAvx2(
+    const char* it,
+    const char* end) noexcept
+{
+    const auto space = _mm256_set1_epi8(' ');
+    const auto newline = _mm256_set1_epi8('\n');
+    const auto tab = _mm256_set1_epi8('\t');
+    const auto carriage = _mm256_set1_epi8('\r');
+    for (; end - it >= 32; it += 32) {
+        const auto chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(it));
+        const auto spaces = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(chunk, space), _mm256_cmpeq_epi8(chunk, newline)),
+            _mm256_or_si256(_mm256_cmpeq_epi8(chunk, tab), _mm256_cmpeq_epi8(chunk, carriage)));
+        const auto mask = ~static_cast<std::uint32_t>(_mm256_movemask_epi8(spaces));
+        if (mask) {
+            return it + LowestBit(mask);
+        }
+    }
+    return it;
+}
+#endif
+
+/**
+ * Поиск первого символа, после которого текст элемента нельзя взять
+ * как есть: '<' заканчивает текст, '&' начинает сущность,
+ * а '\r' заменяется переводом строки.
+ *
+ * \param it Начало текста
+ * \param end Конец конфигурации
+ * \return Найденный символ, либо end
+ */
+const char* FindMarkup(
+    const char* it,
+    const char* end) noexcept
+{
+    // Хвост короче 32 байт досматривается блоками SSE2. Найденный
+    // рядом с концом символ они вернут первым же сравнением
+#if defined(ES_SCANNER_AVX2)
+    if (avx2Supported) {
+        it = FindMarkupAvx2(it, end);
+        if (end - it >= 32) {
+            return it;
+        }
+    }
+#endif
+#if defined(__SSE2__) || defined(_M_X64)
+    const auto less = _mm_set1_epi8('<');
+    const auto ampersand = _mm_set1_epi8('&');
+    const auto carriage = _mm_set1_epi8('\r');
+    for (; end - it >= 16; it += 16) {
+        const auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(it));
+        const auto hits = _mm_or_si128(_mm_cmpeq_epi8(chunk, less),
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, ampersand), _mm_cmpeq_epi8(chunk, carriage)));
+        const auto mask = static_cast<std::uint32_t>(_mm_movemask_epi8(hits));
+        if (mask) {
+            return it + LowestBit(mask);
+        }
+    }
+#endif
+    while (it != end && *it != '<' && *it != '&' && *it != '\r') {
+        ++it;
+    }
+    return it;
+}
+
+/**
+ * Поиск первого непробельного символа.
+ *
+ * \param it Начало поиска
+ * \param end Конец конфигурации
+ * \return Найденный символ, либо end
+ */
+const char* SkipSpaces(
+    const char* it,
+    const char* end) noexcept
+{
+    // Между элементами чаще всего нет пробелов либо стоит короткий отступ
+    if (it == end || !IsSpace(*it)) {
+        return it;
+    }
+#if defined(ES_SCANNER_AVX2)
+    if (avx2Supported) {
+        it = SkipSpacesAvx2(it, end);
+        if (end - it >= 32) {
+            return it;
+        }
+    }
+#endif
+#if defined(__SSE2__) || defined(_M_X64)
+    const auto space = _mm_set1_epi8(' ');
+    const auto newline = _mm_set1_epi8('\n');
+    const auto tab = _mm_set1_epi8('\t');
+    const auto carriage = _mm_set1_epi8('\r');
+    for (; end - it >= 16; it += 16) {
+        const auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(it));
+        const auto spaces = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, space), _mm_cmpeq_epi8(chunk, newline)),
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, tab), _mm_cmpeq_epi8(chunk, carriage)));
+        const auto mask = ~static_cast<std::uint32_t>(_mm_movemask_epi8(spaces)) & 0xFFFFu;
+        if (mask) {
+            return it + LowestBit(mask);
+        }
+    }
+#endif
+    while (it != end && IsSpace(*it)) {
+        ++it;
+    }
+    return it;
+}
+
+/**
+ * Разбор целого числа без локали.
+ * Допускаются только необязательный минус и десятичные цифры.
+ *
+ * \param it Начало числа
+ * \param size Длина числа
+ * \param value Разобранное число
+ * \return true - если число разобрано и помещается в int
+ */
+bool ParseInt(
+    const char* it,
+    const std::size_t size,
+    int& value) noexcept
+{
+    const char* end = it + size;
+    const bool negative = it != end && *it == '-';
+    if (negative) {
+        ++it;
+    }
+    if (it == end || end - it > 10) {
+        return false;
+    }
+    std::int64_t result = 0;
+    for (; it != end; ++it) {
+        const auto digit = static_cast<unsigned char>(*it) - static_cast<unsigned char>('0');
+        if (digit > 9) {
+            return false;
+        }
+        result = result * 10 + digit;
+    }
+    result = negative ? -result : result;
+    if (result < INT_MIN || result > INT_MAX) {
+        return false;
+    }
+    value = static_cast<int>(result);
+    return true;
+}
+
+/**
+ * Запись символа в UTF-8.
+ *
+ * \param code Код символа
+ * \param target Строка, в которую дописывается символ
+ * \return
+ */
+void AppendUtf8(
+    const std::uint32_t code,
+    std::string& target)
+{
+    if (code < 0x80) {
+        target.push_back(static_cast<char>(code));
+    }
+    else if (code < 0x800) {
+        target.push_back(static_cast<char>(0xC0 | (code >> 6)));
+        target.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+    }
+    else if (code < 0x10000) {
+        target.push_back(static_cast<char>(0xE0 | (code >> 12)));
+        target.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+        target.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+    }
+    else {
+        target.push_back(static_cast<char>(0xF0 | (code >> 18)));
+        target.push_back(static_cast<char>(0x80 | ((code >> 12) & 0x3F)));
+        target.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+        target.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+    }
+}
+
+/**
+ * Раскодирование текста элемента так же, как это делает pugixml
+ * по умолчанию: сущности заменяются символами, а \r\n и \r - переводом строки.
+ *
+ * \param it Начало текста
+ * \param end Конец текста
+ * \param target Строка, в которую дописывается текст
+ * \return false - если в тексте незнакомая сущность
+ */
+bool DecodeText(
+    const char* it,
+    const char* end,
+    std::string& target)
+{
+    while (it != end) {
+        const char c = *it;
+        if (c == '\r') {
+            target.push_back('\n');
+            ++it;
+            if (it != end && *it == '\n') {
+                ++it;
+            }
+            continue;
+        }
+        if (c != '&') {
+            target.push_back(c);
+            ++it;
+            continue;
+        }
+        // Самая длинная сущность - &#x10FFFF;
+        const auto limit = static_cast<std::size_t>(std::min<std::ptrdiff_t>(end - it, 11));
+        const auto semicolon = static_cast<const char*>(std::memchr(it, ';', limit));
+        if (!semicolon) {
+            return false;
+        }
+        const std::string_view entity(it + 1, static_cast<std::size_t>(semicolon - it - 1));
+        if (entity == "lt") {
+            target.push_back('<');
+        }
+        else if (entity == "gt") {
+            target.push_back('>');
+        }
+        else if (entity == "amp") {
+            target.push_back('&');
+        }
+        else if (entity == "quot") {
+            target.push_back('"');
+        }
+        else if (entity == "apos") {
+            target.push_back('\'');
+        }
+        else if (entity.size() > 1 && entity[0] == '#') {
+            const bool hex = entity[1] == 'x';
+            const auto digits = entity.substr(hex ? 2 : 1);
+            if (digits.empty()) {
+                return false;
+            }
+            std::uint32_t code = 0;
+            for (const char digit : digits) {
+                std::uint32_t value = 0;
+                if (digit >= '0' && digit <= '9') {
+                    value = static_cast<std::uint32_t>(digit - '0');
+                }
+                else if (hex && digit >= 'a' && digit <= 'f') {
+                    value = static_cast<std::uint32_t>(digit - 'a' + 10);
+                }
+                else if (hex && digit >= 'A' && digit <= 'F') {
+                    value = static_cast<std::uint32_t>(digit - 'A' + 10);
+                }
+                else {
+                    return false;
+                }
+                code = code * (hex ? 16 : 10) + value;
+            }
+            if (code == 0 || code > 0x10FFFF || (code >= 0xD800 && code <= 0xDFFF)) {
+                return false;
+            }
+            AppendUtf8(code, target);
+        }
+        else {
+            return false;
+        }
+        it = semicolon + 1;
+    }
+    return true;
+}
+
+}
+
+/**
+ * Получение набора команд, которым ищется разметка.
+ *
+ * \return AVX2, SSE2, либо пустая строка
+ */
+std::string_view XmlScanner::Instructions() noexcept
+{
+#if defined(ES_SCANNER_AVX2)
+    if (avx2Supported) {
+        return "AVX2";
+    }
+#endif
+#if defined(__SSE2__) || defined(_M_X64)
+    return "SSE2";
+#else
+    return {};
+#endif
+}
+
+/**
+ * Разбор конфигурации.
+ *
+ * \param data Текст конфигурации
+ * \param size Размер текста в байтах
+ * \return true - если конфигурация соответствует схеме
+ */
+bool XmlScanner::Scan(
+    const char* data,
+    const std::size_t size)
+{
+    m_data = data;
+    m_it = data;
+    m_end = data + size;
+    m_name.clear();
+    m_languages.clear();
+    m_nodes.clear();
+    m_connections.clear();
+    m_questions = 0;
+    m_answers = 0;
+    m_decoded.clear();
+    const bool matched = data && ScanDocument();
+    m_stop = static_cast<std::size_t>(m_it - m_data);
+    return matched;
+}
+
+/**
+ * Передача узлов и соединений в построитель.
+ *
+ * \param builder Построитель дерева
+ * \return
+ */
+void XmlScanner::Emit(
+    ITreeBuilder& builder) const
+{
+    builder.Reserve(m_questions, m_answers, 0);
+    for (const auto& node : m_nodes) {
+        const char* text = (node.decoded ? m_decoded.data() : m_data) + node.text;
+        NodeConfig config(node.id, node_data_t(text, node.size));
+        if (node.question) {
+            builder.AddQuestion(std::move(config));
+        }
+        else {
+            builder.AddAnswer(std::move(config));
+        }
+    }
+    builder.Reserve(0, 0, m_connections.size());
+    for (const auto& connection : m_connections) {
+        builder.AddConnection(ConnectionConfig(connection.src, connection.dst,
+            node_predicat_t{ connection.predicat }));
+    }
+}
+
+/**
+ * Разбор документа: пролога и элемента <es>.
+ * Дочерние элементы <es> и <tree> могут идти в любом порядке,
+ * но каждый - не больше одного раза.
+ *
+ * \return true - если документ соответствует схеме
+ */
+bool XmlScanner::ScanDocument()
+{
+    // Метка порядка байтов UTF-8
+    if (m_end - m_it >= 3 && std::memcmp(m_it, "\xEF\xBB\xBF", 3) == 0) {
+        m_it += 3;
+    }
+    SkipSpace();
+    if (Expect("<?xml")) {
+        const std::string_view rest(m_it, static_cast<std::size_t>(m_end - m_it));
+        const auto close = rest.find("?>");
+        if (close == std::string_view::npos) {
+            return false;
+        }
+        m_it += close + 2;
+        SkipSpace();
+    }
+    if (!OpenTag("es", 2)) {
+        return false;
+    }
+    bool hasName = false;
+    bool hasLanguages = false;
+    bool hasTree = false;
+    bool hasNodes = false;
+    bool hasConnections = false;
+    while (true) {
+        SkipSpace();
+        if (Expect("</es>")) {
+            break;
+        }
+        if (!hasName && OpenTag("name", 4)) {
+            hasName = true;
+            const char* raw = m_it;
+            std::size_t offset = 0;
+            std::uint32_t size = 0;
+            bool decoded = false;
+            if (!ScanText(offset, size, decoded)) {
+                return false;
+            }
+            // Название из одних пробелов pugixml считает пустым
+            if ((raw != m_it && SkipSpaces(raw, m_it) == m_it) || !Expect("</name>")) {
+                return false;
+            }
+            m_name.assign((decoded ? m_decoded.data() : m_data) + offset, size);
+        }
+        else if (!hasLanguages && OpenTag("languages", 9)) {
+            hasLanguages = true;
+            if (!ScanLanguages()) {
+                return false;
+            }
+        }
+        else if (!hasTree && OpenTag("tree", 4)) {
+            hasTree = true;
+            while (true) {
+                SkipSpace();
+                if (Expect("</tree>")) {
+                    break;
+                }
+                if (!hasNodes && OpenTag("nodes", 5)) {
+                    hasNodes = true;
+                    if (!ScanNodes()) {
+                        return false;
+                    }
+                }
+                else if (!hasConnections && OpenTag("connections", 11)) {
+                    hasConnections = true;
+                    if (!ScanConnections()) {
+                        return false;
+                    }
+                }
+                else {
+                    return false;
+                }
+            }
+        }
+        else {
+            return false;
+        }
+    }
+    SkipSpace();
+    // Отсутствующие обязательные элементы - ошибка, о которой сообщит pugixml
+    return hasName && hasNodes && hasConnections && m_it == m_end;
+}
+
+/**
+ * Разбор элементов <language code path> до закрывающего </languages>.
+ *
+ * \return true - если элементы соответствуют схеме
+ */
+bool XmlScanner::ScanLanguages()
+{
+    while (true) {
+        SkipSpace();
+        if (Expect("</languages>")) {
+            return true;
+        }
+        if (!Expect("<language") || m_it == m_end || !IsSpace(*m_it)) {
+            return false;
+        }
+        const char* code = nullptr;
+        std::size_t codeSize = 0;
+        const char* path = nullptr;
+        std::size_t pathSize = 0;
+        while (true) {
+            SkipSpace();
+            if (Expect("/>")) {
+                break;
+            }
+            const char* name = nullptr;
+            std::size_t nameSize = 0;
+            const char* value = nullptr;
+            std::size_t valueSize = 0;
+            if (!ScanAttribute(name, nameSize, value, valueSize)) {
+                return false;
+            }
+            if (!code && nameSize == 4 && std::memcmp(name, "code", 4) == 0) {
+                code = value;
+                codeSize = valueSize;
+            }
+            else if (!path && nameSize == 4 && std::memcmp(name, "path", 4) == 0) {
+                path = value;
+                pathSize = valueSize;
+            }
+            else {
+                return false;
+            }
+        }
+        if (!code || !path) {
+            return false;
+        }
+        m_languages.emplace_back(std::string(code, codeSize), std::string(path, pathSize));
+    }
+}
+
+/**
+ * Разбор элементов <node type id> до закрывающего </nodes>.
+ *
+ * \return true - если элементы соответствуют схеме
+ */
+bool XmlScanner::ScanNodes()
+{
+    while (true) {
+        SkipSpace();
+        if (Expect("</nodes>")) {
+            return true;
+        }
+        if (!Expect("<node") || m_it == m_end || !IsSpace(*m_it)) {
+            return false;
+        }
+        ScannedNode node;
+        // Почти все узлы записаны одинаково: <node type="question" id="1">,
+        // и такая запись разбирается сравнением с образцом. Другой порядок
+        // атрибутов, другие кавычки и пробелы разбирает общий цикл
+        const char* attributes = m_it;
+        node.question = Expect(" type=\"question\" id=\"");
+        const bool sample = (node.question || Expect(" type=\"answer\" id=\""))
+            && ScanNumber(node.id) && Expect("\">");
+        bool hasType = sample;
+        bool hasID = sample;
+        if (!sample) {
+            m_it = attributes;
+            node.question = false;
+        }
+        while (!sample) {
+            SkipSpace();
+            if (m_it != m_end && *m_it == '>') {
+                ++m_it;
+                break;
+            }
+            const char* name = nullptr;
+            std::size_t nameSize = 0;
+            const char* value = nullptr;
+            std::size_t valueSize = 0;
+            if (!ScanAttribute(name, nameSize, value, valueSize)) {
+                return false;
+            }
+            if (!hasType && nameSize == 4 && std::memcmp(name, "type", 4) == 0) {
+                // Неизвестный тип узла pugixml пропустит с предупреждением
+                if (valueSize == 8 && std::memcmp(value, "question", 8) == 0) {
+                    node.question = true;
+                }
+                else if (valueSize != 6 || std::memcmp(value, "answer", 6) != 0) {
+                    return false;
+                }
+                hasType = true;
+            }
+            else if (!hasID && nameSize == 2 && std::memcmp(name, "id", 2) == 0) {
+                if (!ParseInt(value, valueSize, node.id)) {
+                    return false;
+                }
+                hasID = true;
+            }
+            else {
+                return false;
+            }
+        }
+        // Узел без текста либо с текстом из одних пробелов pugixml
+        // пропустит с предупреждением
+        const char* raw = m_it;
+        if (!hasType || !hasID || !ScanText(node.text, node.size, node.decoded)
+            || raw == m_it || SkipSpaces(raw, m_it) == m_it || !Expect("</node>")) {
+            return false;
+        }
+        ++(node.question ? m_questions : m_answers);
+        m_nodes.push_back(node);
+    }
+}
+
+/**
+ * Разбор элементов <connection src dst predicat> до закрывающего </connections>.
+ *
+ * \return true - если элементы соответствуют схеме
+ */
+bool XmlScanner::ScanConnections()
+{
+    while (true) {
+        SkipSpace();
+        if (Expect("</connections>")) {
+            return true;
+        }
+        if (!Expect("<connection") || m_it == m_end || !IsSpace(*m_it)) {
+            return false;
+        }
+        ScannedConnection connection;
+        // Обычная запись соединения разбирается сравнением с образцом,
+        // как и запись узла
+        const char* attributes = m_it;
+        const bool sample = Expect(" src=\"") && ScanNumber(connection.src)
+            && Expect("\" dst=\"") && ScanNumber(connection.dst)
+            && Expect("\" predicat=\"") && ScanNumber(connection.predicat) && Expect("\"");
+        unsigned found = sample ? 7 : 0;
+        if (!sample) {
+            m_it = attributes;
+        }
+        while (true) {
+            SkipSpace();
+            if (Expect("/>")) {
+                break;
+            }
+            if (m_it != m_end && *m_it == '>') {
+                ++m_it;
+                SkipSpace();
+                if (!Expect("</connection>")) {
+                    return false;
+                }
+                break;
+            }
+            const char* name = nullptr;
+            std::size_t nameSize = 0;
+            const char* value = nullptr;
+            std::size_t valueSize = 0;
+            if (!ScanAttribute(name, nameSize, value, valueSize)) {
+                return false;
+            }
+            int* target = nullptr;
+            unsigned bit = 0;
+            if (nameSize == 3 && std::memcmp(name, "src", 3) == 0) {
+                target = &connection.src;
+                bit = 1;
+            }
+            else if (nameSize == 3 && std::memcmp(name, "dst", 3) == 0) {
+                target = &connection.dst;
+                bit = 2;
+            }
+            else if (nameSize == 8 && std::memcmp(name, "predicat", 8) == 0) {
+                target = &connection.predicat;
+                bit = 4;
+            }
+            if (!target || (found & bit) || !ParseInt(value, valueSize, *target)) {
+                return false;
+            }
+            found |= bit;
+        }
+        // Соединение без атрибута pugixml пропустит с предупреждением
+        if (found != 7) {
+            return false;
+        }
+        m_connections.push_back(connection);
+    }
+}
+
+/**
+ * Разбор целого числа в текущей позиции.
+ *
+ * \param value Разобранное число
+ * \return true - если число разобрано и помещается в int
+ */
+bool XmlScanner::ScanNumber(
+    int& value) noexcept
+{
+    const char* it = m_it;
+    if (it != m_end && *it == '-') {
+        ++it;
+    }
+    while (it != m_end && static_cast<unsigned char>(*it - '0') <= 9) {
+        ++it;
+    }
+    if (!ParseInt(m_it, static_cast<std::size_t>(it - m_it), value)) {
+        return false;
+    }
+    m_it = it;
+    return true;
+}
+
+/**
+ * Разбор текста элемента до следующего '<'.
+ *
+ * \param offset Начало текста в конфигурации либо в m_decoded
+ * \param size Размер текста
+ * \param decoded Текст раскодирован в m_decoded
+ * \return false - если текст не закончен или в нём незнакомая сущность
+ */
+bool XmlScanner::ScanText(
+    std::size_t& offset,
+    std::uint32_t& size,
+    bool& decoded)
+{
+    const char* begin = m_it;
+    const char* it = FindMarkup(begin, m_end);
+    decoded = it != m_end && *it != '<';
+    if (decoded) {
+        it = static_cast<const char*>(std::memchr(it, '<', static_cast<std::size_t>(m_end - it)));
+        if (!it) {
+            return false;
+        }
+    }
+    if (it == m_end || static_cast<std::size_t>(it - begin) > UINT32_MAX) {
+        return false;
+    }
+    if (decoded) {
+        offset = m_decoded.size();
+        if (!DecodeText(begin, it, m_decoded)) {
+            return false;
+        }
+        size = static_cast<std::uint32_t>(m_decoded.size() - offset);
+    }
+    else {
+        offset = static_cast<std::size_t>(begin - m_data);
+        size = static_cast<std::uint32_t>(it - begin);
+    }
+    m_it = it;
+    return true;
+}
+
+/**
+ * Разбор атрибута name="value".
+ * Значения с сущностями и пробельными символами, кроме пробела,
+ * pugixml нормализует, поэтому такие значения выходят за схему.
+ *
+ * \param name Имя атрибута
+ * \param nameSize Длина имени
+ * \param value Значение атрибута
+ * \param valueSize Длина значения
+ * \return true - если атрибут разобран
+ */
+bool XmlScanner::ScanAttribute(
+    const char*& name,
+    std::size_t& nameSize,
+    const char*& value,
+    std::size_t& valueSize)
+{
+    const char* it = m_it;
+    name = it;
+    while (it != m_end && ((*it >= 'a' && *it <= 'z') || (*it >= 'A' && *it <= 'Z'))) {
+        ++it;
+    }
+    nameSize = static_cast<std::size_t>(it - name);
+    it = SkipSpaces(it, m_end);
+    if (nameSize == 0 || it == m_end || *it != '=') {
+        return false;
+    }
+    it = SkipSpaces(it + 1, m_end);
+    if (it == m_end || (*it != '"' && *it != '\'')) {
+        return false;
+    }
+    // Значения короткие, поэтому конец ищется вместе с проверкой символов
+    const char quote = *it++;
+    value = it;
+    for (; it != m_end && *it != quote; ++it) {
+        if (*it == '&' || *it == '<' || (*it != ' ' && IsSpace(*it))) {
+            return false;
+        }
+    }
+    if (it == m_end) {
+        return false;
+    }
+    valueSize = static_cast<std::size_t>(it - value);
+    m_it = it + 1;
+    return true;
+}
+
+/**
+ * Пропуск открывающего тега без атрибутов.
+ *
+ * \param name Имя элемента
+ * \param size Длина имени
+ * \return true - если в текущей позиции открывающий тег элемента
+ */
+bool XmlScanner::OpenTag(
+    const char* name,
+    const std::size_t size) noexcept
+{
+    if (static_cast<std::size_t>(m_end - m_it) < size + 2 || *m_it != '<'
+        || std::memcmp(m_it + 1, name, size) != 0) {
+        return false;
+    }
+    const char* it = SkipSpaces(m_it + size + 1, m_end);
+    if (it == m_end || *it != '>') {
+        return false;
+    }
+    m_it = it + 1;
+    return true;
+}
+
+/**
+ * Пропуск пробельных символов.
+ */
+void XmlScanner::SkipSpace() noexcept
+{
+    m_it = SkipSpaces(m_it, m_end);
+}
+
+}
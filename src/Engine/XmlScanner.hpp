@@ -0,0 +1,179 @@
+﻿#pragma once
+
+#include "ITreeBuilder.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace ES
+{
+
+/**
+ * Разбор xml-конфигурации экспертной системы без построения DOM.
+ * Сканер знает только схему конфигурации: <es> с элементами <name>,
+ * <languages> и <tree>, в <tree> - <nodes> с элементами <node type id>
+ * и <connections> с элементами <connection src dst predicat>.
+ * Разметка ищется SIMD-сравнением блоков по 16 байт (SSE2) или 32 байта
+ * (AVX2, если его поддерживает процессор),
+ * целые числа разбираются без локали. Всё, что выходит за схему
+ * (комментарии, CDATA, незнакомые элементы и атрибуты, пустые тексты,
+ * нечисловые идентификаторы), прерывает разбор, и конфигурация
+ * разбирается pugixml, который выдаёт те же предупреждения и ошибки,
+ * что и раньше. До успешного окончания разбора построитель не получает
+ * ни одной записи.
+ */
+class XmlScanner final
+{
+public:
+
+    /**
+     * Разбор конфигурации.
+     *
+     * \param data Текст конфигурации. Должен оставаться доступным до Emit
+     * \param size Размер текста в байтах
+     * \return true - если конфигурация соответствует схеме
+     */
+    bool Scan(
+        const char* data,
+        const std::size_t size);
+
+    /**
+     * Передача узлов и соединений в построитель в порядке файла.
+     *
+     * \param builder Построитель дерева
+     * \return
+     */
+    void Emit(
+        ITreeBuilder& builder) const;
+
+    /**
+     * Получение названия экспертной системы.
+     */
+    const std::string& GetName() const noexcept
+    {
+        return m_name;
+    }
+
+    /**
+     * Получение дополнительных языков.
+     *
+     * \return Коды языков и пути к файлам языков из атрибутов
+     */
+    const std::vector<std::pair<std::string, std::string>>& GetLanguages() const noexcept
+    {
+        return m_languages;
+    }
+
+    /**
+     * Получение набора команд, которым ищется разметка.
+     * AVX2 выбирается при запуске, если его поддерживает процессор.
+     *
+     * \return AVX2, SSE2, либо пустая строка
+     */
+    static std::string_view Instructions() noexcept;
+
+    /**
+     * Получение смещения, на котором разбор вышел за схему.
+     *
+     * \return Смещение в байтах от начала текста
+     */
+    std::size_t GetStopOffset() const noexcept
+    {
+        return m_stop;
+    }
+
+private:
+
+    /**
+     * Узел, найденный при разборе.
+     */
+    struct ScannedNode
+    {
+        // Начало текста: смещение в конфигурации либо,
+        // если в тексте были сущности или \r, в m_decoded
+        std::size_t text = 0;
+        // Размер текста в байтах
+        std::uint32_t size = 0;
+        // Текст раскодирован в m_decoded
+        bool decoded = false;
+        // Узел - вопрос
+        bool question = false;
+        // Идентификатор узла
+        node_id_t id = -1;
+    };
+
+    /**
+     * Соединение, найденное при разборе.
+     */
+    struct ScannedConnection
+    {
+        node_id_t src = -1;
+        node_id_t dst = -1;
+        int predicat = 0;
+    };
+
+    bool ScanDocument();
+    bool ScanLanguages();
+    bool ScanNodes();
+    bool ScanConnections();
+    bool ScanText(
+        std::size_t& offset,
+        std::uint32_t& size,
+        bool& decoded);
+    bool ScanNumber(
+        int& value) noexcept;
+    bool ScanAttribute(
+        const char*& name,
+        std::size_t& nameSize,
+        const char*& value,
+        std::size_t& valueSize);
+    bool OpenTag(
+        const char* name,
+        const std::size_t size) noexcept;
+    void SkipSpace() noexcept;
+
+    /**
+     * Пропуск заданной строки. Длина известна при компиляции,
+     * поэтому сравнение не вызывает memcmp.
+     *
+     * \param literal Строка
+     * \return true - если текст в текущей позиции совпадает со строкой
+     */
+    template <std::size_t N>
+    bool Expect(
+        const char (&literal)[N]) noexcept
+    {
+        constexpr std::size_t size = N - 1;
+        if (static_cast<std::size_t>(m_end - m_it) < size || std::memcmp(m_it, literal, size) != 0) {
+            return false;
+        }
+        m_it += size;
+        return true;
+    }
+
+    // Текст конфигурации и текущая позиция разбора
+    const char* m_data = nullptr;
+    const char* m_it = nullptr;
+    const char* m_end = nullptr;
+    // Название экспертной системы
+    std::string m_name;
+    // Дополнительные языки: код и путь к файлу
+    std::vector<std::pair<std::string, std::string>> m_languages;
+    // Узлы и соединения в порядке файла
+    std::vector<ScannedNode> m_nodes;
+    std::vector<ScannedConnection> m_connections;
+    // Количество вопросов и ответов
+    std::size_t m_questions = 0;
+    std::size_t m_answers = 0;
+    // Раскодированные тексты узлов
+    std::string m_decoded;
+    // Смещение, на котором разбор вышел за схему
+    std::size_t m_stop = 0;
+};
+
+}